@@ -71,6 +71,7 @@ G: 1.00003  -0.344125      -0.714128     :Cb - 2^(prec - 1)
 B: 0.999823  1.77204       -8.04142e-06  :Cr - 2^(prec - 1)
 
 -----------------------------------------------------------*/
+#ifdef OPJ_USE_LEGACY
 static void sycc_to_rgb(int offset, int upb, int y, int cb, int cr,
 	int *out_r, int *out_g, int *out_b)
 {
@@ -257,6 +258,7 @@ static void sycc420_to_rgb(opj_image_t *img)
 	img->comps[2].dy = img->comps[0].dy;
 
 }/* sycc420_to_rgb() */
+#endif /* OPJ_USE_LEGACY */
 
 void color_sycc_to_rgb(opj_image_t *img)
 {
@@ -266,6 +268,24 @@ void color_sycc_to_rgb(opj_image_t *img)
 		return;
 	}
 
+#ifndef OPJ_USE_LEGACY
+	/* The library upsamples the chroma row by row while converting:
+	 * full resolution luma, chroma subsampled by at most 2 each way */
+	if((img->comps[0].dx != 1)
+	|| (img->comps[0].dy != 1)
+	|| (img->comps[1].dx != 1 && img->comps[1].dx != 2)
+	|| (img->comps[1].dy != 1 && img->comps[1].dy != 2)
+	|| (img->comps[2].dx != img->comps[1].dx)
+	|| (img->comps[2].dy != img->comps[1].dy))
+  {
+		fprintf(stderr,"%s:%d:color_sycc_to_rgb\n\tCAN NOT CONVERT\n", __FILE__,__LINE__);
+		return;
+  }
+	if(!opj_image_sycc_to_rgb(img))
+	{
+		fprintf(stderr,"%s:%d:color_sycc_to_rgb\n\tCAN NOT CONVERT, the image is left in sYCC\n", __FILE__,__LINE__);
+	}
+#else
 	if((img->comps[0].dx == 1)
 	&& (img->comps[1].dx == 2)
 	&& (img->comps[2].dx == 2)
@@ -301,6 +321,7 @@ void color_sycc_to_rgb(opj_image_t *img)
 		return;
   }
 	img->color_space = OPJ_CLRSPC_SRGB;
+#endif /* OPJ_USE_LEGACY */
 
 }/* color_sycc_to_rgb() */
 
@@ -321,16 +342,57 @@ void color_sycc_to_rgb(opj_image_t *img)
 
 #endif /* OPJ_HAVE_LIBLCMS1 */
 
+/* Number of pixels converted at a time, the buffers do not grow with the image */
+#define COLOR_ICC_NR_PIXELS 4096
+/* Number of transforms kept by a cache */
+#define COLOR_ICC_CACHE_SIZE 16
+
+typedef struct color_icc_transform
+{
+	/* copy of the profile the transform was made from, and its hash */
+	unsigned char *profile;
+	unsigned int profile_len;
+	unsigned int hash;
+	/* 1 when the samples have more than 8 bits */
+	int is_16bit;
+	cmsHTRANSFORM transform;
+	cmsUInt32Number in_type, out_type;
+#ifdef OPJ_HAVE_LIBLCMS1
+	/* LCMS1 transforms need their profiles */
+	cmsHPROFILE in_prof, out_prof;
+#endif
+	/* 1 while an image is converted with the transform: LCMS keeps the
+	   last pixel converted in the transform, it cannot be used by two threads */
+	int in_use;
+} color_icc_transform_t;
+
+struct color_icc_cache
+{
+	color_icc_transform_t transforms[COLOR_ICC_CACHE_SIZE];
+	int nr_transforms;
+	void (*lock)(void);
+	void (*unlock)(void);
+};
+
+static unsigned int color_icc_hash(const unsigned char *buf, unsigned int len)
+{
+	unsigned int hash = 2166136261U, i;/* FNV-1a */
+
+	for(i = 0; i < len; ++i)
+   {
+	hash = (hash ^ buf[i]) * 16777619U;
+   }
+	return hash;
+}
+
 /*#define DEBUG_PROFILE*/
-void color_apply_icc_profile(opj_image_t *image)
+static int color_create_icc_transform(const opj_image_t *image,
+	color_icc_transform_t *t)
 {
 	cmsHPROFILE in_prof, out_prof;
-	cmsHTRANSFORM transform;
 	cmsColorSpaceSignature in_space, out_space;
-	cmsUInt32Number intent, in_type, out_type, nr_samples;
-	int *r, *g, *b;
-	int prec, i, max, max_w, max_h;
-	OPJ_COLOR_SPACE oldspace;
+	cmsUInt32Number intent;
+	int prec;
 
 	in_prof = 
 	 cmsOpenProfileFromMem(image->icc_profile_buf, image->icc_profile_len);
@@ -340,48 +402,30 @@ void color_apply_icc_profile(opj_image_t *image)
   fclose(icm);
 #endif
 
-	if(in_prof == NULL) return;
+	if(in_prof == NULL) return 0;
 
 	in_space = cmsGetPCS(in_prof);
 	out_space = cmsGetColorSpace(in_prof);
 	intent = cmsGetHeaderRenderingIntent(in_prof);
 
-	
-	max_w = (int)image->comps[0].w;
-  max_h = (int)image->comps[0].h;
 	prec = (int)image->comps[0].prec;
-	oldspace = image->color_space;
 
 	if(out_space == cmsSigRgbData) /* enumCS 16 */
    {
-  if( prec <= 8 )
-{
-	in_type = TYPE_RGB_8;
-	out_type = TYPE_RGB_8;
-}
-else
-{
-	in_type = TYPE_RGB_16;
-	out_type = TYPE_RGB_16;
-}
-	out_prof = cmsCreate_sRGBProfile();
-	image->color_space = OPJ_CLRSPC_SRGB;
+	t->in_type = (prec <= 8) ? TYPE_RGB_8 : TYPE_RGB_16;
+	t->out_type = t->in_type;
    }
 	else
 	if(out_space == cmsSigGrayData) /* enumCS 17 */
    {
-	in_type = TYPE_GRAY_8;
-	out_type = TYPE_RGB_8;
-	out_prof = cmsCreate_sRGBProfile();
-	image->color_space = OPJ_CLRSPC_SRGB;
+	t->in_type = TYPE_GRAY_8;
+	t->out_type = TYPE_RGB_8;
    }
 	else
 	if(out_space == cmsSigYCbCrData) /* enumCS 18 */
    {
-	in_type = TYPE_YCbCr_16;
-	out_type = TYPE_RGB_16;
-	out_prof = cmsCreate_sRGBProfile();
-	image->color_space = OPJ_CLRSPC_SRGB;
+	t->in_type = (prec <= 8) ? TYPE_YCbCr_8 : TYPE_YCbCr_16;
+	t->out_type = (prec <= 8) ? TYPE_RGB_8 : TYPE_RGB_16;
    }
 	else
    {
@@ -392,13 +436,15 @@ __FILE__,__LINE__,out_space,
 (out_space>>24) & 0xff,(out_space>>16) & 0xff,
 (out_space>>8) & 0xff, out_space & 0xff);
 #endif
-	return;
+	cmsCloseProfile(in_prof);
+	return 0;
    }
+	out_prof = cmsCreate_sRGBProfile();
 
 #ifdef DEBUG_PROFILE
 fprintf(stderr,"%s:%d:color_apply_icc_profile\n\tchannels(%d) prec(%d) w(%d) h(%d)"
 "\n\tprofile: in(%p) out(%p)\n",__FILE__,__LINE__,image->numcomps,prec,
-max_w,max_h, (void*)in_prof,(void*)out_prof);
+image->comps[0].w,image->comps[0].h, (void*)in_prof,(void*)out_prof);
 
 fprintf(stderr,"\trender_intent (%u)\n\t"
 "color_space: in(%#x)(%c%c%c%c)   out:(%#x)(%c%c%c%c)\n\t"
@@ -412,15 +458,15 @@ out_space,
 (out_space>>24) & 0xff,(out_space>>16) & 0xff,
 (out_space>>8) & 0xff, out_space & 0xff,
 
-in_type,out_type
+t->in_type,t->out_type
  );
 #else
   (void)prec;
   (void)in_space;
 #endif /* DEBUG_PROFILE */
 
-	transform = cmsCreateTransform(in_prof, in_type,
-	 out_prof, out_type, intent, 0);
+	t->transform = cmsCreateTransform(in_prof, t->in_type,
+	 out_prof, t->out_type, intent, 0);
 
 #ifdef OPJ_HAVE_LIBLCMS2
 /* Possible for: LCMS_VERSION >= 2000 :*/
@@ -428,137 +474,225 @@ in_type,out_type
 	cmsCloseProfile(out_prof);
 #endif
 
-	if(transform == NULL)
+	if(t->transform == NULL)
    {
 #ifdef DEBUG_PROFILE
 fprintf(stderr,"%s:%d:color_apply_icc_profile\n\tcmsCreateTransform failed. "
 "ICC Profile ignored.\n",__FILE__,__LINE__);
 #endif
-	image->color_space = oldspace;
 #ifdef OPJ_HAVE_LIBLCMS1
 	cmsCloseProfile(in_prof);
 	cmsCloseProfile(out_prof);
 #endif
-	return;
+	return 0;
    }
+#ifdef OPJ_HAVE_LIBLCMS1
+	t->in_prof = in_prof;
+	t->out_prof = out_prof;
+#endif
+	return 1;
+}/* color_create_icc_transform() */
 
-	if(image->numcomps > 2)/* RGB, RGBA */
-   {
-  if( prec <= 8 )
+static void color_destroy_icc_transform(color_icc_transform_t *t)
 {
-	unsigned char *inbuf, *outbuf, *in, *out;
-	max = max_w * max_h;
-  nr_samples = (cmsUInt32Number)max * 3 * (cmsUInt32Number)sizeof(unsigned char);
-	in = inbuf = (unsigned char*)malloc(nr_samples);
-	out = outbuf = (unsigned char*)malloc(nr_samples);
+	cmsDeleteTransform(t->transform);
+#ifdef OPJ_HAVE_LIBLCMS1
+	cmsCloseProfile(t->in_prof);
+	cmsCloseProfile(t->out_prof);
+#endif
+	free(t->profile);
+}
 
-	r = image->comps[0].data;
-	g = image->comps[1].data;
-	b = image->comps[2].data;
+/* Converts the samples by chunks of COLOR_ICC_NR_PIXELS pixels */
+static int color_convert_icc(opj_image_t *image, const color_icc_transform_t *t)
+{
+	unsigned char *inbuf, *outbuf;
+	int *r, *g, *b;
+	size_t max, i, n, k;
+	int in_channels = (int)T_CHANNELS(t->in_type);
+
+	max = (size_t)image->comps[0].w * image->comps[0].h;
+	inbuf = (unsigned char*)malloc(COLOR_ICC_NR_PIXELS * 3 * sizeof(unsigned short));
+	outbuf = (unsigned char*)malloc(COLOR_ICC_NR_PIXELS * 3 * sizeof(unsigned short));
+	if(inbuf == NULL || outbuf == NULL)
+   {
+	free(inbuf); free(outbuf);
+	return 0;
+   }
 
-	for(i = 0; i < max; ++i)
+	if(image->numcomps <= 2)/* GRAY, GRAYA */
+   {
+	opj_image_comp_t *comps = (opj_image_comp_t*)
+	 realloc(image->comps, (image->numcomps+2)*sizeof(opj_image_comp_t));
+	if(comps == NULL)
   {
-	*in++ = (unsigned char)*r++;
-	*in++ = (unsigned char)*g++;
-	*in++ = (unsigned char)*b++;
+	free(inbuf); free(outbuf);
+	return 0;
   }
+	image->comps = comps;
 
-	cmsDoTransform(transform, inbuf, outbuf, (cmsUInt32Number)max);
+	if(image->numcomps == 2)
+	 image->comps[3] = image->comps[1];
 
-	r = image->comps[0].data;
-	g = image->comps[1].data;
-	b = image->comps[2].data;
+	image->comps[1] = image->comps[0];
+	image->comps[2] = image->comps[0];
 
-	for(i = 0; i < max; ++i)
+	image->comps[1].data = (int*)calloc(max, sizeof(int));
+	image->comps[2].data = (int*)calloc(max, sizeof(int));
+
+	image->numcomps += 2;
+
+	if(image->comps[1].data == NULL || image->comps[2].data == NULL)
   {
-	*r++ = (int)*out++;
-	*g++ = (int)*out++;
-	*b++ = (int)*out++;
-  }
 	free(inbuf); free(outbuf);
-}
-else
-{
-	unsigned short *inbuf, *outbuf, *in, *out;
-	max = max_w * max_h;
-  nr_samples = (cmsUInt32Number)max * 3 * (cmsUInt32Number)sizeof(unsigned short);
-	in = inbuf = (unsigned short*)malloc(nr_samples);
-	out = outbuf = (unsigned short*)malloc(nr_samples);
+	return 0;
+  }
+   }
 
 	r = image->comps[0].data;
 	g = image->comps[1].data;
 	b = image->comps[2].data;
 
-	for(i = 0; i < max; ++i)
+	for(i = 0; i < max; i += n)
+   {
+	n = max - i;
+	if(n > COLOR_ICC_NR_PIXELS) n = COLOR_ICC_NR_PIXELS;
+
+	if(T_BYTES(t->in_type) == 1)
   {
-	*in++ = (unsigned short)*r++;
-	*in++ = (unsigned short)*g++;
-	*in++ = (unsigned short)*b++;
+	unsigned char *in = inbuf;
+	for(k = i; k < i + n; ++k)
+ {
+	*in++ = (unsigned char)r[k];
+	if(in_channels == 3) { *in++ = (unsigned char)g[k]; *in++ = (unsigned char)b[k]; }
+ }
+  }
+	else
+  {
+	unsigned short *in = (unsigned short*)inbuf;
+	for(k = i; k < i + n; ++k)
+ {
+	*in++ = (unsigned short)r[k];
+	if(in_channels == 3) { *in++ = (unsigned short)g[k]; *in++ = (unsigned short)b[k]; }
+ }
   }
 
-	cmsDoTransform(transform, inbuf, outbuf, (cmsUInt32Number)max);
-
-	r = image->comps[0].data;
-	g = image->comps[1].data;
-	b = image->comps[2].data;
+	cmsDoTransform(t->transform, inbuf, outbuf, (cmsUInt32Number)n);
 
-	for(i = 0; i < max; ++i)
+	if(T_BYTES(t->out_type) == 1)
   {
-	*r++ = (int)*out++;
-	*g++ = (int)*out++;
-	*b++ = (int)*out++;
+	const unsigned char *out = outbuf;
+	for(k = i; k < i + n; ++k)
+ {
+	r[k] = (int)*out++; g[k] = (int)*out++; b[k] = (int)*out++;
+ }
+  }
+	else
+  {
+	const unsigned short *out = (const unsigned short*)outbuf;
+	for(k = i; k < i + n; ++k)
+ {
+	r[k] = (int)*out++; g[k] = (int)*out++; b[k] = (int)*out++;
+ }
   }
-	free(inbuf); free(outbuf);
-}
    }
-	else /* GRAY, GRAYA */
-   {
-	unsigned char *in, *inbuf, *out, *outbuf;
-  max = max_w * max_h;
-  nr_samples = (cmsUInt32Number)max * 3 * sizeof(unsigned char);
-	in = inbuf = (unsigned char*)malloc(nr_samples);
-	out = outbuf = (unsigned char*)malloc(nr_samples);
-
-	image->comps = (opj_image_comp_t*)
-	 realloc(image->comps, (image->numcomps+2)*sizeof(opj_image_comp_t));
+	free(inbuf); free(outbuf);
+	return 1;
+}/* color_convert_icc() */
 
-	if(image->numcomps == 2)
-	 image->comps[3] = image->comps[1];
+color_icc_cache_t *color_icc_cache_create(void (*lock)(void), void (*unlock)(void))
+{
+	color_icc_cache_t *cache = (color_icc_cache_t*)calloc(1, sizeof(color_icc_cache_t));
 
-	image->comps[1] = image->comps[0];
-	image->comps[2] = image->comps[0];
+	if(cache == NULL) return NULL;
+	cache->lock = lock;
+	cache->unlock = unlock;
+	return cache;
+}
 
-	image->comps[1].data = (int*)calloc((size_t)max, sizeof(int));
-	image->comps[2].data = (int*)calloc((size_t)max, sizeof(int));
+void color_icc_cache_destroy(color_icc_cache_t *cache)
+{
+	int i;
 
-	image->numcomps += 2;
+	if(cache == NULL) return;
+	for(i = 0; i < cache->nr_transforms; ++i)
+   {
+	color_destroy_icc_transform(&cache->transforms[i]);
+   }
+	free(cache);
+}
 
-	r = image->comps[0].data;
+void color_apply_icc_profile_cached(opj_image_t *image, color_icc_cache_t *cache)
+{
+	color_icc_transform_t local, *t = NULL;
+	unsigned int hash = 0;
+	int is_16bit = (image->comps[0].prec > 8), i, done;
 
-	for(i = 0; i < max; ++i)
+	/* a transform of the same profile and sample size, not used by another thread */
+	if(cache)
+   {
+	hash = color_icc_hash(image->icc_profile_buf, image->icc_profile_len);
+	if(cache->lock) cache->lock();
+	for(i = 0; i < cache->nr_transforms; ++i)
   {
-	*in++ = (unsigned char)*r++;
+	color_icc_transform_t *c = &cache->transforms[i];
+	if(!c->in_use && c->hash == hash && c->is_16bit == is_16bit
+	&& c->profile_len == image->icc_profile_len
+	&& memcmp(c->profile, image->icc_profile_buf, c->profile_len) == 0)
+ {
+	c->in_use = 1;
+	t = c;
+	break;
+ }
   }
-	cmsDoTransform(transform, inbuf, outbuf, (cmsUInt32Number)max);
+	if(cache->unlock) cache->unlock();
+   }
 
-	r = image->comps[0].data;
-	g = image->comps[1].data;
-	b = image->comps[2].data;
+	if(t == NULL)
+   {
+	memset(&local, 0, sizeof(local));
+	if(!color_create_icc_transform(image, &local)) return;
+	t = &local;
 
-	for(i = 0; i < max; ++i)
+	if(cache)
   {
-	*r++ = (int)*out++; *g++ = (int)*out++; *b++ = (int)*out++;
+	if(cache->lock) cache->lock();
+	if(cache->nr_transforms < COLOR_ICC_CACHE_SIZE)
+ {
+	local.profile = (unsigned char*)malloc(image->icc_profile_len);
+	if(local.profile)
+{
+	memcpy(local.profile, image->icc_profile_buf, image->icc_profile_len);
+	local.profile_len = image->icc_profile_len;
+	local.hash = hash;
+	local.is_16bit = is_16bit;
+	local.in_use = 1;
+	t = &cache->transforms[cache->nr_transforms++];
+	*t = local;
+}
+ }
+	if(cache->unlock) cache->unlock();
   }
-	free(inbuf); free(outbuf);
+   }
 
-   }/* if(image->numcomps */
+	done = color_convert_icc(image, t);
+	if(done) image->color_space = OPJ_CLRSPC_SRGB;
 
-	cmsDeleteTransform(transform);
+	if(t == &local)
+   {
+	color_destroy_icc_transform(&local);
+   }
+	else
+   {
+	if(cache->lock) cache->lock();
+	t->in_use = 0;
+	if(cache->unlock) cache->unlock();
+   }
+}/* color_apply_icc_profile_cached() */
 
-#ifdef OPJ_HAVE_LIBLCMS1
-	cmsCloseProfile(in_prof);
-	cmsCloseProfile(out_prof);
-#endif
+void color_apply_icc_profile(opj_image_t *image)
+{
+	color_apply_icc_profile_cached(image, NULL);
 }/* color_apply_icc_profile() */
 
 #endif /* OPJ_HAVE_LIBLCMS2 || OPJ_HAVE_LIBLCMS1 */
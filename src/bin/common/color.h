@@ -38,7 +38,22 @@
 #ifndef _OPJ_COLOR_H_
 #define _OPJ_COLOR_H_
 
+/** Transforms of the ICC profiles already met, reused by the next images */
+typedef struct color_icc_cache color_icc_cache_t;
+
 extern void color_sycc_to_rgb(opj_image_t *img);
 extern void color_apply_icc_profile(opj_image_t *image);
 
+/**
+ * Creates an empty cache of ICC transforms. lock and unlock, if not NULL,
+ * serialize the accesses to the cache of images converted by several threads.
+ */
+extern color_icc_cache_t *color_icc_cache_create(void (*lock)(void), void (*unlock)(void));
+extern void color_icc_cache_destroy(color_icc_cache_t *cache);
+/**
+ * Same as color_apply_icc_profile, the transform of the profile being
+ * taken from the cache or added to it
+ */
+extern void color_apply_icc_profile_cached(opj_image_t *image, color_icc_cache_t *cache);
+
 #endif /* _OPJ_COLOR_H_ */
@@ -0,0 +1,278 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "opj_apps_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#ifdef OPJ_HAVE_PTHREAD
+#include <pthread.h>
+#endif /* OPJ_HAVE_PTHREAD */
+#endif /* _WIN32 */
+
+#include "opj_batch.h"
+
+#if defined(_WIN32)
+static CRITICAL_SECTION opj_batch_mutex;
+#elif defined(OPJ_HAVE_PTHREAD)
+static pthread_mutex_t opj_batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/** State shared by the workers of a batch */
+typedef struct opj_batch_job
+{
+	int num_images;
+	/** next file to process, protected by opj_batch_mutex */
+	int next_image;
+	opj_batch_process_fn process_fn;
+	void *user_data;
+	/** totals of the batch, protected by opj_batch_mutex */
+	opj_batch_stats_t *stats;
+} opj_batch_job_t;
+
+/* -------------------------------------------------------------------------- */
+
+double opj_batch_clock(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, t;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+	/* wall clock: the time of a batch must not add up the CPU time of all threads */
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return (double)t.tv_sec + (double)t.tv_usec * 1e-6;
+#endif
+}
+
+double opj_batch_file_size(const char *filename)
+{
+	FILE *f;
+	long size;
+
+	f = fopen(filename, "rb");
+	if (f == NULL) {
+		return 0.0;
+	}
+	if (fseek(f, 0, SEEK_END) != 0) {
+		fclose(f);
+		return 0.0;
+	}
+	size = ftell(f);
+	fclose(f);
+	return size < 0 ? 0.0 : (double)size;
+}
+
+void opj_batch_lock(void)
+{
+#if defined(_WIN32)
+	EnterCriticalSection(&opj_batch_mutex);
+#elif defined(OPJ_HAVE_PTHREAD)
+	pthread_mutex_lock(&opj_batch_mutex);
+#endif
+}
+
+void opj_batch_unlock(void)
+{
+#if defined(_WIN32)
+	LeaveCriticalSection(&opj_batch_mutex);
+#elif defined(OPJ_HAVE_PTHREAD)
+	pthread_mutex_unlock(&opj_batch_mutex);
+#endif
+}
+
+int opj_batch_has_threads(void)
+{
+#if defined(_WIN32) || defined(OPJ_HAVE_PTHREAD)
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+
+static void opj_batch_worker(opj_batch_job_t *job)
+{
+	for (;;) {
+		opj_batch_stats_t file_stats;
+		int imageno, i;
+
+		opj_batch_lock();
+		imageno = job->next_image++;
+		opj_batch_unlock();
+		if (imageno >= job->num_images) {
+			break;
+		}
+
+		memset(&file_stats, 0, sizeof(file_stats));
+		switch (job->process_fn(imageno, &file_stats, job->user_data)) {
+			case OPJ_BATCH_OK:
+				file_stats.nb_done = 1;
+				break;
+			case OPJ_BATCH_SKIPPED:
+				/* a skipped file does not count in the throughput */
+				memset(&file_stats, 0, sizeof(file_stats));
+				file_stats.nb_skipped = 1;
+				break;
+			default:
+				file_stats.nb_failed = 1;
+				break;
+		}
+
+		opj_batch_lock();
+		job->stats->nb_done += file_stats.nb_done;
+		job->stats->nb_failed += file_stats.nb_failed;
+		job->stats->nb_skipped += file_stats.nb_skipped;
+		job->stats->nb_bytes += file_stats.nb_bytes;
+		for (i = 0; i < OPJ_BATCH_NB_STAGES; i++) {
+			job->stats->stage_time[i] += file_stats.stage_time[i];
+		}
+		opj_batch_unlock();
+	}
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI opj_batch_thread(LPVOID arg)
+{
+	opj_batch_worker((opj_batch_job_t *)arg);
+	return 0;
+}
+#elif defined(OPJ_HAVE_PTHREAD)
+static void *opj_batch_thread(void *arg)
+{
+	opj_batch_worker((opj_batch_job_t *)arg);
+	return NULL;
+}
+#endif
+
+unsigned int opj_batch_run(int num_images, int num_threads,
+		opj_batch_process_fn process_fn, void *user_data,
+		opj_batch_stats_t *stats)
+{
+	opj_batch_job_t job;
+	double start;
+
+	memset(stats, 0, sizeof(opj_batch_stats_t));
+	job.num_images = num_images;
+	job.next_image = 0;
+	job.process_fn = process_fn;
+	job.user_data = user_data;
+	job.stats = stats;
+
+	if (num_threads > num_images) {
+		num_threads = num_images;
+	}
+
+#if defined(_WIN32)
+	InitializeCriticalSection(&opj_batch_mutex);
+#endif
+	start = opj_batch_clock();
+
+#if defined(_WIN32) || defined(OPJ_HAVE_PTHREAD)
+	if (num_threads > 1) {
+		int nb_started = 0, i;
+#if defined(_WIN32)
+		HANDLE *threads = (HANDLE *)malloc((size_t)num_threads * sizeof(HANDLE));
+#else
+		pthread_t *threads = (pthread_t *)malloc((size_t)num_threads * sizeof(pthread_t));
+#endif
+		if (threads) {
+			for (nb_started = 0; nb_started < num_threads; nb_started++) {
+#if defined(_WIN32)
+				threads[nb_started] = CreateThread(NULL, 0, opj_batch_thread, &job, 0, NULL);
+				if (threads[nb_started] == NULL) {
+					break;
+				}
+#else
+				if (pthread_create(&threads[nb_started], NULL, opj_batch_thread, &job) != 0) {
+					break;
+				}
+#endif
+			}
+			if (nb_started < num_threads) {
+				fprintf(stderr, "[WARNING] only %d of the %d threads could be started\n", nb_started, num_threads);
+			}
+		}
+		/* the calling thread takes the remaining files if no worker could be started */
+		if (nb_started == 0) {
+			opj_batch_worker(&job);
+		}
+		for (i = 0; i < nb_started; i++) {
+#if defined(_WIN32)
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+#else
+			pthread_join(threads[i], NULL);
+#endif
+		}
+		free(threads);
+	}
+	else
+#endif
+	{
+		opj_batch_worker(&job);
+	}
+
+#if defined(_WIN32)
+	DeleteCriticalSection(&opj_batch_mutex);
+#endif
+	stats->elapsed = opj_batch_clock() - start;
+	return stats->nb_failed;
+}
+
+void opj_batch_print_summary(const opj_batch_stats_t *stats, int num_threads,
+		const char * const stage_names[OPJ_BATCH_NB_STAGES])
+{
+	unsigned int nb_files = stats->nb_done + stats->nb_failed;
+	double elapsed = stats->elapsed > 0.0 ? stats->elapsed : 1e-9;
+	int i;
+
+	fprintf(stdout, "\n[INFO] %u file(s) processed in %.3f s with %d thread(s): %u failed, %u skipped\n",
+			nb_files, stats->elapsed, num_threads, stats->nb_failed, stats->nb_skipped);
+	fprintf(stdout, "[INFO] throughput: %.2f files/s, %.2f MB/s\n",
+			(double)nb_files / elapsed, stats->nb_bytes / (1024.0 * 1024.0) / elapsed);
+	fprintf(stdout, "[INFO] time per stage (summed over threads):");
+	for (i = 0; i < OPJ_BATCH_NB_STAGES; i++) {
+		fprintf(stdout, "%s %s %.3f s", i ? "," : "", stage_names[i], stats->stage_time[i]);
+		if (nb_files) {
+			fprintf(stdout, " (%.2f ms/file)", stats->stage_time[i] * 1000.0 / (double)nb_files);
+		}
+	}
+	fprintf(stdout, "\n");
+}
@@ -0,0 +1,95 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _OPJ_BATCH_H_
+#define _OPJ_BATCH_H_
+
+/** Number of processing stages timed for each file of a batch */
+#define OPJ_BATCH_NB_STAGES 3
+
+/** Status returned by the processing of a file */
+#define OPJ_BATCH_OK      0
+#define OPJ_BATCH_FAILED  1
+#define OPJ_BATCH_SKIPPED 2
+
+typedef struct opj_batch_stats
+{
+	/** number of files processed successfully */
+	unsigned int nb_done;
+	/** number of files that failed */
+	unsigned int nb_failed;
+	/** number of files skipped (unknown format) */
+	unsigned int nb_skipped;
+	/** size of the input files, in bytes */
+	double nb_bytes;
+	/** time spent in each processing stage, summed over all threads, in seconds */
+	double stage_time[OPJ_BATCH_NB_STAGES];
+	/** wall clock time of the whole batch, in seconds */
+	double elapsed;
+} opj_batch_stats_t;
+
+/**
+ * Processes the file imageno of a batch.
+ * Adds the input size and the stage times of the file to stats.
+ * Returns OPJ_BATCH_OK, OPJ_BATCH_FAILED or OPJ_BATCH_SKIPPED.
+ */
+typedef int (*opj_batch_process_fn)(int imageno, opj_batch_stats_t *stats, void *user_data);
+
+/** Returns a wall clock time in seconds */
+double opj_batch_clock(void);
+
+/** Returns the size of a file in bytes, 0 if it cannot be opened */
+double opj_batch_file_size(const char *filename);
+
+/**
+ * Serializes the code that is not thread safe (strtok in get_next_file,
+ * the cache of ICC transforms) between the workers of opj_batch_run.
+ */
+void opj_batch_lock(void);
+void opj_batch_unlock(void);
+
+/** Returns 1 if opj_batch_run can use more than one thread */
+int opj_batch_has_threads(void);
+
+/**
+ * Calls process_fn on the files 0 to num_images-1, spread over num_threads
+ * worker threads. The failure of a file does not stop the batch.
+ * Fills stats with the totals of all files.
+ * Returns the number of files that failed.
+ */
+unsigned int opj_batch_run(int num_images, int num_threads,
+		opj_batch_process_fn process_fn, void *user_data,
+		opj_batch_stats_t *stats);
+
+/** Prints the throughput of a batch on stdout */
+void opj_batch_print_summary(const opj_batch_stats_t *stats, int num_threads,
+		const char * const stage_names[OPJ_BATCH_NB_STAGES]);
+
+#endif /* _OPJ_BATCH_H_ */
@@ -42,6 +42,10 @@
 #include <string.h>
 #include <ctype.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifdef OPJ_HAVE_LIBTIFF
 #include <tiffio.h>
 #endif /* OPJ_HAVE_LIBTIFF */
@@ -145,6 +149,298 @@ void scale_component(opj_image_comp_t* component, OPJ_UINT32 precision)
 }
 
 
+/* -->> -->> -->> -->>
+
+  ROW PACKING
+
+ <<-- <<-- <<-- <<-- */
+
+/* Layout of the packed samples handed to the file writers */
+typedef enum {
+	PACK_8,		/* one byte per sample */
+	PACK_16BE,	/* two bytes, most significant first */
+	PACK_16LE,	/* two bytes, least significant first */
+	PACK_16NE	/* two bytes, host byte order */
+} pack_layout_t;
+
+/*
+ * Conversion of the samples of one channel: v = s + adjust is clamped to
+ * [min, max], rescaled with v = (v << ushift) + (v >> dshift) when ushift
+ * is set (before clamping if scale_first) and masked.
+ */
+typedef struct {
+	int adjust;
+	int min, max;
+	int ushift, dshift, scale_first;
+	int mask;
+} pack_channel_t;
+
+static void pack_channel_init(pack_channel_t *channel, int adjust, int min, int max, int mask)
+{
+	channel->adjust = adjust;
+	channel->min = min;
+	channel->max = max;
+	channel->ushift = channel->dshift = channel->scale_first = 0;
+	channel->mask = mask;
+}
+
+/* Packs width samples of one channel into an interleaved row of nb_channels channels */
+static void pack_channel(unsigned char *dst, const OPJ_INT32 *src, OPJ_SIZE_T width,
+                         OPJ_SIZE_T nb_channels, const pack_channel_t *channel, pack_layout_t layout)
+{
+	OPJ_SIZE_T x = 0, k;
+	OPJ_SIZE_T step = (layout == PACK_8) ? nb_channels : 2 * nb_channels;
+
+#ifdef __SSE2__
+	/* plain clamping to the packed range is done 16 or 8 samples at a time */
+	if (channel->ushift == 0 && channel->min == 0) {
+		const __m128i adjust = _mm_set1_epi32(channel->adjust);
+
+		if (layout == PACK_8 && channel->max == 255 && (channel->mask & 0xff) == 0xff) {
+			unsigned char tmp[16];
+
+			for (; x + 16 <= width; x += 16) {
+				__m128i a = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(src + x)), adjust);
+				__m128i b = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(src + x + 4)), adjust);
+				__m128i c = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(src + x + 8)), adjust);
+				__m128i d = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(src + x + 12)), adjust);
+				/* signed then unsigned saturation clamps to [0, 255] */
+				__m128i v = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+
+				if (nb_channels == 1) {
+					_mm_storeu_si128((__m128i*)(dst + x), v);
+				} else {
+					_mm_storeu_si128((__m128i*)tmp, v);
+					for (k = 0; k < 16; ++k)
+						dst[(x + k) * step] = tmp[k];
+				}
+			}
+		}
+		else if (layout != PACK_8 && channel->max == 65535 && (channel->mask & 0xffff) == 0xffff) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i upb = _mm_set1_epi32(65535);
+			const __m128i bias32 = _mm_set1_epi32(32768);
+			const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+			OPJ_UINT16 tmp[8];
+
+			for (; x + 8 <= width; x += 8) {
+				__m128i a = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(src + x)), adjust);
+				__m128i b = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(src + x + 4)), adjust);
+				__m128i over, v;
+
+				a = _mm_and_si128(a, _mm_cmpgt_epi32(a, zero));
+				over = _mm_cmpgt_epi32(a, upb);
+				a = _mm_or_si128(_mm_andnot_si128(over, a), _mm_and_si128(over, upb));
+				b = _mm_and_si128(b, _mm_cmpgt_epi32(b, zero));
+				over = _mm_cmpgt_epi32(b, upb);
+				b = _mm_or_si128(_mm_andnot_si128(over, b), _mm_and_si128(over, upb));
+				/* [0, 65535] goes through the signed 16 bit saturation biased */
+				v = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32)), bias16);
+				if (layout == PACK_16BE)
+					v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+
+				if (nb_channels == 1) {
+					_mm_storeu_si128((__m128i*)(dst + 2 * x), v);
+				} else {
+					_mm_storeu_si128((__m128i*)tmp, v);
+					for (k = 0; k < 8; ++k)
+						memcpy(dst + (x + k) * step, &tmp[k], 2);
+				}
+			}
+		}
+	}
+#endif
+
+	for (; x < width; ++x) {
+		unsigned char *d = dst + x * step;
+		int v = src[x] + channel->adjust;
+
+		if (channel->ushift && channel->scale_first)
+			v = (v << channel->ushift) + (v >> channel->dshift);
+		if (v > channel->max) v = channel->max; else if (v < channel->min) v = channel->min;
+		if (channel->ushift && !channel->scale_first)
+			v = (v << channel->ushift) + (v >> channel->dshift);
+		v &= channel->mask;
+
+		switch (layout) {
+		case PACK_8:
+			d[0] = (unsigned char)v;
+			break;
+		case PACK_16BE:
+			d[0] = (unsigned char)(v >> 8);
+			d[1] = (unsigned char)v;
+			break;
+		case PACK_16LE:
+			d[0] = (unsigned char)v;
+			d[1] = (unsigned char)(v >> 8);
+			break;
+		case PACK_16NE:
+			{
+				OPJ_UINT16 u = (OPJ_UINT16)v;
+				memcpy(d, &u, 2);
+			}
+			break;
+		}
+	}
+}
+
+/* Packs one row of nb_channels channels, rows[c] holding the samples of channel c */
+static void pack_row(unsigned char *dst, const OPJ_INT32 * const *rows, const pack_channel_t *channels,
+                     OPJ_SIZE_T nb_channels, OPJ_SIZE_T width, pack_layout_t layout)
+{
+	OPJ_SIZE_T c, size = (layout == PACK_8) ? 1 : 2;
+
+	for (c = 0; c < nb_channels; ++c)
+		pack_channel(dst + c * size, rows[c], width, nb_channels, &channels[c], layout);
+}
+
+/* Fetches row y of the components compnos[] from the source */
+static int get_rows(const convert_row_source_t *source, const int *compnos, int nb_channels,
+                    OPJ_UINT32 y, const OPJ_INT32 **rows)
+{
+	int c;
+
+	for (c = 0; c < nb_channels; ++c) {
+		rows[c] = source->get_row(source->user_data, (OPJ_UINT32)compnos[c], y);
+		if (rows[c] == NULL) {
+			fprintf(stderr, "ERROR -> failed to get row %d of component %d\n", y, compnos[c]);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Row source reading the component planes of a decoded image */
+static const OPJ_INT32* image_get_row(void *user_data, OPJ_UINT32 compno, OPJ_UINT32 y)
+{
+	const opj_image_t *image = (const opj_image_t*)user_data;
+
+	return image->comps[compno].data + (OPJ_SIZE_T)y * image->comps[compno].w;
+}
+
+static void image_row_source(opj_image_t *image, convert_row_source_t *source)
+{
+	source->get_row = image_get_row;
+	source->user_data = image;
+}
+
+
+/* -->> -->> -->> -->>
+
+  ROW READERS
+
+ <<-- <<-- <<-- <<-- */
+
+struct convert_row_reader {
+	opj_image_t *image;	/* components and reference grid, the data is left to NULL */
+	OPJ_UINT32 row;		/* rows already read */
+	/* reads nb_rows rows of every component from row on */
+	int (*read)(void *data, const opj_image_t *image, OPJ_UINT32 row, OPJ_INT32 **rows, OPJ_UINT32 nb_rows);
+	void (*close)(void *data);
+	void *data;		/* state of the file format */
+};
+
+/* Image header of a row reader: like opj_image_create without the component data */
+static opj_image_t* row_image_create(OPJ_UINT32 numcomps, opj_image_cmptparm_t *cmptparm, OPJ_COLOR_SPACE color_space)
+{
+	opj_image_t *image = opj_image_tile_create(numcomps, cmptparm, color_space);
+	OPJ_UINT32 compno;
+
+	if (image) {
+		for (compno = 0; compno < numcomps; ++compno)
+			image->comps[compno].bpp = cmptparm[compno].bpp;
+	}
+	return image;
+}
+
+static convert_row_reader_t* row_reader_create(opj_image_t *image,
+        int (*read)(void *, const opj_image_t *, OPJ_UINT32, OPJ_INT32 **, OPJ_UINT32),
+        void (*close)(void *), void *data)
+{
+	convert_row_reader_t *reader = (convert_row_reader_t*)calloc(1, sizeof(convert_row_reader_t));
+
+	if (reader == NULL) {
+		fprintf(stderr, "Not enough memory to read the image\n");
+		opj_image_destroy(image);
+		close(data);
+		return NULL;
+	}
+	reader->image = image;
+	reader->read = read;
+	reader->close = close;
+	reader->data = data;
+
+	return reader;
+}
+
+opj_image_t* row_reader_image(convert_row_reader_t *reader)
+{
+	return reader->image;
+}
+
+int row_reader_read(convert_row_reader_t *reader, OPJ_INT32 **rows, OPJ_UINT32 nb_rows)
+{
+	if (nb_rows > reader->image->comps[0].h - reader->row) {
+		fprintf(stderr, "Only %d rows are left to read\n", reader->image->comps[0].h - reader->row);
+		return 0;
+	}
+	if (!reader->read(reader->data, reader->image, reader->row, rows, nb_rows))
+		return 0;
+	reader->row += nb_rows;
+
+	return 1;
+}
+
+void row_reader_close(convert_row_reader_t *reader)
+{
+	if (reader == NULL)
+		return;
+	reader->close(reader->data);
+	opj_image_destroy(reader->image);
+	free(reader);
+}
+
+opj_image_t* row_reader_to_image(convert_row_reader_t *reader)
+{
+	opj_image_t *image;
+	OPJ_INT32 **rows;
+	OPJ_UINT32 compno;
+
+	if (reader == NULL)
+		return NULL;
+	image = reader->image;
+	rows = (OPJ_INT32**)calloc(image->numcomps, sizeof(OPJ_INT32*));
+	if (rows == NULL) {
+		row_reader_close(reader);
+		return NULL;
+	}
+	for (compno = 0; compno < image->numcomps; ++compno) {
+		opj_image_comp_t *comp = &image->comps[compno];
+
+		comp->data = (OPJ_INT32*)calloc((size_t)comp->w * comp->h, sizeof(OPJ_INT32));
+		if (comp->data == NULL) {
+			fprintf(stderr, "Unable to allocate memory for image.\n");
+			free(rows);
+			row_reader_close(reader);
+			return NULL;
+		}
+		rows[compno] = comp->data;
+	}
+	if (!row_reader_read(reader, rows, image->comps[0].h)) {
+		free(rows);
+		row_reader_close(reader);
+		return NULL;
+	}
+	free(rows);
+
+	/* the planes now belong to the caller */
+	reader->image = NULL;
+	reader->close(reader->data);
+	free(reader);
+
+	return image;
+}
+
 /* -->> -->> -->> -->>
 
   TGA IMAGE FORMAT
@@ -1849,16 +2145,174 @@ static int has_prec(int val)
     return 16;
 }
 
-opj_image_t* pnmtoimage(const char *filename, opj_cparameters_t *parameters) {
+typedef struct {
+    FILE *fp;
+    struct pnm_header header;
+    int numcomps;
+    int one;                /* binary samples on one byte */
+    unsigned char *buf;     /* binary samples of the rows being read */
+    size_t buf_size;
+    unsigned char c1, uc;   /* last bytes read, kept when a read fails */
+} pnm_reader_t;
+
+static int pnm_read_rows(void *data, const opj_image_t *image, OPJ_UINT32 row,
+                         OPJ_INT32 **rows, OPJ_UINT32 nb_rows)
+{
+    pnm_reader_t *pnm = (pnm_reader_t*)data;
+    int format = pnm->header.format;
+    int w = (int)image->comps[0].w;
+    size_t i, n = (size_t)w * nb_rows;
+    int compno;
+    (void)row;
+
+    if((format == 2) || (format == 3)) /* ascii pixmap */
+    {
+        unsigned int index;
+
+        for (i = 0; i < n; i++)
+        {
+            for(compno = 0; compno < pnm->numcomps; compno++)
+            {
+                index = 0;
+                if (fscanf(pnm->fp, "%u", &index) != 1)
+                    fprintf(stderr, "\nWARNING: fscanf return a number of element different from the expected.\n");
+
+                rows[compno][i] = (OPJ_INT32)(index * 255)/pnm->header.maxval;
+            }
+        }
+    }
+    else
+        if((format == 5)
+                || (format == 6)
+                ||((format == 7)
+                   && (   pnm->header.gray || pnm->header.graya
+                          || pnm->header.rgb || pnm->header.rgba)))/* binary pixmap */
+        {
+            size_t size = n * (size_t)pnm->numcomps * (pnm->one ? 1 : 2), got;
+            unsigned char *s;
+
+            if(size > pnm->buf_size)
+            {
+                free(pnm->buf);
+                pnm->buf = (unsigned char*)malloc(size);
+                pnm->buf_size = pnm->buf ? size : 0;
+                if(pnm->buf == NULL)
+                {
+                    fprintf(stderr, "\nError: not enough memory to read the pnm rows.\n");
+                    return 0;
+                }
+            }
+            got = fread(pnm->buf, 1, size, pnm->fp);
+            if(got < size)
+            {
+                fprintf(stderr, "\nError: fread return a number of element different from the expected.\n");
+                /* only the low byte of the last sample may be missing */
+                if(pnm->one || got + 1 != size)
+                {
+                    if( !pnm->one && (got & 1))/* and the next sample */
+                        fprintf(stderr, "\nError: fread return a number of element different from the expected.\n");
+                    return 0;
+                }
+
+                pnm->buf[got] = (got >= 2) ? pnm->buf[got - 2] : pnm->c1;
+            }
+            s = pnm->buf;
+
+            for (i = 0; i < n; i++)
+            {
+                for(compno = 0; compno < pnm->numcomps; compno++)
+                {
+                    if(pnm->one)
+                    {
+                        rows[compno][i] = *s++;
+                    }
+                    else
+                    {
+                        /* netpbm: */
+                        rows[compno][i] = ((s[0]<<8) | s[1]); s += 2;
+                    }
+                }
+            }
+            if(!pnm->one && size > 0) pnm->c1 = pnm->buf[size - 1];
+        }
+        else
+            if(format == 1) /* ascii bitmap */
+            {
+                for (i = 0; i < n; i++)
+                {
+                    unsigned int index = 0;
+
+                    if ( fscanf(pnm->fp, "%u", &index) != 1)
+                        fprintf(stderr, "\nWARNING: fscanf return a number of element different from the expected.\n");
+
+                    rows[0][i] = (index?0:255);
+                }
+            }
+            else
+                if(format == 4)
+                {
+                    int x, y, bit;
+                    unsigned char uc;
+
+                    i = 0;
+                    for(y = 0; y < (int)nb_rows; ++y)
+                    {
+                        bit = -1; uc = 0;
+
+                        for(x = 0; x < w; ++x)
+                        {
+                            if(bit == -1)
+                            {
+                                bit = 7;
+                                uc = (unsigned char)getc(pnm->fp);
+                            }
+                            rows[0][i] = (((uc>>bit) & 1)?0:255);
+                            --bit; ++i;
+                        }
+                    }
+                }
+                else
+                    if((format == 7 && pnm->header.bw)) /*MONO*/
+                    {
+                        for(compno = 1; compno < pnm->numcomps; compno++)
+                            memset(rows[compno], 0, n * sizeof(OPJ_INT32));
+
+                        for(i = 0; i < n; ++i)
+                        {
+                            if ( !fread(&pnm->uc, 1, 1, pnm->fp) )
+                                fprintf(stderr, "\nError: fread return a number of element different from the expected.\n");
+                            rows[0][i] = (pnm->uc & 1)?0:255;
+                        }
+                    }
+                    else
+                    {
+                        for(compno = 0; compno < pnm->numcomps; compno++)
+                            memset(rows[compno], 0, n * sizeof(OPJ_INT32));
+                    }
+
+    return 1;
+}
+
+static void pnm_close(void *data)
+{
+    pnm_reader_t *pnm = (pnm_reader_t*)data;
+
+    fclose(pnm->fp);
+    free(pnm->buf);
+    free(pnm);
+}
+
+convert_row_reader_t* pnmtorows(const char *filename, opj_cparameters_t *parameters) {
     int subsampling_dx = parameters->subsampling_dx;
     int subsampling_dy = parameters->subsampling_dy;
 
     FILE *fp = NULL;
-    int i, compno, numcomps, w, h, prec, format;
+    int i, numcomps, w, h, prec, format;
     OPJ_COLOR_SPACE color_space;
     opj_image_cmptparm_t cmptparm[4]; /* RGBA: max. 4 components */
     opj_image_t * image = NULL;
     struct pnm_header header_info;
+    pnm_reader_t *pnm;
 
     if((fp = fopen(filename, "rb")) == NULL)
     {
@@ -1922,7 +2376,7 @@ opj_image_t* pnmtoimage(const char *filename, opj_cparameters_t *parameters) {
         cmptparm[i].w = (OPJ_UINT32)w;
         cmptparm[i].h = (OPJ_UINT32)h;
     }
-    image = opj_image_create((OPJ_UINT32)numcomps, &cmptparm[0], color_space);
+    image = row_image_create((OPJ_UINT32)numcomps, &cmptparm[0], color_space);
 
     if(!image) { fclose(fp); return NULL; }
 
@@ -1932,131 +2386,54 @@ opj_image_t* pnmtoimage(const char *filename, opj_cparameters_t *parameters) {
     image->x1 = (OPJ_UINT32)(parameters->image_offset_x0 + (w - 1) * subsampling_dx + 1);
     image->y1 = (OPJ_UINT32)(parameters->image_offset_y0 + (h - 1) * subsampling_dy + 1);
 
-    if((format == 2) || (format == 3)) /* ascii pixmap */
-    {
-        unsigned int index;
-
-        for (i = 0; i < w * h; i++)
-        {
-            for(compno = 0; compno < numcomps; compno++)
-            {
-                index = 0;
-                if (fscanf(fp, "%u", &index) != 1)
-                    fprintf(stderr, "\nWARNING: fscanf return a number of element different from the expected.\n");
-
-                image->comps[compno].data[i] = (OPJ_INT32)(index * 255)/header_info.maxval;
-            }
-        }
-    }
-    else
-        if((format == 5)
-                || (format == 6)
-                ||((format == 7)
-                   && (   header_info.gray || header_info.graya
-                          || header_info.rgb || header_info.rgba)))/* binary pixmap */
-        {
-            unsigned char c0, c1, one;
-
-            one = (prec < 9);
-
-            for (i = 0; i < w * h; i++)
-            {
-                for(compno = 0; compno < numcomps; compno++)
-                {
-                if ( !fread(&c0, 1, 1, fp) )
-                  {
-                  fprintf(stderr, "\nError: fread return a number of element different from the expected.\n");
-                  opj_image_destroy(image);
-                  return NULL;
-                  }
-                    if(one)
-                    {
-                        image->comps[compno].data[i] = c0;
-                    }
-                    else
-                    {
-                        if ( !fread(&c1, 1, 1, fp) )
-                            fprintf(stderr, "\nError: fread return a number of element different from the expected.\n");
-                        /* netpbm: */
-                        image->comps[compno].data[i] = ((c0<<8) | c1);
-                    }
-                }
-            }
-        }
-        else
-            if(format == 1) /* ascii bitmap */
-            {
-                for (i = 0; i < w * h; i++)
-                {
-                    unsigned int index;
-
-                    if ( fscanf(fp, "%u", &index) != 1)
-                        fprintf(stderr, "\nWARNING: fscanf return a number of element different from the expected.\n");
-
-                    image->comps[0].data[i] = (index?0:255);
-                }
-            }
-            else
-                if(format == 4)
-                {
-                    int x, y, bit;
-                    unsigned char uc;
-
-                    i = 0;
-                    for(y = 0; y < h; ++y)
-                    {
-                        bit = -1; uc = 0;
+    pnm = (pnm_reader_t*)calloc(1, sizeof(pnm_reader_t));
+    if(!pnm) { opj_image_destroy(image); fclose(fp); return NULL; }
 
-                        for(x = 0; x < w; ++x)
-                        {
-                            if(bit == -1)
-                            {
-                                bit = 7;
-                                uc = (unsigned char)getc(fp);
-                            }
-                            image->comps[0].data[i] = (((uc>>bit) & 1)?0:255);
-                            --bit; ++i;
-                        }
-                    }
-                }
-                else
-                    if((format == 7 && header_info.bw)) /*MONO*/
-                    {
-                        unsigned char uc;
+    pnm->fp = fp;
+    pnm->header = header_info;
+    pnm->numcomps = numcomps;
+    pnm->one = (prec < 9);
 
-                        for(i = 0; i < w * h; ++i)
-                        {
-                            if ( !fread(&uc, 1, 1, fp) )
-                                fprintf(stderr, "\nError: fread return a number of element different from the expected.\n");
-                            image->comps[0].data[i] = (uc & 1)?0:255;
-                        }
-                    }
-    fclose(fp);
+    return row_reader_create(image, pnm_read_rows, pnm_close, pnm);
+}/* pnmtorows() */
 
-    return image;
+opj_image_t* pnmtoimage(const char *filename, opj_cparameters_t *parameters) {
+    return row_reader_to_image(pnmtorows(filename, parameters));
 }/* pnmtoimage() */
 
 int imagetopnm(opj_image_t * image, const char *outfile) 
 {
-    int *red, *green, *blue, *alpha;
-    int wr, hr, max;
-    int i;
+    return imagetopnm_rows(image, NULL, outfile);
+}
+
+int imagetopnm_rows(opj_image_t * image, const convert_row_source_t *rows,
+                    const char *outfile)
+{
+    convert_row_source_t source;
+    pack_channel_t channels[4];
+    const OPJ_INT32 *src[4];
+    int compnos[4];
+    unsigned char *row;
+    int wr, hr, max, y, c;
     unsigned int compno, ncomp;
-    int adjustR, adjustG, adjustB, adjustA;
-    int fails, two, want_gray, has_alpha, triple;
-    int prec, v;
+    int fails, two, want_gray, has_alpha, triple, nb_channels;
+    int prec;
     FILE *fdest = NULL;
+    FILE **fdests;
     const char *tmp = outfile;
     char *destname;
 
-	alpha = NULL;
-
     if((prec = (int)image->comps[0].prec) > 16)
     {
         fprintf(stderr,"%s:%d:imagetopnm\n\tprecision %d is larger than 16"
                 "\n\t: refused.\n",__FILE__,__LINE__,prec);
         return 1;
     }
+    if(rows == NULL)
+    {
+        image_row_source(image, &source);
+        rows = &source;
+    }
     two = has_alpha = 0; fails = 1;
     ncomp = image->numcomps;
 
@@ -2088,15 +2465,14 @@ int imagetopnm(opj_image_t * image, const char *outfile)
         wr = (int)image->comps[0].w; hr = (int)image->comps[0].h;
         max = (1<<prec) - 1; has_alpha = (ncomp == 4 || ncomp == 2);
 
-        red = image->comps[0].data;
+        nb_channels = 0;
+        compnos[nb_channels++] = 0;
 
         if(triple)
         {
-            green = image->comps[1].data;
-            blue = image->comps[2].data;
+            compnos[nb_channels++] = 1;
+            compnos[nb_channels++] = 2;
         }
-        else green = blue = NULL;
-
         if(has_alpha)
         {
             const char *tt = (triple?"RGB_ALPHA":"GRAYSCALE_ALPHA");
@@ -2104,92 +2480,51 @@ int imagetopnm(opj_image_t * image, const char *outfile)
             fprintf(fdest, "P7\n# OpenJPEG-%s\nWIDTH %d\nHEIGHT %d\nDEPTH %d\n"
                     "MAXVAL %d\nTUPLTYPE %s\nENDHDR\n", opj_version(),
                     wr, hr, ncomp, max, tt);
-            alpha = image->comps[ncomp - 1].data;
-            adjustA = (image->comps[ncomp - 1].sgnd ?
-                        1 << (image->comps[ncomp - 1].prec - 1) : 0);
+            compnos[nb_channels++] = (int)ncomp - 1;
         }
         else
         {
             fprintf(fdest, "P6\n# OpenJPEG-%s\n%d %d\n%d\n",
                     opj_version(), wr, hr, max);
-            adjustA = 0;
         }
-        adjustR = (image->comps[0].sgnd ? 1 << (image->comps[0].prec - 1) : 0);
-
-        if(triple)
+        /* samples up to 8 bits are written without level shift */
+        for(c = 0; c < nb_channels; ++c)
         {
-            adjustG = (image->comps[1].sgnd ? 1 << (image->comps[1].prec - 1) : 0);
-            adjustB = (image->comps[2].sgnd ? 1 << (image->comps[2].prec - 1) : 0);
+            const opj_image_comp_t *comp = &image->comps[compnos[c]];
+
+            pack_channel_init(&channels[c],
+                              (two && comp->sgnd) ? 1 << (comp->prec - 1) : 0,
+                              0, two ? 65535 : 255, -1);
         }
-        else adjustG = adjustB = 0;
+        row = (unsigned char*)malloc((size_t)wr * (size_t)nb_channels * (two ? 2 : 1));
 
-        for(i = 0; i < wr * hr; ++i)
+        if(row == NULL)
         {
-            if(two)
-            {
-                v = *red + adjustR; ++red;
-if(v > 65535) v = 65535; else if(v < 0) v = 0;
-
-                /* netpbm: */
-                fprintf(fdest, "%c%c",(unsigned char)(v>>8), (unsigned char)v);
-
-                if(triple)
-                {
-                    v = *green + adjustG; ++green;
-if(v > 65535) v = 65535; else if(v < 0) v = 0;
-
-                    /* netpbm: */
-                    fprintf(fdest, "%c%c",(unsigned char)(v>>8), (unsigned char)v);
-
-                    v =  *blue + adjustB; ++blue;
-if(v > 65535) v = 65535; else if(v < 0) v = 0;
-
-                    /* netpbm: */
-                    fprintf(fdest, "%c%c",(unsigned char)(v>>8), (unsigned char)v);
-
-                }/* if(triple) */
-
-                if(has_alpha)
-                {
-                    v = *alpha + adjustA; ++alpha;
-		if(v > 65535) v = 65535; else if(v < 0) v = 0;
-
-                    /* netpbm: */
-                    fprintf(fdest, "%c%c",(unsigned char)(v>>8), (unsigned char)v);
-                }
-                continue;
-
-            }	/* if(two) */
-
-            /* prec <= 8: */
-	v = *red++;
-	if(v > 255) v = 255; else if(v < 0) v = 0;
-
-	fprintf(fdest, "%c", (unsigned char)v);
-            if(triple)
- {
-	v = *green++;
-	if(v > 255) v = 255; else if(v < 0) v = 0;
+            fprintf(stderr, "ERROR -> out of memory writing %s\n", outfile);
+            fclose(fdest); return fails;
+        }
+        for(y = 0; y < hr; ++y)
+        {
+            size_t size = (size_t)wr * (size_t)nb_channels * (two ? 2 : 1);
 
-	fprintf(fdest, "%c", (unsigned char)v);
-	v = *blue++;
-	if(v > 255) v = 255; else if(v < 0) v = 0;
+            if(!get_rows(rows, compnos, nb_channels, (OPJ_UINT32)y, src)) break;
 
-	fprintf(fdest, "%c", (unsigned char)v);
- }
-            if(has_alpha)
- {
-	v = *alpha++;
-	if(v > 255) v = 255; else if(v < 0) v = 0;
+            /* netpbm: */
+            pack_row(row, src, channels, (OPJ_SIZE_T)nb_channels, (OPJ_SIZE_T)wr,
+                     two ? PACK_16BE : PACK_8);
 
-	fprintf(fdest, "%c", (unsigned char)v);
- }
-        }	/* for(i */
+            if(fwrite(row, 1, size, fdest) != size)
+            {
+                fprintf(stderr, "ERROR -> failed to write %s\n", outfile);
+                break;
+            }
+        }
+        if(y == hr) fails = 0;
 
-        fclose(fdest); return 0;
+        free(row); fclose(fdest); return fails;
     }
 
-    /* YUV or MONO: */
+    /* YUV or MONO: one file per component, filled row after row */
 
     if (image->numcomps > ncomp)
     {
@@ -2197,7 +2532,15 @@ if(v > 65535) v = 65535; else if(v < 0) v = 0;
         fprintf(stderr,"           is written to the file\n");
     }
     destname = (char*)malloc(strlen(outfile) + 8);
+    fdests = (FILE**)calloc(ncomp, sizeof(FILE*));
+    hr = wr = 0;
 
+    if(destname == NULL || fdests == NULL)
+    {
+        fprintf(stderr, "ERROR -> out of memory writing %s\n", outfile);
+        free(destname); free(fdests);
+        return fails;
+    }
     for (compno = 0; compno < ncomp; compno++)
     {
     if (ncomp > 1)
@@ -2216,55 +2559,63 @@ if(v > 65535) v = 65535; else if(v < 0) v = 0;
         if (!fdest)
         {
             fprintf(stderr, "ERROR -> failed to open %s for writing\n", destname);
-            free(destname);
-            return 1;
+            goto fin;
         }
-        wr = (int)image->comps[compno].w; hr = (int)image->comps[compno].h;
+        fdests[compno] = fdest;
         prec = (int)image->comps[compno].prec;
         max = (1<<prec) - 1;
 
         fprintf(fdest, "P5\n#OpenJPEG-%s\n%d %d\n%d\n",
-                opj_version(), wr, hr, max);
+                opj_version(), image->comps[compno].w, image->comps[compno].h, max);
 
-        red = image->comps[compno].data;
-        adjustR =
-                (image->comps[compno].sgnd ? 1 << (image->comps[compno].prec - 1) : 0);
+        if((int)image->comps[compno].w > wr) wr = (int)image->comps[compno].w;
+        if((int)image->comps[compno].h > hr) hr = (int)image->comps[compno].h;
+    }
+    row = (unsigned char*)malloc((size_t)wr * 2);
 
-        if(prec > 8)
+    if(row == NULL)
+    {
+        fprintf(stderr, "ERROR -> out of memory writing %s\n", outfile);
+        goto fin;
+    }
+    for(y = 0; y < hr; ++y)
+    {
+        for (compno = 0; compno < ncomp; compno++)
         {
-            for (i = 0; i < wr * hr; i++)
-            {
-                v = *red + adjustR; ++red;
-if(v > 65535) v = 65535; else if(v < 0) v = 0;
+            const opj_image_comp_t *comp = &image->comps[compno];
+            int cno = (int)compno;
+            two = (comp->prec > 8);
 
-                /* netpbm: */
-                fprintf(fdest, "%c%c",(unsigned char)(v>>8), (unsigned char)v);
+            if(y >= (int)comp->h) continue;
 
-                if(has_alpha)
-                {
-                    v = *alpha++;
-if(v > 65535) v = 65535; else if(v < 0) v = 0;
+            if(!get_rows(rows, &cno, 1, (OPJ_UINT32)y, src)) break;
 
-                    /* netpbm: */
-                    fprintf(fdest, "%c%c",(unsigned char)(v>>8), (unsigned char)v);
-                }
-            }/* for(i */
-        }
-        else /* prec <= 8 */
-        {
-            for(i = 0; i < wr * hr; ++i)
-            {
-	v = *red + adjustR; ++red;
-	if(v > 255) v = 255; else if(v < 0) v = 0;
+            pack_channel_init(&channels[0], comp->sgnd ? 1 << (comp->prec - 1) : 0,
+                              0, two ? 65535 : 255, -1);
+            /* netpbm: */
+            pack_row(row, src, channels, 1, comp->w, two ? PACK_16BE : PACK_8);
 
-	 fprintf(fdest, "%c", (unsigned char)v);
+            if(fwrite(row, 1, (size_t)comp->w * (two ? 2 : 1), fdests[compno])
+                    != (size_t)comp->w * (two ? 2 : 1))
+            {
+                fprintf(stderr, "ERROR -> failed to write %s\n", outfile);
+                break;
             }
         }
-        fclose(fdest);
-    } /* for (compno */
+        if(compno < ncomp) break;
+    }
+    if(y == hr) fails = 0;
+
+    free(row);
+fin:
+    for (compno = 0; compno < ncomp; compno++)
+    {
+        if(fdests[compno]) fclose(fdests[compno]);
+    }
+    free(fdests);
     free(destname);
 
-    return 0;
+    return fails;
 }/* imagetopnm() */
 
 #ifdef OPJ_HAVE_LIBTIFF
@@ -2276,9 +2627,19 @@ if(v > 65535) v = 65535; else if(v < 0) v = 0;
 
 int imagetotif(opj_image_t * image, const char *outfile) 
 {
-    int width, height, imgsize;
-    int bps,index,adjust, sgnd;
-    int ushift, dshift, has_alpha, force16;
+    return imagetotif_rows(image, NULL, outfile);
+}
+
+int imagetotif_rows(opj_image_t * image, const convert_row_source_t *rows,
+                    const char *outfile)
+{
+    convert_row_source_t source;
+    pack_channel_t channels[4];
+    const OPJ_INT32 *src[4];
+    int compnos[4];
+    int width, height, c;
+    int bps, adjust, sgnd, photometric, fails;
+    int ushift, dshift, has_alpha, force16, nb_channels;
     TIFF *tif;
     tdata_t buf;
     tstrip_t strip;
@@ -2307,6 +2668,11 @@ int imagetotif(opj_image_t * image, const char *outfile)
         fprintf(stderr, "imagetotif:failed to open %s for writing\n", outfile);
         return 1;
     }
+    if(rows == NULL)
+    {
+        image_row_source(image, &source);
+        rows = &source;
+    }
     sgnd = (int)image->comps[0].sgnd;
     adjust = sgnd ? 1 << (image->comps[0].prec - 1) : 0;
 
@@ -2319,375 +2685,217 @@ int imagetotif(opj_image_t * image, const char *outfile)
             && image->comps[1].prec == image->comps[2].prec)
     {
         has_alpha = (image->numcomps == 4);
+        nb_channels = 3 + has_alpha;
+        photometric = PHOTOMETRIC_RGB;
+    }
+    else if(image->numcomps == 1 /* GRAY */
+            || (   image->numcomps == 2 /* GRAY_ALPHA */
+                   && image->comps[0].dx == image->comps[1].dx
+                   && image->comps[0].dy == image->comps[1].dy
+                   && image->comps[0].prec == image->comps[1].prec))
+    {
+        has_alpha = (image->numcomps == 2);
+        nb_channels = 1 + has_alpha;
+        photometric = PHOTOMETRIC_MINISBLACK;
+    }
+    else
+    {
+        TIFFClose(tif);
 
-        width   = (int)image->comps[0].w;
-        height  = (int)image->comps[0].h;
-        imgsize = width * height ;
-
-        TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
-        TIFFSetField(tif, TIFFTAG_IMAGELENGTH, height);
-        TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3 + has_alpha);
-        TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, bps);
-        TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-        TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-        TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-        TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1);
-        strip_size = TIFFStripSize(tif);
-        buf = _TIFFmalloc(strip_size);
-        index=0;
-
-        for(strip = 0; strip < TIFFNumberOfStrips(tif); strip++)
-        {
-            unsigned char *dat8;
-            tsize_t i, ssize, last_i = 0;
-            int step, restx;
-            ssize = TIFFStripSize(tif);
-            dat8 = (unsigned char*)buf;
-
-            if(bps == 8)
-            {
-                step = 3 + has_alpha;
-                restx = step - 1;
-
-                for(i=0; i < ssize - restx; i += step)
-                {
-                    int r, g, b, a = 0;
-
-                    if(index < imgsize)
-                    {
-                        r = image->comps[0].data[index];
-                        g = image->comps[1].data[index];
-                        b = image->comps[2].data[index];
-                        if(has_alpha) a = image->comps[3].data[index];
-
-                        if(sgnd)
-                        {
-                            r += adjust;
-                            g += adjust;
-                            b += adjust;
-                            if(has_alpha) a += adjust;
-                        }
-		if(r > 255) r = 255; else if(r < 0) r = 0;
-                        dat8[i+0] = (unsigned char)r ;
-		if(g > 255) g = 255; else if(g < 0) g = 0;
-                        dat8[i+1] = (unsigned char)g ;
-		if(b > 255) b = 255; else if(b < 0) b = 0;
-                        dat8[i+2] = (unsigned char)b ;
-		if(has_alpha) 
-	 {
-		if(a > 255) a = 255; else if(a < 0) a = 0;
-		dat8[i+3] = (unsigned char)a;
-	 }
-
-                        index++;
-                        last_i = i + step;
-                    }
-                    else
-                        break;
-                }/*for(i = 0;)*/
-
-                if(last_i < ssize)
-                {
-                    for(i = last_i; i < ssize; i += step)
-                    {
-                        int r, g, b, a = 0;
-
-                        if(index < imgsize)
-                        {
-                            r = image->comps[0].data[index];
-                            g = image->comps[1].data[index];
-                            b = image->comps[2].data[index];
-                            if(has_alpha) a = image->comps[3].data[index];
-
-                            if(sgnd)
-                            {
-                                r += adjust;
-                                g += adjust;
-                                b += adjust;
-                                if(has_alpha) a += adjust;
-                            }
-		if(r > 255) r = 255; else if(r < 0) r = 0;
-		if(g > 255) g = 255; else if(g < 0) g = 0;
-		if(b > 255) b = 255; else if(b < 0) b = 0;
-
-                            dat8[i+0] = (unsigned char)r ;
-                            if(i+1 < ssize) dat8[i+1] = (unsigned char)g ;  else break;
-                            if(i+2 < ssize) dat8[i+2] = (unsigned char)b ;  else break;
-                            if(has_alpha)
-                            {
-		if(a > 255) a = 255; else if(a < 0) a = 0;
+        fprintf(stderr,"imagetotif: Bad color format.\n"
+                "\tOnly RGB(A) and GRAY(A) has been implemented\n");
+        fprintf(stderr,"\tFOUND: numcomps(%d)\n\tAborting\n",
+                image->numcomps);
 
-                                if(i+3 < ssize) dat8[i+3] = (unsigned char)a ;  else break;
-                            }
-                            index++;
-                        }
-                        else
-                            break;
-                    }/*for(i)*/
-                }/*if(last_i < ssize)*/
+        return 1;
+    }
 
-            }	/*if(bps == 8)*/
-            else
-                if(bps == 16)
-                {
-                    step = 6 + has_alpha + has_alpha;
-                    restx = step - 1;
+    width   = (int)image->comps[0].w;
+    height  = (int)image->comps[0].h;
 
-                    for(i = 0; i < ssize - restx ; i += step)
-                    {
-                        int r, g, b, a = 0;
+    /* Set tags */
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, height);
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, nb_channels);
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, bps);
+    TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, photometric);
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1);
 
-                        if(index < imgsize)
-                        {
-                            r = image->comps[0].data[index];
-                            g = image->comps[1].data[index];
-                            b = image->comps[2].data[index];
-                            if(has_alpha) a = image->comps[3].data[index];
+    /* All the channels share the level shift of the first component,
+     * 16 bit samples are stored least significant byte first. */
+    for(c = 0; c < nb_channels; ++c)
+    {
+        compnos[c] = c;
+        pack_channel_init(&channels[c], adjust, 0, (bps == 8) ? 255 : 65535, -1);
+        channels[c].ushift = ushift;
+        channels[c].dshift = dshift;
+        channels[c].scale_first = force16;
+    }
 
-                            if(sgnd)
-                            {
-                                r += adjust;
-                                g += adjust;
-                                b += adjust;
-                                if(has_alpha) a += adjust;
-                            }
-                            if(force16)
-                            {
-                                r = (r<<ushift) + (r>>dshift);
-                                g = (g<<ushift) + (g>>dshift);
-                                b = (b<<ushift) + (b>>dshift);
-                                if(has_alpha) a = (a<<ushift) + (a>>dshift);
-                            }
-		if(r > 65535) r = 65535; else if(r < 0) r = 0;
-		if(g > 65535) g = 65535; else if(g < 0) g = 0;
-		if(b > 65535) b = 65535; else if(b < 0) b = 0;
-
-                            dat8[i+0] =  (unsigned char)r;/*LSB*/
-                            dat8[i+1] = (unsigned char)(r >> 8);/*MSB*/
-                            dat8[i+2] =  (unsigned char)g;
-                            dat8[i+3] = (unsigned char)(g >> 8);
-                            dat8[i+4] =  (unsigned char)b;
-                            dat8[i+5] = (unsigned char)(b >> 8);
-                            if(has_alpha)
-                            {
-		if(a > 65535) a = 65535; else if(a < 0) a = 0;
-                                dat8[i+6] =  (unsigned char)a;
-                                dat8[i+7] = (unsigned char)(a >> 8);
-                            }
-                            index++;
-                            last_i = i + step;
-                        }
-                        else
-                            break;
-                    }/*for(i = 0;)*/
+    /* Get a buffer for the data: one strip is one row */
+    strip_size = TIFFStripSize(tif);
+    buf = _TIFFmalloc(strip_size);
+    fails = (buf == NULL);
 
-                    if(last_i < ssize)
-                    {
-                        for(i = last_i ; i < ssize ; i += step)
-                        {
-                            int r, g, b, a = 0;
+    for(strip = 0; !fails && strip < TIFFNumberOfStrips(tif); strip++)
+    {
+        if(!get_rows(rows, compnos, nb_channels, (OPJ_UINT32)strip, src))
+        {
+            fails = 1; break;
+        }
+        pack_row((unsigned char*)buf, src, channels, (OPJ_SIZE_T)nb_channels,
+                 (OPJ_SIZE_T)width, (bps == 8) ? PACK_8 : PACK_16LE);
 
-                            if(index < imgsize)
-                            {
-                                r = image->comps[0].data[index];
-                                g = image->comps[1].data[index];
-                                b = image->comps[2].data[index];
-                                if(has_alpha) a = image->comps[3].data[index];
-
-                                if(sgnd)
-                                {
-                                    r += adjust;
-                                    g += adjust;
-                                    b += adjust;
-                                    if(has_alpha) a += adjust;
-                                }
-                                if(force16)
-                                {
-                                    r = (r<<ushift) + (r>>dshift);
-                                    g = (g<<ushift) + (g>>dshift);
-                                    b = (b<<ushift) + (b>>dshift);
-                                    if(has_alpha) a = (a<<ushift) + (a>>dshift);
-                                }
-		if(r > 65535) r = 65535; else if(r < 0) r = 0;
-		if(g > 65535) g = 65535; else if(g < 0) g = 0;
-		if(b > 65535) b = 65535; else if(b < 0) b = 0;
-
-                                dat8[i+0] = (unsigned char) r;/*LSB*/
-                                if(i+1 < ssize) dat8[i+1] = (unsigned char)(r >> 8);else break;/*MSB*/
-                                if(i+2 < ssize) dat8[i+2] = (unsigned char) g;      else break;
-                                if(i+3 < ssize) dat8[i+3] = (unsigned char)(g >> 8);else break;
-                                if(i+4 < ssize) dat8[i+4] = (unsigned char) b;      else break;
-                                if(i+5 < ssize) dat8[i+5] = (unsigned char)(b >> 8);else break;
-
-                                if(has_alpha)
-                                {
-		if(a > 65535) a = 65535; else if(a < 0) a = 0;
-                                    if(i+6 < ssize) dat8[i+6] = (unsigned char)a; else break;
-                                    if(i+7 < ssize) dat8[i+7] = (unsigned char)(a >> 8); else break;
-                                }
-                                index++;
-                            }
-                            else
-                                break;
-                        }/*for(i)*/
-                    }/*if(last_i < ssize)*/
+        (void)TIFFWriteEncodedStrip(tif, strip, (void*)buf, strip_size);
+    }/*for(strip = 0; )*/
 
-                }/*if(bps == 16)*/
-            (void)TIFFWriteEncodedStrip(tif, strip, (void*)buf, strip_size);
-        }/*for(strip = 0; )*/
+    if(buf) _TIFFfree(buf);
+    TIFFClose(tif);
 
-        _TIFFfree((void*)buf);
-        TIFFClose(tif);
+    return fails;
+}/* imagetotif() */
 
-        return 0;
-    }/*RGB(A)*/
+typedef struct {
+    TIFF *tif;
+    tdata_t buf;
+    tsize_t strip_size, ssize, i;   /* size of the strips, of the current one, read position */
+    tstrip_t strip;                 /* next strip to read */
+    int bps, numcomps, has_alpha, is_rgb, is_cinema, step;
+    int has_pending;                /* second pixel of a 12 bit pair beyond the rows read */
+    OPJ_INT32 pending[3];
+} tif_reader_t;
+
+/* Stores the pixel of 8 or 16 bit samples at dat8 in the rows */
+static void tif_read_pixel(const tif_reader_t *tr, const unsigned char *dat8, OPJ_INT32 **rows, size_t k)
+{
+    int compno, nb = tr->is_rgb ? 3 + tr->has_alpha : 1 + tr->has_alpha;
 
-    if(image->numcomps == 1 /* GRAY */
-            || (   image->numcomps == 2 /* GRAY_ALPHA */
-                   && image->comps[0].dx == image->comps[1].dx
-                   && image->comps[0].dy == image->comps[1].dy
-                   && image->comps[0].prec == image->comps[1].prec))
+    if(tr->bps == 16)
     {
-        int step;
-
-        has_alpha = (image->numcomps == 2);
-
-        width   = (int)image->comps[0].w;
-        height  = (int)image->comps[0].h;
-        imgsize = width * height;
-
-        /* Set tags */
-        TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
-        TIFFSetField(tif, TIFFTAG_IMAGELENGTH, height);
-        TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1 + has_alpha);
-        TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, bps);
-        TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-        TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-        TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
-        TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1);
-
-        /* Get a buffer for the data */
-        strip_size = TIFFStripSize(tif);
-        buf = _TIFFmalloc(strip_size);
-        index = 0;
-
-        for(strip = 0; strip < TIFFNumberOfStrips(tif); strip++)
+        for(compno = 0; compno < nb; compno++)
         {
-            unsigned char *dat8;
-            tsize_t i, ssize = TIFFStripSize(tif);
-            dat8 = (unsigned char*)buf;
-
-            if(bps == 8)
+            rows[compno][k] = ( dat8[2 * compno + 1] << 8 ) | dat8[2 * compno];
+            if(tr->is_rgb && tr->is_cinema)
+            {
+                /* Rounding 16 to 12 bits */
+                rows[compno][k] = (rows[compno][k] + 0x08) >> 4 ;
+            }
+        }
+    }
+    else
+    {
+        for(compno = 0; compno < nb; compno++)
+        {
+            rows[compno][k] = dat8[compno];
+            if(tr->is_rgb && tr->is_cinema)
             {
-                step = 1 + has_alpha;
+                /* Rounding 8 to 12 bits */
+                rows[compno][k] = rows[compno][k] << 4 ;
+            }
+        }
+    }
+}
 
-                for(i=0; i < ssize; i += step)
-                {
-                    if(index < imgsize)
-                    {
-                        int r, a = 0;
+static int tif_read_rows(void *data, const opj_image_t *image, OPJ_UINT32 row,
+                         OPJ_INT32 **rows, OPJ_UINT32 nb_rows)
+{
+    tif_reader_t *tr = (tif_reader_t*)data;
+    size_t w = image->comps[0].w, n = w * nb_rows, k = 0;
+    size_t imgsize = w * image->comps[0].h, index = (size_t)row * w;
+    int compno;
 
-                        r = image->comps[0].data[index];
-                        if(has_alpha) a = image->comps[1].data[index];
+    /* Read the Image components: the pixels follow each other from strip to strip */
+    if(tr->has_pending && n > 0)
+    {
+        for(compno = 0; compno < 3; compno++)
+            rows[compno][0] = tr->pending[compno];
+        tr->has_pending = 0;
+        k = 1;
+    }
+    while(k < n && (tr->bps != 12 || tr->is_rgb))
+    {
+        unsigned char *dat8 = (unsigned char*)tr->buf + tr->i;
 
-                        if(sgnd)
-                        {
-                            r += adjust;
-                            if(has_alpha) a += adjust;
-                        }
-		if(r > 255) r = 255; else if(r < 0) r = 0;
-                        dat8[i+0] = (unsigned char)r;
+        if(tr->i >= tr->ssize)
+        {
+            if(tr->strip >= TIFFNumberOfStrips(tr->tif)) break;
 
-		if(has_alpha) 
-	 {
-		if(a > 255) a = 255; else if(a < 0) a = 0;
-		dat8[i+1] = (unsigned char)a;
-                    }
-		index++;
-	  }
-                    else
-                        break;
-	   }/*for(i )*/
-            }/*if(bps == 8*/
-            else
-                if(bps == 16)
-                {
-                    step = 2 + has_alpha + has_alpha;
+            tr->ssize = TIFFReadEncodedStrip(tr->tif, tr->strip++, tr->buf, tr->strip_size);
+            tr->i = 0;
+            continue;
+        }
+        if(tr->bps == 12)/* CINEMA file */
+        {
+            OPJ_INT32 second[3];
 
-                    for(i=0; i < ssize; i += step)
-                    {
-                        if(index < imgsize)
-                        {
-                            int r, a = 0;
+            if(index + k + 1 >= imgsize) break;
 
-                            r = image->comps[0].data[index];
-                            if(has_alpha) a = image->comps[1].data[index];
+            rows[0][k]   = ( dat8[0]<<4 )        |(dat8[1]>>4);
+            rows[1][k]   = ((dat8[1]& 0x0f)<< 8) | dat8[2];
+            rows[2][k]   = ( dat8[3]<<4)         |(dat8[4]>>4);
+            second[0]    = ((dat8[4]& 0x0f)<< 8) | dat8[5];
+            second[1]    = ( dat8[6] <<4)        |(dat8[7]>>4);
+            second[2]    = ((dat8[7]& 0x0f)<< 8) | dat8[8];
 
-                            if(sgnd)
-                            {
-                                r += adjust;
-                                if(has_alpha) a += adjust;
-                            }
-                            if(force16)
-                            {
-                                r = (r<<ushift) + (r>>dshift);
-                                if(has_alpha) a = (a<<ushift) + (a>>dshift);
-                            }
-		if(r > 65535) r = 65535; else if(r < 0) r = 0;
-                            dat8[i+0] = (unsigned char)r;/*LSB*/
-                            dat8[i+1] = (unsigned char)(r >> 8);/*MSB*/
-                            if(has_alpha)
-                            {
-		if(a > 65535) a = 65535; else if(a < 0) a = 0;
-                                dat8[i+2] = (unsigned char)a;
-                                dat8[i+3] = (unsigned char)(a >> 8);
-                            }
-                            index++;
-                        }/*if(index < imgsize)*/
-                        else
-                            break;
-                    }/*for(i )*/
-                }
-            (void)TIFFWriteEncodedStrip(tif, strip, (void*)buf, strip_size);
-        }/*for(strip*/
+            if(k + 1 < n)
+            {
+                for(compno = 0; compno < 3; compno++)
+                    rows[compno][k + 1] = second[compno];
+            }
+            else
+            {
+                memcpy(tr->pending, second, sizeof(second));
+                tr->has_pending = 1;
+            }
+            k += 2;
+            tr->i += 9;
+            continue;
+        }
+        tif_read_pixel(tr, dat8, rows, k);
+        k++;
+        tr->i += tr->step;
+    }
 
-        _TIFFfree(buf);
-        TIFFClose(tif);
+    /* samples beyond the strips are left to 0 */
+    for(compno = 0; compno < tr->numcomps; compno++)
+    {
+        size_t from = (tr->bps == 12 && compno > 2) ? 0 : k;
 
-        return 0;
+        if(from < n)
+            memset(rows[compno] + from, 0, (n - from) * sizeof(OPJ_INT32));
     }
+    return 1;
+}
 
-    TIFFClose(tif);
-
-    fprintf(stderr,"imagetotif: Bad color format.\n"
-            "\tOnly RGB(A) and GRAY(A) has been implemented\n");
-    fprintf(stderr,"\tFOUND: numcomps(%d)\n\tAborting\n",
-            image->numcomps);
+static void tif_close(void *data)
+{
+    tif_reader_t *tr = (tif_reader_t*)data;
 
-    return 1;
-}/* imagetotif() */
+    if(tr->buf) _TIFFfree(tr->buf);
+    TIFFClose(tr->tif);
+    free(tr);
+}
 
 /*
  * libtiff/tif_getimage.c : 1,2,4,8,16 bitspersample accepted
  * CINEMA                 : 12 bit precision
 */
-opj_image_t* tiftoimage(const char *filename, opj_cparameters_t *parameters)
+convert_row_reader_t* tiftorows(const char *filename, opj_cparameters_t *parameters)
 {
     int subsampling_dx = parameters->subsampling_dx;
     int subsampling_dy = parameters->subsampling_dy;
     TIFF *tif;
-    tdata_t buf;
-    tstrip_t strip;
-    tsize_t strip_size;
-    int j, numcomps, w, h,index;
+    int j, numcomps, w, h;
     OPJ_COLOR_SPACE color_space;
     opj_image_cmptparm_t cmptparm[4]; /* RGBA */
     opj_image_t *image = NULL;
-    int imgsize = 0;
     int has_alpha = 0;
     unsigned short tiBps, tiPhoto, tiSf, tiSpp, tiPC;
     unsigned int tiWidth, tiHeight;
     OPJ_BOOL is_cinema = OPJ_IS_CINEMA(parameters->rsiz);
+    tif_reader_t *tr;
 
     tif = TIFFOpen(filename, "r");
 
@@ -2772,279 +2980,185 @@ opj_image_t* tiftoimage(const char *filename, opj_cparameters_t *parameters)
     {
         numcomps = 3 + has_alpha;
         color_space = OPJ_CLRSPC_SRGB;
-
-        /*#define USETILEMODE*/
-        for(j = 0; j < numcomps; j++)
+    }
+    else /* GRAY(A) */
+    {
+        numcomps = 1 + has_alpha;
+        color_space = OPJ_CLRSPC_GRAY;
+    }
+    for(j = 0; j < numcomps; j++)
+    {
+        if(tiPhoto == PHOTOMETRIC_RGB && is_cinema)
         {
-            if(is_cinema)
-            {
-                cmptparm[j].prec = 12;
-                cmptparm[j].bpp = 12;
-            }
-            else
-            {
-                cmptparm[j].prec = tiBps;
-                cmptparm[j].bpp = tiBps;
-            }
-            cmptparm[j].dx = (OPJ_UINT32)subsampling_dx;
-            cmptparm[j].dy = (OPJ_UINT32)subsampling_dy;
-            cmptparm[j].w = (OPJ_UINT32)w;
-            cmptparm[j].h = (OPJ_UINT32)h;
-#ifdef USETILEMODE
-            cmptparm[j].x0 = 0;
-            cmptparm[j].y0 = 0;
-#endif
+            cmptparm[j].prec = 12;
+            cmptparm[j].bpp = 12;
         }
-
-#ifdef USETILEMODE
-        image = opj_image_tile_create(numcomps,&cmptparm[0],color_space);
-#else
-        image = opj_image_create((OPJ_UINT32)numcomps, &cmptparm[0], color_space);
-#endif
-
-        if(!image)
+        else
         {
-            TIFFClose(tif);
-            return NULL;
+            cmptparm[j].prec = tiBps;
+            cmptparm[j].bpp = tiBps;
         }
-        /* set image offset and reference grid
-*/
-        image->x0 = (OPJ_UINT32)parameters->image_offset_x0;
-        image->y0 = (OPJ_UINT32)parameters->image_offset_y0;
-        image->x1 =	!image->x0 ? (OPJ_UINT32)(w - 1) * (OPJ_UINT32)subsampling_dx + 1 :
-                                 image->x0 + (OPJ_UINT32)(w - 1) * (OPJ_UINT32)subsampling_dx + 1;
-        image->y1 =	!image->y0 ? (OPJ_UINT32)(h - 1) * (OPJ_UINT32)subsampling_dy + 1 :
-                                 image->y0 + (OPJ_UINT32)(h - 1) * (OPJ_UINT32)subsampling_dy + 1;
-
-        buf = _TIFFmalloc(TIFFStripSize(tif));
-
-        strip_size=TIFFStripSize(tif);
-        index = 0;
-        imgsize = (int)(image->comps[0].w * image->comps[0].h);
-        /* Read the Image components
-*/
-        for(strip = 0; strip < TIFFNumberOfStrips(tif); strip++)
-        {
-            unsigned char *dat8;
-            int step;
-            tsize_t i, ssize;
-            ssize = TIFFReadEncodedStrip(tif, strip, buf, strip_size);
-            dat8 = (unsigned char*)buf;
-
-            if(tiBps == 16)
-            {
-                step = 6 + has_alpha + has_alpha;
-
-                for(i = 0; i < ssize; i += step)
-                {
-                    if(index < imgsize)
-                    {
-                        image->comps[0].data[index] = ( dat8[i+1] << 8 ) | dat8[i+0]; /* R */
-                        image->comps[1].data[index] = ( dat8[i+3] << 8 ) | dat8[i+2]; /* G */
-                        image->comps[2].data[index] = ( dat8[i+5] << 8 ) | dat8[i+4]; /* B */
-                        if(has_alpha)
-                            image->comps[3].data[index] = ( dat8[i+7] << 8 ) | dat8[i+6];
-
-                        if(is_cinema)
-                        {
-                            /* Rounding 16 to 12 bits
-*/
-                            image->comps[0].data[index] =
-                                    (image->comps[0].data[index] + 0x08) >> 4 ;
-                            image->comps[1].data[index] =
-                                    (image->comps[1].data[index] + 0x08) >> 4 ;
-                            image->comps[2].data[index] =
-                                    (image->comps[2].data[index] + 0x08) >> 4 ;
-                            if(has_alpha)
-                                image->comps[3].data[index] =
-                                        (image->comps[3].data[index] + 0x08) >> 4 ;
-                        }
-                        index++;
-                    }
-                    else
-                        break;
-                }/*for(i = 0)*/
-            }/*if(tiBps == 16)*/
-            else
-                if(tiBps == 8)
-                {
-                    step = 3 + has_alpha;
+        cmptparm[j].dx = (OPJ_UINT32)subsampling_dx;
+        cmptparm[j].dy = (OPJ_UINT32)subsampling_dy;
+        cmptparm[j].w = (OPJ_UINT32)w;
+        cmptparm[j].h = (OPJ_UINT32)h;
+    }
 
-                    for(i = 0; i < ssize; i += step)
-                    {
-                        if(index < imgsize)
-                        {
-#ifndef USETILEMODE
-                            image->comps[0].data[index] = dat8[i+0];/* R */
-                            image->comps[1].data[index] = dat8[i+1];/* G */
-                            image->comps[2].data[index] = dat8[i+2];/* B */
-                            if(has_alpha)
-                                image->comps[3].data[index] = dat8[i+3];
-#endif
+    image = row_image_create((OPJ_UINT32)numcomps, &cmptparm[0], color_space);
 
-                            if(is_cinema)
-                            {
-                                /* Rounding 8 to 12 bits
+    if(!image)
+    {
+        TIFFClose(tif);
+        return NULL;
+    }
+    /* set image offset and reference grid
 */
-#ifndef USETILEMODE
-                                image->comps[0].data[index] = image->comps[0].data[index] << 4 ;
-                                image->comps[1].data[index] = image->comps[1].data[index] << 4 ;
-                                image->comps[2].data[index] = image->comps[2].data[index] << 4 ;
-                                if(has_alpha)
-                                    image->comps[3].data[index] = image->comps[3].data[index] << 4 ;
-#endif
-                            }
-                            index++;
-                        }/*if(index*/
-                        else
-                            break;
-                    }/*for(i )*/
-                }/*if( tiBps == 8)*/
-                else
-                    if(tiBps == 12)/* CINEMA file */
-                    {
-                        step = 9;
-
-                        for(i = 0; i < ssize; i += step)
-                        {
-                            if((index < imgsize)&(index+1 < imgsize))
-                            {
-                                image->comps[0].data[index]   = ( dat8[i+0]<<4 )        |(dat8[i+1]>>4);
-                                image->comps[1].data[index]   = ((dat8[i+1]& 0x0f)<< 8) | dat8[i+2];
-
-                                image->comps[2].data[index]   = ( dat8[i+3]<<4)         |(dat8[i+4]>>4);
-                                image->comps[0].data[index+1] = ((dat8[i+4]& 0x0f)<< 8) | dat8[i+5];
-
-                                image->comps[1].data[index+1] = ( dat8[i+6] <<4)        |(dat8[i+7]>>4);
-                                image->comps[2].data[index+1] = ((dat8[i+7]& 0x0f)<< 8) | dat8[i+8];
-
-                                index += 2;
-                            }
-                            else
-                                break;
-                        }/*for(i )*/
-                    }
-        }/*for(strip = 0; )*/
+    image->x0 = (OPJ_UINT32)parameters->image_offset_x0;
+    image->y0 = (OPJ_UINT32)parameters->image_offset_y0;
+    image->x1 =	!image->x0 ? (OPJ_UINT32)(w - 1) * (OPJ_UINT32)subsampling_dx + 1 :
+                             image->x0 + (OPJ_UINT32)(w - 1) * (OPJ_UINT32)subsampling_dx + 1;
+    image->y1 =	!image->y0 ? (OPJ_UINT32)(h - 1) * (OPJ_UINT32)subsampling_dy + 1 :
+                             image->y0 + (OPJ_UINT32)(h - 1) * (OPJ_UINT32)subsampling_dy + 1;
 
-        _TIFFfree(buf);
+    tr = (tif_reader_t*)calloc(1, sizeof(tif_reader_t));
+    if(!tr)
+    {
+        opj_image_destroy(image);
         TIFFClose(tif);
+        return NULL;
+    }
+    tr->tif = tif;
+    tr->bps = tiBps;
+    tr->numcomps = numcomps;
+    tr->has_alpha = has_alpha;
+    tr->is_rgb = (tiPhoto == PHOTOMETRIC_RGB);
+    tr->is_cinema = is_cinema;
+    tr->step = (tr->is_rgb ? 3 + has_alpha : 1 + has_alpha) * (tiBps == 16 ? 2 : 1);
 
-        return image;
-    }/*RGB(A)*/
+    tr->strip_size = TIFFStripSize(tif);
+    /* the last pixel of a strip may be cut: it is completed with 0 */
+    tr->buf = _TIFFmalloc(tr->strip_size + 8);
 
-    if(tiPhoto == PHOTOMETRIC_MINISBLACK) /* GRAY(A) */
+    if(!tr->buf)
     {
-        numcomps = 1 + has_alpha;
-        color_space = OPJ_CLRSPC_GRAY;
+        fprintf(stderr, "tiftoimage: not enough memory to read %s\n", filename);
+        opj_image_destroy(image);
+        tif_close(tr);
+        return NULL;
+    }
+    _TIFFmemset(tr->buf, 0, tr->strip_size + 8);
 
-        for(j = 0; j < numcomps; ++j)
-        {
-            cmptparm[j].prec = tiBps;
-            cmptparm[j].bpp = tiBps;
-            cmptparm[j].dx = (OPJ_UINT32)subsampling_dx;
-            cmptparm[j].dy = (OPJ_UINT32)subsampling_dy;
-            cmptparm[j].w = (OPJ_UINT32)w;
-            cmptparm[j].h = (OPJ_UINT32)h;
-        }
-#ifdef USETILEMODE
-        image = opj_image_tile_create(numcomps,&cmptparm[0],color_space);
-#else
-        image = opj_image_create((OPJ_UINT32)numcomps, &cmptparm[0], color_space);
-#endif
+    return row_reader_create(image, tif_read_rows, tif_close, tr);
+}/* tiftorows() */
 
-        if(!image)
-        {
-            TIFFClose(tif);
-            return NULL;
-        }
-        /* set image offset and reference grid
-*/
-        image->x0 = (OPJ_UINT32)parameters->image_offset_x0;
-        image->y0 = (OPJ_UINT32)parameters->image_offset_y0;
-        image->x1 =	!image->x0 ? (OPJ_UINT32)(w - 1) * (OPJ_UINT32)subsampling_dx + 1 :
-                                 image->x0 + (OPJ_UINT32)(w - 1) * (OPJ_UINT32)subsampling_dx + 1;
-        image->y1 =	!image->y0 ? (OPJ_UINT32)(h - 1) * (OPJ_UINT32)subsampling_dy + 1 :
-                                 image->y0 + (OPJ_UINT32)(h - 1) * (OPJ_UINT32)subsampling_dy + 1;
+opj_image_t* tiftoimage(const char *filename, opj_cparameters_t *parameters)
+{
+    return row_reader_to_image(tiftorows(filename, parameters));
+}/* tiftoimage() */
 
-        buf = _TIFFmalloc(TIFFStripSize(tif));
+#endif /* OPJ_HAVE_LIBTIFF */
 
-        strip_size = TIFFStripSize(tif);
-        index = 0;
-        imgsize = (int)(image->comps[0].w * image->comps[0].h);
-        /* Read the Image components
-*/
-        for(strip = 0; strip < TIFFNumberOfStrips(tif); strip++)
-        {
-            unsigned char *dat8;
-            tsize_t i, ssize;
-            int step;
+/* -->> -->> -->> -->>
 
-            ssize = TIFFReadEncodedStrip(tif, strip, buf, strip_size);
-            dat8 = (unsigned char*)buf;
+    RAW IMAGE FORMAT
 
-            if(tiBps == 16)
-            {
-                step = 2 + has_alpha + has_alpha;
+ <<-- <<-- <<-- <<-- */
+typedef struct {
+    FILE *f;
+    int bytes;              /* 1 or 2 bytes per sample */
+    OPJ_BOOL big_endian, is_signed;
+    size_t *nloop;          /* samples of each component in the file */
+    long *offset;           /* position of each component in the file */
+    long end;
+    unsigned char *buf;
+    size_t buf_size;
+} raw_reader_t;
+
+static int raw_read_rows(void *data, const opj_image_t *image, OPJ_UINT32 row,
+                         OPJ_INT32 **rows, OPJ_UINT32 nb_rows)
+{
+    raw_reader_t *rr = (raw_reader_t*)data;
+    size_t w = image->comps[0].w, first = (size_t)row * w, n = w * nb_rows, count, i;
+    OPJ_UINT32 compno;
+    unsigned short ch;
 
-                for(i = 0; i < ssize; i += step)
-                {
-                    if(index < imgsize)
-                    {
-                        image->comps[0].data[index] = ( dat8[i+1] << 8 ) | dat8[i+0];
-                        if(has_alpha)
-                            image->comps[1].data[index] = ( dat8[i+3] << 8 ) | dat8[i+2];
-                        index++;
-                    }
-                    else
-                        break;
-                }/*for(i )*/
+    for(compno = 0; compno < image->numcomps; compno++) {
+        OPJ_INT32 *dst = rows[compno];
+
+        /* the components planes follow each other, samples beyond the
+         * plane of a subsampled component are 0 */
+        count = (first < rr->nloop[compno]) ? rr->nloop[compno] - first : 0;
+        if (count > n) count = n;
+        memset(dst + count, 0, (n - count) * sizeof(OPJ_INT32));
+        if (count == 0) continue;
+
+        if (count * (size_t)rr->bytes > rr->buf_size) {
+            unsigned char *buf = (unsigned char*)realloc(rr->buf, count * (size_t)rr->bytes);
+            if (!buf) {
+                fprintf(stderr, "Failed to allocate the raw row buffer !!\n");
+                return 0;
             }
-            else
-                if(tiBps == 8)
+            rr->buf = buf;
+            rr->buf_size = count * (size_t)rr->bytes;
+        }
+        if (fseek(rr->f, rr->offset[compno] + (long)(first * (size_t)rr->bytes), SEEK_SET) != 0
+                || fread(rr->buf, (size_t)rr->bytes, count, rr->f) != count) {
+            fprintf(stderr,"Error reading raw file. End of file probably reached.\n");
+            return 0;
+        }
+        if (rr->bytes == 1) {
+            for (i = 0; i < count; i++) {
+                unsigned char value = rr->buf[i];
+                dst[i] = rr->is_signed?(char)value:value;
+            }
+        }
+        else {
+            for (i = 0; i < count; i++) {
+                unsigned char temp1 = rr->buf[2 * i];
+                unsigned char temp2 = rr->buf[2 * i + 1];
+                unsigned short value;
+                if( rr->big_endian )
                 {
-                    step = 1 + has_alpha;
-
-                    for(i = 0; i < ssize; i += step)
-                    {
-                        if(index < imgsize)
-                        {
-                            image->comps[0].data[index] = dat8[i+0];
-                            if(has_alpha)
-                                image->comps[1].data[index] = dat8[i+1];
-                            index++;
-                        }
-                        else
-                            break;
-                    }/*for(i )*/
+                    value = (unsigned short)((temp1 << 8) + temp2);
                 }
-        }/*for(strip = 0;*/
-
-        _TIFFfree(buf);
-        TIFFClose(tif);
-
-    }/*GRAY(A)*/
-
-    return image;
-
-}/* tiftoimage() */
+                else
+                {
+                    value = (unsigned short)((temp2 << 8) + temp1);
+                }
+                dst[i] = rr->is_signed?(short)value:value;
+            }
+        }
+    }
 
-#endif /* OPJ_HAVE_LIBTIFF */
+    if (row + nb_rows == image->comps[0].h
+            && fseek(rr->f, rr->end, SEEK_SET) == 0 && fread(&ch, 1, 1, rr->f)) {
+        fprintf(stderr,"Warning. End of raw file not reached... processing anyway\n");
+    }
+    return 1;
+}
 
-/* -->> -->> -->> -->>
+static void raw_close(void *data)
+{
+    raw_reader_t *rr = (raw_reader_t*)data;
 
-    RAW IMAGE FORMAT
+    fclose(rr->f);
+    free(rr->nloop);
+    free(rr->offset);
+    free(rr->buf);
+    free(rr);
+}
 
- <<-- <<-- <<-- <<-- */
-static opj_image_t* rawtoimage_common(const char *filename, opj_cparameters_t *parameters, raw_cparameters_t *raw_cp, OPJ_BOOL big_endian) {
+static convert_row_reader_t* rawtorows_common(const char *filename, opj_cparameters_t *parameters, raw_cparameters_t *raw_cp, OPJ_BOOL big_endian) {
     int subsampling_dx = parameters->subsampling_dx;
     int subsampling_dy = parameters->subsampling_dy;
 
     FILE *f = NULL;
-    int i, compno, numcomps, w, h;
+    int i, numcomps, w, h;
     OPJ_COLOR_SPACE color_space;
     opj_image_cmptparm_t *cmptparm;
     opj_image_t * image = NULL;
-    unsigned short ch;
+    raw_reader_t *rr;
+    long offset;
 
     if((! (raw_cp->rawWidth & raw_cp->rawHeight & raw_cp->rawComp & raw_cp->rawBitDepth)) == 0)
     {
@@ -3064,6 +3178,11 @@ static opj_image_t* rawtoimage_common(const char *filename, opj_cparameters_t *p
         fprintf(stderr,"Aborting\n");
         return NULL;
     }
+    if (raw_cp->rawBitDepth > 16) {
+        fprintf(stderr,"OpenJPEG cannot encode raw components with bit depth higher than 16 bits.\n");
+        fclose(f);
+        return NULL;
+    }
     numcomps = raw_cp->rawComp;
 
     /* FIXME ADE at this point, tcp_mct has not been properly set in calling function */
@@ -3079,12 +3198,30 @@ static opj_image_t* rawtoimage_common(const char *filename, opj_cparameters_t *p
     w = raw_cp->rawWidth;
     h = raw_cp->rawHeight;
     cmptparm = (opj_image_cmptparm_t*) calloc((OPJ_UINT32)numcomps,sizeof(opj_image_cmptparm_t));
-    if (!cmptparm) {
+    rr = (raw_reader_t*) calloc(1, sizeof(raw_reader_t));
+    if (rr) {
+        rr->nloop = (size_t*) calloc((OPJ_UINT32)numcomps, sizeof(size_t));
+        rr->offset = (long*) calloc((OPJ_UINT32)numcomps, sizeof(long));
+    }
+    if (!cmptparm || !rr || !rr->nloop || !rr->offset) {
         fprintf(stderr, "Failed to allocate image components parameters !!\n");
         fprintf(stderr,"Aborting\n");
+        free(cmptparm);
+        if (rr) {
+            free(rr->nloop);
+            free(rr->offset);
+            free(rr);
+        }
+        fclose(f);
         return NULL;
     }
+    rr->f = f;
+    rr->bytes = (raw_cp->rawBitDepth <= 8) ? 1 : 2;
+    rr->big_endian = big_endian;
+    rr->is_signed = raw_cp->rawSigned;
+
     /* initialize image components */
+    offset = 0;
     for(i = 0; i < numcomps; i++) {
         cmptparm[i].prec = (OPJ_UINT32)raw_cp->rawBitDepth;
         cmptparm[i].bpp = (OPJ_UINT32)raw_cp->rawBitDepth;
@@ -3093,12 +3230,18 @@ static opj_image_t* rawtoimage_common(const char *filename, opj_cparameters_t *p
         cmptparm[i].dy = (OPJ_UINT32)(subsampling_dy * raw_cp->rawComps[i].dy);
         cmptparm[i].w = (OPJ_UINT32)w;
         cmptparm[i].h = (OPJ_UINT32)h;
+
+        rr->nloop[i] = (size_t)((w*h)/(raw_cp->rawComps[i].dx * raw_cp->rawComps[i].dy));
+        rr->offset[i] = offset;
+        offset += (long)(rr->nloop[i] * (size_t)rr->bytes);
     }
+    rr->end = offset;
+
     /* create the image */
-    image = opj_image_create((OPJ_UINT32)numcomps, &cmptparm[0], color_space);
+    image = row_image_create((OPJ_UINT32)numcomps, &cmptparm[0], color_space);
     free(cmptparm);
     if(!image) {
-        fclose(f);
+        raw_close(rr);
         return NULL;
     }
     /* set image offset and reference grid */
@@ -3107,78 +3250,34 @@ static opj_image_t* rawtoimage_common(const char *filename, opj_cparameters_t *p
     image->x1 = (OPJ_UINT32)parameters->image_offset_x0 + (OPJ_UINT32)(w - 1) *	(OPJ_UINT32)subsampling_dx + 1;
     image->y1 = (OPJ_UINT32)parameters->image_offset_y0 + (OPJ_UINT32)(h - 1) * (OPJ_UINT32)subsampling_dy + 1;
 
-    if(raw_cp->rawBitDepth <= 8)
-    {
-        unsigned char value = 0;
-        for(compno = 0; compno < numcomps; compno++) {
-            int nloop = (w*h)/(raw_cp->rawComps[compno].dx*raw_cp->rawComps[compno].dy);
-            for (i = 0; i < nloop; i++) {
-                if (!fread(&value, 1, 1, f)) {
-                    fprintf(stderr,"Error reading raw file. End of file probably reached.\n");
-                    return NULL;
-                }
-                image->comps[compno].data[i] = raw_cp->rawSigned?(char)value:value;
-            }
-        }
-    }
-    else if(raw_cp->rawBitDepth <= 16)
-    {
-        unsigned short value;
-        for(compno = 0; compno < numcomps; compno++) {
-            int nloop = (w*h)/(raw_cp->rawComps[compno].dx*raw_cp->rawComps[compno].dx);
-            for (i = 0; i < nloop; i++) {
-                unsigned char temp1;
-                unsigned char temp2;
-                if (!fread(&temp1, 1, 1, f)) {
-                    fprintf(stderr,"Error reading raw file. End of file probably reached.\n");
-                    return NULL;
-                }
-                if (!fread(&temp2, 1, 1, f)) {
-                    fprintf(stderr,"Error reading raw file. End of file probably reached.\n");
-                    return NULL;
-                }
-                if( big_endian )
-                {
-                    value = (unsigned short)((temp1 << 8) + temp2);
-                }
-                else
-                {
-                    value = (unsigned short)((temp2 << 8) + temp1);
-                }
-                image->comps[compno].data[i] = raw_cp->rawSigned?(short)value:value;
-            }
-        }
-    }
-    else {
-        fprintf(stderr,"OpenJPEG cannot encode raw components with bit depth higher than 16 bits.\n");
-        return NULL;
-    }
+    return row_reader_create(image, raw_read_rows, raw_close, rr);
+}
 
-    if (fread(&ch, 1, 1, f)) {
-        fprintf(stderr,"Warning. End of raw file not reached... processing anyway\n");
-    }
-    fclose(f);
+convert_row_reader_t* rawltorows(const char *filename, opj_cparameters_t *parameters, raw_cparameters_t *raw_cp) {
+    return rawtorows_common(filename, parameters, raw_cp, OPJ_FALSE);
+}
 
-    return image;
+convert_row_reader_t* rawtorows(const char *filename, opj_cparameters_t *parameters, raw_cparameters_t *raw_cp) {
+    return rawtorows_common(filename, parameters, raw_cp, OPJ_TRUE);
 }
 
 opj_image_t* rawltoimage(const char *filename, opj_cparameters_t *parameters, raw_cparameters_t *raw_cp) {
-    return rawtoimage_common(filename, parameters, raw_cp, OPJ_FALSE);
+    return row_reader_to_image(rawltorows(filename, parameters, raw_cp));
 }
 
 opj_image_t* rawtoimage(const char *filename, opj_cparameters_t *parameters, raw_cparameters_t *raw_cp) {
-    return rawtoimage_common(filename, parameters, raw_cp, OPJ_TRUE);
+    return row_reader_to_image(rawtorows(filename, parameters, raw_cp));
 }
 
 static int imagetoraw_common(opj_image_t * image, const char *outfile, OPJ_BOOL big_endian)
 {
     FILE *rawFile = NULL;
-    size_t res;
     unsigned int compno;
     int w, h, fails;
-    int line, row, curr, mask;
-    int *ptr;
-    unsigned char uc;
+    int line, size;
+    pack_channel_t channel;
+    const OPJ_INT32 *ptr;
+    unsigned char *row = NULL;
     (void)big_endian;
 
     if((image->numcomps * image->x1 * image->y1) == 0)
@@ -3206,83 +3305,19 @@ static int imagetoraw_common(opj_image_t * image, const char *outfile, OPJ_BOOL
 
         if(image->comps[compno].prec <= 8)
         {
+            size = 1;
             if(image->comps[compno].sgnd == 1)
-            {
-                mask = (1 << image->comps[compno].prec) - 1;
-                ptr = image->comps[compno].data;
-                for (line = 0; line < h; line++) {
-                    for(row = 0; row < w; row++)	{
-                        curr = *ptr;
-                        if(curr > 127) curr = 127; else if(curr < -128) curr = -128;
-                        uc = (unsigned char) (curr & mask);
-                        res = fwrite(&uc, 1, 1, rawFile);
-                        if( res < 1 ) {
-                            fprintf(stderr, "failed to write 1 byte for %s\n", outfile);
-                            goto fin;
-                        }
-                        ptr++;
-                    }
-                }
-            }
-            else if(image->comps[compno].sgnd == 0)
-            {
-                mask = (1 << image->comps[compno].prec) - 1;
-                ptr = image->comps[compno].data;
-                for (line = 0; line < h; line++) {
-                    for(row = 0; row < w; row++)	{
-                        curr = *ptr;
-                        if(curr > 255) curr = 255; else if(curr < 0) curr = 0;
-                        uc = (unsigned char) (curr & mask);
-                        res = fwrite(&uc, 1, 1, rawFile);
-                        if( res < 1 ) {
-                            fprintf(stderr, "failed to write 1 byte for %s\n", outfile);
-                            goto fin;
-                        }
-                        ptr++;
-                    }
-                }
-            }
+                pack_channel_init(&channel, 0, -128, 127, (1 << image->comps[compno].prec) - 1);
+            else
+                pack_channel_init(&channel, 0, 0, 255, (1 << image->comps[compno].prec) - 1);
         }
         else if(image->comps[compno].prec <= 16)
         {
+            size = 2;
             if(image->comps[compno].sgnd == 1)
-            {
-                union { signed short val; signed char vals[2]; } uc16;
-                mask = (1 << image->comps[compno].prec) - 1;
-                ptr = image->comps[compno].data;
-                for (line = 0; line < h; line++) {
-                    for(row = 0; row < w; row++)	{
-                        curr = *ptr;
-                        if(curr > 32767 ) curr = 32767; else if( curr < -32768) curr = -32768;
-                        uc16.val = (signed short)(curr & mask);
-                        res = fwrite(uc16.vals, 1, 2, rawFile);
-                        if( res < 2 ) {
-                            fprintf(stderr, "failed to write 2 byte for %s\n", outfile);
-                            goto fin;
-                        }
-                        ptr++;
-                    }
-                }
-            }
-            else if(image->comps[compno].sgnd == 0)
-            {
-                union { unsigned short val; unsigned char vals[2]; } uc16;
-                mask = (1 << image->comps[compno].prec) - 1;
-                ptr = image->comps[compno].data;
-                for (line = 0; line < h; line++) {
-                    for(row = 0; row < w; row++)	{
-                        curr = *ptr;
-                        if(curr > 65536 ) curr = 65536; else if( curr < 0) curr = 0;
-                        uc16.val = (unsigned short)(curr & mask);
-                        res = fwrite(uc16.vals, 1, 2, rawFile);
-                        if( res < 2 ) {
-                            fprintf(stderr, "failed to write 2 byte for %s\n", outfile);
-                            goto fin;
-                        }
-                        ptr++;
-                    }
-                }
-            }
+                pack_channel_init(&channel, 0, -32768, 32767, (1 << image->comps[compno].prec) - 1);
+            else
+                pack_channel_init(&channel, 0, 0, 65536, (1 << image->comps[compno].prec) - 1);
         }
         else if (image->comps[compno].prec <= 32)
         {
@@ -3294,9 +3329,27 @@ static int imagetoraw_common(opj_image_t * image, const char *outfile, OPJ_BOOL
             fprintf(stderr,"Error: invalid precision: %d\n", image->comps[compno].prec);
             goto fin;
         }
+
+        /* samples are written in host byte order, one row at a time */
+        free(row);
+        row = (unsigned char*)malloc((size_t)w * (size_t)size);
+        if(row == NULL && w > 0) {
+            fprintf(stderr, "out of memory writing %s\n", outfile);
+            goto fin;
+        }
+        ptr = image->comps[compno].data;
+        for (line = 0; line < h; line++) {
+            pack_row(row, &ptr, &channel, 1, (OPJ_SIZE_T)w, (size == 1) ? PACK_8 : PACK_16NE);
+            if(fwrite(row, (size_t)size, (size_t)w, rawFile) < (size_t)w) {
+                fprintf(stderr, "failed to write %d bytes for %s\n", w * size, outfile);
+                goto fin;
+            }
+            ptr += w;
+        }
     }
   fails = 0;
 fin:
+    free(row);
     fclose(rawFile);
     return fails;
 }
@@ -3317,26 +3370,104 @@ int imagetorawl(opj_image_t * image, const char *outfile)
 #define MAGIC_SIZE 8
 /* PNG allows bits per sample: 1, 2, 4, 8, 16 */
 
-opj_image_t *pngtoimage(const char *read_idf, opj_cparameters_t * params)
+typedef struct {
+    FILE *reader;
+    png_structp png;
+    png_infop info;
+    png_uint_32 height;
+    unsigned char **rows;   /* whole image of the interlaced files */
+    unsigned char *row;     /* row being decoded otherwise */
+    int is16, has_alpha;
+} pngr_t;
+
+/* Decodes the next row, png errors come back here */
+static int pngr_read_row(pngr_t *pr)
+{
+    if(setjmp(png_jmpbuf(pr->png)))
+        return 0;
+
+    png_read_row(pr->png, pr->row, NULL);
+
+    return 1;
+}
+
+static int pngr_read_rows(void *data, const opj_image_t *image, OPJ_UINT32 row,
+                         OPJ_INT32 **rows, OPJ_UINT32 nb_rows)
+{
+    pngr_t *pr = (pngr_t*)data;
+    OPJ_UINT32 width = image->comps[0].w, i, j;
+    int *r = rows[0], *g = rows[1], *b = rows[2], *a = pr->has_alpha ? rows[3] : NULL;
+
+    for(i = 0; i < nb_rows; ++i)
+    {
+        unsigned char *s;
+
+        if(pr->rows)
+            s = pr->rows[row + i];
+        else
+        {
+            if( !pngr_read_row(pr))
+                return 0;
+            s = pr->row;
+        }
+
+        for(j = 0; j < width; ++j)
+        {
+            if(pr->is16)
+            {
+                *r++ = s[0]<<8|s[1]; s += 2;
+
+                *g++ = s[0]<<8|s[1]; s += 2;
+
+                *b++ = s[0]<<8|s[1]; s += 2;
+
+                if(pr->has_alpha) { *a++ = s[0]<<8|s[1]; s += 2; }
+
+                continue;
+            }
+            *r++ = *s++; *g++ = *s++; *b++ = *s++;
+
+            if(pr->has_alpha) *a++ = *s++;
+        }
+    }
+    return 1;
+}
+
+static void pngr_close(void *data)
+{
+    pngr_t *pr = (pngr_t*)data;
+    png_uint_32 i;
+
+    if(pr->rows)
+    {
+        for(i = 0; i < pr->height; ++i)
+            free(pr->rows[i]);
+        free(pr->rows);
+    }
+    free(pr->row);
+    if(pr->png)
+        png_destroy_read_struct(&pr->png, &pr->info, NULL);
+
+    fclose(pr->reader);
+    free(pr);
+}
+
+convert_row_reader_t* pngtorows(const char *read_idf, opj_cparameters_t * params)
 {
-    png_structp  png;
-    png_infop    info;
+    pngr_t *pr;
     double gamma, display_exponent;
     int bit_depth, interlace_type,compression_type, filter_type;
     int unit;
     png_uint_32 resx, resy;
-    unsigned int i, j;
+    unsigned int i;
     png_uint_32  width, height;
-    int color_type, has_alpha, is16;
-    unsigned char *s;
+    int color_type;
     FILE *reader;
-    unsigned char **rows;
     /* j2k: */
     opj_image_t *image;
     opj_image_cmptparm_t cmptparm[4];
     int sub_dx, sub_dy;
     unsigned int nr_comp;
-    int *r, *g, *b, *a = NULL;
     unsigned char sigbuf[8];
 
     if((reader = fopen(read_idf, "rb")) == NULL)
@@ -3344,7 +3475,13 @@ opj_image_t *pngtoimage(const char *read_idf, opj_cparameters_t * params)
         fprintf(stderr,"pngtoimage: can not open %s\n",read_idf);
         return NULL;
     }
-    image = NULL; png = NULL; rows = NULL;
+    if((pr = (pngr_t*)calloc(1, sizeof(pngr_t))) == NULL)
+    {
+        fclose(reader);
+        return NULL;
+    }
+    pr->reader = reader;
+    image = NULL;
 
     if(fread(sigbuf, 1, MAGIC_SIZE, reader) != MAGIC_SIZE
             || memcmp(sigbuf, PNG_MAGIC, MAGIC_SIZE) != 0)
@@ -3358,21 +3495,21 @@ opj_image_t *pngtoimage(const char *read_idf, opj_cparameters_t * params)
 */
     display_exponent = 2.2;
 
-    if((png = png_create_read_struct(PNG_LIBPNG_VER_STRING,
-                                     NULL, NULL, NULL)) == NULL)
+    if((pr->png = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                         NULL, NULL, NULL)) == NULL)
         goto fin;
-    if((info = png_create_info_struct(png)) == NULL)
+    if((pr->info = png_create_info_struct(pr->png)) == NULL)
         goto fin;
 
-    if(setjmp(png_jmpbuf(png)))
+    if(setjmp(png_jmpbuf(pr->png)))
         goto fin;
 
-    png_init_io(png, reader);
-    png_set_sig_bytes(png, MAGIC_SIZE);
+    png_init_io(pr->png, reader);
+    png_set_sig_bytes(pr->png, MAGIC_SIZE);
 
-    png_read_info(png, info);
+    png_read_info(pr->png, pr->info);
 
-    if(png_get_IHDR(png, info, &width, &height,
+    if(png_get_IHDR(pr->png, pr->info, &width, &height,
                     &bit_depth, &color_type, &interlace_type,
                     &compression_type, &filter_type) == 0)
         goto fin;
@@ -3383,48 +3520,60 @@ opj_image_t *pngtoimage(const char *read_idf, opj_cparameters_t * params)
  * to alpha channels.
 */
     if(color_type == PNG_COLOR_TYPE_PALETTE)
-        png_set_expand(png);
+        png_set_expand(pr->png);
     else
         if(color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
-            png_set_expand(png);
+            png_set_expand(pr->png);
 
-    if(png_get_valid(png, info, PNG_INFO_tRNS))
-        png_set_expand(png);
+    if(png_get_valid(pr->png, pr->info, PNG_INFO_tRNS))
+        png_set_expand(pr->png);
 
-    is16 = (bit_depth == 16);
+    pr->is16 = (bit_depth == 16);
 
     /* GRAY => RGB; GRAY_ALPHA => RGBA
 */
     if(color_type == PNG_COLOR_TYPE_GRAY
             || color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
     {
-        png_set_gray_to_rgb(png);
+        png_set_gray_to_rgb(pr->png);
         color_type =
                 (color_type == PNG_COLOR_TYPE_GRAY? PNG_COLOR_TYPE_RGB:
                                                     PNG_COLOR_TYPE_RGB_ALPHA);
     }
-    if( !png_get_gAMA(png, info, &gamma))
+    if( !png_get_gAMA(pr->png, pr->info, &gamma))
         gamma = 0.45455;
 
-    png_set_gamma(png, display_exponent, gamma);
+    png_set_gamma(pr->png, display_exponent, gamma);
 
-    png_read_update_info(png, info);
+    png_read_update_info(pr->png, pr->info);
 
-    png_get_pHYs(png, info, &resx, &resy, &unit);
+    png_get_pHYs(pr->png, pr->info, &resx, &resy, &unit);
 
-    color_type = png_get_color_type(png, info);
+    color_type = png_get_color_type(pr->png, pr->info);
 
-    has_alpha = (color_type == PNG_COLOR_TYPE_RGB_ALPHA);
+    pr->has_alpha = (color_type == PNG_COLOR_TYPE_RGB_ALPHA);
 
-    nr_comp = 3 + (unsigned int)has_alpha;
+    nr_comp = 3 + (unsigned int)pr->has_alpha;
 
-    bit_depth = png_get_bit_depth(png, info);
+    bit_depth = png_get_bit_depth(pr->png, pr->info);
 
-    rows = (unsigned char**)calloc(height+1, sizeof(unsigned char*));
-    for(i = 0; i < height; ++i)
-        rows[i] = (unsigned char*)malloc(png_get_rowbytes(png,info));
+    /* The rows of the interlaced images only come out at the last pass:
+     * those are decoded at once, the others one row at a time. */
+    if(interlace_type != PNG_INTERLACE_NONE)
+    {
+        pr->height = height;
+        pr->rows = (unsigned char**)calloc(height+1, sizeof(unsigned char*));
+        if(pr->rows == NULL) goto fin;
+        for(i = 0; i < height; ++i)
+            pr->rows[i] = (unsigned char*)malloc(png_get_rowbytes(pr->png,pr->info));
 
-    png_read_image(png, rows);
+        png_read_image(pr->png, pr->rows);
+    }
+    else
+    {
+        pr->row = (unsigned char*)malloc(png_get_rowbytes(pr->png,pr->info));
+        if(pr->row == NULL) goto fin;
+    }
 
     memset(cmptparm, 0, sizeof(cmptparm));
 
@@ -3442,7 +3591,7 @@ opj_image_t *pngtoimage(const char *read_idf, opj_cparameters_t * params)
         cmptparm[i].h = (OPJ_UINT32)height;
     }
 
-    image = opj_image_create(nr_comp, &cmptparm[0], OPJ_CLRSPC_SRGB);
+    image = row_image_create(nr_comp, &cmptparm[0], OPJ_CLRSPC_SRGB);
 
     if(image == NULL) goto fin;
 
@@ -3451,62 +3600,41 @@ opj_image_t *pngtoimage(const char *read_idf, opj_cparameters_t * params)
     image->x1 = (OPJ_UINT32)(image->x0 + (width  - 1) * (OPJ_UINT32)sub_dx + 1 + image->x0);
     image->y1 = (OPJ_UINT32)(image->y0 + (height - 1) * (OPJ_UINT32)sub_dy + 1 + image->y0);
 
-    r = image->comps[0].data;
-    g = image->comps[1].data;
-    b = image->comps[2].data;
-    if(has_alpha) {
-        a = image->comps[3].data;
+    if(pr->has_alpha)
         image->comps[3].alpha = 1;
-    }
 
-    for(i = 0; i < height; ++i)
-    {
-        s = rows[i];
-
-        for(j = 0; j < width; ++j)
-        {
-            if(is16)
-            {
-                *r++ = s[0]<<8|s[1]; s += 2;
-
-                *g++ = s[0]<<8|s[1]; s += 2;
+    return row_reader_create(image, pngr_read_rows, pngr_close, pr);
 
-                *b++ = s[0]<<8|s[1]; s += 2;
-
-                if(has_alpha) { *a++ = s[0]<<8|s[1]; s += 2; }
-
-                continue;
-            }
-            *r++ = *s++; *g++ = *s++; *b++ = *s++;
-
-            if(has_alpha) *a++ = *s++;
-        }
-    }
 fin:
-    if(rows)
-    {
-        for(i = 0; i < height; ++i)
-            free(rows[i]);
-        free(rows);
-    }
-    if(png)
-        png_destroy_read_struct(&png, &info, NULL);
+    pngr_close(pr);
 
-    fclose(reader);
+    return NULL;
 
-    return image;
+}/* pngtorows() */
 
+opj_image_t *pngtoimage(const char *read_idf, opj_cparameters_t * params)
+{
+    return row_reader_to_image(pngtorows(read_idf, params));
 }/* pngtoimage() */
 
 int imagetopng(opj_image_t * image, const char *write_idf)
+{
+    return imagetopng_rows(image, NULL, write_idf);
+}
+
+int imagetopng_rows(opj_image_t * image, const convert_row_source_t *rows,
+                    const char *write_idf)
 {
     FILE *writer;
     png_structp png;
     png_infop info;
-    int *red, *green, *blue, *alpha;
-    unsigned char *row_buf, *d;
-    int has_alpha, width, height, nr_comp, color_type;
-    int adjustR, adjustG, adjustB, adjustA, x, y, fails;
+    convert_row_source_t source;
+    pack_channel_t channels[4];
+    const OPJ_INT32 *src[4];
+    int compnos[4];
+    unsigned char *row_buf;
+    int has_alpha, width, height, nr_comp, nb_channels, color_type;
+    int c, y, fails;
     int prec, ushift, dshift, is16, force16, force8;
     unsigned short mask = 0xffff;
     png_color_8 sig_bit;
@@ -3537,6 +3665,11 @@ int imagetopng(opj_image_t * image, const char *write_idf)
 
     if(writer == NULL) return fails;
 
+    if(rows == NULL)
+    {
+        image_row_source(image, &source);
+        rows = &source;
+    }
     info = NULL; has_alpha = 0;
 
     /* Create and initialize the png_struct with the desired error handler
@@ -3595,6 +3728,8 @@ int imagetopng(opj_image_t * image, const char *write_idf)
                 else
                     if(prec == 1) mask = 0x0001;
 
+    is16 = (prec == 16);
+
     if(nr_comp >= 3
             && image->comps[0].dx == image->comps[1].dx
             && image->comps[1].dx == image->comps[2].dx
@@ -3603,33 +3738,23 @@ int imagetopng(opj_image_t * image, const char *write_idf)
             && image->comps[0].prec == image->comps[1].prec
             && image->comps[1].prec == image->comps[2].prec)
     {
-        int v;
-
         has_alpha = (nr_comp > 3);
-
-        is16 = (prec == 16);
+        nb_channels = 3 + has_alpha;
 
         width = (int)image->comps[0].w;
         height = (int)image->comps[0].h;
 
-        red = image->comps[0].data;
-        green = image->comps[1].data;
-        blue = image->comps[2].data;
-
         sig_bit.red = sig_bit.green = sig_bit.blue = (png_byte)prec;
 
         if(has_alpha)
         {
             sig_bit.alpha = (png_byte)prec;
-            alpha = image->comps[3].data;
             color_type = PNG_COLOR_TYPE_RGB_ALPHA;
-            adjustA = (image->comps[3].sgnd ? 1 << (image->comps[3].prec - 1) : 0);
         }
         else
         {
-            sig_bit.alpha = 0; alpha = NULL;
+            sig_bit.alpha = 0;
             color_type = PNG_COLOR_TYPE_RGB;
-            adjustA = 0;
         }
         png_set_sBIT(png, info, &sig_bit);
 
@@ -3651,90 +3776,13 @@ printf("%s:%d:sgnd(%d,%d,%d) w(%d) h(%d) alpha(%d)\n",__FILE__,__LINE__,
 image->comps[0].sgnd,
 image->comps[1].sgnd,image->comps[2].sgnd,width,height,has_alpha);
 
-        adjustR = (image->comps[0].sgnd ? 1 << (image->comps[0].prec - 1) : 0);
-        adjustG = (image->comps[1].sgnd ? 1 << (image->comps[1].prec - 1) : 0);
-        adjustB = (image->comps[2].sgnd ? 1 << (image->comps[2].prec - 1) : 0);
-
-        row_buf = (unsigned char*)malloc((size_t)width * (size_t)nr_comp * 2);
-
-        for(y = 0; y < height; ++y)
+        for(c = 0; c < nb_channels; ++c)
         {
-            d = row_buf;
-
-            for(x = 0; x < width; ++x)
-            {
-                if(is16)
-                {
-                    v = *red + adjustR; ++red;
-		if(v > 65535) v = 65535; else if(v < 0) v = 0;
-
-                    if(force16) { v = (v<<ushift) + (v>>dshift); }
-
-                    *d++ = (unsigned char)(v>>8); *d++ = (unsigned char)v;
-
-                    v = *green + adjustG; ++green;
-		if(v > 65535) v = 65535; else if(v < 0) v = 0;
-
-                    if(force16) { v = (v<<ushift) + (v>>dshift); }
-
-                    *d++ = (unsigned char)(v>>8); *d++ = (unsigned char)v;
-
-                    v =  *blue + adjustB; ++blue;
-		if(v > 65535) v = 65535; else if(v < 0) v = 0;
-
-                    if(force16) { v = (v<<ushift) + (v>>dshift); }
-
-                    *d++ = (unsigned char)(v>>8); *d++ = (unsigned char)v;
-
-                    if(has_alpha)
-                    {
-                        v = *alpha + adjustA; ++alpha;
-		if(v > 65535) v = 65535; else if(v < 0) v = 0;
-
-                        if(force16) { v = (v<<ushift) + (v>>dshift); }
-
-                        *d++ = (unsigned char)(v>>8); *d++ = (unsigned char)v;
-                    }
-                    continue;
-                }/* if(is16) */
-
-                v = *red + adjustR; ++red;
-		if(v > 255) v = 255; else if(v < 0) v = 0;
-
-                if(force8) { v = (v<<ushift) + (v>>dshift); }
-
-                *d++ = (unsigned char)(v & mask);
-
-                v = *green + adjustG; ++green;
-		if(v > 255) v = 255; else if(v < 0) v = 0;
-
-                if(force8) { v = (v<<ushift) + (v>>dshift); }
-
-                *d++ = (unsigned char)(v & mask);
-
-                v = *blue + adjustB; ++blue;
-		if(v > 255) v = 255; else if(v < 0) v = 0;
-
-                if(force8) { v = (v<<ushift) + (v>>dshift); }
-
-                *d++ = (unsigned char)(v & mask);
-
-                if(has_alpha)
-                {
-                    v = *alpha + adjustA; ++alpha;
-		if(v > 255) v = 255; else if(v < 0) v = 0;
-
-                    if(force8) { v = (v<<ushift) + (v>>dshift); }
-
-                    *d++ = (unsigned char)(v & mask);
-                }
-            }	/* for(x) */
-
-            png_write_row(png, row_buf);
-
-        }	/* for(y) */
-        free(row_buf);
-
+            compnos[c] = c;
+            pack_channel_init(&channels[c],
+                              image->comps[c].sgnd ? 1 << (image->comps[c].prec - 1) : 0,
+                              0, is16 ? 65535 : 255, mask);
+        }
     }/* nr_comp >= 3 */
     else
         if(nr_comp == 1 /* GRAY */
@@ -3743,21 +3791,15 @@ image->comps[1].sgnd,image->comps[2].sgnd,width,height,has_alpha);
                        && image->comps[0].dy == image->comps[1].dy
                        && image->comps[0].prec == image->comps[1].prec))
         {
-            int v;
-
-            red = image->comps[0].data;
-
             sig_bit.gray = (png_byte)prec;
             sig_bit.red = sig_bit.green = sig_bit.blue = sig_bit.alpha = 0;
-            alpha = NULL; adjustA = 0;
             color_type = PNG_COLOR_TYPE_GRAY;
+            nb_channels = nr_comp;
 
             if(nr_comp == 2)
             {
                 has_alpha = 1; sig_bit.alpha = (png_byte)prec;
-                alpha = image->comps[1].data;
                 color_type = PNG_COLOR_TYPE_GRAY_ALPHA;
-                adjustA = (image->comps[1].sgnd ? 1 << (image->comps[1].prec - 1) : 0);
             }
             width = (int)image->comps[0].w;
             height = (int)image->comps[0].h;
@@ -3774,85 +3816,50 @@ image->comps[1].sgnd,image->comps[2].sgnd,width,height,has_alpha);
             /*=============================*/
             png_write_info(png, info);
             /*=============================*/
-            adjustR = (image->comps[0].sgnd ? 1 << (image->comps[0].prec - 1) : 0);
-
             if(prec < 8)
             {
                 png_set_packing(png);
             }
 
-            if(prec > 8)
-            {
-                row_buf = (unsigned char*)
-                        malloc((size_t)width * (size_t)nr_comp * sizeof(unsigned short));
-
-                for(y = 0; y < height; ++y)
-                {
-                    d = row_buf;
-
-                    for(x = 0; x < width; ++x)
-                    {
-                        v = *red + adjustR; ++red;
-		if(v > 65535) v = 65535; else if(v < 0) v = 0;
-
-                        if(force16) { v = (v<<ushift) + (v>>dshift); }
-
-                        *d++ = (unsigned char)(v>>8); *d++ = (unsigned char)v;
-
-                        if(has_alpha)
-                        {
-                            v = *alpha++;
-		if(v > 65535) v = 65535; else if(v < 0) v = 0;
-
-                            if(force16) { v = (v<<ushift) + (v>>dshift); }
-
-                            *d++ = (unsigned char)(v>>8); *d++ = (unsigned char)v;
-                        }
-                    }/* for(x) */
-                    png_write_row(png, row_buf);
-
-                }	/* for(y) */
-                free(row_buf);
-            }
-            else /* prec <= 8 */
+            for(c = 0; c < nb_channels; ++c)
             {
-                row_buf = (unsigned char*)calloc((size_t)width, (size_t)nr_comp * 2);
-
-                for(y = 0; y < height; ++y)
-                {
-                    d = row_buf;
-
-                    for(x = 0; x < width; ++x)
-                    {
-                        v = *red + adjustR; ++red;
-		if(v > 255) v = 255; else if(v < 0) v = 0;
-
-                        if(force8) { v = (v<<ushift) + (v>>dshift); }
-
-                        *d++ = (unsigned char)(v & mask);
-
-                        if(has_alpha)
-                        {
-                            v = *alpha + adjustA; ++alpha;
-		if(v > 255) v = 255; else if(v < 0) v = 0;
-
-                            if(force8) { v = (v<<ushift) + (v>>dshift); }
-
-                            *d++ = (unsigned char)(v & mask);
-                        }
-                    }/* for(x) */
-
-                    png_write_row(png, row_buf);
-
-                }	/* for(y) */
-                free(row_buf);
+                compnos[c] = c;
+                pack_channel_init(&channels[c],
+                                  image->comps[c].sgnd ? 1 << (image->comps[c].prec - 1) : 0,
+                                  0, is16 ? 65535 : 255, mask);
             }
+            /* 16 bit alpha is written without level shift */
+            if(has_alpha && is16) channels[1].adjust = 0;
         }
         else
         {
             fprintf(stderr,"imagetopng: can not create %s\n",write_idf);
             goto fin;
         }
+
+    for(c = 0; c < nb_channels; ++c)
+    {
+        channels[c].ushift = ushift;
+        channels[c].dshift = dshift;
+    }
+    row_buf = (unsigned char*)malloc((size_t)width * (size_t)nb_channels * (is16 ? 2 : 1));
+
+    if(row_buf == NULL) goto fin;
+
+    for(y = 0; y < height; ++y)
+    {
+        if(!get_rows(rows, compnos, nb_channels, (OPJ_UINT32)y, src))
+        {
+            free(row_buf); goto fin;
+        }
+        pack_row(row_buf, src, channels, (OPJ_SIZE_T)nb_channels, (OPJ_SIZE_T)width,
+                 is16 ? PACK_16BE : PACK_8);
+
+        png_write_row(png, row_buf);
+
+    }	/* for(y) */
+    free(row_buf);
+
     png_write_end(png, info);
 
     fails = 0;
@@ -65,6 +65,27 @@ typedef struct raw_cparameters {
 	/*@}*/
 } raw_cparameters_t;
 
+/* Source of the rows handed to the image writers, e.g. a decoder producing
+   the image strip after strip. get_row returns row y of component compno or
+   NULL on failure; rows are asked in increasing y, component by component. */
+typedef struct convert_row_source {
+	const OPJ_INT32* (*get_row)(void *user_data, OPJ_UINT32 compno, OPJ_UINT32 y);
+	void *user_data;
+} convert_row_source_t;
+
+/* Reader of an image file row after row, e.g. to hand strips to an encoder
+   without loading the whole image. The image returned by row_reader_image
+   describes the components, its data is left to NULL; row_reader_read fills
+   nb_rows rows of every component (comps[compno].w samples each) from the
+   first row not read yet and returns 0 on failure. */
+typedef struct convert_row_reader convert_row_reader_t;
+
+opj_image_t* row_reader_image(convert_row_reader_t *reader);
+int row_reader_read(convert_row_reader_t *reader, OPJ_INT32 **rows, OPJ_UINT32 nb_rows);
+void row_reader_close(convert_row_reader_t *reader);
+/* Reads all the rows into the image, which is returned, and closes the reader */
+opj_image_t* row_reader_to_image(convert_row_reader_t *reader);
+
 /* Component precision clipping */
 void clip_component(opj_image_comp_t* component, OPJ_UINT32 precision);
 /* Component precision scaling */
@@ -80,7 +101,9 @@ int imagetobmp(opj_image_t *image, const char *outfile);
 
 /* TIFF conversion*/
 opj_image_t* tiftoimage(const char *filename, opj_cparameters_t *parameters);
+convert_row_reader_t* tiftorows(const char *filename, opj_cparameters_t *parameters);
 int imagetotif(opj_image_t *image, const char *outfile);
+int imagetotif_rows(opj_image_t *image, const convert_row_source_t *rows, const char *outfile);
 /**
 Load a single image component encoded in PGX file format
 @param filename Name of the PGX file to load
@@ -91,17 +114,23 @@ opj_image_t* pgxtoimage(const char *filename, opj_cparameters_t *parameters);
 int imagetopgx(opj_image_t *image, const char *outfile);
 
 opj_image_t* pnmtoimage(const char *filename, opj_cparameters_t *parameters);
+convert_row_reader_t* pnmtorows(const char *filename, opj_cparameters_t *parameters);
 int imagetopnm(opj_image_t *image, const char *outfile);
+int imagetopnm_rows(opj_image_t *image, const convert_row_source_t *rows, const char *outfile);
 
 /* RAW conversion */
 int imagetoraw(opj_image_t * image, const char *outfile);
 int imagetorawl(opj_image_t * image, const char *outfile);
 opj_image_t* rawtoimage(const char *filename, opj_cparameters_t *parameters, raw_cparameters_t *raw_cp);
 opj_image_t* rawltoimage(const char *filename, opj_cparameters_t *parameters, raw_cparameters_t *raw_cp);
+convert_row_reader_t* rawtorows(const char *filename, opj_cparameters_t *parameters, raw_cparameters_t *raw_cp);
+convert_row_reader_t* rawltorows(const char *filename, opj_cparameters_t *parameters, raw_cparameters_t *raw_cp);
 
 /* PNG conversion*/
 extern int imagetopng(opj_image_t *image, const char *write_idf);
+extern int imagetopng_rows(opj_image_t *image, const convert_row_source_t *rows, const char *write_idf);
 extern opj_image_t* pngtoimage(const char *filename, opj_cparameters_t *parameters);
+extern convert_row_reader_t* pngtorows(const char *filename, opj_cparameters_t *parameters);
 
 #endif /* __J2K_CONVERT_H */
 
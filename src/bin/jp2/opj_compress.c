@@ -64,6 +64,7 @@
 #include "opj_getopt.h"
 #include "convert.h"
 #include "index.h"
+#include "opj_batch.h"
 
 #include "format_defs.h"
 
@@ -83,8 +84,19 @@ typedef struct img_folder{
     char set_imgdir;
     /** Enable Cod Format for output*/
     char set_out_format;
+    /** Number of threads compressing the files of the directory*/
+    int num_threads;
 }img_fol_t;
 
+/** Files to compress and parameters shared by the threads of a batch */
+typedef struct opj_compress_batch{
+    /** command line parameters, copied for each file */
+    const opj_cparameters_t *parameters;
+    const raw_cparameters_t *raw_cp;
+    img_fol_t *img_fol;
+    dircnt_t *dirptr;
+}opj_compress_batch_t;
+
 static void encode_help_display(void) {
     fprintf(stdout,"\nThis is the opj_compress utility from the OpenJPEG project.\n"
             "It compresses various image formats with the JPEG 2000 algorithm.\n"
@@ -143,6 +155,9 @@ static void encode_help_display(void) {
     fprintf(stdout,"-OutFor <J2K|J2C|JP2>\n");
     fprintf(stdout,"    Output format for compressed files.\n");
     fprintf(stdout,"    Required only if -ImgDir is used\n");
+    fprintf(stdout,"-threads <number of threads>\n");
+    fprintf(stdout,"    Compress the files of the -ImgDir directory with several threads.\n");
+    fprintf(stdout,"    A summary of the throughput is printed at the end of the batch.\n");
     fprintf(stdout,"-F <width>,<height>,<ncomp>,<bitdepth>,{s,u}@<dx1>x<dy1>:...:<dxn>x<dyn>\n");
     fprintf(stdout,"    Characteristics of the raw input image\n");
     fprintf(stdout,"    If subsampling is omitted, 1x1 is assumed for all components\n");
@@ -214,6 +229,8 @@ static void encode_help_display(void) {
     fprintf(stdout,"    Divide packets of every tile into tile-parts.\n");
     fprintf(stdout,"    Division is made by grouping Resolutions (R), Layers (L)\n");
     fprintf(stdout,"    or Components (C).\n");
+    fprintf(stdout,"-PLT\n");
+    fprintf(stdout,"    Write the lengths of the packets in PLT markers, in every tile-part header.\n");
     #ifdef FIXME_INDEX
     fprintf(stdout,"-x  <index file>\n");
     fprintf(stdout,"    Create an index file.\n");
@@ -483,7 +500,9 @@ static int parse_cmdline_encoder(int argc, char **argv, opj_cparameters_t *param
         {"POC",REQ_ARG, NULL ,'P'},
         {"ROI",REQ_ARG, NULL ,'R'},
         {"jpip",NO_ARG, NULL, 'J'},
-        {"mct",REQ_ARG, NULL, 'Y'}
+        {"mct",REQ_ARG, NULL, 'Y'},
+        {"PLT",NO_ARG, NULL, 'L'},
+        {"threads",REQ_ARG, NULL, 'N'}
     };
 
     /* parse the command line */
@@ -495,6 +514,7 @@ static int parse_cmdline_encoder(int argc, char **argv, opj_cparameters_t *param
 
     totlen=sizeof(long_option);
     img_fol->set_out_format=0;
+    img_fol->num_threads=1;
     raw_cp->rawWidth = 0;
 
     do{
@@ -974,6 +994,14 @@ static int parse_cmdline_encoder(int argc, char **argv, opj_cparameters_t *param
 
             /* ------------------------------------------------------ */
 
+        case 'L':			/* PLT markers */
+        {
+            parameters->plt_on = OPJ_TRUE;
+        }
+            break;
+
+            /* ------------------------------------------------------ */
+
         case 'z':			/* Image Directory path */
         {
             img_fol->imgdirpath = (char*)malloc(strlen(opj_optarg) + 1);
@@ -984,6 +1012,21 @@ static int parse_cmdline_encoder(int argc, char **argv, opj_cparameters_t *param
 
             /* ------------------------------------------------------ */
 
+        case 'N':			/* Number of threads of the batch mode */
+        {
+            if ((sscanf(opj_optarg, "%d", &img_fol->num_threads) != 1) || (img_fol->num_threads < 1)) {
+                fprintf(stderr, "[ERROR] -threads expects a number of threads greater than 0\n");
+                return 1;
+            }
+            if ((img_fol->num_threads > 1) && !opj_batch_has_threads()) {
+                fprintf(stderr, "[WARNING] threads are not supported by this build, -threads is ignored\n");
+                img_fol->num_threads = 1;
+            }
+        }
+            break;
+
+            /* ------------------------------------------------------ */
+
         case 'w':			/* Digital Cinema 2K profile compliance*/
         {
             int fps=0;
@@ -1536,28 +1579,487 @@ static void info_callback(const char *msg, void *client_data) {
 }
 
 /* -------------------------------------------------------------------------- */
+
+/** Rows read at once when the image is encoded by strips */
+#define STRIP_NB_ROWS 64
+
 /**
- * OPJ_COMPRESS MAIN
+ * Returns the image of a file read row after row. The rows are written to the
+ * encoder as they are read when the components cover the reference grid;
+ * otherwise, or when the tiles are filled by hand, the whole image is loaded
+ * and the reader is closed.
  */
-/* -------------------------------------------------------------------------- */
-int main(int argc, char **argv) {
+static opj_image_t* rows_image(convert_row_reader_t **reader, OPJ_BOOL bUseTiles) {
+    opj_image_t *image;
+    OPJ_UINT32 compno;
+
+    if (*reader == NULL)
+        return NULL;
+
+    image = row_reader_image(*reader);
+    for (compno = 0; compno < image->numcomps; ++compno) {
+        opj_image_comp_t *comp = &image->comps[compno];
+        if (comp->dx != 1 || comp->dy != 1
+                || comp->w != image->x1 - image->x0 || comp->h != image->y1 - image->y0)
+            break;
+    }
+    if (bUseTiles || compno < image->numcomps) {
+        image = row_reader_to_image(*reader);
+        *reader = NULL;
+    }
+    return image;
+}
 
-    opj_cparameters_t parameters;	/* compression parameters */
+/** Frees the image, along with its reader when it is read row after row */
+static void release_image(opj_image_t *image, convert_row_reader_t *reader) {
+    if (reader)
+        row_reader_close(reader);
+    else
+        opj_image_destroy(image);
+}
+
+/** Number of tiles of the image, laid out as opj_setup_encoder does */
+static OPJ_UINT32 get_nb_tiles(const opj_cparameters_t *parameters, const opj_image_t *image) {
+    OPJ_UINT32 tdx = (OPJ_UINT32)parameters->cp_tdx, tdy = (OPJ_UINT32)parameters->cp_tdy;
+
+    if (!parameters->tile_size_on)
+        return 1;
+    return ((image->x1 - (OPJ_UINT32)parameters->cp_tx0 + tdx - 1) / tdx)
+           * ((image->y1 - (OPJ_UINT32)parameters->cp_ty0 + tdy - 1) / tdy);
+}
+
+/**
+ * Encodes an image made of a single tile by strips of STRIP_NB_ROWS rows,
+ * each one read just before being written.
+ */
+static OPJ_BOOL write_strips(opj_codec_t *l_codec, opj_stream_t *l_stream, convert_row_reader_t *reader) {
+    opj_image_t *image = row_reader_image(reader);
+    OPJ_UINT32 w = image->comps[0].w, h = image->comps[0].h;
+    OPJ_UINT32 compno, y, nb_rows;
+    OPJ_INT32 **rows;
+    OPJ_BOOL bSuccess = OPJ_TRUE;
+
+    rows = (OPJ_INT32**) calloc(image->numcomps, sizeof(OPJ_INT32*));
+    if (!rows) {
+        fprintf(stderr, "Unable to allocate memory for the rows.\n");
+        return OPJ_FALSE;
+    }
+    for (compno = 0; compno < image->numcomps && bSuccess; ++compno) {
+        rows[compno] = (OPJ_INT32*) malloc((size_t)w * STRIP_NB_ROWS * sizeof(OPJ_INT32));
+        if (!rows[compno]) {
+            fprintf(stderr, "Unable to allocate memory for the rows.\n");
+            bSuccess = OPJ_FALSE;
+        }
+    }
+
+    for (y = 0; y < h && bSuccess; y += nb_rows) {
+        nb_rows = (h - y < STRIP_NB_ROWS) ? h - y : STRIP_NB_ROWS;
+        if (!row_reader_read(reader, rows, nb_rows)) {
+            fprintf(stderr, "Unable to read the rows %d to %d\n", y, y + nb_rows);
+            bSuccess = OPJ_FALSE;
+        }
+        else if (!opj_write_strip(l_codec, rows, nb_rows, l_stream)) {
+            fprintf(stderr, "failed to encode image: opj_write_strip\n");
+            bSuccess = OPJ_FALSE;
+        }
+    }
+
+    for (compno = 0; compno < image->numcomps; ++compno)
+        free(rows[compno]);
+    free(rows);
+
+    return bSuccess;
+}
+
+/**
+ * Encodes the tiles as they are read: the rows of one row of tiles are held
+ * at a time, and each tile is handed to opj_write_tile with its samples on
+ * 1, 2 or 4 bytes depending on the precision, as opj_encode does.
+ */
+static OPJ_BOOL write_tiles(opj_codec_t *l_codec, opj_stream_t *l_stream, convert_row_reader_t *reader,
+                            const opj_cparameters_t *parameters) {
+    opj_image_t *image = row_reader_image(reader);
+    OPJ_UINT32 w = image->comps[0].w, h = image->comps[0].h;
+    OPJ_UINT32 tdx = (OPJ_UINT32)parameters->cp_tdx, tdy = (OPJ_UINT32)parameters->cp_tdy;
+    OPJ_UINT32 tx0 = (OPJ_UINT32)parameters->cp_tx0, ty0 = (OPJ_UINT32)parameters->cp_ty0;
+    OPJ_UINT32 tw = (image->x1 - tx0 + tdx - 1) / tdx, th = (image->y1 - ty0 + tdy - 1) / tdy;
+    OPJ_UINT32 band_h = (tdy < h) ? tdy : h, tile_w = (tdx < w) ? tdx : w;
+    OPJ_UINT32 compno, p, q, x, y;
+    OPJ_INT32 **rows;
+    OPJ_BYTE *l_data;
+    OPJ_BOOL bSuccess = OPJ_TRUE;
+
+    rows = (OPJ_INT32**) calloc(image->numcomps, sizeof(OPJ_INT32*));
+    l_data = (OPJ_BYTE*) malloc((size_t)tile_w * band_h * image->numcomps * sizeof(OPJ_INT32));
+    if (!rows || !l_data) {
+        fprintf(stderr, "Unable to allocate memory for the tiles.\n");
+        free(rows);
+        free(l_data);
+        return OPJ_FALSE;
+    }
+    for (compno = 0; compno < image->numcomps && bSuccess; ++compno) {
+        rows[compno] = (OPJ_INT32*) malloc((size_t)w * band_h * sizeof(OPJ_INT32));
+        if (!rows[compno]) {
+            fprintf(stderr, "Unable to allocate memory for the tiles.\n");
+            bSuccess = OPJ_FALSE;
+        }
+    }
+
+    for (q = 0; q < th && bSuccess; ++q) {
+        OPJ_UINT32 y0 = (ty0 + q * tdy > image->y0) ? ty0 + q * tdy : image->y0;
+        OPJ_UINT32 y1 = (ty0 + (q + 1) * tdy < image->y1) ? ty0 + (q + 1) * tdy : image->y1;
+
+        if (y1 < y0)	/* the tiles before the image offset are empty */
+            y1 = y0;
+        if (!row_reader_read(reader, rows, y1 - y0)) {
+            fprintf(stderr, "Unable to read the rows %d to %d\n", y0 - image->y0, y1 - image->y0);
+            bSuccess = OPJ_FALSE;
+        }
+        for (p = 0; p < tw && bSuccess; ++p) {
+            OPJ_UINT32 x0 = (tx0 + p * tdx > image->x0) ? tx0 + p * tdx : image->x0;
+            OPJ_UINT32 x1 = (tx0 + (p + 1) * tdx < image->x1) ? tx0 + (p + 1) * tdx : image->x1;
+            OPJ_BYTE *l_ptr = l_data;
+
+            if (x1 < x0)
+                x1 = x0;
+            for (compno = 0; compno < image->numcomps; ++compno) {
+                opj_image_comp_t *comp = &image->comps[compno];
+                OPJ_UINT32 l_size_comp = (comp->prec + 7) >> 3;
+
+                if (l_size_comp == 3)
+                    l_size_comp = 4;
+                for (y = 0; y < y1 - y0; ++y) {
+                    const OPJ_INT32 *l_src = rows[compno] + (size_t)y * w + (x0 - image->x0);
+
+                    for (x = 0; x < x1 - x0; ++x) {
+                        switch (l_size_comp) {
+                        case 1:
+                            *((OPJ_CHAR*)l_ptr) = comp->sgnd ? (OPJ_CHAR)l_src[x] : (OPJ_CHAR)(l_src[x] & 0xff);
+                            break;
+                        case 2:
+                            *((OPJ_INT16*)l_ptr) = comp->sgnd ? (OPJ_INT16)l_src[x] : (OPJ_INT16)(l_src[x] & 0xffff);
+                            break;
+                        default:
+                            *((OPJ_INT32*)l_ptr) = l_src[x];
+                            break;
+                        }
+                        l_ptr += l_size_comp;
+                    }
+                }
+            }
+            if (!opj_write_tile(l_codec, q * tw + p, l_data, (OPJ_UINT32)(l_ptr - l_data), l_stream)) {
+                fprintf(stderr, "failed to encode image: opj_write_tile\n");
+                bSuccess = OPJ_FALSE;
+            }
+        }
+    }
+
+    for (compno = 0; compno < image->numcomps; ++compno)
+        free(rows[compno]);
+    free(rows);
+    free(l_data);
+
+    return bSuccess;
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * Compresses the file imageno of the batch. The file gets its own copy of
+ * the command line parameters, so an error only fails this file.
+ */
+/* -------------------------------------------------------------------------- */
+static int compress_file(int imageno, opj_batch_stats_t *stats, void *user_data) {
+    opj_compress_batch_t *batch = (opj_compress_batch_t*)user_data;
+    opj_cparameters_t parameters;	/* compression parameters of this file */
+    raw_cparameters_t raw_cp = *(batch->raw_cp);
 
     opj_stream_t *l_stream = 00;
     opj_codec_t* l_codec = 00;
     opj_image_t *image = NULL;
+    convert_row_reader_t *reader = NULL;	/* image read row after row */
+
+    OPJ_UINT32 i;
+    OPJ_BOOL bSuccess;
+    OPJ_BOOL bUseTiles = OPJ_FALSE; /* OPJ_TRUE */
+    OPJ_UINT32 l_nb_tiles = 4;
+    double t;
+
+    /* cp_comment, cp_matrice and mct_data are shared, they are only read here */
+    parameters = *(batch->parameters);
+
+    fprintf(stderr,"\n");
+
+    if(batch->img_fol->set_imgdir==1){
+        char skip;
+        /* get_next_file uses strtok */
+        opj_batch_lock();
+        skip = get_next_file(imageno, batch->dirptr, batch->img_fol, &parameters);
+        opj_batch_unlock();
+        if (skip) {
+            fprintf(stderr,"skipping file...\n");
+            return OPJ_BATCH_SKIPPED;
+        }
+    }
+
+    stats->nb_bytes = opj_batch_file_size(parameters.infile);
+    t = opj_batch_clock();
+
+    switch(parameters.decod_format) {
+    case PGX_DFMT:
+        break;
+    case PXM_DFMT:
+        break;
+    case BMP_DFMT:
+        break;
+    case TIF_DFMT:
+        break;
+    case RAW_DFMT:
+    case RAWL_DFMT:
+        break;
+    case TGA_DFMT:
+        break;
+    case PNG_DFMT:
+        break;
+    default:
+        fprintf(stderr,"skipping file...\n");
+        return OPJ_BATCH_SKIPPED;
+    }
+
+    /* decode the source image */
+    /* ----------------------- */
+
+    switch (parameters.decod_format) {
+    case PGX_DFMT:
+        image = pgxtoimage(parameters.infile, &parameters);
+        if (!image) {
+            fprintf(stderr, "Unable to load pgx file\n");
+            return OPJ_BATCH_FAILED;
+        }
+        break;
+
+    case PXM_DFMT:
+        reader = pnmtorows(parameters.infile, &parameters);
+        image = rows_image(&reader, bUseTiles);
+        if (!image) {
+            fprintf(stderr, "Unable to load pnm file\n");
+            return OPJ_BATCH_FAILED;
+        }
+        break;
+
+    case BMP_DFMT:
+        image = bmptoimage(parameters.infile, &parameters);
+        if (!image) {
+            fprintf(stderr, "Unable to load bmp file\n");
+            return OPJ_BATCH_FAILED;
+        }
+        break;
+
+#ifdef OPJ_HAVE_LIBTIFF
+    case TIF_DFMT:
+        reader = tiftorows(parameters.infile, &parameters);
+        image = rows_image(&reader, bUseTiles);
+        if (!image) {
+            fprintf(stderr, "Unable to load tiff file\n");
+            return OPJ_BATCH_FAILED;
+        }
+        break;
+#endif /* OPJ_HAVE_LIBTIFF */
+
+    case RAW_DFMT:
+        reader = rawtorows(parameters.infile, &parameters, &raw_cp);
+        image = rows_image(&reader, bUseTiles);
+        if (!image) {
+            fprintf(stderr, "Unable to load raw file\n");
+            return OPJ_BATCH_FAILED;
+        }
+        break;
+
+    case RAWL_DFMT:
+        reader = rawltorows(parameters.infile, &parameters, &raw_cp);
+        image = rows_image(&reader, bUseTiles);
+        if (!image) {
+            fprintf(stderr, "Unable to load raw file\n");
+            return OPJ_BATCH_FAILED;
+        }
+        break;
+
+    case TGA_DFMT:
+        image = tgatoimage(parameters.infile, &parameters);
+        if (!image) {
+            fprintf(stderr, "Unable to load tga file\n");
+            return OPJ_BATCH_FAILED;
+        }
+        break;
+
+#ifdef OPJ_HAVE_LIBPNG
+    case PNG_DFMT:
+        reader = pngtorows(parameters.infile, &parameters);
+        image = rows_image(&reader, bUseTiles);
+        if (!image) {
+            fprintf(stderr, "Unable to load png file\n");
+            return OPJ_BATCH_FAILED;
+        }
+        break;
+#endif /* OPJ_HAVE_LIBPNG */
+    }
+
+    /* Can happen if input file is TIFF or PNG
+ * and OPJ_HAVE_LIBTIF or OPJ_HAVE_LIBPNG is undefined
+*/
+    if( !image) {
+        fprintf(stderr, "Unable to load file: got no image\n");
+        return OPJ_BATCH_FAILED;
+    }
+
+    /* Decide if MCT should be used */
+    if (parameters.tcp_mct == (char) 255) { /* mct mode has not been set in commandline */
+        parameters.tcp_mct = (image->numcomps >= 3) ? 1 : 0;
+    } else {            /* mct mode has been set in commandline */
+        if ((parameters.tcp_mct == 1) && (image->numcomps < 3)){
+            fprintf(stderr, "RGB->YCC conversion cannot be used:\n");
+            fprintf(stderr, "Input image has less than 3 components\n");
+            release_image(image, reader);
+            return OPJ_BATCH_FAILED;
+        }
+        if ((parameters.tcp_mct == 2) && (!parameters.mct_data)){
+            fprintf(stderr, "Custom MCT has been set but no array-based MCT\n");
+            fprintf(stderr, "has been provided. Aborting.\n");
+            release_image(image, reader);
+            return OPJ_BATCH_FAILED;
+        }
+    }
+
+    stats->stage_time[0] = opj_batch_clock() - t;
+    t = opj_batch_clock();
+
+    /* encode the destination image */
+    /* ---------------------------- */
+
+    switch(parameters.cod_format) {
+    case J2K_CFMT:	/* JPEG-2000 codestream */
+    {
+        /* Get a decoder handle */
+        l_codec = opj_create_compress(OPJ_CODEC_J2K);
+        break;
+    }
+    case JP2_CFMT:	/* JPEG 2000 compressed image data */
+    {
+        /* Get a decoder handle */
+        l_codec = opj_create_compress(OPJ_CODEC_JP2);
+        break;
+    }
+    default:
+        fprintf(stderr, "skipping file..\n");
+        release_image(image, reader);
+        return OPJ_BATCH_SKIPPED;
+    }
+
+    /* catch events using our callbacks and give a local context */
+    opj_set_info_handler(l_codec, info_callback,00);
+    opj_set_warning_handler(l_codec, warning_callback,00);
+    opj_set_error_handler(l_codec, error_callback,00);
+
+    if( bUseTiles ) {
+        parameters.cp_tx0 = 0;
+        parameters.cp_ty0 = 0;
+        parameters.tile_size_on = OPJ_TRUE;
+        parameters.cp_tdx = 512;
+        parameters.cp_tdy = 512;
+    }
+    opj_setup_encoder(l_codec, &parameters, image);
+    stats->stage_time[1] = opj_batch_clock() - t;
+    t = opj_batch_clock();
+
+    /* open a byte stream for writing and allocate memory for all tiles */
+    l_stream = opj_stream_create_default_file_stream(parameters.outfile,OPJ_FALSE);
+    if (! l_stream){
+        opj_destroy_codec(l_codec);
+        release_image(image, reader);
+        return OPJ_BATCH_FAILED;
+    }
+
+    /* encode the image */
+    bSuccess = opj_start_compress(l_codec,image,l_stream);
+    if (!bSuccess)  {
+        fprintf(stderr, "failed to encode image: opj_start_compress\n");
+    }
+    if( bSuccess && bUseTiles ) {
+        OPJ_BYTE *l_data;
+        OPJ_UINT32 l_data_size = 512*512*3;
+        l_data = (OPJ_BYTE*) calloc( 1,l_data_size);
+        assert( l_data );
+        for (i=0;i<l_nb_tiles;++i) {
+            if (! opj_write_tile(l_codec,i,l_data,l_data_size,l_stream)) {
+                fprintf(stderr, "ERROR -> test_tile_encoder: failed to write the tile %d!\n",i);
+                opj_stream_destroy(l_stream);
+                opj_destroy_codec(l_codec);
+                release_image(image, reader);
+                return OPJ_BATCH_FAILED;
+            }
+        }
+        free(l_data);
+    }
+    else if( bSuccess && reader ) {
+        /* the rows are read as the encoder needs them */
+        if (get_nb_tiles(&parameters, image) == 1)
+            bSuccess = write_strips(l_codec, l_stream, reader);
+        else
+            bSuccess = write_tiles(l_codec, l_stream, reader, &parameters);
+    }
+    else {
+        bSuccess = bSuccess && opj_encode(l_codec, l_stream);
+        if (!bSuccess)  {
+            fprintf(stderr, "failed to encode image: opj_encode\n");
+        }
+    }
+    bSuccess = bSuccess && opj_end_compress(l_codec, l_stream);
+    if (!bSuccess)  {
+        fprintf(stderr, "failed to encode image: opj_end_compress\n");
+    }
+
+    if (!bSuccess)  {
+        opj_stream_destroy(l_stream);
+        opj_destroy_codec(l_codec);
+        release_image(image, reader);
+        fprintf(stderr, "failed to encode image\n");
+			remove(parameters.outfile);
+        return OPJ_BATCH_FAILED;
+    }
+
+    stats->stage_time[2] = opj_batch_clock() - t;
+
+    fprintf(stdout,"[INFO] Generated outfile %s\n",parameters.outfile);
+    /* close and free the byte stream */
+    opj_stream_destroy(l_stream);
+
+    /* free remaining compression structures */
+    opj_destroy_codec(l_codec);
+
+    /* free image data */
+    release_image(image, reader);
+
+    return OPJ_BATCH_OK;
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * OPJ_COMPRESS MAIN
+ */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv) {
+
+    opj_cparameters_t parameters;	/* compression parameters */
+    opj_compress_batch_t batch;
+    opj_batch_stats_t stats;
+    static const char * const stage_names[OPJ_BATCH_NB_STAGES] = { "read", "setup", "encode" };
     raw_cparameters_t raw_cp;
 
     char indexfilename[OPJ_PATH_LEN];	/* index file name */
 
-    unsigned int i, num_images, imageno;
+    unsigned int i, num_images;
     img_fol_t img_fol;
     dircnt_t *dirptr = NULL;
-
-    OPJ_BOOL bSuccess;
-    OPJ_BOOL bUseTiles = OPJ_FALSE; /* OPJ_TRUE */
-    OPJ_UINT32 l_nb_tiles = 4;
+    unsigned int nb_failed;
 
     /* set encoding parameters to default values */
     opj_set_default_encoder_parameters(&parameters);
@@ -1604,229 +2106,14 @@ int main(int argc, char **argv) {
     }else{
         num_images=1;
     }
-    /*Encoding image one by one*/
-    for(imageno=0;imageno<num_images;imageno++)	{
-        image = NULL;
-        fprintf(stderr,"\n");
-
-        if(img_fol.set_imgdir==1){
-            if (get_next_file((int)imageno, dirptr,&img_fol, &parameters)) {
-                fprintf(stderr,"skipping file...\n");
-                continue;
-            }
-        }
-
-        switch(parameters.decod_format) {
-        case PGX_DFMT:
-            break;
-        case PXM_DFMT:
-            break;
-        case BMP_DFMT:
-            break;
-        case TIF_DFMT:
-            break;
-        case RAW_DFMT:
-        case RAWL_DFMT:
-            break;
-        case TGA_DFMT:
-            break;
-        case PNG_DFMT:
-            break;
-        default:
-            fprintf(stderr,"skipping file...\n");
-            continue;
-        }
-
-        /* decode the source image */
-        /* ----------------------- */
-
-        switch (parameters.decod_format) {
-        case PGX_DFMT:
-            image = pgxtoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load pgx file\n");
-                return 1;
-            }
-            break;
-
-        case PXM_DFMT:
-            image = pnmtoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load pnm file\n");
-                return 1;
-            }
-            break;
-
-        case BMP_DFMT:
-            image = bmptoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load bmp file\n");
-                return 1;
-            }
-            break;
-
-#ifdef OPJ_HAVE_LIBTIFF
-        case TIF_DFMT:
-            image = tiftoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load tiff file\n");
-                return 1;
-            }
-            break;
-#endif /* OPJ_HAVE_LIBTIFF */
-
-        case RAW_DFMT:
-            image = rawtoimage(parameters.infile, &parameters, &raw_cp);
-            if (!image) {
-                fprintf(stderr, "Unable to load raw file\n");
-                return 1;
-            }
-            break;
-
-        case RAWL_DFMT:
-            image = rawltoimage(parameters.infile, &parameters, &raw_cp);
-            if (!image) {
-                fprintf(stderr, "Unable to load raw file\n");
-                return 1;
-            }
-            break;
-
-        case TGA_DFMT:
-            image = tgatoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load tga file\n");
-                return 1;
-            }
-            break;
-
-#ifdef OPJ_HAVE_LIBPNG
-        case PNG_DFMT:
-            image = pngtoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load png file\n");
-                return 1;
-            }
-            break;
-#endif /* OPJ_HAVE_LIBPNG */
-        }
-
-        /* Can happen if input file is TIFF or PNG
- * and OPJ_HAVE_LIBTIF or OPJ_HAVE_LIBPNG is undefined
-*/
-        if( !image) {
-            fprintf(stderr, "Unable to load file: got no image\n");
-            return 1;
-        }
-
-        /* Decide if MCT should be used */
-        if (parameters.tcp_mct == (char) 255) { /* mct mode has not been set in commandline */
-            parameters.tcp_mct = (image->numcomps >= 3) ? 1 : 0;
-        } else {            /* mct mode has been set in commandline */
-            if ((parameters.tcp_mct == 1) && (image->numcomps < 3)){
-                fprintf(stderr, "RGB->YCC conversion cannot be used:\n");
-                fprintf(stderr, "Input image has less than 3 components\n");
-                return 1;
-            }
-            if ((parameters.tcp_mct == 2) && (!parameters.mct_data)){
-                fprintf(stderr, "Custom MCT has been set but no array-based MCT\n");
-                fprintf(stderr, "has been provided. Aborting.\n");
-                return 1;
-            }
-        }
-
-        /* encode the destination image */
-        /* ---------------------------- */
-
-        switch(parameters.cod_format) {
-        case J2K_CFMT:	/* JPEG-2000 codestream */
-        {
-            /* Get a decoder handle */
-            l_codec = opj_create_compress(OPJ_CODEC_J2K);
-            break;
-        }
-        case JP2_CFMT:	/* JPEG 2000 compressed image data */
-        {
-            /* Get a decoder handle */
-            l_codec = opj_create_compress(OPJ_CODEC_JP2);
-            break;
-        }
-        default:
-            fprintf(stderr, "skipping file..\n");
-            opj_stream_destroy(l_stream);
-            continue;
-        }
-
-        /* catch events using our callbacks and give a local context */
-        opj_set_info_handler(l_codec, info_callback,00);
-        opj_set_warning_handler(l_codec, warning_callback,00);
-        opj_set_error_handler(l_codec, error_callback,00);
-
-        if( bUseTiles ) {
-            parameters.cp_tx0 = 0;
-            parameters.cp_ty0 = 0;
-            parameters.tile_size_on = OPJ_TRUE;
-            parameters.cp_tdx = 512;
-            parameters.cp_tdy = 512;
-        }
-        opj_setup_encoder(l_codec, &parameters, image);
-
-        /* open a byte stream for writing and allocate memory for all tiles */
-        l_stream = opj_stream_create_default_file_stream(parameters.outfile,OPJ_FALSE);
-        if (! l_stream){
-            return 1;
-        }
-
-        /* encode the image */
-        bSuccess = opj_start_compress(l_codec,image,l_stream);
-        if (!bSuccess)  {
-            fprintf(stderr, "failed to encode image: opj_start_compress\n");
-        }
-        if( bSuccess && bUseTiles ) {
-            OPJ_BYTE *l_data;
-            OPJ_UINT32 l_data_size = 512*512*3;
-            l_data = (OPJ_BYTE*) calloc( 1,l_data_size);
-            assert( l_data );
-            for (i=0;i<l_nb_tiles;++i) {
-                if (! opj_write_tile(l_codec,i,l_data,l_data_size,l_stream)) {
-                    fprintf(stderr, "ERROR -> test_tile_encoder: failed to write the tile %d!\n",i);
-                    opj_stream_destroy(l_stream);
-                    opj_destroy_codec(l_codec);
-                    opj_image_destroy(image);
-                    return 1;
-                }
-            }
-            free(l_data);
-        }
-        else {
-            bSuccess = bSuccess && opj_encode(l_codec, l_stream);
-            if (!bSuccess)  {
-                fprintf(stderr, "failed to encode image: opj_encode\n");
-            }
-        }
-        bSuccess = bSuccess && opj_end_compress(l_codec, l_stream);
-        if (!bSuccess)  {
-            fprintf(stderr, "failed to encode image: opj_end_compress\n");
-        }
-
-        if (!bSuccess)  {
-            opj_stream_destroy(l_stream);
-            opj_destroy_codec(l_codec);
-            opj_image_destroy(image);
-            fprintf(stderr, "failed to encode image\n");
-			remove(parameters.outfile);
-            return 1;
-        }
-
-        fprintf(stdout,"[INFO] Generated outfile %s\n",parameters.outfile);
-        /* close and free the byte stream */
-        opj_stream_destroy(l_stream);
-
-        /* free remaining compression structures */
-        opj_destroy_codec(l_codec);
-
-        /* free image data */
-        opj_image_destroy(image);
-
+    /* Encoding images, one by one or with several threads */
+    batch.parameters = &parameters;
+    batch.raw_cp = &raw_cp;
+    batch.img_fol = &img_fol;
+    batch.dirptr = dirptr;
+    nb_failed = opj_batch_run((int)num_images, img_fol.num_threads, compress_file, &batch, &stats);
+    if(img_fol.set_imgdir==1){
+        opj_batch_print_summary(&stats, img_fol.num_threads, stage_names);
     }
 
     /* free user parameters structure */
@@ -1834,5 +2121,5 @@ int main(int argc, char **argv) {
     if(parameters.cp_matrice)   free(parameters.cp_matrice);
     if(raw_cp.rawComps) free(raw_cp.rawComps);
 
-    return 0;
+    return nb_failed ? 1 : 0;
 }
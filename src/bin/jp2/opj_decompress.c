@@ -70,6 +70,7 @@
 #include <lcms.h>
 #endif
 #include "color.h"
+#include "opj_batch.h"
 
 #include "format_defs.h"
 
@@ -90,6 +91,8 @@ typedef struct img_folder{
 	char set_imgdir;
 	/** Enable Cod Format for output*/
 	char set_out_format;
+	/** Number of threads decompressing the files of the directory*/
+	int num_threads;
 
 }img_fol_t;
 
@@ -144,6 +147,17 @@ typedef struct opj_decompress_params
 	int upsample;
 }opj_decompress_parameters;
 
+/** Files to decompress and parameters shared by the threads of a batch */
+typedef struct opj_decompress_batch
+{
+	/** command line parameters, copied for each file */
+	const opj_decompress_parameters *parameters;
+	img_fol_t *img_fol;
+	dircnt_t *dirptr;
+	/** ICC transforms shared by the files, most of them use the same profile */
+	color_icc_cache_t *icc_cache;
+}opj_decompress_batch_t;
+
 /* -------------------------------------------------------------------------- */
 /* Declarations                                                               */
 int get_num_images(char *imgdirpath);
@@ -171,6 +185,10 @@ static void decode_help_display(void) {
 	               "  -OutFor <PBM|PGM|PPM|PNM|PAM|PGX|PNG|BMP|TIF|RAW|RAWL|TGA>\n"
 	               "    REQUIRED only if -ImgDir is used\n"
 	               "	Output format for decompressed images.\n"
+	               "  -threads <number of threads>\n"
+	               "    OPTIONAL, only used with -ImgDir\n"
+	               "    Decompress the files of the directory with several threads.\n"
+	               "    A summary of the throughput is printed at the end of the batch.\n"
 	               "  -i <compressed file>\n"
 	               "    REQUIRED only if an Input image directory is not specified\n"
 	               "    Currently accepts J2K-files, JP2-files and JPT-files. The file type\n"
@@ -211,6 +229,11 @@ static void decode_help_display(void) {
 	               "    If 'C' is specified (default), values are clipped.\n"
 	               "    If 'S' is specified, values are scaled.\n"
 	               "    A 0 value can be specified (meaning original bit depth).\n"
+	               "  -c <comp 0 index>[,<comp 1 index>[,...]]\n"
+	               "    OPTIONAL\n"
+	               "    Components to decode, starting from 0 (e.g. -c 0 for the luminance of a YCC image).\n"
+	               "    The other components are skipped and left out of the output image.\n"
+	               "    By default all the components are decoded.\n"
 	               "  -force-rgb\n"
 	               "    Force output image colorspace to RGB\n"
 	               "  -upsample\n"
@@ -336,6 +359,46 @@ static OPJ_BOOL parse_precision(const char* option, opj_decompress_parameters* p
 
 /* -------------------------------------------------------------------------- */
 
+static OPJ_BOOL parse_components(const char* option, opj_decompress_parameters* parameters)
+{
+	const char* l_remaining = option;
+	OPJ_UINT32 l_nb_comps = 1U;
+	OPJ_UINT32 i;
+
+	/* reset */
+	free(parameters->core.cp_comps);
+	parameters->core.cp_comps = NULL;
+	parameters->core.cp_nb_comps = 0U;
+
+	for (i = 0U; option[i] != '\0'; ++i) {
+		if (option[i] == ',') {
+			++l_nb_comps;
+		}
+	}
+	parameters->core.cp_comps = (OPJ_UINT32*)malloc(l_nb_comps * sizeof(OPJ_UINT32));
+	if (parameters->core.cp_comps == NULL) {
+		fprintf(stderr,"Could not allocate memory for components option\n");
+		return OPJ_FALSE;
+	}
+
+	for (i = 0U; i < l_nb_comps; ++i) {
+		char* l_end;
+		long l_compno = strtol(l_remaining, &l_end, 10);
+
+		if ((l_end == l_remaining) || (l_compno < 0) || ((*l_end != ',') && (*l_end != '\0'))) {
+			fprintf(stderr,"Could not parse components option %s\n", option);
+			return OPJ_FALSE;
+		}
+		parameters->core.cp_comps[i] = (OPJ_UINT32)l_compno;
+		l_remaining = l_end + 1;
+	}
+	parameters->core.cp_nb_comps = l_nb_comps;
+
+	return OPJ_TRUE;
+}
+
+/* -------------------------------------------------------------------------- */
+
 int get_num_images(char *imgdirpath){
 	DIR *dir;
 	struct dirent* content;	
@@ -410,10 +473,10 @@ char get_next_file(int imageno,dircnt_t *dirptr,img_fol_t *img_fol, opj_decompre
 
 	strcpy(image_filename,dirptr->filename[imageno]);
 	fprintf(stderr,"File Number %d \"%s\"\n",imageno,image_filename);
-	parameters->decod_format = infile_format(image_filename);
-	if (parameters->decod_format == -1)
-		return 1;
 	sprintf(infilename,"%s/%s",img_fol->imgdirpath,image_filename);
+	parameters->decod_format = infile_format(infilename);
+	if (parameters->decod_format < 0)
+		return 1;
 	strncpy(parameters->infile, infilename, sizeof(infilename));
 
 	/*Set output file*/
@@ -496,11 +559,12 @@ int parse_cmdline_decoder(int argc, char **argv, opj_decompress_parameters *para
 	opj_option_t long_option[]={
 		{"ImgDir",    REQ_ARG, NULL ,'y'},
 		{"OutFor",    REQ_ARG, NULL ,'O'},
+		{"threads",   REQ_ARG, NULL ,'N'},
 		{"force-rgb", NO_ARG,  &(parameters->force_rgb), 1},
 		{"upsample",  NO_ARG,  &(parameters->upsample),  1}
 	};
 
-	const char optlist[] = "i:o:r:l:x:d:t:p:"
+	const char optlist[] = "i:o:r:l:x:d:t:p:c:"
 
 /* UniPG>> */
 #ifdef USE_JPWL
@@ -511,6 +575,7 @@ int parse_cmdline_decoder(int argc, char **argv, opj_decompress_parameters *para
 	totlen=sizeof(long_option);
 	opj_reset_options_reading();
 	img_fol->set_out_format = 0;
+	img_fol->num_threads = 1;
 	do {
 		c = opj_getopt_long(argc, argv,optlist,long_option,totlen);
 		if (c == -1)
@@ -654,6 +719,21 @@ int parse_cmdline_decoder(int argc, char **argv, opj_decompress_parameters *para
 
 				/* ----------------------------------------------------- */
 
+			case 'N':			/* Number of threads of the batch mode */
+				{
+					if ((sscanf(opj_optarg, "%d", &img_fol->num_threads) != 1) || (img_fol->num_threads < 1)) {
+						fprintf(stderr, "[ERROR] -threads expects a number of threads greater than 0\n");
+						return 1;
+					}
+					if ((img_fol->num_threads > 1) && !opj_batch_has_threads()) {
+						fprintf(stderr, "[WARNING] threads are not supported by this build, -threads is ignored\n");
+						img_fol->num_threads = 1;
+					}
+				}
+				break;
+
+				/* ----------------------------------------------------- */
+
 			case 'd':     		/* Input decode ROI */
 			{
 				int size_optarg = (int)strlen(opj_optarg) + 1;
@@ -696,6 +776,15 @@ int parse_cmdline_decoder(int argc, char **argv, opj_decompress_parameters *para
 				}
 				break;
 				/* ----------------------------------------------------- */
+			case 'c': /* Components to decode */
+				{
+					if (!parse_components(opj_optarg, parameters))
+					{
+						return 1;
+					}
+				}
+				break;
+				/* ----------------------------------------------------- */
 				
 				/* UniPG>> */
 #ifdef USE_JPWL
@@ -879,6 +968,8 @@ static void destroy_parameters(opj_decompress_parameters* parameters)
 			free(parameters->precision);
 			parameters->precision = NULL;
 		}
+		free(parameters->core.cp_comps);
+		parameters->core.cp_comps = NULL;
 	}
 }
 
@@ -1112,389 +1203,427 @@ static opj_image_t* upsample_image_components(opj_image_t* original)
 
 /* -------------------------------------------------------------------------- */
 /**
- * OPJ_DECOMPRESS MAIN
+ * Decompresses the file imageno of the batch. The file gets its own copy of
+ * the command line parameters, so an error only fails this file.
  */
 /* -------------------------------------------------------------------------- */
-int main(int argc, char **argv)
+static int decompress_file(int imageno, opj_batch_stats_t *stats, void *user_data)
 {
-	opj_decompress_parameters parameters;			/* decompression parameters */
+	opj_decompress_batch_t *batch = (opj_decompress_batch_t*)user_data;
+	opj_decompress_parameters parameters;	/* decompression parameters of this file */
 	opj_image_t* image = NULL;
 	opj_stream_t *l_stream = NULL;				/* Stream */
 	opj_codec_t* l_codec = NULL;				/* Handle to a decompressor */
-	opj_codestream_index_t* cstr_index = NULL;
-
-	char indexfilename[OPJ_PATH_LEN];	/* index file name */
+	double t;
+	int failed = 0;
+
+	/* the precision and component arrays are shared, they are only read here */
+	parameters = *(batch->parameters);
+
+	fprintf(stderr,"\n");
+
+	if(batch->img_fol->set_imgdir==1){
+		char skip;
+		/* get_next_file uses strtok */
+		opj_batch_lock();
+		skip = get_next_file(imageno, batch->dirptr, batch->img_fol, &parameters);
+		opj_batch_unlock();
+		if (skip) {
+			fprintf(stderr,"skipping file...\n");
+			return OPJ_BATCH_SKIPPED;
+		}
+	}
 
-	OPJ_INT32 num_images, imageno;
-	img_fol_t img_fol;
-	dircnt_t *dirptr = NULL;
-  int failed = 0;
+	stats->nb_bytes = opj_batch_file_size(parameters.infile);
+	t = opj_batch_clock();
 
-	/* set decoding parameters to default values */
-	set_default_parameters(&parameters);
+	/* read the input file and put it in memory */
+	/* ---------------------------------------- */
 
-	/* FIXME Initialize indexfilename and img_fol */
-	*indexfilename = 0;
-
-	/* Initialize img_fol */
-	memset(&img_fol,0,sizeof(img_fol_t));
-
-	/* parse input and get user encoding parameters */
-	if(parse_cmdline_decoder(argc, argv, &parameters,&img_fol, indexfilename) == 1) {
-		destroy_parameters(&parameters);
-		return EXIT_FAILURE;
+	l_stream = opj_stream_create_default_file_stream(parameters.infile,1);
+	if (!l_stream){
+		fprintf(stderr, "ERROR -> failed to create the stream from the file %s\n", parameters.infile);
+		return OPJ_BATCH_FAILED;
 	}
 
-	/* Initialize reading of directory */
-	if(img_fol.set_imgdir==1){	
-		int it_image;
-		num_images=get_num_images(img_fol.imgdirpath);
+	/* decode the JPEG2000 stream */
+	/* ---------------------- */
 
-		dirptr=(dircnt_t*)malloc(sizeof(dircnt_t));
-		if(dirptr){
-			dirptr->filename_buf = (char*)malloc((size_t)num_images*OPJ_PATH_LEN*sizeof(char));	/* Stores at max 10 image file names*/
-			dirptr->filename = (char**) malloc((size_t)num_images*sizeof(char*));
-
-			if(!dirptr->filename_buf){
-				destroy_parameters(&parameters);
-				return EXIT_FAILURE;
-			}
-			for(it_image=0;it_image<num_images;it_image++){
-				dirptr->filename[it_image] = dirptr->filename_buf + it_image*OPJ_PATH_LEN;
-			}
+	switch(parameters.decod_format) {
+		case J2K_CFMT:	/* JPEG-2000 codestream */
+		{
+			/* Get a decoder handle */
+			l_codec = opj_create_decompress(OPJ_CODEC_J2K);
+			break;
 		}
-		if(load_images(dirptr,img_fol.imgdirpath)==1){
-			destroy_parameters(&parameters);
-			return EXIT_FAILURE;
+		case JP2_CFMT:	/* JPEG 2000 compressed image data */
+		{
+			/* Get a decoder handle */
+			l_codec = opj_create_decompress(OPJ_CODEC_JP2);
+			break;
 		}
-		if (num_images==0){
-			fprintf(stdout,"Folder is empty\n");
-			destroy_parameters(&parameters);
-			return EXIT_FAILURE;
+		case JPT_CFMT:	/* JPEG 2000, JPIP */
+		{
+			/* Get a decoder handle */
+			l_codec = opj_create_decompress(OPJ_CODEC_JPT);
+			break;
 		}
-	}else{
-		num_images=1;
+		default:
+			fprintf(stderr, "skipping file..\n");
+			opj_stream_destroy(l_stream);
+			return OPJ_BATCH_SKIPPED;
 	}
 
-	/*Decoding image one by one*/
-	for(imageno = 0; imageno < num_images ; imageno++)	{
-
-		fprintf(stderr,"\n");
+	/* catch events using our callbacks and give a local context */		
+	opj_set_info_handler(l_codec, info_callback,00);
+	opj_set_warning_handler(l_codec, warning_callback,00);
+	opj_set_error_handler(l_codec, error_callback,00);
 
-		if(img_fol.set_imgdir==1){
-			if (get_next_file(imageno, dirptr,&img_fol, &parameters)) {
-				fprintf(stderr,"skipping file...\n");
-				destroy_parameters(&parameters);
-				continue;
-			}
-		}
-
-		/* read the input file and put it in memory */
-		/* ---------------------------------------- */
-
-		l_stream = opj_stream_create_default_file_stream(parameters.infile,1);
-		if (!l_stream){
-			fprintf(stderr, "ERROR -> failed to create the stream from the file %s\n", parameters.infile);
-			destroy_parameters(&parameters);
-			return EXIT_FAILURE;
-		}
+	/* Setup the decoder decoding parameters using user parameters */
+	if ( !opj_setup_decoder(l_codec, &(parameters.core)) ){
+		fprintf(stderr, "ERROR -> opj_compress: failed to setup the decoder\n");
+		opj_stream_destroy(l_stream);
+		opj_destroy_codec(l_codec);
+		return OPJ_BATCH_FAILED;
+	}
 
-		/* decode the JPEG2000 stream */
-		/* ---------------------- */
 
-		switch(parameters.decod_format) {
-			case J2K_CFMT:	/* JPEG-2000 codestream */
-			{
-				/* Get a decoder handle */
-				l_codec = opj_create_decompress(OPJ_CODEC_J2K);
-				break;
-			}
-			case JP2_CFMT:	/* JPEG 2000 compressed image data */
-			{
-				/* Get a decoder handle */
-				l_codec = opj_create_decompress(OPJ_CODEC_JP2);
-				break;
-			}
-			case JPT_CFMT:	/* JPEG 2000, JPIP */
-			{
-				/* Get a decoder handle */
-				l_codec = opj_create_decompress(OPJ_CODEC_JPT);
-				break;
-			}
-			default:
-				fprintf(stderr, "skipping file..\n");
-				destroy_parameters(&parameters);
-				opj_stream_destroy(l_stream);
-				continue;
-		}
-
-		/* catch events using our callbacks and give a local context */		
-		opj_set_info_handler(l_codec, info_callback,00);
-		opj_set_warning_handler(l_codec, warning_callback,00);
-		opj_set_error_handler(l_codec, error_callback,00);
+	/* Read the main header of the codestream and if necessary the JP2 boxes*/
+	if(! opj_read_header(l_stream, l_codec, &image)){
+		fprintf(stderr, "ERROR -> opj_decompress: failed to read the header\n");
+		opj_stream_destroy(l_stream);
+		opj_destroy_codec(l_codec);
+		opj_image_destroy(image);
+		return OPJ_BATCH_FAILED;
+	}
 
-		/* Setup the decoder decoding parameters using user parameters */
-		if ( !opj_setup_decoder(l_codec, &(parameters.core)) ){
-			fprintf(stderr, "ERROR -> opj_compress: failed to setup the decoder\n");
-			destroy_parameters(&parameters);
+	if (!parameters.nb_tile_to_decode) {
+		/* Optional if you want decode the entire image */
+		if (!opj_set_decode_area(l_codec, image, (OPJ_INT32)parameters.DA_x0,
+				(OPJ_INT32)parameters.DA_y0, (OPJ_INT32)parameters.DA_x1, (OPJ_INT32)parameters.DA_y1)){
+			fprintf(stderr,	"ERROR -> opj_decompress: failed to set the decoded area\n");
 			opj_stream_destroy(l_stream);
 			opj_destroy_codec(l_codec);
-			return EXIT_FAILURE;
+			opj_image_destroy(image);
+			return OPJ_BATCH_FAILED;
 		}
 
-
-		/* Read the main header of the codestream and if necessary the JP2 boxes*/
-		if(! opj_read_header(l_stream, l_codec, &image)){
-			fprintf(stderr, "ERROR -> opj_decompress: failed to read the header\n");
-			destroy_parameters(&parameters);
-			opj_stream_destroy(l_stream);
+		/* Get the decoded image */
+		if (!(opj_decode(l_codec, l_stream, image) && opj_end_decompress(l_codec,	l_stream))) {
+			fprintf(stderr,"ERROR -> opj_decompress: failed to decode image!\n");
 			opj_destroy_codec(l_codec);
+			opj_stream_destroy(l_stream);
 			opj_image_destroy(image);
-			return EXIT_FAILURE;
+			return OPJ_BATCH_FAILED;
 		}
+	}
+	else {
 
-		if (!parameters.nb_tile_to_decode) {
-			/* Optional if you want decode the entire image */
-			if (!opj_set_decode_area(l_codec, image, (OPJ_INT32)parameters.DA_x0,
-					(OPJ_INT32)parameters.DA_y0, (OPJ_INT32)parameters.DA_x1, (OPJ_INT32)parameters.DA_y1)){
-				fprintf(stderr,	"ERROR -> opj_decompress: failed to set the decoded area\n");
-				destroy_parameters(&parameters);
-				opj_stream_destroy(l_stream);
-				opj_destroy_codec(l_codec);
-				opj_image_destroy(image);
-				return EXIT_FAILURE;
-			}
-
-			/* Get the decoded image */
-			if (!(opj_decode(l_codec, l_stream, image) && opj_end_decompress(l_codec,	l_stream))) {
-				fprintf(stderr,"ERROR -> opj_decompress: failed to decode image!\n");
-				destroy_parameters(&parameters);
-				opj_destroy_codec(l_codec);
-				opj_stream_destroy(l_stream);
-				opj_image_destroy(image);
-				return EXIT_FAILURE;
-			}
-		}
-		else {
-
-			/* It is just here to illustrate how to use the resolution after set parameters */
-			/*if (!opj_set_decoded_resolution_factor(l_codec, 5)) {
-				fprintf(stderr, "ERROR -> opj_decompress: failed to set the resolution factor tile!\n");
-				opj_destroy_codec(l_codec);
-				opj_stream_destroy(l_stream);
-				opj_image_destroy(image);
-				return EXIT_FAILURE;
-			}*/
+		/* It is just here to illustrate how to use the resolution after set parameters */
+		/*if (!opj_set_decoded_resolution_factor(l_codec, 5)) {
+			fprintf(stderr, "ERROR -> opj_decompress: failed to set the resolution factor tile!\n");
+			opj_destroy_codec(l_codec);
+			opj_stream_destroy(l_stream);
+			opj_image_destroy(image);
+			return OPJ_BATCH_FAILED;
+		}*/
 
-			if (!opj_get_decoded_tile(l_codec, l_stream, image, parameters.tile_index)) {
-				fprintf(stderr, "ERROR -> opj_decompress: failed to decode tile!\n");
-				destroy_parameters(&parameters);
-				opj_destroy_codec(l_codec);
-				opj_stream_destroy(l_stream);
-				opj_image_destroy(image);
-				return EXIT_FAILURE;
-			}
-			fprintf(stdout, "tile %d is decoded!\n\n", parameters.tile_index);
+		if (!opj_get_decoded_tile(l_codec, l_stream, image, parameters.tile_index)) {
+			fprintf(stderr, "ERROR -> opj_decompress: failed to decode tile!\n");
+			opj_destroy_codec(l_codec);
+			opj_stream_destroy(l_stream);
+			opj_image_destroy(image);
+			return OPJ_BATCH_FAILED;
 		}
+		fprintf(stdout, "tile %d is decoded!\n\n", parameters.tile_index);
+	}
 
-		/* Close the byte stream */
-		opj_stream_destroy(l_stream);
+	/* Close the byte stream */
+	opj_stream_destroy(l_stream);
+	stats->stage_time[0] = opj_batch_clock() - t;
+	t = opj_batch_clock();
 
-		if(image->color_space == OPJ_CLRSPC_SYCC){
-			color_sycc_to_rgb(image); /* FIXME */
-		}
-		
-		if( image->color_space != OPJ_CLRSPC_SYCC 
-			&& image->numcomps == 3 && image->comps[0].dx == image->comps[0].dy
-			&& image->comps[1].dx != 1 )
-			image->color_space = OPJ_CLRSPC_SYCC;
-		else if (image->numcomps <= 2)
-			image->color_space = OPJ_CLRSPC_GRAY;
-
-		if(image->icc_profile_buf) {
+	if(image->color_space == OPJ_CLRSPC_SYCC){
+		color_sycc_to_rgb(image); /* FIXME */
+	}
+	
+	if( image->color_space != OPJ_CLRSPC_SYCC 
+		&& image->numcomps == 3 && image->comps[0].dx == image->comps[0].dy
+		&& image->comps[1].dx != 1 )
+		image->color_space = OPJ_CLRSPC_SYCC;
+	else if (image->numcomps <= 2)
+		image->color_space = OPJ_CLRSPC_GRAY;
+
+	if(image->icc_profile_buf) {
 #if defined(OPJ_HAVE_LIBLCMS1) || defined(OPJ_HAVE_LIBLCMS2)
-			color_apply_icc_profile(image); /* FIXME */
+		color_apply_icc_profile_cached(image, batch->icc_cache); /* FIXME */
 #endif
-			free(image->icc_profile_buf);
-			image->icc_profile_buf = NULL; image->icc_profile_len = 0;
-		}
-		
-		/* Force output precision */
-		/* ---------------------- */
-		if (parameters.precision != NULL)
+		free(image->icc_profile_buf);
+		image->icc_profile_buf = NULL; image->icc_profile_len = 0;
+	}
+	
+	/* Force output precision */
+	/* ---------------------- */
+	if (parameters.precision != NULL)
+	{
+		OPJ_UINT32 compno;
+		for (compno = 0; compno < image->numcomps; ++compno)
 		{
-			OPJ_UINT32 compno;
-			for (compno = 0; compno < image->numcomps; ++compno)
-			{
-				OPJ_UINT32 precno = compno;
-				OPJ_UINT32 prec;
-				
-				if (precno >= parameters.nb_precision) {
-					precno = parameters.nb_precision - 1U;
-				}
-				
-				prec = parameters.precision[precno].prec;
-				if (prec == 0) {
-					prec = image->comps[compno].prec;
-				}
-				
-				switch (parameters.precision[precno].mode) {
-					case OPJ_PREC_MODE_CLIP:
-						clip_component(&(image->comps[compno]), prec);
-						break;
-					case OPJ_PREC_MODE_SCALE:
-						scale_component(&(image->comps[compno]), prec);
-						break;
-					default:
-						break;
-				}
-				
+			OPJ_UINT32 precno = compno;
+			OPJ_UINT32 prec;
+			
+			if (precno >= parameters.nb_precision) {
+				precno = parameters.nb_precision - 1U;
 			}
-		}
-		
-		/* Upsample components */
-		/* ------------------- */
-		if (parameters.upsample)
-		{
-			image = upsample_image_components(image);
-			if (image == NULL) {
-				fprintf(stderr, "ERROR -> opj_decompress: failed to upsample image components!\n");
-				destroy_parameters(&parameters);
-				opj_destroy_codec(l_codec);
-				return EXIT_FAILURE;
+			
+			prec = parameters.precision[precno].prec;
+			if (prec == 0) {
+				prec = image->comps[compno].prec;
 			}
-		}
-		
-		/* Force RGB output */
-		/* ---------------- */
-		if (parameters.force_rgb)
-		{
-			switch (image->color_space) {
-				case OPJ_CLRSPC_SRGB:
+			
+			switch (parameters.precision[precno].mode) {
+				case OPJ_PREC_MODE_CLIP:
+					clip_component(&(image->comps[compno]), prec);
 					break;
-				case OPJ_CLRSPC_GRAY:
-					image = convert_gray_to_rgb(image);
+				case OPJ_PREC_MODE_SCALE:
+					scale_component(&(image->comps[compno]), prec);
 					break;
 				default:
-					fprintf(stderr, "ERROR -> opj_decompress: don't know how to convert image to RGB colorspace!\n");
-					opj_image_destroy(image);
-					image = NULL;
 					break;
 			}
-			if (image == NULL) {
-				fprintf(stderr, "ERROR -> opj_decompress: failed to convert to RGB image!\n");
-				destroy_parameters(&parameters);
-				opj_destroy_codec(l_codec);
-				return EXIT_FAILURE;
-			}
+			
 		}
+	}
+	
+	/* Upsample components */
+	/* ------------------- */
+	if (parameters.upsample)
+	{
+		image = upsample_image_components(image);
+		if (image == NULL) {
+			fprintf(stderr, "ERROR -> opj_decompress: failed to upsample image components!\n");
+			opj_destroy_codec(l_codec);
+			return OPJ_BATCH_FAILED;
+		}
+	}
+	
+	/* Force RGB output */
+	/* ---------------- */
+	if (parameters.force_rgb)
+	{
+		switch (image->color_space) {
+			case OPJ_CLRSPC_SRGB:
+				break;
+			case OPJ_CLRSPC_GRAY:
+				image = convert_gray_to_rgb(image);
+				break;
+			default:
+				fprintf(stderr, "ERROR -> opj_decompress: don't know how to convert image to RGB colorspace!\n");
+				opj_image_destroy(image);
+				image = NULL;
+				break;
+		}
+		if (image == NULL) {
+			fprintf(stderr, "ERROR -> opj_decompress: failed to convert to RGB image!\n");
+			opj_destroy_codec(l_codec);
+			return OPJ_BATCH_FAILED;
+		}
+	}
+
+	stats->stage_time[1] = opj_batch_clock() - t;
+	t = opj_batch_clock();
 
-		/* create output image */
-		/* ------------------- */
-		switch (parameters.cod_format) {
-		case PXM_DFMT:			/* PNM PGM PPM */
-			if (imagetopnm(image, parameters.outfile)) {
+	/* create output image */
+	/* ------------------- */
+	switch (parameters.cod_format) {
+	case PXM_DFMT:			/* PNM PGM PPM */
+		if (imagetopnm(image, parameters.outfile)) {
                 fprintf(stderr,"[ERROR] Outfile %s not generated\n",parameters.outfile);
         failed = 1;
-			}
-			else {
+		}
+		else {
                 fprintf(stdout,"[INFO] Generated Outfile %s\n",parameters.outfile);
-			}
-			break;
+		}
+		break;
 
-		case PGX_DFMT:			/* PGX */
-			if(imagetopgx(image, parameters.outfile)){
+	case PGX_DFMT:			/* PGX */
+		if(imagetopgx(image, parameters.outfile)){
                 fprintf(stderr,"[ERROR] Outfile %s not generated\n",parameters.outfile);
         failed = 1;
-			}
-			else {
+		}
+		else {
                 fprintf(stdout,"[INFO] Generated Outfile %s\n",parameters.outfile);
-			}
-			break;
+		}
+		break;
 
-		case BMP_DFMT:			/* BMP */
-			if(imagetobmp(image, parameters.outfile)){
+	case BMP_DFMT:			/* BMP */
+		if(imagetobmp(image, parameters.outfile)){
                 fprintf(stderr,"[ERROR] Outfile %s not generated\n",parameters.outfile);
         failed = 1;
-			}
-			else {
+		}
+		else {
                 fprintf(stdout,"[INFO] Generated Outfile %s\n",parameters.outfile);
-			}
-			break;
+		}
+		break;
 #ifdef OPJ_HAVE_LIBTIFF
-		case TIF_DFMT:			/* TIFF */
-			if(imagetotif(image, parameters.outfile)){
+	case TIF_DFMT:			/* TIFF */
+		if(imagetotif(image, parameters.outfile)){
                 fprintf(stderr,"[ERROR] Outfile %s not generated\n",parameters.outfile);
         failed = 1;
-			}
-			else {
+		}
+		else {
                 fprintf(stdout,"[INFO] Generated Outfile %s\n",parameters.outfile);
-			}
-			break;
+		}
+		break;
 #endif /* OPJ_HAVE_LIBTIFF */
-		case RAW_DFMT:			/* RAW */
-			if(imagetoraw(image, parameters.outfile)){
+	case RAW_DFMT:			/* RAW */
+		if(imagetoraw(image, parameters.outfile)){
                 fprintf(stderr,"[ERROR] Error generating raw file. Outfile %s not generated\n",parameters.outfile);
         failed = 1;
-			}
-			else {
+		}
+		else {
                 fprintf(stdout,"[INFO] Generated Outfile %s\n",parameters.outfile);
-			}
-			break;
+		}
+		break;
 
-		case RAWL_DFMT:			/* RAWL */
-			if(imagetorawl(image, parameters.outfile)){
+	case RAWL_DFMT:			/* RAWL */
+		if(imagetorawl(image, parameters.outfile)){
                 fprintf(stderr,"[ERROR] Error generating rawl file. Outfile %s not generated\n",parameters.outfile);
         failed = 1;
-			}
-			else {
+		}
+		else {
                 fprintf(stdout,"[INFO] Generated Outfile %s\n",parameters.outfile);
-			}
-			break;
+		}
+		break;
 
-		case TGA_DFMT:			/* TGA */
-			if(imagetotga(image, parameters.outfile)){
+	case TGA_DFMT:			/* TGA */
+		if(imagetotga(image, parameters.outfile)){
                 fprintf(stderr,"[ERROR] Error generating tga file. Outfile %s not generated\n",parameters.outfile);
         failed = 1;
-			}
-			else {
+		}
+		else {
                 fprintf(stdout,"[INFO] Generated Outfile %s\n",parameters.outfile);
-			}
-			break;
+		}
+		break;
 #ifdef OPJ_HAVE_LIBPNG
-		case PNG_DFMT:			/* PNG */
-			if(imagetopng(image, parameters.outfile)){
+	case PNG_DFMT:			/* PNG */
+		if(imagetopng(image, parameters.outfile)){
                 fprintf(stderr,"[ERROR] Error generating png file. Outfile %s not generated\n",parameters.outfile);
         failed = 1;
-			}
-			else {
+		}
+		else {
                 fprintf(stdout,"[INFO] Generated Outfile %s\n",parameters.outfile);
-			}
-			break;
+		}
+		break;
 #endif /* OPJ_HAVE_LIBPNG */
 /* Can happen if output file is TIFF or PNG
  * and OPJ_HAVE_LIBTIF or OPJ_HAVE_LIBPNG is undefined
 */
-			default:
+		default:
                 fprintf(stderr,"[ERROR] Outfile %s not generated\n",parameters.outfile);
         failed = 1;
-		}
+	}
 
-		/* free remaining structures */
-		if (l_codec) {
-			opj_destroy_codec(l_codec);
-		}
+	stats->stage_time[2] = opj_batch_clock() - t;
 
+	/* free remaining structures */
+	if (l_codec) {
+		opj_destroy_codec(l_codec);
+	}
 
-		/* free image data structure */
-		opj_image_destroy(image);
 
-		/* destroy the codestream index */
-		opj_destroy_cstr_index(&cstr_index);
+	/* free image data structure */
+	opj_image_destroy(image);
+
+	if(failed) {
+		remove(parameters.outfile);
+		return OPJ_BATCH_FAILED;
+	}
+	return OPJ_BATCH_OK;
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * OPJ_DECOMPRESS MAIN
+ */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+	opj_decompress_parameters parameters;			/* decompression parameters */
+	opj_decompress_batch_t batch;
+	opj_batch_stats_t stats;
+	static const char * const stage_names[OPJ_BATCH_NB_STAGES] = { "decode", "convert", "write" };
+
+	char indexfilename[OPJ_PATH_LEN];	/* index file name */
+
+	OPJ_INT32 num_images;
+	img_fol_t img_fol;
+	dircnt_t *dirptr = NULL;
+	unsigned int nb_failed;
+
+	/* set decoding parameters to default values */
+	set_default_parameters(&parameters);
+
+	/* FIXME Initialize indexfilename and img_fol */
+	*indexfilename = 0;
+
+	/* Initialize img_fol */
+	memset(&img_fol,0,sizeof(img_fol_t));
+
+	/* parse input and get user encoding parameters */
+	if(parse_cmdline_decoder(argc, argv, &parameters,&img_fol, indexfilename) == 1) {
+		destroy_parameters(&parameters);
+		return EXIT_FAILURE;
+	}
 
-		if(failed) remove(parameters.outfile);
+	/* Initialize reading of directory */
+	if(img_fol.set_imgdir==1){	
+		int it_image;
+		num_images=get_num_images(img_fol.imgdirpath);
+
+		dirptr=(dircnt_t*)malloc(sizeof(dircnt_t));
+		if(dirptr){
+			dirptr->filename_buf = (char*)malloc((size_t)num_images*OPJ_PATH_LEN*sizeof(char));	/* Stores at max 10 image file names*/
+			dirptr->filename = (char**) malloc((size_t)num_images*sizeof(char*));
+
+			if(!dirptr->filename_buf){
+				destroy_parameters(&parameters);
+				return EXIT_FAILURE;
+			}
+			for(it_image=0;it_image<num_images;it_image++){
+				dirptr->filename[it_image] = dirptr->filename_buf + it_image*OPJ_PATH_LEN;
+			}
+		}
+		if(load_images(dirptr,img_fol.imgdirpath)==1){
+			destroy_parameters(&parameters);
+			return EXIT_FAILURE;
+		}
+		if (num_images==0){
+			fprintf(stdout,"Folder is empty\n");
+			destroy_parameters(&parameters);
+			return EXIT_FAILURE;
+		}
+	}else{
+		num_images=1;
+	}
+
+	/* Decoding images, one by one or with several threads */
+	batch.parameters = &parameters;
+	batch.img_fol = &img_fol;
+	batch.dirptr = dirptr;
+	batch.icc_cache = NULL;
+#if defined(OPJ_HAVE_LIBLCMS1) || defined(OPJ_HAVE_LIBLCMS2)
+	batch.icc_cache = color_icc_cache_create(opj_batch_lock, opj_batch_unlock);
+#endif
+	nb_failed = opj_batch_run(num_images, img_fol.num_threads, decompress_file, &batch, &stats);
+	if(img_fol.set_imgdir==1){
+		opj_batch_print_summary(&stats, img_fol.num_threads, stage_names);
 	}
+#if defined(OPJ_HAVE_LIBLCMS1) || defined(OPJ_HAVE_LIBLCMS2)
+	color_icc_cache_destroy(batch.icc_cache);
+#endif
+
 	destroy_parameters(&parameters);
-	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	return nb_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 /*end main*/
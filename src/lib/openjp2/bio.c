@@ -50,11 +50,23 @@ Write a bit
 */
 static void opj_bio_putbit(opj_bio_t *bio, OPJ_UINT32 b);
 /**
-Read a bit
+Fill the decoder cache with the next bytes of the buffer, up to 57 bits at least
 @param bio BIO handle
-@return Returns the read bit
 */
-static OPJ_UINT32 opj_bio_getbit(opj_bio_t *bio);
+static void opj_bio_fill(opj_bio_t *bio);
+/**
+Give back to the buffer the bytes of the decoder cache not started yet, so that
+bp, buf and ct hold the state of a decoder reading the buffer bit by bit.
+The cache keeps the bits left in the current byte.
+@param bio BIO handle
+*/
+static void opj_bio_unfill(opj_bio_t *bio);
+/**
+Number of leading 0 bits of a 64 bits value
+@param v Value
+@return Returns the number of leading 0 bits, 64 if v is 0
+*/
+static INLINE OPJ_UINT32 opj_bio_clz64(OPJ_UINT64 v);
 /**
 Write a byte
 @param bio BIO handle
@@ -98,20 +110,98 @@ OPJ_BOOL opj_bio_bytein(opj_bio_t *bio) {
 	return OPJ_TRUE;
 }
 
-void opj_bio_putbit(opj_bio_t *bio, OPJ_UINT32 b) {
-	if (bio->ct == 0) {
-		opj_bio_byteout(bio); /* MSD: why not check the return value of this function ? */
+void opj_bio_fill(opj_bio_t *bio) {
+	/* the byte following 0xFF only carries 7 bits */
+	OPJ_UINT32 l_last = bio->overflow ? 0 : (bio->bp > bio->start ? bio->bp[-1] : 0);
+
+	if (l_last != 0xff && bio->cache_bits <= 56 && (OPJ_SIZE_T)(bio->end - bio->bp) >= 8) {
+		/* whole bytes at once, when no 0xFF byte is followed by another one in the cache */
+		OPJ_UINT32 l_nb_bytes = (64 - bio->cache_bits) >> 3;
+		OPJ_UINT64 l_word = 0, l_check;
+		OPJ_UINT32 i;
+
+		for (i = 0; i < 8; ++i) {
+			l_word = (l_word << 8) | bio->bp[i];
+		}
+		l_word &= ~(OPJ_UINT64)0 << (64 - 8 * l_nb_bytes);
+		/* bytes equal to 0xFF, the last one aside, are the 0 bytes of l_check */
+		l_check = ~l_word | ~(~(OPJ_UINT64)0 << (64 - 8 * (l_nb_bytes - 1)));
+		if (l_nb_bytes == 1 || !((l_check - 0x0101010101010101ULL) & ~l_check & 0x8080808080808080ULL)) {
+			bio->cache |= l_word >> bio->cache_bits;
+			bio->cache_bits += 8 * l_nb_bytes;
+			bio->bp += l_nb_bytes;
+			return;
+		}
+	}
+
+	while (bio->cache_bits <= 56) {
+		OPJ_UINT32 l_width = (l_last == 0xff) ? 7 : 8;
+		OPJ_UINT32 l_byte = 0;
+
+		if ((OPJ_SIZE_T)bio->bp < (OPJ_SIZE_T)bio->end) {
+			l_byte = *bio->bp++;
+		}
+		else {
+			/* past the end of the buffer, as opj_bio_bytein */
+			++bio->overflow;
+		}
+		bio->cache |= (OPJ_UINT64)(l_byte & ((1U << l_width) - 1)) << (64 - bio->cache_bits - l_width);
+		bio->cache_bits += l_width;
+		l_last = l_byte;
 	}
-	bio->ct--;
-	bio->buf |= b << bio->ct;
 }
 
-OPJ_UINT32 opj_bio_getbit(opj_bio_t *bio) {
+void opj_bio_unfill(opj_bio_t *bio) {
+	OPJ_UINT32 l_width;
+
+	/* bytes read past the end of the buffer, the first one follows the last byte of the buffer */
+	while (bio->overflow) {
+		l_width = (bio->overflow == 1 && bio->bp > bio->start && bio->bp[-1] == 0xff) ? 7 : 8;
+		if (bio->cache_bits < l_width) {
+			break;
+		}
+		bio->cache_bits -= l_width;
+		--bio->overflow;
+	}
+	/* bytes of the buffer */
+	if (! bio->overflow) {
+		while (bio->bp > bio->start) {
+			l_width = (bio->bp - 1 > bio->start && bio->bp[-2] == 0xff) ? 7 : 8;
+			if (bio->cache_bits < l_width) {
+				break;
+			}
+			bio->cache_bits -= l_width;
+			--bio->bp;
+		}
+	}
+
+	/* the remaining bits are the end of the current byte */
+	bio->ct = bio->cache_bits;
+	bio->buf = bio->overflow ? 0 : (bio->bp > bio->start ? bio->bp[-1] : 0);
+}
+
+OPJ_UINT32 opj_bio_clz64(OPJ_UINT64 v) {
+#if defined(__GNUC__)
+	return v ? (OPJ_UINT32)__builtin_clzll(v) : 64;
+#else
+	OPJ_UINT32 n = 0;
+	if (! v) {
+		return 64;
+	}
+	while (! (v & ((OPJ_UINT64)1 << 63))) {
+		v <<= 1;
+		++n;
+	}
+	return n;
+#endif
+}
+
+void opj_bio_putbit(opj_bio_t *bio, OPJ_UINT32 b) {
 	if (bio->ct == 0) {
-		opj_bio_bytein(bio); /* MSD: why not check the return value of this function ? */
+		opj_bio_byteout(bio); /* MSD: why not check the return value of this function ? */
 	}
 	bio->ct--;
-	return (bio->buf >> bio->ct) & 1;
+	bio->buf |= b << bio->ct;
 }
 
 /* 
@@ -132,6 +222,9 @@ void opj_bio_destroy(opj_bio_t *bio) {
 }
 
 ptrdiff_t opj_bio_numbytes(opj_bio_t *bio) {
+	if (bio->cache_bits || bio->overflow) {
+		opj_bio_unfill(bio);
+	}
 	return (bio->bp - bio->start);
 }
 
@@ -141,6 +234,9 @@ void opj_bio_init_enc(opj_bio_t *bio, OPJ_BYTE *bp, OPJ_UINT32 len) {
 	bio->bp = bp;
 	bio->buf = 0;
 	bio->ct = 8;
+	bio->cache = 0;
+	bio->cache_bits = 0;
+	bio->overflow = 0;
 }
 
 void opj_bio_init_dec(opj_bio_t *bio, OPJ_BYTE *bp, OPJ_UINT32 len) {
@@ -149,6 +245,9 @@ void opj_bio_init_dec(opj_bio_t *bio, OPJ_BYTE *bp, OPJ_UINT32 len) {
 	bio->bp = bp;
 	bio->buf = 0;
 	bio->ct = 0;
+	bio->cache = 0;
+	bio->cache_bits = 0;
+	bio->overflow = 0;
 }
 
 void opj_bio_write(opj_bio_t *bio, OPJ_UINT32 v, OPJ_UINT32 n) {
@@ -159,15 +258,47 @@ void opj_bio_write(opj_bio_t *bio, OPJ_UINT32 v, OPJ_UINT32 n) {
 }
 
 OPJ_UINT32 opj_bio_read(opj_bio_t *bio, OPJ_UINT32 n) {
-	OPJ_UINT32 i;
-    OPJ_UINT32 v;
-	v = 0;
-	for (i = n - 1; i < n; i--) {
-		v += opj_bio_getbit(bio) << i;
+	OPJ_UINT32 v;
+	if (n == 0) {
+		return 0;
 	}
+	/* corrupted lengths : only the 32 last bits are kept */
+	while (n > 32) {
+		OPJ_UINT32 l_skip = opj_uint_min(n - 32, 32);
+		opj_bio_read(bio, l_skip);
+		n -= l_skip;
+	}
+	if (bio->cache_bits < n) {
+		opj_bio_fill(bio);
+	}
+	v = (OPJ_UINT32)(bio->cache >> (64 - n));
+	bio->cache <<= n;
+	bio->cache_bits -= n;
 	return v;
 }
 
+OPJ_UINT32 opj_bio_read_zeros(opj_bio_t *bio, OPJ_UINT32 n) {
+	OPJ_UINT32 l_read = 0;
+
+	while (l_read < n) {
+		OPJ_UINT32 l_zeros;
+		if (bio->cache_bits == 0) {
+			opj_bio_fill(bio);
+		}
+		l_zeros = opj_uint_min(opj_bio_clz64(bio->cache), opj_uint_min(bio->cache_bits, n - l_read));
+		bio->cache <<= l_zeros;
+		bio->cache_bits -= l_zeros;
+		l_read += l_zeros;
+		if (l_read < n && bio->cache_bits) {
+			/* the 1 bit */
+			bio->cache <<= 1;
+			bio->cache_bits -= 1;
+			return l_read;
+		}
+	}
+	return n;
+}
+
 OPJ_BOOL opj_bio_flush(opj_bio_t *bio) {
 	bio->ct = 0;
 	if (! opj_bio_byteout(bio)) {
@@ -183,6 +314,9 @@ OPJ_BOOL opj_bio_flush(opj_bio_t *bio) {
 }
 
 OPJ_BOOL opj_bio_inalign(opj_bio_t *bio) {
+	opj_bio_unfill(bio);
+	bio->cache = 0;
+	bio->cache_bits = 0;
 	bio->ct = 0;
 	if ((bio->buf & 0xff) == 0xff) {
 		if (! opj_bio_bytein(bio)) {
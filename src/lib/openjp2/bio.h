@@ -45,6 +45,7 @@
 @brief Implementation of an individual bit input-output (BIO)
 
 The functions in BIO.C have for goal to realize an individual bit input - output.
+The decoder reads the buffer by chunks of up to 64 bits, removing the stuffed bit that follows each 0xFF byte.
 */
 
 /** @defgroup BIO BIO - Individual bit input-output stream */
@@ -64,6 +65,12 @@ typedef struct opj_bio {
 	OPJ_UINT32 buf;
 	/** coder : number of bits free to write. decoder : number of bits read */
 	OPJ_UINT32 ct;
+	/** decoder : bits not read yet, most significant bit first */
+	OPJ_UINT64 cache;
+	/** decoder : number of bits in cache */
+	OPJ_UINT32 cache_bits;
+	/** decoder : number of bytes read past the end of the buffer, read as 0 */
+	OPJ_UINT32 overflow;
 } opj_bio_t;
 
 /** @name Exported functions */
@@ -114,6 +121,13 @@ Read bits
 */
 OPJ_UINT32 opj_bio_read(opj_bio_t *bio, OPJ_UINT32 n);
 /**
+Read 0 bits up to the first 1 bit, as a loop of opj_bio_read(bio, 1) would
+@param bio BIO handle
+@param n Maximum number of bits to read
+@return Returns the number of 0 bits read before a 1 bit (the 1 bit is read too), n if the n bits read are 0
+*/
+OPJ_UINT32 opj_bio_read_zeros(opj_bio_t *bio, OPJ_UINT32 n);
+/**
 Flush bits
 @param bio BIO handle
 @return Returns OPJ_TRUE if successful, returns OPJ_FALSE otherwise
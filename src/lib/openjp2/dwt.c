@@ -70,6 +70,55 @@ typedef struct v4dwt_local {
 	OPJ_INT32		cas ;
 } opj_v4dwt_t ;
 
+struct opj_dwt_strip_decoder {
+	/** tile component to decode */
+	opj_tcd_tilecomp_t * tilec;
+	/** number of resolution levels to decode */
+	OPJ_UINT32 numres;
+	/** 1 for the 5-3 wavelet, 0 for the 9-7 wavelet */
+	OPJ_UINT32 qmfbid;
+	/** source of the band rows */
+	opj_dwt_band_reader_fn reader;
+	void * user_data;
+	/** rows window of each resolution level being synthesized */
+	OPJ_INT32 ** windows;
+	/** number of samples each window can hold */
+	OPJ_UINT32 * windows_size;
+	/** memory of the 1-D transforms */
+	void * mem;
+};
+
+/**
+Rows of a resolution level waiting for the strip forward wavelet transform
+*/
+typedef struct opj_dwt_strip_level {
+	/** rows [y0, y1) of the resolution level */
+	OPJ_INT32 * rows;
+	/** number of rows the buffer can hold */
+	OPJ_UINT32 rows_size;
+	OPJ_UINT32 y0, y1;
+	/** rows of the resolution level already transformed */
+	OPJ_UINT32 done;
+	/** transformed rows : low-pass rows then high-pass rows */
+	OPJ_INT32 * out;
+	/** number of samples out can hold */
+	OPJ_UINT32 out_size;
+} opj_dwt_strip_level_t;
+
+struct opj_dwt_strip_encoder {
+	/** tile component to encode */
+	opj_tcd_tilecomp_t * tilec;
+	/** forward 1-D transform, opj_dwt_encode_1 or opj_dwt_encode_1_real */
+	void (*dwt_1D)(OPJ_INT32 *, OPJ_INT32, OPJ_INT32, OPJ_INT32);
+	/** destination of the band rows */
+	opj_dwt_band_writer_fn writer;
+	void * user_data;
+	/** rows of each resolution level, the first one is unused */
+	opj_dwt_strip_level_t * levels;
+	/** memory of the 1-D transforms */
+	OPJ_INT32 * mem;
+};
+
 static const OPJ_FLOAT32 opj_dwt_alpha =  1.586134342f; /*  12994 */
 static const OPJ_FLOAT32 opj_dwt_beta  =  0.052980118f; /*    434 */
 static const OPJ_FLOAT32 opj_dwt_gamma = -0.882911075f; /*  -7233 */
@@ -105,6 +154,18 @@ Inverse lazy transform (vertical)
 */
 static void opj_dwt_interleave_v(opj_dwt_t* v, OPJ_INT32 *a, OPJ_INT32 x);
 /**
+Inverse lazy transform (horizontal) of 16 bits samples
+*/
+static void opj_dwt_interleave_h_16(opj_dwt_t* h, OPJ_INT16 *a);
+/**
+Inverse lazy transform (vertical) of 16 bits samples
+*/
+static void opj_dwt_interleave_v_16(opj_dwt_t* v, OPJ_INT16 *a, OPJ_INT32 x);
+/**
+Store a line of 32 bits samples as 16 bits samples, if all of them fit
+*/
+static OPJ_BOOL opj_dwt_store_16(OPJ_INT16 *a, OPJ_UINT32 x, const OPJ_INT32 *mem, OPJ_UINT32 n);
+/**
 Forward 5-3 wavelet transform in 1-D
 */
 static void opj_dwt_encode_1(OPJ_INT32 *a, OPJ_INT32 dn, OPJ_INT32 sn, OPJ_INT32 cas);
@@ -131,6 +192,16 @@ static OPJ_BOOL opj_dwt_encode_procedure(	opj_tcd_tilecomp_t * tilec,
 
 static OPJ_UINT32 opj_dwt_max_resolution(opj_tcd_resolution_t* restrict r, OPJ_UINT32 i);
 
+/**
+Reconstruct rows of a resolution level from the rows of the lower level and of its bands.
+*/
+static OPJ_BOOL opj_dwt_decode_strip_res(opj_dwt_strip_decoder_t * dec, OPJ_UINT32 resno, OPJ_UINT32 y0, OPJ_UINT32 y1, OPJ_INT32 * dest, OPJ_UINT32 dest_stride);
+
+/**
+Append rows to a resolution level and transform the ones whose neighbourhood is known.
+*/
+static OPJ_BOOL opj_dwt_encode_strip_res(opj_dwt_strip_encoder_t * enc, OPJ_UINT32 resno, const OPJ_INT32 * src, OPJ_UINT32 src_stride, OPJ_UINT32 nb_rows);
+
 /* <summary>                             */
 /* Inverse 9-7 wavelet transform in 1-D. */
 /* </summary>                            */
@@ -280,6 +351,64 @@ void opj_dwt_interleave_v(opj_dwt_t* v, OPJ_INT32 *a, OPJ_INT32 x) {
 }
 
 
+/* <summary>                                           */
+/* Inverse lazy transform (horizontal) of 16 bits data. */
+/* </summary>                                          */
+void opj_dwt_interleave_h_16(opj_dwt_t* h, OPJ_INT16 *a) {
+    OPJ_INT16 *ai = a;
+    OPJ_INT32 *bi = h->mem + h->cas;
+    OPJ_INT32  i	= h->sn;
+    while( i-- ) {
+      *bi = *(ai++);
+	  bi += 2;
+    }
+    ai	= a + h->sn;
+    bi	= h->mem + 1 - h->cas;
+    i	= h->dn ;
+    while( i-- ) {
+      *bi = *(ai++);
+	  bi += 2;
+    }
+}
+
+/* <summary>                                         */
+/* Inverse lazy transform (vertical) of 16 bits data. */
+/* </summary>                                        */
+void opj_dwt_interleave_v_16(opj_dwt_t* v, OPJ_INT16 *a, OPJ_INT32 x) {
+    OPJ_INT16 *ai = a;
+    OPJ_INT32 *bi = v->mem + v->cas;
+    OPJ_INT32  i = v->sn;
+    while( i-- ) {
+      *bi = *ai;
+	  bi += 2;
+	  ai += x;
+    }
+    ai = a + (v->sn * x);
+    bi = v->mem + 1 - v->cas;
+    i = v->dn ;
+    while( i-- ) {
+      *bi = *ai;
+	  bi += 2;
+	  ai += x;
+    }
+}
+
+/* <summary>                                          */
+/* Narrow a transformed line to 16 bits data.         */
+/* </summary>                                         */
+OPJ_BOOL opj_dwt_store_16(OPJ_INT16 *a, OPJ_UINT32 x, const OPJ_INT32 *mem, OPJ_UINT32 n) {
+	OPJ_UINT32 k;
+	for (k = 0; k < n; ++k) {
+		if (mem[k] != (OPJ_INT16)mem[k]) {
+			return OPJ_FALSE;
+		}
+	}
+	for (k = 0; k < n; ++k) {
+		a[k * x] = (OPJ_INT16)mem[k];
+	}
+	return OPJ_TRUE;
+}
+
 /* <summary>                            */
 /* Forward 5-3 wavelet transform in 1-D. */
 /* </summary>                           */
@@ -578,7 +707,9 @@ OPJ_BOOL opj_dwt_decode_tile(opj_tcd_tilecomp_t* tilec, OPJ_UINT32 numres, DWT1D
 	v.mem = h.mem;
 
 	while( --numres) {
-		OPJ_INT32 * restrict tiledp = tilec->data;
+		/* both views of the samples are used in the level where a 16 bit tile is widened */
+		OPJ_INT32 * tiledp = tilec->data;
+		OPJ_INT16 * tiledp16 = (OPJ_INT16*)tilec->data;
 		OPJ_UINT32 j;
 
 		++tr;
@@ -591,19 +722,49 @@ OPJ_BOOL opj_dwt_decode_tile(opj_tcd_tilecomp_t* tilec, OPJ_UINT32 numres, DWT1D
 		h.dn = (OPJ_INT32)(rw - (OPJ_UINT32)h.sn);
 		h.cas = tr->x0 % 2;
 
+		v.dn = (OPJ_INT32)(rh - (OPJ_UINT32)v.sn);
+		v.cas = tr->y0 % 2;
+
+		/* the lifting runs on 32 bits lines, only the storage of 16 bit tiles is narrowed :
+		 * the first line which does not fit widens the tile to 32 bits for the rest of the transform */
 		for(j = 0; j < rh; ++j) {
-			opj_dwt_interleave_h(&h, &tiledp[j*w]);
-			(dwt_1D)(&h);
+			if (tilec->data_16bit) {
+				opj_dwt_interleave_h_16(&h, &tiledp16[j*w]);
+				(dwt_1D)(&h);
+				if (opj_dwt_store_16(&tiledp16[j*w], 1, h.mem, rw)) {
+					continue;
+				}
+				if (! opj_tcd_widen_tile_component_data(tilec)) {
+					opj_aligned_free(h.mem);
+					return OPJ_FALSE;
+				}
+				tiledp = tilec->data;
+			}
+			else {
+				opj_dwt_interleave_h(&h, &tiledp[j*w]);
+				(dwt_1D)(&h);
+			}
 			memcpy(&tiledp[j*w], h.mem, rw * sizeof(OPJ_INT32));
 		}
 
-		v.dn = (OPJ_INT32)(rh - (OPJ_UINT32)v.sn);
-		v.cas = tr->y0 % 2;
-
 		for(j = 0; j < rw; ++j){
 			OPJ_UINT32 k;
-			opj_dwt_interleave_v(&v, &tiledp[j], (OPJ_INT32)w);
-			(dwt_1D)(&v);
+			if (tilec->data_16bit) {
+				opj_dwt_interleave_v_16(&v, &tiledp16[j], (OPJ_INT32)w);
+				(dwt_1D)(&v);
+				if (opj_dwt_store_16(&tiledp16[j], w, v.mem, rh)) {
+					continue;
+				}
+				if (! opj_tcd_widen_tile_component_data(tilec)) {
+					opj_aligned_free(h.mem);
+					return OPJ_FALSE;
+				}
+				tiledp = tilec->data;
+			}
+			else {
+				opj_dwt_interleave_v(&v, &tiledp[j], (OPJ_INT32)w);
+				(dwt_1D)(&v);
+			}
 			for(k = 0; k < rh; ++k) {
 				tiledp[k * w + j] = v.mem[k];
 			}
@@ -889,7 +1050,9 @@ OPJ_BOOL opj_dwt_decode_real(opj_tcd_tilecomp_t* restrict tilec, OPJ_UINT32 numr
 			for(k = (OPJ_INT32)rw; --k >= 0;){
 				switch(j) {
 					case 3: aj[k+(OPJ_INT32)w*2] = h.wavelet[k].f[2];
+						/* fall through */
 					case 2: aj[k+(OPJ_INT32)w  ] = h.wavelet[k].f[1];
+						/* fall through */
 					case 1: aj[k               ] = h.wavelet[k].f[0];
 				}
 			}
@@ -928,3 +1091,388 @@ OPJ_BOOL opj_dwt_decode_real(opj_tcd_tilecomp_t* restrict tilec, OPJ_UINT32 numr
 	opj_aligned_free(h.wavelet);
 	return OPJ_TRUE;
 }
+
+/* Rows reconstructed beyond each side of a strip : the lifting steps of the
+ * 5-3 and 9-7 wavelets read less than that many neighbours, so the rows of
+ * the strip do not depend on where the window of rows is cut. */
+#define OPJ_DWT_STRIP_MARGIN 8
+
+opj_dwt_strip_decoder_t * opj_dwt_strip_decoder_create(opj_tcd_tilecomp_t * tilec,
+                                                       OPJ_UINT32 numres,
+                                                       OPJ_UINT32 qmfbid,
+                                                       opj_dwt_band_reader_fn reader,
+                                                       void * user_data)
+{
+	OPJ_UINT32 mr = opj_dwt_max_resolution(tilec->resolutions, numres);
+	opj_dwt_strip_decoder_t * dec = (opj_dwt_strip_decoder_t *) opj_calloc(1, sizeof(opj_dwt_strip_decoder_t));
+	if (! dec) {
+		return 00;
+	}
+
+	dec->tilec = tilec;
+	dec->numres = numres;
+	dec->qmfbid = qmfbid;
+	dec->reader = reader;
+	dec->user_data = user_data;
+
+	dec->windows = (OPJ_INT32 **) opj_calloc(numres, sizeof(OPJ_INT32 *));
+	dec->windows_size = (OPJ_UINT32 *) opj_calloc(numres, sizeof(OPJ_UINT32));
+	if (qmfbid == 1) {
+		dec->mem = opj_aligned_malloc((mr + 1) * sizeof(OPJ_INT32));
+	}
+	else {
+		dec->mem = opj_aligned_malloc((mr + 5) * sizeof(opj_v4_t));
+	}
+	if (! dec->windows || ! dec->windows_size || ! dec->mem) {
+		opj_dwt_strip_decoder_destroy(dec);
+		return 00;
+	}
+
+	return dec;
+}
+
+void opj_dwt_strip_decoder_destroy(opj_dwt_strip_decoder_t * dec)
+{
+	OPJ_UINT32 resno;
+
+	if (! dec) {
+		return;
+	}
+
+	if (dec->windows) {
+		for (resno = 0; resno < dec->numres; ++resno) {
+			opj_aligned_free(dec->windows[resno]);
+		}
+		opj_free(dec->windows);
+	}
+	opj_free(dec->windows_size);
+	if (dec->mem) {
+		opj_aligned_free(dec->mem);
+	}
+	opj_free(dec);
+}
+
+OPJ_BOOL opj_dwt_decode_strip(opj_dwt_strip_decoder_t * dec,
+                              OPJ_UINT32 y0,
+                              OPJ_UINT32 y1,
+                              OPJ_INT32 * dest)
+{
+	opj_tcd_resolution_t * res = dec->tilec->resolutions + dec->numres - 1;
+
+	return opj_dwt_decode_strip_res(dec, dec->numres - 1, y0, y1, dest, (OPJ_UINT32)(res->x1 - res->x0));
+}
+
+OPJ_BOOL opj_dwt_decode_strip_res(opj_dwt_strip_decoder_t * dec, OPJ_UINT32 resno, OPJ_UINT32 y0, OPJ_UINT32 y1, OPJ_INT32 * dest, OPJ_UINT32 dest_stride)
+{
+	opj_tcd_resolution_t * res;
+	OPJ_UINT32 rw, rh, sn, cas;
+	OPJ_UINT32 p0, p1, lo0, lo1, hi0, hi1, nlo, nhi, size;
+	OPJ_INT32 * win;
+	OPJ_UINT32 j, k;
+
+	if (resno == 0) {
+		return dec->reader(dec->user_data, 0, 0, y0, y1, dest, dest_stride);
+	}
+	if (y0 >= y1) {
+		return OPJ_TRUE;
+	}
+
+	res = dec->tilec->resolutions + resno;
+	rw = (OPJ_UINT32)(res->x1 - res->x0);
+	rh = (OPJ_UINT32)(res->y1 - res->y0);
+	sn = (OPJ_UINT32)(res[-1].x1 - res[-1].x0);
+	cas = (OPJ_UINT32)(res->y0 % 2);
+
+	/* window of rows [p0, p1) synthesized around the requested ones */
+	p0 = (y0 > OPJ_DWT_STRIP_MARGIN) ? y0 - OPJ_DWT_STRIP_MARGIN : 0;
+	p1 = opj_uint_min(y1 + OPJ_DWT_STRIP_MARGIN, rh);
+
+	/* low-pass rows (rows p - cas even) and high-pass rows of the window */
+	lo0 = (p0 + 1 - cas) / 2;
+	lo1 = (p1 + 1 - cas) / 2;
+	hi0 = p0 - lo0;
+	hi1 = p1 - lo1;
+	nlo = lo1 - lo0;
+	nhi = hi1 - hi0;
+
+	size = (p1 - p0) * rw;
+	if (size > dec->windows_size[resno]) {
+		opj_aligned_free(dec->windows[resno]);
+		dec->windows[resno] = (OPJ_INT32 *) opj_aligned_malloc(size * sizeof(OPJ_INT32));
+		if (! dec->windows[resno]) {
+			dec->windows_size[resno] = 0;
+			return OPJ_FALSE;
+		}
+		dec->windows_size[resno] = size;
+	}
+	win = dec->windows[resno];
+
+	/* Deinterleaved window : low-pass rows then high-pass rows, each of them
+	 * made of its low-pass samples then its high-pass samples */
+	if (! opj_dwt_decode_strip_res(dec, resno - 1, lo0, lo1, win, rw)
+			|| ! dec->reader(dec->user_data, resno, 0, lo0, lo1, win + sn, rw)
+			|| ! dec->reader(dec->user_data, resno, 1, hi0, hi1, win + nlo * rw, rw)
+			|| ! dec->reader(dec->user_data, resno, 2, hi0, hi1, win + nlo * rw + sn, rw)) {
+		return OPJ_FALSE;
+	}
+
+	if (dec->qmfbid == 1) {
+		opj_dwt_t h;
+		opj_dwt_t v;
+
+		h.mem = (OPJ_INT32 *) dec->mem;
+		h.sn = (OPJ_INT32)sn;
+		h.dn = (OPJ_INT32)(rw - sn);
+		h.cas = res->x0 % 2;
+
+		for (j = 0; j < p1 - p0; ++j) {
+			opj_dwt_interleave_h(&h, &win[j * rw]);
+			opj_dwt_decode_1(&h);
+			memcpy(&win[j * rw], h.mem, rw * sizeof(OPJ_INT32));
+		}
+
+		v.mem = h.mem;
+		v.sn = (OPJ_INT32)nlo;
+		v.dn = (OPJ_INT32)nhi;
+		v.cas = (OPJ_INT32)((p0 + cas) % 2);
+
+		for (j = 0; j < rw; ++j) {
+			opj_dwt_interleave_v(&v, &win[j], (OPJ_INT32)rw);
+			opj_dwt_decode_1(&v);
+			for (k = y0; k < y1; ++k) {
+				dest[(k - y0) * dest_stride + j] = v.mem[k - p0];
+			}
+		}
+	}
+	else {
+		opj_v4dwt_t h;
+		opj_v4dwt_t v;
+		OPJ_FLOAT32 * restrict aj = (OPJ_FLOAT32 *) win;
+		OPJ_FLOAT32 * restrict out = (OPJ_FLOAT32 *) dest;
+		OPJ_UINT32 n;
+
+		h.wavelet = (opj_v4_t *) dec->mem;
+		h.sn = (OPJ_INT32)sn;
+		h.dn = (OPJ_INT32)(rw - sn);
+		h.cas = res->x0 % 2;
+
+		for (j = 0; j < p1 - p0; j += 4) {
+			n = opj_uint_min(p1 - p0 - j, 4);
+			opj_v4dwt_interleave_h(&h, aj, (OPJ_INT32)rw, (OPJ_INT32)(size - j * rw));
+			opj_v4dwt_decode(&h);
+			for (k = 0; k < rw; ++k) {
+				switch (n) {
+					case 4: aj[k + rw * 3] = h.wavelet[k].f[3];
+						/* fall through */
+					case 3: aj[k + rw * 2] = h.wavelet[k].f[2];
+						/* fall through */
+					case 2: aj[k + rw    ] = h.wavelet[k].f[1];
+						/* fall through */
+					case 1: aj[k         ] = h.wavelet[k].f[0];
+				}
+			}
+			aj += rw * 4;
+		}
+
+		v.wavelet = h.wavelet;
+		v.sn = (OPJ_INT32)nlo;
+		v.dn = (OPJ_INT32)nhi;
+		v.cas = (OPJ_INT32)((p0 + cas) % 2);
+
+		aj = (OPJ_FLOAT32 *) win;
+		for (j = 0; j < rw; j += 4) {
+			n = opj_uint_min(rw - j, 4);
+			opj_v4dwt_interleave_v(&v, aj + j, (OPJ_INT32)rw, (OPJ_INT32)n);
+			opj_v4dwt_decode(&v);
+			for (k = y0; k < y1; ++k) {
+				memcpy(&out[(k - y0) * dest_stride + j], &v.wavelet[k - p0], n * sizeof(OPJ_FLOAT32));
+			}
+		}
+	}
+
+	return OPJ_TRUE;
+}
+
+/* Rows transformed at once by the strip forward transform when the resolution
+ * level is not complete yet, to keep the cost of the window margins low. */
+#define OPJ_DWT_STRIP_BATCH (4 * OPJ_DWT_STRIP_MARGIN)
+
+opj_dwt_strip_encoder_t * opj_dwt_strip_encoder_create(opj_tcd_tilecomp_t * tilec,
+                                                       OPJ_UINT32 qmfbid,
+                                                       opj_dwt_band_writer_fn writer,
+                                                       void * user_data)
+{
+	OPJ_UINT32 mr = opj_dwt_max_resolution(tilec->resolutions, tilec->numresolutions);
+	opj_dwt_strip_encoder_t * enc = (opj_dwt_strip_encoder_t *) opj_calloc(1, sizeof(opj_dwt_strip_encoder_t));
+	if (! enc) {
+		return 00;
+	}
+
+	enc->tilec = tilec;
+	enc->dwt_1D = (qmfbid == 1) ? opj_dwt_encode_1 : opj_dwt_encode_1_real;
+	enc->writer = writer;
+	enc->user_data = user_data;
+
+	enc->levels = (opj_dwt_strip_level_t *) opj_calloc(tilec->numresolutions, sizeof(opj_dwt_strip_level_t));
+	enc->mem = (OPJ_INT32 *) opj_malloc((mr + 1) * sizeof(OPJ_INT32));
+	if (! enc->levels || ! enc->mem) {
+		opj_dwt_strip_encoder_destroy(enc);
+		return 00;
+	}
+
+	return enc;
+}
+
+void opj_dwt_strip_encoder_destroy(opj_dwt_strip_encoder_t * enc)
+{
+	OPJ_UINT32 resno;
+
+	if (! enc) {
+		return;
+	}
+
+	if (enc->levels) {
+		for (resno = 0; resno < enc->tilec->numresolutions; ++resno) {
+			opj_free(enc->levels[resno].rows);
+			opj_free(enc->levels[resno].out);
+		}
+		opj_free(enc->levels);
+	}
+	opj_free(enc->mem);
+	opj_free(enc);
+}
+
+OPJ_BOOL opj_dwt_encode_strip(opj_dwt_strip_encoder_t * enc,
+                              const OPJ_INT32 * src,
+                              OPJ_UINT32 nb_rows)
+{
+	OPJ_UINT32 resno = enc->tilec->numresolutions - 1;
+	opj_tcd_resolution_t * res = enc->tilec->resolutions + resno;
+
+	return opj_dwt_encode_strip_res(enc, resno, src, (OPJ_UINT32)(res->x1 - res->x0), nb_rows);
+}
+
+OPJ_BOOL opj_dwt_encode_strip_res(opj_dwt_strip_encoder_t * enc, OPJ_UINT32 resno, const OPJ_INT32 * src, OPJ_UINT32 src_stride, OPJ_UINT32 nb_rows)
+{
+	opj_dwt_strip_level_t * lvl;
+	opj_tcd_resolution_t * res;
+	OPJ_UINT32 rw, rh, sn, cas;
+	OPJ_UINT32 limit, p0, p1, lo0, lo1, hi0, hi1, wlo0, whi0, wsn, wcas, nlo, nhi, keep;
+	OPJ_INT32 * out;
+	OPJ_UINT32 j, k;
+
+	if (resno == 0) {
+		return enc->writer(enc->user_data, 0, 0, src, src_stride, nb_rows);
+	}
+
+	lvl = enc->levels + resno;
+	res = enc->tilec->resolutions + resno;
+	rw = (OPJ_UINT32)(res->x1 - res->x0);
+	rh = (OPJ_UINT32)(res->y1 - res->y0);
+	sn = (OPJ_UINT32)(res[-1].x1 - res[-1].x0);
+	cas = (OPJ_UINT32)(res->y0 % 2);
+
+	/* append the rows */
+	if (rw == 0) {
+		/* empty resolution level : the lower ones and their bands are empty too */
+		return OPJ_TRUE;
+	}
+	if (lvl->y1 + nb_rows - lvl->y0 > lvl->rows_size) {
+		OPJ_UINT32 l_size = lvl->y1 + nb_rows - lvl->y0;
+		OPJ_INT32 * l_rows = (OPJ_INT32 *) opj_realloc(lvl->rows, (size_t)l_size * rw * sizeof(OPJ_INT32));
+		if (! l_rows) {
+			return OPJ_FALSE;
+		}
+		lvl->rows = l_rows;
+		lvl->rows_size = l_size;
+	}
+	for (j = 0; j < nb_rows; ++j) {
+		memcpy(lvl->rows + (lvl->y1 - lvl->y0 + j) * rw, src + j * src_stride, rw * sizeof(OPJ_INT32));
+	}
+	lvl->y1 += nb_rows;
+
+	/* rows [done, limit) do not depend on the rows still to come */
+	if (lvl->y1 == rh) {
+		limit = rh;
+	}
+	else if (lvl->y1 >= lvl->done + OPJ_DWT_STRIP_MARGIN + OPJ_DWT_STRIP_BATCH) {
+		limit = lvl->y1 - OPJ_DWT_STRIP_MARGIN;
+	}
+	else {
+		return OPJ_TRUE;
+	}
+	if (limit <= lvl->done) {
+		return OPJ_TRUE;
+	}
+
+	/* low-pass rows (rows p - cas even) and high-pass rows to output */
+	lo0 = (lvl->done + 1 - cas) / 2;
+	lo1 = (limit + 1 - cas) / 2;
+	hi0 = lvl->done - lo0;
+	hi1 = limit - lo1;
+	nlo = lo1 - lo0;
+	nhi = hi1 - hi0;
+
+	/* window of rows [p0, p1) analysed around them */
+	p0 = (lvl->done > OPJ_DWT_STRIP_MARGIN) ? lvl->done - OPJ_DWT_STRIP_MARGIN : 0;
+	p1 = lvl->y1;
+	wlo0 = (p0 + 1 - cas) / 2;
+	whi0 = p0 - wlo0;
+	wsn = (p1 + 1 - cas) / 2 - wlo0;
+	wcas = (p0 + cas) % 2;
+
+	if ((nlo + nhi) * rw > lvl->out_size) {
+		opj_free(lvl->out);
+		lvl->out = (OPJ_INT32 *) opj_malloc((size_t)(nlo + nhi) * rw * sizeof(OPJ_INT32));
+		if (! lvl->out) {
+			lvl->out_size = 0;
+			return OPJ_FALSE;
+		}
+		lvl->out_size = (nlo + nhi) * rw;
+	}
+	out = lvl->out;
+
+	/* vertical pass on the window, keeping the new rows */
+	for (j = 0; j < rw; ++j) {
+		const OPJ_INT32 * aj = lvl->rows + (p0 - lvl->y0) * rw + j;
+		for (k = 0; k < p1 - p0; ++k) {
+			enc->mem[k] = aj[k * rw];
+		}
+
+		enc->dwt_1D(enc->mem, (OPJ_INT32)(p1 - p0 - wsn), (OPJ_INT32)wsn, (OPJ_INT32)wcas);
+
+		for (k = 0; k < nlo; ++k) {
+			out[k * rw + j] = enc->mem[2 * (lo0 + k - wlo0) + wcas];
+		}
+		for (k = 0; k < nhi; ++k) {
+			out[(nlo + k) * rw + j] = enc->mem[2 * (hi0 + k - whi0) + 1 - wcas];
+		}
+	}
+
+	/* horizontal pass on the new rows */
+	for (j = 0; j < nlo + nhi; ++j) {
+		OPJ_INT32 * aj = out + j * rw;
+		memcpy(enc->mem, aj, rw * sizeof(OPJ_INT32));
+		enc->dwt_1D(enc->mem, (OPJ_INT32)(rw - sn), (OPJ_INT32)sn, res->x0 % 2);
+		opj_dwt_deinterleave_h(enc->mem, aj, (OPJ_INT32)(rw - sn), (OPJ_INT32)sn, res->x0 % 2);
+	}
+
+	lvl->done = limit;
+
+	/* HL, LH and HH bands, then the LL band to the lower resolution level */
+	if (! enc->writer(enc->user_data, resno, 0, out + sn, rw, nlo)
+			|| ! enc->writer(enc->user_data, resno, 1, out + nlo * rw, rw, nhi)
+			|| ! enc->writer(enc->user_data, resno, 2, out + nlo * rw + sn, rw, nhi)
+			|| ! opj_dwt_encode_strip_res(enc, resno - 1, out, rw, nlo)) {
+		return OPJ_FALSE;
+	}
+
+	/* drop the rows no longer in the window of the next ones */
+	keep = (lvl->done > OPJ_DWT_STRIP_MARGIN) ? lvl->done - OPJ_DWT_STRIP_MARGIN : 0;
+	if (keep > lvl->y0) {
+		memmove(lvl->rows, lvl->rows + (keep - lvl->y0) * rw, (size_t)(lvl->y1 - keep) * rw * sizeof(OPJ_INT32));
+		lvl->y0 = keep;
+	}
+
+	return OPJ_TRUE;
+}
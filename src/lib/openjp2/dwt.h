@@ -95,6 +95,122 @@ Apply an irreversible inverse DWT transform to a component of an image.
 */
 OPJ_BOOL opj_dwt_decode_real(opj_tcd_tilecomp_t* restrict tilec, OPJ_UINT32 numres);
 
+/**
+Read rows of a band for the strip inverse wavelet transform.
+@param user_data User data given to opj_dwt_strip_decoder_create
+@param resno Resolution level of the band
+@param bandno Index of the band in the resolution level (0->LL for the lowest level, 0->HL, 1->LH, 2->HH otherwise)
+@param y0 First row to read, relative to the top of the band
+@param y1 Row after the last one to read, relative to the top of the band
+@param dest Destination of the rows
+@param dest_stride Distance between two rows of dest, in samples
+@return OPJ_FALSE if the rows can not be read
+*/
+typedef OPJ_BOOL (* opj_dwt_band_reader_fn) (void * user_data,
+                                             OPJ_UINT32 resno,
+                                             OPJ_UINT32 bandno,
+                                             OPJ_UINT32 y0,
+                                             OPJ_UINT32 y1,
+                                             OPJ_INT32 * dest,
+                                             OPJ_UINT32 dest_stride);
+
+/**
+Inverse wavelet transform of a tile component, run by strips of rows
+*/
+typedef struct opj_dwt_strip_decoder opj_dwt_strip_decoder_t;
+
+/**
+Create a strip inverse wavelet transform of a tile component.
+Only the rows needed by the requested strips are reconstructed at each resolution level,
+the band rows are pulled from the reader as they are needed.
+@param tilec Tile component information (current tile)
+@param numres Number of resolution levels to decode
+@param qmfbid 1 for the 5-3 wavelet, 0 for the 9-7 wavelet
+@param reader Function reading the rows of the bands
+@param user_data User data given to the reader
+@return a new strip decoder, 00 if there is not enough memory
+*/
+opj_dwt_strip_decoder_t * opj_dwt_strip_decoder_create(opj_tcd_tilecomp_t * tilec,
+                                                       OPJ_UINT32 numres,
+                                                       OPJ_UINT32 qmfbid,
+                                                       opj_dwt_band_reader_fn reader,
+                                                       void * user_data);
+
+/**
+Reconstruct rows of the highest decoded resolution level.
+The strips must be requested from top to bottom for the band readers to decode each code-block once.
+The samples are integers for the 5-3 wavelet and floats for the 9-7 wavelet, as in the tile component data.
+@param dec Strip decoder
+@param y0 First row to reconstruct, relative to the top of the resolution level
+@param y1 Row after the last one to reconstruct, relative to the top of the resolution level
+@param dest Destination of the rows, width of the resolution level samples per row
+*/
+OPJ_BOOL opj_dwt_decode_strip(opj_dwt_strip_decoder_t * dec,
+                              OPJ_UINT32 y0,
+                              OPJ_UINT32 y1,
+                              OPJ_INT32 * dest);
+
+/**
+Destroy a strip decoder.
+@param dec Strip decoder to destroy
+*/
+void opj_dwt_strip_decoder_destroy(opj_dwt_strip_decoder_t * dec);
+
+/**
+Write rows of a band produced by the strip forward wavelet transform.
+The rows of each band are written from top to bottom.
+@param user_data User data given to opj_dwt_strip_encoder_create
+@param resno Resolution level of the band
+@param bandno Index of the band in the resolution level (0->LL for the lowest level, 0->HL, 1->LH, 2->HH otherwise)
+@param src Rows of the band, band width samples per row
+@param src_stride Distance between two rows of src, in samples
+@param nb_rows Number of rows to write
+@return OPJ_FALSE if the rows can not be written
+*/
+typedef OPJ_BOOL (* opj_dwt_band_writer_fn) (void * user_data,
+                                             OPJ_UINT32 resno,
+                                             OPJ_UINT32 bandno,
+                                             const OPJ_INT32 * src,
+                                             OPJ_UINT32 src_stride,
+                                             OPJ_UINT32 nb_rows);
+
+/**
+Forward wavelet transform of a tile component, fed by strips of rows
+*/
+typedef struct opj_dwt_strip_encoder opj_dwt_strip_encoder_t;
+
+/**
+Create a strip forward wavelet transform of a tile component.
+Each resolution level only keeps the rows still needed by the lifting steps,
+the band rows are given to the writer as soon as they are computed.
+@param tilec Tile component information (current tile)
+@param qmfbid 1 for the 5-3 wavelet, 0 for the 9-7 wavelet
+@param writer Function receiving the rows of the bands
+@param user_data User data given to the writer
+@return a new strip encoder, 00 if there is not enough memory
+*/
+opj_dwt_strip_encoder_t * opj_dwt_strip_encoder_create(opj_tcd_tilecomp_t * tilec,
+                                                       OPJ_UINT32 qmfbid,
+                                                       opj_dwt_band_writer_fn writer,
+                                                       void * user_data);
+
+/**
+Transform the next rows of the tile component.
+The samples are the DC shifted (and color transformed) integers given to opj_dwt_encode or opj_dwt_encode_real.
+@param enc Strip encoder
+@param src Rows to transform, tile component width samples per row
+@param nb_rows Number of rows
+*/
+OPJ_BOOL opj_dwt_encode_strip(opj_dwt_strip_encoder_t * enc,
+                              const OPJ_INT32 * src,
+                              OPJ_UINT32 nb_rows);
+
+/**
+Destroy a strip encoder.
+@param enc Strip encoder to destroy
+*/
+void opj_dwt_strip_encoder_destroy(opj_dwt_strip_encoder_t * enc);
+
 /**
 Get the gain of a subband for the irreversible 9-7 DWT.
 @param orient Number that identifies the subband (0->LL, 1->HL, 2->LH, 3->HH)
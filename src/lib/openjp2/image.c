@@ -29,8 +29,76 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "opj_includes.h"
 
+/**
+ * Chroma contributions to the red, green and blue samples of the rows of a sYCC image.
+ * They are computed once per chroma row and upsampled to the width of the luma.
+ */
+typedef struct opj_image_sycc
+{
+	/** red, green and blue terms of the current row, comps[0].w each */
+	OPJ_INT32 * m_terms;
+	/** terms of the current chroma row before upsampling, NULL when the chroma is not subsampled horizontally */
+	OPJ_INT32 * m_chroma_terms;
+	/** chroma row the terms come from, -1 before the first row */
+	OPJ_INT32 m_chroma_row;
+	/** log2 of the horizontal subsampling of the chroma */
+	OPJ_UINT32 m_shift_x;
+	/** log2 of the vertical subsampling of the chroma */
+	OPJ_UINT32 m_shift_y;
+	/** value of the chroma samples with no colour */
+	OPJ_INT32 m_offset;
+	/** largest value of the converted samples */
+	OPJ_INT32 m_upb;
+} opj_image_sycc_t;
+
+/**
+ * Checks that an image can be converted from sYCC and allocates the rows of chroma terms.
+ *
+ * @param p_sycc	the conversion state to initialize.
+ * @param p_image	the sYCC image.
+ *
+ * @return OPJ_TRUE if the image is supported.
+ */
+static OPJ_BOOL opj_image_sycc_init(opj_image_sycc_t * p_sycc, const opj_image_t * p_image);
+
+/**
+ * Frees the rows of chroma terms.
+ */
+static void opj_image_sycc_destroy(opj_image_sycc_t * p_sycc);
+
+/**
+ * Computes the chroma terms of samples with the inverse sYCC matrix (Amendment 1 to IEC 61966-2-1) :
+ * R = Y + 1.402 Cr, G = Y - 0.344 Cb - 0.714 Cr and B = Y + 1.772 Cb.
+ *
+ * @param p_cb			blue difference samples.
+ * @param p_cr			red difference samples.
+ * @param p_nb_samples	number of samples.
+ * @param p_offset		value of the samples with no colour.
+ * @param p_r			term added to the luma for the red samples.
+ * @param p_g			term subtracted from the luma for the green samples.
+ * @param p_b			term added to the luma for the blue samples.
+ */
+static void opj_image_sycc_chroma_terms(const OPJ_INT32 * p_cb, const OPJ_INT32 * p_cr, OPJ_UINT32 p_nb_samples,
+										OPJ_INT32 p_offset, OPJ_INT32 * p_r, OPJ_INT32 * p_g, OPJ_INT32 * p_b);
+
+/**
+ * Gets the chroma terms of a row of the image, upsampled to the width of the luma.
+ * The terms are only computed again when the row uses another chroma row.
+ *
+ * @param p_sycc	the conversion state.
+ * @param p_image	the sYCC image.
+ * @param p_row		row of the luma.
+ *
+ * @return the red, green and blue terms of the row, one after the other.
+ */
+static const OPJ_INT32 * opj_image_sycc_row_terms(opj_image_sycc_t * p_sycc, const opj_image_t * p_image, OPJ_UINT32 p_row);
+
 opj_image_t* opj_image_create0(void) {
 	opj_image_t *image = (opj_image_t*)opj_calloc(1, sizeof(opj_image_t));
 	return image;
@@ -236,3 +304,302 @@ opj_image_t* OPJ_CALLCONV opj_image_tile_create(OPJ_UINT32 numcmpts, opj_image_c
 
 	return image;
 }
+
+OPJ_BOOL opj_image_sycc_init(opj_image_sycc_t * p_sycc, const opj_image_t * p_image)
+{
+	const opj_image_comp_t *l_y, *l_cb, *l_cr;
+
+	memset(p_sycc, 0, sizeof(opj_image_sycc_t));
+	p_sycc->m_chroma_row = -1;
+
+	if (p_image->numcomps < 3) {
+		return OPJ_FALSE;
+	}
+	l_y = &p_image->comps[0];
+	l_cb = &p_image->comps[1];
+	l_cr = &p_image->comps[2];
+	if (!l_y->data || !l_cb->data || !l_cr->data
+		|| l_y->w == 0 || l_y->h == 0 || l_cb->w == 0 || l_cb->h == 0) {
+		return OPJ_FALSE;
+	}
+
+	/* full resolution luma, and chroma subsampled by at most 2 in each direction */
+	if (l_y->dx != 1 || l_y->dy != 1
+		|| (l_cb->dx != 1 && l_cb->dx != 2) || (l_cb->dy != 1 && l_cb->dy != 2)
+		|| l_cr->dx != l_cb->dx || l_cr->dy != l_cb->dy
+		|| l_cr->w != l_cb->w || l_cr->h != l_cb->h
+		|| l_cr->x0 != l_cb->x0 || l_cr->y0 != l_cb->y0) {
+		return OPJ_FALSE;
+	}
+	p_sycc->m_shift_x = l_cb->dx - 1;
+	p_sycc->m_shift_y = l_cb->dy - 1;
+	if ((!p_sycc->m_shift_x && l_cb->w != l_y->w) || (!p_sycc->m_shift_y && l_cb->h != l_y->h)) {
+		return OPJ_FALSE;
+	}
+
+	/* the terms and the sums have to fit on 32 bits */
+	if (l_y->prec == 0 || l_y->prec > 24 || l_cb->prec > 24 || l_cr->prec > 24) {
+		return OPJ_FALSE;
+	}
+	p_sycc->m_offset = 1 << (l_y->prec - 1);
+	p_sycc->m_upb = (1 << l_y->prec) - 1;
+
+	p_sycc->m_terms = (OPJ_INT32*) opj_malloc(3 * (OPJ_SIZE_T)l_y->w * sizeof(OPJ_INT32));
+	if (!p_sycc->m_terms) {
+		return OPJ_FALSE;
+	}
+	if (p_sycc->m_shift_x) {
+		p_sycc->m_chroma_terms = (OPJ_INT32*) opj_malloc(3 * (OPJ_SIZE_T)l_cb->w * sizeof(OPJ_INT32));
+		if (!p_sycc->m_chroma_terms) {
+			opj_image_sycc_destroy(p_sycc);
+			return OPJ_FALSE;
+		}
+	}
+
+	return OPJ_TRUE;
+}
+
+void opj_image_sycc_destroy(opj_image_sycc_t * p_sycc)
+{
+	opj_free(p_sycc->m_terms);
+	p_sycc->m_terms = 00;
+	opj_free(p_sycc->m_chroma_terms);
+	p_sycc->m_chroma_terms = 00;
+}
+
+void opj_image_sycc_chroma_terms(const OPJ_INT32 * p_cb, const OPJ_INT32 * p_cr, OPJ_UINT32 p_nb_samples,
+								OPJ_INT32 p_offset, OPJ_INT32 * p_r, OPJ_INT32 * p_g, OPJ_INT32 * p_b)
+{
+	OPJ_UINT32 i = 0;
+
+#ifdef __SSE2__
+	/* same double precision products and truncations as the scalar loop, 4 samples at a time */
+	const __m128d l_cr_r = _mm_set1_pd(1.402);
+	const __m128d l_cb_g = _mm_set1_pd(0.344);
+	const __m128d l_cr_g = _mm_set1_pd(0.714);
+	const __m128d l_cb_b = _mm_set1_pd(1.772);
+	const __m128i l_offset = _mm_set1_epi32(p_offset);
+
+	for (; i + 4 <= p_nb_samples; i += 4) {
+		__m128i l_cb = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(p_cb + i)), l_offset);
+		__m128i l_cr = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(p_cr + i)), l_offset);
+		__m128d l_cb_lo = _mm_cvtepi32_pd(l_cb);
+		__m128d l_cb_hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(l_cb, _MM_SHUFFLE(1, 0, 3, 2)));
+		__m128d l_cr_lo = _mm_cvtepi32_pd(l_cr);
+		__m128d l_cr_hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(l_cr, _MM_SHUFFLE(1, 0, 3, 2)));
+
+		_mm_storeu_si128((__m128i *)(p_r + i),
+			_mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_mul_pd(l_cr_r, l_cr_lo)),
+							   _mm_cvttpd_epi32(_mm_mul_pd(l_cr_r, l_cr_hi))));
+		_mm_storeu_si128((__m128i *)(p_g + i),
+			_mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(l_cb_g, l_cb_lo), _mm_mul_pd(l_cr_g, l_cr_lo))),
+							   _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(l_cb_g, l_cb_hi), _mm_mul_pd(l_cr_g, l_cr_hi)))));
+		_mm_storeu_si128((__m128i *)(p_b + i),
+			_mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_mul_pd(l_cb_b, l_cb_lo)),
+							   _mm_cvttpd_epi32(_mm_mul_pd(l_cb_b, l_cb_hi))));
+	}
+#endif
+
+	for (; i < p_nb_samples; ++i) {
+		OPJ_FLOAT64 l_cb = (OPJ_FLOAT64)(p_cb[i] - p_offset);
+		OPJ_FLOAT64 l_cr = (OPJ_FLOAT64)(p_cr[i] - p_offset);
+
+		p_r[i] = (OPJ_INT32)(1.402 * l_cr);
+		p_g[i] = (OPJ_INT32)(0.344 * l_cb + 0.714 * l_cr);
+		p_b[i] = (OPJ_INT32)(1.772 * l_cb);
+	}
+}
+
+const OPJ_INT32 * opj_image_sycc_row_terms(opj_image_sycc_t * p_sycc, const opj_image_t * p_image, OPJ_UINT32 p_row)
+{
+	const opj_image_comp_t *l_y = &p_image->comps[0];
+	const opj_image_comp_t *l_cb = &p_image->comps[1];
+	const opj_image_comp_t *l_cr = &p_image->comps[2];
+	OPJ_UINT32 l_width = l_y->w;
+	OPJ_INT32 *l_r = p_sycc->m_terms;
+	OPJ_INT32 *l_g = l_r + l_width;
+	OPJ_INT32 *l_b = l_g + l_width;
+	OPJ_INT32 l_row;
+	const OPJ_INT32 *l_cb_row, *l_cr_row;
+
+	/* chroma sample covering the row, clamped to the chroma rows for odd origins */
+	l_row = (OPJ_INT32)((l_y->y0 + p_row) >> p_sycc->m_shift_y) - (OPJ_INT32)l_cb->y0;
+	l_row = opj_int_clamp(l_row, 0, (OPJ_INT32)l_cb->h - 1);
+	if (l_row == p_sycc->m_chroma_row) {
+		return p_sycc->m_terms;
+	}
+	p_sycc->m_chroma_row = l_row;
+
+	l_cb_row = l_cb->data + (OPJ_SIZE_T)l_row * l_cb->w;
+	l_cr_row = l_cr->data + (OPJ_SIZE_T)l_row * l_cr->w;
+	if (!p_sycc->m_shift_x) {
+		opj_image_sycc_chroma_terms(l_cb_row, l_cr_row, l_width, p_sycc->m_offset, l_r, l_g, l_b);
+	}
+	else {
+		OPJ_INT32 *l_chroma_r = p_sycc->m_chroma_terms;
+		OPJ_INT32 *l_chroma_g = l_chroma_r + l_cb->w;
+		OPJ_INT32 *l_chroma_b = l_chroma_g + l_cb->w;
+		OPJ_INT32 l_last = (OPJ_INT32)l_cb->w - 1;
+		OPJ_UINT32 j;
+
+		opj_image_sycc_chroma_terms(l_cb_row, l_cr_row, l_cb->w, p_sycc->m_offset, l_chroma_r, l_chroma_g, l_chroma_b);
+		for (j = 0; j < l_width; ++j) {
+			OPJ_INT32 l_col = opj_int_clamp((OPJ_INT32)((l_y->x0 + j) >> 1) - (OPJ_INT32)l_cb->x0, 0, l_last);
+			l_r[j] = l_chroma_r[l_col];
+			l_g[j] = l_chroma_g[l_col];
+			l_b[j] = l_chroma_b[l_col];
+		}
+	}
+
+	return p_sycc->m_terms;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_image_sycc_to_rgb(opj_image_t *p_image)
+{
+	opj_image_sycc_t l_sycc;
+	opj_image_comp_t *l_y, *l_cb, *l_cr;
+	OPJ_INT32 *l_g_data, *l_b_data;
+	OPJ_UINT32 i, j, l_width;
+
+	if (!p_image || !opj_image_sycc_init(&l_sycc, p_image)) {
+		return OPJ_FALSE;
+	}
+	l_y = &p_image->comps[0];
+	l_cb = &p_image->comps[1];
+	l_cr = &p_image->comps[2];
+	l_width = l_y->w;
+
+	/* without subsampling the green and blue samples replace the chroma in place,
+	   the terms of a row being computed before it is overwritten */
+	if (!l_sycc.m_shift_x && !l_sycc.m_shift_y) {
+		l_g_data = l_cb->data;
+		l_b_data = l_cr->data;
+	}
+	else {
+		l_g_data = (OPJ_INT32*) opj_malloc((OPJ_SIZE_T)l_width * l_y->h * sizeof(OPJ_INT32));
+		l_b_data = (OPJ_INT32*) opj_malloc((OPJ_SIZE_T)l_width * l_y->h * sizeof(OPJ_INT32));
+		if (!l_g_data || !l_b_data) {
+			opj_free(l_g_data);
+			opj_free(l_b_data);
+			opj_image_sycc_destroy(&l_sycc);
+			return OPJ_FALSE;
+		}
+	}
+
+	for (i = 0; i < l_y->h; ++i) {
+		const OPJ_INT32 *l_terms = opj_image_sycc_row_terms(&l_sycc, p_image, i);
+		OPJ_INT32 *l_r = l_y->data + (OPJ_SIZE_T)i * l_width;
+		OPJ_INT32 *l_g = l_g_data + (OPJ_SIZE_T)i * l_width;
+		OPJ_INT32 *l_b = l_b_data + (OPJ_SIZE_T)i * l_width;
+
+		for (j = 0; j < l_width; ++j) {
+			OPJ_INT32 l_luma = l_r[j];
+			l_r[j] = opj_int_clamp(l_luma + l_terms[j], 0, l_sycc.m_upb);
+			l_g[j] = opj_int_clamp(l_luma - l_terms[l_width + j], 0, l_sycc.m_upb);
+			l_b[j] = opj_int_clamp(l_luma + l_terms[2 * l_width + j], 0, l_sycc.m_upb);
+		}
+	}
+	opj_image_sycc_destroy(&l_sycc);
+
+	if (l_g_data != l_cb->data) {
+		opj_free(l_cb->data);
+		opj_free(l_cr->data);
+		l_cb->data = l_g_data;
+		l_cr->data = l_b_data;
+		for (i = 1; i < 3; ++i) {
+			opj_image_comp_t *l_comp = &p_image->comps[i];
+			l_comp->w = l_y->w;
+			l_comp->h = l_y->h;
+			l_comp->dx = l_y->dx;
+			l_comp->dy = l_y->dy;
+			l_comp->x0 = l_y->x0;
+			l_comp->y0 = l_y->y0;
+		}
+	}
+	p_image->color_space = OPJ_CLRSPC_SRGB;
+
+	return OPJ_TRUE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_image_sycc_to_buffer(const opj_image_t *p_image,
+												OPJ_BYTE *p_buffer,
+												OPJ_UINT32 p_stride,
+												OPJ_PIXEL_FORMAT p_format)
+{
+	opj_image_sycc_t l_sycc;
+	const opj_image_comp_t *l_y, *l_alpha = 00;
+	OPJ_UINT32 i, j, l_width, l_nb_channels, l_depth;
+	OPJ_UINT32 l_right_shift, l_left_shift;
+	OPJ_UINT32 l_alpha_right_shift = 0, l_alpha_left_shift = 0;
+	OPJ_INT32 l_alpha_offset = 0;
+
+	switch (p_format) {
+		case OPJ_PF_RGB8:	l_nb_channels = 3; l_depth = 8; break;
+		case OPJ_PF_RGBA8:	l_nb_channels = 4; l_depth = 8; break;
+		case OPJ_PF_RGB16:	l_nb_channels = 3; l_depth = 16; break;
+		case OPJ_PF_RGBA16:	l_nb_channels = 4; l_depth = 16; break;
+		default:
+			return OPJ_FALSE;
+	}
+
+	if (!p_image || !p_buffer || !opj_image_sycc_init(&l_sycc, p_image)) {
+		return OPJ_FALSE;
+	}
+	l_y = &p_image->comps[0];
+	l_width = l_y->w;
+	if ((OPJ_SIZE_T)p_stride < (OPJ_SIZE_T)l_width * l_nb_channels * (l_depth >> 3)) {
+		opj_image_sycc_destroy(&l_sycc);
+		return OPJ_FALSE;
+	}
+
+	/* the alpha channel is taken from the fourth component, or set to opaque */
+	if (l_nb_channels == 4 && p_image->numcomps >= 4) {
+		l_alpha = &p_image->comps[3];
+		if (!l_alpha->data || l_alpha->w != l_y->w || l_alpha->h != l_y->h
+			|| l_alpha->prec == 0 || l_alpha->prec > 31) {
+			opj_image_sycc_destroy(&l_sycc);
+			return OPJ_FALSE;
+		}
+		l_alpha_offset = l_alpha->sgnd ? (1 << (l_alpha->prec - 1)) : 0;
+		l_alpha_right_shift = (l_alpha->prec > l_depth) ? l_alpha->prec - l_depth : 0;
+		l_alpha_left_shift = (l_alpha->prec < l_depth) ? l_depth - l_alpha->prec : 0;
+	}
+	l_right_shift = (l_y->prec > l_depth) ? l_y->prec - l_depth : 0;
+	l_left_shift = (l_y->prec < l_depth) ? l_depth - l_y->prec : 0;
+
+	/* upsampling, conversion, clamping and interleaving in a single pass over each row */
+	for (i = 0; i < l_y->h; ++i) {
+		const OPJ_INT32 *l_terms = opj_image_sycc_row_terms(&l_sycc, p_image, i);
+		const OPJ_INT32 *l_luma = l_y->data + (OPJ_SIZE_T)i * l_width;
+		const OPJ_INT32 *l_alpha_row = l_alpha ? l_alpha->data + (OPJ_SIZE_T)i * l_width : 00;
+		OPJ_BYTE *l_dest_ptr = p_buffer + (OPJ_SIZE_T)i * p_stride;
+
+		if (l_depth == 8) {
+			OPJ_BYTE *l_dest = l_dest_ptr;
+			for (j = 0; j < l_width; ++j) {
+				l_dest[0] = (OPJ_BYTE)((OPJ_UINT32)opj_int_clamp(l_luma[j] + l_terms[j], 0, l_sycc.m_upb) >> l_right_shift << l_left_shift);
+				l_dest[1] = (OPJ_BYTE)((OPJ_UINT32)opj_int_clamp(l_luma[j] - l_terms[l_width + j], 0, l_sycc.m_upb) >> l_right_shift << l_left_shift);
+				l_dest[2] = (OPJ_BYTE)((OPJ_UINT32)opj_int_clamp(l_luma[j] + l_terms[2 * l_width + j], 0, l_sycc.m_upb) >> l_right_shift << l_left_shift);
+				if (l_nb_channels == 4) {
+					l_dest[3] = l_alpha_row ? (OPJ_BYTE)((OPJ_UINT32)(l_alpha_row[j] + l_alpha_offset) >> l_alpha_right_shift << l_alpha_left_shift) : 0xff;
+				}
+				l_dest += l_nb_channels;
+			}
+		}
+		else {
+			OPJ_UINT16 *l_dest = (OPJ_UINT16 *) l_dest_ptr;
+			for (j = 0; j < l_width; ++j) {
+				l_dest[0] = (OPJ_UINT16)((OPJ_UINT32)opj_int_clamp(l_luma[j] + l_terms[j], 0, l_sycc.m_upb) >> l_right_shift << l_left_shift);
+				l_dest[1] = (OPJ_UINT16)((OPJ_UINT32)opj_int_clamp(l_luma[j] - l_terms[l_width + j], 0, l_sycc.m_upb) >> l_right_shift << l_left_shift);
+				l_dest[2] = (OPJ_UINT16)((OPJ_UINT32)opj_int_clamp(l_luma[j] + l_terms[2 * l_width + j], 0, l_sycc.m_upb) >> l_right_shift << l_left_shift);
+				if (l_nb_channels == 4) {
+					l_dest[3] = l_alpha_row ? (OPJ_UINT16)((OPJ_UINT32)(l_alpha_row[j] + l_alpha_offset) >> l_alpha_right_shift << l_alpha_left_shift) : 0xffff;
+				}
+				l_dest += l_nb_channels;
+			}
+		}
+	}
+	opj_image_sycc_destroy(&l_sycc);
+
+	return OPJ_TRUE;
+}
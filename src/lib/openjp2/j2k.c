@@ -168,13 +168,66 @@ static OPJ_BOOL opj_j2k_update_rates(   opj_j2k_t *p_j2k,
                                                                             opj_event_mgr_t * p_manager );
 
 /**
- * Copies the decoding tile parameters onto all the tile parameters.
- * Creates also the tile decoder.
+ * Creates the tile decoder once the main header has been read.
+ * The tile parameters are set up lazily, see opj_j2k_init_tile_tcp.
  */
 static OPJ_BOOL opj_j2k_copy_default_tcp_and_create_tcd (       opj_j2k_t * p_j2k,
                                                             opj_stream_private_t *p_stream,
                                                             opj_event_mgr_t * p_manager );
 
+/**
+ * Checks the components to decode given to opj_j2k_setup_decoder against the image read
+ * from the main header.
+ */
+static OPJ_BOOL opj_j2k_init_decoded_components (opj_j2k_t * p_j2k,
+                                                 opj_stream_private_t *p_stream,
+                                                 opj_event_mgr_t * p_manager );
+
+/**
+ * Marks the components of m_comps_to_decode in m_decoded_comps, and sorts m_comps_to_decode
+ * in the order of the components of the image, without the duplicates.
+ */
+static OPJ_BOOL opj_j2k_mark_decoded_components (opj_j2k_t * p_j2k,
+                                                 opj_event_mgr_t * p_manager );
+
+/**
+ * Removes the components which are not decoded from an image which still has all the
+ * components of the codestream. The image is left untouched if they are already removed.
+ */
+static OPJ_BOOL opj_j2k_remove_undecoded_components (opj_j2k_t * p_j2k,
+                                                     opj_image_t * p_image,
+                                                     opj_event_mgr_t * p_manager );
+
+/**
+ * Sets up the coding parameters of a tile from the default ones when its first tile-part is met.
+ * The tile-component parameters and the MCT records are shared with the default tile coding
+ * parameters until a tile-part header marker overrides them (see opj_j2k_unshare_tcp).
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+ * @param       p_tcp           the tile coding parameters to set up.
+ */
+static void opj_j2k_init_tile_tcp ( opj_j2k_t * p_j2k, opj_tcp_t * p_tcp );
+
+/**
+ * Gives a tile its own copy of the parameters it shares with the default tile coding parameters.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+ * @param       p_tcp           the tile coding parameters to make private.
+ * @param       p_manager       the user event manager.
+ *
+ * @return      true if the copy succeeded.
+ */
+static OPJ_BOOL opj_j2k_unshare_tcp (   opj_j2k_t * p_j2k,
+                                        opj_tcp_t * p_tcp,
+                                        opj_event_mgr_t * p_manager );
+
+/**
+ * Tells if a tile-part header marker modifies the parameters a tile shares with the default ones.
+ *
+ * @param       p_id            the marker ID.
+ */
+static OPJ_BOOL opj_j2k_is_tcp_override_marker ( OPJ_UINT32 p_id );
+
 /**
  * Destroys the memory associated with the decoding of headers.
  */
@@ -338,6 +391,51 @@ static OPJ_BOOL opj_j2k_pre_write_tile ( opj_j2k_t * p_j2k,
 
 static OPJ_BOOL opj_j2k_update_image_data (opj_tcd_t * p_tcd, OPJ_BYTE * p_data, opj_image_t* p_output_image);
 
+/**
+ * Gets the component feeding each channel of an interleaved output buffer.
+ *
+ * @param       p_numcomps      number of components of the image.
+ * @param       p_format        layout of the interleaved buffer.
+ * @param       p_map           component index of each channel, -1 for an opaque alpha channel.
+ * @param       p_nb_channels   number of channels of the layout.
+ * @param       p_nb_bytes      number of bytes per sample of the layout.
+ *
+ * @return      OPJ_FALSE if the layout is unknown.
+*/
+static OPJ_BOOL opj_j2k_get_buffer_channel_map (OPJ_UINT32 p_numcomps,
+                                                OPJ_PIXEL_FORMAT p_format,
+                                                OPJ_INT32 * p_map,
+                                                OPJ_UINT32 * p_nb_channels,
+                                                OPJ_UINT32 * p_nb_bytes);
+
+/**
+ * Writes the current decoded tile into the caller-provided interleaved buffer.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+*/
+static OPJ_BOOL opj_j2k_update_buffer_data (opj_j2k_t * p_j2k);
+
+/**
+ * Writes the palette pixels of the indices of the current decoded tile into the caller-provided
+ * interleaved buffer.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+*/
+static OPJ_BOOL opj_j2k_update_buffer_palette_data (opj_j2k_t * p_j2k);
+
+/**
+ * Converts a palette to the pixels of an 8 bit interleaved buffer, one pixel per entry.
+ *
+ * @param       p_palette       the palette.
+ * @param       p_format        layout of the interleaved buffer.
+ * @param       p_manager       the user event manager.
+ *
+ * @return      the pixels, or 00 if the palette can not be written to this layout.
+*/
+static OPJ_BYTE * opj_j2k_get_palette_pixels (const opj_j2k_palette_t * p_palette,
+                                              OPJ_PIXEL_FORMAT p_format,
+                                              opj_event_mgr_t * p_manager);
+
 static void opj_get_tile_dimensions(opj_image_t * l_image,
 																		opj_tcd_tilecomp_t * l_tilec,
 																		opj_image_comp_t * l_img_comp,
@@ -650,6 +748,44 @@ static OPJ_BOOL opj_j2k_read_poc (  opj_j2k_t *p_j2k,
  */
 static OPJ_UINT32 opj_j2k_get_max_toc_size (opj_j2k_t *p_j2k);
 
+/**
+ * Gets the maximum size taken by the PLT markers of a tile.
+ *
+ * @param       p_j2k   the jpeg2000 codec to use.
+ */
+static OPJ_UINT32 opj_j2k_get_max_plt_size (opj_j2k_t *p_j2k);
+
+/**
+ * Gets the maximum size taken by the PLT markers giving the lengths of some packets.
+ *
+ * @param       p_nb_packets    the number of packets.
+ */
+static OPJ_UINT32 opj_j2k_get_plt_room (OPJ_UINT32 p_nb_packets);
+
+/**
+ * Gets the size of the PLT markers giving the lengths of some packets.
+ *
+ * @param       p_lengths       the lengths of the packets.
+ * @param       p_nb_packets    the number of packets.
+ */
+static OPJ_UINT32 opj_j2k_get_plt_size (const OPJ_UINT32 * p_lengths,
+                                        OPJ_UINT32 p_nb_packets);
+
+/**
+ * Writes the PLT markers giving the lengths of some packets (Packet length, tile-part header)
+ *
+ * @param       p_lengths       the lengths of the packets.
+ * @param       p_nb_packets    the number of packets.
+ * @param       p_data          the buffer to write to, large enough for opj_j2k_get_plt_size bytes.
+ * @param       p_data_written  the number of bytes written.
+ * @param       p_manager       the user event manager.
+ */
+static OPJ_BOOL opj_j2k_write_plt_in_memory(const OPJ_UINT32 * p_lengths,
+                                            OPJ_UINT32 p_nb_packets,
+                                            OPJ_BYTE * p_data,
+                                            OPJ_UINT32 * p_data_written,
+                                            opj_event_mgr_t * p_manager );
+
 /**
  * Gets the maximum size taken by the headers of the SOT.
  *
@@ -718,6 +854,125 @@ static OPJ_BOOL opj_j2k_read_plt (  opj_j2k_t *p_j2k,
                                     OPJ_UINT32 p_header_size,
                                     opj_event_mgr_t * p_manager );
 
+/**
+ * Sets the tile-part positions of the codestream index from the TLM markers of the main header,
+ * and the packet lengths from the PLM markers when both are present.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_stream                the stream the main header was read from, positioned after it.
+ * @param       p_manager               the user event manager.
+*/
+static OPJ_BOOL opj_j2k_build_tlm_index (   opj_j2k_t *p_j2k,
+                                            opj_stream_private_t *p_stream,
+                                            opj_event_mgr_t * p_manager );
+
+/**
+ * Adds the length of a packet to the packet index of a tile. The position is set when the tile-part data is reached.
+ *
+ * @param       p_tile_index    the index of the tile.
+ * @param       p_length        the length of the packet.
+*/
+static OPJ_BOOL opj_j2k_add_packet_length ( opj_tile_index_t * p_tile_index,
+                                            OPJ_UINT32 p_length );
+
+/**
+ * Prepares the packet index of the tile-part whose SOT marker was just read : the lengths come from the
+ * PLM markers when the tile-part is met for the first time in codestream order, else from its PLT markers.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_new_tile_part         OPJ_TRUE if no SOT marker after this one has been read yet.
+*/
+static OPJ_BOOL opj_j2k_index_tile_part_packets (   opj_j2k_t *p_j2k,
+                                                    OPJ_BOOL p_new_tile_part );
+
+/**
+ * Forgets the tile-part positions and packet lengths taken from the TLM and PLM markers for the tiles not read yet.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+*/
+static void opj_j2k_reset_tlm_index (opj_j2k_t *p_j2k);
+
+/**
+ * Checks that a tile-part located from the TLM markers starts with the SOT marker of this tile-part, else forgets the TLM index.
+ * The position of the stream is undefined afterwards.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_stream                the stream to read.
+ * @param       p_tile_no               the tile of the tile-part.
+ * @param       p_tp_no                 the index of the tile-part in the tile.
+ * @param       p_manager               the user event manager.
+ *
+ * @return      OPJ_TRUE if the tile-part is where expected.
+*/
+static OPJ_BOOL opj_j2k_check_tlm_tile_part (   opj_j2k_t *p_j2k,
+                                                opj_stream_private_t *p_stream,
+                                                OPJ_UINT32 p_tile_no,
+                                                OPJ_UINT32 p_tp_no,
+                                                opj_event_mgr_t * p_manager );
+
+/**
+ * Moves the stream to the next tile-part of the current tile, when its position is known from the TLM markers.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_stream                the stream to seek.
+ * @param       p_manager               the user event manager.
+*/
+static OPJ_BOOL opj_j2k_seek_next_tile_part (   opj_j2k_t *p_j2k,
+                                                opj_stream_private_t *p_stream,
+                                                opj_event_mgr_t * p_manager );
+
+/**
+ * Updates the checksum (Adler-32) of the main header with a marker segment.
+ *
+ * @param       p_checksum              the checksum of the previous marker segments.
+ * @param       p_data                  the data of the marker segment.
+ * @param       p_size                  the size of the data.
+ *
+ * @return      the new checksum.
+*/
+static OPJ_UINT32 opj_j2k_update_checksum ( OPJ_UINT32 p_checksum,
+                                            const OPJ_BYTE * p_data,
+                                            OPJ_UINT32 p_size );
+
+/**
+ * Checks that the index file loaded by opj_j2k_load_cstr_index describes the codestream whose main header was read,
+ * else forgets it.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_manager               the user event manager.
+*/
+static void opj_j2k_check_index_file (  opj_j2k_t *p_j2k,
+                                        opj_event_mgr_t * p_manager );
+
+/**
+ * Compares the positions of two tile-parts of the codestream index, to sort them in codestream order.
+*/
+static int opj_j2k_compare_index_tps (const void * p_tp1, const void * p_tp2);
+
+/**
+ * Allocates the per tile entries of the codec statistics once the number of tiles is known,
+ * and hands the statistics to the tile coder.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ *
+ * @return true if the statistics could be allocated, or are not collected.
+*/
+static OPJ_BOOL opj_j2k_init_codec_stats (opj_j2k_t *p_j2k);
+
+/**
+ * Reads the tile-part headers, and the data, of the next tile that can be decoded.
+ * See opj_j2k_read_tile_header, which times it for the codec statistics.
+*/
+static OPJ_BOOL opj_j2k_read_tile_parts(        opj_j2k_t * p_j2k,
+                                                OPJ_UINT32 * p_tile_index,
+                                                OPJ_UINT32 * p_data_size,
+                                                OPJ_INT32 * p_tile_x0, OPJ_INT32 * p_tile_y0,
+                                                OPJ_INT32 * p_tile_x1, OPJ_INT32 * p_tile_y1,
+                                                OPJ_UINT32 * p_nb_comps,
+                                                OPJ_BOOL * p_go_on,
+                                                opj_stream_private_t *p_stream,
+                                                opj_event_mgr_t * p_manager );
+
 #if 0
 /**
  * Reads a PPM marker (Packed packet headers, main header)
@@ -753,6 +1008,67 @@ static OPJ_BOOL opj_j2k_read_ppt (  opj_j2k_t *p_j2k,
                                     OPJ_BYTE * p_header_data,
                                     OPJ_UINT32 p_header_size,
                                     opj_event_mgr_t * p_manager );
+
+/**
+ * Stores the data of a PPM or PPT marker segment after the ones already read in the same header.
+ *
+ * @param       p_buffer        the buffer of the packed headers.
+ * @param       p_data_size     number of bytes stored in the buffer.
+ * @param       p_buffer_size   size of the memory allocated for the buffer.
+ * @param       p_markers       marker segments waiting in the buffer.
+ * @param       p_nb_markers    number of marker segments waiting in the buffer.
+ * @param       p_max_markers   size of the memory allocated for the marker segments.
+ * @param       p_index         index of the marker segment (Zppm or Zppt).
+ * @param       p_header_data   the data of the marker segment, after its index.
+ * @param       p_header_size   the size of the data.
+ * @param       p_manager       the user event manager.
+*/
+static OPJ_BOOL opj_j2k_add_ppx (   OPJ_BYTE ** p_buffer,
+                                    OPJ_UINT32 * p_data_size,
+                                    OPJ_UINT32 * p_buffer_size,
+                                    opj_j2k_ppx_t ** p_markers,
+                                    OPJ_UINT32 * p_nb_markers,
+                                    OPJ_UINT32 * p_max_markers,
+                                    OPJ_UINT32 p_index,
+                                    OPJ_BYTE * p_header_data,
+                                    OPJ_UINT32 p_header_size,
+                                    opj_event_mgr_t * p_manager );
+
+/**
+ * Puts the data of the PPM or PPT marker segments of a header in the order of their indexes.
+ * The data is only moved when the marker segments were not read in that order.
+ *
+ * @param       p_buffer        the buffer of the packed headers.
+ * @param       p_markers       marker segments of the header, stored from the same position up to the end of the buffer.
+ * @param       p_nb_markers    number of marker segments.
+ * @param       p_manager       the user event manager.
+*/
+static OPJ_BOOL opj_j2k_sort_ppx (  OPJ_BYTE * p_buffer,
+                                    opj_j2k_ppx_t * p_markers,
+                                    OPJ_UINT32 p_nb_markers,
+                                    opj_event_mgr_t * p_manager );
+
+/**
+ * Compares the indexes of two PPM or PPT marker segments, for qsort.
+*/
+static int opj_j2k_compare_ppx (const void * p_ppx1, const void * p_ppx2);
+
+/**
+ * Merges the PPM marker segments of the main header into the packet headers given to T2,
+ * without the Nppm lengths.
+ *
+ * @param       p_cp            the coding parameters.
+ * @param       p_manager       the user event manager.
+*/
+static OPJ_BOOL opj_j2k_merge_ppm ( opj_cp_t *p_cp, opj_event_mgr_t * p_manager );
+
+/**
+ * Appends the PPT marker segments of the current tile-part header to the packet headers given to T2.
+ *
+ * @param       p_tcp           the tile the tile-part belongs to.
+ * @param       p_manager       the user event manager.
+*/
+static OPJ_BOOL opj_j2k_merge_ppt ( opj_tcp_t *p_tcp, opj_event_mgr_t * p_manager );
 /**
  * Writes the TLM marker (Tile Length Marker)
  *
@@ -821,6 +1137,19 @@ static OPJ_BOOL opj_j2k_read_sod(   opj_j2k_t *p_j2k,
                                     opj_stream_private_t *p_stream,
                                     opj_event_mgr_t * p_manager );
 
+/**
+ * Gets the size of the buffer to allocate for the data of the current tile when its first
+ * tile-part is read: the lengths of all its tile-parts if they are known from the TLM markers,
+ * the length of the tile-part otherwise.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_stream                the stream, located at the data of the tile-part.
+ *
+ * @return      the number of bytes to allocate.
+*/
+static OPJ_UINT32 opj_j2k_get_tile_data_size_hint ( opj_j2k_t *p_j2k,
+                                                    opj_stream_private_t *p_stream );
+
 void opj_j2k_update_tlm (opj_j2k_t * p_j2k, OPJ_UINT32 p_tile_part_size )
 {
         opj_write_bytes(p_j2k->m_specific_param.m_encoder.m_tlm_sot_offsets_current,p_j2k->m_current_tile_number,1);            /* PSOT */
@@ -1286,6 +1615,28 @@ const opj_dec_memory_marker_handler_t j2k_memory_marker_handler_tab [] =
   {J2K_MS_UNK, J2K_STATE_MH | J2K_STATE_TPH, 0}/*opj_j2k_read_unk is directly used*/
 };
 
+/**
+ * Index file written by opj_j2k_save_cstr_index, all the values being big endian :
+ * magic, version, stamp (8 bytes), length of the stream (8 bytes), main header start and end (8 bytes each),
+ * main header checksum, number of tiles, number of tile-parts,
+ * then for each tile-part in codestream order : tile number, length, number of packets,
+ * then the length of each packet.
+ */
+#define OPJ_J2K_INDEX_MAGIC             0x6f6a6978      /* "ojix" */
+#define OPJ_J2K_INDEX_VERSION           1
+#define OPJ_J2K_INDEX_HEADER_SIZE       52
+#define OPJ_J2K_INDEX_TP_SIZE           12
+
+/**
+ * Tile-part of the codestream index, sorted in codestream order when saving the index file
+ */
+typedef struct opj_j2k_index_tp
+{
+        OPJ_UINT32 m_tile_no;
+        opj_tp_index_t * m_tp_index;
+}
+opj_j2k_index_tp_t;
+
 void  opj_j2k_read_int16_to_float (const void * p_src_data, void * p_dest_data, OPJ_UINT32 p_nb_elem)
 {
         OPJ_BYTE * l_src_data = (OPJ_BYTE *) p_src_data;
@@ -1923,7 +2274,6 @@ static OPJ_BOOL opj_j2k_read_siz(opj_j2k_t *p_j2k,
         opj_image_t *l_image = 00;
         opj_cp_t *l_cp = 00;
         opj_image_comp_t * l_img_comp = 00;
-        opj_tcp_t * l_current_tile_param = 00;
 
         /* preconditions */
         assert(p_j2k != 00);
@@ -2222,17 +2572,6 @@ static OPJ_BOOL opj_j2k_read_siz(opj_j2k_t *p_j2k,
                 }
         }
 
-        l_current_tile_param = l_cp->tcps;
-        for     (i = 0; i < l_nb_tiles; ++i) {
-                l_current_tile_param->tccps = (opj_tccp_t*) opj_calloc(l_image->numcomps, sizeof(opj_tccp_t));
-                if (l_current_tile_param->tccps == 00) {
-                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to take in charge SIZ marker\n");
-                        return OPJ_FALSE;
-                }
-
-                ++l_current_tile_param;
-        }
-
         p_j2k->m_specific_param.m_decoder.m_state =  J2K_STATE_MH; /* FIXME J2K_DEC_STATE_MH; */
         opj_image_comp_header_update(l_image,l_cp);
 
@@ -3101,6 +3440,114 @@ OPJ_UINT32 opj_j2k_get_max_toc_size (opj_j2k_t *p_j2k)
         return 12 * l_max;
 }
 
+OPJ_UINT32 opj_j2k_get_max_plt_size (opj_j2k_t *p_j2k)
+{
+        OPJ_UINT32 compno, resno;
+        OPJ_UINT32 l_nb_precincts = 0;
+        opj_cp_t * l_cp = &(p_j2k->m_cp);
+        opj_tccp_t * l_tccp = l_cp->tcps->tccps;
+        opj_image_comp_t * l_img_comp = p_j2k->m_private_image->comps;
+
+        if (! l_cp->m_specific_param.m_enc.m_plt_on) {
+                return 0;
+        }
+
+        /* all the tiles share the same coding parameters, the precincts may not be aligned on the tile */
+        for (compno = 0; compno < p_j2k->m_private_image->numcomps; ++compno) {
+                OPJ_UINT32 l_width = opj_uint_ceildiv(l_cp->tdx, l_img_comp->dx);
+                OPJ_UINT32 l_height = opj_uint_ceildiv(l_cp->tdy, l_img_comp->dy);
+
+                for (resno = 0; resno < l_tccp->numresolutions; ++resno) {
+                        OPJ_UINT32 l_level = l_tccp->numresolutions - 1 - resno;
+                        OPJ_UINT64 l_res_width = ((OPJ_UINT64)l_width + (1U << l_level) - 1) >> l_level;
+                        OPJ_UINT64 l_res_height = ((OPJ_UINT64)l_height + (1U << l_level) - 1) >> l_level;
+                        OPJ_UINT64 l_pw = ((l_res_width + (1U << l_tccp->prcw[resno]) - 1) >> l_tccp->prcw[resno]) + 1;
+                        OPJ_UINT64 l_ph = ((l_res_height + (1U << l_tccp->prch[resno]) - 1) >> l_tccp->prch[resno]) + 1;
+
+                        l_nb_precincts += (OPJ_UINT32)(l_pw * l_ph);
+                }
+                ++l_tccp;
+                ++l_img_comp;
+        }
+
+        return opj_j2k_get_plt_room(l_nb_precincts * l_cp->tcps->numlayers);
+}
+
+OPJ_UINT32 opj_j2k_get_plt_room (OPJ_UINT32 p_nb_packets)
+{
+        /* at most 5 bytes by length, a marker holds at least 65528 bytes of lengths */
+        return 5 * p_nb_packets + 5 * (5 * p_nb_packets / 65528 + 1);
+}
+
+OPJ_UINT32 opj_j2k_get_plt_size (const OPJ_UINT32 * p_lengths,
+                                 OPJ_UINT32 p_nb_packets)
+{
+        OPJ_UINT32 i, l_size = 0, l_marker_size = 65532;
+
+        for (i = 0; i < p_nb_packets; ++i) {
+                OPJ_UINT32 l_nb_bytes = 1;
+                while ((l_nb_bytes < 5) && (p_lengths[i] >> (7 * l_nb_bytes))) {
+                        ++l_nb_bytes;
+                }
+                /* the lengths of a packet are not split on two markers */
+                if (l_marker_size + l_nb_bytes > 65532) {
+                        l_size += 5;
+                        l_marker_size = 0;
+                }
+                l_marker_size += l_nb_bytes;
+                l_size += l_nb_bytes;
+        }
+
+        return l_size;
+}
+
+OPJ_BOOL opj_j2k_write_plt_in_memory(const OPJ_UINT32 * p_lengths,
+                                     OPJ_UINT32 p_nb_packets,
+                                     OPJ_BYTE * p_data,
+                                     OPJ_UINT32 * p_data_written,
+                                     opj_event_mgr_t * p_manager )
+{
+        OPJ_UINT32 i, j, l_marker_size = 65532, l_Zplt = 0;
+        OPJ_BYTE * l_begin_data = p_data;
+        OPJ_BYTE * l_Lplt = 00;
+
+        for (i = 0; i < p_nb_packets; ++i) {
+                OPJ_UINT32 l_nb_bytes = 1;
+                while ((l_nb_bytes < 5) && (p_lengths[i] >> (7 * l_nb_bytes))) {
+                        ++l_nb_bytes;
+                }
+
+                if (l_marker_size + l_nb_bytes > 65532) {
+                        if (l_Lplt) {
+                                opj_write_bytes(l_Lplt, l_marker_size + 3, 2);          /* Lplt */
+                        }
+                        if (l_Zplt > 255) {
+                                opj_event_msg(p_manager, EVT_ERROR, "Too many packets to write their lengths in PLT markers\n");
+                                return OPJ_FALSE;
+                        }
+                        opj_write_bytes(p_data, J2K_MS_PLT, 2);                         /* PLT */
+                        p_data += 2;
+                        l_Lplt = p_data;
+                        p_data += 2;
+                        opj_write_bytes(p_data, l_Zplt++, 1);                           /* Zplt */
+                        ++p_data;
+                        l_marker_size = 0;
+                }
+
+                /* seven bits by byte, most significant first, the last byte has its high bit unset */
+                for (j = l_nb_bytes; j-- > 0;) {
+                        *p_data++ = (OPJ_BYTE)(((p_lengths[i] >> (7 * j)) & 0x7f) | (j ? 0x80 : 0));    /* Iplt_i */
+                }
+                l_marker_size += l_nb_bytes;
+        }
+        if (l_Lplt) {
+                opj_write_bytes(l_Lplt, l_marker_size + 3, 2);                          /* Lplt */
+        }
+
+        *p_data_written = (OPJ_UINT32)(p_data - l_begin_data);
+        return OPJ_TRUE;
+}
+
 OPJ_UINT32 opj_j2k_get_specific_header_sizes(opj_j2k_t *p_j2k)
 {
         OPJ_UINT32 l_nb_bytes = 0;
@@ -3121,6 +3568,7 @@ OPJ_UINT32 opj_j2k_get_specific_header_sizes(opj_j2k_t *p_j2k)
         l_nb_bytes += opj_j2k_get_max_poc_size(p_j2k);
 
         /*** DEVELOPER CORNER, Add room for your headers ***/
+        l_nb_bytes += opj_j2k_get_max_plt_size(p_j2k);
 
         return l_nb_bytes;
 }
@@ -3267,7 +3715,8 @@ static OPJ_BOOL opj_j2k_read_tlm (  opj_j2k_t *p_j2k,
                                     opj_event_mgr_t * p_manager
                                     )
 {
-        OPJ_UINT32 l_Ztlm, l_Stlm, l_ST, l_SP, l_tot_num_tp_remaining, l_quotient, l_Ptlm_size;
+        OPJ_UINT32 l_Ztlm, l_Stlm, l_ST, l_SP, l_tot_num_tp, l_quotient, l_Ptlm_size, i;
+        opj_j2k_dec_t * l_dec = 00;
         /* preconditions */
         assert(p_header_data != 00);
         assert(p_j2k != 00);
@@ -3290,22 +3739,51 @@ static OPJ_BOOL opj_j2k_read_tlm (  opj_j2k_t *p_j2k,
         l_Ptlm_size = (l_SP + 1) * 2;
         l_quotient = l_Ptlm_size + l_ST;
 
-        l_tot_num_tp_remaining = p_header_size % l_quotient;
-
-        if (l_tot_num_tp_remaining != 0) {
+        if ((p_header_size % l_quotient) != 0) {
                 opj_event_msg(p_manager, EVT_ERROR, "Error reading TLM marker\n");
                 return OPJ_FALSE;
         }
-        /* FIXME Do not care of this at the moment since only local variables are set here */
-        /*
-        for
-                (i = 0; i < l_tot_num_tp; ++i)
-        {
-                opj_read_bytes(p_header_data,&l_Ttlm_i,l_ST);                           // Ttlm_i
-                p_header_data += l_ST;
-                opj_read_bytes(p_header_data,&l_Ptlm_i,l_Ptlm_size);            // Ptlm_i
+        l_tot_num_tp = p_header_size / l_quotient;
+
+        l_dec = &p_j2k->m_specific_param.m_decoder;
+        if (l_dec->m_tlm_invalid || l_dec->m_index_file) {
+                return OPJ_TRUE;
+        }
+        /* the tile-parts are only known in codestream order if the markers come in Ztlm order */
+        if ((l_ST == 3) || (l_Ztlm != l_dec->m_nb_tlm_markers++)) {
+                opj_event_msg(p_manager, EVT_WARNING, "TLM marker %d is not usable, tile-part lengths are ignored\n", l_Ztlm);
+                l_dec->m_tlm_invalid = 1;
+                return OPJ_TRUE;
+        }
+
+        if (l_dec->m_nb_tlm + l_tot_num_tp > l_dec->m_max_tlm) {
+                opj_j2k_tlm_info_t * l_new_tlm;
+                OPJ_UINT32 l_new_max = l_dec->m_nb_tlm + l_tot_num_tp + l_dec->m_max_tlm;
+
+                l_new_tlm = (opj_j2k_tlm_info_t *) opj_realloc(l_dec->m_tlm, l_new_max * sizeof(opj_j2k_tlm_info_t));
+                if (! l_new_tlm) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read TLM marker\n");
+                        return OPJ_FALSE;
+                }
+                l_dec->m_tlm = l_new_tlm;
+                l_dec->m_max_tlm = l_new_max;
+        }
+
+        for (i = 0; i < l_tot_num_tp; ++i) {
+                opj_j2k_tlm_info_t * l_tlm = &l_dec->m_tlm[l_dec->m_nb_tlm];
+
+                if (l_ST) {
+                        opj_read_bytes(p_header_data,&l_tlm->m_tile_no,l_ST);     /* Ttlm_i */
+                        p_header_data += l_ST;
+                }
+                else {
+                        /* one tile-part per tile, in tile order */
+                        l_tlm->m_tile_no = l_dec->m_nb_tlm;
+                }
+                opj_read_bytes(p_header_data,&l_tlm->m_length,l_Ptlm_size);       /* Ptlm_i */
                 p_header_data += l_Ptlm_size;
-        }*/
+                ++l_dec->m_nb_tlm;
+        }
         return OPJ_TRUE;
 }
 
@@ -3323,6 +3801,9 @@ static OPJ_BOOL opj_j2k_read_plm (  opj_j2k_t *p_j2k,
                                     opj_event_mgr_t * p_manager
                                     )
 {
+        OPJ_UINT32 l_Zplm, l_Nplm, l_tmp, l_packet_len, i;
+        opj_j2k_dec_t * l_dec = 00;
+
         /* preconditions */
         assert(p_header_data != 00);
         assert(p_j2k != 00);
@@ -3332,50 +3813,76 @@ static OPJ_BOOL opj_j2k_read_plm (  opj_j2k_t *p_j2k,
                 opj_event_msg(p_manager, EVT_ERROR, "Error reading PLM marker\n");
                 return OPJ_FALSE;
         }
-        /* Do not care of this at the moment since only local variables are set here */
-        /*
-        opj_read_bytes(p_header_data,&l_Zplm,1);                                        // Zplm
+
+        opj_read_bytes(p_header_data,&l_Zplm,1);                                        /* Zplm */
         ++p_header_data;
         --p_header_size;
 
-        while
-                (p_header_size > 0)
-        {
-                opj_read_bytes(p_header_data,&l_Nplm,1);                                // Nplm
+        l_dec = &p_j2k->m_specific_param.m_decoder;
+        if (l_dec->m_plm_invalid || l_dec->m_index_file) {
+                return OPJ_TRUE;
+        }
+        if (l_Zplm != l_dec->m_nb_plm_markers++) {
+                opj_event_msg(p_manager, EVT_WARNING, "PLM marker %d is not usable, packet lengths are ignored\n", l_Zplm);
+                l_dec->m_plm_invalid = 1;
+                return OPJ_TRUE;
+        }
+
+        while (p_header_size > 0) {
+                opj_read_bytes(p_header_data,&l_Nplm,1);                                /* Nplm */
                 ++p_header_data;
-                p_header_size -= (1+l_Nplm);
-                if
-                        (p_header_size < 0)
-                {
+                --p_header_size;
+                if (l_Nplm > p_header_size) {
                         opj_event_msg(p_manager, EVT_ERROR, "Error reading PLM marker\n");
-                        return false;
+                        return OPJ_FALSE;
                 }
-                for
-                        (i = 0; i < l_Nplm; ++i)
-                {
-                        opj_read_bytes(p_header_data,&l_tmp,1);                         // Iplm_ij
+                p_header_size -= l_Nplm;
+
+                /* each Nplm starts the packets of a new tile-part */
+                if (l_dec->m_nb_plm_tps == l_dec->m_max_plm_tps) {
+                        OPJ_UINT32 * l_new_tps;
+                        l_dec->m_max_plm_tps += 64;
+                        l_new_tps = (OPJ_UINT32 *) opj_realloc(l_dec->m_plm_tp_nb_packets, l_dec->m_max_plm_tps * sizeof(OPJ_UINT32));
+                        if (! l_new_tps) {
+                                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read PLM marker\n");
+                                return OPJ_FALSE;
+                        }
+                        l_dec->m_plm_tp_nb_packets = l_new_tps;
+                }
+                l_dec->m_plm_tp_nb_packets[l_dec->m_nb_plm_tps] = 0;
+
+                l_packet_len = 0;
+                for (i = 0; i < l_Nplm; ++i) {
+                        opj_read_bytes(p_header_data,&l_tmp,1);                         /* Iplm_ij */
                         ++p_header_data;
-                        // take only the last seven bytes
+                        /* take only the last seven bytes */
                         l_packet_len |= (l_tmp & 0x7f);
-                        if
-                                (l_tmp & 0x80)
-                        {
+                        if (l_tmp & 0x80) {
                                 l_packet_len <<= 7;
                         }
-                        else
-                        {
-                // store packet length and proceed to next packet
+                        else {
+                                /* store packet length and proceed to next packet */
+                                if (l_dec->m_nb_plm_lengths == l_dec->m_max_plm_lengths) {
+                                        OPJ_UINT32 * l_new_lengths;
+                                        l_dec->m_max_plm_lengths += 1024;
+                                        l_new_lengths = (OPJ_UINT32 *) opj_realloc(l_dec->m_plm_lengths, l_dec->m_max_plm_lengths * sizeof(OPJ_UINT32));
+                                        if (! l_new_lengths) {
+                                                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read PLM marker\n");
+                                                return OPJ_FALSE;
+                                        }
+                                        l_dec->m_plm_lengths = l_new_lengths;
+                                }
+                                l_dec->m_plm_lengths[l_dec->m_nb_plm_lengths++] = l_packet_len;
+                                ++l_dec->m_plm_tp_nb_packets[l_dec->m_nb_plm_tps];
                                 l_packet_len = 0;
                         }
                 }
-                if
-                        (l_packet_len != 0)
-                {
+                if (l_packet_len != 0) {
                         opj_event_msg(p_manager, EVT_ERROR, "Error reading PLM marker\n");
-                        return false;
+                        return OPJ_FALSE;
                 }
+                ++l_dec->m_nb_plm_tps;
         }
-        */
         return OPJ_TRUE;
 }
 
@@ -3394,6 +3901,8 @@ static OPJ_BOOL opj_j2k_read_plt (  opj_j2k_t *p_j2k,
                                     )
 {
         OPJ_UINT32 l_Zplt, l_tmp, l_packet_len = 0, i;
+        opj_tile_index_t * l_tile_index = 00;
+        opj_tp_index_t * l_tp_index = 00;
 
         /* preconditions */
         assert(p_header_data != 00);
@@ -3409,6 +3918,11 @@ static OPJ_BOOL opj_j2k_read_plt (  opj_j2k_t *p_j2k,
         ++p_header_data;
         --p_header_size;
 
+        if (p_j2k->m_specific_param.m_decoder.m_record_plt && p_j2k->cstr_index) {
+                l_tile_index = &p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number];
+                l_tp_index = &l_tile_index->tp_index[l_tile_index->current_tpsno];
+        }
+
         for (i = 0; i < p_header_size; ++i) {
                 opj_read_bytes(p_header_data,&l_tmp,1);         /* Iplt_ij */
                 ++p_header_data;
@@ -3419,6 +3933,13 @@ static OPJ_BOOL opj_j2k_read_plt (  opj_j2k_t *p_j2k,
                 }
                 else {
             /* store packet length and proceed to next packet */
+                        if (l_tp_index) {
+                                if (! opj_j2k_add_packet_length(l_tile_index, l_packet_len)) {
+                                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read PLT marker\n");
+                                        return OPJ_FALSE;
+                                }
+                                ++l_tp_index->nb_packets;
+                        }
                         l_packet_len = 0;
                 }
         }
@@ -3431,6 +3952,295 @@ static OPJ_BOOL opj_j2k_read_plt (  opj_j2k_t *p_j2k,
         return OPJ_TRUE;
 }
 
+OPJ_BOOL opj_j2k_build_tlm_index (  opj_j2k_t *p_j2k,
+                                    opj_stream_private_t *p_stream,
+                                    opj_event_mgr_t * p_manager )
+{
+        opj_j2k_dec_t * l_dec = &p_j2k->m_specific_param.m_decoder;
+        opj_codestream_index_t * l_cstr_index = p_j2k->cstr_index;
+        OPJ_UINT32 l_nb_tiles = p_j2k->m_cp.tw * p_j2k->m_cp.th;
+        OPJ_OFF_T l_bytes_left, l_pos;
+        OPJ_UINT32 i, l_nb_lengths = 0;
+        opj_j2k_tlm_info_t * l_tlm;
+
+        if (l_dec->m_tlm_invalid || (l_dec->m_nb_tlm == 0) || (! l_cstr_index->tile_index)) {
+                return OPJ_TRUE;
+        }
+
+        /* the main header was read up to the marker ID of the first SOT */
+        l_bytes_left = opj_stream_get_number_byte_left(p_stream) + 2;
+        for (i = 0, l_tlm = l_dec->m_tlm; i < l_dec->m_nb_tlm; ++i, ++l_tlm) {
+                if ((l_tlm->m_tile_no >= l_nb_tiles) || (l_tlm->m_length < 14) || ((OPJ_OFF_T)l_tlm->m_length > l_bytes_left)
+                        || (l_cstr_index->tile_index[l_tlm->m_tile_no].nb_tps == 255)) {
+                        opj_event_msg(p_manager, EVT_WARNING, "TLM markers do not match the codestream, tile-part lengths are ignored\n");
+                        l_dec->m_tlm_invalid = 1;
+                        for (i = 0; i < l_nb_tiles; ++i) {
+                                l_cstr_index->tile_index[i].nb_tps = 0;
+                        }
+                        return OPJ_TRUE;
+                }
+                l_bytes_left -= l_tlm->m_length;
+                ++l_cstr_index->tile_index[l_tlm->m_tile_no].nb_tps;
+        }
+
+        for (i = 0; i < l_nb_tiles; ++i) {
+                opj_tile_index_t * l_tile_index = &l_cstr_index->tile_index[i];
+
+                l_tile_index->tileno = i;
+                l_tile_index->current_nb_tps = l_tile_index->nb_tps;
+                if (l_tile_index->nb_tps) {
+                        l_tile_index->tp_index = (opj_tp_index_t *) opj_calloc(l_tile_index->nb_tps, sizeof(opj_tp_index_t));
+                        if (! l_tile_index->tp_index) {
+                                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read TLM marker\n");
+                                return OPJ_FALSE;
+                        }
+                }
+                /* counts the tile-parts while they are placed */
+                l_tile_index->nb_tps = 0;
+        }
+
+        /* the packets of the PLM markers can be given to the tile-parts if they are as many */
+        if (l_dec->m_plm_invalid || (l_dec->m_nb_plm_tps != l_dec->m_nb_tlm)) {
+                l_dec->m_plm_invalid = 1;
+        }
+
+        l_pos = l_cstr_index->main_head_end;
+        for (i = 0, l_tlm = l_dec->m_tlm; i < l_dec->m_nb_tlm; ++i, ++l_tlm) {
+                opj_tile_index_t * l_tile_index = &l_cstr_index->tile_index[l_tlm->m_tile_no];
+                opj_tp_index_t * l_tp_index = &l_tile_index->tp_index[l_tile_index->nb_tps++];
+
+                l_tp_index->start_pos = l_pos;
+                l_pos += l_tlm->m_length;
+                l_tp_index->end_pos = l_pos;
+
+                if (! l_dec->m_plm_invalid) {
+                        OPJ_UINT32 j;
+                        l_tp_index->first_packet = l_tile_index->nb_packet;
+                        for (j = 0; j < l_dec->m_plm_tp_nb_packets[i]; ++j) {
+                                if (! opj_j2k_add_packet_length(l_tile_index, l_dec->m_plm_lengths[l_nb_lengths++])) {
+                                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read PLM marker\n");
+                                        return OPJ_FALSE;
+                                }
+                        }
+                        l_tp_index->nb_packets = l_dec->m_plm_tp_nb_packets[i];
+                }
+        }
+        if (! l_dec->m_plm_invalid) {
+                l_dec->m_nb_tile_parts_read = l_dec->m_nb_tlm;
+                l_dec->m_nb_plm_lengths_read = l_nb_lengths;
+        }
+
+        l_dec->m_tlm_index = 1;
+        l_dec->m_tlm_seeks = 1;
+        return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_add_packet_length (opj_tile_index_t * p_tile_index,
+                                    OPJ_UINT32 p_length)
+{
+        OPJ_UINT32 l_nb_packet = p_tile_index->nb_packet;
+        opj_packet_info_t * l_packet;
+
+        /* the array grows by powers of two from 16 packets */
+        if ((l_nb_packet == 0) || ((l_nb_packet >= 16) && ((l_nb_packet & (l_nb_packet - 1)) == 0))) {
+                OPJ_UINT32 l_max_packet = l_nb_packet ? 2 * l_nb_packet : 16;
+                opj_packet_info_t * l_new_packet_index;
+
+                if (l_max_packet < l_nb_packet) {
+                        return OPJ_FALSE;
+                }
+                l_new_packet_index = (opj_packet_info_t *) opj_realloc(p_tile_index->packet_index, l_max_packet * sizeof(opj_packet_info_t));
+                if (! l_new_packet_index) {
+                        return OPJ_FALSE;
+                }
+                p_tile_index->packet_index = l_new_packet_index;
+        }
+
+        /* positions relative to the tile-part data until it is reached */
+        l_packet = &p_tile_index->packet_index[l_nb_packet];
+        l_packet->start_pos = 0;
+        l_packet->end_ph_pos = 0;
+        l_packet->end_pos = (OPJ_OFF_T)p_length - 1;
+        l_packet->disto = 0;
+        ++p_tile_index->nb_packet;
+
+        return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_index_tile_part_packets (  opj_j2k_t *p_j2k,
+                                            OPJ_BOOL p_new_tile_part )
+{
+        opj_j2k_dec_t * l_dec = &p_j2k->m_specific_param.m_decoder;
+        opj_tile_index_t * l_tile_index;
+        opj_tp_index_t * l_tp_index;
+
+        l_dec->m_record_plt = 0;
+        if (! p_j2k->cstr_index || ! p_j2k->cstr_index->tile_index) {
+                return OPJ_TRUE;
+        }
+        l_tile_index = &p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number];
+        l_tp_index = &l_tile_index->tp_index[l_tile_index->current_tpsno];
+
+        if (p_new_tile_part && (l_dec->m_nb_tile_parts_read < l_dec->m_nb_plm_tps) && ! l_dec->m_plm_invalid) {
+                /* the PLM markers list the packets of the tile-parts in codestream order */
+                OPJ_UINT32 l_nb_packets = l_dec->m_plm_tp_nb_packets[l_dec->m_nb_tile_parts_read];
+                OPJ_UINT32 i;
+
+                if (l_tp_index->nb_packets == 0) {
+                        l_tp_index->first_packet = l_tile_index->nb_packet;
+                        for (i = 0; i < l_nb_packets; ++i) {
+                                if (! opj_j2k_add_packet_length(l_tile_index, l_dec->m_plm_lengths[l_dec->m_nb_plm_lengths_read + i])) {
+                                        return OPJ_FALSE;
+                                }
+                        }
+                        l_tp_index->nb_packets = l_nb_packets;
+                }
+                l_dec->m_nb_plm_lengths_read += l_nb_packets;
+        }
+        if (p_new_tile_part) {
+                ++l_dec->m_nb_tile_parts_read;
+        }
+
+        /* else the PLT markers of the tile-part header give its packets */
+        if ((l_tp_index->nb_packets == 0) && ! l_dec->m_skip_data) {
+                l_tp_index->first_packet = l_tile_index->nb_packet;
+                l_dec->m_record_plt = 1;
+        }
+
+        return OPJ_TRUE;
+}
+
+void opj_j2k_reset_tlm_index (opj_j2k_t *p_j2k)
+{
+        OPJ_UINT32 i, j;
+
+        p_j2k->m_specific_param.m_decoder.m_tlm_index = 0;
+        p_j2k->m_specific_param.m_decoder.m_tlm_invalid = 1;
+        p_j2k->m_specific_param.m_decoder.m_plm_invalid = 1;
+
+        for (i = 0; i < p_j2k->cstr_index->nb_of_tiles; ++i) {
+                opj_tile_index_t * l_tile_index = &p_j2k->cstr_index->tile_index[i];
+
+                /* the tile-parts already read have their end of header */
+                if (l_tile_index->tp_index && (l_tile_index->tp_index[0].end_header == 0)) {
+                        l_tile_index->nb_tps = 0;
+                        l_tile_index->nb_packet = 0;
+                        for (j = 0; j < l_tile_index->current_nb_tps; ++j) {
+                                memset(&l_tile_index->tp_index[j], 0, sizeof(opj_tp_index_t));
+                        }
+                }
+        }
+}
+
+OPJ_BOOL opj_j2k_seek_next_tile_part (  opj_j2k_t *p_j2k,
+                                        opj_stream_private_t *p_stream,
+                                        opj_event_mgr_t * p_manager )
+{
+        opj_j2k_dec_t * l_dec = &p_j2k->m_specific_param.m_decoder;
+        opj_tile_index_t * l_tile_index;
+        OPJ_OFF_T l_pos, l_next_pos;
+
+        if (l_dec->m_can_decode || ! l_dec->m_tlm_index || (l_dec->m_state != J2K_STATE_TPHSOT)
+                || (l_dec->m_tile_ind_to_dec != (OPJ_INT32)p_j2k->m_current_tile_number)) {
+                return OPJ_TRUE;
+        }
+
+        l_tile_index = &p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number];
+        if (l_tile_index->current_tpsno + 1 >= l_tile_index->nb_tps) {
+                /* no need to look further for tile-parts of this tile */
+                l_dec->m_can_decode = 1;
+                return OPJ_TRUE;
+        }
+
+        l_pos = opj_stream_tell(p_stream);
+        l_next_pos = l_tile_index->tp_index[l_tile_index->current_tpsno + 1].start_pos;
+        if (! opj_j2k_check_tlm_tile_part(p_j2k, p_stream, p_j2k->m_current_tile_number, l_tile_index->current_tpsno + 1, p_manager)) {
+                /* carry on with the tile-part after the current one */
+                l_next_pos = l_pos;
+        }
+        if (! opj_stream_read_seek(p_stream, l_next_pos, p_manager)) {
+                opj_event_msg(p_manager, EVT_ERROR, "Problem with seek function\n");
+                return OPJ_FALSE;
+        }
+        return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_check_tlm_tile_part (  opj_j2k_t *p_j2k,
+                                        opj_stream_private_t *p_stream,
+                                        OPJ_UINT32 p_tile_no,
+                                        OPJ_UINT32 p_tp_no,
+                                        opj_event_mgr_t * p_manager )
+{
+        opj_tp_index_t * l_tp_index = &p_j2k->cstr_index->tile_index[p_tile_no].tp_index[p_tp_no];
+        OPJ_BYTE l_data [12];
+        OPJ_UINT32 l_marker = 0, l_Lsot = 0, l_Isot = 0, l_Psot = 0, l_TPsot = 0;
+
+        if (opj_stream_read_seek(p_stream, l_tp_index->start_pos, p_manager)
+                && (opj_stream_read_data(p_stream, l_data, 12, p_manager) == 12)) {
+                opj_read_bytes(l_data, &l_marker, 2);                   /* SOT */
+                opj_read_bytes(l_data + 2, &l_Lsot, 2);                 /* Lsot */
+                opj_read_bytes(l_data + 4, &l_Isot, 2);                 /* Isot */
+                opj_read_bytes(l_data + 6, &l_Psot, 4);                 /* Psot */
+                opj_read_bytes(l_data + 10, &l_TPsot, 1);               /* TPsot */
+        }
+        if ((l_marker != J2K_MS_SOT) || (l_Lsot != 10) || (l_Isot != p_tile_no) || (l_TPsot != p_tp_no)
+                || (l_Psot && ((OPJ_OFF_T)l_Psot != l_tp_index->end_pos - l_tp_index->start_pos))) {
+                opj_event_msg(p_manager, EVT_WARNING, "TLM markers do not match the codestream, tile-part lengths are ignored\n");
+                opj_j2k_reset_tlm_index(p_j2k);
+                return OPJ_FALSE;
+        }
+        return OPJ_TRUE;
+}
+
+OPJ_UINT32 opj_j2k_update_checksum (OPJ_UINT32 p_checksum,
+                                    const OPJ_BYTE * p_data,
+                                    OPJ_UINT32 p_size )
+{
+        OPJ_UINT32 l_a = p_checksum & 0xffff;
+        OPJ_UINT32 l_b = p_checksum >> 16;
+
+        while (p_size > 0) {
+                /* the sums do not overflow before 5552 bytes */
+                OPJ_UINT32 l_size = opj_uint_min(p_size, 5552);
+                p_size -= l_size;
+                while (l_size--) {
+                        l_a += *p_data++;
+                        l_b += l_a;
+                }
+                l_a %= 65521;
+                l_b %= 65521;
+        }
+
+        return (l_b << 16) | l_a;
+}
+
+void opj_j2k_check_index_file ( opj_j2k_t *p_j2k,
+                                opj_event_mgr_t * p_manager )
+{
+        opj_j2k_dec_t * l_dec = &p_j2k->m_specific_param.m_decoder;
+
+        if (! l_dec->m_index_file) {
+                return;
+        }
+        if ((l_dec->m_index_nb_tiles != p_j2k->m_cp.tw * p_j2k->m_cp.th)
+                || (l_dec->m_index_stream_length != l_dec->m_stream_length)
+                || (l_dec->m_index_main_head_start != p_j2k->cstr_index->main_head_start)
+                || (l_dec->m_index_main_head_end != p_j2k->cstr_index->main_head_end)
+                || (l_dec->m_index_header_checksum != l_dec->m_header_checksum)) {
+                opj_event_msg(p_manager, EVT_WARNING, "The index file does not match the codestream, it is ignored\n");
+                l_dec->m_tlm_invalid = 1;
+                l_dec->m_plm_invalid = 1;
+        }
+}
+
+int opj_j2k_compare_index_tps (const void * p_tp1, const void * p_tp2)
+{
+        OPJ_OFF_T l_pos1 = ((const opj_j2k_index_tp_t *) p_tp1)->m_tp_index->start_pos;
+        OPJ_OFF_T l_pos2 = ((const opj_j2k_index_tp_t *) p_tp2)->m_tp_index->start_pos;
+
+        return (l_pos1 > l_pos2) - (l_pos1 < l_pos2);
+}
+
 #if 0
 OPJ_BOOL j2k_read_ppm_v2 (
                                                 opj_j2k_t *p_j2k,
@@ -3542,7 +4352,7 @@ OPJ_BOOL j2k_read_ppm_v3 (
                                         )
 {
         opj_cp_t *l_cp = 00;
-        OPJ_UINT32 l_remaining_data, l_Z_ppm, l_N_ppm;
+        OPJ_UINT32 l_Z_ppm;
 
         /* preconditions */
         assert(p_header_data != 00);
@@ -3562,251 +4372,11 @@ OPJ_BOOL j2k_read_ppm_v3 (
         ++p_header_data;
         --p_header_size;
 
-        /* First PPM marker */
-        if (l_Z_ppm == 0) {
-                if (l_cp->ppm_data != NULL) {
-                        opj_event_msg(p_manager, EVT_ERROR, "Zppm O already processed. Found twice.\n");
-                        opj_free(l_cp->ppm_data);
-                        l_cp->ppm_data = NULL;
-                        l_cp->ppm_buffer = NULL;
-                        l_cp->ppm = 0; /* do not use PPM */
-                        return OPJ_FALSE;
-                }
-                /* We need now at least the Nppm^0 element */
-                if (p_header_size < 4) {
-                        opj_event_msg(p_manager, EVT_ERROR, "Error reading PPM marker\n");
-                        return OPJ_FALSE;
-                }
-
-                opj_read_bytes(p_header_data,&l_N_ppm,4);               /* First N_ppm */
-                p_header_data+=4;
-                p_header_size-=4;
-
-                /* sanity check: how much bytes is left for Ippm */
-                if( p_header_size < l_N_ppm )
-                  {
-                  opj_event_msg(p_manager, EVT_ERROR, "Not enough bytes (%u) to hold Ippm series (%u), Index (%d)\n", p_header_size, l_N_ppm, l_Z_ppm );
-                  opj_free(l_cp->ppm_data);
-                  l_cp->ppm_data = NULL;
-                  l_cp->ppm_buffer = NULL;
-                  l_cp->ppm = 0; /* do not use PPM */
-                  return OPJ_FALSE;
-                  }
-
-                /* First PPM marker: Initialization */
-                l_cp->ppm_len = l_N_ppm;
-                l_cp->ppm_data_read = 0;
-
-                l_cp->ppm_data = (OPJ_BYTE *) opj_calloc(1,l_cp->ppm_len);
-                l_cp->ppm_buffer = l_cp->ppm_data;
-                if (l_cp->ppm_data == 00) {
-                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read ppm marker\n");
-                        return OPJ_FALSE;
-                }
-
-                l_cp->ppm_data_current = l_cp->ppm_data;
-
-                /*l_cp->ppm_data = l_cp->ppm_buffer;*/
-        }
-        else {
-                if (p_header_size < 4) {
-                        opj_event_msg(p_manager, EVT_WARNING, "Empty PPM marker\n");
-                        return OPJ_TRUE;
-                }
-                else {
-                        /* Uncompleted Ippm series in the previous PPM marker?*/
-                        if (l_cp->ppm_data_read < l_cp->ppm_len) {
-                                /* Get the place where add the remaining Ippm series*/
-                                l_cp->ppm_data_current = &(l_cp->ppm_data[l_cp->ppm_data_read]);
-                                l_N_ppm = l_cp->ppm_len - l_cp->ppm_data_read;
-                        }
-                        else {
-                                OPJ_BYTE *new_ppm_data;
-                                opj_read_bytes(p_header_data,&l_N_ppm,4);               /* First N_ppm */
-                                p_header_data+=4;
-                                p_header_size-=4;
-
-                                /* sanity check: how much bytes is left for Ippm */
-                                if( p_header_size < l_N_ppm )
-                                  {
-                                  opj_event_msg(p_manager, EVT_ERROR, "Not enough bytes (%u) to hold Ippm series (%u), Index (%d)\n", p_header_size, l_N_ppm, l_Z_ppm );
-                                  opj_free(l_cp->ppm_data);
-                                  l_cp->ppm_data = NULL;
-                                  l_cp->ppm_buffer = NULL;
-                                  l_cp->ppm = 0; /* do not use PPM */
-                                  return OPJ_FALSE;
-                                  }
-                                /* Increase the size of ppm_data to add the new Ippm series*/
-                                assert(l_cp->ppm_data == l_cp->ppm_buffer && "We need ppm_data and ppm_buffer to be the same when reallocating");
-                                new_ppm_data = (OPJ_BYTE *) opj_realloc(l_cp->ppm_data, l_cp->ppm_len + l_N_ppm);
-                                if (! new_ppm_data) {
-                                        opj_free(l_cp->ppm_data);
-                                        l_cp->ppm_data = NULL;
-                                        l_cp->ppm_buffer = NULL;  /* TODO: no need for a new local variable: ppm_buffer and ppm_data are enough */
-                                        l_cp->ppm_len = 0;
-                                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to increase the size of ppm_data to add the new Ippm series\n");
-                                        return OPJ_FALSE;
-                                }
-                                l_cp->ppm_data = new_ppm_data;
-                                l_cp->ppm_buffer = l_cp->ppm_data;
-
-                                /* Keep the position of the place where concatenate the new series*/
-                                l_cp->ppm_data_current = &(l_cp->ppm_data[l_cp->ppm_len]);
-                                l_cp->ppm_len += l_N_ppm;
-                        }
-                }
-        }
-
-        l_remaining_data = p_header_size;
-
-        while (l_remaining_data >= l_N_ppm) {
-                /* read a complete Ippm series*/
-                memcpy(l_cp->ppm_data_current, p_header_data, l_N_ppm);
-                p_header_size -= l_N_ppm;
-                p_header_data += l_N_ppm;
-
-                l_cp->ppm_data_read += l_N_ppm; /* Increase the number of data read*/
-
-                if (p_header_size)
-                {
-                        if (p_header_size < 4) {
-                                opj_free(l_cp->ppm_data);
-                                l_cp->ppm_data = NULL;
-                                l_cp->ppm_buffer = NULL;  /* TODO: no need for a new local variable: ppm_buffer and ppm_data are enough */
-                                l_cp->ppm_len = 0;
-                                l_cp->ppm = 0;
-                                opj_event_msg(p_manager, EVT_ERROR, "Error reading PPM marker\n");
-                                return OPJ_FALSE;
-                        }
-                        opj_read_bytes(p_header_data,&l_N_ppm,4);               /* N_ppm^i */
-                        p_header_data+=4;
-                        p_header_size-=4;
-                }
-                else {
-                        l_remaining_data = p_header_size;
-                        break;
-                }
-
-                l_remaining_data = p_header_size;
-
-                /* Next Ippm series is a complete series ?*/
-                if (l_remaining_data >= l_N_ppm) {
-                        OPJ_BYTE *new_ppm_data;
-                        /* Increase the size of ppm_data to add the new Ippm series*/
-                        assert(l_cp->ppm_data == l_cp->ppm_buffer && "We need ppm_data and ppm_buffer to be the same when reallocating");
-                        /* Overflow check */
-                        if ((l_cp->ppm_len + l_N_ppm) < l_N_ppm) {
-                                opj_free(l_cp->ppm_data);
-                                l_cp->ppm_data = NULL;
-                                l_cp->ppm_buffer = NULL;  /* TODO: no need for a new local variable: ppm_buffer and ppm_data are enough */
-                                l_cp->ppm_len = 0;
-                                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to increase the size of ppm_data to add the new (complete) Ippm series\n");
-                                return OPJ_FALSE;
-                        }
-                        new_ppm_data = (OPJ_BYTE *) opj_realloc(l_cp->ppm_data, l_cp->ppm_len + l_N_ppm);
-                        if (! new_ppm_data) {
-                                opj_free(l_cp->ppm_data);
-                                l_cp->ppm_data = NULL;
-                                l_cp->ppm_buffer = NULL;  /* TODO: no need for a new local variable: ppm_buffer and ppm_data are enough */
-                                l_cp->ppm_len = 0;
-                                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to increase the size of ppm_data to add the new (complete) Ippm series\n");
-                                return OPJ_FALSE;
-                        }
-                        l_cp->ppm_data = new_ppm_data;
-                        l_cp->ppm_buffer = l_cp->ppm_data;
-
-                        /* Keep the position of the place where concatenate the new series */
-                        l_cp->ppm_data_current = &(l_cp->ppm_data[l_cp->ppm_len]);
-                        l_cp->ppm_len += l_N_ppm;
-                }
-
-        }
-
-        /* Need to read an incomplete Ippm series*/
-        if (l_remaining_data) {
-                OPJ_BYTE *new_ppm_data;
-                assert(l_cp->ppm_data == l_cp->ppm_buffer && "We need ppm_data and ppm_buffer to be the same when reallocating");
-
-                /* Overflow check */
-                if ((l_cp->ppm_len + l_N_ppm) < l_N_ppm) {
-                        opj_free(l_cp->ppm_data);
-                        l_cp->ppm_data = NULL;
-                        l_cp->ppm_buffer = NULL;  /* TODO: no need for a new local variable: ppm_buffer and ppm_data are enough */
-                        l_cp->ppm_len = 0;
-                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to increase the size of ppm_data to add the new (complete) Ippm series\n");
-                        return OPJ_FALSE;
-                }
-                new_ppm_data = (OPJ_BYTE *) opj_realloc(l_cp->ppm_data, l_cp->ppm_len + l_N_ppm);
-                if (! new_ppm_data) {
-                        opj_free(l_cp->ppm_data);
-                        l_cp->ppm_data = NULL;
-                        l_cp->ppm_buffer = NULL;  /* TODO: no need for a new local variable: ppm_buffer and ppm_data are enough */
-                        l_cp->ppm_len = 0;
-                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to increase the size of ppm_data to add the new (incomplete) Ippm series\n");
-                        return OPJ_FALSE;
-                }
-                l_cp->ppm_data = new_ppm_data;
-                l_cp->ppm_buffer = l_cp->ppm_data;
-
-                /* Keep the position of the place where concatenate the new series*/
-                l_cp->ppm_data_current = &(l_cp->ppm_data[l_cp->ppm_len]);
-                l_cp->ppm_len += l_N_ppm;
-
-                /* Read incomplete Ippm series*/
-                memcpy(l_cp->ppm_data_current, p_header_data, l_remaining_data);
-                p_header_size -= l_remaining_data;
-                p_header_data += l_remaining_data;
-
-                l_cp->ppm_data_read += l_remaining_data; /* Increase the number of data read*/
-        }
-
-#ifdef CLEAN_MSD
-
-                if (l_cp->ppm_data_size == l_cp->ppm_len) {
-                        if (p_header_size >= 4) {
-                                /* read a N_ppm*/
-                                opj_read_bytes(p_header_data,&l_N_ppm,4);               /* N_ppm */
-                                p_header_data+=4;
-                                p_header_size-=4;
-                                l_cp->ppm_len += l_N_ppm ;
-
-                                OPJ_BYTE *new_ppm_buffer = (OPJ_BYTE *) opj_realloc(l_cp->ppm_buffer, l_cp->ppm_len);
-                                if (! new_ppm_buffer) {
-                                        opj_free(l_cp->ppm_buffer);
-                                        l_cp->ppm_buffer = NULL;
-                                        l_cp->ppm_len = 0;
-                                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read ppm marker\n");
-                                        return OPJ_FALSE;
-                                }
-                                l_cp->ppm_buffer = new_ppm_buffer;
-                                memset(l_cp->ppm_buffer+l_cp->ppm_data_size,0,l_N_ppm);
-
-                                l_cp->ppm_data = l_cp->ppm_buffer;
-                        }
-                        else {
-                                return OPJ_FALSE;
-                        }
-                }
-
-                l_remaining_data = l_cp->ppm_len - l_cp->ppm_data_size;
-
-                if (l_remaining_data <= p_header_size) {
-                        /* we must store less information than available in the packet */
-                        memcpy(l_cp->ppm_buffer + l_cp->ppm_data_size , p_header_data , l_remaining_data);
-                        l_cp->ppm_data_size = l_cp->ppm_len;
-                        p_header_size -= l_remaining_data;
-                        p_header_data += l_remaining_data;
-                }
-                else {
-                        memcpy(l_cp->ppm_buffer + l_cp->ppm_data_size , p_header_data , p_header_size);
-                        l_cp->ppm_data_size += p_header_size;
-                        p_header_data += p_header_size;
-                        p_header_size = 0;
-                        break;
-                }
-        }
-#endif
-        return OPJ_TRUE;
+        /* the Nppm and Ippm series may go on in the next marker segments, they are read
+         * by opj_j2k_merge_ppm once the main header is read */
+        return opj_j2k_add_ppx(&l_cp->ppm_buffer, &l_cp->ppm_data_size, &l_cp->ppm_buffer_size,
+                        &l_cp->ppm_markers, &l_cp->ppm_nb_markers, &l_cp->ppm_max_markers,
+                        l_Z_ppm, p_header_data, p_header_size, p_manager);
 }
 
 /**
@@ -3847,48 +4417,186 @@ static OPJ_BOOL opj_j2k_read_ppt (  opj_j2k_t *p_j2k,
         l_tcp = &(l_cp->tcps[p_j2k->m_current_tile_number]);
         l_tcp->ppt = 1;
 
-        opj_read_bytes(p_header_data,&l_Z_ppt,1);               /* Z_ppt */
-        ++p_header_data;
-        --p_header_size;
+        opj_read_bytes(p_header_data,&l_Z_ppt,1);               /* Z_ppt */
+        ++p_header_data;
+        --p_header_size;
+
+        /* the packet headers follow the ones of the previous tile-parts, opj_j2k_merge_ppt
+         * orders the marker segments of this tile-part when its data is reached */
+        return opj_j2k_add_ppx(&l_tcp->ppt_buffer, &l_tcp->ppt_data_size, &l_tcp->ppt_buffer_size,
+                        &l_tcp->ppt_markers, &l_tcp->ppt_nb_markers, &l_tcp->ppt_max_markers,
+                        l_Z_ppt, p_header_data, p_header_size, p_manager);
+}
+
+OPJ_BOOL opj_j2k_add_ppx (  OPJ_BYTE ** p_buffer,
+                            OPJ_UINT32 * p_data_size,
+                            OPJ_UINT32 * p_buffer_size,
+                            opj_j2k_ppx_t ** p_markers,
+                            OPJ_UINT32 * p_nb_markers,
+                            OPJ_UINT32 * p_max_markers,
+                            OPJ_UINT32 p_index,
+                            OPJ_BYTE * p_header_data,
+                            OPJ_UINT32 p_header_size,
+                            opj_event_mgr_t * p_manager )
+{
+        opj_j2k_ppx_t * l_marker;
+        OPJ_UINT32 i;
+
+        for (i = 0; i < *p_nb_markers; ++i) {
+                if ((*p_markers)[i].m_index == p_index) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Packed packet headers marker with index %d found twice\n", p_index);
+                        return OPJ_FALSE;
+                }
+        }
+
+        if (*p_nb_markers == *p_max_markers) {
+                /* at most 256 marker segments in a header, the index is on one byte */
+                OPJ_UINT32 l_max_markers = *p_max_markers ? 2 * *p_max_markers : 8;
+                opj_j2k_ppx_t * l_new_markers = (opj_j2k_ppx_t *) opj_realloc(*p_markers, l_max_markers * sizeof(opj_j2k_ppx_t));
+                if (! l_new_markers) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read packed packet headers\n");
+                        return OPJ_FALSE;
+                }
+                *p_markers = l_new_markers;
+                *p_max_markers = l_max_markers;
+        }
+
+        if (*p_data_size + p_header_size > *p_buffer_size) {
+                /* the buffer grows geometrically, the data of a marker segment is only copied once */
+                OPJ_UINT32 l_buffer_size = *p_data_size + p_header_size;
+                OPJ_BYTE * l_new_buffer;
+
+                if (l_buffer_size < *p_data_size) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Packed packet headers larger than 4 GB\n");
+                        return OPJ_FALSE;
+                }
+                if (*p_buffer_size > l_buffer_size / 2) {
+                        l_buffer_size = (*p_buffer_size > (OPJ_UINT32)-1 / 2) ? (OPJ_UINT32)-1 : *p_buffer_size * 2;
+                }
+                l_new_buffer = (OPJ_BYTE *) opj_realloc(*p_buffer, l_buffer_size);
+                if (! l_new_buffer) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read packed packet headers\n");
+                        return OPJ_FALSE;
+                }
+                *p_buffer = l_new_buffer;
+                *p_buffer_size = l_buffer_size;
+        }
+
+        l_marker = &(*p_markers)[(*p_nb_markers)++];
+        l_marker->m_index = p_index;
+        l_marker->m_offset = *p_data_size;
+        l_marker->m_size = p_header_size;
+
+        if (p_header_size) {
+                memcpy(*p_buffer + *p_data_size, p_header_data, p_header_size);
+                *p_data_size += p_header_size;
+        }
+
+        return OPJ_TRUE;
+}
+
+int opj_j2k_compare_ppx (const void * p_ppx1, const void * p_ppx2)
+{
+        OPJ_UINT32 l_index1 = ((const opj_j2k_ppx_t *) p_ppx1)->m_index;
+        OPJ_UINT32 l_index2 = ((const opj_j2k_ppx_t *) p_ppx2)->m_index;
+
+        return (l_index1 > l_index2) - (l_index1 < l_index2);
+}
+
+OPJ_BOOL opj_j2k_sort_ppx ( OPJ_BYTE * p_buffer,
+                            opj_j2k_ppx_t * p_markers,
+                            OPJ_UINT32 p_nb_markers,
+                            opj_event_mgr_t * p_manager )
+{
+        OPJ_UINT32 i, l_start, l_size = 0, l_offset;
+        OPJ_BYTE * l_data;
+
+        for (i = 1; i < p_nb_markers; ++i) {
+                if (p_markers[i].m_index < p_markers[i - 1].m_index) {
+                        break;
+                }
+        }
+        if (i >= p_nb_markers) {
+                /* the usual case: the marker segments are already in order */
+                return OPJ_TRUE;
+        }
+
+        l_start = p_markers[0].m_offset;
+        for (i = 0; i < p_nb_markers; ++i) {
+                l_size += p_markers[i].m_size;
+        }
+        l_data = (OPJ_BYTE *) opj_malloc(l_size);
+        if (! l_data) {
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read packed packet headers\n");
+                return OPJ_FALSE;
+        }
+
+        qsort(p_markers, p_nb_markers, sizeof(opj_j2k_ppx_t), opj_j2k_compare_ppx);
+        for (i = 0, l_offset = 0; i < p_nb_markers; ++i) {
+                memcpy(l_data + l_offset, p_buffer + p_markers[i].m_offset, p_markers[i].m_size);
+                p_markers[i].m_offset = l_start + l_offset;
+                l_offset += p_markers[i].m_size;
+        }
+        memcpy(p_buffer + l_start, l_data, l_size);
+        opj_free(l_data);
+
+        return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_merge_ppm ( opj_cp_t *p_cp, opj_event_mgr_t * p_manager )
+{
+        OPJ_UINT32 l_read = 0, l_written = 0, l_N_ppm;
 
-        /* Allocate buffer to read the packet header */
-        if (l_Z_ppt == 0) {
-                /* First PPT marker */
-                l_tcp->ppt_data_size = 0;
-                l_tcp->ppt_len = p_header_size;
+        if (! p_cp->ppm) {
+                return OPJ_TRUE;
+        }
+
+        if (! opj_j2k_sort_ppx(p_cp->ppm_buffer, p_cp->ppm_markers, p_cp->ppm_nb_markers, p_manager)) {
+                return OPJ_FALSE;
+        }
+        opj_free(p_cp->ppm_markers);
+        p_cp->ppm_markers = 00;
+        p_cp->ppm_nb_markers = 0;
+        p_cp->ppm_max_markers = 0;
 
-                opj_free(l_tcp->ppt_buffer);
-                l_tcp->ppt_buffer = (OPJ_BYTE *) opj_calloc(l_tcp->ppt_len, sizeof(OPJ_BYTE) );
-                if (l_tcp->ppt_buffer == 00) {
-                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read PPT marker\n");
+        /* the Ippm series are moved over the Nppm lengths, in place */
+        while (l_read < p_cp->ppm_data_size) {
+                if (p_cp->ppm_data_size - l_read < 4) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Error reading PPM marker\n");
                         return OPJ_FALSE;
                 }
-                l_tcp->ppt_data = l_tcp->ppt_buffer;
-
-                /* memset(l_tcp->ppt_buffer,0,l_tcp->ppt_len); */
-        }
-        else {
-                OPJ_BYTE *new_ppt_buffer;
-                l_tcp->ppt_len += p_header_size;
+                opj_read_bytes(p_cp->ppm_buffer + l_read, &l_N_ppm, 4);         /* N_ppm */
+                l_read += 4;
 
-                new_ppt_buffer = (OPJ_BYTE *) opj_realloc(l_tcp->ppt_buffer, l_tcp->ppt_len);
-                if (! new_ppt_buffer) {
-                        opj_free(l_tcp->ppt_buffer);
-                        l_tcp->ppt_buffer = NULL;
-                        l_tcp->ppt_len = 0;
-                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read PPT marker\n");
+                if (l_N_ppm > p_cp->ppm_data_size - l_read) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Not enough bytes (%u) to hold Ippm series (%u)\n", p_cp->ppm_data_size - l_read, l_N_ppm);
                         return OPJ_FALSE;
                 }
-                l_tcp->ppt_buffer = new_ppt_buffer;
-                l_tcp->ppt_data = l_tcp->ppt_buffer;
+                memmove(p_cp->ppm_buffer + l_written, p_cp->ppm_buffer + l_read, l_N_ppm);
+                l_read += l_N_ppm;
+                l_written += l_N_ppm;
+        }
+
+        p_cp->ppm_data_size = l_written;
+        p_cp->ppm_data = p_cp->ppm_buffer;
+        p_cp->ppm_len = l_written;
 
-                memset(l_tcp->ppt_buffer+l_tcp->ppt_data_size,0,p_header_size);
+        return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_merge_ppt ( opj_tcp_t *p_tcp, opj_event_mgr_t * p_manager )
+{
+        if (! p_tcp->ppt_nb_markers) {
+                return OPJ_TRUE;
         }
 
-        /* Read packet header from buffer */
-        memcpy(l_tcp->ppt_buffer+l_tcp->ppt_data_size,p_header_data,p_header_size);
+        if (! opj_j2k_sort_ppx(p_tcp->ppt_buffer, p_tcp->ppt_markers, p_tcp->ppt_nb_markers, p_manager)) {
+                return OPJ_FALSE;
+        }
+        p_tcp->ppt_nb_markers = 0;
 
-        l_tcp->ppt_data_size += p_header_size;
+        p_tcp->ppt_data = p_tcp->ppt_buffer;
+        p_tcp->ppt_len = p_tcp->ppt_data_size;
 
         return OPJ_TRUE;
 }
@@ -4024,6 +4732,9 @@ OPJ_BOOL opj_j2k_read_sot ( opj_j2k_t *p_j2k,
         }
 
         l_tcp = &l_cp->tcps[p_j2k->m_current_tile_number];
+        if (l_tcp->tccps == 00) {
+                opj_j2k_init_tile_tcp(p_j2k, l_tcp);
+        }
         l_tile_x = p_j2k->m_current_tile_number % l_cp->tw;
         l_tile_y = p_j2k->m_current_tile_number / l_cp->tw;
 
@@ -4106,6 +4817,14 @@ OPJ_BOOL opj_j2k_read_sot ( opj_j2k_t *p_j2k,
                 opj_read_bytes(p_header_data,&l_current_part ,1);       /* TPsot */
                 ++p_header_data;
 
+                /* The first tile-part starts a new set of PPT markers: forget the ones */
+                /* gathered the last time this tile was read (opj_get_decoded_tile). */
+                if (l_current_part == 0) {
+                        l_tcp->ppt_data_size = 0;
+                        l_tcp->ppt_nb_markers = 0;
+                        l_tcp->ppt_len = 0;
+                }
+
                 opj_read_bytes(p_header_data,&l_num_parts ,1);          /* TNsot */
                 ++p_header_data;
 
@@ -4170,6 +4889,7 @@ OPJ_BOOL opj_j2k_read_sot ( opj_j2k_t *p_j2k,
                         p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number].current_tpsno = l_current_part;
 
                         if (l_num_parts != 0){
+                                OPJ_UINT32 l_old_nb_tps = p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number].current_nb_tps;
                                 p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number].nb_tps = l_num_parts;
                                 p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number].current_nb_tps = l_num_parts;
 
@@ -4191,6 +4911,9 @@ OPJ_BOOL opj_j2k_read_sot ( opj_j2k_t *p_j2k,
                                                 return OPJ_FALSE;
                                         }
                                         p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number].tp_index = new_tp_index;
+                                        if (l_num_parts > l_old_nb_tps) {
+                                                memset(new_tp_index + l_old_nb_tps, 0, (l_num_parts - l_old_nb_tps) * sizeof(opj_tp_index_t));
+                                        }
                                 }
                         }
                         else{
@@ -4210,6 +4933,7 @@ OPJ_BOOL opj_j2k_read_sot ( opj_j2k_t *p_j2k,
 
                                         if ( l_current_part >= p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number].current_nb_tps ){
                                                 opj_tp_index_t *new_tp_index;
+                                                OPJ_UINT32 l_old_nb_tps = p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number].current_nb_tps;
                                                 p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number].current_nb_tps = l_current_part + 1;
                                                 new_tp_index = (opj_tp_index_t *) opj_realloc(
                                                                 p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number].tp_index,
@@ -4222,6 +4946,7 @@ OPJ_BOOL opj_j2k_read_sot ( opj_j2k_t *p_j2k,
                                                         return OPJ_FALSE;
                                                 }
                                                 p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number].tp_index = new_tp_index;
+                                                memset(new_tp_index + l_old_nb_tps, 0, (l_current_part + 1 - l_old_nb_tps) * sizeof(opj_tp_index_t));
                                         }
                                 }
 
@@ -4270,6 +4995,8 @@ OPJ_BOOL opj_j2k_write_sod(     opj_j2k_t *p_j2k,
 {
         opj_codestream_info_t *l_cstr_info = 00;
         OPJ_UINT32 l_remaining_data;
+        OPJ_BYTE * l_begin_data = p_data;
+        OPJ_UINT32 l_first_packet;
 
         /* preconditions */
         assert(p_j2k != 00);
@@ -4322,6 +5049,18 @@ OPJ_BOOL opj_j2k_write_sod(     opj_j2k_t *p_j2k,
         }
 
         *p_data_written = 0;
+        l_first_packet = p_tile_coder->tcd_image->tiles->packno;
+
+        /* make room for the PLT markers of the packets still to write */
+        if (p_j2k->m_cp.m_specific_param.m_enc.m_plt_on) {
+                OPJ_UINT32 l_nb_packets = opj_tcd_get_nb_precincts(p_tile_coder) * p_j2k->m_cp.tcps[p_j2k->m_current_tile_number].numlayers;
+                OPJ_UINT32 l_plt_room = opj_j2k_get_plt_room(l_nb_packets - l_first_packet);
+                if (l_plt_room >= l_remaining_data) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Not enough space to write the PLT markers\n");
+                        return OPJ_FALSE;
+                }
+                l_remaining_data -= l_plt_room;
+        }
 
         if (! opj_tcd_encode_tile(p_tile_coder, p_j2k->m_current_tile_number, p_data, p_data_written, l_remaining_data , l_cstr_info)) {
                 opj_event_msg(p_manager, EVT_ERROR, "Cannot encode tile\n");
@@ -4330,9 +5069,55 @@ OPJ_BOOL opj_j2k_write_sod(     opj_j2k_t *p_j2k,
 
         *p_data_written += 2;
 
+        /* the PLT markers end the tile-part header, before the SOD */
+        if (p_j2k->m_cp.m_specific_param.m_enc.m_plt_on && (p_tile_coder->tcd_image->tiles->packno > l_first_packet)) {
+                const OPJ_UINT32 * l_lengths = p_tile_coder->m_packet_lengths + l_first_packet;
+                OPJ_UINT32 l_nb_packets = p_tile_coder->tcd_image->tiles->packno - l_first_packet;
+                OPJ_UINT32 l_plt_size = opj_j2k_get_plt_size(l_lengths, l_nb_packets);
+
+                memmove(l_begin_data + l_plt_size, l_begin_data, *p_data_written);
+                if (! opj_j2k_write_plt_in_memory(l_lengths, l_nb_packets, l_begin_data, &l_plt_size, p_manager)) {
+                        return OPJ_FALSE;
+                }
+                *p_data_written += l_plt_size;
+        }
+
         return OPJ_TRUE;
 }
 
+OPJ_UINT32 opj_j2k_get_tile_data_size_hint ( opj_j2k_t *p_j2k,
+                                             opj_stream_private_t *p_stream )
+{
+        opj_j2k_dec_t * l_dec = &p_j2k->m_specific_param.m_decoder;
+        opj_tile_index_t * l_tile_index;
+        OPJ_UINT64 l_size = 0;
+        OPJ_OFF_T l_bytes_left;
+        OPJ_UINT32 i;
+
+        if (! l_dec->m_tlm_index || ! p_j2k->cstr_index || ! p_j2k->cstr_index->tile_index) {
+                return l_dec->m_sot_length;
+        }
+
+        /* the tile-parts lengths include their headers, it is a bit more than needed */
+        l_tile_index = &p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number];
+        for (i = l_tile_index->current_tpsno; i < l_tile_index->nb_tps; ++i) {
+                l_size += (OPJ_UINT64)(l_tile_index->tp_index[i].end_pos - l_tile_index->tp_index[i].start_pos);
+        }
+
+        /* truncated codestreams or wrong markers must not make a larger allocation */
+        l_bytes_left = opj_stream_get_number_byte_left(p_stream);
+        if (l_size > (OPJ_UINT64)l_bytes_left) {
+                l_size = (OPJ_UINT64)l_bytes_left;
+        }
+        if (l_size > (OPJ_UINT32)-1) {
+                l_size = (OPJ_UINT32)-1;
+        }
+        if (l_size < l_dec->m_sot_length) {
+                return l_dec->m_sot_length;
+        }
+        return (OPJ_UINT32)l_size;
+}
+
 OPJ_BOOL opj_j2k_read_sod (opj_j2k_t *p_j2k,
                            opj_stream_private_t *p_stream,
                                                    opj_event_mgr_t * p_manager
@@ -4344,6 +5129,7 @@ OPJ_BOOL opj_j2k_read_sod (opj_j2k_t *p_j2k,
         opj_tcp_t * l_tcp = 00;
         OPJ_UINT32 * l_tile_len = 00;
         OPJ_BOOL l_sot_length_pb_detected = OPJ_FALSE;
+        opj_tp_index_t * l_tp_index = 00;
 
         /* preconditions */
         assert(p_j2k != 00);
@@ -4352,6 +5138,12 @@ OPJ_BOOL opj_j2k_read_sod (opj_j2k_t *p_j2k,
 
         l_tcp = &(p_j2k->m_cp.tcps[p_j2k->m_current_tile_number]);
 
+        /* The tile-part header is read, its packet headers follow the ones of the previous tile-parts */
+        if (! opj_j2k_merge_ppt(l_tcp, p_manager)) {
+                opj_event_msg(p_manager, EVT_ERROR, "Failed to merge PPT data\n");
+                return OPJ_FALSE;
+        }
+
         if (p_j2k->m_specific_param.m_decoder.m_last_tile_part) {
                 /* opj_stream_get_number_byte_left returns OPJ_OFF_T
                 // but we are in the last tile part,
@@ -4379,14 +5171,28 @@ OPJ_BOOL opj_j2k_read_sod (opj_j2k_t *p_j2k,
                 opj_event_msg(p_manager, EVT_ERROR, "Tile part length size inconsistent with stream length\n");
                 return OPJ_FALSE;
             }
+            if (*l_tile_len + p_j2k->m_specific_param.m_decoder.m_sot_length < *l_tile_len) {
+                opj_event_msg(p_manager, EVT_ERROR, "Tile data larger than 4 GB\n");
+                return OPJ_FALSE;
+            }
             if (! *l_current_data) {
-                /* LH: oddly enough, in this path, l_tile_len!=0.
-                 * TODO: If this was consistant, we could simplify the code to only use realloc(), as realloc(0,...) default to malloc(0,...).
-                 */
-                *l_current_data = (OPJ_BYTE*) opj_malloc(p_j2k->m_specific_param.m_decoder.m_sot_length);
+                /* the buffer gets all the tile-parts of the tile at once when their lengths are known */
+                OPJ_UINT32 l_max_size = opj_j2k_get_tile_data_size_hint(p_j2k, p_stream);
+                *l_current_data = (OPJ_BYTE*) opj_malloc(l_max_size);
+                l_tcp->m_data_max_size = *l_current_data ? l_max_size : 0;
+                /* nothing is left of a previous buffer */
+                *l_tile_len = 0;
             }
-            else {
-                OPJ_BYTE *l_new_current_data = (OPJ_BYTE *) opj_realloc(*l_current_data, *l_tile_len + p_j2k->m_specific_param.m_decoder.m_sot_length);
+            else if (*l_tile_len + p_j2k->m_specific_param.m_decoder.m_sot_length > l_tcp->m_data_max_size) {
+                OPJ_BYTE *l_new_current_data;
+                OPJ_UINT32 l_max_size = *l_tile_len + p_j2k->m_specific_param.m_decoder.m_sot_length;
+
+                /* grows geometrically so that many small tile-parts do not copy the tile each time */
+                if (l_tcp->m_data_max_size > l_max_size / 2) {
+                        l_max_size = (l_tcp->m_data_max_size > (OPJ_UINT32)-1 / 2) ? (OPJ_UINT32)-1 : l_tcp->m_data_max_size * 2;
+                }
+                l_new_current_data = (OPJ_BYTE *) opj_realloc(*l_current_data, l_max_size);
+                l_tcp->m_data_max_size = l_new_current_data ? l_max_size : 0;
                 if (! l_new_current_data) {
                         opj_free(*l_current_data);
                         /*nothing more is done as l_current_data will be set to null, and just
@@ -4417,6 +5223,21 @@ OPJ_BOOL opj_j2k_read_sod (opj_j2k_t *p_j2k,
                 l_cstr_index->tile_index[p_j2k->m_current_tile_number].tp_index[l_current_tile_part].end_pos =
                                 l_current_pos + p_j2k->m_specific_param.m_decoder.m_sot_length + 2;
 
+                /* the packets of the tile-part start with its data */
+                l_tp_index = &l_cstr_index->tile_index[p_j2k->m_current_tile_number].tp_index[l_current_tile_part];
+                if (l_tp_index->nb_packets) {
+                        opj_packet_info_t * l_packet = l_cstr_index->tile_index[p_j2k->m_current_tile_number].packet_index + l_tp_index->first_packet;
+                        if (l_packet->start_pos == 0) {
+                                OPJ_OFF_T l_packet_pos = l_current_pos + 2;
+                                OPJ_UINT32 i;
+                                for (i = 0; i < l_tp_index->nb_packets; ++i, ++l_packet) {
+                                        l_packet->start_pos = l_packet_pos;
+                                        l_packet->end_pos += l_packet_pos;
+                                        l_packet_pos = l_packet->end_pos + 1;
+                                }
+                        }
+                }
+
                 if (OPJ_FALSE == opj_j2k_add_tlmarker(p_j2k->m_current_tile_number,
                                         l_cstr_index,
                                         J2K_MS_SOD,
@@ -5896,18 +6717,35 @@ static OPJ_BOOL opj_j2k_read_cbd (      opj_j2k_t *p_j2k,
 /* J2K / JPT decoder interface                                             */
 /* ----------------------------------------------------------------------- */
 
-void opj_j2k_setup_decoder(opj_j2k_t *j2k, opj_dparameters_t *parameters)
+OPJ_BOOL opj_j2k_setup_decoder(opj_j2k_t *j2k, opj_dparameters_t *parameters)
 {
         if(j2k && parameters) {
-                j2k->m_cp.m_specific_param.m_dec.m_layer = parameters->cp_layer;
-                j2k->m_cp.m_specific_param.m_dec.m_reduce = parameters->cp_reduce;
+                opj_decoding_param_t * l_dec_param = &j2k->m_cp.m_specific_param.m_dec;
+
+                l_dec_param->m_layer = parameters->cp_layer;
+                l_dec_param->m_reduce = parameters->cp_reduce;
+
+                /* the components to decode are checked against the image once its header is read */
+                opj_free(l_dec_param->m_comps_to_decode);
+                l_dec_param->m_comps_to_decode = 00;
+                l_dec_param->m_nb_comps_to_decode = 0;
+                if (parameters->cp_nb_comps && parameters->cp_comps) {
+                        l_dec_param->m_comps_to_decode = (OPJ_UINT32 *) opj_malloc(parameters->cp_nb_comps * sizeof(OPJ_UINT32));
+                        if (! l_dec_param->m_comps_to_decode) {
+                                return OPJ_FALSE;
+                        }
+                        memcpy(l_dec_param->m_comps_to_decode, parameters->cp_comps, parameters->cp_nb_comps * sizeof(OPJ_UINT32));
+                        l_dec_param->m_nb_comps_to_decode = parameters->cp_nb_comps;
+                }
 
 #ifdef USE_JPWL
                 j2k->m_cp.correct = parameters->jpwl_correct;
                 j2k->m_cp.exp_comps = parameters->jpwl_exp_comps;
                 j2k->m_cp.max_tiles = parameters->jpwl_max_tiles;
 #endif /* USE_JPWL */
+                return OPJ_TRUE;
         }
+        return OPJ_FALSE;
 }
 
 /* ----------------------------------------------------------------------- */
@@ -6388,6 +7226,8 @@ OPJ_BOOL opj_j2k_setup_encoder(     opj_j2k_t *p_j2k,
                 cp->m_specific_param.m_enc.m_tp_on = 1;
         }
 
+        cp->m_specific_param.m_enc.m_plt_on = parameters->plt_on ? 1 : 0;
+
 #ifdef USE_JPWL
         /*
         calculate JPWL encoding parameters
@@ -6758,11 +7598,19 @@ OPJ_BOOL opj_j2k_read_header(   opj_stream_private_t *p_stream,
                                                             opj_image_t** p_image,
                                                             opj_event_mgr_t* p_manager )
 {
+        opj_stage_clock_t l_clock;
+        OPJ_OFF_T l_start = 0;
+
         /* preconditions */
         assert(p_j2k != 00);
         assert(p_stream != 00);
         assert(p_manager != 00);
 
+        if (p_j2k->m_stats) {
+                opj_stage_clock_start(&l_clock);
+                l_start = opj_stream_tell(p_stream);
+        }
+
         /* create an empty image header */
         p_j2k->m_private_image = opj_image_create0();
         if (! p_j2k->m_private_image) {
@@ -6789,6 +7637,12 @@ OPJ_BOOL opj_j2k_read_header(   opj_stream_private_t *p_stream,
                 return OPJ_FALSE;
         }
 
+        if (p_j2k->m_stats) {
+                /* the main header is not counted in any tile */
+                opj_stage_clock_stop(&l_clock, p_j2k->m_stats, p_j2k->m_stats->nb_tiles, OPJ_STAGE_HEADER,
+                                     (OPJ_UINT64)(opj_stream_tell(p_stream) - l_start));
+        }
+
         *p_image = opj_image_create0();
         if (! (*p_image)) {
                 return OPJ_FALSE;
@@ -6802,6 +7656,146 @@ OPJ_BOOL opj_j2k_read_header(   opj_stream_private_t *p_stream,
                 return OPJ_FALSE;
         }
 
+        /* Locate the tile-parts from the TLM markers, or the index file */
+        opj_j2k_check_index_file(p_j2k, p_manager);
+        if (! opj_j2k_build_tlm_index(p_j2k, p_stream, p_manager)) {
+                return OPJ_FALSE;
+        }
+
+        return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_probe_header(  const OPJ_BYTE * p_buffer,
+                                OPJ_SIZE_T p_buffer_size,
+                                opj_probe_info_t * p_info )
+{
+        const OPJ_BYTE * l_data = 00;
+        OPJ_SIZE_T l_pos = 2;
+        OPJ_UINT32 l_marker, l_marker_size, l_tmp;
+        OPJ_UINT32 l_nb_comp, i;
+        OPJ_BOOL l_has_siz = OPJ_FALSE, l_has_cod = OPJ_FALSE, l_has_qcd = OPJ_FALSE;
+
+        /* preconditions */
+        assert(p_buffer != 00);
+        assert(p_info != 00);
+
+        if (p_buffer_size < 2) {
+                return OPJ_FALSE;
+        }
+        opj_read_bytes(p_buffer,&l_marker,2);
+        if (l_marker != J2K_MS_SOC) {
+                return OPJ_FALSE;
+        }
+
+        while (! (l_has_siz && l_has_cod && l_has_qcd)) {
+                if (p_buffer_size - l_pos < 4) {
+                        return OPJ_FALSE;
+                }
+                opj_read_bytes(p_buffer + l_pos,&l_marker,2);
+                opj_read_bytes(p_buffer + l_pos + 2,&l_marker_size,2);
+                /* the whole marker segment must be in the buffer */
+                if ((l_marker < 0xff00) || (l_marker_size < 2) || (p_buffer_size - l_pos - 2 < l_marker_size)) {
+                        return OPJ_FALSE;
+                }
+                /* the SIZ marker comes first, the main header ends with the first SOT */
+                if ((! l_has_siz && l_marker != J2K_MS_SIZ) || (l_marker == J2K_MS_SOT)) {
+                        return OPJ_FALSE;
+                }
+                l_data = p_buffer + l_pos + 4;
+                l_marker_size -= 2;
+
+                switch (l_marker) {
+                case J2K_MS_SIZ:
+                        if ((l_marker_size < 36) || ((l_marker_size - 36) % 3 != 0)) {
+                                return OPJ_FALSE;
+                        }
+                        opj_read_bytes(l_data,&p_info->rsiz,2);         /* Rsiz */
+                        opj_read_bytes(l_data + 2,&p_info->x1,4);       /* Xsiz */
+                        opj_read_bytes(l_data + 6,&p_info->y1,4);       /* Ysiz */
+                        opj_read_bytes(l_data + 10,&p_info->x0,4);      /* X0siz */
+                        opj_read_bytes(l_data + 14,&p_info->y0,4);      /* Y0siz */
+                        opj_read_bytes(l_data + 18,&p_info->tdx,4);     /* XTsiz */
+                        opj_read_bytes(l_data + 22,&p_info->tdy,4);     /* YTsiz */
+                        opj_read_bytes(l_data + 26,&p_info->tx0,4);     /* XT0siz */
+                        opj_read_bytes(l_data + 30,&p_info->ty0,4);     /* YT0siz */
+                        opj_read_bytes(l_data + 34,&p_info->numcomps,2);/* Csiz */
+                        l_nb_comp = (l_marker_size - 36) / 3;
+                        if ((p_info->numcomps == 0) || (p_info->numcomps > 16384) || (p_info->numcomps != l_nb_comp)) {
+                                return OPJ_FALSE;
+                        }
+                        if ((p_info->x0 >= p_info->x1) || (p_info->y0 >= p_info->y1)
+                                || (p_info->tdx == 0) || (p_info->tdy == 0)
+                                || (p_info->tx0 > p_info->x0) || (p_info->ty0 > p_info->y0)
+                                || ((OPJ_UINT64)p_info->tx0 + p_info->tdx <= p_info->x0)
+                                || ((OPJ_UINT64)p_info->ty0 + p_info->tdy <= p_info->y0)) {
+                                return OPJ_FALSE;
+                        }
+                        p_info->tw = (OPJ_UINT32)(((OPJ_UINT64)p_info->x1 - p_info->tx0 + p_info->tdx - 1) / p_info->tdx);
+                        p_info->th = (OPJ_UINT32)(((OPJ_UINT64)p_info->y1 - p_info->ty0 + p_info->tdy - 1) / p_info->tdy);
+
+                        l_data += 36;
+                        for (i = 0; i < l_nb_comp; ++i) {
+                                opj_probe_comp_t l_comp;
+                                opj_read_bytes(l_data,&l_tmp,1);                /* Ssiz_i */
+                                l_comp.prec = (l_tmp & 0x7f) + 1;
+                                l_comp.sgnd = l_tmp >> 7;
+                                opj_read_bytes(l_data + 1,&l_comp.dx,1);        /* XRsiz_i */
+                                opj_read_bytes(l_data + 2,&l_comp.dy,1);        /* YRsiz_i */
+                                if ((l_comp.dx == 0) || (l_comp.dy == 0)) {
+                                        return OPJ_FALSE;
+                                }
+                                if (i < OPJ_PROBE_MAX_COMPS) {
+                                        p_info->comps[i] = l_comp;
+                                }
+                                l_data += 3;
+                        }
+                        l_has_siz = OPJ_TRUE;
+                        break;
+
+                case J2K_MS_COD:
+                        if (l_marker_size < 10) {
+                                return OPJ_FALSE;
+                        }
+                        opj_read_bytes(l_data,&p_info->csty,1);                 /* Scod */
+                        if ((p_info->csty & ~(OPJ_UINT32)(J2K_CP_CSTY_PRT | J2K_CP_CSTY_SOP | J2K_CP_CSTY_EPH)) != 0U) {
+                                return OPJ_FALSE;
+                        }
+                        opj_read_bytes(l_data + 1,&l_tmp,1);                    /* SGcod (A) */
+                        p_info->prg = (l_tmp > OPJ_CPRL) ? OPJ_PROG_UNKNOWN : (OPJ_PROG_ORDER) l_tmp;
+                        opj_read_bytes(l_data + 2,&p_info->numlayers,2);        /* SGcod (B) */
+                        opj_read_bytes(l_data + 4,&p_info->mct,1);              /* SGcod (C) */
+                        opj_read_bytes(l_data + 5,&p_info->numresolutions,1);   /* SPcod (D) */
+                        ++p_info->numresolutions;
+                        opj_read_bytes(l_data + 6,&p_info->cblkw,1);            /* SPcod (E) */
+                        p_info->cblkw += 2;
+                        opj_read_bytes(l_data + 7,&p_info->cblkh,1);            /* SPcod (F) */
+                        p_info->cblkh += 2;
+                        opj_read_bytes(l_data + 8,&p_info->cblksty,1);          /* SPcod (G) */
+                        opj_read_bytes(l_data + 9,&p_info->qmfbid,1);           /* SPcod (H) */
+                        if ((p_info->numlayers == 0) || (p_info->numresolutions > OPJ_J2K_MAXRLVLS)
+                                || (p_info->cblkw > 10) || (p_info->cblkh > 10) || (p_info->cblkw + p_info->cblkh > 12)) {
+                                return OPJ_FALSE;
+                        }
+                        l_has_cod = OPJ_TRUE;
+                        break;
+
+                case J2K_MS_QCD:
+                        if (l_marker_size < 1) {
+                                return OPJ_FALSE;
+                        }
+                        opj_read_bytes(l_data,&l_tmp,1);                        /* Sqcd */
+                        p_info->qntsty = l_tmp & 0x1f;
+                        p_info->numgbits = l_tmp >> 5;
+                        l_has_qcd = OPJ_TRUE;
+                        break;
+
+                default:
+                        break;
+                }
+
+                l_pos += 4 + l_marker_size;
+        }
+
         return OPJ_TRUE;
 }
 
@@ -6814,6 +7808,7 @@ void opj_j2k_setup_header_reading (opj_j2k_t *p_j2k)
 
         /* DEVELOPER CORNER, add your custom procedures */
         opj_procedure_list_add_procedure(p_j2k->m_procedure_list,(opj_procedure)opj_j2k_copy_default_tcp_and_create_tcd);
+        opj_procedure_list_add_procedure(p_j2k->m_procedure_list,(opj_procedure)opj_j2k_init_decoded_components);
 
 }
 
@@ -7130,6 +8125,7 @@ OPJ_BOOL opj_j2k_read_header_procedure( opj_j2k_t *p_j2k,
 
         /*  We enter in the main header */
         p_j2k->m_specific_param.m_decoder.m_state = J2K_STATE_MHSOC;
+        p_j2k->m_specific_param.m_decoder.m_header_checksum = 1;
 
         /* Try to read the SOC marker, the codestream must begin with SOC marker */
         if (! opj_j2k_read_soc(p_j2k,p_stream,p_manager)) {
@@ -7220,6 +8216,10 @@ OPJ_BOOL opj_j2k_read_header_procedure( opj_j2k_t *p_j2k,
                         return OPJ_FALSE;
                 }
 
+                /* Identifies the main header for the index files */
+                p_j2k->m_specific_param.m_decoder.m_header_checksum = opj_j2k_update_checksum(
+                                p_j2k->m_specific_param.m_decoder.m_header_checksum, p_j2k->m_specific_param.m_decoder.m_header_data, l_marker_size);
+
                 /* Read the marker segment with the correct marker handler */
                 if (! (*(l_marker_handler->handler))(p_j2k,p_j2k->m_specific_param.m_decoder.m_header_data,l_marker_size,p_manager)) {
                         opj_event_msg(p_manager, EVT_ERROR, "Marker handler function failed to read the marker segment\n");
@@ -7259,11 +8259,22 @@ OPJ_BOOL opj_j2k_read_header_procedure( opj_j2k_t *p_j2k,
             return OPJ_FALSE;
         }
 
+        /* The packet headers of the PPM markers are given to T2 in a single buffer */
+        if (! opj_j2k_merge_ppm(&(p_j2k->m_cp), p_manager)) {
+                opj_event_msg(p_manager, EVT_ERROR, "Failed to merge PPM data\n");
+                return OPJ_FALSE;
+        }
+
         opj_event_msg(p_manager, EVT_INFO, "Main header has been correctly decoded.\n");
 
         /* Position of the last element if the main header */
         p_j2k->cstr_index->main_head_end = (OPJ_UINT32) opj_stream_tell(p_stream) - 2;
 
+        /* Length of the stream, to identify it for the index files */
+        if (opj_stream_get_number_byte_left(p_stream) > 0) {
+                p_j2k->m_specific_param.m_decoder.m_stream_length = opj_stream_tell(p_stream) + opj_stream_get_number_byte_left(p_stream);
+        }
+
         /* Next step: read a tile-part header */
         p_j2k->m_specific_param.m_decoder.m_state = J2K_STATE_TPHSOT;
 
@@ -7304,130 +8315,304 @@ static OPJ_BOOL opj_j2k_copy_default_tcp_and_create_tcd (       opj_j2k_t * p_j2
                                                             opj_event_mgr_t * p_manager
                                                             )
 {
-        opj_tcp_t * l_tcp = 00;
-        opj_tcp_t * l_default_tcp = 00;
-        OPJ_UINT32 l_nb_tiles;
-        OPJ_UINT32 i,j;
-        opj_tccp_t *l_current_tccp = 00;
-        OPJ_UINT32 l_tccp_size;
-        OPJ_UINT32 l_mct_size;
-        opj_image_t * l_image;
-        OPJ_UINT32 l_mcc_records_size,l_mct_records_size;
-        opj_mct_data_t * l_src_mct_rec, *l_dest_mct_rec;
-        opj_simple_mcc_decorrelation_data_t * l_src_mcc_rec, *l_dest_mcc_rec;
-        OPJ_UINT32 l_offset;
+        /* preconditions */
+        assert(p_j2k != 00);
+        assert(p_stream != 00);
+        assert(p_manager != 00);
+
+        /* Create the current tile decoder*/
+        p_j2k->m_tcd = (opj_tcd_t*)opj_tcd_create(OPJ_TRUE); /* FIXME why a cast ? */
+        if (! p_j2k->m_tcd ) {
+                return OPJ_FALSE;
+        }
+
+        if ( !opj_tcd_init(p_j2k->m_tcd, p_j2k->m_private_image, &(p_j2k->m_cp)) ) {
+                opj_tcd_destroy(p_j2k->m_tcd);
+                p_j2k->m_tcd = 00;
+                opj_event_msg(p_manager, EVT_ERROR, "Cannot decode tile, memory error\n");
+                return OPJ_FALSE;
+        }
+
+        if (! opj_j2k_init_codec_stats(p_j2k)) {
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to collect the codec statistics\n");
+                return OPJ_FALSE;
+        }
+
+        return OPJ_TRUE;
+}
 
+OPJ_BOOL opj_j2k_init_decoded_components (opj_j2k_t * p_j2k,
+                                          opj_stream_private_t *p_stream,
+                                          opj_event_mgr_t * p_manager )
+{
         /* preconditions */
         assert(p_j2k != 00);
         assert(p_stream != 00);
         assert(p_manager != 00);
 
-        l_image = p_j2k->m_private_image;
-        l_nb_tiles = p_j2k->m_cp.th * p_j2k->m_cp.tw;
-        l_tcp = p_j2k->m_cp.tcps;
-        l_tccp_size = l_image->numcomps * (OPJ_UINT32)sizeof(opj_tccp_t);
-        l_default_tcp = p_j2k->m_specific_param.m_decoder.m_default_tcp;
-        l_mct_size = l_image->numcomps * l_image->numcomps * (OPJ_UINT32)sizeof(OPJ_FLOAT32);
+        return opj_j2k_mark_decoded_components(p_j2k, p_manager);
+}
 
-        /* For each tile */
-        for (i=0; i<l_nb_tiles; ++i) {
-                /* keep the tile-compo coding parameters pointer of the current tile coding parameters*/
-                l_current_tccp = l_tcp->tccps;
-                /*Copy default coding parameters into the current tile coding parameters*/
-                memcpy(l_tcp, l_default_tcp, sizeof(opj_tcp_t));
-                /* Initialize some values of the current tile coding parameters*/
-                l_tcp->ppt = 0;
-                l_tcp->ppt_data = 00;
-                /* Reconnect the tile-compo coding parameters pointer to the current tile coding parameters*/
-                l_tcp->tccps = l_current_tccp;
-
-                /* Get the mct_decoding_matrix of the dflt_tile_cp and copy them into the current tile cp*/
-                if (l_default_tcp->m_mct_decoding_matrix) {
-                        l_tcp->m_mct_decoding_matrix = (OPJ_FLOAT32*)opj_malloc(l_mct_size);
-                        if (! l_tcp->m_mct_decoding_matrix ) {
-                                return OPJ_FALSE;
-                        }
-                        memcpy(l_tcp->m_mct_decoding_matrix,l_default_tcp->m_mct_decoding_matrix,l_mct_size);
-                }
+OPJ_BOOL opj_j2k_mark_decoded_components (opj_j2k_t * p_j2k,
+                                          opj_event_mgr_t * p_manager )
+{
+        opj_decoding_param_t * l_dec_param = &p_j2k->m_cp.m_specific_param.m_dec;
+        OPJ_UINT32 l_numcomps = p_j2k->m_private_image->numcomps;
+        OPJ_UINT32 i, l_nb_comps;
+
+        opj_free(l_dec_param->m_decoded_comps);
+        l_dec_param->m_decoded_comps = 00;
+        if (! l_dec_param->m_nb_comps_to_decode) {
+                return OPJ_TRUE;
+        }
 
-                /* Get the mct_record of the dflt_tile_cp and copy them into the current tile cp*/
-                l_mct_records_size = l_default_tcp->m_nb_max_mct_records * (OPJ_UINT32)sizeof(opj_mct_data_t);
-                l_tcp->m_mct_records = (opj_mct_data_t*)opj_malloc(l_mct_records_size);
-                if (! l_tcp->m_mct_records) {
+        l_dec_param->m_decoded_comps = (OPJ_BYTE *) opj_calloc(l_numcomps, sizeof(OPJ_BYTE));
+        if (! l_dec_param->m_decoded_comps) {
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to select the components to decode\n");
+                return OPJ_FALSE;
+        }
+        for (i = 0; i < l_dec_param->m_nb_comps_to_decode; ++i) {
+                OPJ_UINT32 l_compno = l_dec_param->m_comps_to_decode[i];
+                if (l_compno >= l_numcomps) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Invalid component index %d to decode: the image has %d components\n",
+                                      l_compno, l_numcomps);
+                        opj_free(l_dec_param->m_decoded_comps);
+                        l_dec_param->m_decoded_comps = 00;
                         return OPJ_FALSE;
                 }
-                memcpy(l_tcp->m_mct_records, l_default_tcp->m_mct_records,l_mct_records_size);
+                l_dec_param->m_decoded_comps[l_compno] = 1;
+        }
 
-                /* Copy the mct record data from dflt_tile_cp to the current tile*/
-                l_src_mct_rec = l_default_tcp->m_mct_records;
-                l_dest_mct_rec = l_tcp->m_mct_records;
+        /* the decoded components keep their order in the output image */
+        l_nb_comps = 0;
+        for (i = 0; i < l_numcomps; ++i) {
+                if (l_dec_param->m_decoded_comps[i]) {
+                        l_dec_param->m_comps_to_decode[l_nb_comps++] = i;
+                }
+        }
+        l_dec_param->m_nb_comps_to_decode = l_nb_comps;
 
-                for (j=0;j<l_default_tcp->m_nb_mct_records;++j) {
+        return OPJ_TRUE;
+}
 
-                        if (l_src_mct_rec->m_data) {
+OPJ_BOOL opj_j2k_remove_undecoded_components (opj_j2k_t * p_j2k,
+                                              opj_image_t * p_image,
+                                              opj_event_mgr_t * p_manager )
+{
+        opj_decoding_param_t * l_dec_param = &p_j2k->m_cp.m_specific_param.m_dec;
+        OPJ_UINT32 compno, l_nb_comps = 0;
 
-                                l_dest_mct_rec->m_data = (OPJ_BYTE*) opj_malloc(l_src_mct_rec->m_data_size);
-                                if(! l_dest_mct_rec->m_data) {
-                                        return OPJ_FALSE;
-                                }
-                                memcpy(l_dest_mct_rec->m_data,l_src_mct_rec->m_data,l_src_mct_rec->m_data_size);
-                        }
+        if (! l_dec_param->m_decoded_comps || p_image->numcomps == l_dec_param->m_nb_comps_to_decode) {
+                return OPJ_TRUE;
+        }
+        if (p_image->numcomps != p_j2k->m_private_image->numcomps) {
+                opj_event_msg(p_manager, EVT_ERROR, "The image has %d components, neither the %d components of the codestream nor the %d decoded ones\n",
+                              p_image->numcomps, p_j2k->m_private_image->numcomps, l_dec_param->m_nb_comps_to_decode);
+                return OPJ_FALSE;
+        }
 
-                        ++l_src_mct_rec;
-                        ++l_dest_mct_rec;
+        for (compno = 0; compno < p_image->numcomps; ++compno) {
+                if (! l_dec_param->m_decoded_comps[compno]) {
+                        opj_free(p_image->comps[compno].data);
+                        continue;
                 }
+                p_image->comps[l_nb_comps++] = p_image->comps[compno];
+        }
+        p_image->numcomps = l_nb_comps;
+        /* a subset of the components has no known colour space */
+        p_image->color_space = OPJ_CLRSPC_UNKNOWN;
+
+        return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_set_decoded_components (opj_j2k_t * p_j2k,
+                                         OPJ_UINT32 p_numcomps,
+                                         const OPJ_UINT32 * p_comps_indices,
+                                         opj_event_mgr_t * p_manager )
+{
+        opj_decoding_param_t * l_dec_param = &p_j2k->m_cp.m_specific_param.m_dec;
+        OPJ_UINT32 * l_comps = 00;
+
+        if (! p_j2k->m_private_image) {
+                opj_event_msg(p_manager, EVT_ERROR, "The components to decode must be set once the header is read\n");
+                return OPJ_FALSE;
+        }
+        if (p_numcomps && ! p_comps_indices) {
+                return OPJ_FALSE;
+        }
 
-                /* Get the mcc_record of the dflt_tile_cp and copy them into the current tile cp*/
-                l_mcc_records_size = l_default_tcp->m_nb_max_mcc_records * (OPJ_UINT32)sizeof(opj_simple_mcc_decorrelation_data_t);
-                l_tcp->m_mcc_records = (opj_simple_mcc_decorrelation_data_t*) opj_malloc(l_mcc_records_size);
-                if (! l_tcp->m_mcc_records) {
+        if (p_numcomps) {
+                l_comps = (OPJ_UINT32 *) opj_malloc(p_numcomps * sizeof(OPJ_UINT32));
+                if (! l_comps) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to select the components to decode\n");
                         return OPJ_FALSE;
                 }
-                memcpy(l_tcp->m_mcc_records,l_default_tcp->m_mcc_records,l_mcc_records_size);
+                memcpy(l_comps, p_comps_indices, p_numcomps * sizeof(OPJ_UINT32));
+        }
+        opj_free(l_dec_param->m_comps_to_decode);
+        l_dec_param->m_comps_to_decode = l_comps;
+        l_dec_param->m_nb_comps_to_decode = p_numcomps;
+
+        if (! opj_j2k_mark_decoded_components(p_j2k, p_manager)) {
+                /* an invalid selection is dropped, all the components are decoded */
+                opj_free(l_dec_param->m_comps_to_decode);
+                l_dec_param->m_comps_to_decode = 00;
+                l_dec_param->m_nb_comps_to_decode = 0;
+                return OPJ_FALSE;
+        }
 
-                /* Copy the mcc record data from dflt_tile_cp to the current tile*/
-                l_src_mcc_rec = l_default_tcp->m_mcc_records;
-                l_dest_mcc_rec = l_tcp->m_mcc_records;
+        return OPJ_TRUE;
+}
 
-                for (j=0;j<l_default_tcp->m_nb_max_mcc_records;++j) {
+static void opj_j2k_init_tile_tcp ( opj_j2k_t * p_j2k, opj_tcp_t * p_tcp )
+{
+        /* preconditions */
+        assert(p_j2k != 00);
+        assert(p_tcp != 00);
 
-                        if (l_src_mcc_rec->m_decorrelation_array) {
-                                l_offset = (OPJ_UINT32)(l_src_mcc_rec->m_decorrelation_array - l_default_tcp->m_mct_records);
-                                l_dest_mcc_rec->m_decorrelation_array = l_tcp->m_mct_records + l_offset;
-                        }
+        /*Copy default coding parameters into the current tile coding parameters*/
+        memcpy(p_tcp, p_j2k->m_specific_param.m_decoder.m_default_tcp, sizeof(opj_tcp_t));
+        /* Initialize some values of the current tile coding parameters*/
+        p_tcp->ppt = 0;
+        p_tcp->ppt_data = 00;
+        /* tccps, m_mct_decoding_matrix, m_mct_records and m_mcc_records still belong to the default tcp */
+        p_tcp->shared = 1;
+}
 
-                        if (l_src_mcc_rec->m_offset_array) {
-                                l_offset = (OPJ_UINT32)(l_src_mcc_rec->m_offset_array - l_default_tcp->m_mct_records);
-                                l_dest_mcc_rec->m_offset_array = l_tcp->m_mct_records + l_offset;
-                        }
+static OPJ_BOOL opj_j2k_unshare_tcp (   opj_j2k_t * p_j2k,
+                                        opj_tcp_t * p_tcp,
+                                        opj_event_mgr_t * p_manager )
+{
+        opj_tcp_t * l_default_tcp = 00;
+        opj_image_t * l_image = 00;
+        OPJ_UINT32 j;
+        OPJ_UINT32 l_tccp_size;
+        OPJ_UINT32 l_mct_size;
+        OPJ_UINT32 l_mcc_records_size,l_mct_records_size;
+        opj_mct_data_t * l_dest_mct_rec;
+        opj_simple_mcc_decorrelation_data_t * l_src_mcc_rec, *l_dest_mcc_rec;
+        OPJ_BYTE * l_src_data;
+        OPJ_UINT32 l_offset;
+
+        /* preconditions */
+        assert(p_j2k != 00);
+        assert(p_tcp != 00);
+        assert(p_manager != 00);
+
+        if (! p_tcp->shared) {
+                return OPJ_TRUE;
+        }
+
+        l_image = p_j2k->m_private_image;
+        l_default_tcp = p_j2k->m_specific_param.m_decoder.m_default_tcp;
+        l_tccp_size = l_image->numcomps * (OPJ_UINT32)sizeof(opj_tccp_t);
+        l_mct_size = l_image->numcomps * l_image->numcomps * (OPJ_UINT32)sizeof(OPJ_FLOAT32);
+
+        /* From now on the tile only refers to the memory it owns, opj_j2k_tcp_destroy frees what has been copied */
+        p_tcp->shared = 0;
+        p_tcp->tccps = 00;
+        p_tcp->m_mct_decoding_matrix = 00;
+        p_tcp->m_mct_records = 00;
+        p_tcp->m_mcc_records = 00;
 
-                        ++l_src_mcc_rec;
-                        ++l_dest_mcc_rec;
+        /* Copy all the dflt_tile_compo_cp to the current tile cp */
+        p_tcp->tccps = (opj_tccp_t*) opj_malloc(l_tccp_size);
+        if (! p_tcp->tccps) {
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to copy the tile coding parameters\n");
+                return OPJ_FALSE;
+        }
+        memcpy(p_tcp->tccps,l_default_tcp->tccps,l_tccp_size);
+
+        /* Get the mct_decoding_matrix of the dflt_tile_cp and copy them into the current tile cp*/
+        if (l_default_tcp->m_mct_decoding_matrix) {
+                p_tcp->m_mct_decoding_matrix = (OPJ_FLOAT32*)opj_malloc(l_mct_size);
+                if (! p_tcp->m_mct_decoding_matrix ) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to copy the tile coding parameters\n");
+                        return OPJ_FALSE;
+                }
+                memcpy(p_tcp->m_mct_decoding_matrix,l_default_tcp->m_mct_decoding_matrix,l_mct_size);
+        }
+
+        /* Get the mct_record of the dflt_tile_cp and copy them into the current tile cp*/
+        l_mct_records_size = l_default_tcp->m_nb_max_mct_records * (OPJ_UINT32)sizeof(opj_mct_data_t);
+        p_tcp->m_mct_records = (opj_mct_data_t*)opj_malloc(l_mct_records_size);
+        if (! p_tcp->m_mct_records) {
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to copy the tile coding parameters\n");
+                return OPJ_FALSE;
+        }
+        memcpy(p_tcp->m_mct_records, l_default_tcp->m_mct_records,l_mct_records_size);
+
+        /* Copy the mct record data from dflt_tile_cp to the current tile*/
+        l_dest_mct_rec = p_tcp->m_mct_records;
+
+        for (j=0;j<p_tcp->m_nb_mct_records;++j) {
+                l_src_data = l_dest_mct_rec->m_data;
+                l_dest_mct_rec->m_data = 00;
+                if (l_src_data) {
+                        l_dest_mct_rec->m_data = (OPJ_BYTE*) opj_malloc(l_dest_mct_rec->m_data_size);
+                        if(! l_dest_mct_rec->m_data) {
+                                /* the remaining records must not refer to the data of the default tcp */
+                                for (++j, ++l_dest_mct_rec; j<p_tcp->m_nb_mct_records; ++j, ++l_dest_mct_rec) {
+                                        l_dest_mct_rec->m_data = 00;
+                                }
+                                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to copy the tile coding parameters\n");
+                                return OPJ_FALSE;
+                        }
+                        memcpy(l_dest_mct_rec->m_data,l_src_data,l_dest_mct_rec->m_data_size);
                 }
 
-                /* Copy all the dflt_tile_compo_cp to the current tile cp */
-                memcpy(l_current_tccp,l_default_tcp->tccps,l_tccp_size);
-
-                /* Move to next tile cp*/
-                ++l_tcp;
+                ++l_dest_mct_rec;
         }
 
-        /* Create the current tile decoder*/
-        p_j2k->m_tcd = (opj_tcd_t*)opj_tcd_create(OPJ_TRUE); /* FIXME why a cast ? */
-        if (! p_j2k->m_tcd ) {
+        /* Get the mcc_record of the dflt_tile_cp and copy them into the current tile cp*/
+        l_mcc_records_size = l_default_tcp->m_nb_max_mcc_records * (OPJ_UINT32)sizeof(opj_simple_mcc_decorrelation_data_t);
+        p_tcp->m_mcc_records = (opj_simple_mcc_decorrelation_data_t*) opj_malloc(l_mcc_records_size);
+        if (! p_tcp->m_mcc_records) {
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to copy the tile coding parameters\n");
                 return OPJ_FALSE;
         }
+        memcpy(p_tcp->m_mcc_records,l_default_tcp->m_mcc_records,l_mcc_records_size);
 
-        if ( !opj_tcd_init(p_j2k->m_tcd, l_image, &(p_j2k->m_cp)) ) {
-                opj_tcd_destroy(p_j2k->m_tcd);
-                p_j2k->m_tcd = 00;
-                opj_event_msg(p_manager, EVT_ERROR, "Cannot decode tile, memory error\n");
-                return OPJ_FALSE;
+        /* Copy the mcc record data from dflt_tile_cp to the current tile*/
+        l_src_mcc_rec = l_default_tcp->m_mcc_records;
+        l_dest_mcc_rec = p_tcp->m_mcc_records;
+
+        for (j=0;j<l_default_tcp->m_nb_max_mcc_records;++j) {
+
+                if (l_src_mcc_rec->m_decorrelation_array) {
+                        l_offset = (OPJ_UINT32)(l_src_mcc_rec->m_decorrelation_array - l_default_tcp->m_mct_records);
+                        l_dest_mcc_rec->m_decorrelation_array = p_tcp->m_mct_records + l_offset;
+                }
+
+                if (l_src_mcc_rec->m_offset_array) {
+                        l_offset = (OPJ_UINT32)(l_src_mcc_rec->m_offset_array - l_default_tcp->m_mct_records);
+                        l_dest_mcc_rec->m_offset_array = p_tcp->m_mct_records + l_offset;
+                }
+
+                ++l_src_mcc_rec;
+                ++l_dest_mcc_rec;
         }
 
         return OPJ_TRUE;
 }
 
+static OPJ_BOOL opj_j2k_is_tcp_override_marker ( OPJ_UINT32 p_id )
+{
+        switch (p_id) {
+                case J2K_MS_COD:
+                case J2K_MS_COC:
+                case J2K_MS_RGN:
+                case J2K_MS_QCD:
+                case J2K_MS_QCC:
+                case J2K_MS_MCT:
+                case J2K_MS_MCC:
+                case J2K_MS_MCO:
+                        return OPJ_TRUE;
+                default:
+                        return OPJ_FALSE;
+        }
+}
+
 const opj_dec_memory_marker_handler_t * opj_j2k_get_marker_handler (OPJ_UINT32 p_id)
 {
         const opj_dec_memory_marker_handler_t *e;
@@ -7458,6 +8643,13 @@ void opj_j2k_destroy (opj_j2k_t *p_j2k)
                         p_j2k->m_specific_param.m_decoder.m_header_data = 00;
                         p_j2k->m_specific_param.m_decoder.m_header_data_size = 0;
                 }
+
+                opj_free(p_j2k->m_specific_param.m_decoder.m_tlm);
+                p_j2k->m_specific_param.m_decoder.m_tlm = 00;
+                opj_free(p_j2k->m_specific_param.m_decoder.m_plm_lengths);
+                p_j2k->m_specific_param.m_decoder.m_plm_lengths = 00;
+                opj_free(p_j2k->m_specific_param.m_decoder.m_plm_tp_nb_packets);
+                p_j2k->m_specific_param.m_decoder.m_plm_tp_nb_packets = 00;
         }
         else {
 
@@ -7481,6 +8673,12 @@ void opj_j2k_destroy (opj_j2k_t *p_j2k)
 
         opj_tcd_destroy(p_j2k->m_tcd);
 
+        if (p_j2k->m_stats) {
+                opj_free(p_j2k->m_stats->tiles);
+                opj_free(p_j2k->m_stats);
+                p_j2k->m_stats = 00;
+        }
+
         opj_j2k_cp_destroy(&(p_j2k->m_cp));
         memset(&(p_j2k->m_cp),0,sizeof(opj_cp_t));
 
@@ -7547,11 +8745,25 @@ void opj_j2k_tcp_destroy (opj_tcp_t *p_tcp)
                 return;
         }
 
+        /* Leave the parameters shared with the default tcp to their owner */
+        if (p_tcp->shared) {
+                p_tcp->tccps = 00;
+                p_tcp->m_mct_decoding_matrix = 00;
+                p_tcp->m_mct_records = 00;
+                p_tcp->m_mcc_records = 00;
+                p_tcp->shared = 0;
+        }
+
         if (p_tcp->ppt_buffer != 00) {
                 opj_free(p_tcp->ppt_buffer);
                 p_tcp->ppt_buffer = 00;
         }
 
+        if (p_tcp->ppt_markers != 00) {
+                opj_free(p_tcp->ppt_markers);
+                p_tcp->ppt_markers = 00;
+        }
+
         if (p_tcp->tccps != 00) {
                 opj_free(p_tcp->tccps);
                 p_tcp->tccps = 00;
@@ -7606,6 +8818,7 @@ void opj_j2k_tcp_data_destroy (opj_tcp_t *p_tcp)
                 opj_free(p_tcp->m_data);
                 p_tcp->m_data = NULL;
                 p_tcp->m_data_size = 0;
+                p_tcp->m_data_max_size = 0;
         }
 }
 
@@ -7635,6 +8848,8 @@ void opj_j2k_cp_destroy (opj_cp_t *p_cp)
         opj_free(p_cp->ppm_buffer);
         p_cp->ppm_buffer = 00;
         p_cp->ppm_data = NULL; /* ppm_data belongs to the allocated buffer pointed by ppm_buffer */
+        opj_free(p_cp->ppm_markers);
+        p_cp->ppm_markers = 00;
         opj_free(p_cp->comment);
         p_cp->comment = 00;
         if (! p_cp->m_is_decoder)
@@ -7642,6 +8857,13 @@ void opj_j2k_cp_destroy (opj_cp_t *p_cp)
                 opj_free(p_cp->m_specific_param.m_enc.m_matrice);
                 p_cp->m_specific_param.m_enc.m_matrice = 00;
         }
+        else
+        {
+                opj_free(p_cp->m_specific_param.m_dec.m_comps_to_decode);
+                p_cp->m_specific_param.m_dec.m_comps_to_decode = 00;
+                opj_free(p_cp->m_specific_param.m_dec.m_decoded_comps);
+                p_cp->m_specific_param.m_dec.m_decoded_comps = 00;
+        }
 }
 
 OPJ_BOOL opj_j2k_read_tile_header(      opj_j2k_t * p_j2k,
@@ -7653,6 +8875,38 @@ OPJ_BOOL opj_j2k_read_tile_header(      opj_j2k_t * p_j2k,
                                                                     OPJ_BOOL * p_go_on,
                                                                     opj_stream_private_t *p_stream,
                                                                     opj_event_mgr_t * p_manager )
+{
+        opj_stage_clock_t l_clock;
+        OPJ_OFF_T l_start;
+        OPJ_BOOL l_result;
+
+        if (! p_j2k->m_stats) {
+                return opj_j2k_read_tile_parts(p_j2k, p_tile_index, p_data_size, p_tile_x0, p_tile_y0,
+                                               p_tile_x1, p_tile_y1, p_nb_comps, p_go_on, p_stream, p_manager);
+        }
+
+        opj_stage_clock_start(&l_clock);
+        l_start = opj_stream_tell(p_stream);
+        l_result = opj_j2k_read_tile_parts(p_j2k, p_tile_index, p_data_size, p_tile_x0, p_tile_y0,
+                                           p_tile_x1, p_tile_y1, p_nb_comps, p_go_on, p_stream, p_manager);
+        /* the tile-part headers and the reading of the tile data are counted in the tile read,
+         * the end of the codestream in no tile */
+        opj_stage_clock_stop(&l_clock, p_j2k->m_stats,
+                             (l_result && *p_go_on) ? *p_tile_index : p_j2k->m_stats->nb_tiles,
+                             OPJ_STAGE_HEADER, (OPJ_UINT64)(opj_stream_tell(p_stream) - l_start));
+
+        return l_result;
+}
+
+OPJ_BOOL opj_j2k_read_tile_parts(       opj_j2k_t * p_j2k,
+                                        OPJ_UINT32 * p_tile_index,
+                                        OPJ_UINT32 * p_data_size,
+                                        OPJ_INT32 * p_tile_x0, OPJ_INT32 * p_tile_y0,
+                                        OPJ_INT32 * p_tile_x1, OPJ_INT32 * p_tile_y1,
+                                        OPJ_UINT32 * p_nb_comps,
+                                        OPJ_BOOL * p_go_on,
+                                        opj_stream_private_t *p_stream,
+                                        opj_event_mgr_t * p_manager )
 {
         OPJ_UINT32 l_current_marker = J2K_MS_SOT;
         OPJ_UINT32 l_marker_size;
@@ -7755,12 +9009,32 @@ OPJ_BOOL opj_j2k_read_tile_header(      opj_j2k_t * p_j2k,
                                 opj_event_msg(p_manager, EVT_ERROR, "Not sure how that happened.\n");
                                 return OPJ_FALSE;
                         }
+                        /* The tile stops sharing the default parameters as soon as one of its markers overrides them */
+                        if ( (p_j2k->m_specific_param.m_decoder.m_state & J2K_STATE_TPH)
+                                && opj_j2k_is_tcp_override_marker(l_marker_handler->id) ) {
+                                if (! opj_j2k_unshare_tcp(p_j2k, &p_j2k->m_cp.tcps[p_j2k->m_current_tile_number], p_manager)) {
+                                        return OPJ_FALSE;
+                                }
+                        }
+
                         /* Read the marker segment with the correct marker handler */
                         if (! (*(l_marker_handler->handler))(p_j2k,p_j2k->m_specific_param.m_decoder.m_header_data,l_marker_size,p_manager)) {
                                 opj_event_msg(p_manager, EVT_ERROR, "Fail to read the current marker segment (%#x)\n", l_current_marker);
                                 return OPJ_FALSE;
                         }
 
+                        /* Check the tile-part against the TLM markers before its position is indexed */
+                        if ( l_marker_handler->id == J2K_MS_SOT && p_j2k->m_specific_param.m_decoder.m_tlm_index ) {
+                                opj_tile_index_t * l_tile_index = &p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number];
+                                OPJ_OFF_T l_sot_pos = opj_stream_tell(p_stream) - l_marker_size - 4;
+
+                                if ( (l_tile_index->current_tpsno >= l_tile_index->nb_tps)
+                                        || (l_tile_index->tp_index[l_tile_index->current_tpsno].start_pos != l_sot_pos) ) {
+                                        opj_event_msg(p_manager, EVT_WARNING, "TLM markers do not match the codestream, tile-part lengths are ignored\n");
+                                        opj_j2k_reset_tlm_index(p_j2k);
+                                }
+                        }
+
                         /* Add the marker to the codestream index*/
                         if (OPJ_FALSE == opj_j2k_add_tlmarker(p_j2k->m_current_tile_number,
                                                 p_j2k->cstr_index,
@@ -7774,9 +9048,15 @@ OPJ_BOOL opj_j2k_read_tile_header(      opj_j2k_t * p_j2k,
                         /* Keep the position of the last SOT marker read */
                         if ( l_marker_handler->id == J2K_MS_SOT ) {
                                 OPJ_UINT32 sot_pos = (OPJ_UINT32) opj_stream_tell(p_stream) - l_marker_size - 4 ;
+                                OPJ_BOOL l_new_tile_part = OPJ_FALSE;
                                 if (sot_pos > p_j2k->m_specific_param.m_decoder.m_last_sot_read_pos)
                                 {
                                         p_j2k->m_specific_param.m_decoder.m_last_sot_read_pos = sot_pos;
+                                        l_new_tile_part = OPJ_TRUE;
+                                }
+                                if (! opj_j2k_index_tile_part_packets(p_j2k, l_new_tile_part)) {
+                                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to index the packets of the tile-part\n");
+                                        return OPJ_FALSE;
                                 }
                         }
 
@@ -7809,6 +9089,11 @@ OPJ_BOOL opj_j2k_read_tile_header(      opj_j2k_t * p_j2k,
                                 return OPJ_FALSE;
                         }
 
+                        /* Go straight to the next tile-part of the tile to decode */
+                        if (! opj_j2k_seek_next_tile_part(p_j2k, p_stream, p_manager)) {
+                                return OPJ_FALSE;
+                        }
+
                         if (! p_j2k->m_specific_param.m_decoder.m_can_decode){
                                 /* Try to read 2 bytes (the next marker ID) from stream and copy them into the buffer */
                                 if (opj_stream_read_data(p_stream,p_j2k->m_specific_param.m_decoder.m_header_data,2,p_manager) != 2) {
@@ -7877,7 +9162,8 @@ OPJ_BOOL opj_j2k_read_tile_header(      opj_j2k_t * p_j2k,
         *p_tile_y0 = p_j2k->m_tcd->tcd_image->tiles->y0;
         *p_tile_x1 = p_j2k->m_tcd->tcd_image->tiles->x1;
         *p_tile_y1 = p_j2k->m_tcd->tcd_image->tiles->y1;
-        *p_nb_comps = p_j2k->m_tcd->tcd_image->tiles->numcomps;
+        *p_nb_comps = p_j2k->m_cp.m_specific_param.m_dec.m_decoded_comps ?
+                        p_j2k->m_cp.m_specific_param.m_dec.m_nb_comps_to_decode : p_j2k->m_tcd->tcd_image->tiles->numcomps;
 
          p_j2k->m_specific_param.m_decoder.m_state |= 0x0080;/* FIXME J2K_DEC_STATE_DATA;*/
 
@@ -7894,6 +9180,8 @@ OPJ_BOOL opj_j2k_decode_tile (  opj_j2k_t * p_j2k,
         OPJ_UINT32 l_current_marker;
         OPJ_BYTE l_data [2];
         opj_tcp_t * l_tcp;
+        OPJ_BOOL l_success;
+        opj_stage_clock_t l_clock;
 
         /* preconditions */
         assert(p_stream != 00);
@@ -7911,19 +9199,42 @@ OPJ_BOOL opj_j2k_decode_tile (  opj_j2k_t * p_j2k,
                 return OPJ_FALSE;
         }
 
-        if (! opj_tcd_decode_tile(      p_j2k->m_tcd,
-                                                                l_tcp->m_data,
-                                                                l_tcp->m_data_size,
-                                                                p_tile_index,
-                                                                p_j2k->cstr_index) ) {
+        if (p_j2k->m_specific_param.m_decoder.m_strip_fn) {
+                l_success = opj_tcd_decode_tile_strips( p_j2k->m_tcd,
+                                                        l_tcp->m_data,
+                                                        l_tcp->m_data_size,
+                                                        p_tile_index,
+                                                        p_j2k->cstr_index,
+                                                        p_j2k->m_output_image,
+                                                        p_j2k->m_specific_param.m_decoder.m_strip_height,
+                                                        p_j2k->m_specific_param.m_decoder.m_strip_fn,
+                                                        p_j2k->m_specific_param.m_decoder.m_strip_user_data);
+        }
+        else {
+                l_success = opj_tcd_decode_tile(        p_j2k->m_tcd,
+                                                        l_tcp->m_data,
+                                                        l_tcp->m_data_size,
+                                                        p_tile_index,
+                                                        p_j2k->cstr_index);
+        }
+        if (! l_success) {
                 opj_j2k_tcp_destroy(l_tcp);
                 p_j2k->m_specific_param.m_decoder.m_state |= 0x8000;/*FIXME J2K_DEC_STATE_ERR;*/
                 opj_event_msg(p_manager, EVT_ERROR, "Failed to decode.\n");
                 return OPJ_FALSE;
         }
 
-        if (! opj_tcd_update_tile_data(p_j2k->m_tcd,p_data,p_data_size)) {
-                return OPJ_FALSE;
+        /* With no destination the decoded samples stay in the tile, the caller copies them out itself */
+        if (p_data) {
+                if (p_j2k->m_stats) {
+                        opj_stage_clock_start(&l_clock);
+                }
+                if (! opj_tcd_update_tile_data(p_j2k->m_tcd,p_data,p_data_size)) {
+                        return OPJ_FALSE;
+                }
+                if (p_j2k->m_stats) {
+                        opj_stage_clock_stop(&l_clock, p_j2k->m_stats, p_tile_index, OPJ_STAGE_COPY, p_data_size);
+                }
         }
 
         /* To avoid to destroy the tcp which can be useful when we try to decode a tile decoded before (cf j2k_random_tile_access)
@@ -7986,6 +9297,7 @@ OPJ_BOOL opj_j2k_update_image_data (opj_tcd_t * p_tcd, OPJ_BYTE * p_data, opj_im
         OPJ_UINT32 l_size_comp, l_remaining;
         OPJ_INT32 * l_dest_ptr;
         opj_tcd_resolution_t* l_res= 00;
+        const OPJ_BYTE * l_decoded_comps = p_tcd->cp->m_specific_param.m_dec.m_decoded_comps;
 
         l_tilec = p_tcd->tcd_image->tiles->comps;
         l_image_src = p_tcd->image;
@@ -7995,6 +9307,13 @@ OPJ_BOOL opj_j2k_update_image_data (opj_tcd_t * p_tcd, OPJ_BYTE * p_data, opj_im
 
         for (i=0; i<l_image_src->numcomps; i++) {
 
+                /* the output image has no room for the components which are not decoded */
+                if (l_decoded_comps && ! l_decoded_comps[i]) {
+                        ++l_img_comp_src;
+                        ++l_tilec;
+                        continue;
+                }
+
                 /* Allocate output component buffer if necessary */
                 if (!l_img_comp_dest->data) {
 
@@ -8229,6 +9548,301 @@ OPJ_BOOL opj_j2k_update_image_data (opj_tcd_t * p_tcd, OPJ_BYTE * p_data, opj_im
         return OPJ_TRUE;
 }
 
+static OPJ_BOOL opj_j2k_get_buffer_channel_map (OPJ_UINT32 p_numcomps,
+                                                OPJ_PIXEL_FORMAT p_format,
+                                                OPJ_INT32 * p_map,
+                                                OPJ_UINT32 * p_nb_channels,
+                                                OPJ_UINT32 * p_nb_bytes)
+{
+        switch (p_format) {
+                case OPJ_PF_GRAY8:
+                case OPJ_PF_GRAY16:
+                        *p_nb_channels = 1;
+                        break;
+                case OPJ_PF_RGB8:
+                case OPJ_PF_RGB16:
+                        *p_nb_channels = 3;
+                        break;
+                case OPJ_PF_RGBA8:
+                case OPJ_PF_RGBA16:
+                        *p_nb_channels = 4;
+                        break;
+                default:
+                        return OPJ_FALSE;
+        }
+        *p_nb_bytes = (p_format >= OPJ_PF_GRAY16) ? 2 : 1;
+
+        /* color channels : grey images are replicated */
+        p_map[0] = 0;
+        p_map[1] = (p_numcomps >= 3) ? 1 : 0;
+        p_map[2] = (p_numcomps >= 3) ? 2 : 0;
+
+        /* alpha channel : grey + alpha, color + alpha, or opaque */
+        if (p_numcomps == 2) {
+                p_map[3] = 1;
+        }
+        else if (p_numcomps >= 4) {
+                p_map[3] = 3;
+        }
+        else {
+                p_map[3] = -1;
+        }
+
+        return OPJ_TRUE;
+}
+
+static OPJ_BOOL opj_j2k_update_buffer_data (opj_j2k_t * p_j2k)
+{
+        OPJ_UINT32 i,j,c;
+        OPJ_INT32 l_map[4];
+        OPJ_UINT32 l_nb_channels, l_nb_bytes, l_depth, l_pixel_size;
+        OPJ_BYTE * l_buffer = p_j2k->m_specific_param.m_decoder.m_output_buffer;
+        OPJ_UINT32 l_stride = p_j2k->m_specific_param.m_decoder.m_output_buffer_stride;
+        opj_image_t * l_image_src = p_j2k->m_tcd->image;
+        opj_image_t * l_image_dest = p_j2k->m_output_image;
+        const OPJ_UINT32 * l_comps = p_j2k->m_cp.m_specific_param.m_dec.m_decoded_comps ?
+                        p_j2k->m_cp.m_specific_param.m_dec.m_comps_to_decode : 00;
+
+        if (p_j2k->m_specific_param.m_decoder.m_output_palette_pixels) {
+                return opj_j2k_update_buffer_palette_data(p_j2k);
+        }
+
+        if (! opj_j2k_get_buffer_channel_map(l_image_dest->numcomps,
+                                             p_j2k->m_specific_param.m_decoder.m_output_buffer_format,
+                                             l_map, &l_nb_channels, &l_nb_bytes)) {
+                return OPJ_FALSE;
+        }
+        l_depth = l_nb_bytes << 3;
+        l_pixel_size = l_nb_channels * l_nb_bytes;
+
+        /* Copy info from decoded comp image to output image */
+        for (i = 0; i < l_image_dest->numcomps; ++i) {
+                l_image_dest->comps[i].resno_decoded = l_image_src->comps[l_comps ? l_comps[i] : i].resno_decoded;
+        }
+
+        for (c = 0; c < l_nb_channels; ++c) {
+                /* the channels are taken from the output components, l_comps gives their index in the codestream */
+                OPJ_UINT32 l_compno = (l_map[c] < 0) ? 0 : (OPJ_UINT32)l_map[c];
+                OPJ_UINT32 l_src_compno = l_comps ? l_comps[l_compno] : l_compno;
+                opj_image_comp_t * l_img_comp_src = l_image_src->comps + l_src_compno;
+                opj_image_comp_t * l_img_comp_dest = l_image_dest->comps + l_compno;
+                opj_tcd_tilecomp_t * l_tilec = p_j2k->m_tcd->tcd_image->tiles->comps + l_src_compno;
+                opj_tcd_resolution_t * l_res = l_tilec->resolutions + l_img_comp_src->resno_decoded;
+                OPJ_INT32 l_x0_dest, l_y0_dest, l_x1_dest, l_y1_dest;
+                OPJ_INT32 l_x0, l_y0, l_x1, l_y1;
+                OPJ_UINT32 l_width, l_height, l_width_src;
+                OPJ_INT32 l_offset;
+                OPJ_UINT32 l_right_shift, l_left_shift;
+                const OPJ_INT32 * l_src_ptr = l_tilec->data;
+                const OPJ_INT16 * l_src_ptr16 = (const OPJ_INT16 *) l_tilec->data;
+                OPJ_SIZE_T l_src_index;
+                OPJ_BYTE * l_dest_ptr;
+
+                /* Border of the output area */
+                l_x0_dest = opj_int_ceildivpow2((OPJ_INT32)l_img_comp_dest->x0, (OPJ_INT32)l_img_comp_dest->factor);
+                l_y0_dest = opj_int_ceildivpow2((OPJ_INT32)l_img_comp_dest->y0, (OPJ_INT32)l_img_comp_dest->factor);
+                l_x1_dest = l_x0_dest + (OPJ_INT32)l_img_comp_dest->w;
+                l_y1_dest = l_y0_dest + (OPJ_INT32)l_img_comp_dest->h;
+
+                /* Part of the decoded tile component inside the output area */
+                l_x0 = opj_int_max(l_res->x0, l_x0_dest);
+                l_y0 = opj_int_max(l_res->y0, l_y0_dest);
+                l_x1 = opj_int_min(l_res->x1, l_x1_dest);
+                l_y1 = opj_int_min(l_res->y1, l_y1_dest);
+                if (l_x1 <= l_x0 || l_y1 <= l_y0) {
+                        continue;
+                }
+                l_width = (OPJ_UINT32)(l_x1 - l_x0);
+                l_height = (OPJ_UINT32)(l_y1 - l_y0);
+                l_width_src = (OPJ_UINT32)(l_tilec->x1 - l_tilec->x0);
+
+                l_src_index = (OPJ_SIZE_T)(l_y0 - l_res->y0) * l_width_src + (OPJ_UINT32)(l_x0 - l_res->x0);
+                l_dest_ptr = l_buffer + (OPJ_SIZE_T)(l_y0 - l_y0_dest) * l_stride
+                                + (OPJ_SIZE_T)(l_x0 - l_x0_dest) * l_pixel_size + c * l_nb_bytes;
+
+                /* Samples are made unsigned and brought to the output depth */
+                l_offset = l_img_comp_src->sgnd ? (1 << (l_img_comp_src->prec - 1)) : 0;
+                l_right_shift = (l_img_comp_src->prec > l_depth) ? l_img_comp_src->prec - l_depth : 0;
+                l_left_shift = (l_img_comp_src->prec < l_depth) ? l_depth - l_img_comp_src->prec : 0;
+
+                if (l_nb_bytes == 1) {
+                        for (j = 0; j < l_height; ++j) {
+                                OPJ_BYTE * l_dest = l_dest_ptr;
+                                if (l_map[c] < 0) {
+                                        for (i = 0; i < l_width; ++i) {
+                                                *l_dest = 0xff;
+                                                l_dest += l_nb_channels;
+                                        }
+                                }
+                                else {
+                                        for (i = 0; i < l_width; ++i) {
+                                                OPJ_INT32 l_value = l_tilec->data_16bit ? l_src_ptr16[l_src_index + i] : l_src_ptr[l_src_index + i];
+                                                *l_dest = (OPJ_BYTE)((OPJ_UINT32)(l_value + l_offset) >> l_right_shift << l_left_shift);
+                                                l_dest += l_nb_channels;
+                                        }
+                                }
+                                l_src_index += l_width_src;
+                                l_dest_ptr += l_stride;
+                        }
+                }
+                else {
+                        for (j = 0; j < l_height; ++j) {
+                                OPJ_UINT16 * l_dest = (OPJ_UINT16 *) l_dest_ptr;
+                                if (l_map[c] < 0) {
+                                        for (i = 0; i < l_width; ++i) {
+                                                *l_dest = 0xffff;
+                                                l_dest += l_nb_channels;
+                                        }
+                                }
+                                else {
+                                        for (i = 0; i < l_width; ++i) {
+                                                OPJ_INT32 l_value = l_tilec->data_16bit ? l_src_ptr16[l_src_index + i] : l_src_ptr[l_src_index + i];
+                                                *l_dest = (OPJ_UINT16)((OPJ_UINT32)(l_value + l_offset) >> l_right_shift << l_left_shift);
+                                                l_dest += l_nb_channels;
+                                        }
+                                }
+                                l_src_index += l_width_src;
+                                l_dest_ptr += l_stride;
+                        }
+                }
+        }
+
+        return OPJ_TRUE;
+}
+
+static OPJ_BOOL opj_j2k_update_buffer_palette_data (opj_j2k_t * p_j2k)
+{
+        OPJ_UINT32 i,j;
+        OPJ_INT32 l_map[4];
+        OPJ_UINT32 l_nb_channels, l_nb_bytes;
+        opj_j2k_dec_t * l_dec = &p_j2k->m_specific_param.m_decoder;
+        OPJ_UINT32 l_stride = l_dec->m_output_buffer_stride;
+        OPJ_UINT32 l_compno = l_dec->m_output_palette_comp;
+        OPJ_INT32 l_max_index = (OPJ_INT32)l_dec->m_output_palette_size - 1;
+        opj_image_t * l_image_src = p_j2k->m_tcd->image;
+        opj_image_t * l_image_dest = p_j2k->m_output_image;
+        opj_image_comp_t * l_img_comp_src = l_image_src->comps + l_compno;
+        opj_image_comp_t * l_img_comp_dest = l_image_dest->comps + l_compno;
+        opj_tcd_tilecomp_t * l_tilec = p_j2k->m_tcd->tcd_image->tiles->comps + l_compno;
+        opj_tcd_resolution_t * l_res = l_tilec->resolutions + l_img_comp_src->resno_decoded;
+        OPJ_INT32 l_x0_dest, l_y0_dest, l_x1_dest, l_y1_dest;
+        OPJ_INT32 l_x0, l_y0, l_x1, l_y1;
+        OPJ_UINT32 l_width, l_height, l_width_src;
+        const OPJ_INT32 * l_src_ptr = l_tilec->data;
+        const OPJ_INT16 * l_src_ptr16 = (const OPJ_INT16 *) l_tilec->data;
+        OPJ_SIZE_T l_src_index;
+        OPJ_BYTE * l_dest_ptr;
+
+        if (! opj_j2k_get_buffer_channel_map(l_image_dest->numcomps, l_dec->m_output_buffer_format,
+                                             l_map, &l_nb_channels, &l_nb_bytes)) {
+                return OPJ_FALSE;
+        }
+
+        /* Copy info from decoded comp image to output image */
+        for (i = 0; i < l_image_dest->numcomps; ++i) {
+                l_image_dest->comps[i].resno_decoded = l_image_src->comps[i].resno_decoded;
+        }
+
+        /* Part of the decoded tile component inside the output area, see opj_j2k_update_buffer_data */
+        l_x0_dest = opj_int_ceildivpow2((OPJ_INT32)l_img_comp_dest->x0, (OPJ_INT32)l_img_comp_dest->factor);
+        l_y0_dest = opj_int_ceildivpow2((OPJ_INT32)l_img_comp_dest->y0, (OPJ_INT32)l_img_comp_dest->factor);
+        l_x1_dest = l_x0_dest + (OPJ_INT32)l_img_comp_dest->w;
+        l_y1_dest = l_y0_dest + (OPJ_INT32)l_img_comp_dest->h;
+        l_x0 = opj_int_max(l_res->x0, l_x0_dest);
+        l_y0 = opj_int_max(l_res->y0, l_y0_dest);
+        l_x1 = opj_int_min(l_res->x1, l_x1_dest);
+        l_y1 = opj_int_min(l_res->y1, l_y1_dest);
+        if (l_x1 <= l_x0 || l_y1 <= l_y0) {
+                return OPJ_TRUE;
+        }
+        l_width = (OPJ_UINT32)(l_x1 - l_x0);
+        l_height = (OPJ_UINT32)(l_y1 - l_y0);
+        l_width_src = (OPJ_UINT32)(l_tilec->x1 - l_tilec->x0);
+
+        l_src_index = (OPJ_SIZE_T)(l_y0 - l_res->y0) * l_width_src + (OPJ_UINT32)(l_x0 - l_res->x0);
+        l_dest_ptr = l_dec->m_output_buffer + (OPJ_SIZE_T)(l_y0 - l_y0_dest) * l_stride
+                        + (OPJ_SIZE_T)(l_x0 - l_x0_dest) * l_nb_channels;
+
+        /* a single pass over the indices, each one is replaced by the whole pixel of its entry */
+        for (j = 0; j < l_height; ++j) {
+                OPJ_BYTE * l_dest = l_dest_ptr;
+                for (i = 0; i < l_width; ++i) {
+                        OPJ_INT32 l_index = l_tilec->data_16bit ? l_src_ptr16[l_src_index + i] : l_src_ptr[l_src_index + i];
+                        const OPJ_BYTE * l_pixel = l_dec->m_output_palette_pixels
+                                        + (OPJ_SIZE_T)opj_int_clamp(l_index, 0, l_max_index) * l_nb_channels;
+                        if (l_nb_channels == 4) {
+                                memcpy(l_dest, l_pixel, 4);
+                        }
+                        else if (l_nb_channels == 3) {
+                                l_dest[0] = l_pixel[0];
+                                l_dest[1] = l_pixel[1];
+                                l_dest[2] = l_pixel[2];
+                        }
+                        else {
+                                *l_dest = *l_pixel;
+                        }
+                        l_dest += l_nb_channels;
+                }
+                l_src_index += l_width_src;
+                l_dest_ptr += l_stride;
+        }
+
+        return OPJ_TRUE;
+}
+
+static OPJ_BYTE * opj_j2k_get_palette_pixels (const opj_j2k_palette_t * p_palette,
+                                              OPJ_PIXEL_FORMAT p_format,
+                                              opj_event_mgr_t * p_manager)
+{
+        OPJ_UINT32 i, c;
+        OPJ_INT32 l_map[4];
+        OPJ_UINT32 l_nb_channels, l_nb_bytes;
+        OPJ_BYTE * l_pixels;
+
+        if (! opj_j2k_get_buffer_channel_map(p_palette->m_nb_channels, p_format, l_map, &l_nb_channels, &l_nb_bytes)) {
+                opj_event_msg(p_manager, EVT_ERROR, "Unknown output buffer format %d\n", p_format);
+                return 00;
+        }
+        if (l_nb_bytes != 1) {
+                opj_event_msg(p_manager, EVT_ERROR, "Palette images can only be decoded into an 8 bit interleaved buffer\n");
+                return 00;
+        }
+        for (c = 0; c < l_nb_channels; ++c) {
+                if (l_map[c] >= 0 && (p_palette->m_prec[l_map[c]] == 0 || p_palette->m_prec[l_map[c]] > 32)) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Unsupported precision %d of palette channel %d\n", p_palette->m_prec[l_map[c]], l_map[c]);
+                        return 00;
+                }
+        }
+
+        l_pixels = (OPJ_BYTE *) opj_malloc((OPJ_SIZE_T)p_palette->m_nb_entries * l_nb_channels);
+        if (! l_pixels) {
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to decode the palette\n");
+                return 00;
+        }
+
+        /* the entries are brought to 8 bits as the samples in opj_j2k_update_buffer_data */
+        for (c = 0; c < l_nb_channels; ++c) {
+                OPJ_UINT32 l_prec, l_offset, l_right_shift, l_left_shift;
+
+                if (l_map[c] < 0) {
+                        for (i = 0; i < p_palette->m_nb_entries; ++i) {
+                                l_pixels[i * l_nb_channels + c] = 0xff;
+                        }
+                        continue;
+                }
+                l_prec = p_palette->m_prec[l_map[c]];
+                l_offset = p_palette->m_sgnd[l_map[c]] ? (1U << (l_prec - 1)) : 0;
+                l_right_shift = (l_prec > 8) ? l_prec - 8 : 0;
+                l_left_shift = (l_prec < 8) ? 8 - l_prec : 0;
+                for (i = 0; i < p_palette->m_nb_entries; ++i) {
+                        OPJ_UINT32 l_value = p_palette->m_entries[i * p_palette->m_nb_channels + (OPJ_UINT32)l_map[c]];
+                        l_pixels[i * l_nb_channels + c] = (OPJ_BYTE)((l_value + l_offset) >> l_right_shift << l_left_shift);
+                }
+        }
+
+        return l_pixels;
+}
+
 OPJ_BOOL opj_j2k_set_decode_area(       opj_j2k_t *p_j2k,
                                                                     opj_image_t* p_image,
                                                                     OPJ_INT32 p_start_x, OPJ_INT32 p_start_y,
@@ -9025,7 +10639,10 @@ void j2k_dump (opj_j2k_t* p_j2k, OPJ_INT32 flag, FILE* out_stream)
           OPJ_UINT32 i;
           opj_tcp_t * l_tcp = p_j2k->m_cp.tcps;
           for (i=0;i<l_nb_tiles;++i) {
-            opj_j2k_dump_tile_info( l_tcp,(OPJ_INT32)p_j2k->m_private_image->numcomps, out_stream);
+            /* tiles not reached yet still use the default parameters */
+            opj_j2k_dump_tile_info( (l_tcp->tccps == 00 && p_j2k->m_is_decoder) ?
+                                    p_j2k->m_specific_param.m_decoder.m_default_tcp : l_tcp,
+                                    (OPJ_INT32)p_j2k->m_private_image->numcomps, out_stream);
             ++l_tcp;
           }
         }
@@ -9280,80 +10897,410 @@ opj_codestream_index_t* j2k_get_cstr_index(opj_j2k_t* p_j2k)
                 return NULL;
         }
 
-        if (!p_j2k->cstr_index->tile_index){
-                opj_free(l_cstr_index->tile_index);
-                l_cstr_index->tile_index = NULL;
+        if (!p_j2k->cstr_index->tile_index){
+                opj_free(l_cstr_index->tile_index);
+                l_cstr_index->tile_index = NULL;
+        }
+        else {
+                OPJ_UINT32 it_tile = 0;
+                for (it_tile = 0; it_tile < l_cstr_index->nb_of_tiles; it_tile++ ){
+
+                        /* Tile Marker*/
+                        l_cstr_index->tile_index[it_tile].marknum = p_j2k->cstr_index->tile_index[it_tile].marknum;
+
+                        l_cstr_index->tile_index[it_tile].marker =
+                                (opj_marker_info_t*)opj_malloc(l_cstr_index->tile_index[it_tile].marknum*sizeof(opj_marker_info_t));
+
+                        if (!l_cstr_index->tile_index[it_tile].marker) {
+                                OPJ_UINT32 it_tile_free;
+
+                                for (it_tile_free=0; it_tile_free < it_tile; it_tile_free++){
+                                        opj_free(l_cstr_index->tile_index[it_tile_free].marker);
+                                }
+
+                                opj_free( l_cstr_index->tile_index);
+                                opj_free( l_cstr_index->marker);
+                                opj_free( l_cstr_index);
+                                return NULL;
+                        }
+
+                        if (p_j2k->cstr_index->tile_index[it_tile].marker)
+                                memcpy( l_cstr_index->tile_index[it_tile].marker,
+                                                p_j2k->cstr_index->tile_index[it_tile].marker,
+                                                l_cstr_index->tile_index[it_tile].marknum * sizeof(opj_marker_info_t) );
+                        else{
+                                opj_free(l_cstr_index->tile_index[it_tile].marker);
+                                l_cstr_index->tile_index[it_tile].marker = NULL;
+                        }
+
+                        /* Tile part index*/
+                        l_cstr_index->tile_index[it_tile].nb_tps = p_j2k->cstr_index->tile_index[it_tile].nb_tps;
+
+                        l_cstr_index->tile_index[it_tile].tp_index =
+                                (opj_tp_index_t*)opj_malloc(l_cstr_index->tile_index[it_tile].nb_tps*sizeof(opj_tp_index_t));
+
+                        if(!l_cstr_index->tile_index[it_tile].tp_index){
+                                OPJ_UINT32 it_tile_free;
+
+                                for (it_tile_free=0; it_tile_free < it_tile; it_tile_free++){
+                                        opj_free(l_cstr_index->tile_index[it_tile_free].marker);
+                                        opj_free(l_cstr_index->tile_index[it_tile_free].tp_index);
+                                }
+
+                                opj_free( l_cstr_index->tile_index);
+                                opj_free( l_cstr_index->marker);
+                                opj_free( l_cstr_index);
+                                return NULL;
+                        }
+
+                        if (p_j2k->cstr_index->tile_index[it_tile].tp_index){
+                                memcpy( l_cstr_index->tile_index[it_tile].tp_index,
+                                                p_j2k->cstr_index->tile_index[it_tile].tp_index,
+                                                l_cstr_index->tile_index[it_tile].nb_tps * sizeof(opj_tp_index_t) );
+                        }
+                        else{
+                                opj_free(l_cstr_index->tile_index[it_tile].tp_index);
+                                l_cstr_index->tile_index[it_tile].tp_index = NULL;
+                        }
+
+                        /* Packet index */
+                        l_cstr_index->tile_index[it_tile].nb_packet = 0;
+                        l_cstr_index->tile_index[it_tile].packet_index = NULL;
+                        if (p_j2k->cstr_index->tile_index[it_tile].nb_packet) {
+                                l_cstr_index->tile_index[it_tile].packet_index = (opj_packet_info_t*)
+                                        opj_malloc(p_j2k->cstr_index->tile_index[it_tile].nb_packet * sizeof(opj_packet_info_t));
+                                if (! l_cstr_index->tile_index[it_tile].packet_index) {
+                                        j2k_destroy_cstr_index(l_cstr_index);
+                                        return NULL;
+                                }
+                                l_cstr_index->tile_index[it_tile].nb_packet = p_j2k->cstr_index->tile_index[it_tile].nb_packet;
+                                memcpy( l_cstr_index->tile_index[it_tile].packet_index,
+                                                p_j2k->cstr_index->tile_index[it_tile].packet_index,
+                                                l_cstr_index->tile_index[it_tile].nb_packet * sizeof(opj_packet_info_t) );
+                        }
+
+                }
+        }
+
+        return l_cstr_index;
+}
+
+OPJ_BOOL opj_j2k_save_cstr_index(   opj_j2k_t *p_j2k,
+                                    opj_stream_private_t *p_index_stream,
+                                    OPJ_UINT64 p_stamp,
+                                    opj_event_mgr_t * p_manager )
+{
+        opj_codestream_index_t * l_cstr_index = p_j2k->cstr_index;
+        opj_j2k_index_tp_t * l_tps, * l_tp;
+        OPJ_UINT32 l_nb_tps = 0, l_nb_lengths = 0, i, j;
+        OPJ_OFF_T l_pos;
+        OPJ_SIZE_T l_size;
+        OPJ_BYTE * l_data, * l_current_data;
+        OPJ_BOOL l_result;
+
+        if (! l_cstr_index || ! l_cstr_index->tile_index) {
+                opj_event_msg(p_manager, EVT_ERROR, "The main header must be read before saving the codestream index\n");
+                return OPJ_FALSE;
+        }
+
+        for (i = 0; i < l_cstr_index->nb_of_tiles; ++i) {
+                if ((l_cstr_index->tile_index[i].nb_tps == 0) || ! l_cstr_index->tile_index[i].tp_index) {
+                        opj_event_msg(p_manager, EVT_ERROR, "The whole codestream must be read before saving its index\n");
+                        return OPJ_FALSE;
+                }
+                l_nb_tps += l_cstr_index->tile_index[i].nb_tps;
+        }
+
+        l_tps = (opj_j2k_index_tp_t *) opj_malloc(l_nb_tps * sizeof(opj_j2k_index_tp_t));
+        if (! l_tps) {
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to save the codestream index\n");
+                return OPJ_FALSE;
+        }
+        l_tp = l_tps;
+        for (i = 0; i < l_cstr_index->nb_of_tiles; ++i) {
+                for (j = 0; j < l_cstr_index->tile_index[i].nb_tps; ++j) {
+                        l_tp->m_tile_no = i;
+                        l_tp->m_tp_index = &l_cstr_index->tile_index[i].tp_index[j];
+                        ++l_tp;
+                }
+        }
+        qsort(l_tps, l_nb_tps, sizeof(opj_j2k_index_tp_t), opj_j2k_compare_index_tps);
+
+        /* the tile-parts follow each other from the end of the main header */
+        l_pos = l_cstr_index->main_head_end;
+        for (i = 0, l_tp = l_tps; i < l_nb_tps; ++i, ++l_tp) {
+                opj_tp_index_t * l_tp_index = l_tp->m_tp_index;
+
+                if ((l_tp_index->start_pos != l_pos) || (l_tp_index->end_pos - l_tp_index->start_pos < 14)
+                        || (l_tp_index->end_pos - l_tp_index->start_pos > (OPJ_OFF_T)0xffffffff)) {
+                        opj_event_msg(p_manager, EVT_ERROR, "The whole codestream must be read before saving its index\n");
+                        opj_free(l_tps);
+                        return OPJ_FALSE;
+                }
+                /* the packets are only given when all of them are known */
+                if (l_tp_index->first_packet + l_tp_index->nb_packets <= l_cstr_index->tile_index[l_tp->m_tile_no].nb_packet) {
+                        l_nb_lengths += l_tp_index->nb_packets;
+                }
+                l_pos = l_tp_index->end_pos;
+        }
+
+        l_size = OPJ_J2K_INDEX_HEADER_SIZE + (OPJ_SIZE_T)l_nb_tps * OPJ_J2K_INDEX_TP_SIZE + (OPJ_SIZE_T)l_nb_lengths * 4;
+        l_data = (OPJ_BYTE *) opj_malloc(l_size);
+        if (! l_data) {
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to save the codestream index\n");
+                opj_free(l_tps);
+                return OPJ_FALSE;
+        }
+
+        l_current_data = l_data;
+        opj_write_bytes(l_current_data, OPJ_J2K_INDEX_MAGIC, 4);                                                       /* magic */
+        opj_write_bytes(l_current_data + 4, OPJ_J2K_INDEX_VERSION, 4);                                                 /* version */
+        opj_write_bytes(l_current_data + 8, (OPJ_UINT32)(p_stamp >> 32), 4);                                           /* stamp */
+        opj_write_bytes(l_current_data + 12, (OPJ_UINT32)p_stamp, 4);
+        opj_write_bytes(l_current_data + 16, (OPJ_UINT32)((OPJ_UINT64)p_j2k->m_specific_param.m_decoder.m_stream_length >> 32), 4);   /* stream length */
+        opj_write_bytes(l_current_data + 20, (OPJ_UINT32)p_j2k->m_specific_param.m_decoder.m_stream_length, 4);
+        opj_write_bytes(l_current_data + 24, (OPJ_UINT32)((OPJ_UINT64)l_cstr_index->main_head_start >> 32), 4);       /* main header start */
+        opj_write_bytes(l_current_data + 28, (OPJ_UINT32)l_cstr_index->main_head_start, 4);
+        opj_write_bytes(l_current_data + 32, (OPJ_UINT32)((OPJ_UINT64)l_cstr_index->main_head_end >> 32), 4);         /* main header end */
+        opj_write_bytes(l_current_data + 36, (OPJ_UINT32)l_cstr_index->main_head_end, 4);
+        opj_write_bytes(l_current_data + 40, p_j2k->m_specific_param.m_decoder.m_header_checksum, 4);                 /* main header checksum */
+        opj_write_bytes(l_current_data + 44, l_cstr_index->nb_of_tiles, 4);                                            /* number of tiles */
+        opj_write_bytes(l_current_data + 48, l_nb_tps, 4);                                                             /* number of tile-parts */
+        l_current_data += OPJ_J2K_INDEX_HEADER_SIZE;
+
+        for (i = 0, l_tp = l_tps; i < l_nb_tps; ++i, ++l_tp) {
+                opj_tp_index_t * l_tp_index = l_tp->m_tp_index;
+                OPJ_UINT32 l_nb_packets = 0;
+
+                if (l_tp_index->first_packet + l_tp_index->nb_packets <= l_cstr_index->tile_index[l_tp->m_tile_no].nb_packet) {
+                        l_nb_packets = l_tp_index->nb_packets;
+                }
+                opj_write_bytes(l_current_data, l_tp->m_tile_no, 4);                                                   /* tile number */
+                opj_write_bytes(l_current_data + 4, (OPJ_UINT32)(l_tp_index->end_pos - l_tp_index->start_pos), 4);   /* tile-part length */
+                opj_write_bytes(l_current_data + 8, l_nb_packets, 4);                                                  /* number of packets */
+                l_current_data += OPJ_J2K_INDEX_TP_SIZE;
+        }
+
+        for (i = 0, l_tp = l_tps; i < l_nb_tps; ++i, ++l_tp) {
+                opj_tile_index_t * l_tile_index = &l_cstr_index->tile_index[l_tp->m_tile_no];
+                opj_tp_index_t * l_tp_index = l_tp->m_tp_index;
+
+                if (l_tp_index->first_packet + l_tp_index->nb_packets > l_tile_index->nb_packet) {
+                        continue;
+                }
+                /* the positions are relative to the tile-part data when it has not been reached */
+                for (j = 0; j < l_tp_index->nb_packets; ++j) {
+                        opj_packet_info_t * l_packet = &l_tile_index->packet_index[l_tp_index->first_packet + j];
+                        opj_write_bytes(l_current_data, (OPJ_UINT32)(l_packet->end_pos - l_packet->start_pos + 1), 4);  /* packet length */
+                        l_current_data += 4;
+                }
+        }
+        opj_free(l_tps);
+
+        l_result = (opj_stream_write_data(p_index_stream, l_data, l_size, p_manager) == l_size)
+                && opj_stream_flush(p_index_stream, p_manager);
+        opj_free(l_data);
+        if (! l_result) {
+                opj_event_msg(p_manager, EVT_ERROR, "Cannot write the index file\n");
+        }
+
+        return l_result;
+}
+
+OPJ_BOOL opj_j2k_load_cstr_index(   opj_j2k_t *p_j2k,
+                                    opj_stream_private_t *p_index_stream,
+                                    OPJ_UINT64 p_stamp,
+                                    opj_event_mgr_t * p_manager )
+{
+        opj_j2k_dec_t * l_dec = &p_j2k->m_specific_param.m_decoder;
+        OPJ_BYTE l_header [OPJ_J2K_INDEX_HEADER_SIZE];
+        OPJ_UINT32 l_magic, l_version, l_high, l_low, l_nb_tps, l_nb_lengths = 0, i;
+        OPJ_UINT64 l_stamp;
+        OPJ_BYTE * l_data, * l_current_data;
+        OPJ_SIZE_T l_size;
+
+        if (l_dec->m_state != J2K_STATE_NONE) {
+                opj_event_msg(p_manager, EVT_ERROR, "The index file must be loaded before the main header is read\n");
+                return OPJ_FALSE;
+        }
+
+        if (opj_stream_read_data(p_index_stream, l_header, OPJ_J2K_INDEX_HEADER_SIZE, p_manager) != OPJ_J2K_INDEX_HEADER_SIZE) {
+                opj_event_msg(p_manager, EVT_WARNING, "The index file cannot be read, it is ignored\n");
+                return OPJ_FALSE;
+        }
+        opj_read_bytes(l_header, &l_magic, 4);                                  /* magic */
+        opj_read_bytes(l_header + 4, &l_version, 4);                            /* version */
+        opj_read_bytes(l_header + 8, &l_high, 4);                               /* stamp */
+        opj_read_bytes(l_header + 12, &l_low, 4);
+        l_stamp = ((OPJ_UINT64)l_high << 32) | l_low;
+        opj_read_bytes(l_header + 48, &l_nb_tps, 4);                            /* number of tile-parts */
+        if ((l_magic != OPJ_J2K_INDEX_MAGIC) || (l_version != OPJ_J2K_INDEX_VERSION)
+                || (l_nb_tps == 0) || (l_nb_tps > 0xffffffff / OPJ_J2K_INDEX_TP_SIZE)) {
+                opj_event_msg(p_manager, EVT_WARNING, "The index file is not valid, it is ignored\n");
+                return OPJ_FALSE;
+        }
+        if (l_stamp != p_stamp) {
+                opj_event_msg(p_manager, EVT_WARNING, "The index file was saved for another version of the file, it is ignored\n");
+                return OPJ_FALSE;
+        }
+
+        l_size = (OPJ_SIZE_T)l_nb_tps * OPJ_J2K_INDEX_TP_SIZE;
+        l_data = (OPJ_BYTE *) opj_malloc(l_size);
+        opj_free(l_dec->m_tlm);
+        l_dec->m_tlm = (opj_j2k_tlm_info_t *) opj_malloc(l_nb_tps * sizeof(opj_j2k_tlm_info_t));
+        opj_free(l_dec->m_plm_tp_nb_packets);
+        l_dec->m_plm_tp_nb_packets = (OPJ_UINT32 *) opj_malloc(l_nb_tps * sizeof(OPJ_UINT32));
+        l_dec->m_nb_tlm = l_dec->m_max_tlm = 0;
+        l_dec->m_nb_plm_tps = l_dec->m_max_plm_tps = 0;
+        l_dec->m_nb_plm_lengths = 0;
+        if (! l_data || ! l_dec->m_tlm || ! l_dec->m_plm_tp_nb_packets) {
+                opj_free(l_data);
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to load the index file\n");
+                return OPJ_FALSE;
         }
-        else {
-                OPJ_UINT32 it_tile = 0;
-                for (it_tile = 0; it_tile < l_cstr_index->nb_of_tiles; it_tile++ ){
+        l_dec->m_max_tlm = l_dec->m_max_plm_tps = l_nb_tps;
 
-                        /* Tile Marker*/
-                        l_cstr_index->tile_index[it_tile].marknum = p_j2k->cstr_index->tile_index[it_tile].marknum;
+        if (opj_stream_read_data(p_index_stream, l_data, l_size, p_manager) != l_size) {
+                opj_free(l_data);
+                opj_event_msg(p_manager, EVT_WARNING, "The index file cannot be read, it is ignored\n");
+                return OPJ_FALSE;
+        }
+        for (i = 0, l_current_data = l_data; i < l_nb_tps; ++i, l_current_data += OPJ_J2K_INDEX_TP_SIZE) {
+                opj_read_bytes(l_current_data, &l_dec->m_tlm[i].m_tile_no, 4);         /* tile number */
+                opj_read_bytes(l_current_data + 4, &l_dec->m_tlm[i].m_length, 4);      /* tile-part length */
+                opj_read_bytes(l_current_data + 8, &l_dec->m_plm_tp_nb_packets[i], 4); /* number of packets */
+                if (l_dec->m_plm_tp_nb_packets[i] > 0xffffffff / 4 - l_nb_lengths) {
+                        opj_free(l_data);
+                        opj_event_msg(p_manager, EVT_WARNING, "The index file is not valid, it is ignored\n");
+                        return OPJ_FALSE;
+                }
+                l_nb_lengths += l_dec->m_plm_tp_nb_packets[i];
+        }
+        opj_free(l_data);
 
-                        l_cstr_index->tile_index[it_tile].marker =
-                                (opj_marker_info_t*)opj_malloc(l_cstr_index->tile_index[it_tile].marknum*sizeof(opj_marker_info_t));
+        if (l_nb_lengths) {
+                l_size = (OPJ_SIZE_T)l_nb_lengths * 4;
+                l_data = (OPJ_BYTE *) opj_malloc(l_size);
+                opj_free(l_dec->m_plm_lengths);
+                l_dec->m_plm_lengths = (OPJ_UINT32 *) opj_malloc(l_nb_lengths * sizeof(OPJ_UINT32));
+                l_dec->m_max_plm_lengths = 0;
+                if (! l_data || ! l_dec->m_plm_lengths) {
+                        opj_free(l_data);
+                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to load the index file\n");
+                        return OPJ_FALSE;
+                }
+                l_dec->m_max_plm_lengths = l_nb_lengths;
+                if (opj_stream_read_data(p_index_stream, l_data, l_size, p_manager) != l_size) {
+                        opj_free(l_data);
+                        opj_event_msg(p_manager, EVT_WARNING, "The index file cannot be read, it is ignored\n");
+                        return OPJ_FALSE;
+                }
+                for (i = 0, l_current_data = l_data; i < l_nb_lengths; ++i, l_current_data += 4) {
+                        opj_read_bytes(l_current_data, &l_dec->m_plm_lengths[i], 4);   /* packet length */
+                }
+                opj_free(l_data);
+        }
 
-                        if (!l_cstr_index->tile_index[it_tile].marker) {
-                                OPJ_UINT32 it_tile_free;
+        /* the codestream the index file describes, checked once the main header is read */
+        opj_read_bytes(l_header + 16, &l_high, 4);                              /* stream length */
+        opj_read_bytes(l_header + 20, &l_low, 4);
+        l_dec->m_index_stream_length = (OPJ_OFF_T)(((OPJ_UINT64)l_high << 32) | l_low);
+        opj_read_bytes(l_header + 24, &l_high, 4);                              /* main header start */
+        opj_read_bytes(l_header + 28, &l_low, 4);
+        l_dec->m_index_main_head_start = (OPJ_OFF_T)(((OPJ_UINT64)l_high << 32) | l_low);
+        opj_read_bytes(l_header + 32, &l_high, 4);                              /* main header end */
+        opj_read_bytes(l_header + 36, &l_low, 4);
+        l_dec->m_index_main_head_end = (OPJ_OFF_T)(((OPJ_UINT64)l_high << 32) | l_low);
+        opj_read_bytes(l_header + 40, &l_dec->m_index_header_checksum, 4);      /* main header checksum */
+        opj_read_bytes(l_header + 44, &l_dec->m_index_nb_tiles, 4);             /* number of tiles */
 
-                                for (it_tile_free=0; it_tile_free < it_tile; it_tile_free++){
-                                        opj_free(l_cstr_index->tile_index[it_tile_free].marker);
-                                }
+        l_dec->m_nb_tlm = l_nb_tps;
+        l_dec->m_nb_plm_tps = l_nb_tps;
+        l_dec->m_nb_plm_lengths = l_nb_lengths;
+        l_dec->m_tlm_invalid = 0;
+        l_dec->m_plm_invalid = 0;
+        l_dec->m_index_file = 1;
 
-                                opj_free( l_cstr_index->tile_index);
-                                opj_free( l_cstr_index->marker);
-                                opj_free( l_cstr_index);
-                                return NULL;
-                        }
+        return OPJ_TRUE;
+}
 
-                        if (p_j2k->cstr_index->tile_index[it_tile].marker)
-                                memcpy( l_cstr_index->tile_index[it_tile].marker,
-                                                p_j2k->cstr_index->tile_index[it_tile].marker,
-                                                l_cstr_index->tile_index[it_tile].marknum * sizeof(opj_marker_info_t) );
-                        else{
-                                opj_free(l_cstr_index->tile_index[it_tile].marker);
-                                l_cstr_index->tile_index[it_tile].marker = NULL;
-                        }
+OPJ_BOOL opj_j2k_init_codec_stats (opj_j2k_t *p_j2k)
+{
+        opj_codec_stats_t * l_stats = p_j2k->m_stats;
+        OPJ_UINT32 l_nb_tiles = p_j2k->m_cp.tw * p_j2k->m_cp.th;
 
-                        /* Tile part index*/
-                        l_cstr_index->tile_index[it_tile].nb_tps = p_j2k->cstr_index->tile_index[it_tile].nb_tps;
+        if (p_j2k->m_tcd) {
+                p_j2k->m_tcd->m_stats = l_stats;
+        }
+        if (! l_stats || l_stats->tiles || ! l_nb_tiles) {
+                return OPJ_TRUE;
+        }
 
-                        l_cstr_index->tile_index[it_tile].tp_index =
-                                (opj_tp_index_t*)opj_malloc(l_cstr_index->tile_index[it_tile].nb_tps*sizeof(opj_tp_index_t));
+        l_stats->tiles = (opj_tile_stats_t *) opj_calloc(l_nb_tiles, sizeof(opj_tile_stats_t));
+        if (! l_stats->tiles) {
+                return OPJ_FALSE;
+        }
+        l_stats->nb_tiles = l_nb_tiles;
 
-                        if(!l_cstr_index->tile_index[it_tile].tp_index){
-                                OPJ_UINT32 it_tile_free;
+        return OPJ_TRUE;
+}
 
-                                for (it_tile_free=0; it_tile_free < it_tile; it_tile_free++){
-                                        opj_free(l_cstr_index->tile_index[it_tile_free].marker);
-                                        opj_free(l_cstr_index->tile_index[it_tile_free].tp_index);
-                                }
+OPJ_BOOL opj_j2k_set_codec_stats(       opj_j2k_t *p_j2k,
+                                        OPJ_BOOL p_enable,
+                                        opj_event_mgr_t * p_manager )
+{
+        /* preconditions */
+        assert(p_j2k != 00);
+        assert(p_manager != 00);
 
-                                opj_free( l_cstr_index->tile_index);
-                                opj_free( l_cstr_index->marker);
-                                opj_free( l_cstr_index);
-                                return NULL;
-                        }
+        if (p_j2k->m_stats) {
+                opj_free(p_j2k->m_stats->tiles);
+                opj_free(p_j2k->m_stats);
+                p_j2k->m_stats = 00;
+        }
+        if (p_enable) {
+                p_j2k->m_stats = (opj_codec_stats_t *) opj_calloc(1, sizeof(opj_codec_stats_t));
+                if (! p_j2k->m_stats) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to collect the codec statistics\n");
+                        return OPJ_FALSE;
+                }
+        }
+        if (! opj_j2k_init_codec_stats(p_j2k)) {
+                opj_free(p_j2k->m_stats);
+                p_j2k->m_stats = 00;
+                if (p_j2k->m_tcd) {
+                        p_j2k->m_tcd->m_stats = 00;
+                }
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to collect the codec statistics\n");
+                return OPJ_FALSE;
+        }
 
-                        if (p_j2k->cstr_index->tile_index[it_tile].tp_index){
-                                memcpy( l_cstr_index->tile_index[it_tile].tp_index,
-                                                p_j2k->cstr_index->tile_index[it_tile].tp_index,
-                                                l_cstr_index->tile_index[it_tile].nb_tps * sizeof(opj_tp_index_t) );
-                        }
-                        else{
-                                opj_free(l_cstr_index->tile_index[it_tile].tp_index);
-                                l_cstr_index->tile_index[it_tile].tp_index = NULL;
-                        }
+        return OPJ_TRUE;
+}
 
-                        /* Packet index (NOT USED)*/
-                        l_cstr_index->tile_index[it_tile].nb_packet = 0;
-                        l_cstr_index->tile_index[it_tile].packet_index = NULL;
+opj_codec_stats_t* opj_j2k_get_codec_stats(opj_j2k_t *p_j2k)
+{
+        opj_codec_stats_t * l_stats = 00;
+
+        if (! p_j2k->m_stats) {
+                return 00;
+        }
 
+        l_stats = (opj_codec_stats_t *) opj_malloc(sizeof(opj_codec_stats_t));
+        if (! l_stats) {
+                return 00;
+        }
+        memcpy(l_stats, p_j2k->m_stats, sizeof(opj_codec_stats_t));
+        if (p_j2k->m_stats->tiles) {
+                l_stats->tiles = (opj_tile_stats_t *) opj_malloc(l_stats->nb_tiles * sizeof(opj_tile_stats_t));
+                if (! l_stats->tiles) {
+                        opj_free(l_stats);
+                        return 00;
                 }
+                memcpy(l_stats->tiles, p_j2k->m_stats->tiles, l_stats->nb_tiles * sizeof(opj_tile_stats_t));
         }
 
-        return l_cstr_index;
+        return l_stats;
 }
 
 OPJ_BOOL opj_j2k_allocate_tile_element_cstr_index(opj_j2k_t *p_j2k)
@@ -9388,6 +11335,7 @@ OPJ_BOOL opj_j2k_decode_tiles ( opj_j2k_t *p_j2k,
         OPJ_UINT32 l_nb_comps;
         OPJ_BYTE * l_current_data;
         OPJ_UINT32 nr_tiles = 0;
+        opj_stage_clock_t l_clock;
 
         l_current_data = (OPJ_BYTE*)opj_malloc(1000);
         if (! l_current_data) {
@@ -9414,27 +11362,58 @@ OPJ_BOOL opj_j2k_decode_tiles ( opj_j2k_t *p_j2k,
                         break;
                 }
 
-                if (l_data_size > l_max_data_size) {
-                        OPJ_BYTE *l_new_current_data = (OPJ_BYTE *) opj_realloc(l_current_data, l_data_size);
-                        if (! l_new_current_data) {
+                if (p_j2k->m_specific_param.m_decoder.m_output_buffer || p_j2k->m_specific_param.m_decoder.m_strip_fn) {
+                        /* the tile is written to the caller buffer straight from the tile components,
+                         * or handed to the caller strip by strip while it is decoded */
+                        if (! opj_j2k_decode_tile(p_j2k,l_current_tile_no,00,0,p_stream,p_manager)) {
                                 opj_free(l_current_data);
-                                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to decode tile %d/%d\n", l_current_tile_no +1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
+                                opj_event_msg(p_manager, EVT_ERROR, "Failed to decode tile %d/%d\n", l_current_tile_no +1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
                                 return OPJ_FALSE;
                         }
-                        l_current_data = l_new_current_data;
-                        l_max_data_size = l_data_size;
-                }
+                        opj_event_msg(p_manager, EVT_INFO, "Tile %d/%d has been decoded.\n", l_current_tile_no +1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
 
-                if (! opj_j2k_decode_tile(p_j2k,l_current_tile_no,l_current_data,l_data_size,p_stream,p_manager)) {
-                        opj_free(l_current_data);
-                        opj_event_msg(p_manager, EVT_ERROR, "Failed to decode tile %d/%d\n", l_current_tile_no +1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
-                        return OPJ_FALSE;
+                        if (p_j2k->m_specific_param.m_decoder.m_output_buffer) {
+                                if (p_j2k->m_stats) {
+                                        opj_stage_clock_start(&l_clock);
+                                }
+                                if (! opj_j2k_update_buffer_data(p_j2k)) {
+                                        opj_free(l_current_data);
+                                        return OPJ_FALSE;
+                                }
+                                if (p_j2k->m_stats) {
+                                        opj_stage_clock_stop(&l_clock, p_j2k->m_stats, l_current_tile_no, OPJ_STAGE_COPY, l_data_size);
+                                }
+                        }
                 }
-                opj_event_msg(p_manager, EVT_INFO, "Tile %d/%d has been decoded.\n", l_current_tile_no +1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
+                else {
+                        if (l_data_size > l_max_data_size) {
+                                OPJ_BYTE *l_new_current_data = (OPJ_BYTE *) opj_realloc(l_current_data, l_data_size);
+                                if (! l_new_current_data) {
+                                        opj_free(l_current_data);
+                                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to decode tile %d/%d\n", l_current_tile_no +1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
+                                        return OPJ_FALSE;
+                                }
+                                l_current_data = l_new_current_data;
+                                l_max_data_size = l_data_size;
+                        }
 
-                if (! opj_j2k_update_image_data(p_j2k->m_tcd,l_current_data, p_j2k->m_output_image)) {
-                        opj_free(l_current_data);
-                        return OPJ_FALSE;
+                        if (! opj_j2k_decode_tile(p_j2k,l_current_tile_no,l_current_data,l_data_size,p_stream,p_manager)) {
+                                opj_free(l_current_data);
+                                opj_event_msg(p_manager, EVT_ERROR, "Failed to decode tile %d/%d\n", l_current_tile_no +1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
+                                return OPJ_FALSE;
+                        }
+                        opj_event_msg(p_manager, EVT_INFO, "Tile %d/%d has been decoded.\n", l_current_tile_no +1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
+
+                        if (p_j2k->m_stats) {
+                                opj_stage_clock_start(&l_clock);
+                        }
+                        if (! opj_j2k_update_image_data(p_j2k->m_tcd,l_current_data, p_j2k->m_output_image)) {
+                                opj_free(l_current_data);
+                                return OPJ_FALSE;
+                        }
+                        if (p_j2k->m_stats) {
+                                opj_stage_clock_stop(&l_clock, p_j2k->m_stats, l_current_tile_no, OPJ_STAGE_COPY, l_data_size);
+                        }
                 }
                 opj_event_msg(p_manager, EVT_INFO, "Image data has been updated with tile %d.\n\n", l_current_tile_no + 1);
                 
@@ -9477,6 +11456,7 @@ static OPJ_BOOL opj_j2k_decode_one_tile (       opj_j2k_t *p_j2k,
         OPJ_INT32 l_tile_x0,l_tile_y0,l_tile_x1,l_tile_y1;
         OPJ_UINT32 l_nb_comps;
         OPJ_BYTE * l_current_data;
+        opj_stage_clock_t l_clock;
 
         l_current_data = (OPJ_BYTE*)opj_malloc(1000);
         if (! l_current_data) {
@@ -9498,10 +11478,19 @@ static OPJ_BOOL opj_j2k_decode_one_tile (       opj_j2k_t *p_j2k,
         if (p_j2k->cstr_index->tile_index)
                 if(p_j2k->cstr_index->tile_index->tp_index)
                 {
+                        /* a position from the TLM markers is checked first, the index is dropped if it is wrong */
+                        if (p_j2k->m_specific_param.m_decoder.m_tlm_index && p_j2k->cstr_index->tile_index[l_tile_no_to_dec].nb_tps
+                                && ! opj_j2k_check_tlm_tile_part(p_j2k, p_stream, l_tile_no_to_dec, 0, p_manager)
+                                && ! p_j2k->m_specific_param.m_decoder.m_last_sot_read_pos) {
+                                /* no tile-part has been read yet, start again from the first one */
+                                p_j2k->m_specific_param.m_decoder.m_last_sot_read_pos = (OPJ_UINT32)p_j2k->cstr_index->main_head_end;
+                        }
                         if ( ! p_j2k->cstr_index->tile_index[l_tile_no_to_dec].nb_tps) {
                                 /* the index for this tile has not been built,
-                                 *  so move to the last SOT read */
-                                if ( !(opj_stream_read_seek(p_stream, p_j2k->m_specific_param.m_decoder.m_last_sot_read_pos+2, p_manager)) ){
+                                 *  so move to the last SOT read, or to the first one if tile-parts may have been jumped over */
+                                OPJ_OFF_T l_sot_pos = p_j2k->m_specific_param.m_decoder.m_tlm_seeks ?
+                                                p_j2k->cstr_index->main_head_end : (OPJ_OFF_T)p_j2k->m_specific_param.m_decoder.m_last_sot_read_pos;
+                                if ( !(opj_stream_read_seek(p_stream, l_sot_pos+2, p_manager)) ){
                                         opj_event_msg(p_manager, EVT_ERROR, "Problem with seek function\n");
                         opj_free(l_current_data);
                                         return OPJ_FALSE;
@@ -9557,10 +11546,16 @@ static OPJ_BOOL opj_j2k_decode_one_tile (       opj_j2k_t *p_j2k,
                 }
                 opj_event_msg(p_manager, EVT_INFO, "Tile %d/%d has been decoded.\n", l_current_tile_no, (p_j2k->m_cp.th * p_j2k->m_cp.tw) - 1);
 
+                if (p_j2k->m_stats) {
+                        opj_stage_clock_start(&l_clock);
+                }
                 if (! opj_j2k_update_image_data(p_j2k->m_tcd,l_current_data, p_j2k->m_output_image)) {
                         opj_free(l_current_data);
                         return OPJ_FALSE;
                 }
+                if (p_j2k->m_stats) {
+                        opj_stage_clock_stop(&l_clock, p_j2k->m_stats, l_current_tile_no, OPJ_STAGE_COPY, l_data_size);
+                }
                 opj_event_msg(p_manager, EVT_INFO, "Image data has been updated with tile %d.\n\n", l_current_tile_no);
 
                 if(l_current_tile_no == l_tile_no_to_dec)
@@ -9606,6 +11601,11 @@ OPJ_BOOL opj_j2k_decode(opj_j2k_t * p_j2k,
         if (!p_image)
                 return OPJ_FALSE;
 
+        /* the output image only holds the decoded components */
+        if (! opj_j2k_remove_undecoded_components(p_j2k, p_image, p_manager)) {
+                return OPJ_FALSE;
+        }
+
         p_j2k->m_output_image = opj_image_create0();
         if (! (p_j2k->m_output_image)) {
                 return OPJ_FALSE;
@@ -9639,6 +11639,160 @@ OPJ_BOOL opj_j2k_decode(opj_j2k_t * p_j2k,
         return OPJ_TRUE;
 }
 
+OPJ_BOOL opj_j2k_decode_to_buffer(opj_j2k_t * p_j2k,
+                                  opj_stream_private_t * p_stream,
+                                  opj_image_t * p_image,
+                                  OPJ_BYTE * p_buffer,
+                                  OPJ_UINT32 p_stride,
+                                  OPJ_PIXEL_FORMAT p_format,
+                                  opj_event_mgr_t * p_manager)
+{
+        OPJ_UINT32 c;
+        OPJ_INT32 l_map[4];
+        OPJ_UINT32 l_nb_channels, l_nb_bytes;
+        opj_image_comp_t * l_ref_comp;
+        OPJ_BOOL l_result;
+
+        if (!p_image || !p_buffer || !p_image->numcomps)
+                return OPJ_FALSE;
+
+        if (! opj_j2k_remove_undecoded_components(p_j2k, p_image, p_manager)) {
+                return OPJ_FALSE;
+        }
+
+        if (! opj_j2k_get_buffer_channel_map(p_image->numcomps, p_format, l_map, &l_nb_channels, &l_nb_bytes)) {
+                opj_event_msg(p_manager, EVT_ERROR, "Unknown output buffer format %d\n", p_format);
+                return OPJ_FALSE;
+        }
+
+        /* Every channel is written on the grid of the first component */
+        l_ref_comp = p_image->comps;
+        for (c = 0; c < l_nb_channels; ++c) {
+                opj_image_comp_t * l_comp;
+                if (l_map[c] < 0) {
+                        continue;
+                }
+                l_comp = p_image->comps + l_map[c];
+                if (l_comp->dx != l_ref_comp->dx || l_comp->dy != l_ref_comp->dy
+                                || l_comp->w != l_ref_comp->w || l_comp->h != l_ref_comp->h
+                                || l_comp->factor != l_ref_comp->factor) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Component %d does not have the size of the first component, it can not be decoded into an interleaved buffer\n", l_map[c]);
+                        return OPJ_FALSE;
+                }
+        }
+
+        if ((OPJ_SIZE_T)p_stride < (OPJ_SIZE_T)l_ref_comp->w * l_nb_channels * l_nb_bytes) {
+                opj_event_msg(p_manager, EVT_ERROR, "Output buffer stride (%d) is smaller than a line of the decoded image\n", p_stride);
+                return OPJ_FALSE;
+        }
+        if (l_nb_bytes == 2 && ((p_stride & 1) || ((OPJ_SIZE_T)p_buffer & 1))) {
+                opj_event_msg(p_manager, EVT_ERROR, "16 bit output buffer and stride must be 2 bytes aligned\n");
+                return OPJ_FALSE;
+        }
+
+        p_j2k->m_specific_param.m_decoder.m_output_buffer = p_buffer;
+        p_j2k->m_specific_param.m_decoder.m_output_buffer_stride = p_stride;
+        p_j2k->m_specific_param.m_decoder.m_output_buffer_format = p_format;
+
+        l_result = opj_j2k_decode(p_j2k, p_stream, p_image, p_manager);
+
+        p_j2k->m_specific_param.m_decoder.m_output_buffer = 00;
+
+        return l_result;
+}
+
+OPJ_BOOL opj_j2k_decode_palette_to_buffer(opj_j2k_t * p_j2k,
+                                          opj_stream_private_t * p_stream,
+                                          opj_image_t * p_image,
+                                          OPJ_BYTE * p_buffer,
+                                          OPJ_UINT32 p_stride,
+                                          OPJ_PIXEL_FORMAT p_format,
+                                          const opj_j2k_palette_t * p_palette,
+                                          opj_event_mgr_t * p_manager)
+{
+        opj_j2k_dec_t * l_dec = &p_j2k->m_specific_param.m_decoder;
+        OPJ_BOOL l_result;
+
+        if (!p_image || !p_palette || !p_palette->m_nb_entries || !p_palette->m_nb_channels)
+                return OPJ_FALSE;
+
+        /* the indices are taken from a component of the codestream */
+        if (p_j2k->m_cp.m_specific_param.m_dec.m_decoded_comps || p_palette->m_compno >= p_image->numcomps) {
+                opj_event_msg(p_manager, EVT_ERROR, "The palette indices of component %d are not decoded\n", p_palette->m_compno);
+                return OPJ_FALSE;
+        }
+
+        l_dec->m_output_palette_pixels = opj_j2k_get_palette_pixels(p_palette, p_format, p_manager);
+        if (! l_dec->m_output_palette_pixels) {
+                return OPJ_FALSE;
+        }
+        l_dec->m_output_palette_size = p_palette->m_nb_entries;
+        l_dec->m_output_palette_comp = p_palette->m_compno;
+
+        l_result = opj_j2k_decode_to_buffer(p_j2k, p_stream, p_image, p_buffer, p_stride, p_format, p_manager);
+
+        opj_free(l_dec->m_output_palette_pixels);
+        l_dec->m_output_palette_pixels = 00;
+
+        return l_result;
+}
+
+OPJ_BOOL opj_j2k_decode_strips(opj_j2k_t * p_j2k,
+                               opj_stream_private_t * p_stream,
+                               opj_image_t * p_image,
+                               OPJ_UINT32 p_strip_height,
+                               opj_strip_decode_fn p_strip_fn,
+                               void * p_user_data,
+                               opj_event_mgr_t * p_manager)
+{
+        OPJ_UINT32 compno;
+        opj_image_comp_t * l_ref_comp;
+        OPJ_BOOL l_result;
+
+        if (!p_image || !p_strip_fn || !p_image->numcomps || !p_j2k->m_tcd)
+                return OPJ_FALSE;
+
+        if (! opj_j2k_remove_undecoded_components(p_j2k, p_image, p_manager)) {
+                return OPJ_FALSE;
+        }
+
+        if (p_strip_height == 0) {
+                opj_event_msg(p_manager, EVT_ERROR, "Strips must have at least one row\n");
+                return OPJ_FALSE;
+        }
+
+        /* The strip decoder keeps the compressed data of a single tile */
+        if (p_j2k->m_cp.tw * p_j2k->m_cp.th != 1) {
+                opj_event_msg(p_manager, EVT_ERROR, "Only codestreams made of a single tile can be decoded by strips (%d tiles)\n", p_j2k->m_cp.tw * p_j2k->m_cp.th);
+                return OPJ_FALSE;
+        }
+
+        /* The components are decoded row by row together (the MCT mixes them) */
+        l_ref_comp = p_image->comps;
+        for (compno = 1; compno < p_image->numcomps; ++compno) {
+                opj_image_comp_t * l_comp = p_image->comps + compno;
+                if (l_comp->dx != l_ref_comp->dx || l_comp->dy != l_ref_comp->dy
+                                || l_comp->w != l_ref_comp->w || l_comp->h != l_ref_comp->h
+                                || l_comp->factor != l_ref_comp->factor) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Component %d does not have the size of the first component, it can not be decoded by strips\n", compno);
+                        return OPJ_FALSE;
+                }
+        }
+
+        p_j2k->m_specific_param.m_decoder.m_strip_fn = p_strip_fn;
+        p_j2k->m_specific_param.m_decoder.m_strip_user_data = p_user_data;
+        p_j2k->m_specific_param.m_decoder.m_strip_height = p_strip_height;
+        p_j2k->m_tcd->m_decode_by_strips = 1;
+
+        l_result = opj_j2k_decode(p_j2k, p_stream, p_image, p_manager);
+
+        p_j2k->m_specific_param.m_decoder.m_strip_fn = 00;
+        p_j2k->m_specific_param.m_decoder.m_strip_user_data = 00;
+        p_j2k->m_tcd->m_decode_by_strips = 0;
+
+        return l_result;
+}
+
 OPJ_BOOL opj_j2k_get_tile(      opj_j2k_t *p_j2k,
                                                     opj_stream_private_t *p_stream,
                                                     opj_image_t* p_image,
@@ -9654,6 +11808,10 @@ OPJ_BOOL opj_j2k_get_tile(      opj_j2k_t *p_j2k,
                 return OPJ_FALSE;
         }
 
+        if (! opj_j2k_remove_undecoded_components(p_j2k, p_image, p_manager)) {
+                return OPJ_FALSE;
+        }
+
         if ( /*(tile_index < 0) &&*/ (tile_index >= p_j2k->m_cp.tw * p_j2k->m_cp.th) ){
                 opj_event_msg(p_manager, EVT_ERROR, "Tile index provided by the user is incorrect %d (max = %d) \n", tile_index, (p_j2k->m_cp.tw * p_j2k->m_cp.th) - 1);
                 return OPJ_FALSE;
@@ -9771,6 +11929,7 @@ OPJ_BOOL opj_j2k_encode(opj_j2k_t * p_j2k,
         OPJ_UINT32 l_max_tile_size = 0, l_current_tile_size;
         OPJ_BYTE * l_current_data = 00;
         opj_tcd_t* p_tcd = 00;
+        opj_stage_clock_t l_clock;
 
         /* preconditions */
         assert(p_j2k != 00);
@@ -9797,6 +11956,7 @@ OPJ_BOOL opj_j2k_encode(opj_j2k_t * p_j2k,
 												        l_tilec->data  =  l_img_comp->data;
 												        l_tilec->ownsData = OPJ_FALSE;
                         } else {
+												        OPJ_UINT32 l_old_data_size = l_tilec->data_size;
 												        if(! opj_alloc_tile_component_data(l_tilec)) {
 												                opj_event_msg(p_manager, EVT_ERROR, "Error allocating tile component data." );
 												                if (l_current_data) {
@@ -9804,6 +11964,9 @@ OPJ_BOOL opj_j2k_encode(opj_j2k_t * p_j2k,
 												                }
 												                return OPJ_FALSE;
 												        }
+												        if (p_j2k->m_stats && l_tilec->data_size != l_old_data_size) {
+												                opj_codec_stats_count_alloc(p_j2k->m_stats, i, l_tilec->data_size);
+												        }
 												        opj_alloc_tile_component_data(l_tilec);
                         }
                 }
@@ -9822,6 +11985,10 @@ OPJ_BOOL opj_j2k_encode(opj_j2k_t * p_j2k,
 																l_max_tile_size = l_current_tile_size;
                         }
 
+                        if (p_j2k->m_stats) {
+                                opj_stage_clock_start(&l_clock);
+                        }
+
                         /* copy image data (32 bit) to l_current_data as contiguous, all-component, zero offset buffer */
                         /* 32 bit components @ 8 bit precision get converted to 8 bit */
                         /* 32 bit components @ 16 bit precision get converted to 16 bit */
@@ -9832,6 +11999,10 @@ OPJ_BOOL opj_j2k_encode(opj_j2k_t * p_j2k,
 																opj_event_msg(p_manager, EVT_ERROR, "Size mismatch between tile data and sent data." );
 																return OPJ_FALSE;
                         }
+
+                        if (p_j2k->m_stats) {
+                                opj_stage_clock_stop(&l_clock, p_j2k->m_stats, i, OPJ_STAGE_COPY, l_current_tile_size);
+                        }
                 }
 
                 if (! opj_j2k_post_write_tile (p_j2k,p_stream,p_manager)) {
@@ -9849,6 +12020,14 @@ OPJ_BOOL opj_j2k_end_compress(  opj_j2k_t *p_j2k,
                                                         opj_stream_private_t *p_stream,
                                                         opj_event_mgr_t * p_manager)
 {
+        opj_stage_clock_t l_clock;
+        OPJ_OFF_T l_start = 0;
+
+        if (p_j2k->m_stats) {
+                opj_stage_clock_start(&l_clock);
+                l_start = opj_stream_tell(p_stream);
+        }
+
         /* customization of the encoding */
         opj_j2k_setup_end_compress(p_j2k);
 
@@ -9857,6 +12036,11 @@ OPJ_BOOL opj_j2k_end_compress(  opj_j2k_t *p_j2k,
                 return OPJ_FALSE;
         }
 
+        if (p_j2k->m_stats) {
+                opj_stage_clock_stop(&l_clock, p_j2k->m_stats, p_j2k->m_stats->nb_tiles, OPJ_STAGE_HEADER,
+                                     (OPJ_UINT64)(opj_stream_tell(p_stream) - l_start));
+        }
+
         return OPJ_TRUE;
 }
 
@@ -9865,11 +12049,19 @@ OPJ_BOOL opj_j2k_start_compress(opj_j2k_t *p_j2k,
                                                             opj_image_t * p_image,
                                                             opj_event_mgr_t * p_manager)
 {
+        opj_stage_clock_t l_clock;
+        OPJ_OFF_T l_start = 0;
+
         /* preconditions */
         assert(p_j2k != 00);
         assert(p_stream != 00);
         assert(p_manager != 00);
 
+        if (p_j2k->m_stats) {
+                opj_stage_clock_start(&l_clock);
+                l_start = opj_stream_tell(p_stream);
+        }
+
         p_j2k->m_private_image = opj_image_create0();
         if (! p_j2k->m_private_image) {
                 opj_event_msg(p_manager, EVT_ERROR, "Failed to allocate image header." );
@@ -9905,6 +12097,12 @@ OPJ_BOOL opj_j2k_start_compress(opj_j2k_t *p_j2k,
                 return OPJ_FALSE;
         }
 
+        if (p_j2k->m_stats) {
+                /* the main header is not counted in any tile */
+                opj_stage_clock_stop(&l_clock, p_j2k->m_stats, p_j2k->m_stats->nb_tiles, OPJ_STAGE_HEADER,
+                                     (OPJ_UINT64)(opj_stream_tell(p_stream) - l_start));
+        }
+
         return OPJ_TRUE;
 }
 
@@ -10528,6 +12726,71 @@ static OPJ_BOOL opj_j2k_create_tcd(     opj_j2k_t *p_j2k,
                 return OPJ_FALSE;
         }
 
+        if (! opj_j2k_init_codec_stats(p_j2k)) {
+                opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to collect the codec statistics\n");
+                return OPJ_FALSE;
+        }
+
+        return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_write_strip (opj_j2k_t * p_j2k,
+                              OPJ_INT32 ** p_comps_data,
+                              OPJ_UINT32 p_nb_rows,
+                              opj_stream_private_t *p_stream,
+                              opj_event_mgr_t * p_manager )
+{
+        opj_image_t * l_image = p_j2k->m_private_image;
+        opj_tcd_tilecomp_t * l_tilec;
+        OPJ_UINT32 l_height;
+        OPJ_UINT32 compno;
+
+        if (p_j2k->m_specific_param.m_encoder.m_strip_rows == 0 && ! p_j2k->m_tcd->m_strip_encoder) {
+                if (p_j2k->m_cp.tw * p_j2k->m_cp.th != 1) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Encoding by strips needs an image made of a single tile\n");
+                        return OPJ_FALSE;
+                }
+                for (compno = 1; compno < l_image->numcomps; ++compno) {
+                        if (l_image->comps[compno].w != l_image->comps[0].w
+                                        || l_image->comps[compno].h != l_image->comps[0].h) {
+                                opj_event_msg(p_manager, EVT_ERROR, "Encoding by strips needs components of the same size\n");
+                                return OPJ_FALSE;
+                        }
+                }
+
+                if (! opj_j2k_pre_write_tile(p_j2k,0,p_stream,p_manager)) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Error while opj_j2k_pre_write_tile with tile index = 0\n");
+                        return OPJ_FALSE;
+                }
+                if (! opj_tcd_init_encode_strips(p_j2k->m_tcd, 0)) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to encode the tile by strips\n");
+                        return OPJ_FALSE;
+                }
+        }
+
+        l_tilec = p_j2k->m_tcd->tcd_image->tiles->comps;
+        l_height = (OPJ_UINT32)(l_tilec->y1 - l_tilec->y0);
+        if (! p_j2k->m_tcd->m_strip_encoder || p_nb_rows > l_height - p_j2k->m_specific_param.m_encoder.m_strip_rows) {
+                opj_event_msg(p_manager, EVT_ERROR, "More rows written than the %d rows of the image\n", l_height);
+                return OPJ_FALSE;
+        }
+
+        if (! opj_tcd_encode_strip(p_j2k->m_tcd, p_comps_data, p_nb_rows)) {
+                opj_event_msg(p_manager, EVT_ERROR, "Error while encoding rows %d to %d\n",
+                              p_j2k->m_specific_param.m_encoder.m_strip_rows,
+                              p_j2k->m_specific_param.m_encoder.m_strip_rows + p_nb_rows);
+                return OPJ_FALSE;
+        }
+        p_j2k->m_specific_param.m_encoder.m_strip_rows += p_nb_rows;
+
+        /* all the code-blocks are known : rate allocation and tier-2 */
+        if (p_j2k->m_specific_param.m_encoder.m_strip_rows == l_height) {
+                if (! opj_j2k_post_write_tile(p_j2k,p_stream,p_manager)) {
+                        opj_event_msg(p_manager, EVT_ERROR, "Error while opj_j2k_post_write_tile with tile index = 0\n");
+                        return OPJ_FALSE;
+                }
+        }
+
         return OPJ_TRUE;
 }
 
@@ -10538,6 +12801,8 @@ OPJ_BOOL opj_j2k_write_tile (opj_j2k_t * p_j2k,
                                                  opj_stream_private_t *p_stream,
                                                  opj_event_mgr_t * p_manager )
 {
+        opj_stage_clock_t l_clock;
+
         if (! opj_j2k_pre_write_tile(p_j2k,p_tile_index,p_stream,p_manager)) {
                 opj_event_msg(p_manager, EVT_ERROR, "Error while opj_j2k_pre_write_tile with tile index = %d\n", p_tile_index);
                 return OPJ_FALSE;
@@ -10547,18 +12812,28 @@ OPJ_BOOL opj_j2k_write_tile (opj_j2k_t * p_j2k,
                 /* Allocate data */
                 for (j=0;j<p_j2k->m_tcd->image->numcomps;++j) {
                         opj_tcd_tilecomp_t* l_tilec = p_j2k->m_tcd->tcd_image->tiles->comps + j;
+                        OPJ_UINT32 l_old_data_size = l_tilec->data_size;
 
                         if(! opj_alloc_tile_component_data(l_tilec)) {
 												        opj_event_msg(p_manager, EVT_ERROR, "Error allocating tile component data." );
                                 return OPJ_FALSE;
                         }
+                        if (p_j2k->m_stats && l_tilec->data_size != l_old_data_size) {
+                                opj_codec_stats_count_alloc(p_j2k->m_stats, p_tile_index, l_tilec->data_size);
+                        }
                 }
 
+                if (p_j2k->m_stats) {
+                        opj_stage_clock_start(&l_clock);
+                }
                 /* now copy data into the the tile component */
                 if (! opj_tcd_copy_tile_data(p_j2k->m_tcd,p_data,p_data_size)) {
                         opj_event_msg(p_manager, EVT_ERROR, "Size mismatch between tile data and sent data." );
                         return OPJ_FALSE;
                 }
+                if (p_j2k->m_stats) {
+                        opj_stage_clock_stop(&l_clock, p_j2k->m_stats, p_tile_index, OPJ_STAGE_COPY, p_data_size);
+                }
                 if (! opj_j2k_post_write_tile(p_j2k,p_stream,p_manager)) {
                         opj_event_msg(p_manager, EVT_ERROR, "Error while opj_j2k_post_write_tile with tile index = %d\n", p_tile_index);
                         return OPJ_FALSE;
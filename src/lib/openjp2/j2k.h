@@ -232,6 +232,20 @@ typedef struct opj_simple_mcc_decorrelation_data
 }
 opj_simple_mcc_decorrelation_data_t;
 
+/**
+ * Marker segment of packed packet headers (PPM or PPT), kept until all the marker
+ * segments of its header are read
+ */
+typedef struct opj_j2k_ppx
+{
+	/** index of the marker segment in its header (Zppm or Zppt) */
+	OPJ_UINT32 m_index;
+	/** position of the data of the marker segment in the buffer of the packed headers */
+	OPJ_UINT32 m_offset;
+	/** size of the data of the marker segment */
+	OPJ_UINT32 m_size;
+} opj_j2k_ppx_t;
+
 /**
 Tile coding parameters :
 this structure is used to store coding/decoding parameters common to all
@@ -258,10 +272,16 @@ typedef struct opj_tcp
 	OPJ_BYTE *ppt_data;
 	/** used to keep a track of the allocated memory */
 	OPJ_BYTE *ppt_buffer;
-	/** Number of bytes stored inside ppt_data*/
+	/** Number of bytes stored inside ppt_buffer*/
 	OPJ_UINT32 ppt_data_size;
 	/** size of ppt_data*/
 	OPJ_UINT32 ppt_len;
+	/** size of the memory allocated for ppt_buffer */
+	OPJ_UINT32 ppt_buffer_size;
+	/** PPT marker segments of the current tile-part header stored in ppt_buffer, merged when its data is reached */
+	opj_j2k_ppx_t *ppt_markers;
+	OPJ_UINT32 ppt_nb_markers;
+	OPJ_UINT32 ppt_max_markers;
 	/** add fixed_quality */
 	OPJ_FLOAT32 distoratio[100];
 	/** tile-component coding parameters */
@@ -272,6 +292,8 @@ typedef struct opj_tcp
 	OPJ_BYTE *		m_data;
 	/** size of data */
 	OPJ_UINT32		m_data_size;
+	/** size of the buffer allocated for the data */
+	OPJ_UINT32		m_data_max_size;
 	/** encoding norms */
 	OPJ_FLOAT64 *	mct_norms;
 	/** the mct decoding matrix */
@@ -297,6 +319,8 @@ typedef struct opj_tcp
 	OPJ_UINT32 ppt : 1;
 	/** indicates if a POC marker has been used O:NO, 1:YES */
 	OPJ_UINT32 POC : 1;
+	/** If shared == 1 --> tccps and the MCT matrix/records point to the ones of the default tcp (decoder only) */
+	OPJ_UINT32 shared : 1;
 } opj_tcp_t;
 
 
@@ -320,6 +344,8 @@ typedef struct opj_encoding_param
 	OPJ_UINT32 m_fixed_quality : 1;
 	/** Enabling Tile part generation*/
 	OPJ_UINT32 m_tp_on : 1;
+	/** Writing the packet lengths in PLT markers */
+	OPJ_UINT32 m_plt_on : 1;
 }
 opj_encoding_param_t;
 
@@ -329,6 +355,12 @@ typedef struct opj_decoding_param
 	OPJ_UINT32 m_reduce;
 	/** if != 0, then only the first "layer" layers are decoded; if == 0 or not used, all the quality layers are decoded */
 	OPJ_UINT32 m_layer;
+	/** number of components to decode; if == 0, all the components are decoded */
+	OPJ_UINT32 m_nb_comps_to_decode;
+	/** indices of the components to decode, sorted once the main header is read */
+	OPJ_UINT32 * m_comps_to_decode;
+	/** one byte per component of the image, != 0 if the component is decoded (00 if all are) */
+	OPJ_BYTE * m_decoded_comps;
 }
 opj_decoding_param_t;
 
@@ -361,21 +393,16 @@ typedef struct opj_cp
 	OPJ_BYTE *ppm_data;
 	/** size of the ppm_data*/
 	OPJ_UINT32 ppm_len;
-	/** size of the ppm_data*/
-	OPJ_UINT32 ppm_data_read;
-
-	OPJ_BYTE *ppm_data_current;
-
 	/** packet header storage original buffer */
 	OPJ_BYTE *ppm_buffer;
-	/** pointer remaining on the first byte of the first header if ppm is used */
-	OPJ_BYTE *ppm_data_first;
-	/** Number of bytes actually stored inside the ppm_data */
+	/** Number of bytes actually stored inside the ppm_buffer */
 	OPJ_UINT32 ppm_data_size;
-	/** use in case of multiple marker PPM (number of info already store) */
-	OPJ_INT32 ppm_store;
-	/** use in case of multiple marker PPM (case on non-finished previous info) */
-	OPJ_INT32 ppm_previous;
+	/** size of the memory allocated for ppm_buffer */
+	OPJ_UINT32 ppm_buffer_size;
+	/** PPM marker segments stored in ppm_buffer, merged at the end of the main header */
+	opj_j2k_ppx_t *ppm_markers;
+	OPJ_UINT32 ppm_nb_markers;
+	OPJ_UINT32 ppm_max_markers;
 
 	/** tile coding parameters */
 	opj_tcp_t *tcps;
@@ -441,6 +468,35 @@ typedef struct opj_cp
 } opj_cp_t;
 
 
+/**
+ * Tile-part described by a TLM marker
+ */
+typedef struct opj_j2k_tlm_info
+{
+	/** tile the tile-part belongs to */
+	OPJ_UINT32 m_tile_no;
+	/** length of the tile-part, from the first byte of its SOT marker */
+	OPJ_UINT32 m_length;
+} opj_j2k_tlm_info_t;
+
+/**
+ * Palette mapping the samples of a component to the channels of an interleaved output buffer
+ * (see opj_j2k_decode_palette_to_buffer)
+ */
+typedef struct opj_j2k_palette
+{
+	/** m_nb_channels values per entry */
+	const OPJ_UINT32 * m_entries;
+	OPJ_UINT32 m_nb_entries;
+	OPJ_UINT32 m_nb_channels;
+	/** precision of each channel */
+	const OPJ_BYTE * m_prec;
+	/** signedness of each channel */
+	const OPJ_BYTE * m_sgnd;
+	/** component holding the palette indices */
+	OPJ_UINT32 m_compno;
+} opj_j2k_palette_t;
+
 typedef struct opj_j2k_dec
 {
 	/** locate in which part of the codestream the decoder is (main header, tile header, end) */
@@ -477,10 +533,74 @@ typedef struct opj_j2k_dec
 	 * SOD reader function. FIXME NOT USED for the moment
 	 */
 	OPJ_BOOL   m_last_tile_part;
+
+	/** Caller-provided interleaved buffer the tiles are written to (see opj_j2k_decode_to_buffer), 00 when decoding into image planes */
+	OPJ_BYTE * m_output_buffer;
+	/** number of bytes between two lines of m_output_buffer */
+	OPJ_UINT32 m_output_buffer_stride;
+	/** layout of the samples in m_output_buffer */
+	OPJ_PIXEL_FORMAT m_output_buffer_format;
+	/** pixels written to m_output_buffer for each palette index, 00 when the samples are written */
+	OPJ_BYTE * m_output_palette_pixels;
+	/** number of entries of m_output_palette_pixels */
+	OPJ_UINT32 m_output_palette_size;
+	/** component holding the palette indices */
+	OPJ_UINT32 m_output_palette_comp;
+
+	/** Function the decoded strips are handed to (see opj_j2k_decode_strips), 00 when decoding into image planes */
+	opj_strip_decode_fn m_strip_fn;
+	/** user data given to m_strip_fn */
+	void * m_strip_user_data;
+	/** number of rows of each strip */
+	OPJ_UINT32 m_strip_height;
+
+	/** tile-parts read from the TLM markers, in codestream order */
+	opj_j2k_tlm_info_t * m_tlm;
+	OPJ_UINT32 m_nb_tlm;
+	OPJ_UINT32 m_max_tlm;
+	/** number of TLM markers read, to check their Ztlm */
+	OPJ_UINT32 m_nb_tlm_markers;
+	/** packet lengths read from the PLM markers, in codestream order */
+	OPJ_UINT32 * m_plm_lengths;
+	OPJ_UINT32 m_nb_plm_lengths;
+	OPJ_UINT32 m_max_plm_lengths;
+	/** number of packets of each tile-part in m_plm_lengths, in codestream order */
+	OPJ_UINT32 * m_plm_tp_nb_packets;
+	OPJ_UINT32 m_nb_plm_tps;
+	OPJ_UINT32 m_max_plm_tps;
+	/** number of PLM markers read, to check their Zplm */
+	OPJ_UINT32 m_nb_plm_markers;
+	/** number of tile-parts met so far in codestream order, to match them with the PLM markers */
+	OPJ_UINT32 m_nb_tile_parts_read;
+	/** number of packet lengths of m_plm_lengths given to these tile-parts */
+	OPJ_UINT32 m_nb_plm_lengths_read;
+
+	/** length of the stream holding the codestream, 0 if unknown */
+	OPJ_OFF_T m_stream_length;
+	/** checksum of the main header marker segments */
+	OPJ_UINT32 m_header_checksum;
+	/** codestream described by the index file loaded by opj_j2k_load_cstr_index, to check that it is the one read */
+	OPJ_OFF_T m_index_stream_length;
+	OPJ_OFF_T m_index_main_head_start;
+	OPJ_OFF_T m_index_main_head_end;
+	OPJ_UINT32 m_index_header_checksum;
+	OPJ_UINT32 m_index_nb_tiles;
+
 	/** to tell that a tile can be decoded. */
 	OPJ_UINT32 m_can_decode			: 1;
 	OPJ_UINT32 m_discard_tiles		: 1;
 	OPJ_UINT32 m_skip_data			: 1;
+	/** the tile-part positions of the codestream index come from the TLM markers */
+	OPJ_UINT32 m_tlm_index			: 1;
+	/** tile-parts may have been reached from the TLM markers, the ones before m_last_sot_read_pos are not all read */
+	OPJ_UINT32 m_tlm_seeks			: 1;
+	/** the TLM (or PLM) markers are not usable */
+	OPJ_UINT32 m_tlm_invalid		: 1;
+	OPJ_UINT32 m_plm_invalid		: 1;
+	/** the PLT markers of the current tile-part header are to be added to the codestream index */
+	OPJ_UINT32 m_record_plt			: 1;
+	/** the tile-parts and packets of m_tlm and m_plm_lengths come from an index file, not from TLM and PLM markers */
+	OPJ_UINT32 m_index_file			: 1;
 
 } opj_j2k_dec_t;
 
@@ -522,6 +642,8 @@ typedef struct opj_j2k_enc
 	/* size of the encoded_data */
 	OPJ_UINT32 m_header_tile_data_size;
 
+	/** number of rows already given to opj_j2k_write_strip */
+	OPJ_UINT32 m_strip_rows;
 
 } opj_j2k_enc_t;
 
@@ -568,6 +690,9 @@ typedef struct opj_j2k
 	/** the current tile coder/decoder **/
 	struct opj_tcd *	m_tcd;
 
+	/** statistics collected on the stages of the pipeline, 00 if they are not collected */
+	opj_codec_stats_t * m_stats;
+
 }
 opj_j2k_t;
 
@@ -583,8 +708,9 @@ Setup the decoder decoding parameters using user parameters.
 Decoding parameters are returned in j2k->cp. 
 @param j2k J2K decompressor handle
 @param parameters decompression parameters
+@return true if the parameters could be stored
 */
-void opj_j2k_setup_decoder(opj_j2k_t *j2k, opj_dparameters_t *parameters);
+OPJ_BOOL opj_j2k_setup_decoder(opj_j2k_t *j2k, opj_dparameters_t *parameters);
 
 /**
  * Creates a J2K compression structure
@@ -633,6 +759,19 @@ OPJ_BOOL opj_j2k_read_header(	opj_stream_private_t *p_stream,
                                 opj_event_mgr_t* p_manager );
 
 
+/**
+ * Reads the SIZ, COD and QCD markers of a main header held in memory, without a codec.
+ *
+ * @param p_buffer      the codestream, starting with its SOC marker.
+ * @param p_buffer_size the number of bytes in p_buffer.
+ * @param p_info        the structure to fill with the image and default coding parameters.
+ *
+ * @return true if the three markers have been found and are valid.
+ */
+OPJ_BOOL opj_j2k_probe_header(  const OPJ_BYTE * p_buffer,
+                                OPJ_SIZE_T p_buffer_size,
+                                opj_probe_info_t * p_info );
+
 /**
  * Destroys a jpeg2000 codec.
  *
@@ -765,6 +904,59 @@ opj_codestream_info_v2_t* j2k_get_cstr_info(opj_j2k_t* p_j2k);
  */
 opj_codestream_index_t* j2k_get_cstr_index(opj_j2k_t* p_j2k);
 
+/**
+ * Saves the tile-parts and packets of the codestream index to an index file, the whole codestream being read.
+ *
+ * @param	p_j2k			the jpeg2000 codec.
+ * @param	p_index_stream	the stream to write the index file to.
+ * @param	p_stamp			value identifying the file of the codestream, written in the index file.
+ * @param	p_manager		the user event manager.
+ *
+ * @return	true if the index file has been written.
+ */
+OPJ_BOOL opj_j2k_save_cstr_index(	opj_j2k_t *p_j2k,
+									opj_stream_private_t *p_index_stream,
+									OPJ_UINT64 p_stamp,
+									opj_event_mgr_t * p_manager );
+
+/**
+ * Loads an index file written by opj_j2k_save_cstr_index, before the main header is read.
+ * The tile-parts and packets it gives are then used as the ones of TLM and PLM markers.
+ *
+ * @param	p_j2k			the jpeg2000 codec.
+ * @param	p_index_stream	the stream to read the index file from.
+ * @param	p_stamp			value identifying the file of the codestream, checked against the index file.
+ * @param	p_manager		the user event manager.
+ *
+ * @return	true if the index file is usable.
+ */
+OPJ_BOOL opj_j2k_load_cstr_index(	opj_j2k_t *p_j2k,
+									opj_stream_private_t *p_index_stream,
+									OPJ_UINT64 p_stamp,
+									opj_event_mgr_t * p_manager );
+
+/**
+ * Enables or disables the collection of the codec statistics, enabling resets them.
+ *
+ * @param	p_j2k			the jpeg2000 codec.
+ * @param	p_enable		OPJ_TRUE to collect the statistics.
+ * @param	p_manager		the user event manager.
+ *
+ * @return	true if the statistics could be enabled or disabled.
+ */
+OPJ_BOOL opj_j2k_set_codec_stats(	opj_j2k_t *p_j2k,
+									OPJ_BOOL p_enable,
+									opj_event_mgr_t * p_manager );
+
+/**
+ * Gets a copy of the codec statistics.
+ *
+ * @param	p_j2k			the jpeg2000 codec.
+ *
+ * @return	the statistics, 00 if they are not collected or on memory error.
+ */
+opj_codec_stats_t* opj_j2k_get_codec_stats(opj_j2k_t *p_j2k);
+
 /**
  * Decode an image from a JPEG-2000 codestream
  * @param j2k J2K decompressor handle
@@ -778,6 +970,73 @@ OPJ_BOOL opj_j2k_decode(opj_j2k_t *j2k,
                         opj_image_t *p_image,
                         opj_event_mgr_t *p_manager);
 
+/**
+ * Decode an image from a JPEG-2000 codestream into a caller-provided interleaved buffer.
+ * Decoded tiles are written straight into the buffer, no component plane is allocated.
+ *
+ * @param p_j2k     J2K decompressor handle
+ * @param p_stream  the stream to read data from.
+ * @param p_image   the decoded area (image header, comps[].data stay NULL)
+ * @param p_buffer  output buffer of at least p_image->comps[0].h * p_stride bytes
+ * @param p_stride  number of bytes between two lines of p_buffer
+ * @param p_format  layout of the samples in p_buffer
+ * @param p_manager the user event manager.
+ * @return OPJ_TRUE if successful, OPJ_FALSE otherwise
+*/
+OPJ_BOOL opj_j2k_decode_to_buffer(opj_j2k_t *p_j2k,
+                                  opj_stream_private_t *p_stream,
+                                  opj_image_t *p_image,
+                                  OPJ_BYTE *p_buffer,
+                                  OPJ_UINT32 p_stride,
+                                  OPJ_PIXEL_FORMAT p_format,
+                                  opj_event_mgr_t *p_manager);
+
+/**
+ * Decode an image from a JPEG-2000 codestream into a caller-provided 8 bit interleaved buffer,
+ * through a palette. Each pixel is looked up in a table of the palette converted to the buffer
+ * layout, the component holding the indices is read once and no channel plane is allocated.
+ *
+ * @param p_j2k     J2K decompressor handle
+ * @param p_stream  the stream to read data from.
+ * @param p_image   the decoded area (image header, comps[].data stay NULL)
+ * @param p_buffer  output buffer of at least p_image->comps[0].h * p_stride bytes
+ * @param p_stride  number of bytes between two lines of p_buffer
+ * @param p_format  layout of the samples in p_buffer, 8 bit formats only
+ * @param p_palette the palette, its channels are mapped to the buffer as the components of an image
+ * @param p_manager the user event manager.
+ * @return OPJ_TRUE if successful, OPJ_FALSE otherwise
+*/
+OPJ_BOOL opj_j2k_decode_palette_to_buffer(opj_j2k_t *p_j2k,
+                                          opj_stream_private_t *p_stream,
+                                          opj_image_t *p_image,
+                                          OPJ_BYTE *p_buffer,
+                                          OPJ_UINT32 p_stride,
+                                          OPJ_PIXEL_FORMAT p_format,
+                                          const opj_j2k_palette_t *p_palette,
+                                          opj_event_mgr_t *p_manager);
+
+/**
+ * Decode an image from a JPEG-2000 codestream strip by strip.
+ * The inverse transforms run on strips of rows and each strip is handed to p_strip_fn,
+ * no component plane is allocated. The codestream must be made of a single tile.
+ *
+ * @param p_j2k     J2K decompressor handle
+ * @param p_stream  the stream to read data from.
+ * @param p_image   the decoded area (image header, comps[].data stay NULL)
+ * @param p_strip_height number of rows of each strip
+ * @param p_strip_fn function called with the samples of each strip
+ * @param p_user_data user data given to p_strip_fn
+ * @param p_manager the user event manager.
+ * @return OPJ_TRUE if successful, OPJ_FALSE otherwise
+*/
+OPJ_BOOL opj_j2k_decode_strips(opj_j2k_t *p_j2k,
+                               opj_stream_private_t *p_stream,
+                               opj_image_t *p_image,
+                               OPJ_UINT32 p_strip_height,
+                               opj_strip_decode_fn p_strip_fn,
+                               void * p_user_data,
+                               opj_event_mgr_t *p_manager);
+
 
 OPJ_BOOL opj_j2k_get_tile(	opj_j2k_t *p_j2k,
 			    			opj_stream_private_t *p_stream,
@@ -789,6 +1048,21 @@ OPJ_BOOL opj_j2k_set_decoded_resolution_factor(opj_j2k_t *p_j2k,
                                                OPJ_UINT32 res_factor,
                                                opj_event_mgr_t * p_manager);
 
+/**
+ * Sets the components to decode, once the main header is read.
+ *
+ * @param p_j2k             the jpeg2000 codec.
+ * @param p_numcomps        number of components to decode, 0 to decode all of them.
+ * @param p_comps_indices   indices of the components to decode.
+ * @param p_manager         the user event manager.
+ *
+ * @return true if the components are in the image.
+ */
+OPJ_BOOL opj_j2k_set_decoded_components(opj_j2k_t *p_j2k,
+                                        OPJ_UINT32 p_numcomps,
+                                        const OPJ_UINT32 * p_comps_indices,
+                                        opj_event_mgr_t * p_manager);
+
 
 /**
  * Writes a tile.
@@ -806,6 +1080,22 @@ OPJ_BOOL opj_j2k_write_tile (	opj_j2k_t * p_j2k,
 							    opj_stream_private_t *p_stream,
 							    opj_event_mgr_t * p_manager );
 
+/**
+ * Writes the next rows of the image. The image must be made of a single tile and its components must have
+ * the same size; the code-blocks are encoded as soon as their rows are known and the tile is written to the
+ * stream with the last rows, so only the compressed data of the tile is kept.
+ * @param	p_j2k		the jpeg2000 codec.
+ * @param	p_comps_data	rows of each component, p_nb_rows * comps[].w samples each
+ * @param	p_nb_rows	number of rows
+ * @param	p_stream	the stream to write data to.
+ * @param	p_manager	the user event manager.
+ */
+OPJ_BOOL opj_j2k_write_strip (	opj_j2k_t * p_j2k,
+							    OPJ_INT32 ** p_comps_data,
+							    OPJ_UINT32 p_nb_rows,
+							    opj_stream_private_t *p_stream,
+							    opj_event_mgr_t * p_manager );
+
 /**
  * Encodes an image into a JPEG-2000 codestream
  */
@@ -108,6 +108,25 @@ static OPJ_BOOL opj_jp2_read_cdef(	opj_jp2_t * jp2,
 
 static void opj_jp2_apply_cdef(opj_image_t *image, opj_jp2_color_t *color);
 
+/**
+ * Sets the color space and ICC profile of an image decoded without its component planes.
+ *
+ * @param jp2     JP2 decompressor handle
+ * @param p_image the decoded image header
+*/
+static void opj_jp2_set_image_color_info(opj_jp2_t *jp2, opj_image_t* p_image);
+
+/**
+ * Gets the palette of an image decoded into an interleaved buffer. All the channels must be
+ * looked up in the palette from the same component, in the order of the channel definitions.
+ *
+ * @param jp2       JP2 decompressor handle
+ * @param p_image   the image header
+ * @param p_palette the palette given to opj_j2k_decode_palette_to_buffer
+ * @param p_manager the user event manager
+*/
+static OPJ_BOOL opj_jp2_get_buffer_palette(opj_jp2_t *jp2, opj_image_t* p_image, opj_j2k_palette_t *p_palette, opj_event_mgr_t * p_manager);
+
 /**
  * Writes the Channel Definition box.
  *
@@ -432,6 +451,23 @@ static OPJ_BOOL opj_jp2_read_boxhdr_char(   opj_jp2_box_t *box,
                                             OPJ_UINT32 p_box_max_size,
                                             opj_event_mgr_t * p_manager );
 
+/**
+ * Reads a box header from a buffer, for opj_jp2_probe_header.
+ *
+ * @param	p_data					the buffer to read the box from.
+ * @param	p_data_size				the number of bytes in p_data.
+ * @param	p_type					the type of the box.
+ * @param	p_header_size			the size of the box header, 8 or 16 bytes.
+ * @param	p_box_size				the size of the box, header included, or 0 if it extends to the end of the file.
+ *
+ * @return	true if the box header is valid.
+*/
+static OPJ_BOOL opj_jp2_probe_box(	const OPJ_BYTE * p_data,
+									OPJ_SIZE_T p_data_size,
+									OPJ_UINT32 * p_type,
+									OPJ_UINT32 * p_header_size,
+									OPJ_UINT64 * p_box_size );
+
 /**
  * Sets up the validation ,i.e. adds the procedures to lauch to make sure the codec parameters
  * are valid. Developpers wanting to extend the library can add their own validation procedures.
@@ -925,7 +961,7 @@ void opj_jp2_apply_pclr(opj_image_t *image, opj_jp2_color_t *color)
 	opj_jp2_cmap_comp_t *cmap;
 	OPJ_INT32 *src, *dst;
 	OPJ_UINT32 j, max;
-	OPJ_UINT16 i, nr_channels, cmp, pcol;
+	OPJ_UINT16 i, l, nr_channels, cmp, pcol;
 	OPJ_INT32 k, top_k;
 
 	channel_size = color->jp2_pclr->channel_size;
@@ -954,15 +990,21 @@ void opj_jp2_apply_pclr(opj_image_t *image, opj_jp2_color_t *color)
       new_comps[pcol] = old_comps[cmp];
     }
 
-		/* Palette mapping: */
-		new_comps[i].data = (OPJ_INT32*)
-				opj_malloc(old_comps[cmp].w * old_comps[cmp].h * sizeof(OPJ_INT32));
-		if (!new_comps[i].data) {
-			opj_free(new_comps);
-			new_comps = NULL;
-			/* FIXME no error code for opj_jp2_apply_pclr */
-			/* FIXME event manager error callback */
-			return;
+		/* Palette mapping: the image only describes the channels when it has been decoded without
+		 * its component planes (see opj_jp2_decode_to_buffer) */
+		if (!old_comps[cmp].data) {
+			new_comps[i].data = NULL;
+		}
+		else {
+			new_comps[i].data = (OPJ_INT32*)
+					opj_malloc(old_comps[cmp].w * old_comps[cmp].h * sizeof(OPJ_INT32));
+			if (!new_comps[i].data) {
+				opj_free(new_comps);
+				new_comps = NULL;
+				/* FIXME no error code for opj_jp2_apply_pclr */
+				/* FIXME event manager error callback */
+				return;
+			}
 		}
 		new_comps[i].prec = channel_size[i];
 		new_comps[i].sgnd = channel_sign[i];
@@ -971,10 +1013,11 @@ void opj_jp2_apply_pclr(opj_image_t *image, opj_jp2_color_t *color)
 	top_k = color->jp2_pclr->nr_entries - 1;
 
 	for(i = 0; i < nr_channels; ++i) {
-		/* Palette mapping: */
 		cmp = cmap[i].cmp; pcol = cmap[i].pcol;
 		src = old_comps[cmp].data;
-    assert( src );
+		if (!src) {
+			continue;
+		}
 		max = new_comps[pcol].w * new_comps[pcol].h;
 
 		/* Direct use: */
@@ -985,19 +1028,31 @@ void opj_jp2_apply_pclr(opj_image_t *image, opj_jp2_color_t *color)
       for(j = 0; j < max; ++j) {
         dst[j] = src[j];
       }
+      continue;
     }
-    else {
-      assert( i == pcol );
-      dst = new_comps[pcol].data;
-      assert( dst );
-      for(j = 0; j < max; ++j) {
-        /* The index */
-        if((k = src[j]) < 0) k = 0; else if(k > top_k) k = top_k;
 
-        /* The colour */
-        dst[j] = (OPJ_INT32)entries[k * nr_channels + pcol];
-        }
-    }
+		/* Palette mapping: the channels of the same component are filled in a single pass
+		 * over its indices, by the first of them */
+		for(l = 0; l < i; ++l) {
+			if(cmap[l].mtyp != 0 && cmap[l].cmp == cmp) break;
+		}
+		if(l < i) {
+			continue;
+		}
+		for(j = 0; j < max; ++j) {
+			const OPJ_UINT32 *entry;
+
+			/* The index */
+			if((k = src[j]) < 0) k = 0; else if(k > top_k) k = top_k;
+			entry = entries + k * nr_channels;
+
+			/* The colour */
+			for(l = i; l < nr_channels; ++l) {
+				if(cmap[l].mtyp != 0 && cmap[l].cmp == cmp) {
+					new_comps[l].data[j] = (OPJ_INT32)entry[l];
+				}
+			}
+		}
 	}
 
 	max = image->numcomps;
@@ -1399,8 +1454,11 @@ OPJ_BOOL opj_jp2_decode(opj_jp2_t *jp2,
                         opj_image_t* p_image,
                         opj_event_mgr_t * p_manager)
 {
+	OPJ_UINT32 l_numcomps;
+
 	if (!p_image)
 		return OPJ_FALSE;
+	l_numcomps = p_image->numcomps;
 
 	/* J2K decoding */
 	if( ! opj_j2k_decode(jp2->j2k, p_stream, p_image, p_manager) ) {
@@ -1408,6 +1466,12 @@ OPJ_BOOL opj_jp2_decode(opj_jp2_t *jp2,
 		return OPJ_FALSE;
 	}
 
+	/* The palette, channel definitions and colour specification refer to all the components
+	 * of the codestream, they are not applied when only some of them are decoded */
+	if (p_image->numcomps != l_numcomps) {
+		return OPJ_TRUE;
+	}
+
     if (!jp2->ignore_pclr_cmap_cdef){
 	    if (!opj_jp2_check_color(p_image, &(jp2->color), p_manager)) {
 		    return OPJ_FALSE;
@@ -1448,6 +1512,145 @@ OPJ_BOOL opj_jp2_decode(opj_jp2_t *jp2,
 	return OPJ_TRUE;
 }
 
+OPJ_BOOL opj_jp2_decode_to_buffer(opj_jp2_t *jp2,
+                                  opj_stream_private_t *p_stream,
+                                  opj_image_t* p_image,
+                                  OPJ_BYTE * p_buffer,
+                                  OPJ_UINT32 p_stride,
+                                  OPJ_PIXEL_FORMAT p_format,
+                                  opj_event_mgr_t * p_manager)
+{
+	OPJ_UINT32 l_numcomps;
+	OPJ_BOOL l_use_pclr;
+	OPJ_BOOL l_result;
+
+	if (!p_image)
+		return OPJ_FALSE;
+	l_numcomps = p_image->numcomps;
+	l_use_pclr = !jp2->ignore_pclr_cmap_cdef && jp2->color.jp2_pclr && jp2->color.jp2_pclr->cmap;
+
+	/* J2K decoding, the palette indices are expanded straight into the buffer */
+	if (l_use_pclr) {
+		opj_j2k_palette_t l_palette;
+
+		if (!opj_jp2_get_buffer_palette(jp2, p_image, &l_palette, p_manager)) {
+			return OPJ_FALSE;
+		}
+		l_result = opj_j2k_decode_palette_to_buffer(jp2->j2k, p_stream, p_image, p_buffer, p_stride, p_format, &l_palette, p_manager);
+	}
+	else {
+		l_result = opj_j2k_decode_to_buffer(jp2->j2k, p_stream, p_image, p_buffer, p_stride, p_format, p_manager);
+	}
+	if( ! l_result ) {
+		opj_event_msg(p_manager, EVT_ERROR, "Failed to decode the codestream in the JP2 file\n");
+		return OPJ_FALSE;
+	}
+
+	if (p_image->numcomps == l_numcomps) {
+		/* the image header describes the channels of the palette */
+		if (l_use_pclr) {
+			opj_jp2_apply_pclr(p_image, &(jp2->color));
+			if (jp2->color.jp2_cdef) {
+				opj_jp2_apply_cdef(p_image, &(jp2->color));
+			}
+		}
+		opj_jp2_set_image_color_info(jp2, p_image);
+	}
+
+	return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_jp2_decode_strips(opj_jp2_t *jp2,
+                               opj_stream_private_t *p_stream,
+                               opj_image_t* p_image,
+                               OPJ_UINT32 p_strip_height,
+                               opj_strip_decode_fn p_strip_fn,
+                               void * p_user_data,
+                               opj_event_mgr_t * p_manager)
+{
+	OPJ_UINT32 l_numcomps;
+
+	if (!p_image)
+		return OPJ_FALSE;
+	l_numcomps = p_image->numcomps;
+
+	/* The palette maps one component to several channels, which needs the component planes */
+	if (!jp2->ignore_pclr_cmap_cdef && jp2->color.jp2_pclr && jp2->color.jp2_pclr->cmap) {
+		opj_event_msg(p_manager, EVT_ERROR, "Palette images can not be decoded by strips\n");
+		return OPJ_FALSE;
+	}
+
+	/* J2K decoding */
+	if( ! opj_j2k_decode_strips(jp2->j2k, p_stream, p_image, p_strip_height, p_strip_fn, p_user_data, p_manager) ) {
+		opj_event_msg(p_manager, EVT_ERROR, "Failed to decode the codestream in the JP2 file\n");
+		return OPJ_FALSE;
+	}
+
+	if (p_image->numcomps == l_numcomps) {
+		opj_jp2_set_image_color_info(jp2, p_image);
+	}
+
+	return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_jp2_get_buffer_palette(opj_jp2_t *jp2, opj_image_t* p_image, opj_j2k_palette_t *p_palette, opj_event_mgr_t * p_manager)
+{
+	opj_jp2_pclr_t *l_pclr = jp2->color.jp2_pclr;
+	OPJ_UINT16 i;
+
+	if (!opj_jp2_check_color(p_image, &(jp2->color), p_manager)) {
+		return OPJ_FALSE;
+	}
+
+	for (i = 0; i < l_pclr->nr_channels; ++i) {
+		if (l_pclr->cmap[i].mtyp != 1 || l_pclr->cmap[i].cmp != l_pclr->cmap[0].cmp) {
+			opj_event_msg(p_manager, EVT_ERROR, "Palette channels which are not mapped from a single component can not be decoded into an interleaved buffer\n");
+			return OPJ_FALSE;
+		}
+	}
+	if (jp2->color.jp2_cdef) {
+		opj_jp2_cdef_info_t *info = jp2->color.jp2_cdef->info;
+		for (i = 0; i < jp2->color.jp2_cdef->n; ++i) {
+			if (info[i].typ == 0 && info[i].asoc != 0 && info[i].asoc != 65535 && info[i].asoc - 1 != info[i].cn) {
+				opj_event_msg(p_manager, EVT_ERROR, "Reordered palette channels can not be decoded into an interleaved buffer\n");
+				return OPJ_FALSE;
+			}
+		}
+	}
+
+	p_palette->m_entries = l_pclr->entries;
+	p_palette->m_nb_entries = l_pclr->nr_entries;
+	p_palette->m_nb_channels = l_pclr->nr_channels;
+	p_palette->m_prec = l_pclr->channel_size;
+	p_palette->m_sgnd = l_pclr->channel_sign;
+	p_palette->m_compno = l_pclr->cmap[0].cmp;
+
+	return OPJ_TRUE;
+}
+
+static void opj_jp2_set_image_color_info(opj_jp2_t *jp2, opj_image_t* p_image)
+{
+	if (!jp2->ignore_pclr_cmap_cdef){
+		/* Set Image Color Space */
+		if (jp2->enumcs == 16)
+			p_image->color_space = OPJ_CLRSPC_SRGB;
+		else if (jp2->enumcs == 17)
+			p_image->color_space = OPJ_CLRSPC_GRAY;
+		else if (jp2->enumcs == 18)
+			p_image->color_space = OPJ_CLRSPC_SYCC;
+		else if (jp2->enumcs == 24)
+			p_image->color_space = OPJ_CLRSPC_EYCC;
+		else
+			p_image->color_space = OPJ_CLRSPC_UNKNOWN;
+
+		if(jp2->color.icc_profile_buf) {
+			p_image->icc_profile_buf = jp2->color.icc_profile_buf;
+			p_image->icc_profile_len = jp2->color.icc_profile_len;
+			jp2->color.icc_profile_buf = NULL;
+		}
+	}
+}
+
 OPJ_BOOL opj_jp2_write_jp2h(opj_jp2_t *jp2,
                             opj_stream_private_t *stream,
                             opj_event_mgr_t * p_manager
@@ -1668,14 +1871,18 @@ OPJ_BOOL opj_jp2_write_jp(	opj_jp2_t *jp2,
 /* JP2 decoder interface                                             */
 /* ----------------------------------------------------------------------- */
 
-void opj_jp2_setup_decoder(opj_jp2_t *jp2, opj_dparameters_t *parameters)
+OPJ_BOOL opj_jp2_setup_decoder(opj_jp2_t *jp2, opj_dparameters_t *parameters)
 {
 	/* setup the J2K codec */
-	opj_j2k_setup_decoder(jp2->j2k, parameters);
+	if (! opj_j2k_setup_decoder(jp2->j2k, parameters)) {
+		return OPJ_FALSE;
+	}
 
 	/* further JP2 initializations go here */
 	jp2->color.jp2_has_colr = 0;
     jp2->ignore_pclr_cmap_cdef = parameters->flags & OPJ_DPARAMETERS_IGNORE_PCLR_CMAP_CDEF_FLAG;
+
+	return OPJ_TRUE;
 }
 
 /* ----------------------------------------------------------------------- */
@@ -2515,6 +2722,139 @@ OPJ_BOOL opj_jp2_read_header(	opj_stream_private_t *p_stream,
 							p_manager);
 }
 
+OPJ_BOOL opj_jp2_probe_box(	const OPJ_BYTE * p_data,
+							OPJ_SIZE_T p_data_size,
+							OPJ_UINT32 * p_type,
+							OPJ_UINT32 * p_header_size,
+							OPJ_UINT64 * p_box_size )
+{
+	OPJ_UINT32 l_value;
+
+	if (p_data_size < 8) {
+		return OPJ_FALSE;
+	}
+	opj_read_bytes(p_data, &l_value, 4);		/* LBox */
+	opj_read_bytes(p_data + 4, p_type, 4);		/* TBox */
+	*p_header_size = 8;
+	*p_box_size = l_value;
+
+	if (l_value == 1) {
+		if (p_data_size < 16) {
+			return OPJ_FALSE;
+		}
+		opj_read_bytes(p_data + 8, &l_value, 4);	/* XLBox */
+		*p_box_size = (OPJ_UINT64)l_value << 32;
+		opj_read_bytes(p_data + 12, &l_value, 4);
+		*p_box_size |= l_value;
+		*p_header_size = 16;
+	}
+	else if (l_value == 0) {
+		return OPJ_TRUE;
+	}
+
+	return *p_box_size >= *p_header_size;
+}
+
+OPJ_BOOL opj_jp2_probe_header(	const OPJ_BYTE * p_buffer,
+								OPJ_SIZE_T p_buffer_size,
+								opj_probe_info_t * p_info )
+{
+	OPJ_SIZE_T l_pos = 0, l_sub_pos, l_size;
+	OPJ_UINT32 l_type, l_header_size, l_value;
+	OPJ_UINT64 l_box_size;
+	OPJ_BOOL l_has_jp2h = OPJ_FALSE, l_has_colr = OPJ_FALSE;
+
+	/* preconditions */
+	assert(p_buffer != 00);
+	assert(p_info != 00);
+
+	/* JPEG 2000 signature box */
+	if (! opj_jp2_probe_box(p_buffer, p_buffer_size, &l_type, &l_header_size, &l_box_size)
+		|| (l_type != JP2_JP) || (l_box_size != 12)) {
+		return OPJ_FALSE;
+	}
+	opj_read_bytes(p_buffer + 8, &l_value, 4);
+	if (l_value != 0x0d0a870a) {
+		return OPJ_FALSE;
+	}
+	l_pos = 12;
+
+	while (opj_jp2_probe_box(p_buffer + l_pos, p_buffer_size - l_pos, &l_type, &l_header_size, &l_box_size)) {
+		/* bytes of the box in the buffer, the contiguous codestream box may be incomplete */
+		l_size = p_buffer_size - l_pos;
+		if ((l_box_size != 0) && (l_box_size <= l_size)) {
+			l_size = (OPJ_SIZE_T)l_box_size;
+		}
+		else if (l_type != JP2_JP2C) {
+			return OPJ_FALSE;
+		}
+
+		if (l_type == JP2_JP2H) {
+			/* iterate over the boxes of the JP2 header */
+			l_sub_pos = l_pos + l_header_size;
+			while (l_sub_pos < l_pos + l_size) {
+				OPJ_UINT32 l_sub_type, l_sub_header_size;
+				OPJ_UINT64 l_sub_box_size;
+				const OPJ_BYTE * l_data;
+
+				if (! opj_jp2_probe_box(p_buffer + l_sub_pos, l_pos + l_size - l_sub_pos, &l_sub_type, &l_sub_header_size, &l_sub_box_size)
+					|| (l_sub_box_size == 0) || (l_sub_box_size > l_pos + l_size - l_sub_pos)) {
+					return OPJ_FALSE;
+				}
+				l_data = p_buffer + l_sub_pos + l_sub_header_size;
+
+				/* Part 1, I.5.3.3 : only the first colour specification box is taken into account */
+				if ((l_sub_type == JP2_COLR) && ! l_has_colr) {
+					if (l_sub_box_size < l_sub_header_size + 3) {
+						return OPJ_FALSE;
+					}
+					opj_read_bytes(l_data, &p_info->meth, 1);			/* METH */
+					if (p_info->meth == 1) {
+						if (l_sub_box_size < l_sub_header_size + 7) {
+							return OPJ_FALSE;
+						}
+						opj_read_bytes(l_data + 3, &p_info->enumcs, 4);	/* EnumCS */
+					}
+					else if (p_info->meth == 2) {
+						p_info->icc_profile_offset = (OPJ_SIZE_T)(l_data + 3 - p_buffer);
+						p_info->icc_profile_len = (OPJ_UINT32)(l_sub_box_size - l_sub_header_size - 3);
+					}
+					l_has_colr = OPJ_TRUE;
+				}
+				else if (l_sub_type == JP2_PCLR) {
+					p_info->has_palette = 1;
+				}
+
+				l_sub_pos += (OPJ_SIZE_T)l_sub_box_size;
+			}
+			l_has_jp2h = OPJ_TRUE;
+		}
+		else if (l_type == JP2_JP2C) {
+			/* the JP2 header box comes before the codestream */
+			if (! l_has_jp2h) {
+				return OPJ_FALSE;
+			}
+
+			if (p_info->enumcs == 16)
+				p_info->color_space = OPJ_CLRSPC_SRGB;
+			else if (p_info->enumcs == 17)
+				p_info->color_space = OPJ_CLRSPC_GRAY;
+			else if (p_info->enumcs == 18)
+				p_info->color_space = OPJ_CLRSPC_SYCC;
+			else if (p_info->enumcs == 24)
+				p_info->color_space = OPJ_CLRSPC_EYCC;
+			else
+				p_info->color_space = OPJ_CLRSPC_UNKNOWN;
+
+			return opj_j2k_probe_header(p_buffer + l_pos + l_header_size, l_size - l_header_size, p_info);
+		}
+
+		l_pos += l_size;
+	}
+
+	return OPJ_FALSE;
+}
+
 void opj_jp2_setup_encoding_validation (opj_jp2_t *jp2)
 {
 	/* preconditions */
@@ -2592,6 +2932,17 @@ OPJ_BOOL opj_jp2_write_tile (	opj_jp2_t *p_jp2,
 	return opj_j2k_write_tile (p_jp2->j2k,p_tile_index,p_data,p_data_size,p_stream,p_manager);
 }
 
+OPJ_BOOL opj_jp2_write_strip (	opj_jp2_t *p_jp2,
+					 	 	    OPJ_INT32 ** p_comps_data,
+					 	 	    OPJ_UINT32 p_nb_rows,
+					 	 	    opj_stream_private_t *p_stream,
+					 	 	    opj_event_mgr_t * p_manager
+                                )
+
+{
+	return opj_j2k_write_strip (p_jp2->j2k,p_comps_data,p_nb_rows,p_stream,p_manager);
+}
+
 OPJ_BOOL opj_jp2_decode_tile (  opj_jp2_t * p_jp2,
                                 OPJ_UINT32 p_tile_index,
                                 OPJ_BYTE * p_data,
@@ -2688,8 +3039,11 @@ OPJ_BOOL opj_jp2_get_tile(	opj_jp2_t *p_jp2,
                             OPJ_UINT32 tile_index
                             )
 {
+	OPJ_UINT32 l_numcomps;
+
 	if (!p_image)
 		return OPJ_FALSE;
+	l_numcomps = p_image->numcomps;
 
 	opj_event_msg(p_manager, EVT_WARNING, "JP2 box which are after the codestream will not be read by this function.\n");
 
@@ -2698,6 +3052,10 @@ OPJ_BOOL opj_jp2_get_tile(	opj_jp2_t *p_jp2,
 		return OPJ_FALSE;
 	}
 
+	if (p_image->numcomps != l_numcomps) {
+		return OPJ_TRUE;
+	}
+
 	if (!opj_jp2_check_color(p_image, &(p_jp2->color), p_manager)) {
 		return OPJ_FALSE;
 	}
@@ -2796,6 +3154,26 @@ opj_codestream_index_t* jp2_get_cstr_index(opj_jp2_t* p_jp2)
 	return j2k_get_cstr_index(p_jp2->j2k);
 }
 
+OPJ_BOOL opj_jp2_save_cstr_index(opj_jp2_t* p_jp2, opj_stream_private_t *p_index_stream, OPJ_UINT64 p_stamp, opj_event_mgr_t * p_manager)
+{
+	return opj_j2k_save_cstr_index(p_jp2->j2k, p_index_stream, p_stamp, p_manager);
+}
+
+OPJ_BOOL opj_jp2_load_cstr_index(opj_jp2_t* p_jp2, opj_stream_private_t *p_index_stream, OPJ_UINT64 p_stamp, opj_event_mgr_t * p_manager)
+{
+	return opj_j2k_load_cstr_index(p_jp2->j2k, p_index_stream, p_stamp, p_manager);
+}
+
+OPJ_BOOL opj_jp2_set_codec_stats(opj_jp2_t* p_jp2, OPJ_BOOL p_enable, opj_event_mgr_t * p_manager)
+{
+	return opj_j2k_set_codec_stats(p_jp2->j2k, p_enable, p_manager);
+}
+
+opj_codec_stats_t* opj_jp2_get_codec_stats(opj_jp2_t* p_jp2)
+{
+	return opj_j2k_get_codec_stats(p_jp2->j2k);
+}
+
 opj_codestream_info_v2_t* jp2_get_cstr_info(opj_jp2_t* p_jp2)
 {
 	return j2k_get_cstr_info(p_jp2->j2k);
@@ -2808,6 +3186,14 @@ OPJ_BOOL opj_jp2_set_decoded_resolution_factor(opj_jp2_t *p_jp2,
 	return opj_j2k_set_decoded_resolution_factor(p_jp2->j2k, res_factor, p_manager);
 }
 
+OPJ_BOOL opj_jp2_set_decoded_components(opj_jp2_t *p_jp2,
+                                        OPJ_UINT32 numcomps,
+                                        const OPJ_UINT32 * comps_indices,
+                                        opj_event_mgr_t * p_manager)
+{
+	return opj_j2k_set_decoded_components(p_jp2->j2k, numcomps, comps_indices, p_manager);
+}
+
 /* JPIP specific */
 
 #ifdef USE_JPIP
@@ -253,8 +253,9 @@ Setup the decoder decoding parameters using user parameters.
 Decoding parameters are returned in jp2->j2k->cp.
 @param jp2 JP2 decompressor handle
 @param parameters decompression parameters
+@return true if the parameters could be stored
 */
-void opj_jp2_setup_decoder(opj_jp2_t *jp2, opj_dparameters_t *parameters);
+OPJ_BOOL opj_jp2_setup_decoder(opj_jp2_t *jp2, opj_dparameters_t *parameters);
 
 /**
  * Decode an image from a JPEG-2000 file stream
@@ -270,6 +271,48 @@ OPJ_BOOL opj_jp2_decode(opj_jp2_t *jp2,
             opj_image_t* p_image,
             opj_event_mgr_t * p_manager);
 
+/**
+ * Decode an image from a JPEG-2000 file stream into a caller-provided interleaved buffer.
+ * Palette (pclr) images are not supported by this function.
+ * @param jp2       JP2 decompressor handle
+ * @param p_stream  the stream to read data from.
+ * @param p_image   the decoded area (image header, comps[].data stay NULL)
+ * @param p_buffer  output buffer of at least p_image->comps[0].h * p_stride bytes
+ * @param p_stride  number of bytes between two lines of p_buffer
+ * @param p_format  layout of the samples in p_buffer
+ * @param p_manager the user event manager.
+ *
+ * @return OPJ_TRUE if successful, OPJ_FALSE otherwise
+*/
+OPJ_BOOL opj_jp2_decode_to_buffer(opj_jp2_t *jp2,
+                                  opj_stream_private_t *p_stream,
+                                  opj_image_t* p_image,
+                                  OPJ_BYTE * p_buffer,
+                                  OPJ_UINT32 p_stride,
+                                  OPJ_PIXEL_FORMAT p_format,
+                                  opj_event_mgr_t * p_manager);
+
+/**
+ * Decode an image from a JPEG-2000 file stream strip by strip (see opj_j2k_decode_strips).
+ * Palette (pclr) images are not supported by this function.
+ * @param jp2       JP2 decompressor handle
+ * @param p_stream  the stream to read data from.
+ * @param p_image   the decoded area (image header, comps[].data stay NULL)
+ * @param p_strip_height number of rows of each strip
+ * @param p_strip_fn function called with the samples of each strip
+ * @param p_user_data user data given to p_strip_fn
+ * @param p_manager the user event manager.
+ *
+ * @return OPJ_TRUE if successful, OPJ_FALSE otherwise
+*/
+OPJ_BOOL opj_jp2_decode_strips(opj_jp2_t *jp2,
+                               opj_stream_private_t *p_stream,
+                               opj_image_t* p_image,
+                               OPJ_UINT32 p_strip_height,
+                               opj_strip_decode_fn p_strip_fn,
+                               void * p_user_data,
+                               opj_event_mgr_t * p_manager);
+
 /**
  * Setup the encoder parameters using the current image and using user parameters. 
  * Coding parameters are returned in jp2->j2k->cp. 
@@ -346,6 +389,20 @@ OPJ_BOOL opj_jp2_read_header(  opj_stream_private_t *p_stream,
                                 opj_image_t ** p_image,
                                 opj_event_mgr_t * p_manager );
 
+/**
+ * Reads the boxes of a JP2 file held in memory up to the SIZ, COD and QCD markers of its codestream,
+ * without a codec.
+ *
+ * @param p_buffer      the JP2 file, starting with its signature box.
+ * @param p_buffer_size the number of bytes in p_buffer.
+ * @param p_info        the structure to fill with the colour specification and the codestream parameters.
+ *
+ * @return true if the JP2 header and the three markers have been found and are valid.
+ */
+OPJ_BOOL opj_jp2_probe_header(  const OPJ_BYTE * p_buffer,
+                                OPJ_SIZE_T p_buffer_size,
+                                opj_probe_info_t * p_info );
+
 /**
  * Reads a tile header.
  * @param  p_jp2         the jpeg2000 codec.
@@ -389,6 +446,21 @@ OPJ_BOOL opj_jp2_write_tile (  opj_jp2_t *p_jp2,
                     opj_stream_private_t *p_stream,
                     opj_event_mgr_t * p_manager );
 
+/**
+ * Writes the next rows of a single-tile image (see opj_j2k_write_strip).
+ *
+ * @param  p_jp2    the jpeg2000 codec.
+ * @param p_comps_data  rows of each component, p_nb_rows * comps[].w samples each
+ * @param p_nb_rows     number of rows
+ * @param  p_stream      the stream to write data to.
+ * @param  p_manager  the user event manager.
+ */
+OPJ_BOOL opj_jp2_write_strip ( opj_jp2_t *p_jp2,
+                    OPJ_INT32 ** p_comps_data,
+                    OPJ_UINT32 p_nb_rows,
+                    opj_stream_private_t *p_stream,
+                    opj_event_mgr_t * p_manager );
+
 /**
  * Decode tile data.
  * @param  p_jp2    the jpeg2000 codec.
@@ -457,6 +529,14 @@ OPJ_BOOL opj_jp2_set_decoded_resolution_factor(opj_jp2_t *p_jp2,
                                                OPJ_UINT32 res_factor, 
                                                opj_event_mgr_t * p_manager);
 
+/**
+ * Sets the components to decode, see opj_j2k_set_decoded_components.
+ */
+OPJ_BOOL opj_jp2_set_decoded_components(opj_jp2_t *p_jp2,
+                                        OPJ_UINT32 numcomps,
+                                        const OPJ_UINT32 * comps_indices,
+                                        opj_event_mgr_t * p_manager);
+
 
 /* TODO MSD: clean these 3 functions */
 /**
@@ -487,6 +567,50 @@ opj_codestream_info_v2_t* jp2_get_cstr_info(opj_jp2_t* p_jp2);
  */
 opj_codestream_index_t* jp2_get_cstr_index(opj_jp2_t* p_jp2);
 
+/**
+ * Saves the tile-parts and packets of the codestream index to an index file (see opj_j2k_save_cstr_index).
+ *
+ *@param  p_jp2           jp2 codec.
+ *@param  p_index_stream  the stream to write the index file to.
+ *@param  p_stamp         value identifying the file of the codestream.
+ *@param  p_manager       the user event manager.
+ *
+ *@return  true if the index file has been written.
+ */
+OPJ_BOOL opj_jp2_save_cstr_index(opj_jp2_t* p_jp2, opj_stream_private_t *p_index_stream, OPJ_UINT64 p_stamp, opj_event_mgr_t * p_manager);
+
+/**
+ * Loads an index file before the header is read (see opj_j2k_load_cstr_index).
+ *
+ *@param  p_jp2           jp2 codec.
+ *@param  p_index_stream  the stream to read the index file from.
+ *@param  p_stamp         value identifying the file of the codestream.
+ *@param  p_manager       the user event manager.
+ *
+ *@return  true if the index file is usable.
+ */
+OPJ_BOOL opj_jp2_load_cstr_index(opj_jp2_t* p_jp2, opj_stream_private_t *p_index_stream, OPJ_UINT64 p_stamp, opj_event_mgr_t * p_manager);
+
+/**
+ * Starts or stops collecting the codec statistics (see opj_j2k_set_codec_stats).
+ *
+ *@param  p_jp2           jp2 codec.
+ *@param  p_enable        true to collect the statistics.
+ *@param  p_manager       the user event manager.
+ *
+ *@return  false if the statistics could not be allocated.
+ */
+OPJ_BOOL opj_jp2_set_codec_stats(opj_jp2_t* p_jp2, OPJ_BOOL p_enable, opj_event_mgr_t * p_manager);
+
+/**
+ * Gets a copy of the codec statistics (see opj_j2k_get_codec_stats).
+ *
+ *@param  p_jp2           jp2 codec.
+ *
+ *@return  the statistics, or NULL if they are not collected.
+ */
+opj_codec_stats_t* opj_jp2_get_codec_stats(opj_jp2_t* p_jp2);
+
 
 /*@}*/
 
@@ -109,6 +109,30 @@ void opj_mct_decode(
 	}
 }
 
+/* <summary> */
+/* Inverse reversible MCT on 16 bits samples. */
+/* </summary> */
+void opj_mct_decode_16(
+		OPJ_INT16* restrict c0,
+		OPJ_INT16* restrict c1, 
+		OPJ_INT16* restrict c2, 
+		OPJ_UINT32 n)
+{
+	OPJ_UINT32 i;
+	for (i = 0; i < n; ++i) {
+		OPJ_INT32 y = c0[i];
+		OPJ_INT32 u = c1[i];
+		OPJ_INT32 v = c2[i];
+		OPJ_INT32 g = y - ((u + v) >> 2);
+		OPJ_INT32 r = v + g;
+		OPJ_INT32 b = u + g;
+		/* saturated values still clamp to the component range (12 bits at most) after the DC level shift */
+		c0[i] = (OPJ_INT16)opj_int_clamp(r, -32768, 32767);
+		c1[i] = (OPJ_INT16)opj_int_clamp(g, -32768, 32767);
+		c2[i] = (OPJ_INT16)opj_int_clamp(b, -32768, 32767);
+	}
+}
+
 /* <summary> */
 /* Get norm of basis function of reversible MCT. */
 /* </summary> */
@@ -70,6 +70,14 @@ Apply a reversible multi-component inverse transform to an image
 */
 void opj_mct_decode(OPJ_INT32 *c0, OPJ_INT32 *c1, OPJ_INT32 *c2, OPJ_UINT32 n);
 /**
+Apply a reversible multi-component inverse transform to an image stored on 16 bits
+@param c0 Samples for luminance component
+@param c1 Samples for red chrominance component
+@param c2 Samples for blue chrominance component
+@param n Number of samples for each component
+*/
+void opj_mct_decode_16(OPJ_INT16 *c0, OPJ_INT16 *c1, OPJ_INT16 *c2, OPJ_UINT32 n);
+/**
 Get norm of the basis function used for the reversible multi-component transform
 @param compno Number of the component (0->Y, 1->U, 2->V)
 @return 
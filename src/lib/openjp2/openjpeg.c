@@ -180,11 +180,33 @@ opj_codec_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT p_format)
 
 			l_codec->opj_get_codec_index = (opj_codestream_index_t* (*) (void*) ) j2k_get_cstr_index;
 
+			l_codec->opj_save_codec_index = (OPJ_BOOL (*) (void*, struct opj_stream_private *, OPJ_UINT64, struct opj_event_mgr *)) opj_j2k_save_cstr_index;
+
+			l_codec->opj_load_codec_index = (OPJ_BOOL (*) (void*, struct opj_stream_private *, OPJ_UINT64, struct opj_event_mgr *)) opj_j2k_load_cstr_index;
+
+			l_codec->opj_set_codec_stats = (OPJ_BOOL (*) (void*, OPJ_BOOL, struct opj_event_mgr *)) opj_j2k_set_codec_stats;
+
+			l_codec->opj_get_codec_stats = (opj_codec_stats_t* (*) (void*)) opj_j2k_get_codec_stats;
+
 			l_codec->m_codec_data.m_decompression.opj_decode =
 					(OPJ_BOOL (*) (	void *,
 									struct opj_stream_private *,
 									opj_image_t*, struct opj_event_mgr * )) opj_j2k_decode;
 
+			l_codec->m_codec_data.m_decompression.opj_decode_to_buffer =
+					(OPJ_BOOL (*) (	void *,
+									struct opj_stream_private *,
+									opj_image_t*,
+									OPJ_BYTE*, OPJ_UINT32, OPJ_PIXEL_FORMAT,
+									struct opj_event_mgr * )) opj_j2k_decode_to_buffer;
+
+			l_codec->m_codec_data.m_decompression.opj_decode_strips =
+					(OPJ_BOOL (*) (	void *,
+									struct opj_stream_private *,
+									opj_image_t*,
+									OPJ_UINT32, opj_strip_decode_fn, void *,
+									struct opj_event_mgr * )) opj_j2k_decode_strips;
+
 			l_codec->m_codec_data.m_decompression.opj_end_decompress =
 					(OPJ_BOOL (*) (	void *,
 									struct opj_stream_private *,
@@ -200,7 +222,7 @@ opj_codec_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT p_format)
 					(void (*) (void *))opj_j2k_destroy;
 
 			l_codec->m_codec_data.m_decompression.opj_setup_decoder =
-					(void (*) (void * , opj_dparameters_t * )) opj_j2k_setup_decoder;
+					(OPJ_BOOL (*) (void * , opj_dparameters_t * )) opj_j2k_setup_decoder;
 
 			l_codec->m_codec_data.m_decompression.opj_read_tile_header =
 					(OPJ_BOOL (*) (	void *,
@@ -239,6 +261,12 @@ opj_codec_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT p_format)
 									OPJ_UINT32 res_factor,
 									struct opj_event_mgr * p_manager)) opj_j2k_set_decoded_resolution_factor;
 
+			l_codec->m_codec_data.m_decompression.opj_set_decoded_components =
+                    (OPJ_BOOL (*) ( void * p_codec,
+									OPJ_UINT32 numcomps,
+									const OPJ_UINT32 * comps_indices,
+									struct opj_event_mgr * p_manager)) opj_j2k_set_decoded_components;
+
 			l_codec->m_codec = opj_j2k_create_decompress();
 
 			if (! l_codec->m_codec) {
@@ -256,12 +284,34 @@ opj_codec_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT p_format)
 
 			l_codec->opj_get_codec_index = (opj_codestream_index_t* (*) (void*) ) jp2_get_cstr_index;
 
+			l_codec->opj_save_codec_index = (OPJ_BOOL (*) (void*, struct opj_stream_private *, OPJ_UINT64, struct opj_event_mgr *)) opj_jp2_save_cstr_index;
+
+			l_codec->opj_load_codec_index = (OPJ_BOOL (*) (void*, struct opj_stream_private *, OPJ_UINT64, struct opj_event_mgr *)) opj_jp2_load_cstr_index;
+
+			l_codec->opj_set_codec_stats = (OPJ_BOOL (*) (void*, OPJ_BOOL, struct opj_event_mgr *)) opj_jp2_set_codec_stats;
+
+			l_codec->opj_get_codec_stats = (opj_codec_stats_t* (*) (void*)) opj_jp2_get_codec_stats;
+
 			l_codec->m_codec_data.m_decompression.opj_decode =
 					(OPJ_BOOL (*) (	void *,
 									struct opj_stream_private *,
 									opj_image_t*,
 									struct opj_event_mgr * )) opj_jp2_decode;
 
+			l_codec->m_codec_data.m_decompression.opj_decode_to_buffer =
+					(OPJ_BOOL (*) (	void *,
+									struct opj_stream_private *,
+									opj_image_t*,
+									OPJ_BYTE*, OPJ_UINT32, OPJ_PIXEL_FORMAT,
+									struct opj_event_mgr * )) opj_jp2_decode_to_buffer;
+
+			l_codec->m_codec_data.m_decompression.opj_decode_strips =
+					(OPJ_BOOL (*) (	void *,
+									struct opj_stream_private *,
+									opj_image_t*,
+									OPJ_UINT32, opj_strip_decode_fn, void *,
+									struct opj_event_mgr * )) opj_jp2_decode_strips;
+
 			l_codec->m_codec_data.m_decompression.opj_end_decompress =  
                     (OPJ_BOOL (*) ( void *,
                                     struct opj_stream_private *,
@@ -295,7 +345,7 @@ opj_codec_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT p_format)
 			l_codec->m_codec_data.m_decompression.opj_destroy = (void (*) (void *))opj_jp2_destroy;
 
 			l_codec->m_codec_data.m_decompression.opj_setup_decoder = 
-                    (void (*) (void * ,opj_dparameters_t * )) opj_jp2_setup_decoder;
+                    (OPJ_BOOL (*) (void * ,opj_dparameters_t * )) opj_jp2_setup_decoder;
 
 			l_codec->m_codec_data.m_decompression.opj_set_decode_area = 
                     (OPJ_BOOL (*) ( void *,
@@ -315,6 +365,12 @@ opj_codec_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT p_format)
 						    		OPJ_UINT32 res_factor,
 							    	opj_event_mgr_t * p_manager)) opj_jp2_set_decoded_resolution_factor;
 
+			l_codec->m_codec_data.m_decompression.opj_set_decoded_components =
+                    (OPJ_BOOL (*) ( void * p_codec,
+						    		OPJ_UINT32 numcomps,
+						    		const OPJ_UINT32 * comps_indices,
+							    	opj_event_mgr_t * p_manager)) opj_jp2_set_decoded_components;
+
 			l_codec->m_codec = opj_jp2_create(OPJ_TRUE);
 
 			if (! l_codec->m_codec) {
@@ -367,9 +423,8 @@ OPJ_BOOL OPJ_CALLCONV opj_setup_decoder(opj_codec_t *p_codec,
 			return OPJ_FALSE;
 		}
 
-		l_codec->m_codec_data.m_decompression.opj_setup_decoder(l_codec->m_codec,
+		return l_codec->m_codec_data.m_decompression.opj_setup_decoder(l_codec->m_codec,
 																parameters);
-		return OPJ_TRUE;
 	}
 	return OPJ_FALSE;
 }
@@ -397,6 +452,60 @@ OPJ_BOOL OPJ_CALLCONV opj_read_header (	opj_stream_t *p_stream,
 	return OPJ_FALSE;
 }
 
+OPJ_BOOL OPJ_CALLCONV opj_decode_to_buffer(	opj_codec_t *p_codec,
+											opj_stream_t *p_stream,
+											opj_image_t* p_image,
+											OPJ_BYTE *p_buffer,
+											OPJ_UINT32 p_stride,
+											OPJ_PIXEL_FORMAT p_format)
+{
+	if (p_codec && p_stream) {
+		opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+		opj_stream_private_t * l_stream = (opj_stream_private_t *) p_stream;
+
+		if (! l_codec->is_decompressor) {
+			return OPJ_FALSE;
+		}
+
+		return l_codec->m_codec_data.m_decompression.opj_decode_to_buffer(	l_codec->m_codec,
+																			l_stream,
+																			p_image,
+																			p_buffer,
+																			p_stride,
+																			p_format,
+																			&(l_codec->m_event_mgr) );
+	}
+
+	return OPJ_FALSE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_decode_strips(	opj_codec_t *p_codec,
+										opj_stream_t *p_stream,
+										opj_image_t* p_image,
+										OPJ_UINT32 p_strip_height,
+										opj_strip_decode_fn p_strip_fn,
+										void *p_user_data)
+{
+	if (p_codec && p_stream) {
+		opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+		opj_stream_private_t * l_stream = (opj_stream_private_t *) p_stream;
+
+		if (! l_codec->is_decompressor) {
+			return OPJ_FALSE;
+		}
+
+		return l_codec->m_codec_data.m_decompression.opj_decode_strips(	l_codec->m_codec,
+																		l_stream,
+																		p_image,
+																		p_strip_height,
+																		p_strip_fn,
+																		p_user_data,
+																		&(l_codec->m_event_mgr) );
+	}
+
+	return OPJ_FALSE;
+}
+
 OPJ_BOOL OPJ_CALLCONV opj_decode(   opj_codec_t *p_codec,
                                     opj_stream_t *p_stream,
                                     opj_image_t* p_image)
@@ -534,6 +643,22 @@ OPJ_BOOL OPJ_CALLCONV opj_set_decoded_resolution_factor(opj_codec_t *p_codec,
 	return OPJ_TRUE;
 }
 
+OPJ_BOOL OPJ_CALLCONV opj_set_decoded_components(opj_codec_t *p_codec,
+												OPJ_UINT32 numcomps,
+												const OPJ_UINT32 *comps_indices)
+{
+	opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+
+	if ( !l_codec || !l_codec->is_decompressor ){
+		return OPJ_FALSE;
+	}
+
+	return l_codec->m_codec_data.m_decompression.opj_set_decoded_components(l_codec->m_codec,
+																			numcomps,
+																			comps_indices,
+																			&(l_codec->m_event_mgr) );
+}
+
 /* ---------------------------------------------------------------------- */
 /* COMPRESSION FUNCTIONS*/
 
@@ -550,6 +675,10 @@ opj_codec_t* OPJ_CALLCONV opj_create_compress(OPJ_CODEC_FORMAT p_format)
 
 	switch(p_format) {
 		case OPJ_CODEC_J2K:
+			l_codec->opj_set_codec_stats = (OPJ_BOOL (*) (void*, OPJ_BOOL, struct opj_event_mgr *)) opj_j2k_set_codec_stats;
+
+			l_codec->opj_get_codec_stats = (opj_codec_stats_t* (*) (void*)) opj_j2k_get_codec_stats;
+
 			l_codec->m_codec_data.m_compression.opj_encode = (OPJ_BOOL (*) (void *,
 																			struct opj_stream_private *,
 																			struct opj_event_mgr * )) opj_j2k_encode;
@@ -570,6 +699,12 @@ opj_codec_t* OPJ_CALLCONV opj_create_compress(OPJ_CODEC_FORMAT p_format)
 																				struct opj_stream_private *,
 																				struct opj_event_mgr *) ) opj_j2k_write_tile;
 
+			l_codec->m_codec_data.m_compression.opj_write_strip = (OPJ_BOOL (*) (void *,
+																				OPJ_INT32 **,
+																				OPJ_UINT32,
+																				struct opj_stream_private *,
+																				struct opj_event_mgr *)) opj_j2k_write_strip;
+
 			l_codec->m_codec_data.m_compression.opj_destroy = (void (*) (void *)) opj_j2k_destroy;
 
 			l_codec->m_codec_data.m_compression.opj_setup_encoder = (OPJ_BOOL (*) (	void *,
@@ -587,6 +722,10 @@ opj_codec_t* OPJ_CALLCONV opj_create_compress(OPJ_CODEC_FORMAT p_format)
 
 		case OPJ_CODEC_JP2:
 			/* get a JP2 decoder handle */
+			l_codec->opj_set_codec_stats = (OPJ_BOOL (*) (void*, OPJ_BOOL, struct opj_event_mgr *)) opj_jp2_set_codec_stats;
+
+			l_codec->opj_get_codec_stats = (opj_codec_stats_t* (*) (void*)) opj_jp2_get_codec_stats;
+
 			l_codec->m_codec_data.m_compression.opj_encode = (OPJ_BOOL (*) (void *,
 																			struct opj_stream_private *,
 																			struct opj_event_mgr * )) opj_jp2_encode;
@@ -607,6 +746,12 @@ opj_codec_t* OPJ_CALLCONV opj_create_compress(OPJ_CODEC_FORMAT p_format)
 																				struct opj_stream_private *,
 																				struct opj_event_mgr *)) opj_jp2_write_tile;
 
+			l_codec->m_codec_data.m_compression.opj_write_strip = (OPJ_BOOL (*) (void *,
+																				OPJ_INT32 **,
+																				OPJ_UINT32,
+																				struct opj_stream_private *,
+																				struct opj_event_mgr *)) opj_jp2_write_strip;
+
 			l_codec->m_codec_data.m_compression.opj_destroy = (void (*) (void *)) opj_jp2_destroy;
 
 			l_codec->m_codec_data.m_compression.opj_setup_encoder = (OPJ_BOOL (*) (	void *,
@@ -837,6 +982,29 @@ OPJ_BOOL OPJ_CALLCONV opj_write_tile (	opj_codec_t *p_codec,
 	return OPJ_FALSE;
 }
 
+OPJ_BOOL OPJ_CALLCONV opj_write_strip (	opj_codec_t *p_codec,
+										OPJ_INT32 ** p_comps_data,
+										OPJ_UINT32 p_nb_rows,
+										opj_stream_t *p_stream )
+{
+	if (p_codec && p_stream && p_comps_data) {
+		opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+		opj_stream_private_t * l_stream = (opj_stream_private_t *) p_stream;
+
+		if (l_codec->is_decompressor) {
+			return OPJ_FALSE;
+		}
+
+		return l_codec->m_codec_data.m_compression.opj_write_strip(	l_codec->m_codec,
+																	p_comps_data,
+																	p_nb_rows,
+																	l_stream,
+																	&(l_codec->m_event_mgr) );
+	}
+
+	return OPJ_FALSE;
+}
+
 /* ---------------------------------------------------------------------- */
 
 void OPJ_CALLCONV opj_destroy_codec(opj_codec_t *p_codec)
@@ -919,6 +1087,103 @@ void OPJ_CALLCONV opj_destroy_cstr_index(opj_codestream_index_t **p_cstr_index)
 	}
 }
 
+OPJ_BOOL OPJ_CALLCONV opj_save_cstr_index(	opj_codec_t *p_codec,
+											opj_stream_t *p_index_stream,
+											OPJ_UINT64 p_stamp )
+{
+	if (p_codec && p_index_stream) {
+		opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+		opj_stream_private_t * l_stream = (opj_stream_private_t *) p_index_stream;
+
+		if (! l_codec->is_decompressor) {
+			opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                "Codec provided to the opj_save_cstr_index function is not a decompressor handler.\n");
+			return OPJ_FALSE;
+		}
+
+		return l_codec->opj_save_codec_index(l_codec->m_codec, l_stream, p_stamp, &(l_codec->m_event_mgr));
+	}
+
+	return OPJ_FALSE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_load_cstr_index(	opj_codec_t *p_codec,
+											opj_stream_t *p_index_stream,
+											OPJ_UINT64 p_stamp )
+{
+	if (p_codec && p_index_stream) {
+		opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+		opj_stream_private_t * l_stream = (opj_stream_private_t *) p_index_stream;
+
+		if (! l_codec->is_decompressor) {
+			opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                "Codec provided to the opj_load_cstr_index function is not a decompressor handler.\n");
+			return OPJ_FALSE;
+		}
+
+		return l_codec->opj_load_codec_index(l_codec->m_codec, l_stream, p_stamp, &(l_codec->m_event_mgr));
+	}
+
+	return OPJ_FALSE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_set_codec_stats(	opj_codec_t *p_codec,
+											OPJ_BOOL p_enable )
+{
+	if (p_codec) {
+		opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+
+		return l_codec->opj_set_codec_stats(l_codec->m_codec, p_enable, &(l_codec->m_event_mgr));
+	}
+
+	return OPJ_FALSE;
+}
+
+opj_codec_stats_t* OPJ_CALLCONV opj_get_codec_stats(opj_codec_t *p_codec)
+{
+	if (p_codec) {
+		opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+
+		return l_codec->opj_get_codec_stats(l_codec->m_codec);
+	}
+
+	return NULL;
+}
+
+void OPJ_CALLCONV opj_destroy_codec_stats(opj_codec_stats_t **p_stats)
+{
+	if (p_stats && *p_stats) {
+		opj_free((*p_stats)->tiles);
+		opj_free(*p_stats);
+		*p_stats = NULL;
+	}
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_probe_header(	const OPJ_BYTE * p_buffer,
+										OPJ_SIZE_T p_buffer_size,
+										opj_probe_info_t * p_info )
+{
+	static const OPJ_BYTE l_jp2_signature[12] = { 0x00, 0x00, 0x00, 0x0c, 0x6a, 0x50, 0x20, 0x20, 0x0d, 0x0a, 0x87, 0x0a };
+	static const OPJ_BYTE l_j2k_signature[4] = { 0xff, 0x4f, 0xff, 0x51 };
+
+	if (! p_buffer || ! p_info) {
+		return OPJ_FALSE;
+	}
+	memset(p_info, 0, sizeof(opj_probe_info_t));
+	p_info->format = OPJ_CODEC_UNKNOWN;
+
+	if (p_buffer_size >= sizeof(l_jp2_signature) && memcmp(p_buffer, l_jp2_signature, sizeof(l_jp2_signature)) == 0) {
+		p_info->format = OPJ_CODEC_JP2;
+		return opj_jp2_probe_header(p_buffer, p_buffer_size, p_info);
+	}
+	if (p_buffer_size >= sizeof(l_j2k_signature) && memcmp(p_buffer, l_j2k_signature, sizeof(l_j2k_signature)) == 0) {
+		p_info->format = OPJ_CODEC_J2K;
+		return opj_j2k_probe_header(p_buffer, p_buffer_size, p_info);
+	}
+
+	return OPJ_FALSE;
+}
+
 opj_stream_t* OPJ_CALLCONV opj_stream_create_default_file_stream (const char *fname, OPJ_BOOL p_is_read_stream)
 {
     return opj_stream_create_file_stream(fname, OPJ_J2K_STREAM_CHUNK_SIZE, p_is_read_stream);
@@ -294,6 +294,19 @@ typedef enum CODEC_FORMAT {
     OPJ_CODEC_JPX  = 4		/**< JPX file format (JPEG 2000 Part-2) : to be coded */
 } OPJ_CODEC_FORMAT;
 
+/**
+ * Sample layouts of a caller-provided interleaved output buffer (see opj_decode_to_buffer).
+ * 16 bit samples are written in the native byte order.
+*/
+typedef enum PIXEL_FORMAT {
+	OPJ_PF_GRAY8  = 0,		/**< 1 channel, 8 bits per sample */
+	OPJ_PF_RGB8   = 1,		/**< 3 channels, 8 bits per sample */
+	OPJ_PF_RGBA8  = 2,		/**< 4 channels, 8 bits per sample */
+	OPJ_PF_GRAY16 = 3,		/**< 1 channel, 16 bits per sample */
+	OPJ_PF_RGB16  = 4,		/**< 3 channels, 16 bits per sample */
+	OPJ_PF_RGBA16 = 5		/**< 4 channels, 16 bits per sample */
+} OPJ_PIXEL_FORMAT;
+
 
 /* 
 ==========================================================
@@ -494,6 +507,8 @@ typedef struct opj_cparameters {
     /** RSIZ value
         To be used to combine OPJ_PROFILE_*, OPJ_EXTENSION_* and (sub)levels values. */
     OPJ_UINT16 rsiz;
+	/** Write the lengths of the packets in PLT markers, in the header of every tile-part */
+	OPJ_BOOL plt_on;
 } opj_cparameters_t;  
 
 #define OPJ_DPARAMETERS_IGNORE_PCLR_CMAP_CDEF_FLAG	0x0001
@@ -561,6 +576,17 @@ typedef struct opj_dparameters {
 
 	unsigned int flags;
 
+	/**
+	Set the number of components to decode, listed in cp_comps.
+	The other components are skipped and the decoded image only holds the listed ones,
+	in the order of the codestream (see opj_set_decoded_components).
+	if != 0, then only the components of cp_comps are decoded;
+	if == 0 or not used, all the components are decoded
+	*/
+	OPJ_UINT32 cp_nb_comps;
+	/** indices of the components to decode, copied by opj_setup_decoder */
+	OPJ_UINT32 * cp_comps;
+
 } opj_dparameters_t;
 
 
@@ -700,6 +726,18 @@ typedef struct opj_image_comptparm {
 	OPJ_UINT32 sgnd;
 } opj_image_cmptparm_t;
 
+/**
+ * Callback function prototype receiving the decoded samples strip by strip (see opj_decode_strips)
+ *
+ * @param p_image		the decoded image header
+ * @param p_y			index of the first row of the strip in the decoded image
+ * @param p_nb_rows		number of rows of the strip
+ * @param p_comps_data	samples of the strip, one array of p_nb_rows * comps[].w values per component
+ * @param p_user_data	user data given to opj_decode_strips
+ * @return 				OPJ_FALSE to stop the decoding
+ */
+typedef OPJ_BOOL (* opj_strip_decode_fn) (opj_image_t * p_image, OPJ_UINT32 p_y, OPJ_UINT32 p_nb_rows, OPJ_INT32 ** p_comps_data, void * p_user_data) ;
+
 
 /* 
 ==========================================================
@@ -945,6 +983,10 @@ typedef struct opj_tp_index {
 	OPJ_OFF_T end_header;
 	/** end position */
 	OPJ_OFF_T end_pos;
+	/** index in packet_index of the first packet of the tile part (from the PLT/PLM markers) */
+	OPJ_UINT32 first_packet;
+	/** number of packets of the tile part in packet_index */
+	OPJ_UINT32 nb_packets;
 
 } opj_tp_index_t;
 
@@ -975,7 +1017,9 @@ typedef struct opj_tile_index {
 
 	/** packet number */
 	OPJ_UINT32 nb_packet;
-	/** information concerning packets inside tile */
+	/** information concerning packets inside tile, read from the PLT/PLM markers.
+	    Until the position of the tile part data is known, start_pos is 0 and end_pos is the packet length minus one.
+	    end_ph_pos is not set */
 	opj_packet_info_t *packet_index;
 
 } opj_tile_index_t;
@@ -1035,6 +1079,145 @@ typedef struct opj_jp2_index {
 
 } opj_jp2_index_t;
 
+/*
+==========================================================
+   Header probe
+==========================================================
+*/
+
+/** Maximum number of components whose parameters are given by opj_probe_header */
+#define OPJ_PROBE_MAX_COMPS 16
+
+/**
+ * Parameters of an image component, as given by opj_probe_header
+ */
+typedef struct opj_probe_comp {
+	/** XRsiz: horizontal separation of a sample of the component with respect to the reference grid */
+	OPJ_UINT32 dx;
+	/** YRsiz: vertical separation of a sample of the component with respect to the reference grid */
+	OPJ_UINT32 dy;
+	/** precision */
+	OPJ_UINT32 prec;
+	/** signed (1) / unsigned (0) */
+	OPJ_UINT32 sgnd;
+} opj_probe_comp_t;
+
+/**
+ * Main parameters of a JPEG 2000 file, read by opj_probe_header from the SIZ, COD and QCD markers
+ * of the main header and, for a JP2 file, from the boxes of the JP2 header.
+ */
+typedef struct opj_probe_info {
+	/** OPJ_CODEC_J2K for a codestream, OPJ_CODEC_JP2 for a JP2 file */
+	OPJ_CODEC_FORMAT format;
+	/** capabilities (Rsiz) */
+	OPJ_UINT32 rsiz;
+	/** image area on the reference grid: x0, y0 included, x1, y1 excluded */
+	OPJ_UINT32 x0, y0, x1, y1;
+	/** origin of the tile grid */
+	OPJ_UINT32 tx0, ty0;
+	/** size of the tiles */
+	OPJ_UINT32 tdx, tdy;
+	/** number of tiles in width and height */
+	OPJ_UINT32 tw, th;
+	/** number of components */
+	OPJ_UINT32 numcomps;
+	/** parameters of the first OPJ_PROBE_MAX_COMPS components */
+	opj_probe_comp_t comps[OPJ_PROBE_MAX_COMPS];
+	/** default coding style (Scod) */
+	OPJ_UINT32 csty;
+	/** default progression order */
+	OPJ_PROG_ORDER prg;
+	/** number of layers */
+	OPJ_UINT32 numlayers;
+	/** multi-component transform */
+	OPJ_UINT32 mct;
+	/** default number of resolutions */
+	OPJ_UINT32 numresolutions;
+	/** default code-block width and height, as powers of 2 */
+	OPJ_UINT32 cblkw, cblkh;
+	/** default code-block coding style */
+	OPJ_UINT32 cblksty;
+	/** default wavelet transform: 1 for the reversible 5-3, 0 for the irreversible 9-7 */
+	OPJ_UINT32 qmfbid;
+	/** default quantisation style */
+	OPJ_UINT32 qntsty;
+	/** default number of guard bits */
+	OPJ_UINT32 numgbits;
+	/** JP2 colour specification method, 0 if the file has no colour specification box */
+	OPJ_UINT32 meth;
+	/** JP2 enumerated colour space, when meth is 1 */
+	OPJ_UINT32 enumcs;
+	/** colour space of the image, OPJ_CLRSPC_UNSPECIFIED for a codestream */
+	OPJ_COLOR_SPACE color_space;
+	/** offset of the ICC profile in the probed buffer, when meth is 2 */
+	OPJ_SIZE_T icc_profile_offset;
+	/** size of the ICC profile */
+	OPJ_UINT32 icc_profile_len;
+	/** 1 if the JP2 header has a palette box */
+	OPJ_UINT32 has_palette;
+} opj_probe_info_t;
+
+/*
+==========================================================
+   Codec statistics
+==========================================================
+*/
+
+/**
+ * Stages of the decoding and encoding pipelines timed by the codec statistics
+ */
+typedef enum CODEC_STAGE {
+	OPJ_STAGE_HEADER   = 0,		/**< main header, and tile-part headers with the reading of the tile-part data (decoder) */
+	OPJ_STAGE_T2       = 1,		/**< tier-2: packet headers and bodies */
+	OPJ_STAGE_T1       = 2,		/**< tier-1: code-blocks */
+	OPJ_STAGE_DWT      = 3,		/**< discrete wavelet transform */
+	OPJ_STAGE_MCT      = 4,		/**< multi-component transform */
+	OPJ_STAGE_DC_SHIFT = 5,		/**< DC level shift */
+	OPJ_STAGE_COPY     = 6,		/**< copy of the tile samples to the image or buffer (decoder), or from the user data (encoder) */
+	OPJ_STAGE_RATE     = 7		/**< rate allocation (encoder) */
+} OPJ_CODEC_STAGE;
+
+/** Number of stages in OPJ_CODEC_STAGE */
+#define OPJ_NB_STAGES 8
+
+/**
+ * Figures of a stage of the pipeline
+ */
+typedef struct opj_stage_stats {
+	/** number of times the stage has run */
+	OPJ_UINT32 nb_calls;
+	/** wall clock time, in seconds */
+	OPJ_FLOAT64 wall_time;
+	/** CPU time of the calling thread, in seconds */
+	OPJ_FLOAT64 cpu_time;
+	/** bytes of codestream for the header and T2 stages, bytes of the tile component buffers for the other ones */
+	OPJ_UINT64 nb_bytes;
+} opj_stage_stats_t;
+
+/**
+ * Figures of a tile, or of the whole image
+ */
+typedef struct opj_tile_stats {
+	/** figures of each stage, indexed by OPJ_CODEC_STAGE */
+	opj_stage_stats_t stages[OPJ_NB_STAGES];
+	/** allocations made to set up the tile structures (tile buffers, resolutions, precincts, tag trees and code-blocks) */
+	OPJ_UINT32 nb_allocs;
+	/** bytes requested by these allocations */
+	OPJ_UINT64 alloc_bytes;
+} opj_tile_stats_t;
+
+/**
+ * Statistics collected by a codec once enabled by opj_set_codec_stats
+ */
+typedef struct opj_codec_stats {
+	/** figures of the whole image, the main header included */
+	opj_tile_stats_t total;
+	/** number of tiles, 0 until the main header has been read or written */
+	OPJ_UINT32 nb_tiles;
+	/** figures of each tile, nb_tiles entries */
+	opj_tile_stats_t *tiles;
+} opj_codec_stats_t;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -1084,6 +1267,35 @@ OPJ_API void OPJ_CALLCONV opj_image_destroy(opj_image_t *image);
 */
 OPJ_API opj_image_t* OPJ_CALLCONV opj_image_tile_create(OPJ_UINT32 numcmpts, opj_image_cmptparm_t *cmptparms, OPJ_COLOR_SPACE clrspc);
 
+/**
+ * Converts the first three components of a decoded image from sYCC to RGB in place.
+ * The chroma components can be subsampled by 2 horizontally and/or vertically, the luma
+ * must not be. Without subsampling the samples are converted in their planes, otherwise
+ * the chroma planes are replaced by full resolution green and blue planes.
+ * The precision of the luma gives the range of the converted samples.
+ *
+ * @param image         the decoded image, its color_space is set to OPJ_CLRSPC_SRGB
+ * @return              OPJ_TRUE if success, OPJ_FALSE if the image is not supported, it is then left untouched
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_image_sycc_to_rgb(opj_image_t *image);
+
+/**
+ * Converts the first three components of a decoded image from sYCC to RGB into a
+ * caller-provided interleaved buffer, upsampling the chroma on the fly. The image is
+ * not modified. The alpha channel of the RGBA formats is taken from the fourth component,
+ * or set to opaque. Samples are shifted to the output bit depth as in opj_decode_to_buffer.
+ *
+ * @param image         the decoded image, with the layouts supported by opj_image_sycc_to_rgb
+ * @param buffer        output buffer of at least comps[0].h * stride bytes
+ * @param stride        number of bytes between two lines of buffer
+ * @param format        layout of the samples in buffer, one of the RGB or RGBA formats
+ * @return              OPJ_TRUE if success, OPJ_FALSE if the image or the format is not supported
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_image_sycc_to_buffer(const opj_image_t *image,
+                                                       OPJ_BYTE *buffer,
+                                                       OPJ_UINT32 stride,
+                                                       OPJ_PIXEL_FORMAT format);
+
 /* 
 ==========================================================
    stream functions definitions
@@ -1300,6 +1512,63 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decode(   opj_codec_t *p_decompressor,
                                             opj_stream_t *p_stream,
                                             opj_image_t *p_image);
 
+/**
+ * Decode an image from a JPEG-2000 codestream directly into a caller-provided
+ * interleaved buffer. No component planes are allocated : p_image only describes
+ * the decoded area (as returned by opj_read_header and adjusted by opj_set_decode_area
+ * and opj_set_decoded_resolution_factor) and its comps[].data stay NULL.
+ *
+ * Channels are taken from the components in order. With less than 3 components the first
+ * one is replicated into the RGB channels, and the alpha channel is taken from the second
+ * (2 components) or fourth component, or set to opaque. Samples are shifted to the output
+ * bit depth and signed components are offset to unsigned values.
+ * All the components used must have the same subsampling as the first one.
+ *
+ * JP2 palette images are expanded in a single pass: each index is replaced by the pixel of
+ * its entry, and p_image then describes the channels of the palette. This is only supported
+ * for 8 bit formats, with all the channels looked up from the same component.
+ *
+ * @param p_decompressor 	decompressor handle
+ * @param p_stream			Input buffer stream
+ * @param p_image 			the decoded image header
+ * @param p_buffer 			output buffer of at least comps[0].h * p_stride bytes
+ * @param p_stride 			number of bytes between two lines of p_buffer
+ * @param p_format 			layout of the samples in p_buffer
+ * @return 					true if success, otherwise false
+ * */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decode_to_buffer(	opj_codec_t *p_decompressor,
+													opj_stream_t *p_stream,
+													opj_image_t *p_image,
+													OPJ_BYTE *p_buffer,
+													OPJ_UINT32 p_stride,
+													OPJ_PIXEL_FORMAT p_format);
+
+/**
+ * Decode an image from a JPEG-2000 codestream by horizontal strips, handing each strip
+ * to a callback instead of filling component planes. The inverse wavelet transform only
+ * reconstructs the rows needed by the current strip and the code-blocks are decoded one
+ * row of code-blocks at a time, so the memory used does not grow with the image height
+ * (the compressed tile data is kept in memory). p_image comps[].data stay NULL.
+ *
+ * Only codestreams made of a single tile are supported, and all the components must
+ * have the same subsampling. The samples given to the callback are the ones opj_decode
+ * would write in the component planes.
+ *
+ * @param p_decompressor 	decompressor handle
+ * @param p_stream			Input buffer stream
+ * @param p_image 			the decoded image header
+ * @param p_strip_height	number of rows of each strip (the last one can be smaller)
+ * @param p_strip_fn 		function called with the samples of each strip, from top to bottom
+ * @param p_user_data 		user data given to p_strip_fn
+ * @return 					true if success, otherwise false
+ * */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decode_strips(	opj_codec_t *p_decompressor,
+												opj_stream_t *p_stream,
+												opj_image_t *p_image,
+												OPJ_UINT32 p_strip_height,
+												opj_strip_decode_fn p_strip_fn,
+												void *p_user_data);
+
 /**
  * Get the decoded tile from the codec
  *
@@ -1324,6 +1593,21 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_get_decoded_tile(	opj_codec_t *p_codec,
  */
 OPJ_API OPJ_BOOL OPJ_CALLCONV opj_set_decoded_resolution_factor(opj_codec_t *p_codec, OPJ_UINT32 res_factor);
 
+/**
+ * Set the components to decode, after opj_read_header. The packets, code-blocks and
+ * sample buffers of the other components are skipped, and the image given to opj_decode
+ * (or opj_get_decoded_tile, opj_decode_to_buffer, opj_decode_strips) is reduced to the
+ * decoded components, in the order of the codestream. It replaces the components set by
+ * opj_dparameters_t::cp_comps.
+ *
+ * @param	p_codec			the jpeg2000 codec.
+ * @param	numcomps		number of components to decode, 0 to decode all of them
+ * @param	comps_indices	indices of the components to decode
+ *
+ * @return					true if success, otherwise false
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_set_decoded_components(opj_codec_t *p_codec, OPJ_UINT32 numcomps, const OPJ_UINT32 *comps_indices);
+
 /**
  * Writes a tile with the given data.
  *
@@ -1342,6 +1626,26 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_write_tile (	opj_codec_t *p_codec,
 												OPJ_UINT32 p_data_size,
 												opj_stream_t *p_stream );
 
+/**
+ * Writes the next rows of an image, without holding the whole image in memory.
+ * The image given to opj_start_compress must be made of a single tile, its components must
+ * have the same size and their data can be left to NULL. The rows go through the wavelet
+ * transform as they come in and each row of code-blocks is encoded as soon as it is complete,
+ * so only the compressed code-blocks are kept until the tile is written with the last rows.
+ * Call opj_end_compress once all the rows are written.
+ *
+ * @param	p_codec			the jpeg2000 codec.
+ * @param	p_comps_data	rows of each component, p_nb_rows * comps[].w samples each.
+ * @param	p_nb_rows		number of rows to write.
+ * @param	p_stream		the stream to write data to.
+ *
+ * @return	true if the rows could be written.
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_write_strip (	opj_codec_t *p_codec,
+												OPJ_INT32 ** p_comps_data,
+												OPJ_UINT32 p_nb_rows,
+												opj_stream_t *p_stream );
+
 /**
  * Reads a tile header. This function is compulsory and allows one to know the size of the tile thta will be decoded.
  * The user may need to refer to the image got by opj_read_header to understand the size being taken by the tile.
@@ -1507,6 +1811,38 @@ OPJ_API opj_codestream_index_t * OPJ_CALLCONV opj_get_cstr_index(opj_codec_t *p_
 
 OPJ_API void OPJ_CALLCONV opj_destroy_cstr_index(opj_codestream_index_t **p_cstr_index);
 
+/**
+ * Saves the positions of the tile-parts, and of the packets when known, to an index file,
+ * so that opj_load_cstr_index spares the scan of the codestream the next time it is opened.
+ * The whole codestream must have been read first, e.g. by opj_decode.
+ *
+ * @param	p_codec			the jpeg2000 codec.
+ * @param	p_index_stream	the stream to write the index file to.
+ * @param	p_stamp			value identifying the file of the codestream (e.g. its modification time),
+ *							checked by opj_load_cstr_index.
+ *
+ * @return true if the index file has been written.
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_save_cstr_index(	opj_codec_t *p_codec,
+													opj_stream_t *p_index_stream,
+													OPJ_UINT64 p_stamp );
+
+/**
+ * Loads an index file written by opj_save_cstr_index. To be called before opj_read_header,
+ * the tile-parts are then located as with TLM markers and tiles can be decoded without reading the ones before.
+ * The index file is ignored, with a warning, if it does not match the stamp, the length of the stream
+ * or the main header of the codestream.
+ *
+ * @param	p_codec			the jpeg2000 codec.
+ * @param	p_index_stream	the stream to read the index file from.
+ * @param	p_stamp			value identifying the file of the codestream, as given to opj_save_cstr_index.
+ *
+ * @return true if the index file has been loaded.
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_load_cstr_index(	opj_codec_t *p_codec,
+													opj_stream_t *p_index_stream,
+													OPJ_UINT64 p_stamp );
+
 
 /**
  * Get the JP2 file information from the codec FIXME
@@ -1529,6 +1865,65 @@ OPJ_API opj_jp2_metadata_t* OPJ_CALLCONV opj_get_jp2_metadata(opj_codec_t *p_cod
 OPJ_API opj_jp2_index_t* OPJ_CALLCONV opj_get_jp2_index(opj_codec_t *p_codec);
 
 
+/*
+==========================================================
+   header probe functions definitions
+==========================================================
+*/
+
+/**
+ * Reads the main parameters of a JPEG 2000 codestream or JP2 file from the first bytes of the file,
+ * without creating a codec. Only the JP2 header boxes and the SIZ, COD and QCD markers are parsed,
+ * tile-part headers, tile-specific parameters and the other main header markers are not looked at.
+ *
+ * @param	p_buffer		the first bytes of the file.
+ * @param	p_buffer_size	the number of bytes in p_buffer.
+ * @param	p_info			the structure to fill.
+ *
+ * @return true if the buffer holds a valid JP2 header and main header up to the SIZ, COD and QCD markers,
+ *		false if it is not a JPEG 2000 file, is corrupted or ends before these markers.
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_probe_header(	const OPJ_BYTE * p_buffer,
+												OPJ_SIZE_T p_buffer_size,
+												opj_probe_info_t * p_info );
+
+
+/*
+==========================================================
+   codec statistics functions definitions
+==========================================================
+*/
+
+/**
+ * Enables or disables the collection of statistics on the time spent in each stage of the pipeline.
+ * Enabling resets the figures collected so far. A codec that does not collect statistics
+ * only tests a pointer at each stage.
+ *
+ * @param	p_codec			the jpeg2000 codec.
+ * @param	p_enable		OPJ_TRUE to collect statistics from now on, OPJ_FALSE to stop.
+ *
+ * @return true if the statistics could be enabled or disabled.
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_set_codec_stats(	opj_codec_t *p_codec,
+													OPJ_BOOL p_enable );
+
+/**
+ * Gets a copy of the statistics collected by the codec.
+ *
+ * @param	p_codec			the jpeg2000 codec.
+ *
+ * @return a statistics structure to free with opj_destroy_codec_stats, NULL if the codec does not collect statistics.
+ */
+OPJ_API opj_codec_stats_t* OPJ_CALLCONV opj_get_codec_stats(opj_codec_t *p_codec);
+
+/**
+ * Destroys statistics returned by opj_get_codec_stats.
+ *
+ * @param	p_stats			the statistics to destroy, set to NULL.
+ */
+OPJ_API void OPJ_CALLCONV opj_destroy_codec_stats(opj_codec_stats_t **p_stats);
+
+
 /*
 ==========================================================
    MCT functions
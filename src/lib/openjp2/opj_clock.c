@@ -35,6 +35,7 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/times.h>
+#include <time.h>
 #endif /* _WIN32 */
 #include "opj_includes.h"
 
@@ -62,3 +63,71 @@ OPJ_FLOAT64 opj_clock(void) {
 #endif
 }
 
+OPJ_FLOAT64 opj_wall_clock(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq , t ;
+    QueryPerformanceFrequency(&freq) ;
+    QueryPerformanceCounter ( & t ) ;
+    return ( t.QuadPart /(OPJ_FLOAT64) freq.QuadPart ) ;
+#else
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (OPJ_FLOAT64)t.tv_sec + (OPJ_FLOAT64)t.tv_usec * 1e-6;
+#endif
+}
+
+OPJ_FLOAT64 opj_thread_cpu_clock(void) {
+#if defined(_WIN32)
+    FILETIME l_creation, l_exit, l_kernel, l_user;
+    if (! GetThreadTimes(GetCurrentThread(), &l_creation, &l_exit, &l_kernel, &l_user)) {
+        return 0.0;
+    }
+    /* FILETIME counts 100 ns intervals */
+    return ( (OPJ_FLOAT64)((((OPJ_UINT64)l_kernel.dwHighDateTime) << 32) | l_kernel.dwLowDateTime)
+           + (OPJ_FLOAT64)((((OPJ_UINT64)l_user.dwHighDateTime) << 32) | l_user.dwLowDateTime) ) * 1e-7;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec t;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t) != 0) {
+        return opj_clock();
+    }
+    return (OPJ_FLOAT64)t.tv_sec + (OPJ_FLOAT64)t.tv_nsec * 1e-9;
+#else
+    /* CPU time of the whole process */
+    return opj_clock();
+#endif
+}
+
+void opj_stage_clock_start(opj_stage_clock_t * p_clock) {
+    p_clock->wall = opj_wall_clock();
+    p_clock->cpu = opj_thread_cpu_clock();
+}
+
+static void opj_stage_stats_add(opj_stage_stats_t * p_stage, OPJ_FLOAT64 p_wall, OPJ_FLOAT64 p_cpu, OPJ_UINT64 p_nb_bytes) {
+    ++p_stage->nb_calls;
+    p_stage->wall_time += p_wall;
+    p_stage->cpu_time += p_cpu;
+    p_stage->nb_bytes += p_nb_bytes;
+}
+
+void opj_stage_clock_stop(  const opj_stage_clock_t * p_clock,
+                            opj_codec_stats_t * p_stats,
+                            OPJ_UINT32 p_tile_no,
+                            OPJ_CODEC_STAGE p_stage,
+                            OPJ_UINT64 p_nb_bytes) {
+    OPJ_FLOAT64 l_wall = opj_wall_clock() - p_clock->wall;
+    OPJ_FLOAT64 l_cpu = opj_thread_cpu_clock() - p_clock->cpu;
+
+    opj_stage_stats_add(&p_stats->total.stages[p_stage], l_wall, l_cpu, p_nb_bytes);
+    if (p_stats->tiles && p_tile_no < p_stats->nb_tiles) {
+        opj_stage_stats_add(&p_stats->tiles[p_tile_no].stages[p_stage], l_wall, l_cpu, p_nb_bytes);
+    }
+}
+
+void opj_codec_stats_count_alloc(opj_codec_stats_t * p_stats, OPJ_UINT32 p_tile_no, OPJ_SIZE_T p_size) {
+    ++p_stats->total.nb_allocs;
+    p_stats->total.alloc_bytes += p_size;
+    if (p_stats->tiles && p_tile_no < p_stats->nb_tiles) {
+        ++p_stats->tiles[p_tile_no].nb_allocs;
+        p_stats->tiles[p_tile_no].alloc_bytes += p_size;
+    }
+}
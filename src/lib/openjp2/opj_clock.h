@@ -34,7 +34,8 @@
 @file opj_clock.h
 @brief Internal function for timing
 
-The functions in OPJ_CLOCK.C are internal utilities mainly used for timing.
+The functions in OPJ_CLOCK.C are internal utilities mainly used for timing,
+and for collecting the codec statistics.
 */
 
 /** @defgroup MISC MISC - Miscellaneous internal functions */
@@ -50,6 +51,55 @@ Difference in successive opj_clock() calls tells you the elapsed time
 */
 OPJ_FLOAT64 opj_clock(void);
 
+/**
+Wall clock, difference in successive calls tells you the elapsed time
+@return Returns time in seconds
+*/
+OPJ_FLOAT64 opj_wall_clock(void);
+
+/**
+CPU time used by the calling thread
+@return Returns time in seconds
+*/
+OPJ_FLOAT64 opj_thread_cpu_clock(void);
+
+/**
+Start of a stage timed for the codec statistics
+*/
+typedef struct opj_stage_clock
+{
+	OPJ_FLOAT64 wall;
+	OPJ_FLOAT64 cpu;
+} opj_stage_clock_t;
+
+/**
+Starts timing a stage
+@param p_clock	clock to start
+*/
+void opj_stage_clock_start(opj_stage_clock_t * p_clock);
+
+/**
+Adds the time elapsed since opj_stage_clock_start to the figures of a stage, for the whole image and for the tile
+@param p_clock		clock started at the beginning of the stage
+@param p_stats		codec statistics
+@param p_tile_no	tile the stage has run for, or a value not lower than the number of tiles for the main header
+@param p_stage		stage that has run
+@param p_nb_bytes	bytes handled by the stage
+*/
+void opj_stage_clock_stop(	const opj_stage_clock_t * p_clock,
+							opj_codec_stats_t * p_stats,
+							OPJ_UINT32 p_tile_no,
+							OPJ_CODEC_STAGE p_stage,
+							OPJ_UINT64 p_nb_bytes);
+
+/**
+Counts an allocation made to set up a tile in the codec statistics
+@param p_stats		codec statistics
+@param p_tile_no	tile the allocation is made for
+@param p_size		bytes requested
+*/
+void opj_codec_stats_count_alloc(opj_codec_stats_t * p_stats, OPJ_UINT32 p_tile_no, OPJ_SIZE_T p_size);
+
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
@@ -61,6 +61,24 @@ typedef struct opj_codec_private
                                      opj_image_t * p_image,
                                      struct opj_event_mgr * p_manager);
 
+            /** Decoding function writing into a caller-provided interleaved buffer */
+            OPJ_BOOL (*opj_decode_to_buffer) ( void * p_codec,
+                                               struct opj_stream_private * p_cio,
+                                               opj_image_t * p_image,
+                                               OPJ_BYTE * p_buffer,
+                                               OPJ_UINT32 p_stride,
+                                               OPJ_PIXEL_FORMAT p_format,
+                                               struct opj_event_mgr * p_manager);
+
+            /** Decoding function handing the image strip by strip to a callback */
+            OPJ_BOOL (*opj_decode_strips) ( void * p_codec,
+                                            struct opj_stream_private * p_cio,
+                                            opj_image_t * p_image,
+                                            OPJ_UINT32 p_strip_height,
+                                            opj_strip_decode_fn p_strip_fn,
+                                            void * p_user_data,
+                                            struct opj_event_mgr * p_manager);
+
             /** FIXME DOC */
             OPJ_BOOL (*opj_read_tile_header)( void * p_codec,
                                               OPJ_UINT32 * p_tile_index,
@@ -91,7 +109,7 @@ typedef struct opj_codec_private
             void (*opj_destroy) (void * p_codec);
 
             /** Setup decoder function handler */
-            void (*opj_setup_decoder) ( void * p_codec, opj_dparameters_t * p_param);
+            OPJ_BOOL (*opj_setup_decoder) ( void * p_codec, opj_dparameters_t * p_param);
 
             /** Set decode area function handler */
             OPJ_BOOL (*opj_set_decode_area) ( void * p_codec,
@@ -113,6 +131,12 @@ typedef struct opj_codec_private
             OPJ_BOOL (*opj_set_decoded_resolution_factor) ( void * p_codec,
                                                             OPJ_UINT32 res_factor,
                                                             opj_event_mgr_t * p_manager);
+
+            /** Set the decoded components */
+            OPJ_BOOL (*opj_set_decoded_components) ( void * p_codec,
+                                                     OPJ_UINT32 numcomps,
+                                                     const OPJ_UINT32 * comps_indices,
+                                                     opj_event_mgr_t * p_manager);
         } m_decompression;
 
         /**
@@ -136,6 +160,12 @@ typedef struct opj_codec_private
                                           struct opj_stream_private * p_cio,
                                           struct opj_event_mgr * p_manager);
 
+            OPJ_BOOL (* opj_write_strip) ( void * p_codec,
+                                           OPJ_INT32 ** p_comps_data,
+                                           OPJ_UINT32 p_nb_rows,
+                                           struct opj_stream_private * p_cio,
+                                           struct opj_event_mgr * p_manager);
+
             OPJ_BOOL (* opj_end_compress) (	void * p_codec,
                                             struct opj_stream_private * p_cio,
                                             struct opj_event_mgr * p_manager);
@@ -157,6 +187,10 @@ typedef struct opj_codec_private
     void (*opj_dump_codec) (void * p_codec, OPJ_INT32 info_flag, FILE* output_stream);
     opj_codestream_info_v2_t* (*opj_get_codec_info)(void* p_codec);
     opj_codestream_index_t* (*opj_get_codec_index)(void* p_codec);
+    OPJ_BOOL (*opj_save_codec_index)(void* p_codec, struct opj_stream_private * p_index_stream, OPJ_UINT64 p_stamp, struct opj_event_mgr * p_manager);
+    OPJ_BOOL (*opj_load_codec_index)(void* p_codec, struct opj_stream_private * p_index_stream, OPJ_UINT64 p_stamp, struct opj_event_mgr * p_manager);
+    OPJ_BOOL (*opj_set_codec_stats)(void* p_codec, OPJ_BOOL p_enable, struct opj_event_mgr * p_manager);
+    opj_codec_stats_t* (*opj_get_codec_stats)(void* p_codec);
 }
 opj_codec_private_t;
 
@@ -57,23 +57,80 @@ Get next packet in resolution-layer-component-precinct order.
 */
 static OPJ_BOOL opj_pi_next_rlcp(opj_pi_iterator_t * pi);
 /**
-Get next packet in resolution-precinct-component-layer order.
+Get next packet in resolution-precinct-component-layer, precinct-component-resolution-layer
+or component-precinct-resolution-layer order, from the precincts listed by opj_pi_build_positions.
 @param pi packet iterator to modify
 @return returns false if pi pointed to the last packet or else returns true
 */
-static OPJ_BOOL opj_pi_next_rpcl(opj_pi_iterator_t * pi);
+static OPJ_BOOL opj_pi_next_position(opj_pi_iterator_t * pi);
+
 /**
-Get next packet in precinct-component-resolution-layer order.
-@param pi packet iterator to modify
-@return returns false if pi pointed to the last packet or else returns true
+Precinct grid of a component at a resolution, used to list the precincts of a position-driven progression
+*/
+typedef struct opj_pi_prc_grid {
+	OPJ_UINT32 compno, resno;
+	/** size of a sample of the resolution on the reference grid */
+	OPJ_INT32 dx, dy;
+	/** log2 of the precinct size in the resolution */
+	OPJ_INT32 pdx, pdy;
+	/** top left corner of the resolution */
+	OPJ_INT32 trx0, try0;
+	/** size of a precinct on the reference grid */
+	OPJ_INT32 prc_x, prc_y;
+	/** true if a partial precinct starts at the top left corner of the tile */
+	OPJ_BOOL partial_x, partial_y;
+	/** number of precincts in width */
+	OPJ_UINT32 pw;
+	/** positions where a precinct starts on the reference grid, in increasing order */
+	OPJ_INT32 *xs, *ys;
+	OPJ_UINT32 nb_x, nb_y;
+	/** state of opj_pi_merge_prc_grids */
+	OPJ_UINT32 cur_x, cur_y;
+	OPJ_INT32 prcj;
+	OPJ_BOOL active;
+} opj_pi_prc_grid_t;
+
+/**
+Lists the precincts visited by a position-driven progression (RPCL, PCRL or CPRL) in pi->positions.
+The list is built once for the ranges of pi->poc, so that the packets are then iterated
+without stepping through the reference grid.
+@param pi packet iterator to update
+@return false if the list could not be allocated
 */
-static OPJ_BOOL opj_pi_next_pcrl(opj_pi_iterator_t * pi);
+static OPJ_BOOL opj_pi_build_positions(opj_pi_iterator_t * pi);
 /**
-Get next packet in component-precinct-resolution-layer order.
-@param pi packet iterator to modify
-@return returns false if pi pointed to the last packet or else returns true
+Sets up the precinct grid of a component at a resolution.
+@return false if the component has no precinct to visit at this resolution
 */
-static OPJ_BOOL opj_pi_next_cprl(opj_pi_iterator_t * pi);
+static OPJ_BOOL opj_pi_init_prc_grid(const opj_pi_iterator_t * pi, OPJ_UINT32 compno, OPJ_UINT32 resno, opj_pi_prc_grid_t * grid);
+/**
+Gets the step of the reference grid visited for the components compno0 to compno1-1, i.e. their smallest precinct size.
+@return false if no precinct size fits the reference grid
+*/
+static OPJ_BOOL opj_pi_get_grid_step(const opj_pi_iterator_t * pi, OPJ_UINT32 compno0, OPJ_UINT32 compno1, OPJ_INT32 * p_step_x, OPJ_INT32 * p_step_y);
+/**
+Gets the maximum number of positions returned by opj_pi_get_prc_positions.
+*/
+static OPJ_UINT32 opj_pi_get_max_prc_positions(OPJ_INT32 start, OPJ_INT32 end, OPJ_INT32 prc_size);
+/**
+Lists, in increasing order, the positions of the range [start, end) visited with the given step
+where a precinct of the given size starts.
+@param positions	array receiving the positions
+@param start		start of the range
+@param end			end of the range
+@param tile_start	start of the tile
+@param step			step of the visited grid
+@param prc_size		precinct size
+@param partial		true if a partial precinct starts at tile_start
+@return the number of positions
+*/
+static OPJ_UINT32 opj_pi_get_prc_positions(OPJ_INT32 * positions, OPJ_INT32 start, OPJ_INT32 end, OPJ_INT32 tile_start,
+                                           OPJ_INT32 step, OPJ_INT32 prc_size, OPJ_BOOL partial);
+/**
+Appends to pi->positions the precincts of the given grids, ordered by position then by grid.
+@return false if pi->positions could not be grown
+*/
+static OPJ_BOOL opj_pi_merge_prc_grids(opj_pi_iterator_t * pi, opj_pi_prc_grid_t ** grids, OPJ_UINT32 nb_grids);
 
 /**
  * Updates the coding parameters if the encoding is used with Progression order changes and final (or cinema parameters are used).
@@ -309,247 +366,350 @@ LABEL_SKIP:;
 	return OPJ_FALSE;
 }
 
-OPJ_BOOL opj_pi_next_rpcl(opj_pi_iterator_t * pi) {
-	opj_pi_comp_t *comp = NULL;
-	opj_pi_resolution_t *res = NULL;
+OPJ_BOOL opj_pi_next_position(opj_pi_iterator_t * pi) {
 	OPJ_UINT32 index = 0;
 
-	if (!pi->first) {
-		goto LABEL_SKIP;
-	} else {
-		OPJ_UINT32 compno, resno;
+	if (pi->first) {
 		pi->first = 0;
-		pi->dx = 0;
-		pi->dy = 0;
-		for (compno = 0; compno < pi->numcomps; compno++) {
-			comp = &pi->comps[compno];
-			for (resno = 0; resno < comp->numresolutions; resno++) {
-				OPJ_UINT32 dx, dy;
-				res = &comp->resolutions[resno];
-				dx = comp->dx * (1u << (res->pdx + comp->numresolutions - 1 - resno));
-				dy = comp->dy * (1u << (res->pdy + comp->numresolutions - 1 - resno));
-				pi->dx = !pi->dx ? dx : opj_uint_min(pi->dx, dx);
-				pi->dy = !pi->dy ? dy : opj_uint_min(pi->dy, dy);
-			}
-		}
+		pi->position_no = 0;
+		pi->layno = pi->poc.layno0;
+	} else {
+		++pi->layno;
 	}
-if (!pi->tp_on){
-			pi->poc.ty0 = pi->ty0;
-			pi->poc.tx0 = pi->tx0;
-			pi->poc.ty1 = pi->ty1;
-			pi->poc.tx1 = pi->tx1;
-		}
-	for (pi->resno = pi->poc.resno0; pi->resno < pi->poc.resno1; pi->resno++) {
-		for (pi->y = pi->poc.ty0; pi->y < pi->poc.ty1; pi->y += (OPJ_INT32)(pi->dy - (OPJ_UINT32)(pi->y % (OPJ_INT32)pi->dy))) {
-			for (pi->x = pi->poc.tx0; pi->x < pi->poc.tx1; pi->x += (OPJ_INT32)(pi->dx - (OPJ_UINT32)(pi->x % (OPJ_INT32)pi->dx))) {
-				for (pi->compno = pi->poc.compno0; pi->compno < pi->poc.compno1; pi->compno++) {
-					OPJ_UINT32 levelno;
-					OPJ_INT32 trx0, try0;
-					OPJ_INT32  trx1, try1;
-					OPJ_UINT32  rpx, rpy;
-					OPJ_INT32  prci, prcj;
-					comp = &pi->comps[pi->compno];
-					if (pi->resno >= comp->numresolutions) {
-						continue;
-					}
-					res = &comp->resolutions[pi->resno];
-					levelno = comp->numresolutions - 1 - pi->resno;
-					trx0 = opj_int_ceildiv(pi->tx0, (OPJ_INT32)(comp->dx << levelno));
-					try0 = opj_int_ceildiv(pi->ty0, (OPJ_INT32)(comp->dy << levelno));
-					trx1 = opj_int_ceildiv(pi->tx1, (OPJ_INT32)(comp->dx << levelno));
-					try1 = opj_int_ceildiv(pi->ty1, (OPJ_INT32)(comp->dy << levelno));
-					rpx = res->pdx + levelno;
-					rpy = res->pdy + levelno;
-					if (!((pi->y % (OPJ_INT32)(comp->dy << rpy) == 0) || ((pi->y == pi->ty0) && ((try0 << levelno) % (1 << rpy))))){
-						continue;	
-					}
-					if (!((pi->x % (OPJ_INT32)(comp->dx << rpx) == 0) || ((pi->x == pi->tx0) && ((trx0 << levelno) % (1 << rpx))))){
-						continue;
-					}
-					
-					if ((res->pw==0)||(res->ph==0)) continue;
-					
-					if ((trx0==trx1)||(try0==try1)) continue;
-					
-					prci = opj_int_floordivpow2(opj_int_ceildiv(pi->x, (OPJ_INT32)(comp->dx << levelno)), (OPJ_INT32)res->pdx)
-						 - opj_int_floordivpow2(trx0, (OPJ_INT32)res->pdx);
-					prcj = opj_int_floordivpow2(opj_int_ceildiv(pi->y, (OPJ_INT32)(comp->dy << levelno)), (OPJ_INT32)res->pdy)
-						 - opj_int_floordivpow2(try0, (OPJ_INT32)res->pdy);
-					pi->precno = (OPJ_UINT32)(prci + prcj * (OPJ_INT32)res->pw);
-					for (pi->layno = pi->poc.layno0; pi->layno < pi->poc.layno1; pi->layno++) {
-						index = pi->layno * pi->step_l + pi->resno * pi->step_r + pi->compno * pi->step_c + pi->precno * pi->step_p;
-						if (!pi->include[index]) {
-							pi->include[index] = 1;
-							return OPJ_TRUE;
-						}
-LABEL_SKIP:;
-					}
-				}
+
+	for (; pi->position_no < pi->nb_positions; ++pi->position_no, pi->layno = pi->poc.layno0) {
+		const opj_pi_position_t *l_position = &pi->positions[pi->position_no];
+		pi->resno = l_position->resno;
+		pi->compno = l_position->compno;
+		pi->precno = l_position->precno;
+		for (; pi->layno < pi->poc.layno1; pi->layno++) {
+			index = pi->layno * pi->step_l + pi->resno * pi->step_r + pi->compno * pi->step_c + pi->precno * pi->step_p;
+			if (!pi->include[index]) {
+				pi->include[index] = 1;
+				return OPJ_TRUE;
 			}
 		}
 	}
-	
+
 	return OPJ_FALSE;
 }
 
-OPJ_BOOL opj_pi_next_pcrl(opj_pi_iterator_t * pi) {
-	opj_pi_comp_t *comp = NULL;
-	opj_pi_resolution_t *res = NULL;
-	OPJ_UINT32 index = 0;
+OPJ_BOOL opj_pi_init_prc_grid(const opj_pi_iterator_t * pi, OPJ_UINT32 compno, OPJ_UINT32 resno, opj_pi_prc_grid_t * grid)
+{
+	const opj_pi_comp_t *comp = &pi->comps[compno];
+	const opj_pi_resolution_t *res = &comp->resolutions[resno];
+	OPJ_UINT32 levelno = comp->numresolutions - 1 - resno;
+	OPJ_UINT32 rpx = res->pdx + levelno;
+	OPJ_UINT32 rpy = res->pdy + levelno;
+	OPJ_INT32 trx1, try1;
+
+	/* precincts that do not fit the reference grid cannot be visited */
+	if (rpx >= 31 || rpy >= 31 || comp->dx == 0 || comp->dy == 0 ||
+		comp->dx > (0x7fffffffU >> rpx) || comp->dy > (0x7fffffffU >> rpy)) {
+		return OPJ_FALSE;
+	}
+	if ((res->pw==0)||(res->ph==0)) {
+		return OPJ_FALSE;
+	}
 
-	if (!pi->first) {
-		comp = &pi->comps[pi->compno];
-		goto LABEL_SKIP;
-	} else {
-		OPJ_UINT32 compno, resno;
-		pi->first = 0;
-		pi->dx = 0;
-		pi->dy = 0;
-		for (compno = 0; compno < pi->numcomps; compno++) {
-			comp = &pi->comps[compno];
-			for (resno = 0; resno < comp->numresolutions; resno++) {
-				OPJ_UINT32 dx, dy;
-				res = &comp->resolutions[resno];
-				dx = comp->dx * (1u << (res->pdx + comp->numresolutions - 1 - resno));
-				dy = comp->dy * (1u << (res->pdy + comp->numresolutions - 1 - resno));
-				pi->dx = !pi->dx ? dx : opj_uint_min(pi->dx, dx);
-				pi->dy = !pi->dy ? dy : opj_uint_min(pi->dy, dy);
+	grid->compno = compno;
+	grid->resno = resno;
+	grid->dx = (OPJ_INT32)(comp->dx << levelno);
+	grid->dy = (OPJ_INT32)(comp->dy << levelno);
+	grid->pdx = (OPJ_INT32)res->pdx;
+	grid->pdy = (OPJ_INT32)res->pdy;
+	grid->trx0 = opj_int_ceildiv(pi->tx0, grid->dx);
+	grid->try0 = opj_int_ceildiv(pi->ty0, grid->dy);
+	trx1 = opj_int_ceildiv(pi->tx1, grid->dx);
+	try1 = opj_int_ceildiv(pi->ty1, grid->dy);
+	if ((grid->trx0==trx1)||(grid->try0==try1)) {
+		return OPJ_FALSE;
+	}
+	grid->prc_x = (OPJ_INT32)(comp->dx << rpx);
+	grid->prc_y = (OPJ_INT32)(comp->dy << rpy);
+	grid->partial_x = ((grid->trx0 << levelno) % (1 << rpx)) != 0;
+	grid->partial_y = ((grid->try0 << levelno) % (1 << rpy)) != 0;
+	grid->pw = res->pw;
+	grid->nb_x = 0;
+	grid->nb_y = 0;
+
+	return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_pi_get_grid_step(const opj_pi_iterator_t * pi, OPJ_UINT32 compno0, OPJ_UINT32 compno1, OPJ_INT32 * p_step_x, OPJ_INT32 * p_step_y)
+{
+	OPJ_UINT32 compno, resno;
+	OPJ_INT32 l_step_x = 0, l_step_y = 0;
+
+	for (compno = compno0; compno < compno1; compno++) {
+		const opj_pi_comp_t *comp = &pi->comps[compno];
+		for (resno = 0; resno < comp->numresolutions; resno++) {
+			const opj_pi_resolution_t *res = &comp->resolutions[resno];
+			OPJ_UINT32 rpx = res->pdx + comp->numresolutions - 1 - resno;
+			OPJ_UINT32 rpy = res->pdy + comp->numresolutions - 1 - resno;
+			if (rpx < 31 && comp->dx != 0 && comp->dx <= (0x7fffffffU >> rpx)) {
+				OPJ_INT32 dx = (OPJ_INT32)(comp->dx << rpx);
+				l_step_x = !l_step_x ? dx : opj_int_min(l_step_x, dx);
+			}
+			if (rpy < 31 && comp->dy != 0 && comp->dy <= (0x7fffffffU >> rpy)) {
+				OPJ_INT32 dy = (OPJ_INT32)(comp->dy << rpy);
+				l_step_y = !l_step_y ? dy : opj_int_min(l_step_y, dy);
 			}
 		}
 	}
-	if (!pi->tp_on){
-			pi->poc.ty0 = pi->ty0;
-			pi->poc.tx0 = pi->tx0;
-			pi->poc.ty1 = pi->ty1;
-			pi->poc.tx1 = pi->tx1;
+	*p_step_x = l_step_x;
+	*p_step_y = l_step_y;
+
+	return l_step_x != 0 && l_step_y != 0;
+}
+
+OPJ_UINT32 opj_pi_get_max_prc_positions(OPJ_INT32 start, OPJ_INT32 end, OPJ_INT32 prc_size)
+{
+	if (start >= end) {
+		return 0;
+	}
+	/* the precinct boundaries of the range, plus the start of the range and of the tile */
+	return (OPJ_UINT32)(((OPJ_INT64)end - start) / prc_size + 3);
+}
+
+OPJ_UINT32 opj_pi_get_prc_positions(OPJ_INT32 * positions, OPJ_INT32 start, OPJ_INT32 end, OPJ_INT32 tile_start,
+                                    OPJ_INT32 step, OPJ_INT32 prc_size, OPJ_BOOL partial)
+{
+	OPJ_UINT32 l_nb = 0;
+	OPJ_INT64 l_next, l_pos;
+	OPJ_BOOL l_tile_start;
+
+	if (start >= end) {
+		return 0;
+	}
+	/* the grid is visited from start, then on the multiples of step following it */
+	if ((start % prc_size == 0) || ((start == tile_start) && partial)) {
+		positions[l_nb++] = start;
+	}
+	l_next = (OPJ_INT64)(start / step) * step + step;
+	l_tile_start = partial && tile_start >= l_next && tile_start < end &&
+		(tile_start % step == 0) && (tile_start % prc_size != 0);
+
+	l_pos = l_next - (((l_next % prc_size) + prc_size) % prc_size);
+	if (l_pos < l_next) {
+		l_pos += prc_size;
+	}
+	for (; l_pos < end; l_pos += prc_size) {
+		if (l_tile_start && tile_start < l_pos) {
+			positions[l_nb++] = tile_start;
+			l_tile_start = OPJ_FALSE;
 		}
-	for (pi->y = pi->poc.ty0; pi->y < pi->poc.ty1; pi->y += (OPJ_INT32)(pi->dy - (OPJ_UINT32)(pi->y % (OPJ_INT32)pi->dy))) {
-		for (pi->x = pi->poc.tx0; pi->x < pi->poc.tx1; pi->x += (OPJ_INT32)(pi->dx - (OPJ_UINT32)(pi->x % (OPJ_INT32)pi->dx))) {
-			for (pi->compno = pi->poc.compno0; pi->compno < pi->poc.compno1; pi->compno++) {
-				comp = &pi->comps[pi->compno];
-				for (pi->resno = pi->poc.resno0; pi->resno < opj_uint_min(pi->poc.resno1, comp->numresolutions); pi->resno++) {
-					OPJ_UINT32 levelno;
-					OPJ_INT32 trx0, try0;
-					OPJ_INT32 trx1, try1;
-					OPJ_UINT32 rpx, rpy;
-					OPJ_INT32 prci, prcj;
-					res = &comp->resolutions[pi->resno];
-					levelno = comp->numresolutions - 1 - pi->resno;
-					trx0 = opj_int_ceildiv(pi->tx0, (OPJ_INT32)(comp->dx << levelno));
-					try0 = opj_int_ceildiv(pi->ty0, (OPJ_INT32)(comp->dy << levelno));
-					trx1 = opj_int_ceildiv(pi->tx1, (OPJ_INT32)(comp->dx << levelno));
-					try1 = opj_int_ceildiv(pi->ty1, (OPJ_INT32)(comp->dy << levelno));
-					rpx = res->pdx + levelno;
-					rpy = res->pdy + levelno;
-					if (!((pi->y % (OPJ_INT32)(comp->dy << rpy) == 0) || ((pi->y == pi->ty0) && ((try0 << levelno) % (1 << rpy))))){
-						continue;	
-					}
-					if (!((pi->x % (OPJ_INT32)(comp->dx << rpx) == 0) || ((pi->x == pi->tx0) && ((trx0 << levelno) % (1 << rpx))))){
-						continue;
-					}
-					
-					if ((res->pw==0)||(res->ph==0)) continue;
-					
-					if ((trx0==trx1)||(try0==try1)) continue;
-					
-					prci = opj_int_floordivpow2(opj_int_ceildiv(pi->x, (OPJ_INT32)(comp->dx << levelno)), (OPJ_INT32)res->pdx)
-						 - opj_int_floordivpow2(trx0, (OPJ_INT32)res->pdx);
-					prcj = opj_int_floordivpow2(opj_int_ceildiv(pi->y, (OPJ_INT32)(comp->dy << levelno)), (OPJ_INT32)res->pdy)
-						 - opj_int_floordivpow2(try0, (OPJ_INT32)res->pdy);
-					pi->precno = (OPJ_UINT32)(prci + prcj * (OPJ_INT32)res->pw);
-					for (pi->layno = pi->poc.layno0; pi->layno < pi->poc.layno1; pi->layno++) {
-						index = pi->layno * pi->step_l + pi->resno * pi->step_r + pi->compno * pi->step_c + pi->precno * pi->step_p;
-						if (!pi->include[index]) {
-							pi->include[index] = 1;
-							return OPJ_TRUE;
-						}	
-LABEL_SKIP:;
-					}
+		if (l_pos % step == 0) {
+			positions[l_nb++] = (OPJ_INT32)l_pos;
+		}
+	}
+	if (l_tile_start) {
+		positions[l_nb++] = tile_start;
+	}
+
+	return l_nb;
+}
+
+OPJ_BOOL opj_pi_merge_prc_grids(opj_pi_iterator_t * pi, opj_pi_prc_grid_t ** grids, OPJ_UINT32 nb_grids)
+{
+	OPJ_UINT32 i;
+	OPJ_UINT64 l_nb_positions = pi->nb_positions;
+
+	/* every precinct of a grid is visited once for each of its rows */
+	for (i = 0; i < nb_grids; ++i) {
+		l_nb_positions += (OPJ_UINT64)grids[i]->nb_x * grids[i]->nb_y;
+		grids[i]->cur_y = 0;
+	}
+	if (l_nb_positions > pi->max_positions) {
+		opj_pi_position_t *l_new_positions;
+		if (l_nb_positions > (OPJ_UINT32)-1 || l_nb_positions > ((OPJ_SIZE_T)-1) / sizeof(opj_pi_position_t)) {
+			return OPJ_FALSE;
+		}
+		l_new_positions = (opj_pi_position_t *) opj_realloc(pi->positions, (OPJ_SIZE_T)l_nb_positions * sizeof(opj_pi_position_t));
+		if (!l_new_positions) {
+			return OPJ_FALSE;
+		}
+		pi->positions = l_new_positions;
+		pi->max_positions = (OPJ_UINT32)l_nb_positions;
+	}
+
+	for (;;) {
+		OPJ_INT32 x = 0, y = 0;
+		OPJ_BOOL l_found = OPJ_FALSE;
+
+		for (i = 0; i < nb_grids; ++i) {
+			const opj_pi_prc_grid_t *l_grid = grids[i];
+			if (l_grid->cur_y < l_grid->nb_y && (!l_found || l_grid->ys[l_grid->cur_y] < y)) {
+				y = l_grid->ys[l_grid->cur_y];
+				l_found = OPJ_TRUE;
+			}
+		}
+		if (!l_found) {
+			break;
+		}
+		for (i = 0; i < nb_grids; ++i) {
+			opj_pi_prc_grid_t *l_grid = grids[i];
+			l_grid->active = l_grid->cur_y < l_grid->nb_y && l_grid->ys[l_grid->cur_y] == y;
+			if (l_grid->active) {
+				l_grid->prcj = opj_int_floordivpow2(opj_int_ceildiv(y, l_grid->dy), l_grid->pdy)
+					 - opj_int_floordivpow2(l_grid->try0, l_grid->pdy);
+				l_grid->cur_x = 0;
+				++l_grid->cur_y;
+			}
+		}
+
+		for (;;) {
+			l_found = OPJ_FALSE;
+			for (i = 0; i < nb_grids; ++i) {
+				const opj_pi_prc_grid_t *l_grid = grids[i];
+				if (l_grid->active && l_grid->cur_x < l_grid->nb_x && (!l_found || l_grid->xs[l_grid->cur_x] < x)) {
+					x = l_grid->xs[l_grid->cur_x];
+					l_found = OPJ_TRUE;
+				}
+			}
+			if (!l_found) {
+				break;
+			}
+			for (i = 0; i < nb_grids; ++i) {
+				opj_pi_prc_grid_t *l_grid = grids[i];
+				if (l_grid->active && l_grid->cur_x < l_grid->nb_x && l_grid->xs[l_grid->cur_x] == x) {
+					opj_pi_position_t *l_position = &pi->positions[pi->nb_positions++];
+					OPJ_INT32 prci = opj_int_floordivpow2(opj_int_ceildiv(x, l_grid->dx), l_grid->pdx)
+						 - opj_int_floordivpow2(l_grid->trx0, l_grid->pdx);
+					l_position->resno = l_grid->resno;
+					l_position->compno = l_grid->compno;
+					l_position->precno = (OPJ_UINT32)(prci + l_grid->prcj * (OPJ_INT32)l_grid->pw);
+					++l_grid->cur_x;
 				}
 			}
 		}
 	}
-	
-	return OPJ_FALSE;
+
+	return OPJ_TRUE;
 }
 
-OPJ_BOOL opj_pi_next_cprl(opj_pi_iterator_t * pi) {
-	opj_pi_comp_t *comp = NULL;
-	opj_pi_resolution_t *res = NULL;
-	OPJ_UINT32 index = 0;
+OPJ_BOOL opj_pi_build_positions(opj_pi_iterator_t * pi)
+{
+	OPJ_UINT32 compno, resno, i;
+	OPJ_UINT32 l_compno1, l_max_res = 0;
+	OPJ_UINT32 l_nb_grids = 0, l_nb_group;
+	OPJ_UINT64 l_nb_coords = 0;
+	OPJ_INT32 l_step_x = 0, l_step_y = 0;
+	OPJ_BOOL l_has_step = OPJ_FALSE;
+	opj_pi_prc_grid_t *l_grids = 00;
+	opj_pi_prc_grid_t **l_group = 00;
+	OPJ_INT32 *l_coords = 00;
+	OPJ_INT32 *l_current_coord = 00;
+	OPJ_BOOL l_result = OPJ_TRUE;
+
+	pi->nb_positions = 0;
+	if (pi->poc.prg != OPJ_RPCL && pi->poc.prg != OPJ_PCRL && pi->poc.prg != OPJ_CPRL) {
+		return OPJ_TRUE;
+	}
+	if (!pi->tp_on){
+		pi->poc.ty0 = pi->ty0;
+		pi->poc.tx0 = pi->tx0;
+		pi->poc.ty1 = pi->ty1;
+		pi->poc.tx1 = pi->tx1;
+	}
 
-	if (!pi->first) {
-		comp = &pi->comps[pi->compno];
-		goto LABEL_SKIP;
-	} else {
-		pi->first = 0;
+	l_compno1 = opj_uint_min(pi->poc.compno1, pi->numcomps);
+	for (compno = pi->poc.compno0; compno < l_compno1; compno++) {
+		l_max_res = opj_uint_max(l_max_res, pi->comps[compno].numresolutions);
+	}
+	if (!l_max_res) {
+		return OPJ_TRUE;
 	}
 
-	for (pi->compno = pi->poc.compno0; pi->compno < pi->poc.compno1; pi->compno++) {
-		OPJ_UINT32 resno;
-		comp = &pi->comps[pi->compno];
-		pi->dx = 0;
-		pi->dy = 0;
-		for (resno = 0; resno < comp->numresolutions; resno++) {
-			OPJ_UINT32 dx, dy;
-			res = &comp->resolutions[resno];
-			dx = comp->dx * (1u << (res->pdx + comp->numresolutions - 1 - resno));
-			dy = comp->dy * (1u << (res->pdy + comp->numresolutions - 1 - resno));
-			pi->dx = !pi->dx ? dx : opj_uint_min(pi->dx, dx);
-			pi->dy = !pi->dy ? dy : opj_uint_min(pi->dy, dy);
+	l_grids = (opj_pi_prc_grid_t *) opj_malloc((l_compno1 - pi->poc.compno0) * l_max_res * sizeof(opj_pi_prc_grid_t));
+	l_group = (opj_pi_prc_grid_t **) opj_malloc((l_compno1 - pi->poc.compno0) * l_max_res * sizeof(opj_pi_prc_grid_t *));
+	if (!l_grids || !l_group) {
+		opj_free(l_grids);
+		opj_free(l_group);
+		return OPJ_FALSE;
+	}
+
+	/* precinct grids of the progression, in component-resolution order */
+	for (compno = pi->poc.compno0; compno < l_compno1; compno++) {
+		OPJ_UINT32 l_resno1 = opj_uint_min(pi->poc.resno1, pi->comps[compno].numresolutions);
+		for (resno = pi->poc.resno0; resno < l_resno1; resno++) {
+			opj_pi_prc_grid_t *l_grid = &l_grids[l_nb_grids];
+			if (opj_pi_init_prc_grid(pi, compno, resno, l_grid)) {
+				l_nb_coords += opj_pi_get_max_prc_positions(pi->poc.tx0, pi->poc.tx1, l_grid->prc_x);
+				l_nb_coords += opj_pi_get_max_prc_positions(pi->poc.ty0, pi->poc.ty1, l_grid->prc_y);
+				++l_nb_grids;
+			}
 		}
-		if (!pi->tp_on){
-			pi->poc.ty0 = pi->ty0;
-			pi->poc.tx0 = pi->tx0;
-			pi->poc.ty1 = pi->ty1;
-			pi->poc.tx1 = pi->tx1;
+	}
+	if (l_nb_coords) {
+		if (l_nb_coords > ((OPJ_SIZE_T)-1) / sizeof(OPJ_INT32)) {
+			l_result = OPJ_FALSE;
 		}
-		for (pi->y = pi->poc.ty0; pi->y < pi->poc.ty1; pi->y += (OPJ_INT32)(pi->dy - (OPJ_UINT32)(pi->y % (OPJ_INT32)pi->dy))) {
-			for (pi->x = pi->poc.tx0; pi->x < pi->poc.tx1; pi->x += (OPJ_INT32)(pi->dx - (OPJ_UINT32)(pi->x % (OPJ_INT32)pi->dx))) {
-				for (pi->resno = pi->poc.resno0; pi->resno < opj_uint_min(pi->poc.resno1, comp->numresolutions); pi->resno++) {
-					OPJ_UINT32 levelno;
-					OPJ_INT32 trx0, try0;
-					OPJ_INT32 trx1, try1;
-					OPJ_UINT32 rpx, rpy;
-					OPJ_INT32 prci, prcj;
-					res = &comp->resolutions[pi->resno];
-					levelno = comp->numresolutions - 1 - pi->resno;
-					trx0 = opj_int_ceildiv(pi->tx0, (OPJ_INT32)(comp->dx << levelno));
-					try0 = opj_int_ceildiv(pi->ty0, (OPJ_INT32)(comp->dy << levelno));
-					trx1 = opj_int_ceildiv(pi->tx1, (OPJ_INT32)(comp->dx << levelno));
-					try1 = opj_int_ceildiv(pi->ty1, (OPJ_INT32)(comp->dy << levelno));
-					rpx = res->pdx + levelno;
-					rpy = res->pdy + levelno;
-					if (!((pi->y % (OPJ_INT32)(comp->dy << rpy) == 0) || ((pi->y == pi->ty0) && ((try0 << levelno) % (1 << rpy))))){
-						continue;	
-					}
-					if (!((pi->x % (OPJ_INT32)(comp->dx << rpx) == 0) || ((pi->x == pi->tx0) && ((trx0 << levelno) % (1 << rpx))))){
-						continue;
-					}
-					
-					if ((res->pw==0)||(res->ph==0)) continue;
-					
-					if ((trx0==trx1)||(try0==try1)) continue;
-					
-					prci = opj_int_floordivpow2(opj_int_ceildiv(pi->x, (OPJ_INT32)(comp->dx << levelno)), (OPJ_INT32)res->pdx)
-						 - opj_int_floordivpow2(trx0, (OPJ_INT32)res->pdx);
-					prcj = opj_int_floordivpow2(opj_int_ceildiv(pi->y, (OPJ_INT32)(comp->dy << levelno)), (OPJ_INT32)res->pdy)
-						 - opj_int_floordivpow2(try0, (OPJ_INT32)res->pdy);
-					pi->precno = (OPJ_UINT32)(prci + prcj * (OPJ_INT32)res->pw);
-					for (pi->layno = pi->poc.layno0; pi->layno < pi->poc.layno1; pi->layno++) {
-						index = pi->layno * pi->step_l + pi->resno * pi->step_r + pi->compno * pi->step_c + pi->precno * pi->step_p;
-						if (!pi->include[index]) {
-							pi->include[index] = 1;
-							return OPJ_TRUE;
+		else {
+			l_coords = (OPJ_INT32 *) opj_malloc((OPJ_SIZE_T)l_nb_coords * sizeof(OPJ_INT32));
+			l_result = l_coords != 00;
+		}
+	}
+
+	/* positions of the precincts on the grid visited by the progression */
+	l_current_coord = l_coords;
+	for (i = 0; l_result && i < l_nb_grids; ++i) {
+		opj_pi_prc_grid_t *l_grid = &l_grids[i];
+		if (i == 0) {
+			l_has_step = opj_pi_get_grid_step(pi, 0, pi->numcomps, &l_step_x, &l_step_y);
+		}
+		if (pi->poc.prg == OPJ_CPRL && (i == 0 || l_grid->compno != l_grids[i - 1].compno)) {
+			l_has_step = opj_pi_get_grid_step(pi, l_grid->compno, l_grid->compno + 1, &l_step_x, &l_step_y);
+		}
+		if (!l_has_step) {
+			continue;
+		}
+		l_grid->xs = l_current_coord;
+		l_grid->nb_x = opj_pi_get_prc_positions(l_grid->xs, pi->poc.tx0, pi->poc.tx1, pi->tx0, l_step_x, l_grid->prc_x, l_grid->partial_x);
+		l_current_coord += opj_pi_get_max_prc_positions(pi->poc.tx0, pi->poc.tx1, l_grid->prc_x);
+		l_grid->ys = l_current_coord;
+		l_grid->nb_y = opj_pi_get_prc_positions(l_grid->ys, pi->poc.ty0, pi->poc.ty1, pi->ty0, l_step_y, l_grid->prc_y, l_grid->partial_y);
+		l_current_coord += opj_pi_get_max_prc_positions(pi->poc.ty0, pi->poc.ty1, l_grid->prc_y);
+	}
+
+	/* precincts in the order of the progression */
+	if (l_result) {
+		switch (pi->poc.prg) {
+			case OPJ_RPCL:
+				for (resno = pi->poc.resno0; l_result && resno < opj_uint_min(pi->poc.resno1, l_max_res); resno++) {
+					l_nb_group = 0;
+					for (i = 0; i < l_nb_grids; ++i) {
+						if (l_grids[i].resno == resno) {
+							l_group[l_nb_group++] = &l_grids[i];
 						}
-LABEL_SKIP:;
 					}
+					l_result = opj_pi_merge_prc_grids(pi, l_group, l_nb_group);
 				}
-			}
+				break;
+			case OPJ_PCRL:
+				for (i = 0; i < l_nb_grids; ++i) {
+					l_group[i] = &l_grids[i];
+				}
+				l_result = opj_pi_merge_prc_grids(pi, l_group, l_nb_grids);
+				break;
+			default:
+				for (i = 0; l_result && i < l_nb_grids; ) {
+					compno = l_grids[i].compno;
+					l_nb_group = 0;
+					while (i < l_nb_grids && l_grids[i].compno == compno) {
+						l_group[l_nb_group++] = &l_grids[i++];
+					}
+					l_result = opj_pi_merge_prc_grids(pi, l_group, l_nb_group);
+				}
+				break;
 		}
 	}
-	
-	return OPJ_FALSE;
+
+	opj_free(l_coords);
+	opj_free(l_group);
+	opj_free(l_grids);
+
+	return l_result;
 }
 
 void opj_get_encoding_parameters(	const opj_image_t *p_image,
@@ -1341,6 +1501,12 @@ opj_pi_iterator_t *opj_pi_create_decode(opj_image_t *p_image,
 	{
 		opj_pi_update_decode_not_poc(l_pi,l_tcp,l_max_prec,l_max_res);
 	}
+	for (pino = 0; pino < l_bound; ++pino) {
+		if (! opj_pi_build_positions(&l_pi[pino])) {
+			opj_pi_destroy(l_pi, l_bound);
+			return 00;
+		}
+	}
 	return l_pi;
 }
 
@@ -1445,8 +1611,6 @@ opj_pi_iterator_t *opj_pi_initialise_encode(const opj_image_t *p_image,
 	l_current_pi->ty0 = l_ty0;
 	l_current_pi->tx1 = l_tx1;
 	l_current_pi->ty1 = l_ty1;
-	l_current_pi->dx = l_dx_min;
-	l_current_pi->dy = l_dy_min;
 	l_current_pi->step_p = l_step_p;
 	l_current_pi->step_c = l_step_c;
 	l_current_pi->step_r = l_step_r;
@@ -1484,8 +1648,6 @@ opj_pi_iterator_t *opj_pi_initialise_encode(const opj_image_t *p_image,
 		l_current_pi->ty0 = l_ty0;
 		l_current_pi->tx1 = l_tx1;
 		l_current_pi->ty1 = l_ty1;
-		l_current_pi->dx = l_dx_min;
-		l_current_pi->dy = l_dy_min;
 		l_current_pi->step_p = l_step_p;
 		l_current_pi->step_c = l_step_c;
 		l_current_pi->step_r = l_step_r;
@@ -1531,7 +1693,7 @@ opj_pi_iterator_t *opj_pi_initialise_encode(const opj_image_t *p_image,
 	return l_pi;
 }
 
-void opj_pi_create_encode( 	opj_pi_iterator_t *pi,
+OPJ_BOOL opj_pi_create_encode( 	opj_pi_iterator_t *pi,
 							opj_cp_t *cp,
 							OPJ_UINT32 tileno,
 							OPJ_UINT32 pino,
@@ -1787,6 +1949,8 @@ void opj_pi_create_encode( 	opj_pi_iterator_t *pi,
 			}
 		}
 	}
+
+	return opj_pi_build_positions(&pi[pino]);
 }
 
 void opj_pi_destroy(opj_pi_iterator_t *p_pi,
@@ -1813,6 +1977,10 @@ void opj_pi_destroy(opj_pi_iterator_t *p_pi,
 				opj_free(l_current_pi->comps);
 				l_current_pi->comps = 0;
 			}
+			if (l_current_pi->positions) {
+				opj_free(l_current_pi->positions);
+				l_current_pi->positions = 00;
+			}
 			++l_current_pi;
 		}
 		opj_free(p_pi);
@@ -1859,11 +2027,9 @@ OPJ_BOOL opj_pi_next(opj_pi_iterator_t * pi) {
 		case OPJ_RLCP:
 			return opj_pi_next_rlcp(pi);
 		case OPJ_RPCL:
-			return opj_pi_next_rpcl(pi);
 		case OPJ_PCRL:
-			return opj_pi_next_pcrl(pi);
 		case OPJ_CPRL:
-			return opj_pi_next_cprl(pi);
+			return opj_pi_next_position(pi);
 		case OPJ_PROG_UNKNOWN:
 			return OPJ_FALSE;
 	}
@@ -67,6 +67,18 @@ typedef struct opj_pi_comp {
   opj_pi_resolution_t *resolutions;
 } opj_pi_comp_t;
 
+/**
+Precinct visited by a position-driven progression (RPCL, PCRL or CPRL)
+*/
+typedef struct opj_pi_position {
+  /** resolution of the precinct */
+  OPJ_UINT32 resno;
+  /** component of the precinct */
+  OPJ_UINT32 compno;
+  /** index of the precinct in the resolution */
+  OPJ_UINT32 precno;
+} opj_pi_position_t;
+
 /**
 Packet iterator
 */
@@ -101,10 +113,14 @@ typedef struct opj_pi_iterator {
   opj_pi_comp_t *comps;
   /** FIXME DOC*/
   OPJ_INT32 tx0, ty0, tx1, ty1;
-  /** FIXME DOC*/
-  OPJ_INT32 x, y;
-  /** FIXME DOC*/
-  OPJ_UINT32 dx, dy;
+  /** precincts of a position-driven progression, in the order of the progression */
+  opj_pi_position_t *positions;
+  /** number of precincts in positions */
+  OPJ_UINT32 nb_positions;
+  /** number of precincts allocated in positions */
+  OPJ_UINT32 max_positions;
+  /** precinct that identify the packet in positions */
+  OPJ_UINT32 position_no;
 } opj_pi_iterator_t;
 
 /** @name Exported functions */
@@ -145,8 +161,9 @@ Modify the packet iterator for enabling tile part generation
 @param tpnum Tile part number of the current tile
 @param tppos The position of the tile part flag in the progression order
 @param t2_mode FIXME DOC
+@return true if the packet iterator could be set up
 */
-void opj_pi_create_encode(  opj_pi_iterator_t *pi, 
+OPJ_BOOL opj_pi_create_encode(  opj_pi_iterator_t *pi, 
                             opj_cp_t *cp,
                             OPJ_UINT32 tileno, 
                             OPJ_UINT32 pino,
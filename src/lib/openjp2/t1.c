@@ -268,36 +268,44 @@ static OPJ_FLOAT64 opj_t1_getwmsedec(
 		const OPJ_FLOAT64 * mct_norms,
 		OPJ_UINT32 mct_numcomps);
 
-static void opj_t1_encode_cblk( opj_t1_t *t1,
-                                opj_tcd_cblk_enc_t* cblk,
-                                OPJ_UINT32 orient,
-                                OPJ_UINT32 compno,
-                                OPJ_UINT32 level,
-                                OPJ_UINT32 qmfbid,
-                                OPJ_FLOAT64 stepsize,
-                                OPJ_UINT32 cblksty,
-                                OPJ_UINT32 numcomps,
-                                opj_tcd_tile_t * tile,
-                                const OPJ_FLOAT64 * mct_norms,
-                                OPJ_UINT32 mct_numcomps);
-
 /**
-Decode 1 code-block
+Encode 1 code-block from its quantized samples
 @param t1 T1 handle
 @param cblk Code-block coding parameters
-@param orient
-@param roishift Region of interest shifting value
-@param cblksty Code-block style
+@param band Band of the code-block
+@param tccp Tile-component coding parameters
+@param compno Component number
+@param level Decomposition level of the band
+@param data Samples of the code-block, scaled in place for the encoder
+@param data_stride Distance between two rows of data, in samples
+@param tile Tile the code-block belongs to
+@param mct_norms FIXME DOC
+@param mct_numcomps Number of components used for MCT
 */
-static OPJ_BOOL opj_t1_decode_cblk( opj_t1_t *t1,
-                                    opj_tcd_cblk_dec_t* cblk,
-                                    OPJ_UINT32 orient,
-                                    OPJ_UINT32 roishift,
-                                    OPJ_UINT32 cblksty);
+static OPJ_BOOL opj_t1_encode_cblk_data(opj_t1_t *t1,
+                                        opj_tcd_cblk_enc_t* cblk,
+                                        opj_tcd_band_t* band,
+                                        opj_tccp_t* tccp,
+                                        OPJ_UINT32 compno,
+                                        OPJ_UINT32 level,
+                                        OPJ_INT32* data,
+                                        OPJ_UINT32 data_stride,
+                                        opj_tcd_tile_t* tile,
+                                        const OPJ_FLOAT64 * mct_norms,
+                                        OPJ_UINT32 mct_numcomps);
 
-OPJ_BOOL opj_t1_allocate_buffers(   opj_t1_t *t1,
-                                    OPJ_UINT32 w,
-                                    OPJ_UINT32 h);
+/**
+Undo the region of interest shift of the code-block just decoded
+@param t1 T1 handle
+@param roishift Region of interest shifting value
+*/
+static void opj_t1_roi_shift_decode(opj_t1_t *t1, OPJ_UINT32 roishift);
+/**
+Tell if the samples of the code-block just decoded fit in a 16 bit tile component
+@param datap Samples of the code-block
+@param n Number of samples
+*/
+static OPJ_BOOL opj_t1_cblk_fits_16(const OPJ_INT32 *datap, OPJ_UINT32 n);
 
 /*@}*/
 
@@ -1268,6 +1276,17 @@ void opj_t1_destroy(opj_t1_t *p_t1)
 	opj_free(p_t1);
 }
 
+OPJ_BOOL opj_t1_cblk_fits_16(const OPJ_INT32 *datap, OPJ_UINT32 n)
+{
+	OPJ_UINT32 i;
+	for (i = 0; i < n; ++i) {
+		if (datap[i] / 2 != (OPJ_INT16)(datap[i] / 2)) {
+			return OPJ_FALSE;
+		}
+	}
+	return OPJ_TRUE;
+}
+
 OPJ_BOOL opj_t1_decode_cblks(   opj_t1_t* t1,
                             opj_tcd_tilecomp_t* tilec,
                             opj_tccp_t* tccp
@@ -1318,21 +1337,26 @@ OPJ_BOOL opj_t1_decode_cblks(   opj_t1_t* t1,
 					cblk_h = t1->h;
 
 					if (tccp->roishift) {
-						OPJ_INT32 thresh = 1 << tccp->roishift;
-						for (j = 0; j < cblk_h; ++j) {
-							for (i = 0; i < cblk_w; ++i) {
-								OPJ_INT32 val = datap[(j * cblk_w) + i];
-								OPJ_INT32 mag = abs(val);
-								if (mag >= thresh) {
-									mag >>= tccp->roishift;
-									datap[(j * cblk_w) + i] = val < 0 ? -mag : mag;
-								}
-							}
+						opj_t1_roi_shift_decode(t1, (OPJ_UINT32)tccp->roishift);
+					}
+
+					/* a damaged code-block may decode beyond the bit-planes of its band */
+					if (tilec->data_16bit && ! opj_t1_cblk_fits_16(datap, cblk_w * cblk_h)) {
+						if (! opj_tcd_widen_tile_component_data(tilec)) {
+							return OPJ_FALSE;
 						}
 					}
 
 					/*tiledp=(void*)&tilec->data[(y * tile_w) + x];*/
-					if (tccp->qmfbid == 1) {
+					if (tilec->data_16bit) {
+                        OPJ_INT16* restrict tiledp = (OPJ_INT16*)tilec->data + (OPJ_UINT32)y * tile_w + (OPJ_UINT32)x;
+						for (j = 0; j < cblk_h; ++j) {
+							for (i = 0; i < cblk_w; ++i) {
+								OPJ_INT32 tmp = datap[(j * cblk_w) + i];
+								tiledp[(j * tile_w) + i] = (OPJ_INT16)(tmp / 2);
+							}
+						}
+					} else if (tccp->qmfbid == 1) {
                         OPJ_INT32* restrict tiledp = &tilec->data[(OPJ_UINT32)y * tile_w + (OPJ_UINT32)x];
 						for (j = 0; j < cblk_h; ++j) {
 							for (i = 0; i < cblk_w; ++i) {
@@ -1367,6 +1391,129 @@ OPJ_BOOL opj_t1_decode_cblks(   opj_t1_t* t1,
         return OPJ_TRUE;
 }
 
+OPJ_BOOL opj_t1_decode_band_rows(   opj_t1_t* t1,
+                                    opj_t1_band_rows_t* rows,
+                                    opj_tccp_t* tccp,
+                                    OPJ_INT32 y0,
+                                    OPJ_INT32 y1,
+                                    OPJ_INT32* dest,
+                                    OPJ_UINT32 dest_stride)
+{
+	opj_tcd_band_t* band = rows->band;
+	OPJ_UINT32 band_w = (OPJ_UINT32)(band->x1 - band->x0);
+	OPJ_UINT32 j;
+	OPJ_INT32 a0, a1;
+
+	if (y0 >= y1) {
+		return OPJ_TRUE;
+	}
+
+	/* code-blocks are aligned on a grid, decode whole code-block rows */
+	a0 = opj_int_max((y0 >> rows->cblk_h_expn) << rows->cblk_h_expn, band->y0);
+	a1 = opj_int_min(((y1 + (1 << rows->cblk_h_expn) - 1) >> rows->cblk_h_expn) << rows->cblk_h_expn, band->y1);
+
+	if (a0 < rows->y0 || a1 > rows->y1) {
+		OPJ_INT32 keep0 = opj_int_max(a0, rows->y0);
+		OPJ_INT32 keep1 = opj_int_min(a1, rows->y1);
+		OPJ_UINT32 nb_rows = (OPJ_UINT32)(a1 - a0);
+		OPJ_UINT32 precno, cblkno;
+
+		/* keep the rows shared with the previous request, drop the others */
+		if (nb_rows > rows->data_rows) {
+			OPJ_INT32* l_data = (OPJ_INT32*) opj_malloc((size_t)nb_rows * band_w * sizeof(OPJ_INT32));
+			if (! l_data) {
+				return OPJ_FALSE;
+			}
+			if (keep0 < keep1) {
+				memcpy(l_data + (OPJ_UINT32)(keep0 - a0) * band_w,
+				       rows->data + (OPJ_UINT32)(keep0 - rows->y0) * band_w,
+				       (size_t)(keep1 - keep0) * band_w * sizeof(OPJ_INT32));
+			}
+			opj_free(rows->data);
+			rows->data = l_data;
+			rows->data_rows = nb_rows;
+		}
+		else if (keep0 < keep1) {
+			memmove(rows->data + (OPJ_UINT32)(keep0 - a0) * band_w,
+			        rows->data + (OPJ_UINT32)(keep0 - rows->y0) * band_w,
+			        (size_t)(keep1 - keep0) * band_w * sizeof(OPJ_INT32));
+		}
+
+		for (precno = 0; precno < rows->nb_precincts; ++precno) {
+			opj_tcd_precinct_t* precinct = &band->precincts[precno];
+
+			if (precinct->y1 <= a0 || precinct->y0 >= a1) {
+				continue;
+			}
+
+			for (cblkno = 0; cblkno < precinct->cw * precinct->ch; ++cblkno) {
+				opj_tcd_cblk_dec_t* cblk = &precinct->cblks.dec[cblkno];
+				OPJ_INT32* restrict datap;
+				OPJ_INT32* restrict rowsp;
+				OPJ_UINT32 i;
+
+				if (cblk->y1 <= a0 || cblk->y0 >= a1 || (cblk->y0 >= keep0 && cblk->y1 <= keep1)) {
+					continue;
+				}
+
+				if (OPJ_FALSE == opj_t1_decode_cblk(
+				                        t1,
+				                        cblk,
+				                        band->bandno,
+				                        (OPJ_UINT32)tccp->roishift,
+				                        tccp->cblksty)) {
+					return OPJ_FALSE;
+				}
+				if (tccp->roishift) {
+					opj_t1_roi_shift_decode(t1, (OPJ_UINT32)tccp->roishift);
+				}
+
+				datap = t1->data;
+				rowsp = rows->data + (OPJ_UINT32)(cblk->y0 - a0) * band_w + (OPJ_UINT32)(cblk->x0 - band->x0);
+				for (j = 0; j < t1->h; ++j) {
+					if (tccp->qmfbid == 1) {
+						for (i = 0; i < t1->w; ++i) {
+							rowsp[i] = datap[i] / 2;
+						}
+					} else {		/* if (tccp->qmfbid == 0) */
+						OPJ_FLOAT32* restrict rowsfp = (OPJ_FLOAT32*) rowsp;
+						for (i = 0; i < t1->w; ++i) {
+							rowsfp[i] = (OPJ_FLOAT32)datap[i] * band->stepsize;
+						}
+					}
+					datap += t1->w;
+					rowsp += band_w;
+				}
+			} /* cblkno */
+		} /* precno */
+
+		rows->y0 = a0;
+		rows->y1 = a1;
+	}
+
+	for (j = 0; j < (OPJ_UINT32)(y1 - y0); ++j) {
+		memcpy(dest + (size_t)j * dest_stride,
+		       rows->data + (OPJ_UINT32)(y0 + (OPJ_INT32)j - rows->y0) * band_w,
+		       band_w * sizeof(OPJ_INT32));
+	}
+
+	return OPJ_TRUE;
+}
+
+static void opj_t1_roi_shift_decode(opj_t1_t *t1, OPJ_UINT32 roishift)
+{
+	OPJ_INT32 thresh = 1 << roishift;
+	OPJ_UINT32 i;
+
+	for (i = 0; i < t1->w * t1->h; ++i) {
+		OPJ_INT32 val = t1->data[i];
+		OPJ_INT32 mag = abs(val);
+		if (mag >= thresh) {
+			mag >>= roishift;
+			t1->data[i] = val < 0 ? -mag : mag;
+		}
+	}
+}
 
 OPJ_BOOL opj_t1_decode_cblk(opj_t1_t *t1,
                             opj_tcd_cblk_dec_t* cblk,
@@ -1483,18 +1630,12 @@ OPJ_BOOL opj_t1_encode_cblks(   opj_t1_t *t1,
 
 			for (bandno = 0; bandno < res->numbands; ++bandno) {
 				opj_tcd_band_t* restrict band = &res->bands[bandno];
-                OPJ_INT32 bandconst = 8192 * 8192 / ((OPJ_INT32) floor(band->stepsize * 8192));
 
 				for (precno = 0; precno < res->pw * res->ph; ++precno) {
 					opj_tcd_precinct_t *prc = &band->precincts[precno];
 
 					for (cblkno = 0; cblkno < prc->cw * prc->ch; ++cblkno) {
 						opj_tcd_cblk_enc_t* cblk = &prc->cblks.enc[cblkno];
-						OPJ_INT32* restrict tiledp;
-						OPJ_UINT32 cblk_w;
-						OPJ_UINT32 cblk_h;
-						OPJ_UINT32 i, j, tileIndex=0, tileLineAdvance;
-
 						OPJ_INT32 x = cblk->x0 - band->x0;
 						OPJ_INT32 y = cblk->y0 - band->y0;
 						if (band->bandno & 1) {
@@ -1506,56 +1647,20 @@ OPJ_BOOL opj_t1_encode_cblks(   opj_t1_t *t1,
 							y += pres->y1 - pres->y0;
 						}
 
-						if(!opj_t1_allocate_buffers(
-									t1,
-									(OPJ_UINT32)(cblk->x1 - cblk->x0),
-									(OPJ_UINT32)(cblk->y1 - cblk->y0)))
-						{
-							return OPJ_FALSE;
-						}
-
-						cblk_w = t1->w;
-						cblk_h = t1->h;
-						tileLineAdvance = tile_w - cblk_w;
-
-						tiledp=&tilec->data[(OPJ_UINT32)y * tile_w + (OPJ_UINT32)x];
-						t1->data = tiledp;
-						t1->data_stride = tile_w;
-						if (tccp->qmfbid == 1) {
-							for (j = 0; j < cblk_h; ++j) {
-								for (i = 0; i < cblk_w; ++i) {
-									tiledp[tileIndex] <<= T1_NMSEDEC_FRACBITS;
-									tileIndex++;
-								}
-								tileIndex += tileLineAdvance;
-							}
-						} else {		/* if (tccp->qmfbid == 0) */
-							for (j = 0; j < cblk_h; ++j) {
-								for (i = 0; i < cblk_w; ++i) {
-									OPJ_INT32 tmp = tiledp[tileIndex];
-									tiledp[tileIndex] =
-										opj_int_fix_mul(
-										tmp,
-										bandconst) >> (11 - T1_NMSEDEC_FRACBITS);
-									tileIndex++;
-								}
-								tileIndex += tileLineAdvance;
-							}
-						}
-
-						opj_t1_encode_cblk(
+						if (! opj_t1_encode_cblk_data(
 								t1,
 								cblk,
-								band->bandno,
+								band,
+								tccp,
 								compno,
 								tilec->numresolutions - 1 - resno,
-								tccp->qmfbid,
-								band->stepsize,
-								tccp->cblksty,
-								tile->numcomps,
+								&tilec->data[(OPJ_UINT32)y * tile_w + (OPJ_UINT32)x],
+								tile_w,
 								tile,
 								mct_norms,
-								mct_numcomps);
+								mct_numcomps)) {
+							return OPJ_FALSE;
+						}
 
 					} /* cblkno */
 				} /* precno */
@@ -1565,6 +1670,153 @@ OPJ_BOOL opj_t1_encode_cblks(   opj_t1_t *t1,
 	return OPJ_TRUE;
 }
 
+OPJ_BOOL opj_t1_encode_band_rows(   opj_t1_t *t1,
+                                    opj_t1_band_rows_t* rows,
+                                    opj_tcd_tile_t *tile,
+                                    opj_tcp_t *tcp,
+                                    OPJ_UINT32 compno,
+                                    OPJ_UINT32 resno,
+                                    const OPJ_FLOAT64 * mct_norms,
+                                    OPJ_UINT32 mct_numcomps,
+                                    const OPJ_INT32* src,
+                                    OPJ_UINT32 src_stride,
+                                    OPJ_UINT32 nb_rows)
+{
+	opj_tcd_band_t* band = rows->band;
+	opj_tcd_tilecomp_t* tilec = &tile->comps[compno];
+	opj_tccp_t* tccp = &tcp->tccps[compno];
+	OPJ_UINT32 band_w = (OPJ_UINT32)(band->x1 - band->x0);
+	OPJ_UINT32 nb_held = (OPJ_UINT32)(rows->y1 - rows->y0);
+	OPJ_UINT32 j;
+
+	if (band_w == 0) {
+		/* no code-block */
+		return OPJ_TRUE;
+	}
+
+	/* append the rows after the ones waiting for their code-block row to be complete */
+	if (nb_held + nb_rows > rows->data_rows) {
+		OPJ_INT32* l_data = (OPJ_INT32*) opj_realloc(rows->data, (size_t)(nb_held + nb_rows) * band_w * sizeof(OPJ_INT32));
+		if (! l_data) {
+			return OPJ_FALSE;
+		}
+		rows->data = l_data;
+		rows->data_rows = nb_held + nb_rows;
+	}
+	for (j = 0; j < nb_rows; ++j) {
+		memcpy(rows->data + (size_t)(nb_held + j) * band_w, src + (size_t)j * src_stride, band_w * sizeof(OPJ_INT32));
+	}
+	rows->y1 += (OPJ_INT32)nb_rows;
+
+	/* encode the code-block rows now complete */
+	while (rows->y0 < band->y1) {
+		OPJ_INT32 row_end = opj_int_min(((rows->y0 >> rows->cblk_h_expn) + 1) << rows->cblk_h_expn, band->y1);
+		OPJ_UINT32 precno, cblkno;
+
+		if (row_end > rows->y1) {
+			break;
+		}
+
+		for (precno = 0; precno < rows->nb_precincts; ++precno) {
+			opj_tcd_precinct_t *prc = &band->precincts[precno];
+
+			if (prc->y1 <= rows->y0 || prc->y0 >= row_end) {
+				continue;
+			}
+
+			for (cblkno = 0; cblkno < prc->cw * prc->ch; ++cblkno) {
+				opj_tcd_cblk_enc_t* cblk = &prc->cblks.enc[cblkno];
+
+				if (cblk->y1 <= rows->y0 || cblk->y0 >= row_end) {
+					continue;
+				}
+
+				if (! opj_t1_encode_cblk_data(
+						t1,
+						cblk,
+						band,
+						tccp,
+						compno,
+						tilec->numresolutions - 1 - resno,
+						rows->data + (OPJ_UINT32)(cblk->y0 - rows->y0) * band_w + (OPJ_UINT32)(cblk->x0 - band->x0),
+						band_w,
+						tile,
+						mct_norms,
+						mct_numcomps)) {
+					return OPJ_FALSE;
+				}
+			}
+		}
+
+		memmove(rows->data,
+		        rows->data + (OPJ_UINT32)(row_end - rows->y0) * band_w,
+		        (size_t)(rows->y1 - row_end) * band_w * sizeof(OPJ_INT32));
+		rows->y0 = row_end;
+	}
+
+	return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_t1_encode_cblk_data(opj_t1_t *t1,
+                                 opj_tcd_cblk_enc_t* cblk,
+                                 opj_tcd_band_t* band,
+                                 opj_tccp_t* tccp,
+                                 OPJ_UINT32 compno,
+                                 OPJ_UINT32 level,
+                                 OPJ_INT32* data,
+                                 OPJ_UINT32 data_stride,
+                                 opj_tcd_tile_t* tile,
+                                 const OPJ_FLOAT64 * mct_norms,
+                                 OPJ_UINT32 mct_numcomps)
+{
+	OPJ_UINT32 i, j;
+
+	if(!opj_t1_allocate_buffers(
+				t1,
+				(OPJ_UINT32)(cblk->x1 - cblk->x0),
+				(OPJ_UINT32)(cblk->y1 - cblk->y0)))
+	{
+		return OPJ_FALSE;
+	}
+
+	t1->data = data;
+	t1->data_stride = data_stride;
+	if (tccp->qmfbid == 1) {
+		for (j = 0; j < t1->h; ++j) {
+			for (i = 0; i < t1->w; ++i) {
+				data[j * data_stride + i] *= (1 << T1_NMSEDEC_FRACBITS);
+			}
+		}
+	} else {		/* if (tccp->qmfbid == 0) */
+		OPJ_INT32 bandconst = 8192 * 8192 / ((OPJ_INT32) floor(band->stepsize * 8192));
+		for (j = 0; j < t1->h; ++j) {
+			for (i = 0; i < t1->w; ++i) {
+				OPJ_INT32 tmp = data[j * data_stride + i];
+				data[j * data_stride + i] =
+					opj_int_fix_mul(
+					tmp,
+					bandconst) >> (11 - T1_NMSEDEC_FRACBITS);
+			}
+		}
+	}
+
+	opj_t1_encode_cblk(
+			t1,
+			cblk,
+			band->bandno,
+			compno,
+			level,
+			tccp->qmfbid,
+			band->stepsize,
+			tccp->cblksty,
+			tile->numcomps,
+			tile,
+			mct_norms,
+			mct_numcomps);
+
+	return OPJ_TRUE;
+}
+
 /** mod fixed_quality */
 void opj_t1_encode_cblk(opj_t1_t *t1,
                         opj_tcd_cblk_enc_t* cblk,
@@ -116,6 +116,24 @@ typedef struct opj_t1 {
 
 #define MACRO_t1_flags(x,y) t1->flags[((x)*(t1->flags_stride))+(y)]
 
+/**
+Rows of a band processed one code-block row at a time, used by the strip decoder and encoder
+*/
+typedef struct opj_t1_band_rows {
+	/** band the rows are read from */
+	opj_tcd_band_t *band;
+	/** number of precincts of the band */
+	OPJ_UINT32 nb_precincts;
+	/** log2 of the code-block height of the band */
+	OPJ_UINT32 cblk_h_expn;
+	/** band rows held in data (band coordinates) */
+	OPJ_INT32 y0, y1;
+	/** decoded rows, band width samples per row */
+	OPJ_INT32 *data;
+	/** number of rows data can hold */
+	OPJ_UINT32 data_rows;
+} opj_t1_band_rows_t;
+
 /** @name Exported functions */
 /*@{*/
 /* ----------------------------------------------------------------------- */
@@ -134,6 +152,33 @@ OPJ_BOOL opj_t1_encode_cblks(   opj_t1_t *t1,
                                 const OPJ_FLOAT64 * mct_norms,
                                 OPJ_UINT32 mct_numcomps);
 
+/**
+Append rows to a band and encode the code-blocks whose rows are all known.
+The rows of a band must be given from top to bottom; rows->y0 and rows->y1 start at the top of the band.
+@param t1 T1 handle
+@param rows Rows of the band waiting for their code-block row to be complete
+@param tile The tile to encode
+@param tcp Tile coding parameters
+@param compno Component of the band
+@param resno Resolution level of the band
+@param mct_norms  FIXME DOC
+@param mct_numcomps Number of components used for MCT
+@param src Rows to append, band width samples per row
+@param src_stride Distance between two rows of src, in samples
+@param nb_rows Number of rows to append
+*/
+OPJ_BOOL opj_t1_encode_band_rows(   opj_t1_t *t1,
+                                    opj_t1_band_rows_t* rows,
+                                    opj_tcd_tile_t *tile,
+                                    opj_tcp_t *tcp,
+                                    OPJ_UINT32 compno,
+                                    OPJ_UINT32 resno,
+                                    const OPJ_FLOAT64 * mct_norms,
+                                    OPJ_UINT32 mct_numcomps,
+                                    const OPJ_INT32* src,
+                                    OPJ_UINT32 src_stride,
+                                    OPJ_UINT32 nb_rows);
+
 /**
 Decode the code-blocks of a tile
 @param t1 T1 handle
@@ -144,7 +189,75 @@ OPJ_BOOL opj_t1_decode_cblks(   opj_t1_t* t1,
                                 opj_tcd_tilecomp_t* tilec,
                                 opj_tccp_t* tccp);
 
+/**
+Decode rows of a band, decoding only the code-blocks not already held by the rows cache
+@param t1 T1 handle
+@param rows Rows cache of the band
+@param tccp Tile coding parameters
+@param y0 First row to decode (band coordinates)
+@param y1 Row after the last one to decode (band coordinates)
+@param dest Destination of the rows, band width samples per row
+@param dest_stride Distance between two rows of dest, in samples
+*/
+OPJ_BOOL opj_t1_decode_band_rows(   opj_t1_t* t1,
+                                    opj_t1_band_rows_t* rows,
+                                    opj_tccp_t* tccp,
+                                    OPJ_INT32 y0,
+                                    OPJ_INT32 y1,
+                                    OPJ_INT32* dest,
+                                    OPJ_UINT32 dest_stride);
+
+/**
+Set up the buffers of the T1 handle for a code-block: the flags, and the samples when decoding
+@param t1 T1 handle
+@param w Width of the code-block
+@param h Height of the code-block
+*/
+OPJ_BOOL opj_t1_allocate_buffers(   opj_t1_t *t1,
+                                    OPJ_UINT32 w,
+                                    OPJ_UINT32 h);
+
+/**
+Encode 1 code-block from the samples in t1->data, holding T1_NMSEDEC_FRACBITS fractional bits
+@param t1 T1 handle
+@param cblk Code-block coding parameters, receives the coded data and the passes
+@param orient Orientation of the band
+@param compno Component number
+@param level Decomposition level of the band
+@param qmfbid Wavelet transform, 1 for 5-3 and 0 for 9-7
+@param stepsize Quantization step size of the band
+@param cblksty Code-block style
+@param numcomps Number of components of the tile
+@param tile Tile the code-block belongs to, its distortion is updated
+@param mct_norms  FIXME DOC
+@param mct_numcomps Number of components used for MCT
+*/
+void opj_t1_encode_cblk(opj_t1_t *t1,
+                        opj_tcd_cblk_enc_t* cblk,
+                        OPJ_UINT32 orient,
+                        OPJ_UINT32 compno,
+                        OPJ_UINT32 level,
+                        OPJ_UINT32 qmfbid,
+                        OPJ_FLOAT64 stepsize,
+                        OPJ_UINT32 cblksty,
+                        OPJ_UINT32 numcomps,
+                        opj_tcd_tile_t * tile,
+                        const OPJ_FLOAT64 * mct_norms,
+                        OPJ_UINT32 mct_numcomps);
 
+/**
+Decode 1 code-block into t1->data
+@param t1 T1 handle
+@param cblk Code-block coding parameters
+@param orient Orientation of the band
+@param roishift Region of interest shifting value
+@param cblksty Code-block style
+*/
+OPJ_BOOL opj_t1_decode_cblk(opj_t1_t *t1,
+                            opj_tcd_cblk_dec_t* cblk,
+                            OPJ_UINT32 orient,
+                            OPJ_UINT32 roishift,
+                            OPJ_UINT32 cblksty);
 
 /**
  * Creates a new Tier 1 handle
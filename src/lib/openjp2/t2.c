@@ -108,6 +108,27 @@ static OPJ_BOOL opj_t2_skip_packet( opj_t2_t* p_t2,
                                     OPJ_UINT32 p_max_length,
                                     opj_packet_info_t *p_pack_info);
 
+/**
+Gives the packets of the codestream index of a tile when their lengths describe exactly the tile data,
+so that the packets which are not decoded can be skipped without reading their header.
+@param p_t2             T2 handle
+@param p_tile_no        number of the tile
+@param p_max_len        length of the tile data
+@param p_cstr_index     codestream index, may be 00
+@param p_nb_packets     number of packets of the returned index
+@return the packet index of the tile, or 00 if it cannot be used
+*/
+static opj_packet_info_t * opj_t2_get_packet_index( opj_t2_t* p_t2,
+                                                    OPJ_UINT32 p_tile_no,
+                                                    OPJ_UINT32 p_max_len,
+                                                    opj_codestream_index_t *p_cstr_index,
+                                                    OPJ_UINT32 * p_nb_packets);
+
+/**
+Tells if the packets of a component are decoded, see opj_dparameters_t::cp_comps.
+*/
+static OPJ_BOOL opj_t2_is_decoded_comp(opj_t2_t* p_t2, OPJ_UINT32 p_compno);
+
 static OPJ_BOOL opj_t2_read_packet_header(  opj_t2_t* p_t2,
                                             opj_tcd_tile_t *p_tile,
                                             opj_tcp_t *p_tcp,
@@ -133,6 +154,15 @@ static OPJ_BOOL opj_t2_skip_packet_data(opj_t2_t* p_t2,
                                         OPJ_UINT32 p_max_length,
                                         opj_packet_info_t *pack_info);
 
+/**
+Makes room in the data of a code-block for bytes of a segment that cannot be read in place
+@param p_cblk       the code-block
+@param p_length     number of bytes to add after the current data
+@return OPJ_TRUE if the data can hold them
+*/
+static OPJ_BOOL opj_t2_reserve_cblk_data(opj_tcd_cblk_dec_t* p_cblk,
+                                         OPJ_UINT32 p_length);
+
 /**
 @param cblk
 @param index
@@ -204,6 +234,7 @@ OPJ_BOOL opj_t2_encode_packets( opj_t2_t* p_t2,
                                 OPJ_UINT32 * p_data_written,
                                 OPJ_UINT32 p_max_len,
                                 opj_codestream_info_t *cstr_info,
+                                OPJ_UINT32 * p_packet_lengths,
                                 OPJ_UINT32 p_tp_num,
                                 OPJ_INT32 p_tp_pos,
                                 OPJ_UINT32 p_pino,
@@ -239,8 +270,10 @@ OPJ_BOOL opj_t2_encode_packets( opj_t2_t* p_t2,
                         for (poc = 0; poc < pocno ; ++poc) {
                                 OPJ_UINT32 l_tp_num = compno;
 
-                                /* TODO MSD : check why this function cannot fail (cf. v1) */
-                                opj_pi_create_encode(l_pi, l_cp,p_tile_no,poc,l_tp_num,p_tp_pos,p_t2_mode);
+                                if (! opj_pi_create_encode(l_pi, l_cp,p_tile_no,poc,l_tp_num,p_tp_pos,p_t2_mode)) {
+                                        opj_pi_destroy(l_pi, l_nb_pocs);
+                                        return OPJ_FALSE;
+                                }
 
                                 if (l_current_pi->poc.prg == OPJ_PROG_UNKNOWN) {
                                     /* TODO ADE : add an error */
@@ -276,7 +309,10 @@ OPJ_BOOL opj_t2_encode_packets( opj_t2_t* p_t2,
                 }
         }
         else {  /* t2_mode == FINAL_PASS  */
-                opj_pi_create_encode(l_pi, l_cp,p_tile_no,p_pino,p_tp_num,p_tp_pos,p_t2_mode);
+                if (! opj_pi_create_encode(l_pi, l_cp,p_tile_no,p_pino,p_tp_num,p_tp_pos,p_t2_mode)) {
+                        opj_pi_destroy(l_pi, l_nb_pocs);
+                        return OPJ_FALSE;
+                }
 
                 l_current_pi = &l_pi[p_pino];
                 if (l_current_pi->poc.prg == OPJ_PROG_UNKNOWN) {
@@ -316,6 +352,9 @@ OPJ_BOOL opj_t2_encode_packets( opj_t2_t* p_t2,
                                         cstr_info->packno++;
                                 }
                                 /* << INDEX */
+                                if (p_packet_lengths) {
+                                        p_packet_lengths[p_tile->packno] = l_nb_bytes;
+                                }
                                 ++p_tile->packno;
                         }
                 }
@@ -362,8 +401,9 @@ OPJ_BOOL opj_t2_decode_packets( opj_t2_t *p_t2,
 #endif 
         opj_packet_info_t *l_pack_info = 00;
         opj_image_comp_t* l_img_comp = 00;
-
-        OPJ_ARG_NOT_USED(p_cstr_index);
+        opj_packet_info_t *l_packet_index = 00;
+        OPJ_UINT32 l_nb_indexed_packets = 0;
+        OPJ_UINT32 l_packet_no = 0;
 
 #ifdef TODO_MSD
         if (p_cstr_index) {
@@ -371,6 +411,13 @@ OPJ_BOOL opj_t2_decode_packets( opj_t2_t *p_t2,
         }
 #endif
 
+        /* the code-block segments point into the tile data until T1 has decoded them */
+        p_tile->src_data = p_src;
+
+        /* with the packet lengths of the PLT/PLM markers or of an index file,
+           the packets which are not decoded are skipped without reading their header */
+        l_packet_index = opj_t2_get_packet_index(p_t2, p_tile_no, p_max_len, p_cstr_index, &l_nb_indexed_packets);
+
         /* create a packet iterator */
         l_pi = opj_pi_create_decode(l_image, l_cp, p_tile_no);
         if (!l_pi) {
@@ -404,11 +451,19 @@ OPJ_BOOL opj_t2_decode_packets( opj_t2_t *p_t2,
                 memset(first_pass_failed, OPJ_TRUE, l_image->numcomps * sizeof(OPJ_BOOL));
 
                 while (opj_pi_next(l_current_pi)) {
+                        OPJ_UINT32 l_packet_length = 0;
+
                   JAS_FPRINTF( stderr, "packet offset=00000166 prg=%d cmptno=%02d rlvlno=%02d prcno=%03d lyrno=%02d\n\n",
                     l_current_pi->poc.prg1, l_current_pi->compno, l_current_pi->resno, l_current_pi->precno, l_current_pi->layno );
 
+                        if (l_packet_no < l_nb_indexed_packets) {
+                                l_packet_length = (OPJ_UINT32)(l_packet_index[l_packet_no].end_pos - l_packet_index[l_packet_no].start_pos + 1);
+                        }
+                        ++l_packet_no;
+
                         if (l_tcp->num_layers_to_decode > l_current_pi->layno
-                                        && l_current_pi->resno < p_tile->comps[l_current_pi->compno].minimum_num_resolutions) {
+                                        && l_current_pi->resno < p_tile->comps[l_current_pi->compno].minimum_num_resolutions
+                                        && opj_t2_is_decoded_comp(p_t2, l_current_pi->compno)) {
                                 l_nb_bytes_read = 0;
 
                                 first_pass_failed[l_current_pi->compno] = OPJ_FALSE;
@@ -419,9 +474,19 @@ OPJ_BOOL opj_t2_decode_packets( opj_t2_t *p_t2,
                                         return OPJ_FALSE;
                                 }
 
+                                /* the index no longer matches the packets read: it is not used for the rest of the tile */
+                                if (l_packet_length && l_nb_bytes_read != l_packet_length) {
+                                        l_nb_indexed_packets = 0;
+                                }
+
                                 l_img_comp = &(l_image->comps[l_current_pi->compno]);
                                 l_img_comp->resno_decoded = opj_uint_max(l_current_pi->resno, l_img_comp->resno_decoded);
                         }
+                        else if (l_packet_length && l_packet_length <= p_max_len) {
+                                /* the packets after a skipped one in the same precinct are skipped too,
+                                   so the state left by its header is never needed */
+                                l_nb_bytes_read = l_packet_length;
+                        }
                         else {
                                 l_nb_bytes_read = 0;
                                 if (! opj_t2_skip_packet(p_t2,p_tile,l_tcp,l_current_pi,l_current_data,&l_nb_bytes_read,p_max_len,l_pack_info)) {
@@ -482,6 +547,52 @@ OPJ_BOOL opj_t2_decode_packets( opj_t2_t *p_t2,
         return OPJ_TRUE;
 }
 
+opj_packet_info_t * opj_t2_get_packet_index( opj_t2_t* p_t2,
+                                            OPJ_UINT32 p_tile_no,
+                                            OPJ_UINT32 p_max_len,
+                                            opj_codestream_index_t *p_cstr_index,
+                                            OPJ_UINT32 * p_nb_packets)
+{
+        opj_tile_index_t *l_tile_index;
+        OPJ_UINT64 l_total_length = 0;
+        OPJ_UINT32 i;
+
+        *p_nb_packets = 0;
+
+        /* the packet headers of the PPM/PPT markers are not in the tile data */
+        if (! p_cstr_index || ! p_cstr_index->tile_index || (p_tile_no >= p_cstr_index->nb_of_tiles)
+                        || p_t2->cp->ppm || p_t2->cp->tcps[p_tile_no].ppt) {
+                return 00;
+        }
+
+        l_tile_index = &p_cstr_index->tile_index[p_tile_no];
+        if (! l_tile_index->nb_packet || ! l_tile_index->packet_index) {
+                return 00;
+        }
+
+        /* the index must list all the packets of all the tile-parts read */
+        for (i = 0; i < l_tile_index->nb_packet; ++i) {
+                const opj_packet_info_t *l_packet = &l_tile_index->packet_index[i];
+                if (l_packet->end_pos < l_packet->start_pos) {
+                        return 00;
+                }
+                l_total_length += (OPJ_UINT64)(l_packet->end_pos - l_packet->start_pos + 1);
+        }
+        if (l_total_length != p_max_len) {
+                return 00;
+        }
+
+        *p_nb_packets = l_tile_index->nb_packet;
+        return l_tile_index->packet_index;
+}
+
+OPJ_BOOL opj_t2_is_decoded_comp(opj_t2_t* p_t2, OPJ_UINT32 p_compno)
+{
+        const OPJ_BYTE * l_decoded_comps = p_t2->cp->m_specific_param.m_dec.m_decoded_comps;
+
+        return (! l_decoded_comps) || l_decoded_comps[p_compno];
+}
+
 /* ----------------------------------------------------------------------- */
 
 /**
@@ -844,7 +955,8 @@ OPJ_BOOL opj_t2_read_packet_header( opj_t2_t* p_t2,
         OPJ_UINT32 * l_modified_length_ptr = 00;
         OPJ_BYTE *l_current_data = p_src_data;
         opj_cp_t *l_cp = p_t2->cp;
-        opj_bio_t *l_bio = 00;  /* BIO component */
+        opj_bio_t l_bio_data;   /* BIO component, on the stack as it only lives for one packet header */
+        opj_bio_t *l_bio = &l_bio_data;
         opj_tcd_band_t *l_band = 00;
         opj_tcd_cblk_dec_t* l_cblk = 00;
         opj_tcd_resolution_t* l_res = &p_tile->comps[p_pi->compno].resolutions[p_pi->resno];
@@ -901,11 +1013,6 @@ OPJ_BOOL opj_t2_read_packet_header( opj_t2_t* p_t2,
         step 2: Return to codestream for decoding
         */
 
-        l_bio = opj_bio_create();
-        if (! l_bio) {
-                return OPJ_FALSE;
-        }
-
         if (l_cp->ppm == 1) { /* PPM */
                 l_header_data_start = &l_cp->ppm_data;
                 l_header_data = *l_header_data_start;
@@ -932,7 +1039,6 @@ OPJ_BOOL opj_t2_read_packet_header( opj_t2_t* p_t2,
             /* TODO MSD: no test to control the output of this function*/
                 opj_bio_inalign(l_bio);
                 l_header_data += opj_bio_numbytes(l_bio);
-                opj_bio_destroy(l_bio);
 
                 /* EPH markers */
                 if (p_tcp->csty & J2K_CP_CSTY_EPH) {
@@ -996,11 +1102,8 @@ OPJ_BOOL opj_t2_read_packet_header( opj_t2_t* p_t2,
 
                         /* if cblk not yet included --> zero-bitplane tagtree */
                         if (!l_cblk->numsegs) {
-                                OPJ_UINT32 i = 0;
-
-                                while (!opj_tgt_decode(l_bio, l_prc->imsbtree, cblkno, (OPJ_INT32)i)) {
-                                        ++i;
-                                }
+                                /* number of missing bit-planes, plus one */
+                                OPJ_UINT32 i = (OPJ_UINT32)opj_tgt_decode_value(l_bio, l_prc->imsbtree, cblkno, 999) + 1;
 
                                 l_cblk->numbps = (OPJ_UINT32)l_band->numbps + 1 - i;
                                 l_cblk->numlenbits = 3;
@@ -1016,7 +1119,6 @@ OPJ_BOOL opj_t2_read_packet_header( opj_t2_t* p_t2,
 
                         if (!l_cblk->numsegs) {
                                 if (! opj_t2_init_seg(l_cblk, l_segno, p_tcp->tccps[p_pi->compno].cblksty, 1)) {
-                                        opj_bio_destroy(l_bio);
                                         return OPJ_FALSE;
                                 }
                         }
@@ -1025,7 +1127,6 @@ OPJ_BOOL opj_t2_read_packet_header( opj_t2_t* p_t2,
                                 if (l_cblk->segs[l_segno].numpasses == l_cblk->segs[l_segno].maxpasses) {
                                         ++l_segno;
                                         if (! opj_t2_init_seg(l_cblk, l_segno, p_tcp->tccps[p_pi->compno].cblksty, 0)) {
-                                                opj_bio_destroy(l_bio);
                                                 return OPJ_FALSE;
                                         }
                                 }
@@ -1042,7 +1143,6 @@ OPJ_BOOL opj_t2_read_packet_header( opj_t2_t* p_t2,
                                         ++l_segno;
 
                                         if (! opj_t2_init_seg(l_cblk, l_segno, p_tcp->tccps[p_pi->compno].cblksty, 0)) {
-                                                opj_bio_destroy(l_bio);
                                                 return OPJ_FALSE;
                                         }
                                 }
@@ -1055,12 +1155,10 @@ OPJ_BOOL opj_t2_read_packet_header( opj_t2_t* p_t2,
         }
 
         if (!opj_bio_inalign(l_bio)) {
-                opj_bio_destroy(l_bio);
                 return OPJ_FALSE;
         }
 
         l_header_data += opj_bio_numbytes(l_bio);
-        opj_bio_destroy(l_bio);
 
         /* EPH markers */
         if (p_tcp->csty & J2K_CP_CSTY_EPH) {
@@ -1174,31 +1272,32 @@ OPJ_BOOL opj_t2_read_packet_data(   opj_t2_t* p_t2,
                                 };
 
 #endif /* USE_JPWL */
-                                /* Check possible overflow on size */
-                                if ((l_cblk->data_current_size + l_seg->newlen) < l_cblk->data_current_size) {
-                                        fprintf(stderr, "read: segment too long (%d) with current size (%d > %d) for codeblock %d (p=%d, b=%d, r=%d, c=%d)\n",
-                                                l_seg->newlen, l_cblk->data_current_size, 0xFFFFFFFF - l_seg->newlen, cblkno, p_pi->precno, bandno, p_pi->resno, p_pi->compno);
-                                        return OPJ_FALSE;
-                                }
-                                /* Check if the cblk->data have allocated enough memory */
-                                if ((l_cblk->data_current_size + l_seg->newlen) > l_cblk->data_max_size) {
-                                    OPJ_BYTE* new_cblk_data = (OPJ_BYTE*) opj_realloc(l_cblk->data, l_cblk->data_current_size + l_seg->newlen);
-                                    if(! new_cblk_data) {
-                                        opj_free(l_cblk->data);
-                                        l_cblk->data = NULL;
-                                        l_cblk->data_max_size = 0;
-                                        /* opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to realloc code block cata!\n"); */
-                                        return OPJ_FALSE;
-                                    }
-                                    l_cblk->data_max_size = l_cblk->data_current_size + l_seg->newlen;
-                                    l_cblk->data = new_cblk_data;
-                                }
-                               
-                                memcpy(l_cblk->data + l_cblk->data_current_size, l_current_data, l_seg->newlen);
-
                                 if (l_seg->numpasses == 0) {
+                                        /* a new segment is read in place from the tile data */
+                                        l_seg->data = &p_tile->src_data;
+                                        l_seg->dataindex = (OPJ_UINT32)(l_current_data - p_tile->src_data);
+                                }
+                                else if ((l_seg->data != &l_cblk->data) && (*l_seg->data + l_seg->dataindex + l_seg->len != l_current_data)) {
+                                        /* the segment goes on in another packet: its bytes are gathered in the code-block */
+                                        if (! opj_t2_reserve_cblk_data(l_cblk, l_seg->len)) {
+                                                fprintf(stderr, "read: segment too long (%d) with current size (%d) for codeblock %d (p=%d, b=%d, r=%d, c=%d)\n",
+                                                        l_seg->len, l_cblk->data_current_size, cblkno, p_pi->precno, bandno, p_pi->resno, p_pi->compno);
+                                                return OPJ_FALSE;
+                                        }
+                                        memcpy(l_cblk->data + l_cblk->data_current_size, *l_seg->data + l_seg->dataindex, l_seg->len);
                                         l_seg->data = &l_cblk->data;
                                         l_seg->dataindex = l_cblk->data_current_size;
+                                        l_cblk->data_current_size += l_seg->len;
+                                }
+
+                                if (l_seg->data == &l_cblk->data) {
+                                        if (! opj_t2_reserve_cblk_data(l_cblk, l_seg->newlen)) {
+                                                fprintf(stderr, "read: segment too long (%d) with current size (%d) for codeblock %d (p=%d, b=%d, r=%d, c=%d)\n",
+                                                        l_seg->newlen, l_cblk->data_current_size, cblkno, p_pi->precno, bandno, p_pi->resno, p_pi->compno);
+                                                return OPJ_FALSE;
+                                        }
+                                        memcpy(l_cblk->data + l_cblk->data_current_size, l_current_data, l_seg->newlen);
+                                        l_cblk->data_current_size += l_seg->newlen;
                                 }
 
                                 l_current_data += l_seg->newlen;
@@ -1206,7 +1305,6 @@ OPJ_BOOL opj_t2_read_packet_data(   opj_t2_t* p_t2,
                                 l_cblk->numnewpasses -= l_seg->numnewpasses;
 
                                 l_seg->real_num_passes = l_seg->numpasses;
-                                l_cblk->data_current_size += l_seg->newlen;
                                 l_seg->len += l_seg->newlen;
 
                                 if (l_cblk->numnewpasses > 0) {
@@ -1228,6 +1326,36 @@ OPJ_BOOL opj_t2_read_packet_data(   opj_t2_t* p_t2,
         return OPJ_TRUE;
 }
 
+OPJ_BOOL opj_t2_reserve_cblk_data(opj_tcd_cblk_dec_t* p_cblk,
+                                  OPJ_UINT32 p_length)
+{
+        OPJ_UINT32 l_max_size = p_cblk->data_current_size + p_length;
+        OPJ_BYTE* l_new_data;
+
+        /* Check possible overflow on size */
+        if (l_max_size < p_cblk->data_current_size) {
+                return OPJ_FALSE;
+        }
+        if (l_max_size <= p_cblk->data_max_size) {
+                return OPJ_TRUE;
+        }
+
+        /* grows geometrically, the segment may go on in the packets of the next layers */
+        if (p_cblk->data_max_size > l_max_size / 2) {
+                l_max_size = (p_cblk->data_max_size > (OPJ_UINT32)-1 / 2) ? (OPJ_UINT32)-1 : p_cblk->data_max_size * 2;
+        }
+        l_new_data = (OPJ_BYTE*) opj_realloc(p_cblk->data, l_max_size);
+        if (! l_new_data) {
+                opj_free(p_cblk->data);
+                p_cblk->data = NULL;
+                p_cblk->data_max_size = 0;
+                return OPJ_FALSE;
+        }
+        p_cblk->data = l_new_data;
+        p_cblk->data_max_size = l_max_size;
+        return OPJ_TRUE;
+}
+
 OPJ_BOOL opj_t2_skip_packet_data(   opj_t2_t* p_t2,
                                     opj_tcd_tile_t *p_tile,
                                     opj_pi_iterator_t *p_pi,
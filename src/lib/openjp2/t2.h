@@ -72,6 +72,7 @@ Encode the packets of a tile to a destination buffer
 @param p_data_written   FIXME DOC
 @param len              the length of the destination buffer
 @param cstr_info        Codestream information structure
+@param packet_lengths   if not 00, receives the length of every packet written in the final pass, indexed by its number in the tile
 @param tpnum            Tile part number of the current tile
 @param tppos            The position of the tile part flag in the progression order
 @param pino             FIXME DOC
@@ -85,6 +86,7 @@ OPJ_BOOL opj_t2_encode_packets(	opj_t2_t* t2,
 								OPJ_UINT32 * p_data_written,
 								OPJ_UINT32 len,
 								opj_codestream_info_t *cstr_info,
+								OPJ_UINT32 * packet_lengths,
 								OPJ_UINT32 tpnum,
 								OPJ_INT32 tppos,
 								OPJ_UINT32 pino,
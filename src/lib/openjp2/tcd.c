@@ -110,9 +110,9 @@ void tcd_dump(FILE *fd, opj_tcd_t *tcd, opj_tcd_image_t * img) {
 static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no, OPJ_BOOL isEncoder, OPJ_FLOAT32 fraction, OPJ_SIZE_T sizeof_block);
 
 /**
-* Allocates memory for a decoding code block.
+* Allocates memory for a decoding code block, counted in p_stats (if any) for the tile p_tile_no.
 */
-static OPJ_BOOL opj_tcd_code_block_dec_allocate (opj_tcd_cblk_dec_t * p_code_block);
+static OPJ_BOOL opj_tcd_code_block_dec_allocate (opj_tcd_cblk_dec_t * p_code_block, opj_codec_stats_t * p_stats, OPJ_UINT32 p_tile_no);
 
 /**
  * Deallocates the decoding data of the given precinct.
@@ -120,9 +120,9 @@ static OPJ_BOOL opj_tcd_code_block_dec_allocate (opj_tcd_cblk_dec_t * p_code_blo
 static void opj_tcd_code_block_dec_deallocate (opj_tcd_precinct_t * p_precinct);
 
 /**
- * Allocates memory for an encoding code block.
+ * Allocates memory for an encoding code block, counted in p_stats (if any) for the tile p_tile_no.
  */
-static OPJ_BOOL opj_tcd_code_block_enc_allocate (opj_tcd_cblk_enc_t * p_code_block);
+static OPJ_BOOL opj_tcd_code_block_enc_allocate (opj_tcd_cblk_enc_t * p_code_block, opj_codec_stats_t * p_stats, OPJ_UINT32 p_tile_no);
 
 /**
  * Deallocates the encoding data of the given precinct.
@@ -151,6 +151,127 @@ static OPJ_BOOL opj_tcd_mct_decode (opj_tcd_t *p_tcd);
 
 static OPJ_BOOL opj_tcd_dc_level_shift_decode (opj_tcd_t *p_tcd);
 
+/**
+ * Tells if a component is decoded, see opj_dparameters_t::cp_comps.
+ */
+static OPJ_BOOL opj_tcd_is_decoded_comp (opj_tcd_t *p_tcd, OPJ_UINT32 p_compno);
+
+/**
+ * Tells if all the components combined by the MCT of the tile are decoded.
+ */
+static OPJ_BOOL opj_tcd_are_mct_comps_decoded (opj_tcd_t *p_tcd);
+
+/**
+ * Decoding state of a tile component decoded by strips.
+ */
+typedef struct opj_tcd_strip_comp
+{
+        /** T1 handle shared by the components */
+        opj_t1_t * t1;
+        opj_tcd_tilecomp_t * tilec;
+        opj_tccp_t * tccp;
+        /** number of resolution levels decoded */
+        OPJ_UINT32 numres;
+        /** decoded rows of the bands, 3 per resolution level */
+        opj_t1_band_rows_t * bands;
+        /** inverse wavelet transform by strips */
+        opj_dwt_strip_decoder_t * dwt;
+        /** rows of the decoded resolution of the current strip */
+        OPJ_INT32 * work;
+        /** rows of the current strip cropped to the decoded area */
+        OPJ_INT32 * data;
+} opj_tcd_strip_comp_t;
+
+/**
+ * Reads rows of a band of a tile component decoded by strips (opj_dwt_band_reader_fn).
+ */
+static OPJ_BOOL opj_tcd_read_band_rows (void * p_user_data,
+                                        OPJ_UINT32 p_resno,
+                                        OPJ_UINT32 p_bandno,
+                                        OPJ_UINT32 p_y0,
+                                        OPJ_UINT32 p_y1,
+                                        OPJ_INT32 * p_dest,
+                                        OPJ_UINT32 p_dest_stride);
+
+/**
+ * Frees the decoding state of the tile components decoded by strips.
+ */
+static void opj_tcd_free_strip_comps (opj_tcd_strip_comp_t * p_comps, OPJ_UINT32 p_numcomps);
+
+/**
+ * Applies the MCT to the samples of a strip, as opj_tcd_mct_decode does on a whole tile.
+ */
+static OPJ_BOOL opj_tcd_mct_decode_strip (opj_tcd_t *p_tcd, opj_tcd_strip_comp_t * p_comps, OPJ_UINT32 p_samples);
+
+/**
+ * Applies the DC level shift to the samples of a strip, as opj_tcd_dc_level_shift_decode does on a whole tile.
+ */
+static void opj_tcd_dc_level_shift_decode_strip (opj_tcd_t *p_tcd, OPJ_UINT32 p_compno, OPJ_INT32 * p_data, OPJ_UINT32 p_samples);
+
+/**
+ * Encoding state of a tile component encoded by strips.
+ */
+typedef struct opj_tcd_strip_enc_comp
+{
+        /** encoding state of the tile */
+        opj_tcd_strip_encoder_t * encoder;
+        OPJ_UINT32 compno;
+        /** rows of the bands waiting for their code-block row, 3 per resolution level */
+        opj_t1_band_rows_t * bands;
+        /** forward wavelet transform by strips */
+        opj_dwt_strip_encoder_t * dwt;
+        /** rows of the current strip */
+        OPJ_INT32 * work;
+} opj_tcd_strip_enc_comp_t;
+
+struct opj_tcd_strip_encoder
+{
+        opj_tcd_t * tcd;
+        /** T1 handle shared by the components */
+        opj_t1_t * t1;
+        const OPJ_FLOAT64 * mct_norms;
+        OPJ_UINT32 mct_numcomps;
+        opj_tcd_strip_enc_comp_t * comps;
+        /** number of rows the work buffers can hold */
+        OPJ_UINT32 work_rows;
+};
+
+/**
+ * Encodes rows of a band of a tile component encoded by strips (opj_dwt_band_writer_fn).
+ */
+static OPJ_BOOL opj_tcd_write_band_rows (void * p_user_data,
+                                         OPJ_UINT32 p_resno,
+                                         OPJ_UINT32 p_bandno,
+                                         const OPJ_INT32 * p_src,
+                                         OPJ_UINT32 p_src_stride,
+                                         OPJ_UINT32 p_nb_rows);
+
+/**
+ * Frees the encoding state of a tile encoded by strips.
+ */
+static void opj_tcd_free_strip_encoder (opj_tcd_t *p_tcd);
+
+/**
+ * Applies the MCT to the samples of a strip, as opj_tcd_mct_encode does on a whole tile.
+ */
+static OPJ_BOOL opj_tcd_mct_encode_strip (opj_tcd_t *p_tcd, OPJ_UINT32 p_samples);
+
+/**
+ * Gets the norms of the multiple component transform used by the rate allocation of tier-1.
+ *
+ * @param       p_tcd           TCD handle.
+ * @param       p_numcomps      number of components of the transform.
+*/
+static const OPJ_FLOAT64 * opj_tcd_get_mct_norms (opj_tcd_t *p_tcd, OPJ_UINT32 * p_numcomps);
+
+/**
+ * Tells if the coefficients of a tile to decode can be stored on 16 bits.
+ *
+ * @param       p_tcd           TCD handle.
+ * @param       p_tcp           coding parameters of the tile.
+*/
+static OPJ_BOOL opj_tcd_is_16bit_decodable (opj_tcd_t *p_tcd, opj_tcp_t * p_tcp);
+
 
 static OPJ_BOOL opj_tcd_dc_level_shift_encode ( opj_tcd_t *p_tcd );
 
@@ -171,6 +292,26 @@ static OPJ_BOOL opj_tcd_rate_allocate_encode(   opj_tcd_t *p_tcd,
                                                                                         OPJ_UINT32 p_max_dest_size,
                                                                                         opj_codestream_info_t *p_cstr_info );
 
+/**
+ * Starts timing a stage of the current tile, if the codec statistics are collected.
+*/
+static void opj_tcd_stage_start (opj_tcd_t *p_tcd, opj_stage_clock_t * p_clock);
+
+/**
+ * Adds the time of a stage of the current tile to the codec statistics, if they are collected.
+ *
+ * @param       p_tcd           TCD handle.
+ * @param       p_clock         clock started by opj_tcd_stage_start.
+ * @param       p_stage         stage that has run.
+ * @param       p_nb_bytes      bytes handled by the stage.
+*/
+static void opj_tcd_stage_stop (opj_tcd_t *p_tcd, const opj_stage_clock_t * p_clock, OPJ_CODEC_STAGE p_stage, OPJ_UINT64 p_nb_bytes);
+
+/**
+ * Gets the size of the samples of the current tile, as counted in the codec statistics.
+*/
+static OPJ_UINT64 opj_tcd_get_tile_samples_size (opj_tcd_t *p_tcd);
+
 /* ----------------------------------------------------------------------- */
 
 /**
@@ -511,7 +652,7 @@ OPJ_BOOL opj_tcd_rateallocate(  opj_tcd_t *tcd,
 
                                 if (cp->m_specific_param.m_enc.m_fixed_quality) {       /* fixed_quality */
                                         if(OPJ_IS_CINEMA(cp->rsiz)){
-                                                if (! opj_t2_encode_packets(t2,tcd->tcd_tileno, tcd_tile, layno + 1, dest, p_data_written, maxlen, cstr_info,tcd->cur_tp_num,tcd->tp_pos,tcd->cur_pino,THRESH_CALC)) {
+                                                if (! opj_t2_encode_packets(t2,tcd->tcd_tileno, tcd_tile, layno + 1, dest, p_data_written, maxlen, cstr_info, 00,tcd->cur_tp_num,tcd->tp_pos,tcd->cur_pino,THRESH_CALC)) {
 
                                                         lo = thresh;
                                                         continue;
@@ -540,7 +681,7 @@ OPJ_BOOL opj_tcd_rateallocate(  opj_tcd_t *tcd,
                                                 lo = thresh;
                                         }
                                 } else {
-                                        if (! opj_t2_encode_packets(t2, tcd->tcd_tileno, tcd_tile, layno + 1, dest,p_data_written, maxlen, cstr_info,tcd->cur_tp_num,tcd->tp_pos,tcd->cur_pino,THRESH_CALC))
+                                        if (! opj_t2_encode_packets(t2, tcd->tcd_tileno, tcd_tile, layno + 1, dest,p_data_written, maxlen, cstr_info, 00,tcd->cur_tp_num,tcd->tp_pos,tcd->cur_pino,THRESH_CALC))
                                         {
                                                 /* TODO: what to do with l ??? seek / tell ??? */
                                                 /* opj_event_msg(tcd->cinfo, EVT_INFO, "rate alloc: len=%d, max=%d\n", l, maxlen); */
@@ -607,7 +748,9 @@ Destroy a previously created TCD handle
 */
 void opj_tcd_destroy(opj_tcd_t *tcd) {
         if (tcd) {
+                opj_tcd_free_strip_encoder(tcd);
                 opj_tcd_free_tile(tcd);
+                opj_free(tcd->m_packet_lengths);
 
                 if (tcd->tcd_image) {
                         opj_free(tcd->tcd_image);
@@ -648,6 +791,29 @@ OPJ_BOOL opj_alloc_tile_component_data(opj_tcd_tilecomp_t *l_tilec)
 	return OPJ_TRUE;
 }
 
+OPJ_BOOL opj_tcd_widen_tile_component_data(opj_tcd_tilecomp_t *p_tilec)
+{
+	OPJ_UINT32 l_nb_samples = (OPJ_UINT32)((p_tilec->x1 - p_tilec->x0) * (p_tilec->y1 - p_tilec->y0));
+	OPJ_INT16 * l_src;
+	OPJ_UINT32 i;
+
+	assert(p_tilec->data_16bit && p_tilec->ownsData);
+
+	p_tilec->data_size_needed = l_nb_samples * (OPJ_UINT32)sizeof(OPJ_INT32);
+	if (! opj_alloc_tile_component_data(p_tilec)) {
+		return OPJ_FALSE;
+	}
+
+	/* from the last sample backward, a 32 bit sample only covers 16 bit samples already read */
+	l_src = (OPJ_INT16 *) p_tilec->data;
+	for (i = l_nb_samples; i-- > 0;) {
+		p_tilec->data[i] = l_src[i];
+	}
+	p_tilec->data_16bit = OPJ_FALSE;
+
+	return OPJ_TRUE;
+}
+
 /* ----------------------------------------------------------------------- */
 
 static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no, OPJ_BOOL isEncoder, OPJ_FLOAT32 fraction, OPJ_SIZE_T sizeof_block)
@@ -682,6 +848,8 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 	OPJ_UINT32 l_nb_code_blocks_size;
 	/* size of data for a tile */
 	OPJ_UINT32 l_data_size;
+	/* size of a sample of the tile component data */
+	OPJ_UINT32 l_sample_size;
 	
 	l_cp = p_tcd->cp;
 	l_tcp = &(l_cp->tcps[p_tile_no]);
@@ -707,6 +875,9 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 	}
 	/*fprintf(stderr, "Tile border = %d,%d,%d,%d\n", l_tile->x0, l_tile->y0,l_tile->x1,l_tile->y1);*/
 	
+	/* reversible tiles of low bit depth are decoded with half the memory */
+	l_sample_size = (p_tcd->m_is_decoder && opj_tcd_is_16bit_decodable(p_tcd, l_tcp)) ? (OPJ_UINT32)sizeof(OPJ_INT16) : (OPJ_UINT32)sizeof(OPJ_UINT32);
+	
 	/*tile->numcomps = image->numcomps; */
 	for (compno = 0; compno < l_tile->numcomps; ++compno) {
 		/*fprintf(stderr, "compno = %d/%d\n", compno, l_tile->numcomps);*/
@@ -726,11 +897,11 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 		}
 		l_data_size = l_data_size * (OPJ_UINT32)(l_tilec->y1 - l_tilec->y0);
 		
-		if ((((OPJ_UINT32)-1) / (OPJ_UINT32)sizeof(OPJ_UINT32)) < l_data_size) {
+		if ((((OPJ_UINT32)-1) / l_sample_size) < l_data_size) {
 			/* TODO event */
 			return OPJ_FALSE;
 		}
-		l_data_size = l_data_size * (OPJ_UINT32)sizeof(OPJ_UINT32);
+		l_data_size = l_data_size * l_sample_size;
 		l_tilec->numresolutions = l_tccp->numresolutions;
 		if (l_tccp->numresolutions < l_cp->m_specific_param.m_dec.m_reduce) {
 			l_tilec->minimum_num_resolutions = 1;
@@ -740,8 +911,16 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 		}
 		
 		l_tilec->data_size_needed = l_data_size;
-		if (p_tcd->m_is_decoder && !opj_alloc_tile_component_data(l_tilec)) {
-			return OPJ_FALSE;
+		l_tilec->data_16bit = (l_sample_size == sizeof(OPJ_INT16));
+		/* no samples are kept for the components which are not decoded */
+		if (p_tcd->m_is_decoder && !p_tcd->m_decode_by_strips && opj_tcd_is_decoded_comp(p_tcd, compno)) {
+			OPJ_UINT32 l_old_data_size = l_tilec->data_size;
+			if (! opj_alloc_tile_component_data(l_tilec)) {
+				return OPJ_FALSE;
+			}
+			if (p_tcd->m_stats && l_tilec->data_size != l_old_data_size) {
+				opj_codec_stats_count_alloc(p_tcd->m_stats, p_tile_no, l_tilec->data_size);
+			}
 		}
 		
 		l_data_size = l_tilec->numresolutions * (OPJ_UINT32)sizeof(opj_tcd_resolution_t);
@@ -754,6 +933,9 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 			/*fprintf(stderr, "\tAllocate resolutions of tilec (opj_tcd_resolution_t): %d\n",l_data_size);*/
 			l_tilec->resolutions_size = l_data_size;
 			memset(l_tilec->resolutions,0,l_data_size);
+			if (p_tcd->m_stats) {
+				opj_codec_stats_count_alloc(p_tcd->m_stats, p_tile_no, l_data_size);
+			}
 		}
 		else if (l_data_size > l_tilec->resolutions_size) {
 			opj_tcd_resolution_t* new_resolutions = (opj_tcd_resolution_t *) opj_realloc(l_tilec->resolutions, l_data_size);
@@ -769,6 +951,9 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 			/*fprintf(stderr, "\tReallocate data of tilec (int): from %d to %d x OPJ_UINT32\n", l_tilec->resolutions_size, l_data_size);*/
 			memset(((OPJ_BYTE*) l_tilec->resolutions)+l_tilec->resolutions_size,0,l_data_size - l_tilec->resolutions_size);
 			l_tilec->resolutions_size = l_data_size;
+			if (p_tcd->m_stats) {
+				opj_codec_stats_count_alloc(p_tcd->m_stats, p_tile_no, l_data_size);
+			}
 		}
 		
 		l_level_no = l_tilec->numresolutions - 1;
@@ -872,6 +1057,9 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 					/*fprintf(stderr, "\t\t\t\tAllocate precincts of a band (opj_tcd_precinct_t): %d\n",l_nb_precinct_size);     */
 					memset(l_band->precincts,0,l_nb_precinct_size);
 					l_band->precincts_data_size = l_nb_precinct_size;
+					if (p_tcd->m_stats) {
+						opj_codec_stats_count_alloc(p_tcd->m_stats, p_tile_no, l_nb_precinct_size);
+					}
 				}
 				else if (l_band->precincts_data_size < l_nb_precinct_size) {
 					
@@ -888,6 +1076,9 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 					/*fprintf(stderr, "\t\t\t\tReallocate precincts of a band (opj_tcd_precinct_t): from %d to %d\n",l_band->precincts_data_size, l_nb_precinct_size);*/
 					memset(((OPJ_BYTE *) l_band->precincts) + l_band->precincts_data_size,0,l_nb_precinct_size - l_band->precincts_data_size);
 					l_band->precincts_data_size = l_nb_precinct_size;
+					if (p_tcd->m_stats) {
+						opj_codec_stats_count_alloc(p_tcd->m_stats, p_tile_no, l_nb_precinct_size);
+					}
 				}
 				
 				l_current_precinct = l_band->precincts;
@@ -934,6 +1125,9 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 						memset(l_current_precinct->cblks.blocks,0,l_nb_code_blocks_size);
 						
 						l_current_precinct->block_size = l_nb_code_blocks_size;
+						if (p_tcd->m_stats) {
+							opj_codec_stats_count_alloc(p_tcd->m_stats, p_tile_no, l_nb_code_blocks_size);
+						}
 					}
 					else if (l_nb_code_blocks_size > l_current_precinct->block_size) {
 						void *new_blocks = opj_realloc(l_current_precinct->cblks.blocks, l_nb_code_blocks_size);
@@ -953,11 +1147,17 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 									 ,l_nb_code_blocks_size - l_current_precinct->block_size);
 						
 						l_current_precinct->block_size = l_nb_code_blocks_size;
+						if (p_tcd->m_stats) {
+							opj_codec_stats_count_alloc(p_tcd->m_stats, p_tile_no, l_nb_code_blocks_size);
+						}
 					}
 					
 					if (! l_current_precinct->incltree) {
 						l_current_precinct->incltree = opj_tgt_create(l_current_precinct->cw,
 																													l_current_precinct->ch);
+						if (p_tcd->m_stats && l_current_precinct->incltree) {
+							opj_codec_stats_count_alloc(p_tcd->m_stats, p_tile_no, l_current_precinct->incltree->nodes_size);
+						}
 					}
 					else{
 						l_current_precinct->incltree = opj_tgt_init(l_current_precinct->incltree,
@@ -974,6 +1174,9 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 						l_current_precinct->imsbtree = opj_tgt_create(
 																													l_current_precinct->cw,
 																													l_current_precinct->ch);
+						if (p_tcd->m_stats && l_current_precinct->imsbtree) {
+							opj_codec_stats_count_alloc(p_tcd->m_stats, p_tile_no, l_current_precinct->imsbtree->nodes_size);
+						}
 					}
 					else {
 						l_current_precinct->imsbtree = opj_tgt_init(
@@ -996,7 +1199,7 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 						if (isEncoder) {
 							opj_tcd_cblk_enc_t* l_code_block = l_current_precinct->cblks.enc + cblkno;
 							
-							if (! opj_tcd_code_block_enc_allocate(l_code_block)) {
+							if (! opj_tcd_code_block_enc_allocate(l_code_block, p_tcd->m_stats, p_tile_no)) {
 								return OPJ_FALSE;
 							}
 							/* code-block size (global) */
@@ -1007,7 +1210,7 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 						} else {
 							opj_tcd_cblk_dec_t* l_code_block = l_current_precinct->cblks.dec + cblkno;
 							
-							if (! opj_tcd_code_block_dec_allocate(l_code_block)) {
+							if (! opj_tcd_code_block_dec_allocate(l_code_block, p_tcd->m_stats, p_tile_no)) {
 								return OPJ_FALSE;
 							}
 							/* code-block size (global) */
@@ -1045,7 +1248,7 @@ OPJ_BOOL opj_tcd_init_decode_tile (opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no)
 /**
  * Allocates memory for an encoding code block.
  */
-OPJ_BOOL opj_tcd_code_block_enc_allocate (opj_tcd_cblk_enc_t * p_code_block)
+OPJ_BOOL opj_tcd_code_block_enc_allocate (opj_tcd_cblk_enc_t * p_code_block, opj_codec_stats_t * p_stats, OPJ_UINT32 p_tile_no)
 {
         if (! p_code_block->data) {
 
@@ -1053,6 +1256,9 @@ OPJ_BOOL opj_tcd_code_block_enc_allocate (opj_tcd_cblk_enc_t * p_code_block)
                 if(! p_code_block->data) {
                         return OPJ_FALSE;
                 }
+                if (p_stats) {
+                        opj_codec_stats_count_alloc(p_stats, p_tile_no, OPJ_J2K_DEFAULT_CBLK_DATA_SIZE*2);
+                }
 
                 p_code_block->data[0] = 0;
                 p_code_block->data+=1;
@@ -1062,11 +1268,17 @@ OPJ_BOOL opj_tcd_code_block_enc_allocate (opj_tcd_cblk_enc_t * p_code_block)
                 if (! p_code_block->layers) {
                         return OPJ_FALSE;
                 }
+                if (p_stats) {
+                        opj_codec_stats_count_alloc(p_stats, p_tile_no, 100 * sizeof(opj_tcd_layer_t));
+                }
 
                 p_code_block->passes = (opj_tcd_pass_t*) opj_calloc(100, sizeof(opj_tcd_pass_t));
                 if (! p_code_block->passes) {
                         return OPJ_FALSE;
                 }
+                if (p_stats) {
+                        opj_codec_stats_count_alloc(p_stats, p_tile_no, 100 * sizeof(opj_tcd_pass_t));
+                }
         }
 
         return OPJ_TRUE;
@@ -1075,21 +1287,18 @@ OPJ_BOOL opj_tcd_code_block_enc_allocate (opj_tcd_cblk_enc_t * p_code_block)
 /**
  * Allocates memory for a decoding code block.
  */
-OPJ_BOOL opj_tcd_code_block_dec_allocate (opj_tcd_cblk_dec_t * p_code_block)
+OPJ_BOOL opj_tcd_code_block_dec_allocate (opj_tcd_cblk_dec_t * p_code_block, opj_codec_stats_t * p_stats, OPJ_UINT32 p_tile_no)
 {
-        if (! p_code_block->data) {
-
-                p_code_block->data = (OPJ_BYTE*) opj_malloc(OPJ_J2K_DEFAULT_CBLK_DATA_SIZE);
-                if (! p_code_block->data) {
-                        return OPJ_FALSE;
-                }
-                p_code_block->data_max_size = OPJ_J2K_DEFAULT_CBLK_DATA_SIZE;
-                /*fprintf(stderr, "Allocate 8192 elements of code_block->data\n");*/
-
+        if (! p_code_block->segs) {
+                /* the segments are read in place from the tile data, the code-block data is only
+                 * allocated by T2 for the ones that go on in several packets */
                 p_code_block->segs = (opj_tcd_seg_t *) opj_calloc(OPJ_J2K_DEFAULT_NB_SEGS,sizeof(opj_tcd_seg_t));
                 if (! p_code_block->segs) {
                         return OPJ_FALSE;
                 }
+                if (p_stats) {
+                        opj_codec_stats_count_alloc(p_stats, p_tile_no, OPJ_J2K_DEFAULT_NB_SEGS * sizeof(opj_tcd_seg_t));
+                }
                 /*fprintf(stderr, "Allocate %d elements of code_block->data\n", OPJ_J2K_DEFAULT_NB_SEGS * sizeof(opj_tcd_seg_t));*/
 
                 p_code_block->m_current_max_segs = OPJ_J2K_DEFAULT_NB_SEGS;
@@ -1124,6 +1333,12 @@ OPJ_UINT32 opj_tcd_get_decoded_tile_size ( opj_tcd_t *p_tcd )
         l_img_comp = p_tcd->image->comps;
 
         for (i=0;i<p_tcd->image->numcomps;++i) {
+                if (! opj_tcd_is_decoded_comp(p_tcd, i)) {
+                        ++l_img_comp;
+                        ++l_tile_comp;
+                        continue;
+                }
+
                 l_size_comp = l_img_comp->prec >> 3; /*(/ 8)*/
                 l_remaining = l_img_comp->prec & 7;  /* (%8) */
 
@@ -1144,6 +1359,22 @@ OPJ_UINT32 opj_tcd_get_decoded_tile_size ( opj_tcd_t *p_tcd )
         return l_data_size;
 }
 
+OPJ_UINT32 opj_tcd_get_nb_precincts ( opj_tcd_t *p_tcd )
+{
+        OPJ_UINT32 compno, resno;
+        OPJ_UINT32 l_nb_precincts = 0;
+        opj_tcd_tilecomp_t * l_tile_comp = p_tcd->tcd_image->tiles->comps;
+
+        for (compno = 0; compno < p_tcd->tcd_image->tiles->numcomps; ++compno) {
+                for (resno = 0; resno < l_tile_comp->numresolutions; ++resno) {
+                        l_nb_precincts += l_tile_comp->resolutions[resno].pw * l_tile_comp->resolutions[resno].ph;
+                }
+                ++l_tile_comp;
+        }
+
+        return l_nb_precincts;
+}
+
 OPJ_BOOL opj_tcd_encode_tile(   opj_tcd_t *p_tcd,
                                                         OPJ_UINT32 p_tile_no,
                                                         OPJ_BYTE *p_dest,
@@ -1151,11 +1382,14 @@ OPJ_BOOL opj_tcd_encode_tile(   opj_tcd_t *p_tcd,
                                                         OPJ_UINT32 p_max_length,
                                                         opj_codestream_info_t *p_cstr_info)
 {
+        opj_stage_clock_t l_clock;
 
         if (p_tcd->cur_tp_num == 0) {
+                OPJ_UINT64 l_samples_size;
 
                 p_tcd->tcd_tileno = p_tile_no;
                 p_tcd->tcp = &p_tcd->cp->tcps[p_tile_no];
+                l_samples_size = p_tcd->m_stats ? opj_tcd_get_tile_samples_size(p_tcd) : 0;
 
                 /* INDEX >> "Precinct_nb_X et Precinct_nb_Y" */
                 if(p_cstr_info)  {
@@ -1182,36 +1416,42 @@ OPJ_BOOL opj_tcd_encode_tile(   opj_tcd_t *p_tcd,
                 }
                 /* << INDEX */
 
-                /* FIXME _ProfStart(PGROUP_DC_SHIFT); */
-                /*---------------TILE-------------------*/
-                if (! opj_tcd_dc_level_shift_encode(p_tcd)) {
-                        return OPJ_FALSE;
+                if (p_tcd->m_strip_encoder) {
+                        /* the code-blocks were encoded by opj_tcd_encode_strip */
+                        opj_tcd_free_strip_encoder(p_tcd);
                 }
-                /* FIXME _ProfStop(PGROUP_DC_SHIFT); */
+                else {
+                        /*---------------TILE-------------------*/
+                        opj_tcd_stage_start(p_tcd, &l_clock);
+                        if (! opj_tcd_dc_level_shift_encode(p_tcd)) {
+                                return OPJ_FALSE;
+                        }
+                        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_DC_SHIFT, l_samples_size);
 
-                /* FIXME _ProfStart(PGROUP_MCT); */
-                if (! opj_tcd_mct_encode(p_tcd)) {
-                        return OPJ_FALSE;
-                }
-                /* FIXME _ProfStop(PGROUP_MCT); */
+                        opj_tcd_stage_start(p_tcd, &l_clock);
+                        if (! opj_tcd_mct_encode(p_tcd)) {
+                                return OPJ_FALSE;
+                        }
+                        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_MCT, l_samples_size);
 
-                /* FIXME _ProfStart(PGROUP_DWT); */
-                if (! opj_tcd_dwt_encode(p_tcd)) {
-                        return OPJ_FALSE;
-                }
-                /* FIXME  _ProfStop(PGROUP_DWT); */
+                        opj_tcd_stage_start(p_tcd, &l_clock);
+                        if (! opj_tcd_dwt_encode(p_tcd)) {
+                                return OPJ_FALSE;
+                        }
+                        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_DWT, l_samples_size);
 
-                /* FIXME  _ProfStart(PGROUP_T1); */
-                if (! opj_tcd_t1_encode(p_tcd)) {
-                        return OPJ_FALSE;
+                        opj_tcd_stage_start(p_tcd, &l_clock);
+                        if (! opj_tcd_t1_encode(p_tcd)) {
+                                return OPJ_FALSE;
+                        }
+                        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_T1, l_samples_size);
                 }
-                /* FIXME _ProfStop(PGROUP_T1); */
 
-                /* FIXME _ProfStart(PGROUP_RATE); */
+                opj_tcd_stage_start(p_tcd, &l_clock);
                 if (! opj_tcd_rate_allocate_encode(p_tcd,p_dest,p_max_length,p_cstr_info)) {
                         return OPJ_FALSE;
                 }
-                /* FIXME _ProfStop(PGROUP_RATE); */
+                opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_RATE, l_samples_size);
 
         }
         /*--------------TIER2------------------*/
@@ -1220,12 +1460,11 @@ OPJ_BOOL opj_tcd_encode_tile(   opj_tcd_t *p_tcd,
         if (p_cstr_info) {
                 p_cstr_info->index_write = 1;
         }
-        /* FIXME _ProfStart(PGROUP_T2); */
-
+        opj_tcd_stage_start(p_tcd, &l_clock);
         if (! opj_tcd_t2_encode(p_tcd,p_dest,p_data_written,p_max_length,p_cstr_info)) {
                 return OPJ_FALSE;
         }
-        /* FIXME _ProfStop(PGROUP_T2); */
+        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_T2, *p_data_written);
 
         /*---------------CLEAN-------------------*/
 
@@ -1240,8 +1479,12 @@ OPJ_BOOL opj_tcd_decode_tile(   opj_tcd_t *p_tcd,
                                 )
 {
         OPJ_UINT32 l_data_read;
+        opj_stage_clock_t l_clock;
+        OPJ_UINT64 l_samples_size;
+
         p_tcd->tcd_tileno = p_tile_no;
         p_tcd->tcp = &(p_tcd->cp->tcps[p_tile_no]);
+        l_samples_size = p_tcd->m_stats ? opj_tcd_get_tile_samples_size(p_tcd) : 0;
 
 #ifdef TODO_MSD /* FIXME */
         /* INDEX >>  */
@@ -1267,50 +1510,50 @@ OPJ_BOOL opj_tcd_decode_tile(   opj_tcd_t *p_tcd,
 #endif
 
         /*--------------TIER2------------------*/
-        /* FIXME _ProfStart(PGROUP_T2); */
+        opj_tcd_stage_start(p_tcd, &l_clock);
         l_data_read = 0;
         if (! opj_tcd_t2_decode(p_tcd, p_src, &l_data_read, p_max_length, p_cstr_index))
         {
                 return OPJ_FALSE;
         }
-        /* FIXME _ProfStop(PGROUP_T2); */
+        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_T2, l_data_read);
 
         /*------------------TIER1-----------------*/
 
-        /* FIXME _ProfStart(PGROUP_T1); */
+        opj_tcd_stage_start(p_tcd, &l_clock);
         if
                 (! opj_tcd_t1_decode(p_tcd))
         {
                 return OPJ_FALSE;
         }
-        /* FIXME _ProfStop(PGROUP_T1); */
+        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_T1, l_samples_size);
 
         /*----------------DWT---------------------*/
 
-        /* FIXME _ProfStart(PGROUP_DWT); */
+        opj_tcd_stage_start(p_tcd, &l_clock);
         if
                 (! opj_tcd_dwt_decode(p_tcd))
         {
                 return OPJ_FALSE;
         }
-        /* FIXME _ProfStop(PGROUP_DWT); */
+        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_DWT, l_samples_size);
 
         /*----------------MCT-------------------*/
-        /* FIXME _ProfStart(PGROUP_MCT); */
+        opj_tcd_stage_start(p_tcd, &l_clock);
         if
                 (! opj_tcd_mct_decode(p_tcd))
         {
                 return OPJ_FALSE;
         }
-        /* FIXME _ProfStop(PGROUP_MCT); */
+        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_MCT, l_samples_size);
 
-        /* FIXME _ProfStart(PGROUP_DC_SHIFT); */
+        opj_tcd_stage_start(p_tcd, &l_clock);
         if
                 (! opj_tcd_dc_level_shift_decode(p_tcd))
         {
                 return OPJ_FALSE;
         }
-        /* FIXME _ProfStop(PGROUP_DC_SHIFT); */
+        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_DC_SHIFT, l_samples_size);
 
 
         /*---------------TILE-------------------*/
@@ -1338,6 +1581,13 @@ OPJ_BOOL opj_tcd_update_tile_data ( opj_tcd_t *p_tcd,
         l_img_comp = p_tcd->image->comps;
 
         for (i=0;i<p_tcd->image->numcomps;++i) {
+                /* only the decoded components are written, one after the other */
+                if (! opj_tcd_is_decoded_comp(p_tcd, i)) {
+                        ++l_img_comp;
+                        ++l_tilec;
+                        continue;
+                }
+
                 l_size_comp = l_img_comp->prec >> 3; /*(/ 8)*/
                 l_remaining = l_img_comp->prec & 7;  /* (%8) */
                 l_res = l_tilec->resolutions + l_img_comp->resno_decoded;
@@ -1353,6 +1603,35 @@ OPJ_BOOL opj_tcd_update_tile_data ( opj_tcd_t *p_tcd,
                         l_size_comp = 4;
                 }
 
+                if (l_tilec->data_16bit) {
+                        /* at most 12 bits samples, already in the range of the output type */
+                        const OPJ_INT16 * l_src_ptr = (const OPJ_INT16 *) l_tilec->data;
+
+                        if (l_size_comp == 1) {
+                                OPJ_CHAR * l_dest_ptr = (OPJ_CHAR *) p_dest;
+                                for (j=0;j<l_height;++j) {
+                                        for (k=0;k<l_width;++k) {
+                                                *(l_dest_ptr++) = (OPJ_CHAR) (*(l_src_ptr++));
+                                        }
+                                        l_src_ptr += l_stride;
+                                }
+                                p_dest = (OPJ_BYTE *)l_dest_ptr;
+                        }
+                        else {
+                                OPJ_INT16 * l_dest_ptr = (OPJ_INT16 *) p_dest;
+                                for (j=0;j<l_height;++j) {
+                                        memcpy(l_dest_ptr, l_src_ptr, l_width * sizeof(OPJ_INT16));
+                                        l_dest_ptr += l_width;
+                                        l_src_ptr += l_width + l_stride;
+                                }
+                                p_dest = (OPJ_BYTE *)l_dest_ptr;
+                        }
+
+                        ++l_img_comp;
+                        ++l_tilec;
+                        continue;
+                }
+
                 switch (l_size_comp)
                         {
                         case 1:
@@ -1562,6 +1841,11 @@ OPJ_BOOL opj_tcd_t1_decode ( opj_tcd_t *p_tcd )
         }
 
         for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                if (! opj_tcd_is_decoded_comp(p_tcd, compno)) {
+                        ++l_tile_comp;
+                        ++l_tccp;
+                        continue;
+                }
                 /* The +3 is headroom required by the vectorized DWT */
                 if (OPJ_FALSE == opj_t1_decode_cblks(l_t1, l_tile_comp, l_tccp)) {
                         opj_t1_destroy(l_t1);
@@ -1599,7 +1883,10 @@ OPJ_BOOL opj_tcd_dwt_decode ( opj_tcd_t *p_tcd )
                 if(numres2decode > 0){
                 */
 
-                if (l_tccp->qmfbid == 1) {
+                if (! opj_tcd_is_decoded_comp(p_tcd, compno)) {
+                        /* nothing to transform */
+                }
+                else if (l_tccp->qmfbid == 1) {
                         if (! opj_dwt_decode(l_tile_comp, l_img_comp->resno_decoded+1)) {
                                 return OPJ_FALSE;
                         }
@@ -1617,6 +1904,40 @@ OPJ_BOOL opj_tcd_dwt_decode ( opj_tcd_t *p_tcd )
 
         return OPJ_TRUE;
 }
+OPJ_BOOL opj_tcd_is_16bit_decodable (opj_tcd_t *p_tcd, opj_tcp_t * p_tcp)
+{
+        OPJ_UINT32 compno, bandno;
+        opj_tccp_t * l_tccp = p_tcp->tccps;
+        opj_image_comp_t * l_img_comp = p_tcd->image->comps;
+
+        /* custom decorrelation works on 32 bit samples */
+        if (p_tcp->mct == 2) {
+                return OPJ_FALSE;
+        }
+
+        for (compno = 0; compno < p_tcd->image->numcomps; ++compno) {
+                /* the background of a region of interest is scaled beyond the bit-planes of its band */
+                if (l_tccp->qmfbid != 1 || l_img_comp->prec > 12 || l_tccp->roishift != 0) {
+                        return OPJ_FALSE;
+                }
+
+                /* The magnitude bit-planes of a band (guard bits included) bound its
+                 * coefficients : with the sign bit they must fit in 16 bits. The values
+                 * rebuilt by the 5-3 inverse transform of a lossy or damaged code-stream
+                 * may not fit, the tile component is then widened to 32 bits. */
+                for (bandno = 0; bandno < l_tccp->numresolutions * 3 - 2; ++bandno) {
+                        if (l_tccp->stepsizes[bandno].expn + (OPJ_INT32)l_tccp->numgbits - 1 > 15) {
+                                return OPJ_FALSE;
+                        }
+                }
+
+                ++l_tccp;
+                ++l_img_comp;
+        }
+
+        return OPJ_TRUE;
+}
+
 OPJ_BOOL opj_tcd_mct_decode ( opj_tcd_t *p_tcd )
 {
         opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
@@ -1628,6 +1949,11 @@ OPJ_BOOL opj_tcd_mct_decode ( opj_tcd_t *p_tcd )
                 return OPJ_TRUE;
         }
 
+        /* the decoded components keep their transformed values when the others are not decoded */
+        if (! opj_tcd_are_mct_comps_decoded(p_tcd)) {
+                return OPJ_TRUE;
+        }
+
         l_samples = (OPJ_UINT32)((l_tile_comp->x1 - l_tile_comp->x0) * (l_tile_comp->y1 - l_tile_comp->y0));
 
         if (l_tile->numcomps >= 3 ){
@@ -1672,7 +1998,22 @@ OPJ_BOOL opj_tcd_mct_decode ( opj_tcd_t *p_tcd )
                         opj_free(l_data);
                 }
                 else {
-                        if (l_tcp->tccps->qmfbid == 1) {
+                        /* a component widened by its inverse transform widens the two others */
+                        if (l_tile->comps[0].data_16bit != l_tile->comps[1].data_16bit || l_tile->comps[0].data_16bit != l_tile->comps[2].data_16bit) {
+                                for (i = 0; i < 3; ++i) {
+                                        if (l_tile->comps[i].data_16bit && ! opj_tcd_widen_tile_component_data(&l_tile->comps[i])) {
+                                                return OPJ_FALSE;
+                                        }
+                                }
+                        }
+
+                        if (l_tile->comps[0].data_16bit) {
+                                opj_mct_decode_16(  (OPJ_INT16*)l_tile->comps[0].data,
+                                                    (OPJ_INT16*)l_tile->comps[1].data,
+                                                    (OPJ_INT16*)l_tile->comps[2].data,
+                                                    l_samples);
+                        }
+                        else if (l_tcp->tccps->qmfbid == 1) {
                                 opj_mct_decode(     l_tile->comps[0].data,
                                                         l_tile->comps[1].data,
                                                         l_tile->comps[2].data,
@@ -1714,12 +2055,19 @@ OPJ_BOOL opj_tcd_dc_level_shift_decode ( opj_tcd_t *p_tcd )
         l_img_comp = p_tcd->image->comps;
 
         for (compno = 0; compno < l_tile->numcomps; compno++) {
+                if (! opj_tcd_is_decoded_comp(p_tcd, compno)) {
+                        ++l_img_comp;
+                        ++l_tccp;
+                        ++l_tile_comp;
+                        continue;
+                }
+
                 l_res = l_tile_comp->resolutions + l_img_comp->resno_decoded;
                 l_width = (OPJ_UINT32)(l_res->x1 - l_res->x0);
                 l_height = (OPJ_UINT32)(l_res->y1 - l_res->y0);
                 l_stride = (OPJ_UINT32)(l_tile_comp->x1 - l_tile_comp->x0) - l_width;
 
-                assert(l_height == 0 || l_width + l_stride <= l_tile_comp->data_size / l_height); /*MUPDF*/
+                assert(l_height == 0 || l_width + l_stride <= l_tile_comp->data_size / (l_tile_comp->data_16bit ? sizeof(OPJ_INT16) : sizeof(OPJ_INT32)) / l_height); /*MUPDF*/
 
                 if (l_img_comp->sgnd) {
                         l_min = -(1 << (l_img_comp->prec - 1));
@@ -1732,7 +2080,17 @@ OPJ_BOOL opj_tcd_dc_level_shift_decode ( opj_tcd_t *p_tcd )
 
                 l_current_ptr = l_tile_comp->data;
 
-                if (l_tccp->qmfbid == 1) {
+                if (l_tile_comp->data_16bit) {
+                        OPJ_INT16 * l_current_ptr16 = (OPJ_INT16 *) l_current_ptr;
+                        for (j=0;j<l_height;++j) {
+                                for (i = 0; i < l_width; ++i) {
+                                        *l_current_ptr16 = (OPJ_INT16)opj_int_clamp(*l_current_ptr16 + l_tccp->m_dc_level_shift, l_min, l_max);
+                                        ++l_current_ptr16;
+                                }
+                                l_current_ptr16 += l_stride;
+                        }
+                }
+                else if (l_tccp->qmfbid == 1) {
                         for (j=0;j<l_height;++j) {
                                 for (i = 0; i < l_width; ++i) {
                                         *l_current_ptr = opj_int_clamp(*l_current_ptr + l_tccp->m_dc_level_shift, l_min, l_max);
@@ -1762,6 +2120,342 @@ OPJ_BOOL opj_tcd_dc_level_shift_decode ( opj_tcd_t *p_tcd )
 
 
 
+OPJ_BOOL opj_tcd_decode_tile_strips(    opj_tcd_t *p_tcd,
+                                        OPJ_BYTE *p_src,
+                                        OPJ_UINT32 p_max_length,
+                                        OPJ_UINT32 p_tile_no,
+                                        opj_codestream_index_t *p_cstr_index,
+                                        opj_image_t *p_output_image,
+                                        OPJ_UINT32 p_strip_height,
+                                        opj_strip_decode_fn p_strip_fn,
+                                        void *p_user_data)
+{
+        OPJ_UINT32 l_data_read, compno, resno, bandno, j, l_nb_comps;
+        opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+        opj_image_comp_t * l_img_comp = p_tcd->image->comps;
+        opj_image_comp_t * l_img_comp_dest = p_output_image->comps;
+        opj_tcd_resolution_t * l_res;
+        opj_tcd_strip_comp_t * l_comps;
+        OPJ_INT32 ** l_comps_data;
+        opj_t1_t * l_t1;
+        OPJ_INT32 l_x0_dest, l_y0_dest, l_x0, l_y0, l_x1, l_y1, l_y;
+        OPJ_UINT32 l_res_w, l_width, l_nb_rows;
+        OPJ_BOOL l_success = OPJ_TRUE;
+        opj_stage_clock_t l_clock;
+        OPJ_UINT64 l_strip_size;
+
+        p_tcd->tcd_tileno = p_tile_no;
+        p_tcd->tcp = &(p_tcd->cp->tcps[p_tile_no]);
+
+        /*--------------TIER2------------------*/
+        opj_tcd_stage_start(p_tcd, &l_clock);
+        l_data_read = 0;
+        if (! opj_tcd_t2_decode(p_tcd, p_src, &l_data_read, p_max_length, p_cstr_index))
+        {
+                return OPJ_FALSE;
+        }
+        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_T2, l_data_read);
+
+        /* Every component is decoded on the grid of the first one, see opj_j2k_decode_strips.
+         * The output image only holds the decoded components. */
+        l_res = 00;
+        l_nb_comps = 0;
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                opj_tcd_resolution_t * l_res_comp = l_tile->comps[compno].resolutions + l_img_comp[compno].resno_decoded;
+                if (! opj_tcd_is_decoded_comp(p_tcd, compno)) {
+                        continue;
+                }
+                if (! l_res) {
+                        l_res = l_res_comp;
+                }
+                else if (l_res_comp->x0 != l_res->x0 || l_res_comp->y0 != l_res->y0
+                                || l_res_comp->x1 != l_res->x1 || l_res_comp->y1 != l_res->y1) {
+                        return OPJ_FALSE;
+                }
+                if (l_nb_comps >= p_output_image->numcomps) {
+                        return OPJ_FALSE;
+                }
+                p_output_image->comps[l_nb_comps++].resno_decoded = l_img_comp[compno].resno_decoded;
+        }
+        if (! l_res || l_nb_comps != p_output_image->numcomps) {
+                return OPJ_FALSE;
+        }
+
+        /* Part of the decoded tile inside the output area, as in opj_j2k_update_image_data */
+        l_x0_dest = opj_int_ceildivpow2((OPJ_INT32)l_img_comp_dest->x0, (OPJ_INT32)l_img_comp_dest->factor);
+        l_y0_dest = opj_int_ceildivpow2((OPJ_INT32)l_img_comp_dest->y0, (OPJ_INT32)l_img_comp_dest->factor);
+        l_x0 = opj_int_max(l_res->x0, l_x0_dest);
+        l_y0 = opj_int_max(l_res->y0, l_y0_dest);
+        l_x1 = opj_int_min(l_res->x1, l_x0_dest + (OPJ_INT32)l_img_comp_dest->w);
+        l_y1 = opj_int_min(l_res->y1, l_y0_dest + (OPJ_INT32)l_img_comp_dest->h);
+        if (l_x1 <= l_x0 || l_y1 <= l_y0) {
+                return OPJ_TRUE;
+        }
+        l_res_w = (OPJ_UINT32)(l_res->x1 - l_res->x0);
+        l_width = (OPJ_UINT32)(l_x1 - l_x0);
+
+        l_comps = (opj_tcd_strip_comp_t *) opj_calloc(l_tile->numcomps, sizeof(opj_tcd_strip_comp_t));
+        l_comps_data = (OPJ_INT32 **) opj_calloc(l_nb_comps, sizeof(OPJ_INT32 *));
+        l_t1 = opj_t1_create(OPJ_FALSE);
+        if (! l_comps || ! l_comps_data || ! l_t1) {
+                opj_free(l_comps);
+                opj_free(l_comps_data);
+                if (l_t1) {
+                        opj_t1_destroy(l_t1);
+                }
+                return OPJ_FALSE;
+        }
+
+        l_nb_comps = 0;
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                opj_tcd_strip_comp_t * l_comp = l_comps + compno;
+                OPJ_UINT32 l_numres = l_img_comp[compno].resno_decoded + 1;
+
+                /* the components which are not decoded have no buffers, band rows nor inverse transform */
+                if (! opj_tcd_is_decoded_comp(p_tcd, compno)) {
+                        continue;
+                }
+
+                l_comp->t1 = l_t1;
+                l_comp->tilec = l_tile->comps + compno;
+                l_comp->tccp = p_tcd->tcp->tccps + compno;
+                l_comp->numres = l_numres;
+
+                l_comp->work = (OPJ_INT32 *) opj_aligned_malloc((size_t)p_strip_height * l_res_w * sizeof(OPJ_INT32));
+                l_comp->data = (OPJ_INT32 *) opj_malloc((size_t)p_strip_height * l_img_comp_dest->w * sizeof(OPJ_INT32));
+                if (! l_comp->work || ! l_comp->data) {
+                        l_success = OPJ_FALSE;
+                        break;
+                }
+                l_comps_data[l_nb_comps++] = l_comp->data;
+
+                l_comp->bands = (opj_t1_band_rows_t *) opj_calloc(l_numres * 3, sizeof(opj_t1_band_rows_t));
+                if (! l_comp->bands) {
+                        l_success = OPJ_FALSE;
+                        break;
+                }
+                for (resno = 0; resno < l_numres; ++resno) {
+                        opj_tcd_resolution_t * l_band_res = l_comp->tilec->resolutions + resno;
+                        /* code-block height, as set up by opj_tcd_init_tile */
+                        OPJ_UINT32 l_cbgheightexpn = (resno == 0) ? l_comp->tccp->prch[resno] : l_comp->tccp->prch[resno] - 1;
+
+                        for (bandno = 0; bandno < l_band_res->numbands; ++bandno) {
+                                opj_t1_band_rows_t * l_rows = l_comp->bands + resno * 3 + bandno;
+                                l_rows->band = l_band_res->bands + bandno;
+                                l_rows->nb_precincts = l_band_res->pw * l_band_res->ph;
+                                l_rows->cblk_h_expn = opj_uint_min(l_comp->tccp->cblkh, l_cbgheightexpn);
+                        }
+                }
+
+                l_comp->dwt = opj_dwt_strip_decoder_create(l_comp->tilec, l_numres, l_comp->tccp->qmfbid, opj_tcd_read_band_rows, l_comp);
+                if (! l_comp->dwt) {
+                        l_success = OPJ_FALSE;
+                        break;
+                }
+        }
+
+        for (l_y = l_y0; l_success && l_y < l_y1; l_y += (OPJ_INT32)l_nb_rows) {
+                l_nb_rows = opj_uint_min(p_strip_height, (OPJ_UINT32)(l_y1 - l_y));
+                l_strip_size = (OPJ_UINT64)l_nb_rows * l_res_w * l_nb_comps * sizeof(OPJ_INT32);
+
+                /*------------TIER1 + DWT--------------*/
+                /* the code-blocks are decoded while the DWT pulls their rows, both are counted in the T1 stage */
+                opj_tcd_stage_start(p_tcd, &l_clock);
+                for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                        if (! l_comps[compno].dwt) {
+                                continue;
+                        }
+                        if (! opj_dwt_decode_strip(l_comps[compno].dwt,
+                                                   (OPJ_UINT32)(l_y - l_res->y0),
+                                                   (OPJ_UINT32)(l_y - l_res->y0) + l_nb_rows,
+                                                   l_comps[compno].work)) {
+                                l_success = OPJ_FALSE;
+                                break;
+                        }
+                }
+                if (! l_success) {
+                        break;
+                }
+                opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_T1, l_strip_size);
+
+                /*----------------MCT-------------------*/
+                opj_tcd_stage_start(p_tcd, &l_clock);
+                if (! opj_tcd_mct_decode_strip(p_tcd, l_comps, l_nb_rows * l_res_w)) {
+                        l_success = OPJ_FALSE;
+                        break;
+                }
+                opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_MCT, l_strip_size);
+
+                /* the DC level shift and the copy to the strip buffers are counted in the DC shift stage */
+                opj_tcd_stage_start(p_tcd, &l_clock);
+                for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                        opj_tcd_strip_comp_t * l_comp = l_comps + compno;
+                        OPJ_INT32 * l_src, * l_dest;
+
+                        if (! l_comp->dwt) {
+                                continue;
+                        }
+                        l_src = l_comp->work + (l_x0 - l_res->x0);
+                        l_dest = l_comp->data + (l_x0 - l_x0_dest);
+                        opj_tcd_dc_level_shift_decode_strip(p_tcd, compno, l_comp->work, l_nb_rows * l_res_w);
+
+                        /* columns of the output area outside of the tile are left to zero */
+                        if (l_width != l_img_comp_dest->w) {
+                                memset(l_comp->data, 0, (size_t)l_nb_rows * l_img_comp_dest->w * sizeof(OPJ_INT32));
+                        }
+                        for (j = 0; j < l_nb_rows; ++j) {
+                                memcpy(l_dest, l_src, l_width * sizeof(OPJ_INT32));
+                                l_src += l_res_w;
+                                l_dest += l_img_comp_dest->w;
+                        }
+                }
+                opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_DC_SHIFT, l_strip_size);
+
+                if (! p_strip_fn(p_output_image, (OPJ_UINT32)(l_y - l_y0_dest), l_nb_rows, l_comps_data, p_user_data)) {
+                        l_success = OPJ_FALSE;
+                }
+        }
+
+        opj_tcd_free_strip_comps(l_comps, l_tile->numcomps);
+        opj_free(l_comps_data);
+        opj_t1_destroy(l_t1);
+
+        return l_success;
+}
+
+OPJ_BOOL opj_tcd_read_band_rows (void * p_user_data,
+                                 OPJ_UINT32 p_resno,
+                                 OPJ_UINT32 p_bandno,
+                                 OPJ_UINT32 p_y0,
+                                 OPJ_UINT32 p_y1,
+                                 OPJ_INT32 * p_dest,
+                                 OPJ_UINT32 p_dest_stride)
+{
+        opj_tcd_strip_comp_t * l_comp = (opj_tcd_strip_comp_t *) p_user_data;
+        opj_t1_band_rows_t * l_rows = l_comp->bands + p_resno * 3 + p_bandno;
+
+        return opj_t1_decode_band_rows(l_comp->t1,
+                                       l_rows,
+                                       l_comp->tccp,
+                                       l_rows->band->y0 + (OPJ_INT32)p_y0,
+                                       l_rows->band->y0 + (OPJ_INT32)p_y1,
+                                       p_dest,
+                                       p_dest_stride);
+}
+
+void opj_tcd_free_strip_comps (opj_tcd_strip_comp_t * p_comps, OPJ_UINT32 p_numcomps)
+{
+        OPJ_UINT32 compno, i;
+
+        for (compno = 0; compno < p_numcomps; ++compno) {
+                opj_tcd_strip_comp_t * l_comp = p_comps + compno;
+
+                if (l_comp->bands) {
+                        for (i = 0; i < l_comp->numres * 3; ++i) {
+                                opj_free(l_comp->bands[i].data);
+                        }
+                        opj_free(l_comp->bands);
+                }
+                opj_dwt_strip_decoder_destroy(l_comp->dwt);
+                if (l_comp->work) {
+                        opj_aligned_free(l_comp->work);
+                }
+                opj_free(l_comp->data);
+        }
+        opj_free(p_comps);
+}
+
+OPJ_BOOL opj_tcd_mct_decode_strip (opj_tcd_t *p_tcd, opj_tcd_strip_comp_t * p_comps, OPJ_UINT32 p_samples)
+{
+        opj_tcp_t * l_tcp = p_tcd->tcp;
+        OPJ_UINT32 l_numcomps = p_tcd->tcd_image->tiles->numcomps;
+        OPJ_UINT32 i;
+
+        if (! l_tcp->mct || l_numcomps < 3 || ! opj_tcd_are_mct_comps_decoded(p_tcd)) {
+                return OPJ_TRUE;
+        }
+
+        if (l_tcp->mct == 2) {
+                OPJ_BYTE ** l_data;
+                OPJ_BOOL l_result;
+
+                if (! l_tcp->m_mct_decoding_matrix) {
+                        return OPJ_TRUE;
+                }
+
+                l_data = (OPJ_BYTE **) opj_malloc(l_numcomps * sizeof(OPJ_BYTE*));
+                if (! l_data) {
+                        return OPJ_FALSE;
+                }
+                for (i = 0; i < l_numcomps; ++i) {
+                        l_data[i] = (OPJ_BYTE*) p_comps[i].work;
+                }
+                l_result = opj_mct_decode_custom((OPJ_BYTE*) l_tcp->m_mct_decoding_matrix, p_samples, l_data, l_numcomps, p_tcd->image->comps->sgnd);
+                opj_free(l_data);
+                return l_result;
+        }
+
+        if (l_tcp->tccps->qmfbid == 1) {
+                opj_mct_decode(p_comps[0].work, p_comps[1].work, p_comps[2].work, p_samples);
+        }
+        else {
+                opj_mct_decode_real((OPJ_FLOAT32*)p_comps[0].work, (OPJ_FLOAT32*)p_comps[1].work, (OPJ_FLOAT32*)p_comps[2].work, p_samples);
+        }
+
+        return OPJ_TRUE;
+}
+
+void opj_tcd_dc_level_shift_decode_strip (opj_tcd_t *p_tcd, OPJ_UINT32 p_compno, OPJ_INT32 * p_data, OPJ_UINT32 p_samples)
+{
+        opj_tccp_t * l_tccp = p_tcd->tcp->tccps + p_compno;
+        opj_image_comp_t * l_img_comp = p_tcd->image->comps + p_compno;
+        OPJ_INT32 l_min, l_max;
+        OPJ_UINT32 i;
+
+        if (l_img_comp->sgnd) {
+                l_min = -(1 << (l_img_comp->prec - 1));
+                l_max = (1 << (l_img_comp->prec - 1)) - 1;
+        }
+        else {
+                l_min = 0;
+                l_max = (1 << l_img_comp->prec) - 1;
+        }
+
+        if (l_tccp->qmfbid == 1) {
+                for (i = 0; i < p_samples; ++i) {
+                        p_data[i] = opj_int_clamp(p_data[i] + l_tccp->m_dc_level_shift, l_min, l_max);
+                }
+        }
+        else {
+                for (i = 0; i < p_samples; ++i) {
+                        OPJ_FLOAT32 l_value = *((OPJ_FLOAT32 *) &p_data[i]);
+                        p_data[i] = opj_int_clamp((OPJ_INT32)lrintf(l_value) + l_tccp->m_dc_level_shift, l_min, l_max);
+                }
+        }
+}
+
+OPJ_BOOL opj_tcd_is_decoded_comp (opj_tcd_t *p_tcd, OPJ_UINT32 p_compno)
+{
+        const OPJ_BYTE * l_decoded_comps = p_tcd->cp->m_specific_param.m_dec.m_decoded_comps;
+
+        return (! l_decoded_comps) || l_decoded_comps[p_compno];
+}
+
+OPJ_BOOL opj_tcd_are_mct_comps_decoded (opj_tcd_t *p_tcd)
+{
+        OPJ_UINT32 compno;
+        /* the custom MCT combines all the components, the RCT and ICT the first three */
+        OPJ_UINT32 l_nb_comps = (p_tcd->tcp->mct == 2) ? p_tcd->tcd_image->tiles->numcomps : 3;
+
+        for (compno = 0; compno < l_nb_comps && compno < p_tcd->tcd_image->tiles->numcomps; ++compno) {
+                if (! opj_tcd_is_decoded_comp(p_tcd, compno)) {
+                        return OPJ_FALSE;
+                }
+        }
+
+        return OPJ_TRUE;
+}
+
 /**
  * Deallocates the encoding data of the given precinct.
  */
@@ -1891,7 +2585,7 @@ OPJ_BOOL opj_tcd_dc_level_shift_encode ( opj_tcd_t *p_tcd )
                 }
                 else {
                         for (i = 0; i < l_nb_elem; ++i) {
-                                *l_current_ptr = (*l_current_ptr - l_tccp->m_dc_level_shift) << 11 ;
+                                *l_current_ptr = (*l_current_ptr - l_tccp->m_dc_level_shift) * (1 << 11);
                                 ++l_current_ptr;
                         }
                 }
@@ -1997,31 +2691,262 @@ OPJ_BOOL opj_tcd_t1_encode ( opj_tcd_t *p_tcd )
                 return OPJ_FALSE;
         }
 
+        l_mct_norms = opj_tcd_get_mct_norms(p_tcd, &l_mct_numcomps);
+
+        if (! opj_t1_encode_cblks(l_t1, p_tcd->tcd_image->tiles , l_tcp, l_mct_norms, l_mct_numcomps)) {
+        opj_t1_destroy(l_t1);
+                return OPJ_FALSE;
+        }
+
+        opj_t1_destroy(l_t1);
+
+        return OPJ_TRUE;
+}
+
+const OPJ_FLOAT64 * opj_tcd_get_mct_norms (opj_tcd_t *p_tcd, OPJ_UINT32 * p_numcomps)
+{
+        opj_tcp_t * l_tcp = p_tcd->tcp;
+
         if (l_tcp->mct == 1) {
-                l_mct_numcomps = 3U;
+                *p_numcomps = 3U;
                 /* irreversible encoding */
                 if (l_tcp->tccps->qmfbid == 0) {
-                        l_mct_norms = opj_mct_get_mct_norms_real();
+                        return opj_mct_get_mct_norms_real();
                 }
-                else {
-                        l_mct_norms = opj_mct_get_mct_norms();
+                return opj_mct_get_mct_norms();
+        }
+
+        *p_numcomps = p_tcd->image->numcomps;
+        return (const OPJ_FLOAT64 *) (l_tcp->mct_norms);
+}
+
+OPJ_BOOL opj_tcd_init_encode_strips(    opj_tcd_t *p_tcd,
+                                        OPJ_UINT32 p_tile_no)
+{
+        opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+        opj_tcd_strip_encoder_t * l_enc;
+        OPJ_UINT32 compno, resno, bandno;
+
+        opj_tcd_free_strip_encoder(p_tcd);
+
+        p_tcd->tcd_tileno = p_tile_no;
+        p_tcd->tcp = &p_tcd->cp->tcps[p_tile_no];
+
+        l_enc = (opj_tcd_strip_encoder_t *) opj_calloc(1, sizeof(opj_tcd_strip_encoder_t));
+        if (! l_enc) {
+                return OPJ_FALSE;
+        }
+        p_tcd->m_strip_encoder = l_enc;
+
+        l_enc->tcd = p_tcd;
+        l_enc->mct_norms = opj_tcd_get_mct_norms(p_tcd, &l_enc->mct_numcomps);
+        l_enc->t1 = opj_t1_create(OPJ_TRUE);
+        l_enc->comps = (opj_tcd_strip_enc_comp_t *) opj_calloc(l_tile->numcomps, sizeof(opj_tcd_strip_enc_comp_t));
+        if (! l_enc->t1 || ! l_enc->comps) {
+                opj_tcd_free_strip_encoder(p_tcd);
+                return OPJ_FALSE;
+        }
+
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                opj_tcd_strip_enc_comp_t * l_comp = l_enc->comps + compno;
+                opj_tcd_tilecomp_t * l_tilec = l_tile->comps + compno;
+                opj_tccp_t * l_tccp = p_tcd->tcp->tccps + compno;
+
+                l_comp->encoder = l_enc;
+                l_comp->compno = compno;
+                l_comp->bands = (opj_t1_band_rows_t *) opj_calloc(l_tilec->numresolutions * 3, sizeof(opj_t1_band_rows_t));
+                l_comp->dwt = opj_dwt_strip_encoder_create(l_tilec, l_tccp->qmfbid, opj_tcd_write_band_rows, l_comp);
+                if (! l_comp->bands || ! l_comp->dwt) {
+                        opj_tcd_free_strip_encoder(p_tcd);
+                        return OPJ_FALSE;
+                }
+
+                for (resno = 0; resno < l_tilec->numresolutions; ++resno) {
+                        opj_tcd_resolution_t * l_res = l_tilec->resolutions + resno;
+                        /* code-block height, as set up by opj_tcd_init_tile */
+                        OPJ_UINT32 l_cbgheightexpn = (resno == 0) ? l_tccp->prch[resno] : l_tccp->prch[resno] - 1;
+
+                        for (bandno = 0; bandno < l_res->numbands; ++bandno) {
+                                opj_t1_band_rows_t * l_rows = l_comp->bands + resno * 3 + bandno;
+                                l_rows->band = l_res->bands + bandno;
+                                l_rows->nb_precincts = l_res->pw * l_res->ph;
+                                l_rows->cblk_h_expn = opj_uint_min(l_tccp->cblkh, l_cbgheightexpn);
+                                l_rows->y0 = l_rows->y1 = l_rows->band->y0;
+                        }
                 }
         }
-        else {
-                l_mct_numcomps = p_tcd->image->numcomps;
-                l_mct_norms = (const OPJ_FLOAT64 *) (l_tcp->mct_norms);
+
+        l_tile->distotile = 0;          /* fixed_quality */
+
+        return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_tcd_encode_strip(  opj_tcd_t *p_tcd,
+                                OPJ_INT32 ** p_comps_data,
+                                OPJ_UINT32 p_nb_rows)
+{
+        opj_tcd_strip_encoder_t * l_enc = p_tcd->m_strip_encoder;
+        opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+        OPJ_UINT32 compno;
+        /* every component has the size of the first one, see opj_j2k_write_strip */
+        OPJ_UINT32 l_width = (OPJ_UINT32)(l_tile->comps->x1 - l_tile->comps->x0);
+        OPJ_UINT32 l_samples = l_width * p_nb_rows;
+        OPJ_UINT64 l_strip_size = (OPJ_UINT64)l_samples * l_tile->numcomps * sizeof(OPJ_INT32);
+        opj_stage_clock_t l_clock;
+
+        if (! l_enc) {
+                return OPJ_FALSE;
         }
 
-        if (! opj_t1_encode_cblks(l_t1, p_tcd->tcd_image->tiles , l_tcp, l_mct_norms, l_mct_numcomps)) {
-        opj_t1_destroy(l_t1);
+        if (p_nb_rows > l_enc->work_rows) {
+                for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                        opj_tcd_strip_enc_comp_t * l_comp = l_enc->comps + compno;
+                        opj_free(l_comp->work);
+                        l_comp->work = (OPJ_INT32 *) opj_malloc((size_t)l_samples * sizeof(OPJ_INT32));
+                        if (! l_comp->work) {
+                                l_enc->work_rows = 0;
+                                return OPJ_FALSE;
+                        }
+                }
+                l_enc->work_rows = p_nb_rows;
+        }
+
+        /*---------------DC SHIFT---------------*/
+        opj_tcd_stage_start(p_tcd, &l_clock);
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                opj_tccp_t * l_tccp = p_tcd->tcp->tccps + compno;
+                const OPJ_INT32 * l_src = p_comps_data[compno];
+                OPJ_INT32 * l_dest = l_enc->comps[compno].work;
+                OPJ_UINT32 i;
+
+                if (l_tccp->qmfbid == 1) {
+                        for (i = 0; i < l_samples; ++i) {
+                                l_dest[i] = l_src[i] - l_tccp->m_dc_level_shift;
+                        }
+                }
+                else {
+                        for (i = 0; i < l_samples; ++i) {
+                                l_dest[i] = (l_src[i] - l_tccp->m_dc_level_shift) * (1 << 11);
+                        }
+                }
+        }
+        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_DC_SHIFT, l_strip_size);
+
+        /*----------------MCT-------------------*/
+        opj_tcd_stage_start(p_tcd, &l_clock);
+        if (! opj_tcd_mct_encode_strip(p_tcd, l_samples)) {
                 return OPJ_FALSE;
         }
+        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_MCT, l_strip_size);
 
-        opj_t1_destroy(l_t1);
+        /*------------DWT + TIER1---------------*/
+        /* the code-blocks are encoded as the DWT hands their rows out, both are counted in the T1 stage */
+        opj_tcd_stage_start(p_tcd, &l_clock);
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                if (! opj_dwt_encode_strip(l_enc->comps[compno].dwt, l_enc->comps[compno].work, p_nb_rows)) {
+                        return OPJ_FALSE;
+                }
+        }
+        opj_tcd_stage_stop(p_tcd, &l_clock, OPJ_STAGE_T1, l_strip_size);
 
         return OPJ_TRUE;
 }
 
+OPJ_BOOL opj_tcd_write_band_rows (void * p_user_data,
+                                  OPJ_UINT32 p_resno,
+                                  OPJ_UINT32 p_bandno,
+                                  const OPJ_INT32 * p_src,
+                                  OPJ_UINT32 p_src_stride,
+                                  OPJ_UINT32 p_nb_rows)
+{
+        opj_tcd_strip_enc_comp_t * l_comp = (opj_tcd_strip_enc_comp_t *) p_user_data;
+        opj_tcd_strip_encoder_t * l_enc = l_comp->encoder;
+
+        return opj_t1_encode_band_rows(l_enc->t1,
+                                       l_comp->bands + p_resno * 3 + p_bandno,
+                                       l_enc->tcd->tcd_image->tiles,
+                                       l_enc->tcd->tcp,
+                                       l_comp->compno,
+                                       p_resno,
+                                       l_enc->mct_norms,
+                                       l_enc->mct_numcomps,
+                                       p_src,
+                                       p_src_stride,
+                                       p_nb_rows);
+}
+
+OPJ_BOOL opj_tcd_mct_encode_strip (opj_tcd_t *p_tcd, OPJ_UINT32 p_samples)
+{
+        opj_tcd_strip_enc_comp_t * l_comps = p_tcd->m_strip_encoder->comps;
+        opj_tcp_t * l_tcp = p_tcd->tcp;
+        OPJ_UINT32 l_numcomps = p_tcd->tcd_image->tiles->numcomps;
+        OPJ_UINT32 i;
+
+        if (! l_tcp->mct) {
+                return OPJ_TRUE;
+        }
+
+        if (l_tcp->mct == 2) {
+                OPJ_BYTE ** l_data;
+                OPJ_BOOL l_result;
+
+                if (! l_tcp->m_mct_coding_matrix) {
+                        return OPJ_TRUE;
+                }
+
+                l_data = (OPJ_BYTE **) opj_malloc(l_numcomps * sizeof(OPJ_BYTE*));
+                if (! l_data) {
+                        return OPJ_FALSE;
+                }
+                for (i = 0; i < l_numcomps; ++i) {
+                        l_data[i] = (OPJ_BYTE*) l_comps[i].work;
+                }
+                l_result = opj_mct_encode_custom((OPJ_BYTE*) l_tcp->m_mct_coding_matrix, p_samples, l_data, l_numcomps, p_tcd->image->comps->sgnd);
+                opj_free(l_data);
+                return l_result;
+        }
+
+        if (l_tcp->tccps->qmfbid == 0) {
+                opj_mct_encode_real(l_comps[0].work, l_comps[1].work, l_comps[2].work, p_samples);
+        }
+        else {
+                opj_mct_encode(l_comps[0].work, l_comps[1].work, l_comps[2].work, p_samples);
+        }
+
+        return OPJ_TRUE;
+}
+
+void opj_tcd_free_strip_encoder (opj_tcd_t *p_tcd)
+{
+        opj_tcd_strip_encoder_t * l_enc = p_tcd->m_strip_encoder;
+        OPJ_UINT32 compno, i;
+
+        if (! l_enc) {
+                return;
+        }
+
+        if (l_enc->comps) {
+                for (compno = 0; compno < p_tcd->tcd_image->tiles->numcomps; ++compno) {
+                        opj_tcd_strip_enc_comp_t * l_comp = l_enc->comps + compno;
+
+                        if (l_comp->bands) {
+                                for (i = 0; i < p_tcd->tcd_image->tiles->comps[compno].numresolutions * 3; ++i) {
+                                        opj_free(l_comp->bands[i].data);
+                                }
+                                opj_free(l_comp->bands);
+                        }
+                        opj_dwt_strip_encoder_destroy(l_comp->dwt);
+                        opj_free(l_comp->work);
+                }
+                opj_free(l_enc->comps);
+        }
+        if (l_enc->t1) {
+                opj_t1_destroy(l_enc->t1);
+        }
+        opj_free(l_enc);
+        p_tcd->m_strip_encoder = 00;
+}
+
 OPJ_BOOL opj_tcd_t2_encode (opj_tcd_t *p_tcd,
                                                 OPJ_BYTE * p_dest_data,
                                                 OPJ_UINT32 * p_data_written,
@@ -2030,6 +2955,20 @@ OPJ_BOOL opj_tcd_t2_encode (opj_tcd_t *p_tcd,
 {
         opj_t2_t * l_t2;
 
+        /* room for the length of every packet of the tile, for the PLT markers */
+        if (p_tcd->cp->m_specific_param.m_enc.m_plt_on) {
+                OPJ_UINT32 l_nb_packets = opj_tcd_get_nb_precincts(p_tcd) * p_tcd->tcp->numlayers;
+
+                if (l_nb_packets > p_tcd->m_max_packet_lengths) {
+                        OPJ_UINT32 * l_new_lengths = (OPJ_UINT32 *) opj_realloc(p_tcd->m_packet_lengths, l_nb_packets * sizeof(OPJ_UINT32));
+                        if (! l_new_lengths) {
+                                return OPJ_FALSE;
+                        }
+                        p_tcd->m_packet_lengths = l_new_lengths;
+                        p_tcd->m_max_packet_lengths = l_nb_packets;
+                }
+        }
+
         l_t2 = opj_t2_create(p_tcd->image, p_tcd->cp);
         if (l_t2 == 00) {
                 return OPJ_FALSE;
@@ -2044,6 +2983,7 @@ OPJ_BOOL opj_tcd_t2_encode (opj_tcd_t *p_tcd,
                                         p_data_written,
                                         p_max_dest_size,
                                         p_cstr_info,
+                                        p_tcd->cp->m_specific_param.m_enc.m_plt_on ? p_tcd->m_packet_lengths : 00,
                                         p_tcd->tp_num,
                                         p_tcd->tp_pos,
                                         p_tcd->cur_pino,
@@ -2177,3 +3117,30 @@ OPJ_BOOL opj_tcd_copy_tile_data (       opj_tcd_t *p_tcd,
 
         return OPJ_TRUE;
 }
+
+void opj_tcd_stage_start (opj_tcd_t *p_tcd, opj_stage_clock_t * p_clock)
+{
+        if (p_tcd->m_stats) {
+                opj_stage_clock_start(p_clock);
+        }
+}
+
+void opj_tcd_stage_stop (opj_tcd_t *p_tcd, const opj_stage_clock_t * p_clock, OPJ_CODEC_STAGE p_stage, OPJ_UINT64 p_nb_bytes)
+{
+        if (p_tcd->m_stats) {
+                opj_stage_clock_stop(p_clock, p_tcd->m_stats, p_tcd->tcd_tileno, p_stage, p_nb_bytes);
+        }
+}
+
+OPJ_UINT64 opj_tcd_get_tile_samples_size (opj_tcd_t *p_tcd)
+{
+        opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+        OPJ_UINT64 l_size = 0;
+        OPJ_UINT32 compno;
+
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                l_size += l_tile->comps[compno].data_size_needed;
+        }
+
+        return l_size;
+}
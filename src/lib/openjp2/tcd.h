@@ -165,6 +165,7 @@ typedef struct opj_tcd_tilecomp
 	OPJ_BOOL  ownsData;                 /* if true, then need to free after usage, otherwise do not free */
 	OPJ_UINT32 data_size_needed;        /* we may either need to allocate this amount of data, or re-use image data and ignore this value */
 	OPJ_UINT32 data_size;               /* size of the data of the component */
+	OPJ_BOOL  data_16bit;               /* if true, data holds OPJ_INT16 samples (low memory reversible decoding) */
 	OPJ_INT32 numpix;                   /* add fixed_quality */
 } opj_tcd_tilecomp_t;
 
@@ -180,6 +181,7 @@ typedef struct opj_tcd_tile {
 	OPJ_FLOAT64 distotile;			/* add fixed_quality */
 	OPJ_FLOAT64 distolayer[100];	/* add fixed_quality */
 	OPJ_UINT32 packno;              /* packet number */
+	OPJ_BYTE * src_data;			/* compressed data of the tile while decoding, referenced by the code-block segments */
 } opj_tcd_tile_t;
 
 /**
@@ -192,6 +194,11 @@ typedef struct opj_tcd_image
 opj_tcd_image_t;
 
 
+/**
+Encoding state of a tile encoded by strips (opj_tcd_encode_strip)
+*/
+typedef struct opj_tcd_strip_encoder opj_tcd_strip_encoder_t;
+
 /**
 Tile coder/decoder
 */
@@ -219,6 +226,16 @@ typedef struct opj_tcd
 	OPJ_UINT32 tcd_tileno;
 	/** tell if the tcd is a decoder. */
 	OPJ_UINT32 m_is_decoder : 1;
+	/** tell if the tiles are decoded by strips (opj_tcd_decode_tile_strips), without tile component buffers. */
+	OPJ_UINT32 m_decode_by_strips : 1;
+	/** rows and code-blocks of the tile being encoded by strips, 00 if the tile is encoded at once. */
+	opj_tcd_strip_encoder_t * m_strip_encoder;
+	/** lengths of the packets of the tile being encoded, by packet number, when PLT markers are written. */
+	OPJ_UINT32 * m_packet_lengths;
+	/** number of packets m_packet_lengths can hold. */
+	OPJ_UINT32 m_max_packet_lengths;
+	/** statistics of the codec, 00 if they are not collected. */
+	opj_codec_stats_t * m_stats;
 } opj_tcd_t;
 
 /** @name Exported functions */
@@ -286,6 +303,11 @@ OPJ_BOOL opj_tcd_rateallocate(	opj_tcd_t *tcd,
  */
 OPJ_UINT32 opj_tcd_get_decoded_tile_size (opj_tcd_t *p_tcd );
 
+/**
+ * Gets the number of precincts of the current tile, for all its components and resolutions.
+ */
+OPJ_UINT32 opj_tcd_get_nb_precincts (opj_tcd_t *p_tcd );
+
 /**
  * Encodes a tile from the raw image into the given buffer.
  * @param	p_tcd			Tile Coder handle
@@ -303,6 +325,29 @@ OPJ_BOOL opj_tcd_encode_tile(   opj_tcd_t *p_tcd,
 							    OPJ_UINT32 p_len,
 							    struct opj_codestream_info *p_cstr_info);
 
+/**
+ * Prepares the encoding of a tile by strips of rows : the tile component buffers are
+ * not allocated, the rows given to opj_tcd_encode_strip go through the DC level shift,
+ * the MCT and the wavelet transform and the code-blocks are encoded as soon as all
+ * their rows are known. Once all the rows are given, opj_tcd_encode_tile only runs
+ * the rate allocation and tier-2.
+ * @param	p_tcd			Tile Coder handle, initialized by opj_tcd_init_encode_tile
+ * @param	p_tile_no		Index of the tile to encode.
+ * @return  true if the encoding state could be allocated.
+*/
+OPJ_BOOL opj_tcd_init_encode_strips(    opj_tcd_t *p_tcd,
+                                        OPJ_UINT32 p_tile_no);
+
+/**
+ * Encodes the next rows of the tile initialized by opj_tcd_init_encode_strips.
+ * @param	p_tcd			Tile Coder handle
+ * @param	p_comps_data	rows of each tile component, p_nb_rows * tile component width samples each
+ * @param	p_nb_rows		number of rows
+ * @return  true if the coding is successfull.
+*/
+OPJ_BOOL opj_tcd_encode_strip(  opj_tcd_t *p_tcd,
+                                OPJ_INT32 ** p_comps_data,
+                                OPJ_UINT32 p_nb_rows);
 
 /**
 Decode a tile from a buffer into a raw image
@@ -318,6 +363,30 @@ OPJ_BOOL opj_tcd_decode_tile(   opj_tcd_t *tcd,
 							    OPJ_UINT32 tileno,
 							    opj_codestream_index_t *cstr_info);
 
+/**
+Decode a tile from a buffer strip by strip. The code-blocks are decoded one row of code-blocks
+at a time and the inverse transforms only run on the rows of the current strip, which is then
+handed to strip_fn : no buffer of the size of the tile components is allocated.
+@param tcd TCD handle
+@param src Source buffer
+@param len Length of source buffer
+@param tileno Number that identifies one of the tiles to be decoded
+@param cstr_info  FIXME DOC
+@param output_image Decoded area, the strips are cropped to it
+@param strip_height Number of rows of each strip
+@param strip_fn Function called with the samples of each strip
+@param user_data User data given to strip_fn
+*/
+OPJ_BOOL opj_tcd_decode_tile_strips(    opj_tcd_t *tcd,
+                                        OPJ_BYTE *src,
+                                        OPJ_UINT32 len,
+                                        OPJ_UINT32 tileno,
+                                        opj_codestream_index_t *cstr_info,
+                                        opj_image_t *output_image,
+                                        OPJ_UINT32 strip_height,
+                                        opj_strip_decode_fn strip_fn,
+                                        void *user_data);
+
 
 /**
  * Copies tile data from the system onto the given memory block.
@@ -356,6 +425,16 @@ OPJ_BOOL opj_tcd_copy_tile_data (opj_tcd_t *p_tcd,
  */
 OPJ_BOOL opj_alloc_tile_component_data(opj_tcd_tilecomp_t *l_tilec);
 
+/**
+ * Converts the 16 bit samples of a tile component to 32 bit samples,
+ * when a reversible tile does not fit in 16 bits.
+ *
+ * @param	p_tilec		tile component which data_16bit is set.
+ *
+ * @return true if the data could be reallocated (false otherwise).
+ */
+OPJ_BOOL opj_tcd_widen_tile_component_data(opj_tcd_tilecomp_t *p_tilec);
+
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
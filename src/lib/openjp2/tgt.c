@@ -39,6 +39,21 @@
 
 #include "opj_includes.h"
 
+/** @name Local static functions */
+/*@{*/
+
+/**
+Decode the value of a leaf of the tag-tree up to a given threshold
+@param bio Pointer to a BIO handle
+@param tree Tag-tree to decode
+@param leafno Number that identifies the leaf to decode
+@param threshold Threshold to use when decoding value of the leaf
+@return Returns the decoded leaf
+*/
+static opj_tgt_node_t * opj_tgt_decode_leaf(opj_bio_t *bio, opj_tgt_tree_t *tree, OPJ_UINT32 leafno, OPJ_INT32 threshold);
+
+/*@}*/
+
 /* 
 ==========================================================
    Tag-tree coder interface
@@ -297,14 +312,21 @@ void opj_tgt_encode(opj_bio_t *bio, opj_tgt_tree_t *tree, OPJ_UINT32 leafno, OPJ
         }
 }
 
-OPJ_UINT32 opj_tgt_decode(opj_bio_t *bio, opj_tgt_tree_t *tree, OPJ_UINT32 leafno, OPJ_INT32 threshold) {
+opj_tgt_node_t * opj_tgt_decode_leaf(opj_bio_t *bio, opj_tgt_tree_t *tree, OPJ_UINT32 leafno, OPJ_INT32 threshold) {
         opj_tgt_node_t *stk[31];
         opj_tgt_node_t **stkptr;
         opj_tgt_node_t *node;
+        opj_tgt_node_t *leaf;
         OPJ_INT32 low;
 
+        leaf = &tree->nodes[leafno];
+        /* nothing left to read on the path from the root when the leaf is known up to threshold */
+        if (leaf->low >= threshold || leaf->low >= leaf->value) {
+                return leaf;
+        }
+
         stkptr = stk;
-        node = &tree->nodes[leafno];
+        node = leaf;
         while (node->parent) {
                 *stkptr++ = node;
                 node = node->parent;
@@ -312,16 +334,21 @@ OPJ_UINT32 opj_tgt_decode(opj_bio_t *bio, opj_tgt_tree_t *tree, OPJ_UINT32 leafn
         
         low = 0;
         for (;;) {
+                OPJ_INT32 l_max;
+
                 if (low > node->low) {
                         node->low = low;
                 } else {
                         low = node->low;
                 }
-                while (low < threshold && low < node->value) {
-                        if (opj_bio_read(bio, 1)) {
+                /* each 0 bit increments low, a 1 bit sets the value */
+                l_max = opj_int_min(threshold, node->value);
+                if (low < l_max) {
+                        OPJ_UINT32 l_nb_bits = (OPJ_UINT32)(l_max - low);
+                        OPJ_UINT32 l_zeros = opj_bio_read_zeros(bio, l_nb_bits);
+                        low += (OPJ_INT32)l_zeros;
+                        if (l_zeros < l_nb_bits) {
                                 node->value = low;
-                        } else {
-                                ++low;
                         }
                 }
                 node->low = low;
@@ -331,5 +358,17 @@ OPJ_UINT32 opj_tgt_decode(opj_bio_t *bio, opj_tgt_tree_t *tree, OPJ_UINT32 leafn
                 node = *--stkptr;
         }
         
+        return node;
+}
+
+OPJ_UINT32 opj_tgt_decode(opj_bio_t *bio, opj_tgt_tree_t *tree, OPJ_UINT32 leafno, OPJ_INT32 threshold) {
+        opj_tgt_node_t *node = opj_tgt_decode_leaf(bio, tree, leafno, threshold);
+
         return (node->value < threshold) ? 1 : 0;
 }
+
+OPJ_INT32 opj_tgt_decode_value(opj_bio_t *bio, opj_tgt_tree_t *tree, OPJ_UINT32 leafno, OPJ_INT32 max_value) {
+        opj_tgt_node_t *node = opj_tgt_decode_leaf(bio, tree, leafno, max_value);
+
+        return (node->value < max_value) ? node->value : max_value;
+}
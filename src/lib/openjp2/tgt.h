@@ -138,6 +138,19 @@ OPJ_UINT32 opj_tgt_decode(opj_bio_t *bio,
                           opj_tgt_tree_t *tree, 
                           OPJ_UINT32 leafno, 
                           OPJ_INT32 threshold);
+/**
+Decode the value of a leaf of the tag-tree in a single pass,
+as successive calls to opj_tgt_decode with increasing thresholds would
+@param bio Pointer to a BIO handle
+@param tree Tag-tree to decode
+@param leafno Number that identifies the leaf to decode
+@param max_value Value returned when the leaf's value is not below it
+@return Returns the value of the leaf, max_value if the leaf's value >= max_value
+*/
+OPJ_INT32 opj_tgt_decode_value(opj_bio_t *bio, 
+                               opj_tgt_tree_t *tree, 
+                               OPJ_UINT32 leafno, 
+                               OPJ_INT32 max_value);
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
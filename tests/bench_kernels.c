@@ -0,0 +1,514 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Kernel micro-benchmarks : the MQ coder, the tier-1 code-block coder, the
+ * inverse wavelet transforms and the inverse color transforms are run alone
+ * on fixed inputs, and the best of several runs is reported per sample. A
+ * sample is a decision for the MQ coder, a coefficient for the tier-1 coder
+ * and the wavelet transforms, and a component value for the color transforms.
+ * The cycles are read from the time stamp counter where there is one, which
+ * counts at a constant rate whatever the clock of the core.
+ *
+ * The program is built from the library sources so that it can call the
+ * internal functions; the decoders are checked against the encoders on the
+ * way, so a run also guards the kernels against regressions.
+ */
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define HAVE_CYCLE_COUNTER
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER
+#endif
+
+#include "opj_includes.h"
+
+/* -------------------------------------------------------------------------- */
+
+typedef struct kernel_timer {
+	OPJ_UINT64 cycles_start;
+	OPJ_FLOAT64 wall_start;
+	/* best run so far */
+	OPJ_UINT64 cycles;
+	OPJ_FLOAT64 seconds;
+	OPJ_UINT32 nb_runs;
+} kernel_timer_t;
+
+static OPJ_UINT64 read_cycles(void)
+{
+#ifdef HAVE_CYCLE_COUNTER
+	return (OPJ_UINT64)__rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static void timer_start(kernel_timer_t *timer)
+{
+	timer->wall_start = opj_wall_clock();
+	timer->cycles_start = read_cycles();
+}
+
+static void timer_stop(kernel_timer_t *timer)
+{
+	OPJ_UINT64 cycles = read_cycles() - timer->cycles_start;
+	OPJ_FLOAT64 seconds = opj_wall_clock() - timer->wall_start;
+
+	if (timer->nb_runs == 0 || seconds < timer->seconds) {
+		timer->seconds = seconds;
+		timer->cycles = cycles;
+	}
+	++timer->nb_runs;
+}
+
+static void report(const char *kernel, const char *config, const kernel_timer_t *timer, OPJ_UINT64 nb_samples)
+{
+#ifdef HAVE_CYCLE_COUNTER
+	printf("%-24s %-12s %10lu samples %8.2f cycles/sample %8.3f ns/sample\n", kernel, config, (unsigned long)nb_samples,
+	       (double)timer->cycles / (double)nb_samples, 1e9 * timer->seconds / (double)nb_samples);
+#else
+	printf("%-24s %-12s %10lu samples %8s cycles/sample %8.3f ns/sample\n", kernel, config, (unsigned long)nb_samples,
+	       "-", 1e9 * timer->seconds / (double)nb_samples);
+#endif
+}
+
+/* uniform in [0, 1), same sequence on every platform */
+static OPJ_UINT32 random_state = 1;
+
+static OPJ_FLOAT64 uniform(void)
+{
+	random_state = random_state * 1103515245u + 12345u;
+	return (OPJ_FLOAT64)(random_state >> 8) / (OPJ_FLOAT64)(1u << 24);
+}
+
+/* -------------------------------------------------------------------------- */
+
+/* decisions of all the contexts, with probabilities of the MPS from 0.5 to 0.98 */
+static int bench_mqc(OPJ_UINT32 nb_decisions, OPJ_UINT32 iterations)
+{
+	OPJ_BYTE *ctxnos = (OPJ_BYTE*)opj_malloc(nb_decisions);
+	OPJ_BYTE *decisions = (OPJ_BYTE*)opj_malloc(nb_decisions);
+	OPJ_BYTE *decoded = (OPJ_BYTE*)opj_malloc(nb_decisions);
+	OPJ_BYTE *buffer = (OPJ_BYTE*)opj_malloc(nb_decisions + 16);
+	opj_mqc_t *mqc = opj_mqc_create();
+	kernel_timer_t encode_timer, decode_timer;
+	OPJ_UINT32 i, it, len = 0;
+	int ok = 0;
+
+	memset(&encode_timer, 0, sizeof(encode_timer));
+	memset(&decode_timer, 0, sizeof(decode_timer));
+	if (!ctxnos || !decisions || !decoded || !buffer || !mqc) {
+		goto cleanup;
+	}
+	for (i = 0; i < nb_decisions; ++i) {
+		OPJ_UINT32 ctxno = (OPJ_UINT32)(uniform() * MQC_NUMCTXS);
+		ctxnos[i] = (OPJ_BYTE)ctxno;
+		decisions[i] = uniform() < 0.5 + 0.48 * ctxno / (MQC_NUMCTXS - 1) ? 0 : 1;
+	}
+
+	/* the byte before the coded data is read by opj_mqc_init_enc */
+	buffer[0] = 0;
+	for (it = 0; it < iterations; ++it) {
+		timer_start(&encode_timer);
+		opj_mqc_resetstates(mqc);
+		opj_mqc_init_enc(mqc, buffer + 1);
+		for (i = 0; i < nb_decisions; ++i) {
+			opj_mqc_setcurctx(mqc, ctxnos[i]);
+			opj_mqc_encode(mqc, decisions[i]);
+		}
+		opj_mqc_flush(mqc);
+		timer_stop(&encode_timer);
+		len = opj_mqc_numbytes(mqc);
+	}
+
+	for (it = 0; it < iterations; ++it) {
+		timer_start(&decode_timer);
+		opj_mqc_resetstates(mqc);
+		if (!opj_mqc_init_dec(mqc, buffer + 1, len)) {
+			goto cleanup;
+		}
+		for (i = 0; i < nb_decisions; ++i) {
+			opj_mqc_setcurctx(mqc, ctxnos[i]);
+			decoded[i] = (OPJ_BYTE)opj_mqc_decode(mqc);
+		}
+		timer_stop(&decode_timer);
+	}
+	if (memcmp(decoded, decisions, nb_decisions) != 0) {
+		fprintf(stderr, "ERROR -> opj_mqc_decode does not give back the encoded decisions\n");
+		goto cleanup;
+	}
+
+	report("opj_mqc_encode", "", &encode_timer, nb_decisions);
+	report("opj_mqc_decode", "", &decode_timer, nb_decisions);
+	ok = 1;
+
+cleanup:
+	if (mqc) {
+		opj_mqc_destroy(mqc);
+	}
+	opj_free(buffer);
+	opj_free(decoded);
+	opj_free(decisions);
+	opj_free(ctxnos);
+	return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+
+#define CBLK_DATA_SIZE (OPJ_J2K_DEFAULT_CBLK_DATA_SIZE * 2)
+#define CBLK_MAX_PASSES 100
+
+/*
+ * Code-blocks of wavelet coefficients, whose magnitudes follow Laplacian laws
+ * from nearly empty high frequency blocks to busy low frequency ones. They are
+ * encoded, then the recorded code-blocks are decoded.
+ */
+static int bench_t1(OPJ_UINT32 cblk_size, OPJ_UINT32 nb_cblks, OPJ_UINT32 iterations)
+{
+	OPJ_UINT32 cblk_samples = cblk_size * cblk_size;
+	OPJ_INT32 *coefs = (OPJ_INT32*)opj_malloc(nb_cblks * cblk_samples * sizeof(OPJ_INT32));
+	OPJ_INT32 *scaled = (OPJ_INT32*)opj_aligned_malloc(nb_cblks * cblk_samples * sizeof(OPJ_INT32));
+	opj_tcd_cblk_enc_t *cblks_enc = (opj_tcd_cblk_enc_t*)opj_calloc(nb_cblks, sizeof(opj_tcd_cblk_enc_t));
+	opj_tcd_cblk_dec_t *cblks_dec = (opj_tcd_cblk_dec_t*)opj_calloc(nb_cblks, sizeof(opj_tcd_cblk_dec_t));
+	opj_tcd_seg_t *segs = (opj_tcd_seg_t*)opj_calloc(nb_cblks, sizeof(opj_tcd_seg_t));
+	opj_t1_t *t1_enc = opj_t1_create(OPJ_TRUE);
+	opj_t1_t *t1_dec = opj_t1_create(OPJ_FALSE);
+	kernel_timer_t encode_timer, decode_timer;
+	opj_tcd_tile_t tile;
+	OPJ_UINT32 i, it, cblkno;
+	char config[32];
+	int ok = 0;
+
+	memset(&encode_timer, 0, sizeof(encode_timer));
+	memset(&decode_timer, 0, sizeof(decode_timer));
+	if (!coefs || !scaled || !cblks_enc || !cblks_dec || !segs || !t1_enc || !t1_dec) {
+		goto cleanup;
+	}
+	for (cblkno = 0; cblkno < nb_cblks; ++cblkno) {
+		OPJ_FLOAT64 scale = 0.3 * pow(400.0, (OPJ_FLOAT64)cblkno / (OPJ_FLOAT64)(nb_cblks > 1 ? nb_cblks - 1 : 1));
+		OPJ_INT32 *cblk_coefs = coefs + cblkno * cblk_samples;
+		opj_tcd_cblk_enc_t *cblk = &cblks_enc[cblkno];
+		for (i = 0; i < cblk_samples; ++i) {
+			OPJ_INT32 magnitude = (OPJ_INT32)(-log(1.0 - uniform()) * scale);
+			cblk_coefs[i] = (uniform() < 0.5) ? -magnitude : magnitude;
+		}
+		/* the byte before the coded data is read by opj_mqc_init_enc */
+		cblk->data = (OPJ_BYTE*)opj_malloc(CBLK_DATA_SIZE + 1);
+		cblk->passes = (opj_tcd_pass_t*)opj_calloc(CBLK_MAX_PASSES, sizeof(opj_tcd_pass_t));
+		if (!cblk->data || !cblk->passes) {
+			goto cleanup;
+		}
+		cblk->data[0] = 0;
+		++cblk->data;
+		cblk->x1 = (OPJ_INT32)cblk_size;
+		cblk->y1 = (OPJ_INT32)cblk_size;
+	}
+
+	for (it = 0; it < iterations; ++it) {
+		for (i = 0; i < nb_cblks * cblk_samples; ++i) {
+			scaled[i] = coefs[i] * (1 << T1_NMSEDEC_FRACBITS);
+		}
+		memset(&tile, 0, sizeof(tile));
+		timer_start(&encode_timer);
+		for (cblkno = 0; cblkno < nb_cblks; ++cblkno) {
+			if (!opj_t1_allocate_buffers(t1_enc, cblk_size, cblk_size)) {
+				goto cleanup;
+			}
+			t1_enc->data = scaled + cblkno * cblk_samples;
+			t1_enc->data_stride = cblk_size;
+			opj_t1_encode_cblk(t1_enc, &cblks_enc[cblkno], cblkno % 4, 0, 1, 1, 1.0, 0, 1, &tile, 00, 0);
+		}
+		timer_stop(&encode_timer);
+	}
+	/* the encoder borrows the samples */
+	t1_enc->data = 00;
+
+	/* all the passes in a single segment, as for a single layer */
+	for (cblkno = 0; cblkno < nb_cblks; ++cblkno) {
+		opj_tcd_cblk_enc_t *cblk_enc = &cblks_enc[cblkno];
+		opj_tcd_cblk_dec_t *cblk = &cblks_dec[cblkno];
+		cblk->segs = &segs[cblkno];
+		cblk->x1 = (OPJ_INT32)cblk_size;
+		cblk->y1 = (OPJ_INT32)cblk_size;
+		cblk->numbps = cblk_enc->numbps;
+		cblk->real_num_segs = cblk_enc->totalpasses ? 1 : 0;
+		segs[cblkno].data = &cblk_enc->data;
+		segs[cblkno].real_num_passes = cblk_enc->totalpasses;
+		segs[cblkno].len = cblk_enc->totalpasses ? cblk_enc->passes[cblk_enc->totalpasses - 1].rate : 0;
+	}
+
+	/* lossless check, the reconstruction adds half a quantization step */
+	for (cblkno = 0; cblkno < nb_cblks; ++cblkno) {
+		const OPJ_INT32 *cblk_coefs = coefs + cblkno * cblk_samples;
+		if (!opj_t1_decode_cblk(t1_dec, &cblks_dec[cblkno], cblkno % 4, 0, 0)) {
+			goto cleanup;
+		}
+		for (i = 0; i < cblk_samples; ++i) {
+			if (t1_dec->data[i] / 2 != cblk_coefs[i]) {
+				fprintf(stderr, "ERROR -> opj_t1_decode_cblk gives %d instead of %d in code-block %u\n",
+				        t1_dec->data[i] / 2, cblk_coefs[i], cblkno);
+				goto cleanup;
+			}
+		}
+	}
+
+	for (it = 0; it < iterations; ++it) {
+		timer_start(&decode_timer);
+		for (cblkno = 0; cblkno < nb_cblks; ++cblkno) {
+			if (!opj_t1_decode_cblk(t1_dec, &cblks_dec[cblkno], cblkno % 4, 0, 0)) {
+				goto cleanup;
+			}
+		}
+		timer_stop(&decode_timer);
+	}
+
+	sprintf(config, "%ux%u", cblk_size, cblk_size);
+	report("opj_t1_encode_cblk", config, &encode_timer, (OPJ_UINT64)nb_cblks * cblk_samples);
+	report("opj_t1_decode_cblk", config, &decode_timer, (OPJ_UINT64)nb_cblks * cblk_samples);
+	ok = 1;
+
+cleanup:
+	if (t1_enc) {
+		t1_enc->data = 00;
+		opj_t1_destroy(t1_enc);
+	}
+	if (t1_dec) {
+		opj_t1_destroy(t1_dec);
+	}
+	if (cblks_enc) {
+		for (cblkno = 0; cblkno < nb_cblks; ++cblkno) {
+			if (cblks_enc[cblkno].data) {
+				opj_free(cblks_enc[cblkno].data - 1);
+			}
+			opj_free(cblks_enc[cblkno].passes);
+		}
+	}
+	opj_free(segs);
+	opj_free(cblks_dec);
+	opj_free(cblks_enc);
+	opj_aligned_free(scaled);
+	opj_free(coefs);
+	return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+
+/* single tile component of size x size samples at the origin, with its resolutions */
+static opj_tcd_tilecomp_t *create_tilecomp(OPJ_UINT32 size, OPJ_UINT32 numresolutions)
+{
+	opj_tcd_tilecomp_t *tilec = (opj_tcd_tilecomp_t*)opj_calloc(1, sizeof(opj_tcd_tilecomp_t));
+	OPJ_UINT32 resno;
+
+	if (!tilec) {
+		return 00;
+	}
+	tilec->x1 = (OPJ_INT32)size;
+	tilec->y1 = (OPJ_INT32)size;
+	tilec->numresolutions = numresolutions;
+	tilec->minimum_num_resolutions = numresolutions;
+	tilec->resolutions = (opj_tcd_resolution_t*)opj_calloc(numresolutions, sizeof(opj_tcd_resolution_t));
+	tilec->data = (OPJ_INT32*)opj_aligned_malloc(size * size * sizeof(OPJ_INT32));
+	if (!tilec->resolutions || !tilec->data) {
+		opj_free(tilec->resolutions);
+		opj_aligned_free(tilec->data);
+		opj_free(tilec);
+		return 00;
+	}
+	for (resno = 0; resno < numresolutions; ++resno) {
+		opj_tcd_resolution_t *res = &tilec->resolutions[resno];
+		OPJ_UINT32 level = numresolutions - 1 - resno;
+		res->x1 = opj_int_ceildivpow2((OPJ_INT32)size, (OPJ_INT32)level);
+		res->y1 = opj_int_ceildivpow2((OPJ_INT32)size, (OPJ_INT32)level);
+		res->numbands = resno ? 3 : 1;
+	}
+	tilec->data_size = size * size * (OPJ_UINT32)sizeof(OPJ_INT32);
+	return tilec;
+}
+
+static void destroy_tilecomp(opj_tcd_tilecomp_t *tilec)
+{
+	if (tilec) {
+		opj_free(tilec->resolutions);
+		opj_aligned_free(tilec->data);
+		opj_free(tilec);
+	}
+}
+
+/*
+ * Inverse transforms of the 5 levels of decomposition of a natural-like
+ * image, as given by opj_dwt_encode. The 9-7 transform runs on the same
+ * coefficients converted to floats.
+ */
+static int bench_dwt(OPJ_UINT32 size, OPJ_UINT32 iterations)
+{
+	const OPJ_UINT32 numresolutions = 6, nb_samples = size * size;
+	opj_tcd_tilecomp_t *tilec = create_tilecomp(size, numresolutions);
+	OPJ_INT32 *image = (OPJ_INT32*)opj_malloc(nb_samples * sizeof(OPJ_INT32));
+	OPJ_INT32 *coefs = (OPJ_INT32*)opj_malloc(nb_samples * sizeof(OPJ_INT32));
+	kernel_timer_t timer, real_timer;
+	OPJ_UINT32 i, x, y, it;
+	char config[32];
+	int ok = 0;
+
+	memset(&timer, 0, sizeof(timer));
+	memset(&real_timer, 0, sizeof(real_timer));
+	if (!tilec || !image || !coefs) {
+		goto cleanup;
+	}
+	for (y = 0; y < size; ++y) {
+		for (x = 0; x < size; ++x) {
+			OPJ_FLOAT64 u = (OPJ_FLOAT64)x / size, v = (OPJ_FLOAT64)y / size;
+			image[y * size + x] = (OPJ_INT32)(60 * sin(9 * u + 4 * v) * cos(5 * v) + 40 * (u > 0.6 && v < 0.7)
+			                                  + 8 * uniform()) - 4;
+		}
+	}
+	memcpy(tilec->data, image, nb_samples * sizeof(OPJ_INT32));
+	if (!opj_dwt_encode(tilec)) {
+		goto cleanup;
+	}
+	memcpy(coefs, tilec->data, nb_samples * sizeof(OPJ_INT32));
+
+	for (it = 0; it < iterations; ++it) {
+		memcpy(tilec->data, coefs, nb_samples * sizeof(OPJ_INT32));
+		timer_start(&timer);
+		if (!opj_dwt_decode(tilec, numresolutions)) {
+			goto cleanup;
+		}
+		timer_stop(&timer);
+	}
+	if (memcmp(tilec->data, image, nb_samples * sizeof(OPJ_INT32)) != 0) {
+		fprintf(stderr, "ERROR -> opj_dwt_decode does not give back the image\n");
+		goto cleanup;
+	}
+
+	for (it = 0; it < iterations; ++it) {
+		OPJ_FLOAT32 *data = (OPJ_FLOAT32*)tilec->data;
+		for (i = 0; i < nb_samples; ++i) {
+			data[i] = (OPJ_FLOAT32)coefs[i];
+		}
+		timer_start(&real_timer);
+		if (!opj_dwt_decode_real(tilec, numresolutions)) {
+			goto cleanup;
+		}
+		timer_stop(&real_timer);
+	}
+
+	sprintf(config, "%ux%u", size, size);
+	report("opj_dwt_decode", config, &timer, nb_samples);
+	report("opj_dwt_decode_real", config, &real_timer, nb_samples);
+	ok = 1;
+
+cleanup:
+	destroy_tilecomp(tilec);
+	opj_free(coefs);
+	opj_free(image);
+	return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+
+static int bench_mct(OPJ_UINT32 nb_pixels, OPJ_UINT32 iterations)
+{
+	OPJ_INT32 *source = (OPJ_INT32*)opj_malloc(3 * nb_pixels * sizeof(OPJ_INT32));
+	OPJ_INT32 *planes = (OPJ_INT32*)opj_aligned_malloc(3 * nb_pixels * sizeof(OPJ_INT32));
+	OPJ_INT32 *rgb = (OPJ_INT32*)opj_malloc(3 * nb_pixels * sizeof(OPJ_INT32));
+	kernel_timer_t timer, real_timer;
+	OPJ_UINT32 i, it;
+	int ok = 0;
+
+	memset(&timer, 0, sizeof(timer));
+	memset(&real_timer, 0, sizeof(real_timer));
+	if (!source || !planes || !rgb) {
+		goto cleanup;
+	}
+	/* forward transform of correlated RGB samples */
+	for (i = 0; i < nb_pixels; ++i) {
+		OPJ_INT32 luma = (OPJ_INT32)(255 * uniform()) - 128;
+		rgb[i] = luma + (OPJ_INT32)(20 * uniform());
+		rgb[nb_pixels + i] = luma;
+		rgb[2 * nb_pixels + i] = luma - (OPJ_INT32)(20 * uniform());
+	}
+	memcpy(source, rgb, 3 * nb_pixels * sizeof(OPJ_INT32));
+	opj_mct_encode(source, source + nb_pixels, source + 2 * nb_pixels, nb_pixels);
+
+	for (it = 0; it < iterations; ++it) {
+		memcpy(planes, source, 3 * nb_pixels * sizeof(OPJ_INT32));
+		timer_start(&timer);
+		opj_mct_decode(planes, planes + nb_pixels, planes + 2 * nb_pixels, nb_pixels);
+		timer_stop(&timer);
+	}
+	if (memcmp(planes, rgb, 3 * nb_pixels * sizeof(OPJ_INT32)) != 0) {
+		fprintf(stderr, "ERROR -> opj_mct_decode does not give back the RGB samples\n");
+		goto cleanup;
+	}
+
+	for (it = 0; it < iterations; ++it) {
+		OPJ_FLOAT32 *data = (OPJ_FLOAT32*)planes;
+		for (i = 0; i < 3 * nb_pixels; ++i) {
+			data[i] = (OPJ_FLOAT32)source[i];
+		}
+		timer_start(&real_timer);
+		opj_mct_decode_real(data, data + nb_pixels, data + 2 * nb_pixels, nb_pixels);
+		timer_stop(&real_timer);
+	}
+
+	report("opj_mct_decode", "", &timer, 3 * (OPJ_UINT64)nb_pixels);
+	report("opj_mct_decode_real", "", &real_timer, 3 * (OPJ_UINT64)nb_pixels);
+	ok = 1;
+
+cleanup:
+	opj_free(rgb);
+	opj_aligned_free(planes);
+	opj_free(source);
+	return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	OPJ_UINT32 iterations, size;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s <iterations> [size (1024)]\n", argv[0]);
+		return 1;
+	}
+	iterations = (OPJ_UINT32)atoi(argv[1]);
+	size = (argc > 2) ? (OPJ_UINT32)atoi(argv[2]) : 1024;
+	/* the wavelet transforms are size / 16, size / 4 and size wide, with rows of a multiple of 8 samples */
+	if (iterations == 0 || size < 256 || size > 8192 || (size & 127) != 0) {
+		return 1;
+	}
+
+	if (!bench_mqc(size * size, iterations)
+	    || !bench_t1(64, size / 16, iterations) || !bench_t1(32, size / 4, iterations)
+	    || !bench_dwt(size / 16, iterations) || !bench_dwt(size / 4, iterations) || !bench_dwt(size, iterations)
+	    || !bench_mct(size * size, iterations)) {
+		fprintf(stderr, "ERROR -> benchmark failed\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Packet header decoding benchmark : a codestream with many layers and small
+ * precincts is decoded at its lowest resolution, where the time is spent
+ * parsing the packet headers, then at full resolution.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_RESOLUTIONS 6
+#define NUM_LAYERS_MAX 100
+
+static int encode(const char *filename, OPJ_UINT32 size, OPJ_UINT32 num_layers)
+{
+	opj_cparameters_t parameters;
+	opj_image_t *image;
+	OPJ_UINT32 i, j;
+
+	image = test_create_image(1, 0, 0, size, size, 8);
+	if (!image) {
+		return 0;
+	}
+	/* noisy ramps, so that each code-block gets a few passes in each layer */
+	srand(1);
+	for (j = 0; j < size; ++j) {
+		for (i = 0; i < size; ++i) {
+			image->comps[0].data[j * size + i] = (OPJ_INT32)(((i + 3 * j) / 4 + (OPJ_UINT32)(rand() % 64)) & 0xff);
+		}
+	}
+
+	opj_set_default_encoder_parameters(&parameters);
+	parameters.numresolution = NUM_RESOLUTIONS;
+	parameters.cblockw_init = 16;
+	parameters.cblockh_init = 16;
+	/* 16x16 precincts at every resolution */
+	parameters.csty |= 0x01;
+	parameters.res_spec = NUM_RESOLUTIONS;
+	for (i = 0; i < NUM_RESOLUTIONS; ++i) {
+		parameters.prcw_init[i] = 16;
+		parameters.prch_init[i] = 16;
+	}
+	parameters.tcp_numlayers = (int)num_layers;
+	for (i = 0; i < num_layers; ++i) {
+		parameters.tcp_rates[i] = (float)(2 * (num_layers - i));
+	}
+	parameters.tcp_rates[num_layers - 1] = 0;
+	parameters.cp_disto_alloc = 1;
+
+	return test_encode_image(filename, &parameters, image);
+}
+
+static int decode(const char *filename, OPJ_UINT32 reduce)
+{
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	opj_image_t *image = 00;
+	int ok;
+
+	opj_set_default_decoder_parameters(&parameters);
+	parameters.cp_reduce = reduce;
+
+	codec = opj_create_decompress(OPJ_CODEC_J2K);
+	opj_set_error_handler(codec, test_error_callback, 00);
+	stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+	ok = stream && opj_setup_decoder(codec, &parameters)
+	     && opj_read_header(stream, codec, &image) && opj_decode(codec, stream, image) && opj_end_decompress(codec, stream);
+	if (stream) {
+		opj_stream_destroy(stream);
+	}
+	opj_destroy_codec(codec);
+	opj_image_destroy(image);
+	return ok;
+}
+
+static int bench(const char *filename, OPJ_UINT32 reduce, OPJ_UINT32 iterations)
+{
+	clock_t start = clock();
+	OPJ_UINT32 i;
+	double ms;
+
+	for (i = 0; i < iterations; ++i) {
+		if (!decode(filename, reduce)) {
+			fprintf(stderr, "ERROR -> failed to decode %s with reduce %u\n", filename, reduce);
+			return 0;
+		}
+	}
+	ms = 1000.0 * (double)(clock() - start) / CLOCKS_PER_SEC / iterations;
+	printf("reduce %u : %.3f ms per decode\n", reduce, ms);
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *filename;
+	OPJ_UINT32 iterations, size, num_layers;
+
+	if (argc < 3 || argc > 5) {
+		fprintf(stderr, "Usage: %s <file.j2k> <iterations> [size (512)] [layers (40)]\n", argv[0]);
+		return 1;
+	}
+	filename = argv[1];
+	iterations = (OPJ_UINT32)atoi(argv[2]);
+	size = (argc > 3) ? (OPJ_UINT32)atoi(argv[3]) : 512;
+	num_layers = (argc > 4) ? (OPJ_UINT32)atoi(argv[4]) : 40;
+	if (iterations == 0 || size < 64 || num_layers == 0 || num_layers > NUM_LAYERS_MAX) {
+		return 1;
+	}
+
+	if (!encode(filename, size, num_layers)) {
+		fprintf(stderr, "ERROR -> failed to encode %s\n", filename);
+		return 1;
+	}
+	printf("%s : %ux%u, %u layers, %u resolutions, 16x16 precincts\n", filename, size, size, num_layers, NUM_RESOLUTIONS);
+
+	if (!bench(filename, NUM_RESOLUTIONS - 1, iterations) || !bench(filename, 0, iterations)) {
+		return 1;
+	}
+	return 0;
+}
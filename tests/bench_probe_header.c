@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Header probe benchmark : a tiled codestream and a JP2 file are probed with
+ * opj_probe_header from the first bytes of the file, the results are checked
+ * against opj_read_header, then the number of files per second of both ways
+ * of reading the header is measured.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+#define PREFIX_SIZE 4096
+
+/* a J2K or a JP2 file after the extension of its name, the third component is subsampled */
+static int encode(const char *filename, OPJ_UINT32 numcomps, OPJ_UINT32 prec,
+                  OPJ_UINT32 tile_size, OPJ_UINT32 num_layers, OPJ_UINT32 num_resolutions)
+{
+	opj_cparameters_t parameters;
+	opj_image_cmptparm_t params[3];
+	opj_image_t *image;
+	OPJ_UINT32 i, j, w = 400, h = 300;
+
+	memset(params, 0, sizeof(params));
+	for (i = 0; i < numcomps; ++i) {
+		params[i].dx = 1;
+		params[i].dy = (i == 2) ? 2 : 1;
+		params[i].w = w;
+		params[i].h = h / params[i].dy;
+		params[i].prec = prec;
+	}
+	image = opj_image_create(numcomps, params, numcomps == 3 ? OPJ_CLRSPC_SRGB : OPJ_CLRSPC_GRAY);
+	if (!image) {
+		return 0;
+	}
+	image->x0 = 3;
+	image->y0 = 5;
+	image->x1 = w + 3;
+	image->y1 = h + 5;
+	for (i = 0; i < numcomps; ++i) {
+		OPJ_UINT32 size = image->comps[i].w * image->comps[i].h;
+		for (j = 0; j < size; ++j) {
+			image->comps[i].data[j] = (OPJ_INT32)((j * (i + 1)) % (1u << prec));
+		}
+	}
+
+	opj_set_default_encoder_parameters(&parameters);
+	parameters.numresolution = (int)num_resolutions;
+	parameters.tcp_numlayers = (int)num_layers;
+	for (i = 0; i < num_layers; ++i) {
+		parameters.tcp_rates[i] = (float)(4 * (num_layers - i));
+	}
+	parameters.tcp_rates[num_layers - 1] = 0;
+	parameters.cp_disto_alloc = 1;
+	parameters.prog_order = OPJ_RPCL;
+	if (tile_size) {
+		parameters.tile_size_on = OPJ_TRUE;
+		parameters.cp_tx0 = 1;
+		parameters.cp_ty0 = 2;
+		parameters.cp_tdx = (int)tile_size;
+		parameters.cp_tdy = (int)tile_size;
+	}
+
+	return test_encode_image(filename, &parameters, image);
+}
+
+static OPJ_SIZE_T read_prefix(const char *filename, OPJ_BYTE *buffer, OPJ_SIZE_T size)
+{
+	FILE *file = fopen(filename, "rb");
+	OPJ_SIZE_T read;
+
+	if (!file) {
+		return 0;
+	}
+	read = fread(buffer, 1, size, file);
+	fclose(file);
+	return read;
+}
+
+static int read_header(const char *filename, OPJ_CODEC_FORMAT format, opj_image_t **image, opj_codestream_info_v2_t **cstr_info)
+{
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	int ok;
+
+	*image = 00;
+	opj_set_default_decoder_parameters(&parameters);
+	codec = opj_create_decompress(format);
+	opj_set_error_handler(codec, test_error_callback, 00);
+	stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+	ok = stream && opj_setup_decoder(codec, &parameters) && opj_read_header(stream, codec, image);
+	if (ok && cstr_info) {
+		*cstr_info = opj_get_cstr_info(codec);
+		ok = (*cstr_info != 00);
+	}
+	if (stream) {
+		opj_stream_destroy(stream);
+	}
+	opj_destroy_codec(codec);
+	return ok;
+}
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "ERROR -> %s: check failed: %s\n", filename, #cond); return 0; } } while (0)
+
+static int compare(const char *filename, const opj_probe_info_t *info, OPJ_CODEC_FORMAT format,
+                   const opj_image_t *image, const opj_codestream_info_v2_t *cstr_info)
+{
+	const opj_tile_info_v2_t *tile_info = &cstr_info->m_default_tile_info;
+	OPJ_UINT32 i;
+
+	CHECK(info->format == format);
+	CHECK(info->x0 == image->x0 && info->y0 == image->y0 && info->x1 == image->x1 && info->y1 == image->y1);
+	CHECK(info->numcomps == image->numcomps);
+	for (i = 0; i < image->numcomps; ++i) {
+		CHECK(info->comps[i].prec == image->comps[i].prec && info->comps[i].sgnd == image->comps[i].sgnd);
+		CHECK(info->comps[i].dx == image->comps[i].dx && info->comps[i].dy == image->comps[i].dy);
+	}
+	CHECK(info->tx0 == cstr_info->tx0 && info->ty0 == cstr_info->ty0);
+	CHECK(info->tdx == cstr_info->tdx && info->tdy == cstr_info->tdy);
+	CHECK(info->tw == cstr_info->tw && info->th == cstr_info->th);
+	CHECK(info->csty == tile_info->csty && info->prg == tile_info->prg);
+	CHECK(info->numlayers == tile_info->numlayers && info->mct == tile_info->mct);
+	CHECK(info->numresolutions == tile_info->tccp_info[0].numresolutions);
+	CHECK(info->cblkw == tile_info->tccp_info[0].cblkw && info->cblkh == tile_info->tccp_info[0].cblkh);
+	CHECK(info->cblksty == tile_info->tccp_info[0].cblksty && info->qmfbid == tile_info->tccp_info[0].qmfbid);
+	CHECK(info->qntsty == tile_info->tccp_info[0].qntsty && info->numgbits == tile_info->tccp_info[0].numgbits);
+	if (format == OPJ_CODEC_JP2) {
+		CHECK(info->meth == 1 && info->enumcs == 17 && info->color_space == OPJ_CLRSPC_GRAY);
+		CHECK(info->icc_profile_len == 0 && info->has_palette == 0);
+	}
+	else {
+		CHECK(info->meth == 0 && info->color_space == OPJ_CLRSPC_UNSPECIFIED);
+	}
+	return 1;
+}
+
+static int check(const char *filename, OPJ_CODEC_FORMAT format)
+{
+	OPJ_BYTE buffer[PREFIX_SIZE];
+	OPJ_SIZE_T size, shortest;
+	opj_probe_info_t info, truncated_info;
+	opj_image_t *image;
+	opj_codestream_info_v2_t *cstr_info;
+	int ok;
+
+	size = read_prefix(filename, buffer, sizeof(buffer));
+	CHECK(size > 0);
+	CHECK(opj_probe_header(buffer, size, &info));
+	if (!read_header(filename, format, &image, &cstr_info)) {
+		fprintf(stderr, "ERROR -> %s: failed to read the header\n", filename);
+		return 0;
+	}
+	ok = compare(filename, &info, format, image, cstr_info);
+	opj_image_destroy(image);
+	opj_destroy_cstr_info(&cstr_info);
+	if (!ok) {
+		return 0;
+	}
+
+	/* the probe fails on a buffer ending before the SIZ, COD and QCD markers, and on a damaged signature */
+	for (shortest = 1; !opj_probe_header(buffer, shortest, &truncated_info); ++shortest) {
+		CHECK(shortest < size);
+	}
+	CHECK(memcmp(&info, &truncated_info, sizeof(info)) == 0);
+	buffer[format == OPJ_CODEC_JP2 ? 4 : 1] ^= 1;
+	CHECK(!opj_probe_header(buffer, size, &truncated_info));
+
+	printf("%s : %ux%u, %u tiles, %u components, header probed from its first %u bytes\n", filename,
+	       info.x1 - info.x0, info.y1 - info.y0, info.tw * info.th, info.numcomps, (OPJ_UINT32)shortest);
+	return 1;
+}
+
+static int bench(const char *filename, OPJ_CODEC_FORMAT format, OPJ_UINT32 iterations)
+{
+	OPJ_BYTE buffer[PREFIX_SIZE];
+	opj_probe_info_t info;
+	opj_image_t *image;
+	clock_t start;
+	double probe_s, header_s;
+	OPJ_UINT32 i;
+
+	start = clock();
+	for (i = 0; i < iterations; ++i) {
+		OPJ_SIZE_T size = read_prefix(filename, buffer, sizeof(buffer));
+		if (!opj_probe_header(buffer, size, &info)) {
+			fprintf(stderr, "ERROR -> failed to probe %s\n", filename);
+			return 0;
+		}
+	}
+	probe_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	start = clock();
+	for (i = 0; i < iterations; ++i) {
+		if (!read_header(filename, format, &image, 00)) {
+			fprintf(stderr, "ERROR -> failed to read the header of %s\n", filename);
+			return 0;
+		}
+		opj_image_destroy(image);
+	}
+	header_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	printf("%s : opj_probe_header %.0f files/s, opj_read_header %.0f files/s\n", filename,
+	       probe_s > 0 ? iterations / probe_s : 0.0, header_s > 0 ? iterations / header_s : 0.0);
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	char j2k_name[256], jp2_name[256];
+	OPJ_UINT32 iterations;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <basename> <iterations>\n", argv[0]);
+		return 1;
+	}
+	iterations = (OPJ_UINT32)atoi(argv[2]);
+	if (iterations == 0 || strlen(argv[1]) > sizeof(j2k_name) - 5) {
+		return 1;
+	}
+	sprintf(j2k_name, "%s.j2k", argv[1]);
+	sprintf(jp2_name, "%s.jp2", argv[1]);
+
+	if (!encode(j2k_name, 3, 8, 64, 3, 4) || !encode(jp2_name, 1, 12, 0, 2, 6)) {
+		fprintf(stderr, "ERROR -> failed to encode the test files\n");
+		return 1;
+	}
+
+	if (!check(j2k_name, OPJ_CODEC_J2K) || !check(jp2_name, OPJ_CODEC_JP2)) {
+		return 1;
+	}
+	if (!bench(j2k_name, OPJ_CODEC_J2K, iterations) || !bench(jp2_name, OPJ_CODEC_JP2, iterations)) {
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Encoder and decoder benchmark : synthetic RGB images (smooth, noisy and
+ * natural-like) are encoded in memory with every combination of lossless or
+ * lossy coding, tiling, code-block size and number of layers, then each
+ * codestream is decoded in full, at lower resolutions and through ROI windows.
+ * The CPU time of each workload is written as CSV or JSON, one record per
+ * workload, so that the results of two releases can be compared.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+#include "openjpeg.h"
+#include "opj_getopt.h"
+
+/* -------------------------------------------------------------------------- */
+
+/**
+sample error callback expecting no client object
+*/
+static void error_callback(const char *msg, void *client_data) {
+	(void)client_data;
+	fprintf(stderr, "[ERROR] %s", msg);
+}
+
+/* -------------------------------------------------------------------------- */
+
+/* growable memory buffer behind the encoder and decoder streams */
+typedef struct mem_buffer {
+	OPJ_BYTE *data;
+	OPJ_SIZE_T size;
+	OPJ_SIZE_T capacity;
+	OPJ_SIZE_T offset;
+} mem_buffer_t;
+
+static OPJ_SIZE_T mem_read(void *p_buffer, OPJ_SIZE_T p_nb_bytes, void *p_user_data)
+{
+	mem_buffer_t *buffer = (mem_buffer_t*)p_user_data;
+	OPJ_SIZE_T nb_bytes = buffer->size - buffer->offset;
+
+	if (nb_bytes == 0) {
+		return (OPJ_SIZE_T)-1;
+	}
+	if (nb_bytes > p_nb_bytes) {
+		nb_bytes = p_nb_bytes;
+	}
+	memcpy(p_buffer, buffer->data + buffer->offset, nb_bytes);
+	buffer->offset += nb_bytes;
+	return nb_bytes;
+}
+
+static OPJ_BOOL mem_reserve(mem_buffer_t *buffer, OPJ_SIZE_T size)
+{
+	if (size > buffer->capacity) {
+		OPJ_SIZE_T capacity = buffer->capacity ? buffer->capacity : 65536;
+		OPJ_BYTE *data;
+		while (capacity < size) {
+			capacity *= 2;
+		}
+		data = (OPJ_BYTE*)realloc(buffer->data, capacity);
+		if (!data) {
+			return OPJ_FALSE;
+		}
+		buffer->data = data;
+		buffer->capacity = capacity;
+	}
+	return OPJ_TRUE;
+}
+
+static OPJ_SIZE_T mem_write(void *p_buffer, OPJ_SIZE_T p_nb_bytes, void *p_user_data)
+{
+	mem_buffer_t *buffer = (mem_buffer_t*)p_user_data;
+
+	if (!mem_reserve(buffer, buffer->offset + p_nb_bytes)) {
+		return (OPJ_SIZE_T)-1;
+	}
+	memcpy(buffer->data + buffer->offset, p_buffer, p_nb_bytes);
+	buffer->offset += p_nb_bytes;
+	if (buffer->offset > buffer->size) {
+		buffer->size = buffer->offset;
+	}
+	return p_nb_bytes;
+}
+
+/* moving past the end of the data extends it with zeros, as with a file */
+static OPJ_BOOL mem_set_offset(mem_buffer_t *buffer, OPJ_OFF_T offset)
+{
+	if (offset < 0) {
+		return OPJ_FALSE;
+	}
+	if ((OPJ_SIZE_T)offset > buffer->size) {
+		if (!mem_reserve(buffer, (OPJ_SIZE_T)offset)) {
+			return OPJ_FALSE;
+		}
+		memset(buffer->data + buffer->size, 0, (OPJ_SIZE_T)offset - buffer->size);
+		buffer->size = (OPJ_SIZE_T)offset;
+	}
+	buffer->offset = (OPJ_SIZE_T)offset;
+	return OPJ_TRUE;
+}
+
+static OPJ_BOOL mem_seek(OPJ_OFF_T p_nb_bytes, void *p_user_data)
+{
+	return mem_set_offset((mem_buffer_t*)p_user_data, p_nb_bytes);
+}
+
+static OPJ_OFF_T mem_skip(OPJ_OFF_T p_nb_bytes, void *p_user_data)
+{
+	mem_buffer_t *buffer = (mem_buffer_t*)p_user_data;
+
+	if (!mem_set_offset(buffer, (OPJ_OFF_T)buffer->offset + p_nb_bytes)) {
+		return -1;
+	}
+	return p_nb_bytes;
+}
+
+static opj_stream_t* mem_stream_create(mem_buffer_t *buffer, OPJ_BOOL is_input)
+{
+	opj_stream_t *stream = opj_stream_default_create(is_input);
+
+	if (!stream) {
+		return 00;
+	}
+	buffer->offset = 0;
+	opj_stream_set_user_data(stream, buffer, 00);
+	opj_stream_set_seek_function(stream, mem_seek);
+	opj_stream_set_skip_function(stream, mem_skip);
+	if (is_input) {
+		opj_stream_set_read_function(stream, mem_read);
+		opj_stream_set_user_data_length(stream, buffer->size);
+	}
+	else {
+		opj_stream_set_write_function(stream, mem_write);
+	}
+	return stream;
+}
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS 3
+#define NUM_RESOLUTIONS 6
+#define LOSSY_RATE 20
+
+typedef enum {
+	IMAGE_SMOOTH,
+	IMAGE_NOISY,
+	IMAGE_NATURAL
+} image_kind_t;
+
+static const char *image_names[] = { "smooth", "noisy", "natural" };
+
+/* bilinear interpolation of a grid of random values, one octave of value noise */
+static double value_noise(const double *grid, OPJ_UINT32 grid_size, double x, double y)
+{
+	OPJ_UINT32 ix = (OPJ_UINT32)x, iy = (OPJ_UINT32)y;
+	double fx = x - ix, fy = y - iy;
+	const double *row = grid + iy * (grid_size + 1);
+
+	return (row[ix] * (1 - fx) + row[ix + 1] * fx) * (1 - fy)
+	       + (row[grid_size + 1 + ix] * (1 - fx) + row[grid_size + 1 + ix + 1] * fx) * fy;
+}
+
+static int clamp8(double value)
+{
+	return value < 0 ? 0 : value > 255 ? 255 : (int)(value + 0.5);
+}
+
+/*
+ * smooth : gradients and low frequency waves, the wavelet coefficients are small
+ * noisy : uniform random samples, nothing to compress
+ * natural : 1/f value noise with a few sharp edged objects, mild sensor noise
+ *           and correlated components, close to a photograph
+ */
+static opj_image_t *create_image(image_kind_t kind, OPJ_UINT32 size)
+{
+	opj_image_cmptparm_t params[NUM_COMPS];
+	opj_image_t *image;
+	double *grids[5] = { 00 };
+	OPJ_UINT32 compno, octave, x, y;
+
+	memset(params, 0, sizeof(params));
+	for (compno = 0; compno < NUM_COMPS; ++compno) {
+		params[compno].dx = 1;
+		params[compno].dy = 1;
+		params[compno].w = size;
+		params[compno].h = size;
+		params[compno].prec = 8;
+		params[compno].bpp = 8;
+	}
+	image = opj_image_create(NUM_COMPS, params, OPJ_CLRSPC_SRGB);
+	if (!image) {
+		return 00;
+	}
+	image->x1 = size;
+	image->y1 = size;
+
+	srand(1 + (unsigned int)kind);
+	if (kind == IMAGE_NATURAL) {
+		for (octave = 0; octave < 5; ++octave) {
+			OPJ_UINT32 grid_size = 4u << octave, i;
+			grids[octave] = (double*)malloc((grid_size + 1) * (grid_size + 1) * sizeof(double));
+			if (!grids[octave]) {
+				while (octave--) {
+					free(grids[octave]);
+				}
+				opj_image_destroy(image);
+				return 00;
+			}
+			for (i = 0; i < (grid_size + 1) * (grid_size + 1); ++i) {
+				grids[octave][i] = rand() / (double)RAND_MAX - 0.5;
+			}
+		}
+	}
+
+	for (y = 0; y < size; ++y) {
+		for (x = 0; x < size; ++x) {
+			double u = (double)x / size, v = (double)y / size;
+			OPJ_UINT32 offset = y * size + x;
+			if (kind == IMAGE_SMOOTH) {
+				image->comps[0].data[offset] = clamp8(255 * u);
+				image->comps[1].data[offset] = clamp8(255 * v);
+				image->comps[2].data[offset] = clamp8(128 + 100 * sin(6.28 * (u + v)) * cos(3.14 * u));
+			}
+			else if (kind == IMAGE_NOISY) {
+				for (compno = 0; compno < NUM_COMPS; ++compno) {
+					image->comps[compno].data[offset] = rand() & 0xff;
+				}
+			}
+			else {
+				double luma = 0, amplitude = 128, dx, dy;
+				for (octave = 0; octave < 5; ++octave) {
+					OPJ_UINT32 grid_size = 4u << octave;
+					luma += amplitude * value_noise(grids[octave], grid_size, u * grid_size, v * grid_size);
+					amplitude /= 2;
+				}
+				luma += 128;
+				/* a bright disc and a dark band over the background */
+				dx = u - 0.3;
+				dy = v - 0.6;
+				if (dx * dx + dy * dy < 0.04) {
+					luma = 220 - 60 * dy;
+				}
+				if (u > 0.55 && u < 0.7 && v > 0.1) {
+					luma = 40 + 20 * v;
+				}
+				luma += (rand() % 7) - 3;
+				image->comps[0].data[offset] = clamp8(luma * 1.1 - 10);
+				image->comps[1].data[offset] = clamp8(luma);
+				image->comps[2].data[offset] = clamp8(luma * 0.8 + 30 * u);
+			}
+		}
+	}
+	for (octave = 0; octave < 5; ++octave) {
+		free(grids[octave]);
+	}
+	return image;
+}
+
+/* opj_start_compress takes the samples of the image, so each encoding gets its own copy */
+static opj_image_t *copy_image(const opj_image_t *image)
+{
+	opj_image_cmptparm_t params[NUM_COMPS];
+	opj_image_t *copy;
+	OPJ_UINT32 compno;
+
+	memset(params, 0, sizeof(params));
+	for (compno = 0; compno < image->numcomps; ++compno) {
+		params[compno].dx = image->comps[compno].dx;
+		params[compno].dy = image->comps[compno].dy;
+		params[compno].w = image->comps[compno].w;
+		params[compno].h = image->comps[compno].h;
+		params[compno].prec = image->comps[compno].prec;
+		params[compno].bpp = image->comps[compno].bpp;
+	}
+	copy = opj_image_create(image->numcomps, params, image->color_space);
+	if (!copy) {
+		return 00;
+	}
+	copy->x1 = image->x1;
+	copy->y1 = image->y1;
+	for (compno = 0; compno < image->numcomps; ++compno) {
+		memcpy(copy->comps[compno].data, image->comps[compno].data,
+		       image->comps[compno].w * image->comps[compno].h * sizeof(OPJ_INT32));
+	}
+	return copy;
+}
+
+/* -------------------------------------------------------------------------- */
+
+typedef struct encode_config {
+	int lossless;
+	OPJ_UINT32 tile_size; /* 0 for a single tile */
+	OPJ_UINT32 cblk_size;
+	OPJ_UINT32 num_layers;
+} encode_config_t;
+
+typedef struct decode_config {
+	const char *name;
+	OPJ_UINT32 reduce;
+	OPJ_UINT32 roi_divisor; /* 0 for the whole image, else a centered window of size / roi_divisor */
+} decode_config_t;
+
+static const decode_config_t decode_configs[] = {
+	{ "full", 0, 0 },
+	{ "reduce1", 1, 0 },
+	{ "reduce2", 2, 0 },
+	{ "roi_large", 0, 2 },
+	{ "roi_small", 0, 8 },
+};
+
+static int encode(opj_image_t *image, const encode_config_t *config, mem_buffer_t *buffer)
+{
+	opj_cparameters_t parameters;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	OPJ_UINT32 i;
+	int ok;
+
+	opj_set_default_encoder_parameters(&parameters);
+	parameters.numresolution = NUM_RESOLUTIONS;
+	parameters.tcp_mct = 1;
+	parameters.irreversible = config->lossless ? 0 : 1;
+	parameters.cblockw_init = (int)config->cblk_size;
+	parameters.cblockh_init = (int)config->cblk_size;
+	/* each layer doubles the rate of the previous one */
+	parameters.tcp_numlayers = (int)config->num_layers;
+	for (i = 0; i < config->num_layers; ++i) {
+		parameters.tcp_rates[i] = (float)(LOSSY_RATE << (config->num_layers - 1 - i));
+	}
+	if (config->lossless) {
+		parameters.tcp_rates[config->num_layers - 1] = 0;
+	}
+	parameters.cp_disto_alloc = 1;
+	if (config->tile_size) {
+		parameters.tile_size_on = OPJ_TRUE;
+		parameters.cp_tdx = (int)config->tile_size;
+		parameters.cp_tdy = (int)config->tile_size;
+	}
+
+	buffer->size = 0;
+	codec = opj_create_compress(OPJ_CODEC_J2K);
+	opj_set_error_handler(codec, error_callback, 00);
+	stream = mem_stream_create(buffer, OPJ_FALSE);
+	ok = stream && opj_setup_encoder(codec, &parameters, image)
+	     && opj_start_compress(codec, image, stream) && opj_encode(codec, stream)
+	     && opj_end_compress(codec, stream);
+	if (stream) {
+		opj_stream_destroy(stream);
+	}
+	opj_destroy_codec(codec);
+	return ok;
+}
+
+static opj_image_t *decode(mem_buffer_t *buffer, const decode_config_t *config)
+{
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	opj_image_t *image = 00;
+	int ok;
+
+	opj_set_default_decoder_parameters(&parameters);
+	parameters.cp_reduce = config->reduce;
+
+	codec = opj_create_decompress(OPJ_CODEC_J2K);
+	opj_set_error_handler(codec, error_callback, 00);
+	stream = mem_stream_create(buffer, OPJ_TRUE);
+	ok = stream && opj_setup_decoder(codec, &parameters) && opj_read_header(stream, codec, &image);
+	if (ok && config->roi_divisor) {
+		OPJ_INT32 width = (OPJ_INT32)(image->x1 - image->x0) / (OPJ_INT32)config->roi_divisor;
+		OPJ_INT32 height = (OPJ_INT32)(image->y1 - image->y0) / (OPJ_INT32)config->roi_divisor;
+		OPJ_INT32 x0 = (OPJ_INT32)(image->x0 + image->x1) / 2 - width / 2;
+		OPJ_INT32 y0 = (OPJ_INT32)(image->y0 + image->y1) / 2 - height / 2;
+		ok = opj_set_decode_area(codec, image, x0, y0, x0 + width, y0 + height);
+	}
+	ok = ok && opj_decode(codec, stream, image) && opj_end_decompress(codec, stream);
+	if (stream) {
+		opj_stream_destroy(stream);
+	}
+	opj_destroy_codec(codec);
+	if (!ok) {
+		opj_image_destroy(image);
+		return 00;
+	}
+	return image;
+}
+
+/* PSNR of a full resolution decoding over all the components, negative when lossless */
+static double psnr(const opj_image_t *reference, const opj_image_t *image)
+{
+	double error = 0;
+	OPJ_UINT32 compno, i, count = 0;
+
+	for (compno = 0; compno < reference->numcomps; ++compno) {
+		const opj_image_comp_t *comp = &reference->comps[compno];
+		for (i = 0; i < comp->w * comp->h; ++i) {
+			double diff = comp->data[i] - image->comps[compno].data[i];
+			error += diff * diff;
+		}
+		count += comp->w * comp->h;
+	}
+	if (error == 0) {
+		return -1;
+	}
+	return 10 * log10(255.0 * 255.0 * count / error);
+}
+
+/* -------------------------------------------------------------------------- */
+
+typedef enum {
+	OUTPUT_CSV,
+	OUTPUT_JSON
+} output_format_t;
+
+typedef struct result {
+	const char *image;
+	const encode_config_t *config;
+	const char *operation;
+	const char *variant;
+	OPJ_UINT32 width;
+	OPJ_UINT32 height;
+	OPJ_SIZE_T bytes;
+	double psnr; /* 0 if not measured, negative if lossless */
+	double ms_min;
+	double ms_mean;
+} result_t;
+
+static void write_result(FILE *out, output_format_t format, const result_t *result, OPJ_UINT32 index)
+{
+	double mpixels_s = result->ms_min > 0 ? result->width * result->height / (1000.0 * result->ms_min) : 0.0;
+	char psnr_value[32];
+
+	if (result->psnr > 0) {
+		sprintf(psnr_value, "%.3f", result->psnr);
+	}
+	else {
+		strcpy(psnr_value, format == OUTPUT_JSON ? "null" : "");
+	}
+	if (format == OUTPUT_CSV) {
+		if (index == 0) {
+			fprintf(out, "image,mode,tile,cblk,layers,operation,variant,width,height,bytes,psnr,ms_min,ms_mean,mpixels_s\n");
+		}
+		fprintf(out, "%s,%s,%u,%u,%u,%s,%s,%u,%u,%lu,%s,%.3f,%.3f,%.2f\n", result->image,
+		        result->config->lossless ? "lossless" : "lossy", result->config->tile_size, result->config->cblk_size,
+		        result->config->num_layers, result->operation, result->variant, result->width, result->height,
+		        (unsigned long)result->bytes, psnr_value, result->ms_min, result->ms_mean, mpixels_s);
+	}
+	else {
+		fprintf(out, "%s\n    {\"image\": \"%s\", \"mode\": \"%s\", \"tile\": %u, \"cblk\": %u, \"layers\": %u, "
+		        "\"operation\": \"%s\", \"variant\": \"%s\", \"width\": %u, \"height\": %u, \"bytes\": %lu, "
+		        "\"psnr\": %s, \"ms_min\": %.3f, \"ms_mean\": %.3f, \"mpixels_s\": %.2f}", index ? "," : "",
+		        result->image, result->config->lossless ? "lossless" : "lossy", result->config->tile_size,
+		        result->config->cblk_size, result->config->num_layers, result->operation, result->variant,
+		        result->width, result->height, (unsigned long)result->bytes, psnr_value, result->ms_min,
+		        result->ms_mean, mpixels_s);
+	}
+	fflush(out);
+}
+
+static double elapsed_ms(clock_t start)
+{
+	return 1000.0 * (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* times the encoding of the image, then each decoding of the codestream, and writes a record for each */
+static int bench(FILE *out, output_format_t format, image_kind_t kind, const opj_image_t *image,
+                 const encode_config_t *config, OPJ_UINT32 iterations, OPJ_UINT32 *index)
+{
+	mem_buffer_t buffer;
+	result_t result;
+	OPJ_UINT32 i, j;
+
+	memset(&buffer, 0, sizeof(buffer));
+	memset(&result, 0, sizeof(result));
+	result.image = image_names[kind];
+	result.config = config;
+
+	result.operation = "encode";
+	result.variant = "-";
+	result.width = image->x1 - image->x0;
+	result.height = image->y1 - image->y0;
+	for (i = 0; i < iterations; ++i) {
+		opj_image_t *copy = copy_image(image);
+		clock_t start = clock();
+		double ms;
+		if (!copy || !encode(copy, config, &buffer)) {
+			fprintf(stderr, "ERROR -> failed to encode the %s image\n", image_names[kind]);
+			opj_image_destroy(copy);
+			free(buffer.data);
+			return 0;
+		}
+		ms = elapsed_ms(start);
+		opj_image_destroy(copy);
+		result.ms_min = (i == 0 || ms < result.ms_min) ? ms : result.ms_min;
+		result.ms_mean += ms / iterations;
+	}
+	result.bytes = buffer.size;
+	write_result(out, format, &result, (*index)++);
+
+	result.operation = "decode";
+	for (j = 0; j < sizeof(decode_configs) / sizeof(decode_configs[0]); ++j) {
+		const decode_config_t *decode_config = &decode_configs[j];
+		result.variant = decode_config->name;
+		result.ms_mean = 0;
+		for (i = 0; i < iterations; ++i) {
+			clock_t start = clock();
+			opj_image_t *decoded = decode(&buffer, decode_config);
+			double ms = elapsed_ms(start);
+			if (!decoded) {
+				fprintf(stderr, "ERROR -> failed to decode the %s image (%s)\n", image_names[kind], decode_config->name);
+				free(buffer.data);
+				return 0;
+			}
+			result.ms_min = (i == 0 || ms < result.ms_min) ? ms : result.ms_min;
+			result.ms_mean += ms / iterations;
+			if (i == 0) {
+				result.width = decoded->comps[0].w;
+				result.height = decoded->comps[0].h;
+				result.psnr = (j == 0) ? psnr(image, decoded) : 0;
+				if (j == 0 && config->lossless && result.psnr >= 0) {
+					fprintf(stderr, "ERROR -> lossless decoding of the %s image differs from the source\n", image_names[kind]);
+					opj_image_destroy(decoded);
+					free(buffer.data);
+					return 0;
+				}
+			}
+			opj_image_destroy(decoded);
+		}
+		write_result(out, format, &result, (*index)++);
+	}
+	free(buffer.data);
+	return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+
+static void help_display(void)
+{
+	fprintf(stdout, "\nList of parameters for opj_bench\n\n");
+	fprintf(stdout, "  -s \t image width and height (default 512)\n");
+	fprintf(stdout, "  -n \t number of iterations of each workload, the minimum and mean times are reported (default 3)\n");
+	fprintf(stdout, "  -f \t output format, csv or json (default csv)\n");
+	fprintf(stdout, "  -o \t output file (default stdout)\n");
+	fprintf(stdout, "  -i \t only the smooth, noisy or natural image (default all of them)\n");
+	fprintf(stdout, "\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const OPJ_UINT32 cblk_sizes[] = { 64, 32 };
+	static const OPJ_UINT32 layers[] = { 1, 5 };
+	OPJ_UINT32 size = 512, iterations = 3, index = 0, kind, lossless, tiled, cblk, layer;
+	output_format_t format = OUTPUT_CSV;
+	const char *outfile = 00, *only_image = 00;
+	FILE *out = stdout;
+	int c, ok = 1;
+
+	opj_opterr = 0;
+	while ((c = opj_getopt(argc, argv, "s:n:f:o:i:h")) != -1) {
+		switch (c) {
+		case 's':
+			size = (OPJ_UINT32)atoi(opj_optarg);
+			break;
+		case 'n':
+			iterations = (OPJ_UINT32)atoi(opj_optarg);
+			break;
+		case 'f':
+			if (strcmp(opj_optarg, "csv") == 0) {
+				format = OUTPUT_CSV;
+			}
+			else if (strcmp(opj_optarg, "json") == 0) {
+				format = OUTPUT_JSON;
+			}
+			else {
+				fprintf(stderr, "Unknown output format %s\n", opj_optarg);
+				return 1;
+			}
+			break;
+		case 'o':
+			outfile = opj_optarg;
+			break;
+		case 'i':
+			only_image = opj_optarg;
+			for (kind = IMAGE_SMOOTH; kind <= IMAGE_NATURAL && strcmp(only_image, image_names[kind]) != 0; ++kind) {
+			}
+			if (kind > IMAGE_NATURAL) {
+				fprintf(stderr, "Unknown image %s\n", only_image);
+				return 1;
+			}
+			break;
+		case 'h':
+			help_display();
+			return 0;
+		default:
+			if (isprint(opj_optopt)) {
+				fprintf(stderr, "Invalid option `-%c'.\n", opj_optopt);
+			}
+			help_display();
+			return 1;
+		}
+	}
+	/* the tiles are a quarter of the image and keep NUM_RESOLUTIONS levels */
+	if (opj_optind != argc || size < 256 || size > 16384 || iterations == 0) {
+		help_display();
+		return 1;
+	}
+
+	if (outfile) {
+		out = fopen(outfile, "w");
+		if (!out) {
+			fprintf(stderr, "ERROR -> failed to open %s for writing\n", outfile);
+			return 1;
+		}
+	}
+	if (format == OUTPUT_JSON) {
+		fprintf(out, "{\n  \"version\": \"%s\",\n  \"size\": %u,\n  \"iterations\": %u,\n  \"results\": [",
+		        opj_version(), size, iterations);
+	}
+
+	for (kind = IMAGE_SMOOTH; kind <= IMAGE_NATURAL && ok; ++kind) {
+		opj_image_t *image;
+		if (only_image && strcmp(only_image, image_names[kind]) != 0) {
+			continue;
+		}
+		image = create_image((image_kind_t)kind, size);
+		if (!image) {
+			fprintf(stderr, "ERROR -> failed to create the %s image\n", image_names[kind]);
+			ok = 0;
+			break;
+		}
+		for (lossless = 0; lossless < 2 && ok; ++lossless) {
+			for (tiled = 0; tiled < 2 && ok; ++tiled) {
+				for (cblk = 0; cblk < sizeof(cblk_sizes) / sizeof(cblk_sizes[0]) && ok; ++cblk) {
+					for (layer = 0; layer < sizeof(layers) / sizeof(layers[0]) && ok; ++layer) {
+						encode_config_t config;
+						config.lossless = (int)(1 - lossless);
+						config.tile_size = tiled ? size / 4 : 0;
+						config.cblk_size = cblk_sizes[cblk];
+						config.num_layers = layers[layer];
+						ok = bench(out, format, (image_kind_t)kind, image, &config, iterations, &index);
+					}
+				}
+			}
+		}
+		opj_image_destroy(image);
+	}
+
+	if (format == OUTPUT_JSON) {
+		fprintf(out, "\n  ]\n}\n");
+	}
+	if (outfile) {
+		fclose(out);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+#define WIDTH FIXTURE_WIDTH
+#define HEIGHT FIXTURE_HEIGHT
+#define TILE_SIZE FIXTURE_TILE_SIZE
+#define NUM_TILES (((WIDTH + TILE_SIZE - 1) / TILE_SIZE) * ((HEIGHT + TILE_SIZE - 1) / TILE_SIZE))
+
+static const char * const stage_names[OPJ_NB_STAGES] = { "header", "T2", "T1", "DWT", "MCT", "DC shift", "copy", "rate" };
+
+static OPJ_CODEC_FORMAT get_format(const char *filename)
+{
+	size_t len = strlen(filename);
+	return (len > 4 && strcmp(filename + len - 4, ".jp2") == 0) ? OPJ_CODEC_JP2 : OPJ_CODEC_J2K;
+}
+
+static void print_stats(const char *title, const opj_codec_stats_t *stats)
+{
+	OPJ_UINT32 i;
+
+	printf("%s: %d tiles, %d allocations (%.0f bytes)\n", title, stats->nb_tiles,
+			stats->total.nb_allocs, (double)stats->total.alloc_bytes);
+	for (i = 0; i < OPJ_NB_STAGES; ++i) {
+		const opj_stage_stats_t *stage = &stats->total.stages[i];
+		printf("  %-8s %6d calls %9.6f s wall %9.6f s cpu %10.0f bytes\n", stage_names[i],
+				stage->nb_calls, stage->wall_time, stage->cpu_time, (double)stage->nb_bytes);
+	}
+}
+
+/* checks that every tile has run the given stages, and that their figures add up to the total */
+static int check_tiles(const opj_codec_stats_t *stats, const int *stages, int nb_stages)
+{
+	OPJ_UINT32 i;
+	int k;
+
+	if (stats->nb_tiles != NUM_TILES || !stats->tiles) {
+		fprintf(stderr, "ERROR -> %d tiles in the statistics instead of %d\n", stats->nb_tiles, NUM_TILES);
+		return 0;
+	}
+	for (k = 0; k < nb_stages; ++k) {
+		OPJ_UINT32 nb_calls = 0;
+		OPJ_UINT64 nb_bytes = 0;
+		for (i = 0; i < stats->nb_tiles; ++i) {
+			const opj_stage_stats_t *stage = &stats->tiles[i].stages[stages[k]];
+			if (stage->nb_calls == 0 || stage->nb_bytes == 0) {
+				fprintf(stderr, "ERROR -> no %s stage for tile %d\n", stage_names[stages[k]], i);
+				return 0;
+			}
+			nb_calls += stage->nb_calls;
+			nb_bytes += stage->nb_bytes;
+		}
+		/* the main header is only counted in the total */
+		if (stages[k] == OPJ_STAGE_HEADER) {
+			if (nb_calls >= stats->total.stages[stages[k]].nb_calls || nb_bytes >= stats->total.stages[stages[k]].nb_bytes) {
+				fprintf(stderr, "ERROR -> the main header is not counted in the total\n");
+				return 0;
+			}
+		}
+		else if (nb_calls != stats->total.stages[stages[k]].nb_calls || nb_bytes != stats->total.stages[stages[k]].nb_bytes) {
+			fprintf(stderr, "ERROR -> the %s stage of the tiles does not add up to the total\n", stage_names[stages[k]]);
+			return 0;
+		}
+	}
+	/* the structures of the first tile are reused by the next ones */
+	if (stats->tiles[0].nb_allocs == 0 || stats->tiles[0].alloc_bytes == 0) {
+		fprintf(stderr, "ERROR -> no allocation counted for the first tile\n");
+		return 0;
+	}
+	return 1;
+}
+
+static int encode(const char *filename)
+{
+	static const int stages[] = { OPJ_STAGE_T2, OPJ_STAGE_T1, OPJ_STAGE_DWT, OPJ_STAGE_MCT, OPJ_STAGE_DC_SHIFT, OPJ_STAGE_RATE };
+	opj_cparameters_t parameters;
+	opj_image_t *image;
+	opj_codec_t *codec;
+	opj_codec_stats_t *stats = 00;
+	int ok;
+
+	image = test_create_fixture_image();
+	if (!image) {
+		return 0;
+	}
+	test_set_fixture_parameters(&parameters);
+
+	codec = test_create_encoder(filename);
+	ok = codec && opj_set_codec_stats(codec, OPJ_TRUE) && test_encode_to_file(codec, filename, &parameters, image);
+	if (ok) {
+		stats = opj_get_codec_stats(codec);
+		ok = stats != 00;
+	}
+	if (ok) {
+		print_stats("encode", stats);
+		/* the main header, written by opj_start_compress, and the end of the codestream */
+		ok = stats->total.stages[OPJ_STAGE_HEADER].nb_calls == 2 && check_tiles(stats, stages, (int)(sizeof(stages) / sizeof(stages[0])));
+	}
+	opj_destroy_codec_stats(&stats);
+	if (codec) {
+		opj_destroy_codec(codec);
+	}
+	opj_image_destroy(image);
+	return ok;
+}
+
+static int decode(const char *filename, OPJ_BOOL with_stats)
+{
+	static const int stages[] = { OPJ_STAGE_HEADER, OPJ_STAGE_T2, OPJ_STAGE_T1, OPJ_STAGE_DWT, OPJ_STAGE_MCT, OPJ_STAGE_DC_SHIFT, OPJ_STAGE_COPY };
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	opj_image_t *image = 00;
+	opj_codec_stats_t *stats = 00;
+	int ok;
+
+	opj_set_default_decoder_parameters(&parameters);
+	codec = opj_create_decompress(get_format(filename));
+	opj_set_warning_handler(codec, test_warning_callback, 00);
+	opj_set_error_handler(codec, test_error_callback, 00);
+	stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+	ok = stream && opj_setup_decoder(codec, &parameters) && opj_set_codec_stats(codec, with_stats)
+		&& opj_read_header(stream, codec, &image) && opj_decode(codec, stream, image) && opj_end_decompress(codec, stream);
+	if (ok) {
+		stats = opj_get_codec_stats(codec);
+		if (!with_stats) {
+			ok = stats == 00;
+		}
+		else if (!stats) {
+			ok = 0;
+		}
+		else {
+			print_stats("decode", stats);
+			ok = check_tiles(stats, stages, (int)(sizeof(stages) / sizeof(stages[0])));
+		}
+	}
+	opj_destroy_codec_stats(&stats);
+	if (stream) {
+		opj_stream_destroy(stream);
+	}
+	opj_destroy_codec(codec);
+	opj_image_destroy(image);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <file.j2k|file.jp2>\n", argv[0]);
+		return 1;
+	}
+
+	if (!encode(argv[1])) {
+		fprintf(stderr, "ERROR -> wrong statistics while encoding %s\n", argv[1]);
+		return 1;
+	}
+	if (!decode(argv[1], OPJ_TRUE)) {
+		fprintf(stderr, "ERROR -> wrong statistics while decoding %s\n", argv[1]);
+		return 1;
+	}
+	if (!decode(argv[1], OPJ_FALSE)) {
+		fprintf(stderr, "ERROR -> statistics returned while they are disabled\n");
+		return 1;
+	}
+
+	return 0;
+}
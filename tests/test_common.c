@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+void test_error_callback(const char *msg, void *client_data) {
+	(void)client_data;
+	fprintf(stdout, "[ERROR] %s", msg);
+}
+
+void test_warning_callback(const char *msg, void *client_data) {
+	(void)client_data;
+	fprintf(stdout, "[WARNING] %s", msg);
+}
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS_MAX 4
+
+opj_image_t * test_create_image(OPJ_UINT32 numcomps, OPJ_UINT32 x0, OPJ_UINT32 y0, OPJ_UINT32 w, OPJ_UINT32 h, OPJ_UINT32 prec)
+{
+	opj_image_cmptparm_t params[NUM_COMPS_MAX];
+	opj_image_t *image;
+	OPJ_UINT32 compno;
+
+	if (numcomps == 0 || numcomps > NUM_COMPS_MAX) {
+		return 00;
+	}
+	memset(params, 0, sizeof(params));
+	for (compno = 0; compno < numcomps; ++compno) {
+		params[compno].dx = 1;
+		params[compno].dy = 1;
+		params[compno].x0 = x0;
+		params[compno].y0 = y0;
+		params[compno].w = w;
+		params[compno].h = h;
+		params[compno].prec = prec;
+	}
+	image = opj_image_create(numcomps, params, numcomps == 1 ? OPJ_CLRSPC_GRAY : OPJ_CLRSPC_SRGB);
+	if (!image) {
+		return 00;
+	}
+	image->x0 = x0;
+	image->y0 = y0;
+	image->x1 = x0 + w;
+	image->y1 = y0 + h;
+	return image;
+}
+
+opj_image_t * test_create_fixture_image(void)
+{
+	opj_image_t *image = test_create_image(FIXTURE_NUM_COMPS, 0, 0, FIXTURE_WIDTH, FIXTURE_HEIGHT, 8);
+	OPJ_UINT32 compno, i;
+
+	if (!image) {
+		return 00;
+	}
+	srand(1);
+	for (compno = 0; compno < FIXTURE_NUM_COMPS; ++compno) {
+		for (i = 0; i < FIXTURE_WIDTH * FIXTURE_HEIGHT; ++i) {
+			image->comps[compno].data[i] = (OPJ_INT32)((((i % FIXTURE_WIDTH) * (compno + 1) + (i / FIXTURE_WIDTH) * 2) / 3 + (OPJ_UINT32)(rand() % 16)) & 0xff);
+		}
+	}
+	return image;
+}
+
+void test_set_fixture_parameters(opj_cparameters_t *parameters)
+{
+	opj_set_default_encoder_parameters(parameters);
+	parameters->numresolution = 4;
+	parameters->tcp_numlayers = 1;
+	parameters->tcp_rates[0] = 0;
+	parameters->cp_disto_alloc = 1;
+	parameters->tcp_mct = 1;
+	parameters->tile_size_on = OPJ_TRUE;
+	parameters->cp_tdx = FIXTURE_TILE_SIZE;
+	parameters->cp_tdy = FIXTURE_TILE_SIZE;
+	parameters->prog_order = OPJ_RPCL;
+}
+
+/* -------------------------------------------------------------------------- */
+
+opj_codec_t * test_create_encoder(const char *filename)
+{
+	const char *ext = strrchr(filename, '.');
+	opj_codec_t *codec = opj_create_compress((ext && strcmp(ext, ".jp2") == 0) ? OPJ_CODEC_JP2 : OPJ_CODEC_J2K);
+
+	if (codec) {
+		opj_set_warning_handler(codec, test_warning_callback, 00);
+		opj_set_error_handler(codec, test_error_callback, 00);
+	}
+	return codec;
+}
+
+int test_encode_to_file(opj_codec_t *codec, const char *filename, opj_cparameters_t *parameters, opj_image_t *image)
+{
+	opj_stream_t *stream = opj_stream_create_default_file_stream(filename, OPJ_FALSE);
+	int ok;
+
+	ok = stream && opj_setup_encoder(codec, parameters, image)
+		&& opj_start_compress(codec, image, stream) && opj_encode(codec, stream) && opj_end_compress(codec, stream);
+	if (stream) {
+		opj_stream_destroy(stream);
+	}
+	return ok;
+}
+
+int test_encode_image(const char *filename, opj_cparameters_t *parameters, opj_image_t *image)
+{
+	opj_codec_t *codec;
+	int ok;
+
+	if (!image) {
+		return 0;
+	}
+	codec = test_create_encoder(filename);
+	ok = codec && test_encode_to_file(codec, filename, parameters, image);
+	if (codec) {
+		opj_destroy_codec(codec);
+	}
+	opj_image_destroy(image);
+	return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int test_open_decoder(const char *filename, OPJ_UINT32 reduce, const char *comps,
+                      opj_codec_t **codec, opj_stream_t **stream, opj_image_t **image)
+{
+	opj_dparameters_t parameters;
+	const char *ext = strrchr(filename, '.');
+	OPJ_UINT32 l_comps[16];
+
+	opj_set_default_decoder_parameters(&parameters);
+	parameters.cp_reduce = reduce;
+	/* comma separated list of the components to decode */
+	while (comps && *comps && parameters.cp_nb_comps < 16) {
+		char *l_end;
+		l_comps[parameters.cp_nb_comps++] = (OPJ_UINT32)strtoul(comps, &l_end, 10);
+		comps = (*l_end == ',') ? l_end + 1 : l_end;
+	}
+	parameters.cp_comps = l_comps;
+
+	*codec = opj_create_decompress((ext && strcmp(ext, ".jp2") == 0) ? OPJ_CODEC_JP2 : OPJ_CODEC_J2K);
+	opj_set_warning_handler(*codec, test_warning_callback, 00);
+	opj_set_error_handler(*codec, test_error_callback, 00);
+
+	*stream = opj_stream_create_default_file_stream(filename, 1);
+	if (!*stream) {
+		fprintf(stderr, "ERROR -> failed to create the stream from the file %s\n", filename);
+		opj_destroy_codec(*codec);
+		return 0;
+	}
+
+	if (!opj_setup_decoder(*codec, &parameters) || !opj_read_header(*stream, *codec, image)) {
+		fprintf(stderr, "ERROR -> failed to read the header of %s\n", filename);
+		opj_stream_destroy(*stream);
+		opj_destroy_codec(*codec);
+		return 0;
+	}
+
+	return 1;
+}
+
+void test_close_decoder(opj_codec_t *codec, opj_stream_t *stream, opj_image_t *image)
+{
+	opj_stream_destroy(stream);
+	opj_destroy_codec(codec);
+	opj_image_destroy(image);
+}
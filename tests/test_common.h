@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _OPJ_TEST_COMMON_H_
+#define _OPJ_TEST_COMMON_H_
+
+#include "openjpeg.h"
+
+/* Fixtures shared by the tests */
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Sample error callback expecting no client object.
+ */
+void test_error_callback(const char *msg, void *client_data);
+
+/**
+ * Sample warning callback expecting no client object.
+ */
+void test_warning_callback(const char *msg, void *client_data);
+
+/* -------------------------------------------------------------------------- */
+
+/* the tiled fixture: an RGB image of 200x150 in tiles of 64x64 */
+#define FIXTURE_NUM_COMPS 3
+#define FIXTURE_WIDTH 200
+#define FIXTURE_HEIGHT 150
+#define FIXTURE_TILE_SIZE 64
+
+/**
+ * Creates an image of unsigned components of the same size and precision,
+ * gray with one component and sRGB with more. Its samples are not set.
+ */
+opj_image_t * test_create_image(OPJ_UINT32 numcomps, OPJ_UINT32 x0, OPJ_UINT32 y0, OPJ_UINT32 w, OPJ_UINT32 h, OPJ_UINT32 prec);
+
+/**
+ * Creates the image of the tiled fixture: 8 bit gradients with some noise,
+ * the same at each call.
+ */
+opj_image_t * test_create_fixture_image(void);
+
+/**
+ * Sets the encoding parameters of the tiled fixture: 4 resolutions, one
+ * lossless layer, the MCT and tiles of 64x64 in RPCL.
+ */
+void test_set_fixture_parameters(opj_cparameters_t *parameters);
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Creates an encoder for the format of a file (JP2 for a .jp2 file, J2K
+ * otherwise) which prints its warnings and errors.
+ */
+opj_codec_t * test_create_encoder(const char *filename);
+
+/**
+ * Sets the encoder up and encodes an image into a file.
+ * opj_start_compress takes over the samples of the image.
+ */
+int test_encode_to_file(opj_codec_t *codec, const char *filename, opj_cparameters_t *parameters, opj_image_t *image);
+
+/**
+ * Encodes an image into a file with a new encoder, then destroys the image.
+ */
+int test_encode_image(const char *filename, opj_cparameters_t *parameters, opj_image_t *image);
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Creates a decoder for the format of a file which prints its warnings and
+ * errors, opens the file and reads its header. The decoder reduces the
+ * resolution by reduce levels and, when comps is not 00, decodes the
+ * components of its comma separated list only.
+ * On failure, prints an error and releases the decoder and the stream.
+ */
+int test_open_decoder(const char *filename, OPJ_UINT32 reduce, const char *comps,
+                      opj_codec_t **codec, opj_stream_t **stream, opj_image_t **image);
+
+/**
+ * Releases the stream, the decoder and the image of test_open_decoder.
+ */
+void test_close_decoder(opj_codec_t *codec, opj_stream_t *stream, opj_image_t *image);
+
+#endif /* _OPJ_TEST_COMMON_H_ */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS 3
+#define WIDTH 517
+#define HEIGHT 389
+#define TILE_SIZE 64
+/* a component precision which keeps the tiles on 32 bits */
+#define WIDE_PREC 13
+/* offset of the Ssiz field of the first component, after SOC, SIZ, Lsiz, Rsiz, the 8 sizes and Csiz */
+#define SSIZ_OFFSET 42
+
+/* noisy RGB samples: the code-blocks of the encoder overflow and the code-stream is damaged,
+ * the inverse transform of its tiles does not fit in 16 bits */
+static int encode(const char *filename)
+{
+	opj_cparameters_t parameters;
+	opj_image_t *image;
+	OPJ_UINT32 compno, i;
+
+	image = test_create_image(NUM_COMPS, 0, 0, WIDTH, HEIGHT, 8);
+	if (!image) {
+		return 0;
+	}
+	srand(4);
+	for (i = 0; i < WIDTH * HEIGHT; ++i) {
+		for (compno = 0; compno < NUM_COMPS; ++compno) {
+			image->comps[compno].data[i] = (OPJ_INT32)(((OPJ_UINT32)(rand() % 128) + (i % WIDTH % TILE_SIZE) * 2) & 0xff);
+		}
+	}
+
+	/* the settings of opj_compress -t 64,64 */
+	opj_set_default_encoder_parameters(&parameters);
+	parameters.tcp_numlayers = 1;
+	parameters.tcp_rates[0] = 0;
+	parameters.cp_disto_alloc = 1;
+	parameters.tcp_mct = 1;
+	parameters.tile_size_on = OPJ_TRUE;
+	parameters.cp_tdx = TILE_SIZE;
+	parameters.cp_tdy = TILE_SIZE;
+
+	return test_encode_image(filename, &parameters, image);
+}
+
+/* changes the precision of the components written in the SIZ marker */
+static int set_precision(const char *filename, OPJ_UINT32 prec)
+{
+	FILE *file = fopen(filename, "r+b");
+	OPJ_UINT32 compno;
+	int ok = 1;
+
+	if (!file) {
+		return 0;
+	}
+	for (compno = 0; ok && compno < NUM_COMPS; ++compno) {
+		ok = fseek(file, SSIZ_OFFSET + 3 * (long)compno, SEEK_SET) == 0 && fputc((int)(prec - 1), file) != EOF;
+	}
+	return fclose(file) == 0 && ok;
+}
+
+static opj_image_t * decode(const char *filename, OPJ_UINT32 reduce)
+{
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	opj_image_t *image = 00;
+	int ok;
+
+	opj_set_default_decoder_parameters(&parameters);
+	parameters.cp_reduce = reduce;
+	codec = opj_create_decompress(OPJ_CODEC_J2K);
+	opj_set_warning_handler(codec, test_warning_callback, 00);
+	opj_set_error_handler(codec, test_error_callback, 00);
+	stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+	ok = stream && opj_setup_decoder(codec, &parameters) && opj_read_header(stream, codec, &image)
+		&& opj_decode(codec, stream, image) && opj_end_decompress(codec, stream);
+	if (stream) {
+		opj_stream_destroy(stream);
+	}
+	opj_destroy_codec(codec);
+	if (!ok && image) {
+		opj_image_destroy(image);
+		image = 00;
+	}
+	return image;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out_file;
+	OPJ_UINT32 reduce, compno, i, nb_clamped = 0;
+	opj_image_t *image, *wide_image;
+	int ok = 1;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <file.j2k> <reduce>\n", argv[0]);
+		return 1;
+	}
+	out_file = argv[1];
+	reduce = (OPJ_UINT32)atoi(argv[2]);
+
+	if (!encode(out_file)) {
+		fprintf(stderr, "ERROR -> failed to encode %s\n", out_file);
+		return 1;
+	}
+
+	/* the 8 bit components are decoded on 16 bits */
+	image = decode(out_file, reduce);
+	if (!image) {
+		fprintf(stderr, "ERROR -> failed to decode %s\n", out_file);
+		return 1;
+	}
+
+	/* the coefficients of the 13 bit components are the same, only their DC level shift
+	 * and their range differ : they are decoded on 32 bits */
+	if (!set_precision(out_file, WIDE_PREC) || !(wide_image = decode(out_file, reduce))) {
+		fprintf(stderr, "ERROR -> failed to decode %s with %d bit components\n", out_file, WIDE_PREC);
+		opj_image_destroy(image);
+		return 1;
+	}
+
+	for (compno = 0; ok && compno < NUM_COMPS; ++compno) {
+		opj_image_comp_t *comp = &image->comps[compno], *wide_comp = &wide_image->comps[compno];
+		OPJ_INT32 shift = (1 << (WIDE_PREC - 1)) - (1 << 7);
+
+		if (comp->w != wide_comp->w || comp->h != wide_comp->h) {
+			fprintf(stderr, "ERROR -> component %d does not have the same size on 16 and 32 bits\n", compno);
+			ok = 0;
+			break;
+		}
+		for (i = 0; i < comp->w * comp->h; ++i) {
+			/* the 8 bit range lies in the 13 bit range, both values are clamped alike */
+			OPJ_INT32 value = wide_comp->data[i] - shift;
+			value = value < 0 ? 0 : (value > 255 ? 255 : value);
+			if (comp->data[i] != value) {
+				fprintf(stderr, "ERROR -> sample %d of component %d is %d on 16 bits and %d on 32 bits\n",
+					i, compno, comp->data[i], value);
+				ok = 0;
+				break;
+			}
+			if (wide_comp->data[i] < shift || wide_comp->data[i] > shift + 255) {
+				++nb_clamped;
+			}
+		}
+	}
+
+	/* the damaged code-blocks rebuild values out of the 8 bit range */
+	if (ok && nb_clamped == 0) {
+		fprintf(stderr, "ERROR -> no sample of %s goes out of the 8 bit range\n", out_file);
+		ok = 0;
+	}
+
+	opj_image_destroy(wide_image);
+	opj_image_destroy(image);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS FIXTURE_NUM_COMPS
+#define WIDTH FIXTURE_WIDTH
+#define HEIGHT FIXTURE_HEIGHT
+#define TILE_SIZE FIXTURE_TILE_SIZE
+
+/* 3 quality layers, layer-resolution-component-position progression */
+static int encode(const char *filename, int plt_on, int mct)
+{
+	opj_cparameters_t parameters;
+
+	test_set_fixture_parameters(&parameters);
+	parameters.tcp_numlayers = 3;
+	parameters.tcp_rates[0] = 40;
+	parameters.tcp_rates[1] = 10;
+	parameters.tcp_rates[2] = 0;
+	parameters.tcp_mct = (char)mct;
+	parameters.prog_order = OPJ_LRCP;
+	parameters.plt_on = plt_on ? OPJ_TRUE : OPJ_FALSE;
+	return test_encode_image(filename, &parameters, test_create_fixture_image());
+}
+
+/* decodes the whole image, with all the components when nb_comps is 0.
+ * The components are given to opj_setup_decoder, or to opj_set_decoded_components when use_api is set */
+static opj_image_t * decode_components(const char *filename, OPJ_UINT32 reduce, OPJ_UINT32 layer, OPJ_UINT32 *comps, OPJ_UINT32 nb_comps, int use_api)
+{
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	opj_image_t *image = 00;
+	int ok;
+
+	opj_set_default_decoder_parameters(&parameters);
+	parameters.cp_reduce = reduce;
+	parameters.cp_layer = layer;
+	if (!use_api) {
+		parameters.cp_comps = comps;
+		parameters.cp_nb_comps = nb_comps;
+	}
+	codec = opj_create_decompress(OPJ_CODEC_J2K);
+	opj_set_warning_handler(codec, test_warning_callback, 00);
+	opj_set_error_handler(codec, test_error_callback, 00);
+	stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+	ok = stream && opj_setup_decoder(codec, &parameters) && opj_read_header(stream, codec, &image)
+		&& (!use_api || opj_set_decoded_components(codec, nb_comps, comps))
+		&& opj_decode(codec, stream, image) && opj_end_decompress(codec, stream);
+	if (stream) {
+		opj_stream_destroy(stream);
+	}
+	opj_destroy_codec(codec);
+	if (!ok) {
+		opj_image_destroy(image);
+		return 00;
+	}
+	return image;
+}
+
+static opj_image_t * decode(const char *filename, OPJ_UINT32 reduce, OPJ_UINT32 layer, OPJ_UINT32 *comps, OPJ_UINT32 nb_comps)
+{
+	return decode_components(filename, reduce, layer, comps, nb_comps, 0);
+}
+
+/* compares two components */
+static int same_comp(const opj_image_comp_t *comp, const opj_image_comp_t *ref)
+{
+	OPJ_UINT32 i;
+
+	if (comp->w != ref->w || comp->h != ref->h || comp->prec != ref->prec) {
+		return 0;
+	}
+	for (i = 0; i < comp->w * comp->h; ++i) {
+		if (comp->data[i] != ref->data[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* the packets skipped with the PLT markers give the same image as when their headers are read */
+static int check_plt_skipping(const char *plt_file, const char *file, OPJ_UINT32 reduce, OPJ_UINT32 layer, OPJ_UINT32 *comps, OPJ_UINT32 nb_comps)
+{
+	opj_image_t *image = decode(plt_file, reduce, layer, comps, nb_comps);
+	opj_image_t *ref = decode(file, reduce, layer, comps, nb_comps);
+	OPJ_UINT32 compno;
+	int ok = image && ref && image->numcomps == ref->numcomps;
+
+	for (compno = 0; ok && compno < image->numcomps; ++compno) {
+		ok = same_comp(&image->comps[compno], &ref->comps[compno]);
+	}
+	if (!ok) {
+		fprintf(stderr, "ERROR -> the image decoded with PLT markers differs (reduce %d, layer %d, %d components)\n", reduce, layer, nb_comps);
+	}
+	opj_image_destroy(image);
+	opj_image_destroy(ref);
+	return ok;
+}
+
+/* decodes a subset of the components and compares it with the decoding of all of them.
+ * The decoded image only holds the subset, in the order of the codestream. */
+static int check_components(const char *filename, OPJ_UINT32 reduce, OPJ_UINT32 *comps, OPJ_UINT32 nb_comps, int same_decoded, int use_api)
+{
+	opj_image_t *image = decode_components(filename, reduce, 0, comps, nb_comps, use_api);
+	opj_image_t *ref = decode(filename, reduce, 0, 00, 0);
+	OPJ_UINT32 compno, i, nb_decoded = 0;
+	int ok = image && ref;
+
+	for (compno = 0; ok && compno < NUM_COMPS; ++compno) {
+		int decoded = 0;
+		for (i = 0; i < nb_comps; ++i) {
+			decoded |= (comps[i] == compno);
+		}
+		if (!decoded) {
+			continue;
+		}
+		ok = nb_decoded < image->numcomps && (!same_decoded || same_comp(&image->comps[nb_decoded], &ref->comps[compno]));
+		++nb_decoded;
+	}
+	ok = ok && nb_decoded == image->numcomps;
+	if (!ok) {
+		fprintf(stderr, "ERROR -> wrong decoding of %d components of %s (reduce %d)\n", nb_comps, filename, reduce);
+	}
+	opj_image_destroy(image);
+	opj_image_destroy(ref);
+	return ok;
+}
+
+/* decodes a subset of the components into a grey + alpha buffer */
+static int check_buffer(const char *filename, OPJ_UINT32 *comps, OPJ_UINT32 nb_comps)
+{
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	opj_image_t *image = 00;
+	opj_image_t *ref = decode(filename, 0, 0, comps, nb_comps);
+	OPJ_BYTE *buffer = (OPJ_BYTE *)malloc(WIDTH * HEIGHT * 4);
+	OPJ_UINT32 i, c;
+	int ok;
+
+	opj_set_default_decoder_parameters(&parameters);
+	codec = opj_create_decompress(OPJ_CODEC_J2K);
+	opj_set_warning_handler(codec, test_warning_callback, 00);
+	opj_set_error_handler(codec, test_error_callback, 00);
+	stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+	ok = ref && ref->numcomps == 2 && buffer && stream && opj_setup_decoder(codec, &parameters) && opj_read_header(stream, codec, &image)
+		&& opj_set_decoded_components(codec, nb_comps, comps)
+		&& opj_decode_to_buffer(codec, stream, image, buffer, WIDTH * 4, OPJ_PF_RGBA8)
+		&& opj_end_decompress(codec, stream) && image->numcomps == 2;
+	for (i = 0; ok && i < WIDTH * HEIGHT; ++i) {
+		for (c = 0; c < 4; ++c) {
+			/* the first component is replicated into the RGB channels, the second one is the alpha */
+			ok = ok && buffer[i * 4 + c] == (OPJ_BYTE)ref->comps[c == 3 ? 1 : 0].data[i];
+		}
+	}
+	if (!ok) {
+		fprintf(stderr, "ERROR -> wrong buffer decoding of %d components of %s\n", nb_comps, filename);
+	}
+	if (stream) {
+		opj_stream_destroy(stream);
+	}
+	opj_destroy_codec(codec);
+	opj_image_destroy(image);
+	opj_image_destroy(ref);
+	free(buffer);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	char plt_file[256], file[256], rgb_file[256];
+	OPJ_UINT32 luminance[] = { 0 };
+	OPJ_UINT32 chroma[] = { 2, 1 };
+	OPJ_UINT32 all[] = { 0, 1, 2 };
+	OPJ_UINT32 duplicated[] = { 2, 0, 2 };
+	OPJ_UINT32 invalid[] = { 1, NUM_COMPS };
+	opj_image_t *image;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <prefix of the files>\n", argv[0]);
+		return 1;
+	}
+	sprintf(plt_file, "%s_plt.j2k", argv[1]);
+	sprintf(file, "%s.j2k", argv[1]);
+	sprintf(rgb_file, "%s_rgb.j2k", argv[1]);
+
+	if (!encode(plt_file, 1, 1) || !encode(file, 0, 1) || !encode(rgb_file, 1, 0)) {
+		fprintf(stderr, "ERROR -> failed to encode the test images\n");
+		return 1;
+	}
+
+	/* skipped layers, resolutions and components */
+	if (!check_plt_skipping(plt_file, file, 0, 0, 00, 0) || !check_plt_skipping(plt_file, file, 0, 1, 00, 0)
+			|| !check_plt_skipping(plt_file, file, 1, 2, 00, 0) || !check_plt_skipping(plt_file, file, 2, 0, luminance, 1)
+			|| !check_plt_skipping(plt_file, file, 0, 1, chroma, 2)) {
+		return 1;
+	}
+
+	/* without MCT the decoded components do not depend on the others */
+	if (!check_components(rgb_file, 0, chroma, 2, 1, 0) || !check_components(rgb_file, 1, luminance, 1, 1, 0)
+			|| !check_components(rgb_file, 0, chroma, 2, 1, 1) || !check_components(file, 1, duplicated, 3, 0, 1)) {
+		return 1;
+	}
+	/* with it, they are all needed to give the same image, else the luminance is left untransformed */
+	if (!check_components(plt_file, 0, all, 3, 1, 0) || !check_components(plt_file, 0, luminance, 1, 0, 0)
+			|| !check_components(plt_file, 0, all, 3, 1, 1)) {
+		return 1;
+	}
+
+	/* the interleaved buffer takes its channels from the decoded components */
+	if (!check_buffer(rgb_file, chroma, 2)) {
+		return 1;
+	}
+
+	/* the components are checked against the main header */
+	image = decode(file, 0, 0, invalid, 2);
+	if (!image) {
+		image = decode_components(file, 0, 0, invalid, 2, 1);
+	}
+	if (image) {
+		fprintf(stderr, "ERROR -> component %d decoded in an image of %d components\n", NUM_COMPS, NUM_COMPS);
+		opj_image_destroy(image);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+/* compares the strips with the planes decoded by opj_decode */
+typedef struct strip_check {
+	const opj_image_t *ref;
+	OPJ_UINT32 next_row;
+	int failed;
+} strip_check_t;
+
+static OPJ_BOOL check_strip(opj_image_t *image, OPJ_UINT32 y, OPJ_UINT32 nb_rows, OPJ_INT32 **comps_data, void *user_data)
+{
+	strip_check_t *check = (strip_check_t *) user_data;
+	OPJ_UINT32 compno, i, j;
+
+	if (y != check->next_row || y + nb_rows > image->comps[0].h) {
+		fprintf(stderr, "ERROR -> unexpected strip of %d rows at row %d\n", nb_rows, y);
+		check->failed = 1;
+		return OPJ_FALSE;
+	}
+
+	for (compno = 0; compno < image->numcomps; ++compno) {
+		const opj_image_comp_t *ref = &check->ref->comps[compno];
+		for (j = 0; j < nb_rows; ++j) {
+			for (i = 0; i < image->comps[compno].w; ++i) {
+				OPJ_INT32 value = comps_data[compno][j * image->comps[compno].w + i];
+				OPJ_INT32 expected = ref->data[(y + j) * ref->w + i];
+				if (value != expected) {
+					fprintf(stderr, "ERROR -> sample (%d,%d) of component %d is %d, expected %d\n",
+					        i, y + j, compno, value, expected);
+					check->failed = 1;
+					return OPJ_FALSE;
+				}
+			}
+		}
+	}
+
+	check->next_row = y + nb_rows;
+	return OPJ_TRUE;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	opj_codec_t *l_codec = NULL;
+	opj_stream_t *l_stream = NULL;
+	opj_image_t *l_ref = NULL, *l_image = NULL;
+	OPJ_UINT32 l_reduce = 0, l_strip_height, c;
+	const char *l_comps = NULL;
+	strip_check_t l_check;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <input_file> <strip_height> [reduce] [components]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	l_strip_height = (OPJ_UINT32)atoi(argv[2]);
+	if (argc > 3)
+		l_reduce = (OPJ_UINT32)atoi(argv[3]);
+	if (argc > 4)
+		l_comps = argv[4];
+
+	/* Reference decode into component planes */
+	if (!test_open_decoder(argv[1], l_reduce, l_comps, &l_codec, &l_stream, &l_ref))
+		return EXIT_FAILURE;
+	if (!opj_decode(l_codec, l_stream, l_ref) || !opj_end_decompress(l_codec, l_stream)) {
+		fprintf(stderr, "ERROR -> failed to decode %s\n", argv[1]);
+		test_close_decoder(l_codec, l_stream, l_ref);
+		return EXIT_FAILURE;
+	}
+	opj_stream_destroy(l_stream);
+	opj_destroy_codec(l_codec);
+
+	/* Decode by strips, checking each of them */
+	if (!test_open_decoder(argv[1], l_reduce, l_comps, &l_codec, &l_stream, &l_image)) {
+		opj_image_destroy(l_ref);
+		return EXIT_FAILURE;
+	}
+	l_check.ref = l_ref;
+	l_check.next_row = 0;
+	l_check.failed = 0;
+	if (!opj_decode_strips(l_codec, l_stream, l_image, l_strip_height, check_strip, &l_check)
+			|| !opj_end_decompress(l_codec, l_stream) || l_check.failed) {
+		fprintf(stderr, "ERROR -> failed to decode %s by strips\n", argv[1]);
+		test_close_decoder(l_codec, l_stream, l_image);
+		opj_image_destroy(l_ref);
+		return EXIT_FAILURE;
+	}
+
+	if (l_check.next_row != l_ref->comps[0].h) {
+		fprintf(stderr, "ERROR -> %d rows decoded by strips, expected %d\n", l_check.next_row, l_ref->comps[0].h);
+		test_close_decoder(l_codec, l_stream, l_image);
+		opj_image_destroy(l_ref);
+		return EXIT_FAILURE;
+	}
+
+	for (c = 0; c < l_image->numcomps; ++c) {
+		if (l_image->comps[c].data != NULL) {
+			fprintf(stderr, "ERROR -> component %d has been allocated\n", c);
+			test_close_decoder(l_codec, l_stream, l_image);
+			opj_image_destroy(l_ref);
+			return EXIT_FAILURE;
+		}
+	}
+
+	fprintf(stdout, "%s decoded by strips of %d rows successfully\n", argv[1], l_strip_height);
+
+	test_close_decoder(l_codec, l_stream, l_image);
+	opj_image_destroy(l_ref);
+
+	return EXIT_SUCCESS;
+}
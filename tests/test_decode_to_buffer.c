@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+/* expected value of a buffer sample, following the mapping documented in opj_decode_to_buffer */
+static OPJ_UINT32 expected_sample(const opj_image_t *image, OPJ_UINT32 channel, OPJ_UINT32 index, OPJ_UINT32 depth)
+{
+	const opj_image_comp_t *comp;
+	OPJ_UINT32 compno, value;
+
+	if (channel < 3) {
+		compno = (image->numcomps >= 3) ? channel : 0;
+	}
+	else if (image->numcomps == 2 || image->numcomps >= 4) {
+		compno = (image->numcomps == 2) ? 1 : 3;
+	}
+	else {
+		return (1u << depth) - 1;
+	}
+
+	comp = &image->comps[compno];
+	value = (OPJ_UINT32)(comp->data[index] + (comp->sgnd ? (1 << (comp->prec - 1)) : 0));
+	if (comp->prec > depth)
+		return value >> (comp->prec - depth);
+	return value << (depth - comp->prec);
+}
+
+/* -------------------------------------------------------------------------- */
+
+#define PCLR_NB_ENTRIES 200
+#define PCLR_NB_CHANNELS 3
+
+static void write_box_header(FILE *file, OPJ_UINT32 length, const char *type)
+{
+	fputc((int)(length >> 24), file);
+	fputc((int)((length >> 16) & 0xff), file);
+	fputc((int)((length >> 8) & 0xff), file);
+	fputc((int)(length & 0xff), file);
+	fwrite(type, 1, 4, file);
+}
+
+static void write_value(FILE *file, OPJ_UINT32 value, OPJ_UINT32 nb_bytes)
+{
+	while (nb_bytes--) {
+		fputc((int)((value >> (8 * nb_bytes)) & 0xff), file);
+	}
+}
+
+/* wraps the codestream of a single component in a JP2 file whose palette has channels of 8, 5
+ * and 12 bits, with less entries than the indices so that they are clamped */
+static int make_pclr_file(const char *j2k_filename, const char *jp2_filename)
+{
+	static const OPJ_UINT32 precisions[PCLR_NB_CHANNELS] = { 8, 5, 12 };
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	opj_image_t *image;
+	FILE *in, *out;
+	long size;
+	OPJ_BYTE *codestream;
+	OPJ_UINT32 width, height, pclr_length, i, c;
+
+	if (!test_open_decoder(j2k_filename, 0, 00, &codec, &stream, &image))
+		return 0;
+	width = image->x1 - image->x0;
+	height = image->y1 - image->y0;
+	if (image->numcomps != 1 || image->comps[0].prec != 8) {
+		fprintf(stderr, "ERROR -> %s must have a single 8 bit component\n", j2k_filename);
+		test_close_decoder(codec, stream, image);
+		return 0;
+	}
+	test_close_decoder(codec, stream, image);
+
+	in = fopen(j2k_filename, "rb");
+	if (!in)
+		return 0;
+	fseek(in, 0, SEEK_END);
+	size = ftell(in);
+	fseek(in, 0, SEEK_SET);
+	codestream = (OPJ_BYTE*) malloc((size_t)size);
+	if (!codestream || fread(codestream, 1, (size_t)size, in) != (size_t)size) {
+		free(codestream);
+		fclose(in);
+		return 0;
+	}
+	fclose(in);
+
+	out = fopen(jp2_filename, "wb");
+	if (!out) {
+		free(codestream);
+		return 0;
+	}
+	/* signature and file type */
+	write_box_header(out, 12, "jP  ");
+	write_value(out, 0x0d0a870a, 4);
+	write_box_header(out, 20, "ftyp");
+	fwrite("jp2 ", 1, 4, out);
+	write_value(out, 0, 4);
+	fwrite("jp2 ", 1, 4, out);
+
+	/* header : image, colour, palette and component mapping */
+	pclr_length = 8 + 3 + PCLR_NB_CHANNELS + PCLR_NB_ENTRIES * (1 + 1 + 2);
+	write_box_header(out, 8 + 22 + 15 + pclr_length + 8 + 4 * PCLR_NB_CHANNELS, "jp2h");
+	write_box_header(out, 22, "ihdr");
+	write_value(out, height, 4);
+	write_value(out, width, 4);
+	write_value(out, 1, 2);
+	write_value(out, 7, 1);
+	write_value(out, 7, 1);
+	write_value(out, 0, 2);
+	write_box_header(out, 15, "colr");
+	write_value(out, 1, 3);
+	write_value(out, 16, 4);
+	write_box_header(out, pclr_length, "pclr");
+	write_value(out, PCLR_NB_ENTRIES, 2);
+	write_value(out, PCLR_NB_CHANNELS, 1);
+	for (c = 0; c < PCLR_NB_CHANNELS; ++c) {
+		write_value(out, precisions[c] - 1, 1);
+	}
+	for (i = 0; i < PCLR_NB_ENTRIES; ++i) {
+		for (c = 0; c < PCLR_NB_CHANNELS; ++c) {
+			write_value(out, (i * (c * 37 + 11) + c) & ((1u << precisions[c]) - 1), (precisions[c] + 7) / 8);
+		}
+	}
+	write_box_header(out, 8 + 4 * PCLR_NB_CHANNELS, "cmap");
+	for (c = 0; c < PCLR_NB_CHANNELS; ++c) {
+		write_value(out, 0, 2);
+		write_value(out, 1, 1);
+		write_value(out, c, 1);
+	}
+
+	write_box_header(out, 8 + (OPJ_UINT32)size, "jp2c");
+	fwrite(codestream, 1, (size_t)size, out);
+	free(codestream);
+
+	return fclose(out) == 0;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	static const char *formats[] = { "gray8", "rgb8", "rgba8", "gray16", "rgb16", "rgba16" };
+	static const OPJ_UINT32 channels[] = { 1, 3, 4, 1, 3, 4 };
+	opj_codec_t *l_codec = NULL;
+	opj_stream_t *l_stream = NULL;
+	opj_image_t *l_ref = NULL, *l_image = NULL;
+	OPJ_PIXEL_FORMAT l_format;
+	OPJ_UINT32 l_reduce = 0, l_nb_channels, l_depth, l_stride, i, j, c;
+	OPJ_BYTE *l_buffer;
+	int l_fmt = -1;
+	char l_pclr_filename[256];
+	const char *l_filename;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <input_file> <gray8|rgb8|rgba8|gray16|rgb16|rgba16> [reduce] [pclr]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < sizeof(formats) / sizeof(*formats); ++i) {
+		if (strcmp(argv[2], formats[i]) == 0)
+			l_fmt = (int)i;
+	}
+	if (l_fmt < 0) {
+		fprintf(stderr, "Unknown output format %s\n", argv[2]);
+		return EXIT_FAILURE;
+	}
+	if (argc > 3)
+		l_reduce = (OPJ_UINT32)atoi(argv[3]);
+
+	/* a palette image is made from the codestream of a single component */
+	l_filename = argv[1];
+	if (argc > 4 && strcmp(argv[4], "pclr") == 0) {
+		sprintf(l_pclr_filename, "%.200s_pclr.jp2", argv[1]);
+		if (!make_pclr_file(argv[1], l_pclr_filename)) {
+			fprintf(stderr, "ERROR -> failed to write %s\n", l_pclr_filename);
+			return EXIT_FAILURE;
+		}
+		l_filename = l_pclr_filename;
+	}
+
+	l_format = (OPJ_PIXEL_FORMAT)l_fmt;
+	l_nb_channels = channels[l_fmt];
+	l_depth = (l_format >= OPJ_PF_GRAY16) ? 16 : 8;
+
+	/* Reference decode into component planes */
+	if (!test_open_decoder(l_filename, l_reduce, 00, &l_codec, &l_stream, &l_ref))
+		return EXIT_FAILURE;
+	if (!opj_decode(l_codec, l_stream, l_ref) || !opj_end_decompress(l_codec, l_stream)) {
+		fprintf(stderr, "ERROR -> failed to decode %s\n", l_filename);
+		test_close_decoder(l_codec, l_stream, l_ref);
+		return EXIT_FAILURE;
+	}
+	opj_stream_destroy(l_stream);
+	opj_destroy_codec(l_codec);
+
+	/* Decode into an interleaved buffer with some padding at the end of the lines */
+	if (!test_open_decoder(l_filename, l_reduce, 00, &l_codec, &l_stream, &l_image)) {
+		opj_image_destroy(l_ref);
+		return EXIT_FAILURE;
+	}
+	l_stride = l_image->comps[0].w * l_nb_channels * (l_depth / 8) + 16;
+	l_buffer = (OPJ_BYTE*) malloc((size_t)l_stride * l_image->comps[0].h);
+	if (!l_buffer) {
+		test_close_decoder(l_codec, l_stream, l_image);
+		opj_image_destroy(l_ref);
+		return EXIT_FAILURE;
+	}
+	if (!opj_decode_to_buffer(l_codec, l_stream, l_image, l_buffer, l_stride, l_format)
+			|| !opj_end_decompress(l_codec, l_stream)) {
+		fprintf(stderr, "ERROR -> failed to decode %s into a buffer\n", l_filename);
+		free(l_buffer);
+		test_close_decoder(l_codec, l_stream, l_image);
+		opj_image_destroy(l_ref);
+		return EXIT_FAILURE;
+	}
+
+	for (c = 0; c < l_image->numcomps; ++c) {
+		if (l_image->comps[c].data != NULL) {
+			fprintf(stderr, "ERROR -> component %d has been allocated\n", c);
+			free(l_buffer);
+			test_close_decoder(l_codec, l_stream, l_image);
+			opj_image_destroy(l_ref);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (j = 0; j < l_ref->comps[0].h; ++j) {
+		const OPJ_BYTE *l_line = l_buffer + (size_t)j * l_stride;
+		for (i = 0; i < l_ref->comps[0].w; ++i) {
+			for (c = 0; c < l_nb_channels; ++c) {
+				OPJ_UINT32 l_expected = expected_sample(l_ref, c, j * l_ref->comps[0].w + i, l_depth);
+				OPJ_UINT32 l_value = (l_depth == 8) ? l_line[i * l_nb_channels + c]
+				                                    : ((const OPJ_UINT16*)l_line)[i * l_nb_channels + c];
+				if (l_value != l_expected) {
+					fprintf(stderr, "ERROR -> sample (%d,%d) channel %d is %d, expected %d\n",
+					        i, j, c, l_value, l_expected);
+					free(l_buffer);
+					test_close_decoder(l_codec, l_stream, l_image);
+					opj_image_destroy(l_ref);
+					return EXIT_FAILURE;
+				}
+			}
+		}
+	}
+
+	fprintf(stdout, "%s decoded into %s buffer successfully\n", l_filename, argv[2]);
+
+	free(l_buffer);
+	test_close_decoder(l_codec, l_stream, l_image);
+	opj_image_destroy(l_ref);
+
+	return EXIT_SUCCESS;
+}
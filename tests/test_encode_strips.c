@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS_MAX 4
+
+static void set_parameters(opj_cparameters_t *parameters, int irreversible, OPJ_UINT32 num_comps)
+{
+	opj_set_default_encoder_parameters(parameters);
+	parameters->irreversible = irreversible;
+	parameters->numresolution = 5;
+	parameters->tcp_mct = (char)(num_comps >= 3);
+	parameters->cblockw_init = 32;
+	parameters->cblockh_init = 16;
+	/* two layers sized by the rate allocation */
+	parameters->tcp_numlayers = 2;
+	parameters->tcp_rates[0] = 40;
+	parameters->tcp_rates[1] = irreversible ? 10 : 0;
+	parameters->cp_disto_alloc = 1;
+}
+
+/* an image without samples, as the strips are pushed by the caller */
+static opj_image_t * create_tile_image(OPJ_UINT32 num_comps, OPJ_UINT32 x0, OPJ_UINT32 y0, OPJ_UINT32 w, OPJ_UINT32 h)
+{
+	opj_image_cmptparm_t params[NUM_COMPS_MAX];
+	opj_image_t *image;
+	OPJ_UINT32 i;
+
+	memset(params, 0, sizeof(params));
+	for (i = 0; i < num_comps; ++i) {
+		params[i].dx = 1;
+		params[i].dy = 1;
+		params[i].w = w;
+		params[i].h = h;
+		params[i].x0 = x0;
+		params[i].y0 = y0;
+		params[i].prec = 8;
+		params[i].sgnd = 0;
+	}
+
+	image = opj_image_tile_create(num_comps, params, num_comps == 1 ? OPJ_CLRSPC_GRAY : OPJ_CLRSPC_SRGB);
+	if (image) {
+		image->x0 = x0;
+		image->y0 = y0;
+		image->x1 = x0 + w;
+		image->y1 = y0 + h;
+	}
+	return image;
+}
+
+static long read_file(const char *filename, unsigned char **data)
+{
+	FILE *f = fopen(filename, "rb");
+	long size;
+
+	*data = 00;
+	if (!f) {
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	*data = (unsigned char *) malloc((size_t)size + 1);
+	if (!*data || fread(*data, 1, (size_t)size, f) != (size_t)size) {
+		size = -1;
+	}
+	fclose(f);
+	return size;
+}
+
+int main(int argc, char *argv[])
+{
+	OPJ_UINT32 num_comps, x0, y0, w, h, strip_height, compno, i, j, y;
+	int irreversible;
+	char ref_file[256];
+	const char *out_file;
+	OPJ_INT32 *samples[NUM_COMPS_MAX];
+	OPJ_INT32 *rows[NUM_COMPS_MAX];
+	opj_cparameters_t parameters;
+	opj_image_t *image;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	unsigned char *ref_data, *out_data;
+	long ref_size, out_size;
+	int ok;
+
+	if (argc != 9) {
+		fprintf(stderr, "Usage: %s <num_comps> <x0> <y0> <width> <height> <irreversible> <strip_height> <file.j2k|file.jp2>\n", argv[0]);
+		return 1;
+	}
+	num_comps = (OPJ_UINT32)atoi(argv[1]);
+	x0 = (OPJ_UINT32)atoi(argv[2]);
+	y0 = (OPJ_UINT32)atoi(argv[3]);
+	w = (OPJ_UINT32)atoi(argv[4]);
+	h = (OPJ_UINT32)atoi(argv[5]);
+	irreversible = atoi(argv[6]);
+	strip_height = (OPJ_UINT32)atoi(argv[7]);
+	out_file = argv[8];
+	if (num_comps == 0 || num_comps > NUM_COMPS_MAX || strip_height == 0 || strlen(out_file) + 5 > sizeof(ref_file)) {
+		return 1;
+	}
+	sprintf(ref_file, "ref_%s", out_file);
+
+	/* smooth ramps with some noise, so that the code-blocks have a few passes */
+	srand(1);
+	for (compno = 0; compno < num_comps; ++compno) {
+		samples[compno] = (OPJ_INT32 *) malloc((size_t)w * h * sizeof(OPJ_INT32));
+		if (!samples[compno]) {
+			return 1;
+		}
+		for (j = 0; j < h; ++j) {
+			for (i = 0; i < w; ++i) {
+				samples[compno][j * w + i] = (OPJ_INT32)(((i * (compno + 1) + j * 2) / 3 + (OPJ_UINT32)(rand() % 16)) & 0xff);
+			}
+		}
+	}
+
+	/* reference : the whole image at once */
+	image = test_create_image(num_comps, x0, y0, w, h, 8);
+	if (!image) {
+		return 1;
+	}
+	for (compno = 0; compno < num_comps; ++compno) {
+		memcpy(image->comps[compno].data, samples[compno], (size_t)w * h * sizeof(OPJ_INT32));
+	}
+	set_parameters(&parameters, irreversible, num_comps);
+	if (!test_encode_image(ref_file, &parameters, image)) {
+		fprintf(stderr, "ERROR -> failed to encode %s\n", ref_file);
+		return 1;
+	}
+
+	/* the same image pushed by strips */
+	image = create_tile_image(num_comps, x0, y0, w, h);
+	if (!image) {
+		return 1;
+	}
+	codec = test_create_encoder(out_file);
+	stream = opj_stream_create_default_file_stream(out_file, OPJ_FALSE);
+	if (!codec || !stream || !opj_setup_encoder(codec, &parameters, image)) {
+		return 1;
+	}
+	ok = opj_start_compress(codec, image, stream);
+	for (y = 0; ok && y < h; y += strip_height) {
+		OPJ_UINT32 nb_rows = (h - y < strip_height) ? h - y : strip_height;
+		for (compno = 0; compno < num_comps; ++compno) {
+			rows[compno] = samples[compno] + (size_t)y * w;
+		}
+		ok = opj_write_strip(codec, rows, nb_rows, stream);
+	}
+	/* rows beyond the image are refused */
+	if (ok && opj_write_strip(codec, rows, 1, stream)) {
+		fprintf(stderr, "ERROR -> an extra row was accepted\n");
+		ok = 0;
+	}
+	ok = ok && opj_end_compress(codec, stream);
+	opj_stream_destroy(stream);
+	opj_destroy_codec(codec);
+	opj_image_destroy(image);
+	if (!ok) {
+		fprintf(stderr, "ERROR -> failed to encode %s by strips\n", out_file);
+		return 1;
+	}
+
+	for (compno = 0; compno < num_comps; ++compno) {
+		free(samples[compno]);
+	}
+
+	ref_size = read_file(ref_file, &ref_data);
+	out_size = read_file(out_file, &out_data);
+	ok = ref_size > 0 && ref_size == out_size && memcmp(ref_data, out_data, (size_t)ref_size) == 0;
+	free(ref_data);
+	free(out_data);
+	if (!ok) {
+		fprintf(stderr, "ERROR -> %s (%ld bytes) differs from %s (%ld bytes)\n", out_file, out_size, ref_file, ref_size);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+static int nb_warnings = 0;
+
+/**
+sample warning callback counting the warnings
+*/
+static void warning_callback(const char *msg, void *client_data) {
+	(void)client_data;
+	fprintf(stdout, "[WARNING] %s", msg);
+	++nb_warnings;
+}
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS FIXTURE_NUM_COMPS
+#define WIDTH FIXTURE_WIDTH
+#define HEIGHT FIXTURE_HEIGHT
+#define TILE_SIZE FIXTURE_TILE_SIZE
+#define NUM_TILES (((WIDTH + TILE_SIZE - 1) / TILE_SIZE) * ((HEIGHT + TILE_SIZE - 1) / TILE_SIZE))
+#define STAMP 1234567890123ULL
+
+/* tiles of 64x64, one tile-part per resolution, without TLM marker */
+static int encode(const char *filename, int plt_on)
+{
+	opj_cparameters_t parameters;
+
+	test_set_fixture_parameters(&parameters);
+	parameters.tp_on = 1;
+	parameters.tp_flag = 'R';
+	parameters.plt_on = plt_on ? OPJ_TRUE : OPJ_FALSE;
+	return test_encode_image(filename, &parameters, test_create_fixture_image());
+}
+
+/* opens the codestream, with the index file when given */
+static opj_codec_t * create_decoder(const char *filename, const char *index_file, OPJ_UINT64 stamp, int *index_loaded,
+									opj_stream_t **stream, opj_image_t **image)
+{
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+
+	opj_set_default_decoder_parameters(&parameters);
+	codec = opj_create_decompress(OPJ_CODEC_J2K);
+	opj_set_warning_handler(codec, warning_callback, 00);
+	opj_set_error_handler(codec, test_error_callback, 00);
+	*image = 00;
+	if (index_file) {
+		opj_stream_t *index_stream = opj_stream_create_default_file_stream(index_file, OPJ_TRUE);
+		*index_loaded = index_stream && opj_load_cstr_index(codec, index_stream, stamp);
+		if (index_stream) {
+			opj_stream_destroy(index_stream);
+		}
+	}
+	*stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+	if (!*stream || !opj_setup_decoder(codec, &parameters) || !opj_read_header(*stream, codec, image)) {
+		if (*stream) {
+			opj_stream_destroy(*stream);
+		}
+		opj_destroy_codec(codec);
+		return 00;
+	}
+	return codec;
+}
+
+/* number of tile-parts known right after the main header */
+static OPJ_UINT32 get_nb_indexed_tile_parts(opj_codec_t *codec)
+{
+	opj_codestream_index_t *cstr_index = opj_get_cstr_index(codec);
+	OPJ_UINT32 i, nb_tps = 0;
+
+	for (i = 0; i < cstr_index->nb_of_tiles; ++i) {
+		nb_tps += cstr_index->tile_index[i].nb_tps;
+	}
+	opj_destroy_cstr_index(&cstr_index);
+	return nb_tps;
+}
+
+/* decodes the tiles in reverse order and compares them with the reference */
+static int check_tiles(opj_codec_t *codec, opj_stream_t *stream, opj_image_t *image, opj_image_t *ref_image)
+{
+	OPJ_UINT32 i, compno;
+
+	for (i = NUM_TILES; i-- > 0;) {
+		if (!opj_get_decoded_tile(codec, stream, image, i)) {
+			fprintf(stderr, "ERROR -> failed to decode tile %d\n", i);
+			return 0;
+		}
+		for (compno = 0; compno < NUM_COMPS; ++compno) {
+			opj_image_comp_t *comp = &image->comps[compno];
+			OPJ_UINT32 x, y;
+			for (y = 0; y < comp->h; ++y) {
+				for (x = 0; x < comp->w; ++x) {
+					if (comp->data[y * comp->w + x] != ref_image->comps[compno].data[(comp->y0 + y) * WIDTH + comp->x0 + x]) {
+						fprintf(stderr, "ERROR -> tile %d differs from the reference at (%d,%d)\n", i, comp->x0 + x, comp->y0 + y);
+						return 0;
+					}
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *in_file;
+	char index_file[256], other_file[256];
+	int ok, plt_on, index_loaded = 0;
+	OPJ_UINT32 k, nb_tps;
+	opj_codec_t *codec;
+	opj_stream_t *stream, *index_stream;
+	opj_image_t *ref_image, *image;
+	opj_codestream_index_t *ref_index, *cstr_index;
+	FILE *f;
+	unsigned char *data, *com;
+	long size;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <file.j2k> <with PLT markers>\n", argv[0]);
+		return 1;
+	}
+	in_file = argv[1];
+	plt_on = atoi(argv[2]);
+	if (strlen(in_file) + 7 > sizeof(index_file)) {
+		return 1;
+	}
+	sprintf(index_file, "%s.index", in_file);
+	sprintf(other_file, "other_%s", in_file);
+
+	if (!encode(in_file, plt_on)) {
+		fprintf(stderr, "ERROR -> failed to encode %s\n", in_file);
+		return 1;
+	}
+
+	/* reference : the whole image, read sequentially, and its index file */
+	codec = create_decoder(in_file, 00, 0, &index_loaded, &stream, &ref_image);
+	if (!codec) {
+		return 1;
+	}
+	if (get_nb_indexed_tile_parts(codec) != 0) {
+		fprintf(stderr, "ERROR -> tile-parts indexed without TLM marker\n");
+		return 1;
+	}
+	ok = opj_decode(codec, stream, ref_image) && opj_end_decompress(codec, stream);
+	opj_stream_destroy(stream);
+	index_stream = opj_stream_create_default_file_stream(index_file, OPJ_FALSE);
+	ok = ok && index_stream && opj_save_cstr_index(codec, index_stream, STAMP);
+	if (index_stream) {
+		opj_stream_destroy(index_stream);
+	}
+	ref_index = opj_get_cstr_index(codec);
+	opj_destroy_codec(codec);
+	if (!ok) {
+		fprintf(stderr, "ERROR -> failed to decode %s and save its index\n", in_file);
+		return 1;
+	}
+
+	/* with the index file, the tile-parts are known from the main header on */
+	nb_warnings = 0;
+	codec = create_decoder(in_file, index_file, STAMP, &index_loaded, &stream, &image);
+	if (!codec || !index_loaded) {
+		fprintf(stderr, "ERROR -> failed to load %s\n", index_file);
+		return 1;
+	}
+	cstr_index = opj_get_cstr_index(codec);
+	for (k = 0; ok && k < NUM_TILES; ++k) {
+		opj_tile_index_t *tile_index = &cstr_index->tile_index[k];
+		opj_tile_index_t *ref_tile_index = &ref_index->tile_index[k];
+		OPJ_UINT32 i;
+		if (tile_index->nb_tps != ref_tile_index->nb_tps) {
+			fprintf(stderr, "ERROR -> tile-parts of tile %d are not indexed\n", k);
+			ok = 0;
+			break;
+		}
+		for (i = 0; i < tile_index->nb_tps; ++i) {
+			if (tile_index->tp_index[i].start_pos != ref_tile_index->tp_index[i].start_pos
+				|| tile_index->tp_index[i].end_pos != ref_tile_index->tp_index[i].end_pos
+				|| tile_index->tp_index[i].nb_packets != ref_tile_index->tp_index[i].nb_packets) {
+				fprintf(stderr, "ERROR -> tile-part %d of tile %d differs from the index file\n", i, k);
+				ok = 0;
+			}
+		}
+		if (plt_on && (tile_index->nb_packet == 0 || tile_index->nb_packet != ref_tile_index->nb_packet)) {
+			fprintf(stderr, "ERROR -> packets of tile %d are not indexed\n", k);
+			ok = 0;
+		}
+	}
+	opj_destroy_cstr_index(&cstr_index);
+	opj_destroy_cstr_index(&ref_index);
+	ok = ok && check_tiles(codec, stream, image, ref_image) && nb_warnings == 0;
+	opj_stream_destroy(stream);
+	opj_destroy_codec(codec);
+	opj_image_destroy(image);
+	if (!ok) {
+		opj_image_destroy(ref_image);
+		return 1;
+	}
+
+	/* an index file saved for another stamp is not loaded */
+	nb_warnings = 0;
+	codec = create_decoder(in_file, index_file, STAMP + 1, &index_loaded, &stream, &image);
+	if (!codec) {
+		return 1;
+	}
+	nb_tps = get_nb_indexed_tile_parts(codec);
+	ok = !index_loaded && nb_warnings == 1 && nb_tps == 0 && check_tiles(codec, stream, image, ref_image);
+	opj_stream_destroy(stream);
+	opj_destroy_codec(codec);
+	opj_image_destroy(image);
+	if (!ok) {
+		fprintf(stderr, "ERROR -> index file with another stamp not rejected\n");
+		opj_image_destroy(ref_image);
+		return 1;
+	}
+
+	/* nor is it used for a codestream of the same length whose main header differs */
+	f = fopen(in_file, "rb");
+	if (!f) {
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = (unsigned char *) malloc((size_t)size);
+	ok = data && fread(data, 1, (size_t)size, f) == (size_t)size;
+	fclose(f);
+	com = ok ? (unsigned char *) memchr(data, 'C', 200) : 00;
+	if (!com || memcmp(com, "Created", 7) != 0) {
+		fprintf(stderr, "ERROR -> no comment in %s\n", in_file);
+		return 1;
+	}
+	*com = 'c';
+	f = fopen(other_file, "wb");
+	ok = f && fwrite(data, 1, (size_t)size, f) == (size_t)size;
+	if (f) {
+		fclose(f);
+	}
+	free(data);
+	if (!ok) {
+		return 1;
+	}
+
+	nb_warnings = 0;
+	codec = create_decoder(other_file, index_file, STAMP, &index_loaded, &stream, &image);
+	if (!codec) {
+		return 1;
+	}
+	nb_tps = get_nb_indexed_tile_parts(codec);
+	ok = index_loaded && nb_warnings == 1 && nb_tps == 0 && check_tiles(codec, stream, image, ref_image);
+	opj_stream_destroy(stream);
+	opj_destroy_codec(codec);
+	opj_image_destroy(image);
+	opj_image_destroy(ref_image);
+	if (!ok) {
+		fprintf(stderr, "ERROR -> index file of another codestream not rejected\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS FIXTURE_NUM_COMPS
+#define WIDTH FIXTURE_WIDTH
+#define HEIGHT FIXTURE_HEIGHT
+#define TILE_SIZE FIXTURE_TILE_SIZE
+#define NUM_TILES (((WIDTH + TILE_SIZE - 1) / TILE_SIZE) * ((HEIGHT + TILE_SIZE - 1) / TILE_SIZE))
+#define MAX_TILE_PARTS 256
+
+/* where the packet headers are moved */
+#define TO_PPM          0
+#define TO_PPT          1       /* Zppt restarts in each tile-part */
+#define TO_PPT_TILE     2       /* Zppt goes on over the tile-parts of a tile */
+
+typedef struct buffer {
+	unsigned char *data;
+	size_t size;
+	size_t max_size;
+	int overflow;
+} buffer_t;
+
+typedef struct tile_part {
+	OPJ_UINT32 tile;
+	const unsigned char *sot;       /* the SOT marker segment */
+	const unsigned char *header;    /* the other markers of the tile-part header */
+	size_t header_size;
+	buffer_t packet_headers;        /* without the SOP and EPH markers */
+	buffer_t packet_bodies;
+} tile_part_t;
+
+static void put_bytes(buffer_t *buffer, const unsigned char *data, size_t size)
+{
+	/* an empty packet body or header has no data, and an empty buffer neither */
+	if (size == 0) {
+		return;
+	}
+	if (buffer->size + size > buffer->max_size) {
+		size_t max_size = buffer->max_size ? buffer->max_size : 1024;
+		unsigned char *new_data;
+		while (max_size < buffer->size + size) {
+			max_size *= 2;
+		}
+		new_data = (unsigned char *) realloc(buffer->data, max_size);
+		if (!new_data) {
+			buffer->overflow = 1;
+			return;
+		}
+		buffer->data = new_data;
+		buffer->max_size = max_size;
+	}
+	memcpy(buffer->data + buffer->size, data, size);
+	buffer->size += size;
+}
+
+static void put_int(buffer_t *buffer, OPJ_UINT32 value, int nb_bytes)
+{
+	unsigned char bytes[4];
+	int i;
+
+	for (i = 0; i < nb_bytes; ++i) {
+		bytes[i] = (unsigned char)(value >> (8 * (nb_bytes - 1 - i)));
+	}
+	put_bytes(buffer, bytes, (size_t)nb_bytes);
+}
+
+static int write_file(const char *filename, const unsigned char *data, size_t size)
+{
+	FILE *f = fopen(filename, "wb");
+	int ok;
+
+	if (!f) {
+		return 0;
+	}
+	ok = fwrite(data, 1, size, f) == size;
+	fclose(f);
+	return ok;
+}
+
+static long read_file(const char *filename, unsigned char **data)
+{
+	FILE *f = fopen(filename, "rb");
+	long size;
+
+	*data = 00;
+	if (!f) {
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	*data = (unsigned char *) malloc((size_t)size + 1);
+	if (!*data || fread(*data, 1, (size_t)size, f) != (size_t)size) {
+		size = -1;
+	}
+	fclose(f);
+	return size;
+}
+
+/* tiles of 64x64 with SOP and EPH markers, one tile-part per resolution or per tile */
+static int encode(const char *filename, int tp_on)
+{
+	opj_cparameters_t parameters;
+
+	test_set_fixture_parameters(&parameters);
+	parameters.tcp_numlayers = 2;
+	parameters.tcp_rates[0] = 20;
+	parameters.tcp_rates[1] = 0;
+	parameters.csty |= 0x02 | 0x04;        /* SOP and EPH */
+	if (tp_on) {
+		parameters.tp_on = 1;
+		parameters.tp_flag = 'R';
+	}
+	return test_encode_image(filename, &parameters, test_create_fixture_image());
+}
+
+static opj_codec_t * create_decoder(const char *filename, opj_stream_t **stream, opj_image_t **image)
+{
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+
+	opj_set_default_decoder_parameters(&parameters);
+	codec = opj_create_decompress(OPJ_CODEC_J2K);
+	opj_set_warning_handler(codec, test_warning_callback, 00);
+	opj_set_error_handler(codec, test_error_callback, 00);
+	*image = 00;
+	*stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+	if (!*stream || !opj_setup_decoder(codec, &parameters) || !opj_read_header(*stream, codec, image)) {
+		if (*stream) {
+			opj_stream_destroy(*stream);
+		}
+		opj_destroy_codec(codec);
+		return 00;
+	}
+	return codec;
+}
+
+/* splits the tile-part data into packet headers and packet bodies, dropping the SOP and EPH markers */
+static int split_packets(tile_part_t *tp, const unsigned char *data, size_t size)
+{
+	size_t pos = 0, start;
+
+	while (pos < size) {
+		if (pos + 6 > size || data[pos] != 0xff || data[pos + 1] != 0x91) {
+			return 0;
+		}
+		pos += 6;
+		/* the packet header cannot hold 0xff 0x92, the byte following 0xff is stuffed */
+		for (start = pos; pos + 1 < size && !(data[pos] == 0xff && data[pos + 1] == 0x92); ++pos) {
+		}
+		if (pos + 1 >= size) {
+			return 0;
+		}
+		put_bytes(&tp->packet_headers, data + start, pos - start);
+		pos += 2;
+		/* neither can the code-block data hold 0xff 0x91 */
+		for (start = pos; pos < size && !(pos + 1 < size && data[pos] == 0xff && data[pos + 1] == 0x91); ++pos) {
+		}
+		put_bytes(&tp->packet_bodies, data + start, pos - start);
+	}
+	return !tp->packet_headers.overflow && !tp->packet_bodies.overflow;
+}
+
+/* writes the PPM or PPT marker segments holding data, numbered from *p_index */
+static void put_packed_headers(buffer_t *out, int marker, const unsigned char *data, size_t size,
+	int split, int reversed, OPJ_UINT32 *p_index)
+{
+	size_t offsets[257];
+	OPJ_UINT32 nb_segments = 0, i, k;
+
+	offsets[0] = 0;
+	while (offsets[nb_segments] < size && nb_segments < 256) {
+		/* the first split segment ends within the first Nppm of a PPM */
+		size_t len = !split ? 65532 : (nb_segments == 0 ? 3 : size / 4 + 1);
+		offsets[nb_segments + 1] = offsets[nb_segments] + len < size ? offsets[nb_segments] + len : size;
+		++nb_segments;
+	}
+	for (k = 0; k < nb_segments; ++k) {
+		i = reversed ? nb_segments - 1 - k : k;
+		put_int(out, (OPJ_UINT32)marker, 2);
+		put_int(out, (OPJ_UINT32)(offsets[i + 1] - offsets[i] + 3), 2);
+		put_int(out, *p_index + i, 1);                  /* Zppm or Zppt */
+		put_bytes(out, data + offsets[i], offsets[i + 1] - offsets[i]);
+	}
+	*p_index += nb_segments;
+}
+
+/* rewrites the codestream with the packet headers in PPM or PPT marker segments */
+static int rewrite(buffer_t *out, const unsigned char *data, size_t main_header_size,
+	tile_part_t *tps, OPJ_UINT32 nb_tps, int target, int split, int reversed)
+{
+	OPJ_UINT32 k, index = 0, tile_index[NUM_TILES];
+	size_t pos;
+
+	out->size = 0;
+	put_bytes(out, data, main_header_size);
+	/* Scod: the SOP and EPH markers are gone */
+	for (pos = 2; pos + 4 < main_header_size; pos += 2 + (size_t)((out->data[pos + 2] << 8) | out->data[pos + 3])) {
+		if (out->data[pos] == 0xff && out->data[pos + 1] == 0x52) {
+			out->data[pos + 4] &= (unsigned char)~(0x02 | 0x04);
+		}
+	}
+
+	if (target == TO_PPM) {
+		buffer_t ppm;
+		memset(&ppm, 0, sizeof(ppm));
+		for (k = 0; k < nb_tps; ++k) {
+			put_int(&ppm, (OPJ_UINT32)tps[k].packet_headers.size, 4);    /* Nppm */
+			put_bytes(&ppm, tps[k].packet_headers.data, tps[k].packet_headers.size);
+		}
+		put_packed_headers(out, 0xff60, ppm.data, ppm.size, split, reversed, &index);
+		out->overflow |= ppm.overflow;
+		free(ppm.data);
+	}
+
+	memset(tile_index, 0, sizeof(tile_index));
+	for (k = 0; k < nb_tps; ++k) {
+		size_t sot_pos = out->size;
+		OPJ_UINT32 psot;
+
+		put_bytes(out, tps[k].sot, 12);
+		put_bytes(out, tps[k].header, tps[k].header_size);
+		if (target != TO_PPM) {
+			if (target == TO_PPT) {
+				tile_index[tps[k].tile] = 0;
+			}
+			put_packed_headers(out, 0xff61, tps[k].packet_headers.data, tps[k].packet_headers.size,
+				split, reversed, &tile_index[tps[k].tile]);
+		}
+		put_int(out, 0xff93, 2);                        /* SOD */
+		put_bytes(out, tps[k].packet_bodies.data, tps[k].packet_bodies.size);
+		if (out->overflow) {
+			return 0;
+		}
+		psot = (OPJ_UINT32)(out->size - sot_pos);
+		out->data[sot_pos + 6] = (unsigned char)(psot >> 24);
+		out->data[sot_pos + 7] = (unsigned char)(psot >> 16);
+		out->data[sot_pos + 8] = (unsigned char)(psot >> 8);
+		out->data[sot_pos + 9] = (unsigned char)psot;
+	}
+	put_int(out, 0xffd9, 2);                                /* EOC */
+	return !out->overflow;
+}
+
+static int compare_tile(opj_image_t *image, opj_image_t *ref_image, OPJ_UINT32 tile)
+{
+	OPJ_UINT32 compno, x, y;
+
+	for (compno = 0; compno < NUM_COMPS; ++compno) {
+		opj_image_comp_t *comp = &image->comps[compno];
+		for (y = 0; y < comp->h; ++y) {
+			for (x = 0; x < comp->w; ++x) {
+				if (comp->data[y * comp->w + x] != ref_image->comps[compno].data[(comp->y0 + y) * WIDTH + comp->x0 + x]) {
+					fprintf(stderr, "ERROR -> tile %d differs from the reference at (%d,%d)\n", tile, comp->x0 + x, comp->y0 + y);
+					return 0;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *target_names[] = { "PPM", "PPT", "PPT over the tile" };
+	const char *out_file;
+	char ref_file[256];
+	int tp_on, variant, ok = 1;
+	unsigned char *data;
+	long size, pos, main_header_end;
+	OPJ_UINT32 nb_tps = 0, k, compno;
+	tile_part_t tps[MAX_TILE_PARTS];
+	buffer_t out;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	opj_image_t *ref_image, *image;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <file.j2k> <tile-parts>\n"
+			"  tile-parts 0: one tile-part per tile, 1: one tile-part per resolution\n", argv[0]);
+		return 1;
+	}
+	out_file = argv[1];
+	tp_on = atoi(argv[2]);
+	if (strlen(out_file) + 5 > sizeof(ref_file)) {
+		return 1;
+	}
+	sprintf(ref_file, "ref_%s", out_file);
+
+	if (!encode(ref_file, tp_on)) {
+		fprintf(stderr, "ERROR -> failed to encode %s\n", ref_file);
+		return 1;
+	}
+
+	/* locate the tile-parts and their packets : the main header ends with the first SOT */
+	size = read_file(ref_file, &data);
+	if (size < 0) {
+		return 1;
+	}
+	pos = 2;
+	while (pos + 4 <= size && !(data[pos] == 0xff && data[pos + 1] == 0x90)) {
+		pos += 2 + ((data[pos + 2] << 8) | data[pos + 3]);
+	}
+	main_header_end = pos;
+	memset(tps, 0, sizeof(tps));
+	while (ok && pos + 12 <= size && data[pos] == 0xff && data[pos + 1] == 0x90 && nb_tps < MAX_TILE_PARTS) {
+		tile_part_t *tp = &tps[nb_tps++];
+		long end = pos + (long)(((OPJ_UINT32)data[pos + 6] << 24) | ((OPJ_UINT32)data[pos + 7] << 16) | ((OPJ_UINT32)data[pos + 8] << 8) | data[pos + 9]);
+		long header_end = pos + 12;
+
+		tp->tile = (OPJ_UINT32)((data[pos + 4] << 8) | data[pos + 5]);
+		tp->sot = data + pos;
+		tp->header = data + pos + 12;
+		while (header_end + 4 <= end && !(data[header_end] == 0xff && data[header_end + 1] == 0x93)) {
+			header_end += 2 + ((data[header_end + 2] << 8) | data[header_end + 3]);
+		}
+		tp->header_size = (size_t)(header_end - pos - 12);
+		ok = end <= size && tp->tile < NUM_TILES && split_packets(tp, data + header_end + 2, (size_t)(end - header_end - 2));
+		pos = end;
+	}
+	if (!ok || nb_tps < NUM_TILES || (tp_on != 0) != (nb_tps > NUM_TILES) || pos + 2 != size) {
+		fprintf(stderr, "ERROR -> unexpected tile-parts in %s\n", ref_file);
+		return 1;
+	}
+
+	/* reference : the whole image */
+	codec = create_decoder(ref_file, &stream, &ref_image);
+	if (!codec) {
+		return 1;
+	}
+	ok = opj_decode(codec, stream, ref_image) && opj_end_decompress(codec, stream);
+	opj_stream_destroy(stream);
+	opj_destroy_codec(codec);
+	if (!ok) {
+		fprintf(stderr, "ERROR -> failed to decode %s\n", ref_file);
+		return 1;
+	}
+
+	/* PPM, PPT or PPT numbered over the tile, in one or several segments, in order or reversed */
+	memset(&out, 0, sizeof(out));
+	for (variant = 0; ok && variant < 12; ++variant) {
+		int target = variant / 4, split = (variant / 2) % 2, reversed = variant % 2;
+
+		if (!rewrite(&out, data, (size_t)main_header_end, tps, nb_tps, target, split, reversed)
+			|| !write_file(out_file, out.data, out.size)) {
+			fprintf(stderr, "ERROR -> failed to write %s\n", out_file);
+			ok = 0;
+			break;
+		}
+
+		codec = create_decoder(out_file, &stream, &image);
+		if (!codec) {
+			fprintf(stderr, "ERROR -> failed to read the header of the %s variant %d\n", target_names[target], variant);
+			ok = 0;
+			break;
+		}
+		if (!opj_decode(codec, stream, image) || !opj_end_decompress(codec, stream)) {
+			fprintf(stderr, "ERROR -> failed to decode the %s variant %d\n", target_names[target], variant);
+			ok = 0;
+		}
+		for (compno = 0; ok && compno < NUM_COMPS; ++compno) {
+			if (memcmp(image->comps[compno].data, ref_image->comps[compno].data, WIDTH * HEIGHT * sizeof(OPJ_INT32)) != 0) {
+				fprintf(stderr, "ERROR -> the %s variant %d differs from the reference\n", target_names[target], variant);
+				ok = 0;
+			}
+		}
+		opj_stream_destroy(stream);
+		opj_destroy_codec(codec);
+		opj_image_destroy(image);
+
+		/* the PPT data of a tile are read again each time it is decoded */
+		if (ok && target != TO_PPM) {
+			static const OPJ_UINT32 tiles[] = { NUM_TILES / 2, NUM_TILES / 2, 0, NUM_TILES / 2 };
+			codec = create_decoder(out_file, &stream, &image);
+			if (!codec) {
+				ok = 0;
+				break;
+			}
+			for (k = 0; ok && k < sizeof(tiles) / sizeof(tiles[0]); ++k) {
+				if (!opj_get_decoded_tile(codec, stream, image, tiles[k])) {
+					fprintf(stderr, "ERROR -> failed to decode tile %d of the %s variant %d\n", tiles[k], target_names[target], variant);
+					ok = 0;
+					break;
+				}
+				ok = compare_tile(image, ref_image, tiles[k]);
+			}
+			opj_stream_destroy(stream);
+			opj_destroy_codec(codec);
+			opj_image_destroy(image);
+		}
+	}
+
+	for (k = 0; k < nb_tps; ++k) {
+		free(tps[k].packet_headers.data);
+		free(tps[k].packet_bodies.data);
+	}
+	free(out.data);
+	free(data);
+	opj_image_destroy(ref_image);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,610 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS 3
+#define NUM_RESOLUTIONS 5
+#define NUM_LAYERS 3
+/* the encoder needs an image offset multiple of the subsampling */
+#define X0 14
+#define Y0 6
+#define X1 (X0 + 181)
+#define Y1 (Y0 + 123)
+
+/* the first component is full size, the others are subsampled */
+static const OPJ_UINT32 comp_dx[NUM_COMPS] = { 1, 2, 1 };
+static const OPJ_UINT32 comp_dy[NUM_COMPS] = { 1, 2, 3 };
+
+static OPJ_UINT32 ceildiv(OPJ_UINT32 a, OPJ_UINT32 b)
+{
+	return (a + b - 1) / b;
+}
+
+static opj_image_t * create_image(void)
+{
+	opj_image_cmptparm_t params[NUM_COMPS];
+	opj_image_t *image;
+	OPJ_UINT32 compno, i;
+
+	memset(params, 0, sizeof(params));
+	for (compno = 0; compno < NUM_COMPS; ++compno) {
+		params[compno].dx = comp_dx[compno];
+		params[compno].dy = comp_dy[compno];
+		params[compno].x0 = ceildiv(X0, comp_dx[compno]);
+		params[compno].y0 = ceildiv(Y0, comp_dy[compno]);
+		params[compno].w = ceildiv(X1, comp_dx[compno]) - params[compno].x0;
+		params[compno].h = ceildiv(Y1, comp_dy[compno]) - params[compno].y0;
+		params[compno].prec = 8;
+	}
+	image = opj_image_create(NUM_COMPS, params, OPJ_CLRSPC_UNKNOWN);
+	if (!image) {
+		return 00;
+	}
+	image->x0 = X0;
+	image->y0 = Y0;
+	image->x1 = X1;
+	image->y1 = Y1;
+	srand(1);
+	for (compno = 0; compno < NUM_COMPS; ++compno) {
+		opj_image_comp_t *comp = &image->comps[compno];
+		for (i = 0; i < comp->w * comp->h; ++i) {
+			comp->data[i] = (OPJ_INT32)(((i % comp->w) * (compno + 1) + (i / comp->w) * 2 + (OPJ_UINT32)(rand() % 32)) & 0xff);
+		}
+	}
+	return image;
+}
+
+/* the three layouts of the code-stream */
+#define LAYOUT_TILES 0
+#define LAYOUT_ONE_TILE 1
+#define LAYOUT_POCS 2
+
+/* the low resolutions, then the high resolutions of the first component and of the others,
+ * the encoder expects the POCs to share no packet: resno0, compno0, resno1, compno1 */
+#define NUM_POCS 3
+static const OPJ_UINT32 pocs[NUM_POCS][4] = { { 0, 0, 3, NUM_COMPS }, { 3, 0, NUM_RESOLUTIONS, 1 }, { 3, 1, NUM_RESOLUTIONS, NUM_COMPS } };
+
+/* tiles of 64x64 offset from the image, one tile, or one tile with three POCs in successive orders.
+ * The PLT markers delimit the packets. */
+static int encode(const char *filename, OPJ_PROG_ORDER prog_order, int layout)
+{
+	opj_cparameters_t parameters;
+	opj_image_t *image;
+
+	/* opj_start_compress takes over the samples of the image */
+	image = create_image();
+	if (!image) {
+		return 0;
+	}
+
+	opj_set_default_encoder_parameters(&parameters);
+	parameters.numresolution = NUM_RESOLUTIONS;
+	parameters.tcp_numlayers = NUM_LAYERS;
+	parameters.tcp_rates[0] = 40;
+	parameters.tcp_rates[1] = 10;
+	parameters.tcp_rates[2] = 0;
+	parameters.cp_disto_alloc = 1;
+	parameters.cblockw_init = 16;
+	parameters.cblockh_init = 16;
+	parameters.prog_order = prog_order;
+	/* precincts of different sizes in x and y, down to 4x4 */
+	parameters.csty |= 0x01;
+	parameters.res_spec = 3;
+	parameters.prcw_init[0] = 32;
+	parameters.prch_init[0] = 16;
+	parameters.prcw_init[1] = 16;
+	parameters.prch_init[1] = 64;
+	parameters.prcw_init[2] = 8;
+	parameters.prch_init[2] = 8;
+	parameters.plt_on = OPJ_TRUE;
+	if (layout == LAYOUT_POCS) {
+		OPJ_UINT32 i;
+
+		parameters.numpocs = NUM_POCS;
+		for (i = 0; i < parameters.numpocs; ++i) {
+			parameters.POC[i].tile = 1;
+			parameters.POC[i].resno0 = pocs[i][0];
+			parameters.POC[i].compno0 = pocs[i][1];
+			parameters.POC[i].layno1 = NUM_LAYERS;
+			parameters.POC[i].resno1 = pocs[i][2];
+			parameters.POC[i].compno1 = pocs[i][3];
+			parameters.POC[i].prg1 = (OPJ_PROG_ORDER)(((OPJ_UINT32)prog_order + i) % 5);
+		}
+	} else if (layout == LAYOUT_TILES) {
+		parameters.tile_size_on = OPJ_TRUE;
+		parameters.cp_tx0 = 5;
+		parameters.cp_ty0 = 3;
+		parameters.cp_tdx = 64;
+		parameters.cp_tdy = 64;
+	}
+
+	return test_encode_image(filename, &parameters, image);
+}
+
+static opj_image_t * decode(const char *filename)
+{
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	opj_image_t *image = 00;
+	int ok;
+
+	opj_set_default_decoder_parameters(&parameters);
+	codec = opj_create_decompress(OPJ_CODEC_J2K);
+	opj_set_warning_handler(codec, test_warning_callback, 00);
+	opj_set_error_handler(codec, test_error_callback, 00);
+	stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+	ok = stream && opj_setup_decoder(codec, &parameters) && opj_read_header(stream, codec, &image)
+		&& opj_decode(codec, stream, image) && opj_end_decompress(codec, stream);
+	if (stream) {
+		opj_stream_destroy(stream);
+	}
+	opj_destroy_codec(codec);
+	if (!ok && image) {
+		opj_image_destroy(image);
+		image = 00;
+	}
+	return image;
+}
+
+static int compare_images(opj_image_t *image, opj_image_t *ref_image)
+{
+	OPJ_UINT32 compno;
+
+	if (image->x0 != ref_image->x0 || image->y0 != ref_image->y0 || image->numcomps != ref_image->numcomps) {
+		fprintf(stderr, "ERROR -> the decoded image does not have the area or the components of the original\n");
+		return 0;
+	}
+	for (compno = 0; compno < NUM_COMPS; ++compno) {
+		opj_image_comp_t *comp = &image->comps[compno], *ref_comp = &ref_image->comps[compno];
+		if (comp->x0 != ref_comp->x0 || comp->y0 != ref_comp->y0 || comp->w != ref_comp->w || comp->h != ref_comp->h) {
+			fprintf(stderr, "ERROR -> component %d does not have the area of the original\n", compno);
+			return 0;
+		}
+		if (memcmp(comp->data, ref_comp->data, comp->w * comp->h * sizeof(OPJ_INT32)) != 0) {
+			fprintf(stderr, "ERROR -> component %d differs from the original\n", compno);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+
+/* The expected packet order is computed from the main header by stepping on the reference grid
+ * as in B.12.1 of the standard, independently of the packet iterator of the library. */
+
+#define MAX_PACKETS 4096
+#define MAX_TILES 32
+
+typedef struct packet_id {
+	OPJ_UINT32 layno, resno, compno, precno;
+} packet_id_t;
+
+typedef struct packet {
+	const OPJ_BYTE *data;
+	OPJ_UINT32 length;
+} packet_t;
+
+typedef struct codestream {
+	OPJ_BYTE *data;
+	OPJ_UINT32 size;
+	/* from SIZ */
+	OPJ_UINT32 x0, y0, x1, y1, tdx, tdy, tx0, ty0;
+	OPJ_UINT32 dx[NUM_COMPS], dy[NUM_COMPS];
+	/* from COD */
+	OPJ_UINT32 prog, numlayers, numres;
+	OPJ_UINT32 prcw[NUM_RESOLUTIONS], prch[NUM_RESOLUTIONS];
+	/* packets of the tiles in the order of the code-stream, from PLT */
+	OPJ_UINT32 numtiles;
+	OPJ_UINT32 numpackets[MAX_TILES];
+	OPJ_UINT32 numread[MAX_TILES];
+	packet_t packets[MAX_TILES][MAX_PACKETS];
+} codestream_t;
+
+static OPJ_UINT32 get_int(const OPJ_BYTE *data, OPJ_UINT32 nb_bytes)
+{
+	OPJ_UINT32 value = 0, i;
+	for (i = 0; i < nb_bytes; ++i) {
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+
+static int read_codestream(const char *filename, codestream_t *cs)
+{
+	FILE *file = fopen(filename, "rb");
+	OPJ_UINT32 pos, compno, resno, tileno;
+	long size;
+
+	memset(cs, 0, sizeof(*cs));
+	if (!file) {
+		return 0;
+	}
+	if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 4 || fseek(file, 0, SEEK_SET) != 0) {
+		fclose(file);
+		return 0;
+	}
+	cs->size = (OPJ_UINT32)size;
+	cs->data = (OPJ_BYTE *)malloc(cs->size);
+	if (!cs->data || fread(cs->data, 1, cs->size, file) != cs->size) {
+		fclose(file);
+		return 0;
+	}
+	fclose(file);
+
+	/* main header, after SOC */
+	for (pos = 2; pos + 4 <= cs->size && get_int(cs->data + pos, 2) != 0xff90; pos += 2 + get_int(cs->data + pos + 2, 2)) {
+		const OPJ_BYTE *segment = cs->data + pos + 4;
+		switch (get_int(cs->data + pos, 2)) {
+		case 0xff51: /* SIZ */
+			cs->x1 = get_int(segment + 2, 4);
+			cs->y1 = get_int(segment + 6, 4);
+			cs->x0 = get_int(segment + 10, 4);
+			cs->y0 = get_int(segment + 14, 4);
+			cs->tdx = get_int(segment + 18, 4);
+			cs->tdy = get_int(segment + 22, 4);
+			cs->tx0 = get_int(segment + 26, 4);
+			cs->ty0 = get_int(segment + 30, 4);
+			if (get_int(segment + 34, 2) != NUM_COMPS) {
+				return 0;
+			}
+			for (compno = 0; compno < NUM_COMPS; ++compno) {
+				cs->dx[compno] = segment[36 + 3 * compno + 1];
+				cs->dy[compno] = segment[36 + 3 * compno + 2];
+			}
+			break;
+		case 0xff52: /* COD */
+			cs->prog = segment[1];
+			cs->numlayers = get_int(segment + 2, 2);
+			cs->numres = segment[5] + 1U;
+			if (cs->numres != NUM_RESOLUTIONS) {
+				return 0;
+			}
+			for (resno = 0; resno < cs->numres; ++resno) {
+				cs->prcw[resno] = (segment[0] & 0x01) ? (segment[10 + resno] & 0x0fU) : 15;
+				cs->prch[resno] = (segment[0] & 0x01) ? (OPJ_UINT32)(segment[10 + resno] >> 4) : 15;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	/* tile-parts: SOT, the PLT markers of the header, then the packets after SOD */
+	while (pos + 12 <= cs->size && get_int(cs->data + pos, 2) == 0xff90) {
+		OPJ_UINT32 end = pos + get_int(cs->data + pos + 6, 4), length = 0;
+		tileno = get_int(cs->data + pos + 4, 2);
+		if (tileno >= MAX_TILES || end > cs->size) {
+			return 0;
+		}
+		if (tileno >= cs->numtiles) {
+			cs->numtiles = tileno + 1;
+		}
+		for (pos += 12; pos + 4 <= end && get_int(cs->data + pos, 2) != 0xff93; pos += 2 + get_int(cs->data + pos + 2, 2)) {
+			if (get_int(cs->data + pos, 2) == 0xff58) {
+				OPJ_UINT32 i, seg_end = pos + 2 + get_int(cs->data + pos + 2, 2);
+				for (i = pos + 5; i < seg_end; ++i) {
+					length = (length << 7) | (cs->data[i] & 0x7fU);
+					if (!(cs->data[i] & 0x80)) {
+						if (cs->numpackets[tileno] == MAX_PACKETS) {
+							return 0;
+						}
+						cs->packets[tileno][cs->numpackets[tileno]++].length = length;
+						length = 0;
+					}
+				}
+			}
+		}
+		/* the packets of the tile-part follow SOD */
+		for (pos += 2; pos < end; pos += cs->packets[tileno][cs->numread[tileno]++].length) {
+			if (cs->numread[tileno] == cs->numpackets[tileno] || pos + cs->packets[tileno][cs->numread[tileno]].length > end) {
+				return 0;
+			}
+			cs->packets[tileno][cs->numread[tileno]].data = cs->data + pos;
+		}
+	}
+
+	for (tileno = 0; tileno < cs->numtiles; ++tileno) {
+		if (cs->numread[tileno] != cs->numpackets[tileno]) {
+			return 0;
+		}
+	}
+	return cs->numtiles > 0;
+}
+
+typedef struct packet_list {
+	OPJ_UINT32 numpackets;
+	packet_id_t ids[MAX_PACKETS];
+	/* the packets already listed, by layer, resolution, component and precinct */
+	OPJ_BYTE *listed;
+} packet_list_t;
+
+/* area of a tile-component at a resolution, and size of its precincts as log2 */
+typedef struct res_area {
+	OPJ_UINT32 x0, y0, x1, y1, pw, ph, scale;
+} res_area_t;
+
+static OPJ_UINT32 uint_min(OPJ_UINT32 a, OPJ_UINT32 b)
+{
+	return a < b ? a : b;
+}
+
+static OPJ_UINT32 uint_max(OPJ_UINT32 a, OPJ_UINT32 b)
+{
+	return a > b ? a : b;
+}
+
+static void get_res_area(const codestream_t *cs, OPJ_UINT32 tx0, OPJ_UINT32 ty0, OPJ_UINT32 tx1, OPJ_UINT32 ty1,
+                         OPJ_UINT32 compno, OPJ_UINT32 resno, res_area_t *area)
+{
+	/* the reference grid samples of a resolution sample */
+	area->scale = 1U << (cs->numres - 1 - resno);
+	area->x0 = ceildiv(tx0, cs->dx[compno] * area->scale);
+	area->y0 = ceildiv(ty0, cs->dy[compno] * area->scale);
+	area->x1 = ceildiv(tx1, cs->dx[compno] * area->scale);
+	area->y1 = ceildiv(ty1, cs->dy[compno] * area->scale);
+	if (area->x0 == area->x1 || area->y0 == area->y1) {
+		area->pw = area->ph = 0;
+		return;
+	}
+	area->pw = ceildiv(area->x1, 1U << cs->prcw[resno]) - (area->x0 >> cs->prcw[resno]);
+	area->ph = ceildiv(area->y1, 1U << cs->prch[resno]) - (area->y0 >> cs->prch[resno]);
+}
+
+static void list_layers(packet_list_t *list, OPJ_UINT32 layno1, OPJ_UINT32 resno, OPJ_UINT32 compno, OPJ_UINT32 precno)
+{
+	OPJ_UINT32 layno;
+	for (layno = 0; layno < layno1; ++layno) {
+		OPJ_BYTE *listed = &list->listed[((layno * NUM_RESOLUTIONS + resno) * NUM_COMPS + compno) * MAX_PACKETS + precno];
+		if (*listed || list->numpackets == MAX_PACKETS) {
+			continue;
+		}
+		*listed = 1;
+		list->ids[list->numpackets].layno = layno;
+		list->ids[list->numpackets].resno = resno;
+		list->ids[list->numpackets].compno = compno;
+		list->ids[list->numpackets].precno = precno;
+		++list->numpackets;
+	}
+}
+
+/* lists the precinct of a position of the reference grid, if a precinct starts there */
+static void list_position(const codestream_t *cs, packet_list_t *list, OPJ_UINT32 tx0, OPJ_UINT32 ty0, OPJ_UINT32 tx1, OPJ_UINT32 ty1,
+                          OPJ_UINT32 x, OPJ_UINT32 y, OPJ_UINT32 layno1, OPJ_UINT32 resno, OPJ_UINT32 compno)
+{
+	res_area_t area;
+	OPJ_UINT32 xstep, ystep, precno;
+
+	get_res_area(cs, tx0, ty0, tx1, ty1, compno, resno, &area);
+	if (area.pw == 0) {
+		return;
+	}
+	xstep = cs->dx[compno] * area.scale << cs->prcw[resno];
+	ystep = cs->dy[compno] * area.scale << cs->prch[resno];
+	if (!(y % ystep == 0 || (y == ty0 && (area.y0 * area.scale) % (area.scale << cs->prch[resno]) != 0))) {
+		return;
+	}
+	if (!(x % xstep == 0 || (x == tx0 && (area.x0 * area.scale) % (area.scale << cs->prcw[resno]) != 0))) {
+		return;
+	}
+	precno = (ceildiv(x, cs->dx[compno] * area.scale) >> cs->prcw[resno]) - (area.x0 >> cs->prcw[resno])
+		+ area.pw * ((ceildiv(y, cs->dy[compno] * area.scale) >> cs->prch[resno]) - (area.y0 >> cs->prch[resno]));
+	list_layers(list, layno1, resno, compno, precno);
+}
+
+/* lists the packets of a progression over layers 0 to layno1 - 1, resolutions resno0 to resno1 - 1
+ * and components compno0 to compno1 - 1 of a tile */
+static void list_packets(const codestream_t *cs, packet_list_t *list, OPJ_UINT32 tileno, OPJ_UINT32 prog,
+                         OPJ_UINT32 layno1, OPJ_UINT32 resno0, OPJ_UINT32 resno1, OPJ_UINT32 compno0, OPJ_UINT32 compno1)
+{
+	OPJ_UINT32 numtx = ceildiv(cs->x1 - cs->tx0, cs->tdx);
+	OPJ_UINT32 p = tileno % numtx, q = tileno / numtx;
+	OPJ_UINT32 tx0 = uint_max(cs->tx0 + p * cs->tdx, cs->x0), ty0 = uint_max(cs->ty0 + q * cs->tdy, cs->y0);
+	OPJ_UINT32 tx1 = uint_min(cs->tx0 + (p + 1) * cs->tdx, cs->x1), ty1 = uint_min(cs->ty0 + (q + 1) * cs->tdy, cs->y1);
+	OPJ_UINT32 layno, resno, compno, precno, x, y;
+	res_area_t area;
+
+	switch (prog) {
+	case OPJ_LRCP:
+		for (layno = 0; layno < layno1; ++layno)
+			for (resno = resno0; resno < resno1; ++resno)
+				for (compno = compno0; compno < compno1; ++compno) {
+					get_res_area(cs, tx0, ty0, tx1, ty1, compno, resno, &area);
+					for (precno = 0; precno < area.pw * area.ph; ++precno)
+						list_layers(list, layno + 1, resno, compno, precno);
+				}
+		break;
+	case OPJ_RLCP:
+		for (resno = resno0; resno < resno1; ++resno)
+			for (layno = 0; layno < layno1; ++layno)
+				for (compno = compno0; compno < compno1; ++compno) {
+					get_res_area(cs, tx0, ty0, tx1, ty1, compno, resno, &area);
+					for (precno = 0; precno < area.pw * area.ph; ++precno)
+						list_layers(list, layno + 1, resno, compno, precno);
+				}
+		break;
+	case OPJ_RPCL:
+		for (resno = resno0; resno < resno1; ++resno)
+			for (y = ty0; y < ty1; ++y)
+				for (x = tx0; x < tx1; ++x)
+					for (compno = compno0; compno < compno1; ++compno)
+						list_position(cs, list, tx0, ty0, tx1, ty1, x, y, layno1, resno, compno);
+		break;
+	case OPJ_PCRL:
+		for (y = ty0; y < ty1; ++y)
+			for (x = tx0; x < tx1; ++x)
+				for (compno = compno0; compno < compno1; ++compno)
+					for (resno = resno0; resno < resno1; ++resno)
+						list_position(cs, list, tx0, ty0, tx1, ty1, x, y, layno1, resno, compno);
+		break;
+	case OPJ_CPRL:
+		for (compno = compno0; compno < compno1; ++compno)
+			for (y = ty0; y < ty1; ++y)
+				for (x = tx0; x < tx1; ++x)
+					for (resno = resno0; resno < resno1; ++resno)
+						list_position(cs, list, tx0, ty0, tx1, ty1, x, y, layno1, resno, compno);
+		break;
+	default:
+		break;
+	}
+}
+
+/* lists the packets of a tile in the order of the standard, with the POCs of the layout */
+static int list_tile_packets(const codestream_t *cs, OPJ_UINT32 tileno, int layout, packet_list_t *list)
+{
+	list->numpackets = 0;
+	list->listed = (OPJ_BYTE *)calloc(NUM_LAYERS * NUM_RESOLUTIONS * NUM_COMPS * MAX_PACKETS, 1);
+	if (!list->listed) {
+		return 0;
+	}
+	if (layout == LAYOUT_POCS) {
+		OPJ_UINT32 i;
+		for (i = 0; i < NUM_POCS; ++i) {
+			list_packets(cs, list, tileno, (cs->prog + i) % 5, cs->numlayers, pocs[i][0], pocs[i][2], pocs[i][1], pocs[i][3]);
+		}
+	}
+	else {
+		list_packets(cs, list, tileno, cs->prog, cs->numlayers, 0, cs->numres, 0, NUM_COMPS);
+	}
+	free(list->listed);
+	list->listed = 00;
+	return 1;
+}
+
+/* each packet of the code-stream in the order of the standard is the packet with the same
+ * layer, resolution, component and precinct in the reference code-stream in LRCP */
+static int check_packet_order(const char *filename, const char *ref_filename, int layout)
+{
+	static codestream_t cs, ref_cs;
+	static packet_list_t list, ref_list;
+	OPJ_UINT32 tileno, i, j;
+	int ok = read_codestream(filename, &cs) && read_codestream(ref_filename, &ref_cs);
+
+	if (!ok || cs.numtiles != ref_cs.numtiles || ref_cs.prog != OPJ_LRCP) {
+		fprintf(stderr, "ERROR -> failed to read the packets of %s and %s\n", filename, ref_filename);
+		ok = 0;
+	}
+	for (tileno = 0; ok && tileno < cs.numtiles; ++tileno) {
+		if (!list_tile_packets(&cs, tileno, layout, &list) || !list_tile_packets(&ref_cs, tileno, LAYOUT_ONE_TILE, &ref_list)) {
+			ok = 0;
+			break;
+		}
+		if (list.numpackets != cs.numpackets[tileno] || ref_list.numpackets != ref_cs.numpackets[tileno]) {
+			fprintf(stderr, "ERROR -> tile %d has %d packets, %d are expected\n", tileno, cs.numpackets[tileno], list.numpackets);
+			ok = 0;
+			break;
+		}
+		for (i = 0; ok && i < list.numpackets; ++i) {
+			const packet_id_t *id = &list.ids[i];
+			for (j = 0; j < ref_list.numpackets && memcmp(&ref_list.ids[j], id, sizeof(*id)) != 0; ++j) {
+			}
+			if (j == ref_list.numpackets || cs.packets[tileno][i].length != ref_cs.packets[tileno][j].length
+				|| memcmp(cs.packets[tileno][i].data, ref_cs.packets[tileno][j].data, cs.packets[tileno][i].length) != 0) {
+				fprintf(stderr, "ERROR -> packet %d of tile %d is not layer %d, resolution %d, component %d, precinct %d\n",
+					i, tileno, id->layno, id->resno, id->compno, id->precno);
+				ok = 0;
+			}
+		}
+	}
+	free(cs.data);
+	free(ref_cs.data);
+	cs.data = ref_cs.data = 00;
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *prog_names[] = { "LRCP", "RLCP", "RPCL", "PCRL", "CPRL" };
+	const char *out_file;
+	char *ref_file;
+	int prog, layout, ok = 1;
+	opj_image_t *image, *ref_image;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <file.j2k> <progression order>\n"
+			"  progression order: LRCP, RLCP, RPCL, PCRL or CPRL\n", argv[0]);
+		return 1;
+	}
+	out_file = argv[1];
+	for (prog = 0; prog < 5 && strcmp(argv[2], prog_names[prog]) != 0; ++prog) {
+	}
+	if (prog == 5) {
+		fprintf(stderr, "ERROR -> unknown progression order %s\n", argv[2]);
+		return 1;
+	}
+
+	ref_image = create_image();
+	if (!ref_image) {
+		return 1;
+	}
+
+	ref_file = (char *)malloc(strlen(out_file) + sizeof(".lrcp.j2k"));
+	if (!ref_file) {
+		opj_image_destroy(ref_image);
+		return 1;
+	}
+	sprintf(ref_file, "%s.lrcp.j2k", out_file);
+
+	for (layout = LAYOUT_TILES; ok && layout <= LAYOUT_POCS; layout += LAYOUT_POCS - LAYOUT_TILES) {
+		const char *layout_name = layout == LAYOUT_POCS ? " with POCs" : "";
+
+		if (!encode(out_file, (OPJ_PROG_ORDER)prog, layout)) {
+			fprintf(stderr, "ERROR -> failed to encode %s in %s%s\n", out_file, prog_names[prog], layout_name);
+			ok = 0;
+			break;
+		}
+
+		/* the encoder and the decoder iterate the same packets: the image comes back losslessly */
+		image = decode(out_file);
+		if (!image) {
+			fprintf(stderr, "ERROR -> failed to decode %s in %s%s\n", out_file, prog_names[prog], layout_name);
+			ok = 0;
+			break;
+		}
+		ok = compare_images(image, ref_image);
+		opj_image_destroy(image);
+
+		/* and they iterate them in the order of the standard */
+		if (ok && !encode(ref_file, OPJ_LRCP, layout == LAYOUT_POCS ? LAYOUT_ONE_TILE : layout)) {
+			fprintf(stderr, "ERROR -> failed to encode %s in LRCP\n", ref_file);
+			ok = 0;
+		}
+		ok = ok && check_packet_order(out_file, ref_file, layout);
+	}
+
+	free(ref_file);
+	opj_image_destroy(ref_image);
+
+	return ok ? 0 : 1;
+}
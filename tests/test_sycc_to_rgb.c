@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+
+/* -------------------------------------------------------------------------- */
+
+/* sYCC image with random samples, the chroma subsampled by dx and dy */
+static opj_image_t *create_image(OPJ_UINT32 width, OPJ_UINT32 height, OPJ_UINT32 dx, OPJ_UINT32 dy,
+                                 OPJ_UINT32 prec, OPJ_UINT32 x0, OPJ_UINT32 y0, OPJ_UINT32 numcomps)
+{
+	opj_image_cmptparm_t params[4];
+	opj_image_t *image;
+	OPJ_UINT32 compno, i;
+
+	memset(params, 0, sizeof(params));
+	for (compno = 0; compno < numcomps; ++compno) {
+		OPJ_UINT32 cdx = (compno == 1 || compno == 2) ? dx : 1;
+		OPJ_UINT32 cdy = (compno == 1 || compno == 2) ? dy : 1;
+		params[compno].dx = cdx;
+		params[compno].dy = cdy;
+		params[compno].x0 = (x0 + cdx - 1) / cdx;
+		params[compno].y0 = (y0 + cdy - 1) / cdy;
+		params[compno].w = (x0 + width + cdx - 1) / cdx - params[compno].x0;
+		params[compno].h = (y0 + height + cdy - 1) / cdy - params[compno].y0;
+		params[compno].prec = prec;
+		params[compno].bpp = prec;
+	}
+	image = opj_image_create(numcomps, params, OPJ_CLRSPC_SYCC);
+	if (!image)
+		return NULL;
+	image->x0 = x0;
+	image->y0 = y0;
+	image->x1 = x0 + width;
+	image->y1 = y0 + height;
+
+	srand(prec * 131 + dx * 17 + dy);
+	for (compno = 0; compno < numcomps; ++compno) {
+		opj_image_comp_t *comp = &image->comps[compno];
+		for (i = 0; i < comp->w * comp->h; ++i)
+			comp->data[i] = rand() & ((1 << prec) - 1);
+	}
+
+	return image;
+}
+
+/* per pixel conversion done by the applications before opj_image_sycc_to_rgb */
+static void reference_pixel(const opj_image_t *image, OPJ_UINT32 x, OPJ_UINT32 y, int rgb[3])
+{
+	const opj_image_comp_t *cb = &image->comps[1];
+	int upb = (1 << image->comps[0].prec) - 1, offset = 1 << (image->comps[0].prec - 1);
+	int col = (int)((image->comps[0].x0 + x) / cb->dx) - (int)cb->x0;
+	int row = (int)((image->comps[0].y0 + y) / cb->dy) - (int)cb->y0;
+	int luma, vb, vr, c;
+
+	col = (col < 0) ? 0 : (col >= (int)cb->w) ? (int)cb->w - 1 : col;
+	row = (row < 0) ? 0 : (row >= (int)cb->h) ? (int)cb->h - 1 : row;
+	luma = image->comps[0].data[y * image->comps[0].w + x];
+	vb = cb->data[(OPJ_UINT32)row * cb->w + (OPJ_UINT32)col] - offset;
+	vr = image->comps[2].data[(OPJ_UINT32)row * cb->w + (OPJ_UINT32)col] - offset;
+
+	rgb[0] = luma + (int)(1.402 * (float)vr);
+	rgb[1] = luma - (int)(0.344 * (float)vb + 0.714 * (float)vr);
+	rgb[2] = luma + (int)(1.772 * (float)vb);
+	for (c = 0; c < 3; ++c)
+		rgb[c] = (rgb[c] < 0) ? 0 : (rgb[c] > upb) ? upb : rgb[c];
+}
+
+static int check_buffer(const opj_image_t *image, OPJ_PIXEL_FORMAT format, OPJ_UINT32 nb_channels, OPJ_UINT32 depth)
+{
+	OPJ_UINT32 width = image->comps[0].w, height = image->comps[0].h, prec = image->comps[0].prec;
+	OPJ_UINT32 stride = width * nb_channels * (depth / 8) + 6, x, y, c;
+	OPJ_BYTE *buffer = (OPJ_BYTE*) malloc((size_t)stride * height);
+	int ok = 1;
+
+	if (!buffer || !opj_image_sycc_to_buffer(image, buffer, stride, format)) {
+		fprintf(stderr, "ERROR -> failed to convert into a buffer\n");
+		free(buffer);
+		return 0;
+	}
+	for (y = 0; y < height && ok; ++y) {
+		for (x = 0; x < width && ok; ++x) {
+			int rgb[3];
+			reference_pixel(image, x, y, rgb);
+			for (c = 0; c < nb_channels; ++c) {
+				OPJ_UINT32 expected, value;
+				if (c == 3 && image->numcomps <= 3) {
+					expected = (1u << depth) - 1; /* opaque */
+				}
+				else {
+					expected = (c < 3) ? (OPJ_UINT32)rgb[c] : (OPJ_UINT32)image->comps[3].data[y * width + x];
+					expected = (prec > depth) ? expected >> (prec - depth) : expected << (depth - prec);
+				}
+				if (depth == 8)
+					value = buffer[y * stride + x * nb_channels + c];
+				else
+					value = ((OPJ_UINT16*)(buffer + y * stride))[x * nb_channels + c];
+				if (value != expected) {
+					fprintf(stderr, "ERROR -> pixel (%d,%d) channel %d is %d instead of %d\n", x, y, c, value, expected);
+					ok = 0;
+					break;
+				}
+			}
+		}
+	}
+	free(buffer);
+
+	return ok;
+}
+
+static int check_planes(opj_image_t *image)
+{
+	OPJ_UINT32 width = image->comps[0].w, height = image->comps[0].h, x, y, c;
+	int *expected = (int*) malloc(3 * sizeof(int) * width * height);
+
+	if (!expected)
+		return 0;
+	for (y = 0; y < height; ++y)
+		for (x = 0; x < width; ++x)
+			reference_pixel(image, x, y, expected + 3 * (y * width + x));
+
+	if (!opj_image_sycc_to_rgb(image) || image->color_space != OPJ_CLRSPC_SRGB) {
+		fprintf(stderr, "ERROR -> failed to convert the planes\n");
+		free(expected);
+		return 0;
+	}
+	for (c = 0; c < 3; ++c) {
+		if (image->comps[c].w != width || image->comps[c].h != height
+			|| image->comps[c].dx != 1 || image->comps[c].dy != 1) {
+			fprintf(stderr, "ERROR -> component %d is %dx%d\n", c, image->comps[c].w, image->comps[c].h);
+			free(expected);
+			return 0;
+		}
+		for (y = 0; y < width * height; ++y) {
+			if (image->comps[c].data[y] != expected[3 * y + c]) {
+				fprintf(stderr, "ERROR -> sample %d of component %d is %d instead of %d\n",
+				        y, c, image->comps[c].data[y], expected[3 * y + c]);
+				free(expected);
+				return 0;
+			}
+		}
+	}
+	free(expected);
+
+	return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	OPJ_UINT32 width, height, dx, dy, prec, x0 = 0, y0 = 0, numcomps = 3;
+	opj_image_t *image;
+	OPJ_BYTE pixel[8];
+	int ok;
+
+	if (argc < 6) {
+		fprintf(stderr, "Usage: %s <width> <height> <dx> <dy> <prec> [x0] [y0] [numcomps]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	width = (OPJ_UINT32)atoi(argv[1]);
+	height = (OPJ_UINT32)atoi(argv[2]);
+	dx = (OPJ_UINT32)atoi(argv[3]);
+	dy = (OPJ_UINT32)atoi(argv[4]);
+	prec = (OPJ_UINT32)atoi(argv[5]);
+	if (argc > 6)
+		x0 = (OPJ_UINT32)atoi(argv[6]);
+	if (argc > 7)
+		y0 = (OPJ_UINT32)atoi(argv[7]);
+	if (argc > 8)
+		numcomps = (OPJ_UINT32)atoi(argv[8]);
+
+	image = create_image(width, height, dx, dy, prec, x0, y0, numcomps);
+	if (!image) {
+		fprintf(stderr, "ERROR -> failed to create the image\n");
+		return EXIT_FAILURE;
+	}
+
+	ok = check_buffer(image, OPJ_PF_RGB8, 3, 8) && check_buffer(image, OPJ_PF_RGBA8, 4, 8)
+	     && check_buffer(image, OPJ_PF_RGB16, 3, 16) && check_buffer(image, OPJ_PF_RGBA16, 4, 16);
+
+	/* gray formats and strides too small for a row are rejected */
+	if (ok && (opj_image_sycc_to_buffer(image, pixel, sizeof(pixel), OPJ_PF_GRAY8)
+	           || opj_image_sycc_to_buffer(image, pixel, width * 3 - 1, OPJ_PF_RGB8))) {
+		fprintf(stderr, "ERROR -> unsupported buffer accepted\n");
+		ok = 0;
+	}
+
+	ok = ok && check_planes(image);
+	opj_image_destroy(image);
+	if (!ok)
+		return EXIT_FAILURE;
+
+	fprintf(stdout, "%dx%d image with a chroma subsampled by %dx%d converted successfully\n", width, height, dx, dy);
+	return EXIT_SUCCESS;
+}
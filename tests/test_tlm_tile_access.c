@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2015, OpenJPEG contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* -------------------------------------------------------------------------- */
+
+static int nb_warnings = 0;
+
+/**
+sample warning callback counting the warnings
+*/
+static void warning_callback(const char *msg, void *client_data) {
+	(void)client_data;
+	fprintf(stdout, "[WARNING] %s", msg);
+	++nb_warnings;
+}
+
+/* -------------------------------------------------------------------------- */
+
+#define NUM_COMPS FIXTURE_NUM_COMPS
+#define WIDTH FIXTURE_WIDTH
+#define HEIGHT FIXTURE_HEIGHT
+#define TILE_SIZE FIXTURE_TILE_SIZE
+#define NUM_TILES (((WIDTH + TILE_SIZE - 1) / TILE_SIZE) * ((HEIGHT + TILE_SIZE - 1) / TILE_SIZE))
+#define MAX_TILE_PARTS 256
+
+static int write_file(const char *filename, const unsigned char *data, size_t size)
+{
+	FILE *f = fopen(filename, "wb");
+	int ok;
+
+	if (!f) {
+		return 0;
+	}
+	ok = fwrite(data, 1, size, f) == size;
+	fclose(f);
+	return ok;
+}
+
+static long read_file(const char *filename, unsigned char **data)
+{
+	FILE *f = fopen(filename, "rb");
+	long size;
+
+	*data = 00;
+	if (!f) {
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	*data = (unsigned char *) malloc((size_t)size + 1);
+	if (!*data || fread(*data, 1, (size_t)size, f) != (size_t)size) {
+		size = -1;
+	}
+	fclose(f);
+	return size;
+}
+
+/* tiles of 64x64, one tile-part per resolution */
+static int encode(const char *filename, int plt_on)
+{
+	opj_cparameters_t parameters;
+
+	test_set_fixture_parameters(&parameters);
+	parameters.tp_on = 1;
+	parameters.tp_flag = 'R';
+	parameters.plt_on = plt_on ? OPJ_TRUE : OPJ_FALSE;
+	return test_encode_image(filename, &parameters, test_create_fixture_image());
+}
+
+static opj_codec_t * create_decoder(const char *filename, opj_stream_t **stream, opj_image_t **image)
+{
+	opj_dparameters_t parameters;
+	opj_codec_t *codec;
+
+	opj_set_default_decoder_parameters(&parameters);
+	codec = opj_create_decompress(OPJ_CODEC_J2K);
+	opj_set_warning_handler(codec, warning_callback, 00);
+	opj_set_error_handler(codec, test_error_callback, 00);
+	*image = 00;
+	*stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+	if (!*stream || !opj_setup_decoder(codec, &parameters) || !opj_read_header(*stream, codec, image)) {
+		if (*stream) {
+			opj_stream_destroy(*stream);
+		}
+		opj_destroy_codec(codec);
+		return 00;
+	}
+	return codec;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out_file;
+	char ref_file[256];
+	int mode, ok = 1;
+	unsigned char *data, *out_data, *p;
+	long size, pos, main_header_end;
+	OPJ_UINT32 nb_tps = 0, tlm_size, i, k, compno;
+	OPJ_UINT32 tp_tile[MAX_TILE_PARTS], tp_pos[MAX_TILE_PARTS], tp_len[MAX_TILE_PARTS];
+	opj_codec_t *codec;
+	opj_stream_t *stream;
+	opj_image_t *ref_image, *image;
+	opj_codestream_index_t *cstr_index;
+	opj_tile_index_t *tile_index;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <file.j2k> <mode>\n"
+			"  mode 0: TLM marker, 1: TLM marker and unknown numbers of tile-parts, 2: wrong TLM marker,\n"
+			"  3: TLM and PLT markers\n", argv[0]);
+		return 1;
+	}
+	out_file = argv[1];
+	mode = atoi(argv[2]);
+	if (strlen(out_file) + 5 > sizeof(ref_file)) {
+		return 1;
+	}
+	sprintf(ref_file, "ref_%s", out_file);
+
+	if (!encode(ref_file, mode == 3)) {
+		fprintf(stderr, "ERROR -> failed to encode %s\n", ref_file);
+		return 1;
+	}
+
+	/* locate the tile-parts : the main header ends with the first SOT */
+	size = read_file(ref_file, &data);
+	if (size < 0) {
+		return 1;
+	}
+	pos = 2;
+	while (pos + 4 <= size && !(data[pos] == 0xff && data[pos + 1] == 0x90)) {
+		pos += 2 + ((data[pos + 2] << 8) | data[pos + 3]);
+	}
+	main_header_end = pos;
+	while (pos + 12 <= size && data[pos] == 0xff && data[pos + 1] == 0x90 && nb_tps < MAX_TILE_PARTS) {
+		tp_tile[nb_tps] = (OPJ_UINT32)((data[pos + 4] << 8) | data[pos + 5]);
+		tp_len[nb_tps] = ((OPJ_UINT32)data[pos + 6] << 24) | ((OPJ_UINT32)data[pos + 7] << 16) | ((OPJ_UINT32)data[pos + 8] << 8) | data[pos + 9];
+		if (mode == 1) {
+			data[pos + 11] = 0; /* TNsot */
+		}
+		pos += tp_len[nb_tps++];
+	}
+	if (nb_tps <= NUM_TILES || pos + 2 != size) {
+		fprintf(stderr, "ERROR -> unexpected tile-parts in %s\n", ref_file);
+		return 1;
+	}
+
+	/* insert a TLM marker with 16-bit tile numbers and 32-bit lengths */
+	tlm_size = 6 + 6 * nb_tps;
+	out_data = (unsigned char *) malloc((size_t)size + tlm_size);
+	if (!out_data) {
+		return 1;
+	}
+	memcpy(out_data, data, (size_t)main_header_end);
+	p = out_data + main_header_end;
+	*p++ = 0xff; *p++ = 0x55;
+	*p++ = (unsigned char)((tlm_size - 2) >> 8); *p++ = (unsigned char)(tlm_size - 2);
+	*p++ = 0;       /* Ztlm */
+	*p++ = 0x60;    /* Stlm */
+	for (k = 0; k < nb_tps; ++k) {
+		OPJ_UINT32 len = tp_len[k] + ((mode == 2 && k == nb_tps / 2) ? 1 : 0);
+		tp_pos[k] = k ? tp_pos[k - 1] + tp_len[k - 1] : (OPJ_UINT32)main_header_end + tlm_size;
+		*p++ = (unsigned char)(tp_tile[k] >> 8); *p++ = (unsigned char)tp_tile[k];
+		*p++ = (unsigned char)(len >> 24); *p++ = (unsigned char)(len >> 16); *p++ = (unsigned char)(len >> 8); *p++ = (unsigned char)len;
+	}
+	memcpy(p, data + main_header_end, (size_t)(size - main_header_end));
+	ok = write_file(out_file, out_data, (size_t)size + tlm_size);
+	free(out_data);
+	/* the reference keeps the modified TNsot */
+	ok = ok && write_file(ref_file, data, (size_t)size);
+	free(data);
+	if (!ok) {
+		return 1;
+	}
+
+	/* reference : the whole image */
+	codec = create_decoder(ref_file, &stream, &ref_image);
+	if (!codec) {
+		return 1;
+	}
+	ok = opj_decode(codec, stream, ref_image) && opj_end_decompress(codec, stream);
+	opj_stream_destroy(stream);
+	opj_destroy_codec(codec);
+	if (!ok) {
+		fprintf(stderr, "ERROR -> failed to decode %s\n", ref_file);
+		return 1;
+	}
+
+	nb_warnings = 0;
+	codec = create_decoder(out_file, &stream, &image);
+	if (!codec) {
+		return 1;
+	}
+
+	/* the tile-parts are known as soon as the main header is read */
+	cstr_index = opj_get_cstr_index(codec);
+	if (mode != 2) {
+		OPJ_UINT32 tp_no[NUM_TILES];
+		memset(tp_no, 0, sizeof(tp_no));
+		for (k = 0; ok && k < nb_tps; ++k) {
+			opj_tile_index_t *tile_index = &cstr_index->tile_index[tp_tile[k]];
+			i = tp_no[tp_tile[k]]++;
+			if (i >= tile_index->nb_tps || tile_index->tp_index[i].start_pos != tp_pos[k]
+				|| tile_index->tp_index[i].end_pos != tp_pos[k] + tp_len[k]) {
+				fprintf(stderr, "ERROR -> tile-part %d of tile %d is not indexed\n", i, tp_tile[k]);
+				ok = 0;
+			}
+		}
+	}
+	opj_destroy_cstr_index(&cstr_index);
+
+	/* tiles in reverse order */
+	for (i = NUM_TILES; ok && i-- > 0;) {
+		if (!opj_get_decoded_tile(codec, stream, image, i)) {
+			fprintf(stderr, "ERROR -> failed to decode tile %d\n", i);
+			ok = 0;
+			break;
+		}
+		for (compno = 0; ok && compno < NUM_COMPS; ++compno) {
+			opj_image_comp_t *comp = &image->comps[compno];
+			OPJ_UINT32 x, y;
+			for (y = 0; ok && y < comp->h; ++y) {
+				for (x = 0; x < comp->w; ++x) {
+					if (comp->data[y * comp->w + x] != ref_image->comps[compno].data[(comp->y0 + y) * WIDTH + comp->x0 + x]) {
+						fprintf(stderr, "ERROR -> tile %d differs from the reference at (%d,%d)\n", i, comp->x0 + x, comp->y0 + y);
+						ok = 0;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	/* the PLT markers give the position of every packet of the decoded tile-parts */
+	cstr_index = opj_get_cstr_index(codec);
+	for (i = 0; ok && mode == 3 && i < NUM_TILES; ++i) {
+		tile_index = &cstr_index->tile_index[i];
+		for (k = 0; ok && k < tile_index->nb_tps; ++k) {
+			opj_tp_index_t *tp_index = &tile_index->tp_index[k];
+			opj_packet_info_t *first, *last;
+			if (tp_index->nb_packets == 0 || tp_index->first_packet + tp_index->nb_packets > tile_index->nb_packet) {
+				fprintf(stderr, "ERROR -> no packet for tile-part %d of tile %d\n", k, i);
+				ok = 0;
+				break;
+			}
+			first = &tile_index->packet_index[tp_index->first_packet];
+			last = &tile_index->packet_index[tp_index->first_packet + tp_index->nb_packets - 1];
+			if (first->start_pos != tp_index->end_header + 2 || last->end_pos + 1 != tp_index->end_pos) {
+				fprintf(stderr, "ERROR -> wrong packet positions in tile-part %d of tile %d\n", k, i);
+				ok = 0;
+			}
+		}
+	}
+	opj_destroy_cstr_index(&cstr_index);
+
+	opj_stream_destroy(stream);
+	opj_destroy_codec(codec);
+	opj_image_destroy(image);
+	opj_image_destroy(ref_image);
+
+	if (ok && ((mode == 2) != (nb_warnings > 0))) {
+		fprintf(stderr, "ERROR -> %d warnings\n", nb_warnings);
+		ok = 0;
+	}
+
+	return ok ? 0 : 1;
+}
@@ -156,6 +156,7 @@ int main(int argc, char *argv[])
   opj_set_warning_handler(d_codec, warning_callback,00);
   opj_set_error_handler(d_codec, error_callback,00);
 
+  opj_set_default_decoder_parameters(&dparameters);
   bSuccess = opj_setup_decoder(d_codec, &dparameters);
   assert( bSuccess );
 